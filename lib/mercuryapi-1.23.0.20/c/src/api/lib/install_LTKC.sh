@@ -42,6 +42,8 @@ patch -p0 -d ${INSTALL_DIR} < ${PATCH_DIR}/llrp_ltkc_max_custom_messages_size.pa
 patch -p0 -d ${INSTALL_DIR} < ${PATCH_DIR}/llrp_shared_lib.patch
 patch -p0 -d ${INSTALL_DIR} < ${PATCH_DIR}/llrp_ltkc_add_custom_access_command_opspec.patch
 patch -p0 -d ${INSTALL_DIR} < ${PATCH_DIR}/llrp_ltk_shared_libs.patch
+#Route LTKC element and array allocations through a replaceable allocator
+patch -p0 -d ${INSTALL_DIR} < ${PATCH_DIR}/llrp_ltkc_element_allocator.patch
 
 #This is to avoid multiple includes of out_ltkc_ header files.
 echo '#ifndef __OUT_LTKC_WRAPPER_H' > ${INSTALL_DIR}/LTK/LTKC/Library/out_ltkc_wrapper.h
@@ -0,0 +1,2258 @@
+/**
+ *  @file llrp_emulator.c
+ *  @brief Mercury API - Local LLRP reader emulator
+ *
+ * Each emulated reader listens on its own socket.  One accept thread
+ * polls all listen sockets and starts a session thread per client
+ * connection.  A session owns its LTKC connection and all reader state
+ * (ROSpecs, AccessSpecs, configuration), so sessions never share
+ * anything but the type registry and the emulator counters.
+ *
+ * A session thread alternates between receiving client messages with
+ * a short timeout and running the ROSpec that is currently active:
+ * tag reads are generated at the configured rate, round robin over
+ * the tag population and the AISpec antennas, merged per tag and
+ * antenna until the ROReportSpec asks for a report, and sent as
+ * RO_ACCESS_REPORT messages.
+ *
+ * Not emulated: tag filters (AccessSpecs apply to every tag), writes
+ * to tag memory (reads return fixed per tag contents), GPIO, ThingMagic
+ * custom OpSpecs, and the ThingMagic custom configuration other than
+ * region, deduplication and async off time.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "tm_reader.h"
+#include "llrp_reader_imp.h"
+#include "llrp_emulator.h"
+
+#define EMU_MAX_ROSPECS 16
+#define EMU_MAX_ACCESSSPECS 16
+#define EMU_MAX_OPSPECS 8
+#define EMU_MAX_ANTENNAS 16
+#define EMU_FRAME_SIZE (64u * 1024u)
+/* Largest report the client's 32kb receive buffer is given */
+#define EMU_MAX_REPORT_BYTES 24000
+#define EMU_MAX_REPORT_TAGS 200
+/* Reads generated per loop when the read rate is unlimited */
+#define EMU_BURST 256
+#define EMU_IDLE_WAIT_MS 10
+#define EMU_READ_WAIT_MS 2
+/* Words returned by a C1G2Read with a WordCount of 0 */
+#define EMU_DEFAULT_READ_WORDS 8
+#define EMU_FIRMWARE_VERSION "5.3.2.97"
+#define EMU_HOP_TABLE_SIZE 50
+#define EMU_SESSION_STACK_SIZE (256 * 1024)
+
+typedef struct EmuROSpec
+{
+  uint32_t id;
+  LLRP_tEROSpecState state;
+  LLRP_tEROSpecStartTriggerType startTrigger;
+  uint32_t periodMs;
+  uint32_t offsetMs;
+  /* Run time of one pass, 0 until stopped */
+  uint32_t durationMs;
+  LLRP_tEROReportTriggerType reportTrigger;
+  uint16_t reportN;
+  /* TagReportContentSelector, as a bit mask of EMU_CONTENT_* */
+  uint16_t content;
+  bool phase;
+  uint16_t antennas[EMU_MAX_ANTENNAS];
+  uint8_t antennaCount;
+  /* Start of the next pass of a periodic ROSpec */
+  uint64_t nextStartUs;
+} EmuROSpec;
+
+#define EMU_CONTENT_ROSPECID     0x0001
+#define EMU_CONTENT_SPECINDEX    0x0002
+#define EMU_CONTENT_INVPARAMID   0x0004
+#define EMU_CONTENT_ANTENNAID    0x0008
+#define EMU_CONTENT_CHANNELINDEX 0x0010
+#define EMU_CONTENT_PEAKRSSI     0x0020
+#define EMU_CONTENT_FIRSTSEEN    0x0040
+#define EMU_CONTENT_LASTSEEN     0x0080
+#define EMU_CONTENT_SEENCOUNT    0x0100
+#define EMU_CONTENT_ACCESSSPECID 0x0200
+#define EMU_CONTENT_PCBITS       0x0400
+#define EMU_CONTENT_CRC          0x0800
+
+typedef struct EmuOpSpec
+{
+  const LLRP_tSTypeDescriptor *pType;
+  uint16_t opSpecId;
+  uint8_t bank;
+  uint16_t wordPointer;
+  uint16_t wordCount;
+} EmuOpSpec;
+
+typedef struct EmuAccessSpec
+{
+  uint32_t id;
+  uint16_t antennaId;
+  uint32_t roSpecId;
+  bool enabled;
+  EmuOpSpec opSpecs[EMU_MAX_OPSPECS];
+  uint8_t opSpecCount;
+} EmuAccessSpec;
+
+/** Reads of one tag on one antenna waiting to be reported */
+typedef struct EmuPendingRead
+{
+  uint32_t tag;
+  uint16_t antenna;
+  uint16_t count;
+  int8_t rssi;
+  uint16_t channel;
+  uint16_t phase;
+  uint64_t firstSeenUs;
+  uint64_t lastSeenUs;
+} EmuPendingRead;
+
+typedef struct EmuSession
+{
+  struct TMR_LLRP_Emulator *emu;
+  struct EmuSession *next;
+  pthread_t thread;
+  volatile bool done;
+  uint32_t readerIndex;
+  LLRP_tSConnection *pConn;
+  uint32_t random;
+  bool closing;
+
+  /* Reader configuration */
+  uint32_t keepaliveMs;
+  uint64_t nextKeepaliveUs;
+  bool roSpecEvents;
+  bool holdEvents;
+  LLRP_tEThingMagicRegionID region;
+  bool dedupHighestRssi;
+  bool dedupByAntenna;
+  bool dedupByData;
+  uint32_t asyncOffTime;
+
+  EmuROSpec roSpecs[EMU_MAX_ROSPECS];
+  uint8_t roSpecCount;
+  EmuAccessSpec accessSpecs[EMU_MAX_ACCESSSPECS];
+  uint8_t accessSpecCount;
+
+  /* ROSpec being run, its start time and reads generated so far */
+  EmuROSpec *running;
+  uint64_t runStartUs;
+  uint64_t runReads;
+  uint32_t nextTag;
+  uint8_t nextAntenna;
+
+  /* Reads not reported yet, indexed by tag * antennaCount + antenna - 1 */
+  EmuPendingRead *pending;
+  int32_t *pendingIndex;
+  uint32_t pendingCount;
+
+  /* Counters not yet added to the emulator totals */
+  TMR_LLRP_EmulatorStats stats;
+} EmuSession;
+
+struct TMR_LLRP_Emulator
+{
+  TMR_LLRP_EmulatorConfig config;
+  LLRP_tSTypeRegistry *pTypeRegistry;
+  int *listenFds;
+  uint32_t listenCount;
+  pthread_t acceptThread;
+  volatile bool stopping;
+  pthread_mutex_t lock;
+  EmuSession *sessions;
+  TMR_LLRP_EmulatorStats stats;
+};
+
+/**
+ * Every LLRP response message, including the ThingMagic custom ones,
+ * starts with its LLRPStatus parameter.
+ **/
+typedef struct EmuStatusResponse
+{
+  LLRP_tSMessage hdr;
+  LLRP_tSLLRPStatus *pLLRPStatus;
+} EmuStatusResponse;
+
+static uint64_t
+emu_nowUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static uint64_t
+emu_utcUs(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+static uint32_t
+emu_random(EmuSession *s)
+{
+  /* xorshift32 */
+  s->random ^= s->random << 13;
+  s->random ^= s->random >> 17;
+  s->random ^= s->random << 5;
+  return s->random;
+}
+
+/**
+ * Gen2 CRC-16 (CCITT, preset 0xFFFF, complemented)
+ **/
+static uint16_t
+emu_crc16(const uint8_t *data, uint32_t len)
+{
+  uint16_t crc;
+  uint32_t i;
+  int bit;
+
+  crc = 0xFFFF;
+  for (i = 0; i < len; i++)
+  {
+    crc ^= (uint16_t)(data[i] << 8);
+    for (bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return (uint16_t)~crc;
+}
+
+/**
+ * EPC of a tag of the population: E2 00, the seed, zeros and the tag
+ * number, like the simulated serial module.
+ **/
+static void
+emu_tagEpc(const TMR_LLRP_EmulatorConfig *config, uint32_t tag, uint8_t *epc)
+{
+  uint8_t len;
+
+  len = config->epcLength;
+  memset(epc, 0, len);
+  epc[0] = 0xE2;
+  epc[1] = 0x00;
+  epc[2] = (uint8_t)(config->seed >> 8);
+  epc[3] = (uint8_t)config->seed;
+  epc[len - 4] = (uint8_t)(tag >> 24);
+  epc[len - 3] = (uint8_t)(tag >> 16);
+  epc[len - 2] = (uint8_t)(tag >> 8);
+  epc[len - 1] = (uint8_t)tag;
+}
+
+/**
+ * Contents of a tag memory word.  The EPC bank holds the CRC, PC and
+ * EPC, the TID bank a fixed class and model followed by the tag
+ * number, and the user bank a pattern derived from the tag number.
+ * Passwords are zero.
+ **/
+static uint16_t
+emu_tagWord(const TMR_LLRP_EmulatorConfig *config, uint32_t tag,
+            uint8_t bank, uint16_t address)
+{
+  uint8_t epc[30];
+
+  switch (bank)
+  {
+    case TMR_GEN2_BANK_EPC:
+      emu_tagEpc(config, tag, epc);
+      if (0 == address)
+      {
+        return emu_crc16(epc, config->epcLength);
+      }
+      if (1 == address)
+      {
+        return (uint16_t)((config->epcLength / 2) << 11);
+      }
+      if ((uint32_t)(address - 2) < (uint32_t)(config->epcLength / 2))
+      {
+        return (uint16_t)((epc[(address - 2) * 2] << 8) | epc[(address - 2) * 2 + 1]);
+      }
+      return 0;
+
+    case TMR_GEN2_BANK_TID:
+      switch (address)
+      {
+        case 0: return 0xE200;
+        case 1: return 0x3412;
+        case 2: return (uint16_t)config->seed;
+        case 3: return (uint16_t)(tag >> 16);
+        case 4: return (uint16_t)tag;
+        default: return 0;
+      }
+
+    case TMR_GEN2_BANK_USER:
+      return (uint16_t)((tag * 0x9E37u) ^ (address * 0x0101u));
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ * Fold the session counters into the emulator totals
+ **/
+static void
+emu_flushStats(EmuSession *s)
+{
+  TMR_LLRP_EmulatorStats *total;
+
+  total = &s->emu->stats;
+  pthread_mutex_lock(&s->emu->lock);
+  total->messagesReceived += s->stats.messagesReceived;
+  total->messagesSent += s->stats.messagesSent;
+  total->reports += s->stats.reports;
+  total->tagReports += s->stats.tagReports;
+  total->tagReads += s->stats.tagReads;
+  pthread_mutex_unlock(&s->emu->lock);
+  memset(&s->stats, 0, sizeof(s->stats));
+}
+
+/**
+ * Send a message and free it.  A failed send closes the session.
+ **/
+static void
+emu_send(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  if (LLRP_RC_OK != LLRP_Conn_sendMessage(s->pConn, pMsg))
+  {
+    s->closing = true;
+  }
+  else
+  {
+    s->stats.messagesSent++;
+  }
+  LLRP_Element_destruct(&pMsg->elementHdr);
+}
+
+static LLRP_tSLLRPStatus *
+emu_status(LLRP_tEStatusCode code, const char *description)
+{
+  LLRP_tSLLRPStatus *pStatus;
+  llrp_utf8v_t text;
+  uint16_t len;
+
+  pStatus = LLRP_LLRPStatus_construct();
+  LLRP_LLRPStatus_setStatusCode(pStatus, code);
+  len = (NULL == description) ? 0 : (uint16_t)strlen(description);
+  text = LLRP_utf8v_construct(len);
+  if (0 != len)
+  {
+    memcpy(text.pValue, description, len);
+  }
+  LLRP_LLRPStatus_setErrorDescription(pStatus, text);
+  return pStatus;
+}
+
+/**
+ * Construct the response to a request, with the given status.  A
+ * request that has no response type gets an ERROR_MESSAGE.
+ **/
+static LLRP_tSMessage *
+emu_response(LLRP_tSMessage *pReq, LLRP_tEStatusCode code, const char *description)
+{
+  const LLRP_tSTypeDescriptor *pType;
+  LLRP_tSMessage *pRsp;
+
+  pType = pReq->elementHdr.pType->pResponseType;
+  if (NULL == pType)
+  {
+    pType = &LLRP_tdERROR_MESSAGE;
+  }
+  pRsp = (LLRP_tSMessage *)pType->pfConstruct();
+  LLRP_Message_setMessageID(pRsp, pReq->MessageID);
+  LLRP_Element_setSubParameterPtr(&pRsp->elementHdr,
+      (LLRP_tSParameter **)&((EmuStatusResponse *)pRsp)->pLLRPStatus,
+      &emu_status(code, description)->hdr);
+  return pRsp;
+}
+
+static void
+emu_respond(EmuSession *s, LLRP_tSMessage *pReq, LLRP_tEStatusCode code,
+            const char *description)
+{
+  emu_send(s, emu_response(pReq, code, description));
+}
+
+static LLRP_tSUTCTimestamp *
+emu_timestamp(void)
+{
+  LLRP_tSUTCTimestamp *pTimestamp;
+
+  pTimestamp = LLRP_UTCTimestamp_construct();
+  LLRP_UTCTimestamp_setMicroseconds(pTimestamp, emu_utcUs());
+  return pTimestamp;
+}
+
+static void
+emu_sendConnectionEvent(EmuSession *s)
+{
+  LLRP_tSREADER_EVENT_NOTIFICATION *pNtf;
+  LLRP_tSReaderEventNotificationData *pData;
+  LLRP_tSConnectionAttemptEvent *pEvent;
+
+  pNtf = LLRP_READER_EVENT_NOTIFICATION_construct();
+  pData = LLRP_ReaderEventNotificationData_construct();
+  LLRP_ReaderEventNotificationData_setTimestamp(pData, &emu_timestamp()->hdr);
+  pEvent = LLRP_ConnectionAttemptEvent_construct();
+  LLRP_ConnectionAttemptEvent_setStatus(pEvent, LLRP_ConnectionAttemptStatusType_Success);
+  LLRP_ReaderEventNotificationData_setConnectionAttemptEvent(pData, pEvent);
+  LLRP_READER_EVENT_NOTIFICATION_setReaderEventNotificationData(pNtf, pData);
+  emu_send(s, &pNtf->hdr);
+}
+
+static void
+emu_sendROSpecEvent(EmuSession *s, LLRP_tEROSpecEventType type, uint32_t roSpecId)
+{
+  LLRP_tSREADER_EVENT_NOTIFICATION *pNtf;
+  LLRP_tSReaderEventNotificationData *pData;
+  LLRP_tSROSpecEvent *pEvent;
+
+  if (false == s->roSpecEvents)
+  {
+    return;
+  }
+
+  pNtf = LLRP_READER_EVENT_NOTIFICATION_construct();
+  pData = LLRP_ReaderEventNotificationData_construct();
+  LLRP_ReaderEventNotificationData_setTimestamp(pData, &emu_timestamp()->hdr);
+  pEvent = LLRP_ROSpecEvent_construct();
+  LLRP_ROSpecEvent_setEventType(pEvent, type);
+  LLRP_ROSpecEvent_setROSpecID(pEvent, roSpecId);
+  LLRP_ReaderEventNotificationData_setROSpecEvent(pData, pEvent);
+  LLRP_READER_EVENT_NOTIFICATION_setReaderEventNotificationData(pNtf, pData);
+  emu_send(s, &pNtf->hdr);
+}
+
+/**
+ * Result of one OpSpec of an AccessSpec on a tag, always successful
+ **/
+static LLRP_tSParameter *
+emu_opSpecResult(EmuSession *s, const EmuOpSpec *op, uint32_t tag)
+{
+  const TMR_LLRP_EmulatorConfig *config;
+
+  config = &s->emu->config;
+
+  if (&LLRP_tdC1G2Read == op->pType)
+  {
+    LLRP_tSC1G2ReadOpSpecResult *pResult;
+    llrp_u16v_t data;
+    uint16_t count;
+    uint16_t i;
+
+    count = (0 == op->wordCount) ? EMU_DEFAULT_READ_WORDS : op->wordCount;
+    data = LLRP_u16v_construct(count);
+    for (i = 0; i < count; i++)
+    {
+      data.pValue[i] = emu_tagWord(config, tag, op->bank, (uint16_t)(op->wordPointer + i));
+    }
+    pResult = LLRP_C1G2ReadOpSpecResult_construct();
+    LLRP_C1G2ReadOpSpecResult_setResult(pResult, LLRP_C1G2ReadResultType_Success);
+    LLRP_C1G2ReadOpSpecResult_setOpSpecID(pResult, op->opSpecId);
+    LLRP_C1G2ReadOpSpecResult_setReadData(pResult, data);
+    return &pResult->hdr;
+  }
+  if (&LLRP_tdC1G2Write == op->pType)
+  {
+    LLRP_tSC1G2WriteOpSpecResult *pResult;
+
+    pResult = LLRP_C1G2WriteOpSpecResult_construct();
+    LLRP_C1G2WriteOpSpecResult_setResult(pResult, LLRP_C1G2WriteResultType_Success);
+    LLRP_C1G2WriteOpSpecResult_setOpSpecID(pResult, op->opSpecId);
+    LLRP_C1G2WriteOpSpecResult_setNumWordsWritten(pResult, op->wordCount);
+    return &pResult->hdr;
+  }
+  if (&LLRP_tdC1G2BlockWrite == op->pType)
+  {
+    LLRP_tSC1G2BlockWriteOpSpecResult *pResult;
+
+    pResult = LLRP_C1G2BlockWriteOpSpecResult_construct();
+    LLRP_C1G2BlockWriteOpSpecResult_setResult(pResult, LLRP_C1G2BlockWriteResultType_Success);
+    LLRP_C1G2BlockWriteOpSpecResult_setOpSpecID(pResult, op->opSpecId);
+    LLRP_C1G2BlockWriteOpSpecResult_setNumWordsWritten(pResult, op->wordCount);
+    return &pResult->hdr;
+  }
+  if (&LLRP_tdC1G2BlockErase == op->pType)
+  {
+    LLRP_tSC1G2BlockEraseOpSpecResult *pResult;
+
+    pResult = LLRP_C1G2BlockEraseOpSpecResult_construct();
+    LLRP_C1G2BlockEraseOpSpecResult_setResult(pResult, LLRP_C1G2BlockEraseResultType_Success);
+    LLRP_C1G2BlockEraseOpSpecResult_setOpSpecID(pResult, op->opSpecId);
+    return &pResult->hdr;
+  }
+  if (&LLRP_tdC1G2Lock == op->pType)
+  {
+    LLRP_tSC1G2LockOpSpecResult *pResult;
+
+    pResult = LLRP_C1G2LockOpSpecResult_construct();
+    LLRP_C1G2LockOpSpecResult_setResult(pResult, LLRP_C1G2LockResultType_Success);
+    LLRP_C1G2LockOpSpecResult_setOpSpecID(pResult, op->opSpecId);
+    return &pResult->hdr;
+  }
+  if (&LLRP_tdC1G2Kill == op->pType)
+  {
+    LLRP_tSC1G2KillOpSpecResult *pResult;
+
+    pResult = LLRP_C1G2KillOpSpecResult_construct();
+    LLRP_C1G2KillOpSpecResult_setResult(pResult, LLRP_C1G2KillResultType_Success);
+    LLRP_C1G2KillOpSpecResult_setOpSpecID(pResult, op->opSpecId);
+    return &pResult->hdr;
+  }
+  return NULL;
+}
+
+/**
+ * The enabled AccessSpec that applies to reads of the running ROSpec
+ * on the given antenna, if any.  As on a reader, only the first match
+ * is executed.
+ **/
+static EmuAccessSpec *
+emu_matchAccessSpec(EmuSession *s, uint16_t antenna)
+{
+  uint8_t i;
+
+  for (i = 0; i < s->accessSpecCount; i++)
+  {
+    EmuAccessSpec *spec = &s->accessSpecs[i];
+
+    if ((true == spec->enabled)
+        && ((0 == spec->roSpecId) || (spec->roSpecId == s->running->id))
+        && ((0 == spec->antennaId) || (spec->antennaId == antenna)))
+    {
+      return spec;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Encoded size estimate of one TagReportData, to keep each report
+ * within the client's receive buffer
+ **/
+static uint32_t
+emu_tagReportSize(EmuSession *s, const EmuAccessSpec *spec)
+{
+  uint32_t size;
+  uint8_t i;
+
+  size = 80 + s->emu->config.epcLength;
+  if (NULL != spec)
+  {
+    for (i = 0; i < spec->opSpecCount; i++)
+    {
+      size += 12;
+      if (&LLRP_tdC1G2Read == spec->opSpecs[i].pType)
+      {
+        size += 2 * ((0 == spec->opSpecs[i].wordCount)
+                     ? EMU_DEFAULT_READ_WORDS : spec->opSpecs[i].wordCount);
+      }
+    }
+  }
+  return size;
+}
+
+static LLRP_tSTagReportData *
+emu_tagReport(EmuSession *s, const EmuPendingRead *read, const EmuAccessSpec *spec)
+{
+  const TMR_LLRP_EmulatorConfig *config;
+  const EmuROSpec *ro;
+  LLRP_tSTagReportData *pTag;
+  uint8_t epc[30];
+
+  config = &s->emu->config;
+  ro = s->running;
+  pTag = LLRP_TagReportData_construct();
+
+  emu_tagEpc(config, read->tag, epc);
+  if (12 == config->epcLength)
+  {
+    LLRP_tSEPC_96 *pEpc;
+
+    pEpc = LLRP_EPC_96_construct();
+    memcpy(pEpc->EPC.aValue, epc, 12);
+    LLRP_TagReportData_setEPCParameter(pTag, &pEpc->hdr);
+  }
+  else
+  {
+    LLRP_tSEPCData *pEpc;
+    llrp_u1v_t bits;
+
+    pEpc = LLRP_EPCData_construct();
+    bits = LLRP_u1v_construct((uint16_t)(config->epcLength * 8));
+    memcpy(bits.pValue, epc, config->epcLength);
+    LLRP_EPCData_setEPC(pEpc, bits);
+    LLRP_TagReportData_setEPCParameter(pTag, &pEpc->hdr);
+  }
+
+  if (ro->content & EMU_CONTENT_ROSPECID)
+  {
+    LLRP_tSROSpecID *p = LLRP_ROSpecID_construct();
+    LLRP_ROSpecID_setROSpecID(p, ro->id);
+    LLRP_TagReportData_setROSpecID(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_SPECINDEX)
+  {
+    LLRP_tSSpecIndex *p = LLRP_SpecIndex_construct();
+    LLRP_SpecIndex_setSpecIndex(p, 1);
+    LLRP_TagReportData_setSpecIndex(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_INVPARAMID)
+  {
+    LLRP_tSInventoryParameterSpecID *p = LLRP_InventoryParameterSpecID_construct();
+    LLRP_InventoryParameterSpecID_setInventoryParameterSpecID(p, 1);
+    LLRP_TagReportData_setInventoryParameterSpecID(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_ANTENNAID)
+  {
+    LLRP_tSAntennaID *p = LLRP_AntennaID_construct();
+    LLRP_AntennaID_setAntennaID(p, read->antenna);
+    LLRP_TagReportData_setAntennaID(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_PEAKRSSI)
+  {
+    LLRP_tSPeakRSSI *p = LLRP_PeakRSSI_construct();
+    LLRP_PeakRSSI_setPeakRSSI(p, read->rssi);
+    LLRP_TagReportData_setPeakRSSI(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_CHANNELINDEX)
+  {
+    LLRP_tSChannelIndex *p = LLRP_ChannelIndex_construct();
+    LLRP_ChannelIndex_setChannelIndex(p, read->channel);
+    LLRP_TagReportData_setChannelIndex(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_FIRSTSEEN)
+  {
+    LLRP_tSFirstSeenTimestampUTC *p = LLRP_FirstSeenTimestampUTC_construct();
+    LLRP_FirstSeenTimestampUTC_setMicroseconds(p, read->firstSeenUs);
+    LLRP_TagReportData_setFirstSeenTimestampUTC(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_LASTSEEN)
+  {
+    LLRP_tSLastSeenTimestampUTC *p = LLRP_LastSeenTimestampUTC_construct();
+    LLRP_LastSeenTimestampUTC_setMicroseconds(p, read->lastSeenUs);
+    LLRP_TagReportData_setLastSeenTimestampUTC(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_SEENCOUNT)
+  {
+    LLRP_tSTagSeenCount *p = LLRP_TagSeenCount_construct();
+    LLRP_TagSeenCount_setTagCount(p, read->count);
+    LLRP_TagReportData_setTagSeenCount(pTag, p);
+  }
+  if (ro->content & EMU_CONTENT_PCBITS)
+  {
+    LLRP_tSC1G2_PC *p = LLRP_C1G2_PC_construct();
+    LLRP_C1G2_PC_setPC_Bits(p, emu_tagWord(config, read->tag, TMR_GEN2_BANK_EPC, 1));
+    LLRP_TagReportData_addAirProtocolTagData(pTag, &p->hdr);
+  }
+  if (ro->content & EMU_CONTENT_CRC)
+  {
+    LLRP_tSC1G2_CRC *p = LLRP_C1G2_CRC_construct();
+    LLRP_C1G2_CRC_setCRC(p, emu_crc16(epc, config->epcLength));
+    LLRP_TagReportData_addAirProtocolTagData(pTag, &p->hdr);
+  }
+  if (ro->phase)
+  {
+    LLRP_tSThingMagicRFPhase *p = LLRP_ThingMagicRFPhase_construct();
+    LLRP_ThingMagicRFPhase_setPhase(p, read->phase);
+    LLRP_TagReportData_addCustom(pTag, &p->hdr);
+  }
+
+  if (NULL != spec)
+  {
+    uint8_t i;
+
+    if (ro->content & EMU_CONTENT_ACCESSSPECID)
+    {
+      LLRP_tSAccessSpecID *p = LLRP_AccessSpecID_construct();
+      LLRP_AccessSpecID_setAccessSpecID(p, spec->id);
+      LLRP_TagReportData_setAccessSpecID(pTag, p);
+    }
+    for (i = 0; i < spec->opSpecCount; i++)
+    {
+      LLRP_tSParameter *pResult;
+
+      pResult = emu_opSpecResult(s, &spec->opSpecs[i], read->tag);
+      if (NULL != pResult)
+      {
+        LLRP_TagReportData_addAccessCommandOpSpecResult(pTag, pResult);
+      }
+    }
+  }
+
+  return pTag;
+}
+
+/**
+ * Report all pending reads, in as many RO_ACCESS_REPORT messages as
+ * the client's receive buffer requires
+ **/
+static void
+emu_flushReports(EmuSession *s)
+{
+  LLRP_tSRO_ACCESS_REPORT *pReport;
+  uint32_t i;
+  uint32_t inReport;
+  uint32_t bytes;
+
+  if ((0 == s->pendingCount) || (NULL == s->running))
+  {
+    return;
+  }
+
+  pReport = NULL;
+  inReport = 0;
+  bytes = 0;
+  for (i = 0; i < s->pendingCount; i++)
+  {
+    const EmuPendingRead *read;
+    EmuAccessSpec *spec;
+    uint32_t size;
+
+    read = &s->pending[i];
+    spec = emu_matchAccessSpec(s, read->antenna);
+    size = emu_tagReportSize(s, spec);
+
+    if ((NULL != pReport)
+        && ((EMU_MAX_REPORT_TAGS == inReport) || (bytes + size > EMU_MAX_REPORT_BYTES)))
+    {
+      emu_send(s, &pReport->hdr);
+      s->stats.reports++;
+      pReport = NULL;
+    }
+    if (NULL == pReport)
+    {
+      pReport = LLRP_RO_ACCESS_REPORT_construct();
+      inReport = 0;
+      bytes = 0;
+    }
+    LLRP_RO_ACCESS_REPORT_addTagReportData(pReport, emu_tagReport(s, read, spec));
+    inReport++;
+    bytes += size;
+    s->stats.tagReports++;
+    s->pendingIndex[(read->tag * s->emu->config.antennaCount) + read->antenna - 1] = -1;
+  }
+  emu_send(s, &pReport->hdr);
+  s->stats.reports++;
+  s->pendingCount = 0;
+}
+
+/**
+ * Generate one tag read of the running ROSpec
+ **/
+static void
+emu_generateRead(EmuSession *s)
+{
+  const TMR_LLRP_EmulatorConfig *config;
+  EmuROSpec *ro;
+  EmuPendingRead *read;
+  uint32_t key;
+  uint16_t antenna;
+  int8_t rssi;
+  uint64_t now;
+
+  config = &s->emu->config;
+  ro = s->running;
+
+  antenna = ro->antennas[s->nextAntenna];
+  key = (s->nextTag * config->antennaCount) + antenna - 1;
+  rssi = (int8_t)(-40 - (int8_t)(emu_random(s) % 30));
+  now = emu_utcUs();
+
+  if (0 <= s->pendingIndex[key])
+  {
+    read = &s->pending[s->pendingIndex[key]];
+    if (read->count < 0xFFFF)
+    {
+      read->count++;
+    }
+    if (rssi > read->rssi)
+    {
+      read->rssi = rssi;
+    }
+    read->lastSeenUs = now;
+  }
+  else
+  {
+    s->pendingIndex[key] = (int32_t)s->pendingCount;
+    read = &s->pending[s->pendingCount++];
+    read->tag = s->nextTag;
+    read->antenna = antenna;
+    read->count = 1;
+    read->rssi = rssi;
+    read->channel = (uint16_t)(1 + (emu_random(s) % EMU_HOP_TABLE_SIZE));
+    read->phase = (uint16_t)(emu_random(s) % 180);
+    read->firstSeenUs = now;
+    read->lastSeenUs = now;
+  }
+  s->stats.tagReads++;
+  s->runReads++;
+
+  s->nextTag = (s->nextTag + 1) % config->tagCount;
+  if (0 == s->nextTag)
+  {
+    s->nextAntenna = (uint8_t)((s->nextAntenna + 1) % ro->antennaCount);
+  }
+
+  if ((0 != ro->reportN)
+      && (LLRP_ROReportTriggerType_None != ro->reportTrigger)
+      && (s->pendingCount >= ro->reportN))
+  {
+    emu_flushReports(s);
+  }
+}
+
+static EmuROSpec *
+emu_findROSpec(EmuSession *s, uint32_t id)
+{
+  uint8_t i;
+
+  for (i = 0; i < s->roSpecCount; i++)
+  {
+    if (s->roSpecs[i].id == id)
+    {
+      return &s->roSpecs[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+emu_startROSpec(EmuSession *s, EmuROSpec *ro, uint64_t now)
+{
+  s->running = ro;
+  s->runStartUs = now;
+  s->runReads = 0;
+  s->nextAntenna = 0;
+  ro->state = LLRP_ROSpecState_Active;
+  emu_sendROSpecEvent(s, LLRP_ROSpecEventType_Start_Of_ROSpec, ro->id);
+}
+
+/**
+ * End the running ROSpec: report what is pending and notify the end
+ * of the ROSpec.  It goes back to Inactive, a periodic ROSpec to wait
+ * for its next pass.
+ **/
+static void
+emu_endROSpec(EmuSession *s)
+{
+  EmuROSpec *ro;
+
+  ro = s->running;
+  if (NULL == ro)
+  {
+    return;
+  }
+  emu_flushReports(s);
+  ro->state = LLRP_ROSpecState_Inactive;
+  s->running = NULL;
+  emu_sendROSpecEvent(s, LLRP_ROSpecEventType_End_Of_ROSpec, ro->id);
+}
+
+/**
+ * Run the active ROSpec for the time elapsed since the last call, and
+ * start the next one when it ends.
+ **/
+static void
+emu_runROSpecs(EmuSession *s)
+{
+  const TMR_LLRP_EmulatorConfig *config;
+  uint64_t now;
+
+  config = &s->emu->config;
+  now = emu_nowUs();
+
+  if (NULL == s->running)
+  {
+    uint8_t i;
+
+    /* ROSpecs started by START_ROSPEC first, then due periodic ones */
+    for (i = 0; (i < s->roSpecCount) && (NULL == s->running); i++)
+    {
+      if (LLRP_ROSpecState_Active == s->roSpecs[i].state)
+      {
+        emu_startROSpec(s, &s->roSpecs[i], now);
+      }
+    }
+    for (i = 0; (i < s->roSpecCount) && (NULL == s->running); i++)
+    {
+      EmuROSpec *ro = &s->roSpecs[i];
+
+      if ((LLRP_ROSpecState_Inactive == ro->state)
+          && (LLRP_ROSpecStartTriggerType_Periodic == ro->startTrigger)
+          && (now >= ro->nextStartUs))
+      {
+        ro->nextStartUs += (uint64_t)ro->periodMs * 1000;
+        if (ro->nextStartUs < now)
+        {
+          ro->nextStartUs = now + ((uint64_t)ro->periodMs * 1000);
+        }
+        emu_startROSpec(s, ro, now);
+      }
+    }
+    if (NULL == s->running)
+    {
+      return;
+    }
+  }
+
+  {
+    EmuROSpec *ro;
+    uint64_t due;
+    uint64_t elapsedUs;
+
+    ro = s->running;
+    elapsedUs = now - s->runStartUs;
+    if ((0 != ro->durationMs) && (elapsedUs > (uint64_t)ro->durationMs * 1000))
+    {
+      elapsedUs = (uint64_t)ro->durationMs * 1000;
+    }
+
+    if (0 == config->readRate)
+    {
+      due = s->runReads + EMU_BURST;
+    }
+    else
+    {
+      due = (elapsedUs * config->readRate) / 1000000;
+    }
+    while ((s->runReads < due) && (false == s->closing))
+    {
+      emu_generateRead(s);
+    }
+
+    if ((0 != ro->durationMs) && (elapsedUs >= (uint64_t)ro->durationMs * 1000))
+    {
+      emu_endROSpec(s);
+    }
+  }
+}
+
+static void
+emu_addROSpec(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  LLRP_tSROSpec *pROSpec;
+  LLRP_tSParameter *pSpec;
+  EmuROSpec *ro;
+
+  pROSpec = ((LLRP_tSADD_ROSPEC *)pMsg)->pROSpec;
+  if ((NULL == pROSpec) || (NULL == pROSpec->pROBoundarySpec)
+      || (NULL == pROSpec->pROBoundarySpec->pROSpecStartTrigger))
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_MissingParameter, "Incomplete ROSpec");
+    return;
+  }
+  if ((0 == pROSpec->ROSpecID) || (NULL != emu_findROSpec(s, pROSpec->ROSpecID)))
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "Invalid ROSpecID");
+    return;
+  }
+  if (EMU_MAX_ROSPECS == s->roSpecCount)
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_A_OutOfRange, "Too many ROSpecs");
+    return;
+  }
+
+  ro = &s->roSpecs[s->roSpecCount];
+  memset(ro, 0, sizeof(*ro));
+  ro->id = pROSpec->ROSpecID;
+  ro->state = LLRP_ROSpecState_Disabled;
+
+  {
+    LLRP_tSROSpecStartTrigger *pStart;
+    LLRP_tSROSpecStopTrigger *pStop;
+
+    pStart = pROSpec->pROBoundarySpec->pROSpecStartTrigger;
+    ro->startTrigger = pStart->eROSpecStartTriggerType;
+    if (NULL != pStart->pPeriodicTriggerValue)
+    {
+      ro->periodMs = pStart->pPeriodicTriggerValue->Period;
+      ro->offsetMs = pStart->pPeriodicTriggerValue->Offset;
+    }
+    pStop = pROSpec->pROBoundarySpec->pROSpecStopTrigger;
+    if ((NULL != pStop)
+        && (LLRP_ROSpecStopTriggerType_Duration == pStop->eROSpecStopTriggerType))
+    {
+      ro->durationMs = pStop->DurationTriggerValue;
+    }
+  }
+
+  for (pSpec = pROSpec->listSpecParameter; NULL != pSpec; pSpec = pSpec->pNextSubParameter)
+  {
+    LLRP_tSAISpec *pAISpec;
+    uint16_t i;
+
+    if (&LLRP_tdAISpec != pSpec->elementHdr.pType)
+    {
+      continue;
+    }
+    pAISpec = (LLRP_tSAISpec *)pSpec;
+    if ((NULL != pAISpec->pAISpecStopTrigger)
+        && (LLRP_AISpecStopTriggerType_Duration == pAISpec->pAISpecStopTrigger->eAISpecStopTriggerType)
+        && ((0 == ro->durationMs) || (pAISpec->pAISpecStopTrigger->DurationTrigger < ro->durationMs)))
+    {
+      ro->durationMs = pAISpec->pAISpecStopTrigger->DurationTrigger;
+    }
+    for (i = 0; i < pAISpec->AntennaIDs.nValue; i++)
+    {
+      uint16_t id = pAISpec->AntennaIDs.pValue[i];
+      uint8_t j;
+
+      if (0 == id)
+      {
+        /* All antennas */
+        ro->antennaCount = 0;
+        for (j = 1; j <= s->emu->config.antennaCount; j++)
+        {
+          ro->antennas[ro->antennaCount++] = j;
+        }
+        break;
+      }
+      if ((id <= s->emu->config.antennaCount) && (ro->antennaCount < EMU_MAX_ANTENNAS))
+      {
+        ro->antennas[ro->antennaCount++] = id;
+      }
+    }
+  }
+  if (0 == ro->antennaCount)
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "No valid AISpec antenna");
+    return;
+  }
+
+  ro->reportTrigger = LLRP_ROReportTriggerType_Upon_N_Tags_Or_End_Of_ROSpec;
+  ro->content = EMU_CONTENT_ROSPECID | EMU_CONTENT_ANTENNAID | EMU_CONTENT_PEAKRSSI
+                | EMU_CONTENT_FIRSTSEEN | EMU_CONTENT_LASTSEEN | EMU_CONTENT_SEENCOUNT
+                | EMU_CONTENT_PCBITS | EMU_CONTENT_CRC;
+  if (NULL != pROSpec->pROReportSpec)
+  {
+    LLRP_tSROReportSpec *pReportSpec;
+    LLRP_tSTagReportContentSelector *pSel;
+    LLRP_tSParameter *pCustom;
+
+    pReportSpec = pROSpec->pROReportSpec;
+    ro->reportTrigger = pReportSpec->eROReportTrigger;
+    ro->reportN = pReportSpec->N;
+    pSel = pReportSpec->pTagReportContentSelector;
+    if (NULL != pSel)
+    {
+      LLRP_tSParameter *pMemSel;
+
+      ro->content = (pSel->EnableROSpecID ? EMU_CONTENT_ROSPECID : 0)
+                  | (pSel->EnableSpecIndex ? EMU_CONTENT_SPECINDEX : 0)
+                  | (pSel->EnableInventoryParameterSpecID ? EMU_CONTENT_INVPARAMID : 0)
+                  | (pSel->EnableAntennaID ? EMU_CONTENT_ANTENNAID : 0)
+                  | (pSel->EnableChannelIndex ? EMU_CONTENT_CHANNELINDEX : 0)
+                  | (pSel->EnablePeakRSSI ? EMU_CONTENT_PEAKRSSI : 0)
+                  | (pSel->EnableFirstSeenTimestamp ? EMU_CONTENT_FIRSTSEEN : 0)
+                  | (pSel->EnableLastSeenTimestamp ? EMU_CONTENT_LASTSEEN : 0)
+                  | (pSel->EnableTagSeenCount ? EMU_CONTENT_SEENCOUNT : 0)
+                  | (pSel->EnableAccessSpecID ? EMU_CONTENT_ACCESSSPECID : 0);
+      for (pMemSel = pSel->listAirProtocolEPCMemorySelector; NULL != pMemSel;
+           pMemSel = pMemSel->pNextSubParameter)
+      {
+        if (&LLRP_tdC1G2EPCMemorySelector == pMemSel->elementHdr.pType)
+        {
+          LLRP_tSC1G2EPCMemorySelector *pGen2 = (LLRP_tSC1G2EPCMemorySelector *)pMemSel;
+
+          ro->content |= (pGen2->EnablePCBits ? EMU_CONTENT_PCBITS : 0)
+                       | (pGen2->EnableCRC ? EMU_CONTENT_CRC : 0);
+        }
+      }
+    }
+    for (pCustom = pReportSpec->listCustom; NULL != pCustom; pCustom = pCustom->pNextSubParameter)
+    {
+      if (&LLRP_tdThingMagicTagReportContentSelector == pCustom->elementHdr.pType)
+      {
+        ro->phase = (LLRP_ThingMagicPhaseMode_Enabled ==
+                     ((LLRP_tSThingMagicTagReportContentSelector *)pCustom)->ePhaseMode);
+      }
+    }
+  }
+
+  s->roSpecCount++;
+  emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+}
+
+/**
+ * Apply a ROSpec message to one ROSpec, or to all when the ID is 0
+ **/
+static void
+emu_roSpecCommand(EmuSession *s, LLRP_tSMessage *pMsg, uint32_t id)
+{
+  const LLRP_tSTypeDescriptor *pType;
+  uint64_t now;
+  uint8_t i;
+
+  pType = pMsg->elementHdr.pType;
+  now = emu_nowUs();
+
+  if ((0 != id) && (NULL == emu_findROSpec(s, id)))
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "No such ROSpec");
+    return;
+  }
+  if ((&LLRP_tdSTART_ROSPEC == pType) || (&LLRP_tdSTOP_ROSPEC == pType))
+  {
+    EmuROSpec *ro = emu_findROSpec(s, id);
+
+    /* START and STOP name a single ROSpec */
+    if (NULL == ro)
+    {
+      emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "No such ROSpec");
+      return;
+    }
+    if (&LLRP_tdSTART_ROSPEC == pType)
+    {
+      if (LLRP_ROSpecState_Disabled == ro->state)
+      {
+        emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "ROSpec is disabled");
+        return;
+      }
+      if (s->running != ro)
+      {
+        ro->state = LLRP_ROSpecState_Active;
+      }
+    }
+    else
+    {
+      if (s->running == ro)
+      {
+        emu_endROSpec(s);
+      }
+      else if (LLRP_ROSpecState_Active == ro->state)
+      {
+        ro->state = LLRP_ROSpecState_Inactive;
+      }
+    }
+    emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+    return;
+  }
+
+  for (i = 0; i < s->roSpecCount; )
+  {
+    EmuROSpec *ro = &s->roSpecs[i];
+
+    if ((0 != id) && (ro->id != id))
+    {
+      i++;
+      continue;
+    }
+    if (&LLRP_tdENABLE_ROSPEC == pType)
+    {
+      if (LLRP_ROSpecState_Disabled == ro->state)
+      {
+        ro->state = LLRP_ROSpecState_Inactive;
+        ro->nextStartUs = now + ((uint64_t)ro->offsetMs * 1000);
+      }
+      i++;
+      continue;
+    }
+    if (s->running == ro)
+    {
+      emu_endROSpec(s);
+    }
+    ro->state = LLRP_ROSpecState_Disabled;
+    if (&LLRP_tdDELETE_ROSPEC == pType)
+    {
+      EmuROSpec *running = s->running;
+
+      memmove(ro, ro + 1, (s->roSpecCount - i - 1) * sizeof(*ro));
+      s->roSpecCount--;
+      if ((NULL != running) && (running > ro))
+      {
+        s->running = running - 1;
+      }
+      continue;
+    }
+    i++;
+  }
+  emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+}
+
+/**
+ * Minimal copy of a ROSpec for GET_ROSPECS, enough for a client to
+ * find and stop the ones that are running.
+ **/
+static LLRP_tSROSpec *
+emu_describeROSpec(EmuSession *s, const EmuROSpec *ro)
+{
+  LLRP_tSROSpec *pROSpec;
+  LLRP_tSROBoundarySpec *pBoundary;
+  LLRP_tSROSpecStartTrigger *pStart;
+  LLRP_tSROSpecStopTrigger *pStop;
+  LLRP_tSAISpec *pAISpec;
+  LLRP_tSAISpecStopTrigger *pAIStop;
+  LLRP_tSInventoryParameterSpec *pInv;
+  llrp_u16v_t antennas;
+  uint8_t i;
+
+  (void)s;
+  pROSpec = LLRP_ROSpec_construct();
+  LLRP_ROSpec_setROSpecID(pROSpec, ro->id);
+  LLRP_ROSpec_setCurrentState(pROSpec, ro->state);
+
+  pBoundary = LLRP_ROBoundarySpec_construct();
+  pStart = LLRP_ROSpecStartTrigger_construct();
+  LLRP_ROSpecStartTrigger_setROSpecStartTriggerType(pStart, ro->startTrigger);
+  if (LLRP_ROSpecStartTriggerType_Periodic == ro->startTrigger)
+  {
+    LLRP_tSPeriodicTriggerValue *pPeriodic = LLRP_PeriodicTriggerValue_construct();
+
+    LLRP_PeriodicTriggerValue_setOffset(pPeriodic, ro->offsetMs);
+    LLRP_PeriodicTriggerValue_setPeriod(pPeriodic, ro->periodMs);
+    LLRP_ROSpecStartTrigger_setPeriodicTriggerValue(pStart, pPeriodic);
+  }
+  LLRP_ROBoundarySpec_setROSpecStartTrigger(pBoundary, pStart);
+  pStop = LLRP_ROSpecStopTrigger_construct();
+  LLRP_ROSpecStopTrigger_setROSpecStopTriggerType(pStop, LLRP_ROSpecStopTriggerType_Null);
+  LLRP_ROBoundarySpec_setROSpecStopTrigger(pBoundary, pStop);
+  LLRP_ROSpec_setROBoundarySpec(pROSpec, pBoundary);
+
+  pAISpec = LLRP_AISpec_construct();
+  antennas = LLRP_u16v_construct(ro->antennaCount);
+  for (i = 0; i < ro->antennaCount; i++)
+  {
+    antennas.pValue[i] = ro->antennas[i];
+  }
+  LLRP_AISpec_setAntennaIDs(pAISpec, antennas);
+  pAIStop = LLRP_AISpecStopTrigger_construct();
+  if (0 != ro->durationMs)
+  {
+    LLRP_AISpecStopTrigger_setAISpecStopTriggerType(pAIStop, LLRP_AISpecStopTriggerType_Duration);
+    LLRP_AISpecStopTrigger_setDurationTrigger(pAIStop, ro->durationMs);
+  }
+  else
+  {
+    LLRP_AISpecStopTrigger_setAISpecStopTriggerType(pAIStop, LLRP_AISpecStopTriggerType_Null);
+  }
+  LLRP_AISpec_setAISpecStopTrigger(pAISpec, pAIStop);
+  pInv = LLRP_InventoryParameterSpec_construct();
+  LLRP_InventoryParameterSpec_setInventoryParameterSpecID(pInv, 1);
+  LLRP_InventoryParameterSpec_setProtocolID(pInv, LLRP_AirProtocols_EPCGlobalClass1Gen2);
+  LLRP_AISpec_addInventoryParameterSpec(pAISpec, pInv);
+  LLRP_ROSpec_addSpecParameter(pROSpec, &pAISpec->hdr);
+
+  return pROSpec;
+}
+
+static void
+emu_getROSpecs(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  LLRP_tSGET_ROSPECS_RESPONSE *pRsp;
+  uint8_t i;
+
+  pRsp = (LLRP_tSGET_ROSPECS_RESPONSE *)emu_response(pMsg, LLRP_StatusCode_M_Success, NULL);
+  for (i = 0; i < s->roSpecCount; i++)
+  {
+    LLRP_GET_ROSPECS_RESPONSE_addROSpec(pRsp, emu_describeROSpec(s, &s->roSpecs[i]));
+  }
+  emu_send(s, &pRsp->hdr);
+}
+
+static EmuAccessSpec *
+emu_findAccessSpec(EmuSession *s, uint32_t id)
+{
+  uint8_t i;
+
+  for (i = 0; i < s->accessSpecCount; i++)
+  {
+    if (s->accessSpecs[i].id == id)
+    {
+      return &s->accessSpecs[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+emu_addAccessSpec(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  LLRP_tSAccessSpec *pSpec;
+  LLRP_tSParameter *pOp;
+  EmuAccessSpec *spec;
+
+  pSpec = ((LLRP_tSADD_ACCESSSPEC *)pMsg)->pAccessSpec;
+  if ((NULL == pSpec) || (NULL == pSpec->pAccessCommand))
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_MissingParameter, "Incomplete AccessSpec");
+    return;
+  }
+  if ((0 == pSpec->AccessSpecID) || (NULL != emu_findAccessSpec(s, pSpec->AccessSpecID)))
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "Invalid AccessSpecID");
+    return;
+  }
+  if (EMU_MAX_ACCESSSPECS == s->accessSpecCount)
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_A_OutOfRange, "Too many AccessSpecs");
+    return;
+  }
+
+  spec = &s->accessSpecs[s->accessSpecCount];
+  memset(spec, 0, sizeof(*spec));
+  spec->id = pSpec->AccessSpecID;
+  spec->antennaId = pSpec->AntennaID;
+  spec->roSpecId = pSpec->ROSpecID;
+  spec->enabled = (LLRP_AccessSpecState_Active == pSpec->eCurrentState);
+
+  for (pOp = pSpec->pAccessCommand->listAccessCommandOpSpec; NULL != pOp;
+       pOp = pOp->pNextSubParameter)
+  {
+    const LLRP_tSTypeDescriptor *pType = pOp->elementHdr.pType;
+    EmuOpSpec *op;
+
+    if (EMU_MAX_OPSPECS == spec->opSpecCount)
+    {
+      emu_respond(s, pMsg, LLRP_StatusCode_A_OutOfRange, "Too many OpSpecs");
+      return;
+    }
+    op = &spec->opSpecs[spec->opSpecCount];
+    op->pType = pType;
+    if (&LLRP_tdC1G2Read == pType)
+    {
+      LLRP_tSC1G2Read *p = (LLRP_tSC1G2Read *)pOp;
+
+      op->opSpecId = p->OpSpecID;
+      op->bank = p->MB;
+      op->wordPointer = p->WordPointer;
+      op->wordCount = p->WordCount;
+    }
+    else if (&LLRP_tdC1G2Write == pType)
+    {
+      LLRP_tSC1G2Write *p = (LLRP_tSC1G2Write *)pOp;
+
+      op->opSpecId = p->OpSpecID;
+      op->wordCount = p->WriteData.nValue;
+    }
+    else if (&LLRP_tdC1G2BlockWrite == pType)
+    {
+      LLRP_tSC1G2BlockWrite *p = (LLRP_tSC1G2BlockWrite *)pOp;
+
+      op->opSpecId = p->OpSpecID;
+      op->wordCount = p->WriteData.nValue;
+    }
+    else if (&LLRP_tdC1G2BlockErase == pType)
+    {
+      op->opSpecId = ((LLRP_tSC1G2BlockErase *)pOp)->OpSpecID;
+    }
+    else if (&LLRP_tdC1G2Lock == pType)
+    {
+      op->opSpecId = ((LLRP_tSC1G2Lock *)pOp)->OpSpecID;
+    }
+    else if (&LLRP_tdC1G2Kill == pType)
+    {
+      op->opSpecId = ((LLRP_tSC1G2Kill *)pOp)->OpSpecID;
+    }
+    else
+    {
+      /* Custom OpSpecs are accepted, but produce no result */
+      continue;
+    }
+    spec->opSpecCount++;
+  }
+
+  s->accessSpecCount++;
+  emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+}
+
+/**
+ * Apply an AccessSpec message to one AccessSpec, or to all when the ID
+ * is 0
+ **/
+static void
+emu_accessSpecCommand(EmuSession *s, LLRP_tSMessage *pMsg, uint32_t id)
+{
+  const LLRP_tSTypeDescriptor *pType;
+  uint8_t i;
+
+  pType = pMsg->elementHdr.pType;
+  if ((0 != id) && (NULL == emu_findAccessSpec(s, id)))
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_FieldError, "No such AccessSpec");
+    return;
+  }
+
+  for (i = 0; i < s->accessSpecCount; )
+  {
+    EmuAccessSpec *spec = &s->accessSpecs[i];
+
+    if ((0 != id) && (spec->id != id))
+    {
+      i++;
+      continue;
+    }
+    if (&LLRP_tdDELETE_ACCESSSPEC == pType)
+    {
+      memmove(spec, spec + 1, (s->accessSpecCount - i - 1) * sizeof(*spec));
+      s->accessSpecCount--;
+      continue;
+    }
+    spec->enabled = (&LLRP_tdENABLE_ACCESSSPEC == pType);
+    i++;
+  }
+  emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+}
+
+static void
+emu_getCapabilities(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  const TMR_LLRP_EmulatorConfig *config;
+  LLRP_tSGET_READER_CAPABILITIES *pCmd;
+  LLRP_tSGET_READER_CAPABILITIES_RESPONSE *pRsp;
+  LLRP_tEGetReaderCapabilitiesRequestedData requested;
+  LLRP_tSParameter *pCustom;
+
+  config = &s->emu->config;
+  pCmd = (LLRP_tSGET_READER_CAPABILITIES *)pMsg;
+  requested = pCmd->eRequestedData;
+
+  /* ThingMagic capabilities are requested through custom parameters */
+  for (pCustom = pCmd->listCustom; NULL != pCustom; pCustom = pCustom->pNextSubParameter)
+  {
+    if ((&LLRP_tdThingMagicDeviceControlCapabilities != pCustom->elementHdr.pType)
+        || (LLRP_ThingMagicControlCapabilities_DeviceProtocolCapabilities !=
+            ((LLRP_tSThingMagicDeviceControlCapabilities *)pCustom)->eRequestedData))
+    {
+      emu_respond(s, pMsg, LLRP_StatusCode_M_UnsupportedParameter, "Unsupported custom capability");
+      return;
+    }
+  }
+
+  pRsp = (LLRP_tSGET_READER_CAPABILITIES_RESPONSE *)emu_response(pMsg, LLRP_StatusCode_M_Success, NULL);
+
+  if ((LLRP_GetReaderCapabilitiesRequestedData_All == requested)
+      || (LLRP_GetReaderCapabilitiesRequestedData_General_Device_Capabilities == requested))
+  {
+    LLRP_tSGeneralDeviceCapabilities *pGeneral;
+    llrp_utf8v_t version;
+
+    pGeneral = LLRP_GeneralDeviceCapabilities_construct();
+    LLRP_GeneralDeviceCapabilities_setMaxNumberOfAntennaSupported(pGeneral, config->antennaCount);
+    LLRP_GeneralDeviceCapabilities_setCanSetAntennaProperties(pGeneral, 0);
+    LLRP_GeneralDeviceCapabilities_setHasUTCClockCapability(pGeneral, 1);
+    LLRP_GeneralDeviceCapabilities_setDeviceManufacturerName(pGeneral, TM_MANUFACTURER_ID);
+    LLRP_GeneralDeviceCapabilities_setModelName(pGeneral, TMR_LLRP_MODEL_M6);
+    version = LLRP_utf8v_construct((uint16_t)strlen(EMU_FIRMWARE_VERSION));
+    memcpy(version.pValue, EMU_FIRMWARE_VERSION, strlen(EMU_FIRMWARE_VERSION));
+    LLRP_GeneralDeviceCapabilities_setReaderFirmwareVersion(pGeneral, version);
+
+    {
+      LLRP_tSReceiveSensitivityTableEntry *pSensitivity;
+      LLRP_tSGPIOCapabilities *pGpio;
+      uint16_t i;
+
+      pSensitivity = LLRP_ReceiveSensitivityTableEntry_construct();
+      LLRP_ReceiveSensitivityTableEntry_setIndex(pSensitivity, 1);
+      LLRP_ReceiveSensitivityTableEntry_setReceiveSensitivityValue(pSensitivity, 0);
+      LLRP_GeneralDeviceCapabilities_addReceiveSensitivityTableEntry(pGeneral, pSensitivity);
+
+      pGpio = LLRP_GPIOCapabilities_construct();
+      LLRP_GPIOCapabilities_setNumGPIs(pGpio, 0);
+      LLRP_GPIOCapabilities_setNumGPOs(pGpio, 0);
+      LLRP_GeneralDeviceCapabilities_setGPIOCapabilities(pGeneral, pGpio);
+
+      for (i = 1; i <= config->antennaCount; i++)
+      {
+        LLRP_tSPerAntennaAirProtocol *pAirProtocol;
+        llrp_u8v_t protocols;
+
+        pAirProtocol = LLRP_PerAntennaAirProtocol_construct();
+        LLRP_PerAntennaAirProtocol_setAntennaID(pAirProtocol, i);
+        protocols = LLRP_u8v_construct(1);
+        protocols.pValue[0] = LLRP_AirProtocols_EPCGlobalClass1Gen2;
+        LLRP_PerAntennaAirProtocol_setProtocolID(pAirProtocol, protocols);
+        LLRP_GeneralDeviceCapabilities_addPerAntennaAirProtocol(pGeneral, pAirProtocol);
+      }
+    }
+    LLRP_GET_READER_CAPABILITIES_RESPONSE_setGeneralDeviceCapabilities(pRsp, pGeneral);
+  }
+
+  if ((LLRP_GetReaderCapabilitiesRequestedData_All == requested)
+      || (LLRP_GetReaderCapabilitiesRequestedData_LLRP_Capabilities == requested))
+  {
+    LLRP_tSLLRPCapabilities *pLlrp;
+
+    pLlrp = LLRP_LLRPCapabilities_construct();
+    LLRP_LLRPCapabilities_setSupportsEventAndReportHolding(pLlrp, 1);
+    LLRP_LLRPCapabilities_setMaxNumPriorityLevelsSupported(pLlrp, 1);
+    LLRP_LLRPCapabilities_setMaxNumROSpecs(pLlrp, EMU_MAX_ROSPECS);
+    LLRP_LLRPCapabilities_setMaxNumSpecsPerROSpec(pLlrp, 1);
+    LLRP_LLRPCapabilities_setMaxNumInventoryParameterSpecsPerAISpec(pLlrp, 1);
+    LLRP_LLRPCapabilities_setMaxNumAccessSpecs(pLlrp, EMU_MAX_ACCESSSPECS);
+    LLRP_LLRPCapabilities_setMaxNumOpSpecsPerAccessSpec(pLlrp, EMU_MAX_OPSPECS);
+    LLRP_GET_READER_CAPABILITIES_RESPONSE_setLLRPCapabilities(pRsp, pLlrp);
+  }
+
+  if ((LLRP_GetReaderCapabilitiesRequestedData_All == requested)
+      || (LLRP_GetReaderCapabilitiesRequestedData_Regulatory_Capabilities == requested))
+  {
+    LLRP_tSRegulatoryCapabilities *pRegulatory;
+    LLRP_tSUHFBandCapabilities *pBand;
+    LLRP_tSFrequencyInformation *pFreqInfo;
+    LLRP_tSFrequencyHopTable *pHop;
+    LLRP_tSC1G2UHFRFModeTable *pModeTable;
+    llrp_u32v_t frequencies;
+    static const uint32_t blf[] = { 250000, 640000, 320000 };
+    uint16_t i;
+
+    pRegulatory = LLRP_RegulatoryCapabilities_construct();
+    LLRP_RegulatoryCapabilities_setCountryCode(pRegulatory, 840);
+    LLRP_RegulatoryCapabilities_setCommunicationsStandard(pRegulatory,
+        LLRP_CommunicationsStandard_US_FCC_Part_15);
+    pBand = LLRP_UHFBandCapabilities_construct();
+
+    /* 5 to 31.5 dBm in 0.5 dB steps */
+    for (i = 0; i <= 53; i++)
+    {
+      LLRP_tSTransmitPowerLevelTableEntry *pEntry = LLRP_TransmitPowerLevelTableEntry_construct();
+
+      LLRP_TransmitPowerLevelTableEntry_setIndex(pEntry, (uint16_t)(i + 1));
+      LLRP_TransmitPowerLevelTableEntry_setTransmitPowerValue(pEntry, (llrp_s16_t)(500 + (i * 50)));
+      LLRP_UHFBandCapabilities_addTransmitPowerLevelTableEntry(pBand, pEntry);
+    }
+
+    pFreqInfo = LLRP_FrequencyInformation_construct();
+    LLRP_FrequencyInformation_setHopping(pFreqInfo, 1);
+    pHop = LLRP_FrequencyHopTable_construct();
+    LLRP_FrequencyHopTable_setHopTableID(pHop, 1);
+    frequencies = LLRP_u32v_construct(EMU_HOP_TABLE_SIZE);
+    for (i = 0; i < EMU_HOP_TABLE_SIZE; i++)
+    {
+      frequencies.pValue[i] = 902750 + (i * 500);
+    }
+    LLRP_FrequencyHopTable_setFrequency(pHop, frequencies);
+    LLRP_FrequencyInformation_addFrequencyHopTable(pFreqInfo, pHop);
+    LLRP_UHFBandCapabilities_setFrequencyInformation(pBand, pFreqInfo);
+
+    pModeTable = LLRP_C1G2UHFRFModeTable_construct();
+    for (i = 0; i < sizeof(blf) / sizeof(blf[0]); i++)
+    {
+      LLRP_tSC1G2UHFRFModeTableEntry *pMode = LLRP_C1G2UHFRFModeTableEntry_construct();
+
+      LLRP_C1G2UHFRFModeTableEntry_setModeIdentifier(pMode, i);
+      LLRP_C1G2UHFRFModeTableEntry_setDRValue(pMode, LLRP_C1G2DRValue_DRV_64_3);
+      LLRP_C1G2UHFRFModeTableEntry_setEPCHAGTCConformance(pMode, 0);
+      LLRP_C1G2UHFRFModeTableEntry_setMValue(pMode, LLRP_C1G2MValue_MV_4);
+      LLRP_C1G2UHFRFModeTableEntry_setForwardLinkModulation(pMode, LLRP_C1G2ForwardLinkModulation_PR_ASK);
+      LLRP_C1G2UHFRFModeTableEntry_setSpectralMaskIndicator(pMode, LLRP_C1G2SpectralMaskIndicator_MI);
+      LLRP_C1G2UHFRFModeTableEntry_setBDRValue(pMode, blf[i]);
+      LLRP_C1G2UHFRFModeTableEntry_setPIEValue(pMode, 2000);
+      LLRP_C1G2UHFRFModeTableEntry_setMinTariValue(pMode, 6250);
+      LLRP_C1G2UHFRFModeTableEntry_setMaxTariValue(pMode, 25000);
+      LLRP_C1G2UHFRFModeTableEntry_setStepTariValue(pMode, 0);
+      LLRP_C1G2UHFRFModeTable_addC1G2UHFRFModeTableEntry(pModeTable, pMode);
+    }
+    LLRP_UHFBandCapabilities_addAirProtocolUHFRFModeTable(pBand, &pModeTable->hdr);
+
+    LLRP_RegulatoryCapabilities_setUHFBandCapabilities(pRegulatory, pBand);
+    LLRP_GET_READER_CAPABILITIES_RESPONSE_setRegulatoryCapabilities(pRsp, pRegulatory);
+  }
+
+  if (NULL != pCmd->listCustom)
+  {
+    LLRP_tSDeviceProtocolCapabilities *pProtocols;
+    LLRP_tSSupportedProtocols *pGen2;
+
+    pProtocols = LLRP_DeviceProtocolCapabilities_construct();
+    pGen2 = LLRP_SupportedProtocols_construct();
+    LLRP_SupportedProtocols_setProtocol(pGen2, (LLRP_tEProtocolID)TMR_TAG_PROTOCOL_GEN2);
+    LLRP_DeviceProtocolCapabilities_addSupportedProtocols(pProtocols, pGen2);
+    LLRP_GET_READER_CAPABILITIES_RESPONSE_addCustom(pRsp, &pProtocols->hdr);
+  }
+
+  emu_send(s, &pRsp->hdr);
+}
+
+static void
+emu_getConfig(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  const TMR_LLRP_EmulatorConfig *config;
+  LLRP_tSGET_READER_CONFIG *pCmd;
+  LLRP_tSGET_READER_CONFIG_RESPONSE *pRsp;
+  LLRP_tEGetReaderConfigRequestedData requested;
+  LLRP_tSParameter *pCustom;
+  bool all;
+
+  config = &s->emu->config;
+  pCmd = (LLRP_tSGET_READER_CONFIG *)pMsg;
+  requested = pCmd->eRequestedData;
+  all = (LLRP_GetReaderConfigRequestedData_All == requested);
+
+  for (pCustom = pCmd->listCustom; NULL != pCustom; pCustom = pCustom->pNextSubParameter)
+  {
+    LLRP_tEThingMagicControlConfiguration data;
+
+    if (&LLRP_tdThingMagicDeviceControlConfiguration != pCustom->elementHdr.pType)
+    {
+      emu_respond(s, pMsg, LLRP_StatusCode_M_UnsupportedParameter, "Unsupported custom configuration");
+      return;
+    }
+    data = ((LLRP_tSThingMagicDeviceControlConfiguration *)pCustom)->eRequestedData;
+    if ((LLRP_ThingMagicControlConfiguration_ThingMagicRegionConfiguration != data)
+        && (LLRP_ThingMagicControlConfiguration_ThingMagicDeDuplication != data)
+        && (LLRP_ThingMagicControlConfiguration_ThingMagicAsyncOFFTime != data))
+    {
+      emu_respond(s, pMsg, LLRP_StatusCode_M_UnsupportedParameter, "Unsupported custom configuration");
+      return;
+    }
+  }
+
+  pRsp = (LLRP_tSGET_READER_CONFIG_RESPONSE *)emu_response(pMsg, LLRP_StatusCode_M_Success, NULL);
+
+  if (all || (LLRP_GetReaderConfigRequestedData_Identification == requested))
+  {
+    LLRP_tSIdentification *pId;
+    llrp_u8v_t mac;
+
+    pId = LLRP_Identification_construct();
+    LLRP_Identification_setIDType(pId, LLRP_IdentificationType_MAC_Address);
+    mac = LLRP_u8v_construct(6);
+    mac.pValue[0] = 0x00;
+    mac.pValue[1] = 0x17;
+    mac.pValue[2] = 0x9E;
+    mac.pValue[3] = (uint8_t)(s->readerIndex >> 16);
+    mac.pValue[4] = (uint8_t)(s->readerIndex >> 8);
+    mac.pValue[5] = (uint8_t)s->readerIndex;
+    LLRP_Identification_setReaderID(pId, mac);
+    LLRP_GET_READER_CONFIG_RESPONSE_setIdentification(pRsp, pId);
+  }
+
+  if (all || (LLRP_GetReaderConfigRequestedData_AntennaProperties == requested))
+  {
+    uint8_t i;
+
+    for (i = 1; i <= config->antennaCount; i++)
+    {
+      LLRP_tSAntennaProperties *pAnt;
+
+      if ((0 != pCmd->AntennaID) && (i != pCmd->AntennaID))
+      {
+        continue;
+      }
+      pAnt = LLRP_AntennaProperties_construct();
+      LLRP_AntennaProperties_setAntennaConnected(pAnt, 1);
+      LLRP_AntennaProperties_setAntennaID(pAnt, i);
+      LLRP_AntennaProperties_setAntennaGain(pAnt, 0);
+      LLRP_GET_READER_CONFIG_RESPONSE_addAntennaProperties(pRsp, pAnt);
+    }
+  }
+
+  if (all || (LLRP_GetReaderConfigRequestedData_ReaderEventNotificationSpec == requested))
+  {
+    LLRP_tSReaderEventNotificationSpec *pSpec;
+    LLRP_tSEventNotificationState *pState;
+
+    pSpec = LLRP_ReaderEventNotificationSpec_construct();
+    pState = LLRP_EventNotificationState_construct();
+    LLRP_EventNotificationState_setEventType(pState, LLRP_NotificationEventType_ROSpec_Event);
+    LLRP_EventNotificationState_setNotificationState(pState, s->roSpecEvents ? 1 : 0);
+    LLRP_ReaderEventNotificationSpec_addEventNotificationState(pSpec, pState);
+    LLRP_GET_READER_CONFIG_RESPONSE_setReaderEventNotificationSpec(pRsp, pSpec);
+  }
+
+  if (all || (LLRP_GetReaderConfigRequestedData_KeepaliveSpec == requested))
+  {
+    LLRP_tSKeepaliveSpec *pKeepalive;
+
+    pKeepalive = LLRP_KeepaliveSpec_construct();
+    LLRP_KeepaliveSpec_setKeepaliveTriggerType(pKeepalive, (0 == s->keepaliveMs)
+        ? LLRP_KeepaliveTriggerType_Null : LLRP_KeepaliveTriggerType_Periodic);
+    LLRP_KeepaliveSpec_setPeriodicTriggerValue(pKeepalive, s->keepaliveMs);
+    LLRP_GET_READER_CONFIG_RESPONSE_setKeepaliveSpec(pRsp, pKeepalive);
+  }
+
+  if (all || (LLRP_GetReaderConfigRequestedData_EventsAndReports == requested))
+  {
+    LLRP_tSEventsAndReports *pEvents;
+
+    pEvents = LLRP_EventsAndReports_construct();
+    LLRP_EventsAndReports_setHoldEventsAndReportsUponReconnect(pEvents, s->holdEvents ? 1 : 0);
+    LLRP_GET_READER_CONFIG_RESPONSE_setEventsAndReports(pRsp, pEvents);
+  }
+
+  for (pCustom = pCmd->listCustom; NULL != pCustom; pCustom = pCustom->pNextSubParameter)
+  {
+    switch (((LLRP_tSThingMagicDeviceControlConfiguration *)pCustom)->eRequestedData)
+    {
+      case LLRP_ThingMagicControlConfiguration_ThingMagicRegionConfiguration:
+        {
+          LLRP_tSThingMagicRegionConfiguration *pRegion;
+
+          pRegion = LLRP_ThingMagicRegionConfiguration_construct();
+          LLRP_ThingMagicRegionConfiguration_setRegionID(pRegion, s->region);
+          LLRP_GET_READER_CONFIG_RESPONSE_addCustom(pRsp, &pRegion->hdr);
+          break;
+        }
+
+      case LLRP_ThingMagicControlConfiguration_ThingMagicDeDuplication:
+        {
+          LLRP_tSThingMagicDeDuplication *pDedup;
+
+          pDedup = LLRP_ThingMagicDeDuplication_construct();
+          LLRP_ThingMagicDeDuplication_setRecordHighestRSSI(pDedup, s->dedupHighestRssi ? 1 : 0);
+          LLRP_ThingMagicDeDuplication_setUniqueByAntenna(pDedup, s->dedupByAntenna ? 1 : 0);
+          LLRP_ThingMagicDeDuplication_setUniqueByData(pDedup, s->dedupByData ? 1 : 0);
+          LLRP_GET_READER_CONFIG_RESPONSE_addCustom(pRsp, &pDedup->hdr);
+          break;
+        }
+
+      default:
+        {
+          LLRP_tSThingMagicAsyncOFFTime *pOffTime;
+
+          pOffTime = LLRP_ThingMagicAsyncOFFTime_construct();
+          LLRP_ThingMagicAsyncOFFTime_setAsyncOFFTime(pOffTime, s->asyncOffTime);
+          LLRP_GET_READER_CONFIG_RESPONSE_addCustom(pRsp, &pOffTime->hdr);
+          break;
+        }
+    }
+  }
+
+  emu_send(s, &pRsp->hdr);
+}
+
+static void
+emu_setConfig(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  LLRP_tSSET_READER_CONFIG *pCmd;
+  LLRP_tSParameter *pCustom;
+
+  pCmd = (LLRP_tSSET_READER_CONFIG *)pMsg;
+
+  if (pCmd->ResetToFactoryDefault)
+  {
+    s->keepaliveMs = 0;
+    s->roSpecEvents = false;
+    s->holdEvents = false;
+  }
+
+  if (NULL != pCmd->pKeepaliveSpec)
+  {
+    if (LLRP_KeepaliveTriggerType_Periodic == pCmd->pKeepaliveSpec->eKeepaliveTriggerType)
+    {
+      s->keepaliveMs = pCmd->pKeepaliveSpec->PeriodicTriggerValue;
+      s->nextKeepaliveUs = emu_nowUs() + ((uint64_t)s->keepaliveMs * 1000);
+    }
+    else
+    {
+      s->keepaliveMs = 0;
+    }
+  }
+
+  if (NULL != pCmd->pReaderEventNotificationSpec)
+  {
+    LLRP_tSEventNotificationState *pState;
+
+    for (pState = pCmd->pReaderEventNotificationSpec->listEventNotificationState;
+         NULL != pState;
+         pState = (LLRP_tSEventNotificationState *)pState->hdr.pNextSubParameter)
+    {
+      if (LLRP_NotificationEventType_ROSpec_Event == pState->eEventType)
+      {
+        s->roSpecEvents = (0 != pState->NotificationState);
+      }
+    }
+  }
+
+  if (NULL != pCmd->pEventsAndReports)
+  {
+    s->holdEvents = (0 != pCmd->pEventsAndReports->HoldEventsAndReportsUponReconnect);
+  }
+
+  /* Other custom configuration is accepted and ignored */
+  for (pCustom = pCmd->listCustom; NULL != pCustom; pCustom = pCustom->pNextSubParameter)
+  {
+    if (&LLRP_tdThingMagicRegionConfiguration == pCustom->elementHdr.pType)
+    {
+      s->region = ((LLRP_tSThingMagicRegionConfiguration *)pCustom)->eRegionID;
+    }
+    else if (&LLRP_tdThingMagicDeDuplication == pCustom->elementHdr.pType)
+    {
+      LLRP_tSThingMagicDeDuplication *pDedup = (LLRP_tSThingMagicDeDuplication *)pCustom;
+
+      s->dedupHighestRssi = (0 != pDedup->RecordHighestRSSI);
+      s->dedupByAntenna = (0 != pDedup->UniqueByAntenna);
+      s->dedupByData = (0 != pDedup->UniqueByData);
+    }
+    else if (&LLRP_tdThingMagicAsyncOFFTime == pCustom->elementHdr.pType)
+    {
+      s->asyncOffTime = ((LLRP_tSThingMagicAsyncOFFTime *)pCustom)->AsyncOFFTime;
+    }
+  }
+
+  emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+}
+
+static void
+emu_handleMessage(EmuSession *s, LLRP_tSMessage *pMsg)
+{
+  const LLRP_tSTypeDescriptor *pType;
+
+  pType = pMsg->elementHdr.pType;
+  s->stats.messagesReceived++;
+
+  if (&LLRP_tdGET_READER_CAPABILITIES == pType)
+  {
+    emu_getCapabilities(s, pMsg);
+  }
+  else if (&LLRP_tdGET_READER_CONFIG == pType)
+  {
+    emu_getConfig(s, pMsg);
+  }
+  else if (&LLRP_tdSET_READER_CONFIG == pType)
+  {
+    emu_setConfig(s, pMsg);
+  }
+  else if (&LLRP_tdADD_ROSPEC == pType)
+  {
+    emu_addROSpec(s, pMsg);
+  }
+  else if (&LLRP_tdGET_ROSPECS == pType)
+  {
+    emu_getROSpecs(s, pMsg);
+  }
+  else if (&LLRP_tdENABLE_ROSPEC == pType)
+  {
+    emu_roSpecCommand(s, pMsg, ((LLRP_tSENABLE_ROSPEC *)pMsg)->ROSpecID);
+  }
+  else if (&LLRP_tdDISABLE_ROSPEC == pType)
+  {
+    emu_roSpecCommand(s, pMsg, ((LLRP_tSDISABLE_ROSPEC *)pMsg)->ROSpecID);
+  }
+  else if (&LLRP_tdDELETE_ROSPEC == pType)
+  {
+    emu_roSpecCommand(s, pMsg, ((LLRP_tSDELETE_ROSPEC *)pMsg)->ROSpecID);
+  }
+  else if (&LLRP_tdSTART_ROSPEC == pType)
+  {
+    emu_roSpecCommand(s, pMsg, ((LLRP_tSSTART_ROSPEC *)pMsg)->ROSpecID);
+  }
+  else if (&LLRP_tdSTOP_ROSPEC == pType)
+  {
+    emu_roSpecCommand(s, pMsg, ((LLRP_tSSTOP_ROSPEC *)pMsg)->ROSpecID);
+  }
+  else if (&LLRP_tdADD_ACCESSSPEC == pType)
+  {
+    emu_addAccessSpec(s, pMsg);
+  }
+  else if (&LLRP_tdENABLE_ACCESSSPEC == pType)
+  {
+    emu_accessSpecCommand(s, pMsg, ((LLRP_tSENABLE_ACCESSSPEC *)pMsg)->AccessSpecID);
+  }
+  else if (&LLRP_tdDISABLE_ACCESSSPEC == pType)
+  {
+    emu_accessSpecCommand(s, pMsg, ((LLRP_tSDISABLE_ACCESSSPEC *)pMsg)->AccessSpecID);
+  }
+  else if (&LLRP_tdDELETE_ACCESSSPEC == pType)
+  {
+    emu_accessSpecCommand(s, pMsg, ((LLRP_tSDELETE_ACCESSSPEC *)pMsg)->AccessSpecID);
+  }
+  else if (&LLRP_tdGET_REPORT == pType)
+  {
+    emu_flushReports(s);
+  }
+  else if ((&LLRP_tdENABLE_EVENTS_AND_REPORTS == pType)
+           || (&LLRP_tdKEEPALIVE_ACK == pType))
+  {
+    /* No response */
+  }
+  else if (&LLRP_tdCLOSE_CONNECTION == pType)
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_Success, NULL);
+    s->closing = true;
+  }
+  else
+  {
+    emu_respond(s, pMsg, LLRP_StatusCode_M_UnsupportedMessage, "Not emulated");
+  }
+}
+
+static void *
+emu_sessionThread(void *arg)
+{
+  EmuSession *s;
+  const TMR_LLRP_EmulatorConfig *config;
+  uint32_t slots;
+  uint32_t i;
+  sigset_t sigs;
+
+  s = arg;
+  config = &s->emu->config;
+
+  /* A client that disconnects mid-write must not kill the host process */
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &sigs, NULL);
+
+  slots = config->tagCount * config->antennaCount;
+  s->pending = malloc(slots * sizeof(*s->pending));
+  s->pendingIndex = malloc(slots * sizeof(*s->pendingIndex));
+  if ((NULL == s->pending) || (NULL == s->pendingIndex))
+  {
+    s->closing = true;
+  }
+  else
+  {
+    for (i = 0; i < slots; i++)
+    {
+      s->pendingIndex[i] = -1;
+    }
+    emu_sendConnectionEvent(s);
+  }
+
+  while ((false == s->closing) && (false == s->emu->stopping))
+  {
+    LLRP_tSMessage *pMsg;
+    int waitMs;
+    uint64_t now;
+
+    if (NULL != s->running)
+    {
+      waitMs = (0 == config->readRate) ? 0 : EMU_READ_WAIT_MS;
+    }
+    else
+    {
+      waitMs = EMU_IDLE_WAIT_MS;
+    }
+
+    pMsg = LLRP_Conn_recvMessage(s->pConn, waitMs);
+    if (NULL != pMsg)
+    {
+      emu_handleMessage(s, pMsg);
+      LLRP_Element_destruct(&pMsg->elementHdr);
+    }
+    else if (LLRP_RC_RecvTimeout != LLRP_Conn_getRecvError(s->pConn)->eResultCode)
+    {
+      /* Client went away or sent garbage */
+      break;
+    }
+
+    emu_runROSpecs(s);
+
+    now = emu_nowUs();
+    if ((0 != s->keepaliveMs) && (now >= s->nextKeepaliveUs))
+    {
+      emu_send(s, &LLRP_KEEPALIVE_construct()->hdr);
+      s->nextKeepaliveUs = now + ((uint64_t)s->keepaliveMs * 1000);
+    }
+
+    emu_flushStats(s);
+  }
+
+  emu_flushStats(s);
+  LLRP_Conn_closeConnectionToReader(s->pConn);
+  LLRP_Conn_destruct(s->pConn);
+  s->pConn = NULL;
+  free(s->pending);
+  free(s->pendingIndex);
+  s->pending = NULL;
+  s->pendingIndex = NULL;
+
+  pthread_mutex_lock(&s->emu->lock);
+  s->emu->stats.activeSessions--;
+  pthread_mutex_unlock(&s->emu->lock);
+  s->done = true;
+  return NULL;
+}
+
+/**
+ * Join and free the sessions that have ended, or all of them
+ **/
+static void
+emu_reapSessions(TMR_LLRP_Emulator *emu, bool all)
+{
+  EmuSession **link;
+
+  link = &emu->sessions;
+  while (NULL != *link)
+  {
+    EmuSession *s = *link;
+
+    if (all || s->done)
+    {
+      pthread_join(s->thread, NULL);
+      *link = s->next;
+      free(s);
+    }
+    else
+    {
+      link = &s->next;
+    }
+  }
+}
+
+static void
+emu_accept(TMR_LLRP_Emulator *emu, uint32_t readerIndex)
+{
+  EmuSession *s;
+  pthread_attr_t attr;
+  int fd;
+  int flag;
+
+  fd = accept(emu->listenFds[readerIndex], NULL, NULL);
+  if (0 > fd)
+  {
+    return;
+  }
+  flag = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *)&flag, sizeof flag);
+
+  s = calloc(1, sizeof(*s));
+  if (NULL != s)
+  {
+    s->pConn = LLRP_Conn_construct(emu->pTypeRegistry, EMU_FRAME_SIZE);
+  }
+  if ((NULL == s) || (NULL == s->pConn))
+  {
+    free(s);
+    close(fd);
+    return;
+  }
+  s->pConn->fd = fd;
+  s->emu = emu;
+  s->readerIndex = readerIndex;
+  s->random = (emu->config.seed * 2654435761u) ^ (readerIndex + 1);
+  if (0 == s->random)
+  {
+    s->random = 1;
+  }
+  s->region = LLRP_ThingMagicRegionID_NorthAmerica;
+  s->dedupByAntenna = true;
+
+  pthread_mutex_lock(&emu->lock);
+  emu->stats.connections++;
+  emu->stats.activeSessions++;
+  pthread_mutex_unlock(&emu->lock);
+
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, EMU_SESSION_STACK_SIZE);
+  if (0 != pthread_create(&s->thread, &attr, emu_sessionThread, s))
+  {
+    pthread_mutex_lock(&emu->lock);
+    emu->stats.activeSessions--;
+    pthread_mutex_unlock(&emu->lock);
+    LLRP_Conn_closeConnectionToReader(s->pConn);
+    LLRP_Conn_destruct(s->pConn);
+    free(s);
+  }
+  else
+  {
+    s->next = emu->sessions;
+    emu->sessions = s;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+static void *
+emu_acceptThread(void *arg)
+{
+  TMR_LLRP_Emulator *emu;
+  struct pollfd *fds;
+  uint32_t i;
+
+  emu = arg;
+  fds = calloc(emu->listenCount, sizeof(*fds));
+  if (NULL == fds)
+  {
+    return NULL;
+  }
+  for (i = 0; i < emu->listenCount; i++)
+  {
+    fds[i].fd = emu->listenFds[i];
+    fds[i].events = POLLIN;
+  }
+
+  while (false == emu->stopping)
+  {
+    int ready;
+
+    ready = poll(fds, emu->listenCount, 100);
+    for (i = 0; (0 < ready) && (i < emu->listenCount); i++)
+    {
+      if (fds[i].revents & POLLIN)
+      {
+        emu_accept(emu, i);
+        ready--;
+      }
+    }
+    emu_reapSessions(emu, false);
+  }
+
+  emu_reapSessions(emu, true);
+  free(fds);
+  return NULL;
+}
+
+void
+TMR_LLRP_emulatorInitConfig(TMR_LLRP_EmulatorConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  strcpy(config->address, "127.0.0.1");
+  config->port = TMR_LLRP_READER_DEFAULT_PORT;
+  config->readerCount = 1;
+  config->portPerReader = false;
+  config->tagCount = 100;
+  config->epcLength = 12;
+  config->antennaCount = 4;
+  config->readRate = 1000;
+  config->seed = 1;
+}
+
+static void
+emu_free(TMR_LLRP_Emulator *emu)
+{
+  uint32_t i;
+
+  for (i = 0; i < emu->listenCount; i++)
+  {
+    close(emu->listenFds[i]);
+  }
+  free(emu->listenFds);
+  if (NULL != emu->pTypeRegistry)
+  {
+    LLRP_TypeRegistry_destruct(emu->pTypeRegistry);
+  }
+  pthread_mutex_destroy(&emu->lock);
+  free(emu);
+}
+
+TMR_Status
+TMR_LLRP_emulatorStart(TMR_LLRP_Emulator **emulator,
+                       const TMR_LLRP_EmulatorConfig *config)
+{
+  TMR_LLRP_Emulator *emu;
+  struct in_addr base;
+  uint32_t i;
+
+  if ((0 == config->readerCount) || (0 == config->tagCount)
+      || (config->epcLength < 4) || (config->epcLength > 30) || (config->epcLength & 1)
+      || (0 == config->antennaCount) || (config->antennaCount > EMU_MAX_ANTENNAS)
+      || (0 == inet_aton(config->address, &base))
+      || (config->portPerReader && (config->port + config->readerCount - 1 > 0xFFFF)))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  emu = calloc(1, sizeof(*emu));
+  if (NULL == emu)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  emu->config = *config;
+  pthread_mutex_init(&emu->lock, NULL);
+  emu->listenFds = calloc(config->readerCount, sizeof(*emu->listenFds));
+  emu->pTypeRegistry = LLRP_getTheTypeRegistry();
+  if ((NULL == emu->listenFds) || (NULL == emu->pTypeRegistry))
+  {
+    emu_free(emu);
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  LLRP_enrollTmTypesIntoRegistry(emu->pTypeRegistry);
+
+  for (i = 0; i < config->readerCount; i++)
+  {
+    struct sockaddr_in sin;
+    int fd;
+    int flag;
+
+    memset(&sin, 0, sizeof sin);
+    sin.sin_family = AF_INET;
+    if (config->portPerReader)
+    {
+      sin.sin_addr = base;
+      sin.sin_port = htons((uint16_t)(config->port + i));
+    }
+    else
+    {
+      sin.sin_addr.s_addr = htonl(ntohl(base.s_addr) + i);
+      sin.sin_port = htons(config->port);
+    }
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > fd)
+    {
+      emu_free(emu);
+      return TMR_ERROR_COMM_ERRNO(errno);
+    }
+    flag = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void *)&flag, sizeof flag);
+    if ((0 != bind(fd, (struct sockaddr *)&sin, sizeof sin)) || (0 != listen(fd, 8)))
+    {
+      TMR_Status ret = TMR_ERROR_COMM_ERRNO(errno);
+
+      close(fd);
+      emu_free(emu);
+      return ret;
+    }
+    emu->listenFds[emu->listenCount++] = fd;
+  }
+
+  if (0 != pthread_create(&emu->acceptThread, NULL, emu_acceptThread, emu))
+  {
+    emu_free(emu);
+    return TMR_ERROR_NO_THREADS;
+  }
+
+  *emulator = emu;
+  return TMR_SUCCESS;
+}
+
+void
+TMR_LLRP_emulatorGetStats(TMR_LLRP_Emulator *emulator, TMR_LLRP_EmulatorStats *stats)
+{
+  pthread_mutex_lock(&emulator->lock);
+  *stats = emulator->stats;
+  pthread_mutex_unlock(&emulator->lock);
+}
+
+void
+TMR_LLRP_emulatorStop(TMR_LLRP_Emulator *emulator)
+{
+  emulator->stopping = true;
+  pthread_join(emulator->acceptThread, NULL);
+  emu_free(emulator);
+}
@@ -0,0 +1,145 @@
+#ifndef _LLRP_EMULATOR_H
+#define _LLRP_EMULATOR_H
+/**
+ *  @file llrp_emulator.h
+ *  @brief Mercury API - Local LLRP reader emulator
+ *
+ * Emulates ThingMagic LLRP readers on local TCP sockets, for exercising
+ * the LLRP reader client end to end without fixed readers.  Each
+ * emulated reader accepts one client at a time and answers the
+ * messages the client uses: the connect handshake, reader capabilities
+ * and configuration (including the ThingMagic custom parameters read
+ * at boot), ROSpec and AccessSpec management, keep alives, and
+ * RO_ACCESS_REPORT streams generated from a synthetic tag population
+ * at a configured rate.
+ *
+ * Any number of readers can be emulated in one process; each client
+ * connection is served by its own thread.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Emulator configuration, see TMR_LLRP_emulatorInitConfig() for the
+ * defaults.
+ **/
+typedef struct TMR_LLRP_EmulatorConfig
+{
+  /** Listen address (IPv4) of the first reader */
+  char address[32];
+  /** Listen port of the first reader */
+  uint16_t port;
+  /** Number of readers to emulate */
+  uint32_t readerCount;
+  /**
+   * When true, reader N listens on port + N at the same address.
+   * Otherwise reader N listens on the same port at address + N, which
+   * keeps every reader on the default LLRP port so clients enable
+   * keep alives (use the 127.0.0.0/8 loopback range).
+   **/
+  bool portPerReader;
+  /** Number of distinct tags each reader sees */
+  uint32_t tagCount;
+  /** EPC length in bytes (even, 4 to 30) */
+  uint8_t epcLength;
+  /** Number of antenna ports of each reader (1 to 16) */
+  uint8_t antennaCount;
+  /** Tag reads per second generated by each reader, 0 for as fast as possible */
+  uint32_t readRate;
+  /** Random seed, also part of the EPCs */
+  uint32_t seed;
+} TMR_LLRP_EmulatorConfig;
+
+/**
+ * Emulator counters, summed over all readers since the emulator started
+ **/
+typedef struct TMR_LLRP_EmulatorStats
+{
+  /** Client connections accepted */
+  uint32_t connections;
+  /** Client connections currently open */
+  uint32_t activeSessions;
+  /** LLRP messages received from clients */
+  uint64_t messagesReceived;
+  /** LLRP messages sent to clients */
+  uint64_t messagesSent;
+  /** RO_ACCESS_REPORT messages sent */
+  uint64_t reports;
+  /** TagReportData entries sent */
+  uint64_t tagReports;
+  /** Tag reads generated (a TagReportData entry may carry several) */
+  uint64_t tagReads;
+} TMR_LLRP_EmulatorStats;
+
+typedef struct TMR_LLRP_Emulator TMR_LLRP_Emulator;
+
+/**
+ * Fill a configuration with the defaults: one reader at 127.0.0.1 on
+ * the default LLRP port, 100 tags with 12 byte EPCs, 4 antennas and
+ * 1000 reads per second.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_LLRP_emulatorInitConfig(TMR_LLRP_EmulatorConfig *config);
+
+/**
+ * Open the listen sockets of all readers and start serving clients in
+ * background threads.
+ *
+ * @param[out] emulator The running emulator
+ * @param config The emulator configuration
+ * @return TMR_ERROR_INVALID if the configuration is not usable,
+ *         TMR_ERROR_OUT_OF_MEMORY, or a TMR_ERROR_COMM_ERRNO status if
+ *         a listen socket cannot be opened
+ **/
+TMR_Status TMR_LLRP_emulatorStart(TMR_LLRP_Emulator **emulator,
+                                  const TMR_LLRP_EmulatorConfig *config);
+
+/**
+ * Read the emulator counters.
+ *
+ * @param emulator The emulator
+ * @param[out] stats The counters
+ **/
+void TMR_LLRP_emulatorGetStats(TMR_LLRP_Emulator *emulator,
+                               TMR_LLRP_EmulatorStats *stats);
+
+/**
+ * Close all client connections and listen sockets, and free the
+ * emulator.
+ *
+ * @param emulator The emulator
+ **/
+void TMR_LLRP_emulatorStop(TMR_LLRP_Emulator *emulator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LLRP_EMULATOR_H */
@@ -0,0 +1,405 @@
+/**
+ *  @file llrp_mem_pool.c
+ *  @brief Mercury API - LLRP message memory pool
+ */
+
+ /*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "llrp_reader_imp.h"
+
+#ifdef TMR_ENABLE_LLRP_MEM_POOL
+
+/**
+ * LTKC constructs every element and array of a message separately,
+ * so each command and each tag report is a burst of small allocations,
+ * made and released on different threads. Blocks up to the largest
+ * size class are recycled through per reader free lists instead of
+ * going back to the C library.
+ *
+ * Every block carries a header naming the pool it came from, so it can
+ * be released from any thread. The pool used for new allocations is the
+ * one bound to the calling thread by TMR_LLRP_memPoolBind(). Each entry
+ * point of the LLRP reader, and its receiver thread, binds the reader's
+ * pool before constructing any message, so a thread that serves several
+ * readers charges each message to the reader it is for.
+ *
+ * Other threads may still have a pool bound after its reader is
+ * destroyed, so pool structures are never freed. They are retired
+ * and handed to the next reader instead.
+ **/
+
+#define TMR_LLRP_MEMPOOL_NUM_CLASSES 8
+#define TMR_LLRP_MEMPOOL_MIN_SHIFT 4
+#define TMR_LLRP_MEMPOOL_MAX_CACHED 256
+#define TMR_LLRP_MEMPOOL_LARGE 0xFF
+
+typedef union MemPoolHeader
+{
+  struct
+  {
+    struct TMR_LLRP_MemPool *pool;
+    uint32_t size;
+    uint8_t sizeClass;
+  } h;
+  /* Keep the payload aligned for any LTKC element */
+  long double align;
+  union MemPoolHeader *next;
+} MemPoolHeader;
+
+struct TMR_LLRP_MemPool
+{
+  pthread_mutex_t lock;
+  MemPoolHeader *freeList[TMR_LLRP_MEMPOOL_NUM_CLASSES];
+  uint32_t freeCount[TMR_LLRP_MEMPOOL_NUM_CLASSES];
+  bool closing;
+  TMR_LLRP_MemPoolStats stats;
+  struct TMR_LLRP_MemPool *next;
+};
+
+static pthread_once_t memPoolOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t memPoolKey;
+static pthread_mutex_t retiredLock = PTHREAD_MUTEX_INITIALIZER;
+static struct TMR_LLRP_MemPool *retiredPools = NULL;
+
+static uint8_t
+memPoolClass(uint32_t size)
+{
+  uint8_t sizeClass;
+
+  for (sizeClass = 0; sizeClass < TMR_LLRP_MEMPOOL_NUM_CLASSES; sizeClass++)
+  {
+    if (size <= (1U << (sizeClass + TMR_LLRP_MEMPOOL_MIN_SHIFT)))
+    {
+      return sizeClass;
+    }
+  }
+  return TMR_LLRP_MEMPOOL_LARGE;
+}
+
+static void
+memPoolRelease(struct TMR_LLRP_MemPool *pool)
+{
+  MemPoolHeader *hdr;
+  int i;
+
+  for (i = 0; i < TMR_LLRP_MEMPOOL_NUM_CLASSES; i++)
+  {
+    while (NULL != pool->freeList[i])
+    {
+      hdr = pool->freeList[i];
+      pool->freeList[i] = hdr->next;
+      free(hdr);
+    }
+    pool->freeCount[i] = 0;
+  }
+  pool->stats.bytesCached = 0;
+}
+
+static void *
+memPoolAlloc(void *cookie, unsigned int nByte)
+{
+  struct TMR_LLRP_MemPool *pool;
+  MemPoolHeader *hdr;
+  uint8_t sizeClass;
+  uint32_t blockSize;
+
+  pool = pthread_getspecific(memPoolKey);
+  sizeClass = memPoolClass(nByte);
+  blockSize = (TMR_LLRP_MEMPOOL_LARGE == sizeClass) ? nByte :
+              (1U << (sizeClass + TMR_LLRP_MEMPOOL_MIN_SHIFT));
+
+  if (NULL != pool)
+  {
+    pthread_mutex_lock(&pool->lock);
+    if (true == pool->closing)
+    {
+      pthread_mutex_unlock(&pool->lock);
+      pool = NULL;
+    }
+  }
+
+  if (NULL == pool)
+  {
+    hdr = malloc(sizeof(MemPoolHeader) + blockSize);
+    if (NULL == hdr)
+    {
+      return NULL;
+    }
+    hdr->h.pool = NULL;
+    hdr->h.size = blockSize;
+    hdr->h.sizeClass = sizeClass;
+    return hdr + 1;
+  }
+
+  hdr = NULL;
+  if ((TMR_LLRP_MEMPOOL_LARGE != sizeClass) && (NULL != pool->freeList[sizeClass]))
+  {
+    hdr = pool->freeList[sizeClass];
+    pool->freeList[sizeClass] = hdr->next;
+    pool->freeCount[sizeClass]--;
+    pool->stats.bytesCached -= blockSize;
+    pool->stats.poolHits++;
+  }
+  else
+  {
+    hdr = malloc(sizeof(MemPoolHeader) + blockSize);
+    if (NULL == hdr)
+    {
+      pthread_mutex_unlock(&pool->lock);
+      return NULL;
+    }
+    if (TMR_LLRP_MEMPOOL_LARGE == sizeClass)
+    {
+      pool->stats.largeAllocs++;
+    }
+  }
+
+  pool->stats.allocs++;
+  pool->stats.blocksInUse++;
+  pool->stats.bytesInUse += blockSize;
+  if (pool->stats.bytesInUse > pool->stats.peakBytesInUse)
+  {
+    pool->stats.peakBytesInUse = pool->stats.bytesInUse;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  hdr->h.pool = pool;
+  hdr->h.size = blockSize;
+  hdr->h.sizeClass = sizeClass;
+
+  return hdr + 1;
+}
+
+static void
+memPoolFree(void *cookie, void *mem)
+{
+  struct TMR_LLRP_MemPool *pool;
+  MemPoolHeader *hdr;
+  uint8_t sizeClass;
+
+  if (NULL == mem)
+  {
+    return;
+  }
+
+  hdr = (MemPoolHeader *)mem - 1;
+  pool = hdr->h.pool;
+  sizeClass = hdr->h.sizeClass;
+
+  if (NULL == pool)
+  {
+    free(hdr);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stats.frees++;
+  pool->stats.blocksInUse--;
+  pool->stats.bytesInUse -= hdr->h.size;
+
+  if ((false == pool->closing) && (TMR_LLRP_MEMPOOL_LARGE != sizeClass) &&
+      (TMR_LLRP_MEMPOOL_MAX_CACHED > pool->freeCount[sizeClass]))
+  {
+    hdr->next = pool->freeList[sizeClass];
+    pool->freeList[sizeClass] = hdr;
+    pool->freeCount[sizeClass]++;
+    pool->stats.bytesCached += (1U << (sizeClass + TMR_LLRP_MEMPOOL_MIN_SHIFT));
+    hdr = NULL;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (NULL != hdr)
+  {
+    free(hdr);
+  }
+}
+
+static void
+memPoolInstall(void)
+{
+  pthread_key_create(&memPoolKey, NULL);
+  LLRP_setAllocator(memPoolAlloc, memPoolFree, NULL);
+}
+
+#endif /* TMR_ENABLE_LLRP_MEM_POOL */
+
+/**
+ * Create the message memory pool of an LLRP reader
+ *
+ * @param reader The reader
+ */
+TMR_Status
+TMR_LLRP_memPoolCreate(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_LLRP_MEM_POOL
+  struct TMR_LLRP_MemPool *pool;
+
+  pthread_once(&memPoolOnce, memPoolInstall);
+
+  pthread_mutex_lock(&retiredLock);
+  pool = retiredPools;
+  if (NULL != pool)
+  {
+    retiredPools = pool->next;
+  }
+  pthread_mutex_unlock(&retiredLock);
+
+  if (NULL == pool)
+  {
+    pool = calloc(1, sizeof(*pool));
+    if (NULL == pool)
+    {
+      return TMR_ERROR_OUT_OF_MEMORY;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+  }
+  else
+  {
+    /**
+     * Blocks of the previous owner that are still in use
+     * carry on being counted and come back to this pool.
+     **/
+    pthread_mutex_lock(&pool->lock);
+    pool->closing = false;
+    pool->next = NULL;
+    pool->stats.allocs = 0;
+    pool->stats.frees = 0;
+    pool->stats.poolHits = 0;
+    pool->stats.largeAllocs = 0;
+    pool->stats.peakBytesInUse = pool->stats.bytesInUse;
+    pthread_mutex_unlock(&pool->lock);
+  }
+  reader->u.llrpReader.memPool = pool;
+#else
+  reader->u.llrpReader.memPool = NULL;
+#endif
+
+  return TMR_SUCCESS;
+}
+
+/**
+ * Retire the memory pool of an LLRP reader. Blocks still held
+ * by messages are returned to the C library as they are freed.
+ *
+ * @param reader The reader
+ */
+void
+TMR_LLRP_memPoolDestroy(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_LLRP_MEM_POOL
+  struct TMR_LLRP_MemPool *pool;
+
+  pool = reader->u.llrpReader.memPool;
+  if (NULL == pool)
+  {
+    return;
+  }
+  reader->u.llrpReader.memPool = NULL;
+
+  if (pthread_getspecific(memPoolKey) == pool)
+  {
+    pthread_setspecific(memPoolKey, NULL);
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->closing = true;
+  memPoolRelease(pool);
+  pthread_mutex_unlock(&pool->lock);
+
+  pthread_mutex_lock(&retiredLock);
+  pool->next = retiredPools;
+  retiredPools = pool;
+  pthread_mutex_unlock(&retiredLock);
+#endif
+}
+
+/**
+ * Make the reader's pool serve the LTKC allocations of the calling thread
+ *
+ * @param reader The reader
+ */
+void
+TMR_LLRP_memPoolBind(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_LLRP_MEM_POOL
+  if ((NULL != reader->u.llrpReader.memPool) &&
+      (pthread_getspecific(memPoolKey) != reader->u.llrpReader.memPool))
+  {
+    pthread_setspecific(memPoolKey, reader->u.llrpReader.memPool);
+  }
+#endif
+}
+
+/**
+ * Get a snapshot of the pool allocation statistics
+ *
+ * @param reader The reader
+ * @param[out] stats Statistics
+ */
+void
+TMR_LLRP_memPoolGetStats(TMR_Reader *reader, TMR_LLRP_MemPoolStats *stats)
+{
+  memset(stats, 0, sizeof(*stats));
+#ifdef TMR_ENABLE_LLRP_MEM_POOL
+  if (NULL != reader->u.llrpReader.memPool)
+  {
+    struct TMR_LLRP_MemPool *pool = reader->u.llrpReader.memPool;
+
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    pthread_mutex_unlock(&pool->lock);
+  }
+#endif
+}
+
+/**
+ * Return the cached blocks to the C library and clear the counters.
+ * Blocks in use are not affected.
+ *
+ * @param reader The reader
+ */
+void
+TMR_LLRP_memPoolReset(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_LLRP_MEM_POOL
+  if (NULL != reader->u.llrpReader.memPool)
+  {
+    struct TMR_LLRP_MemPool *pool = reader->u.llrpReader.memPool;
+
+    pthread_mutex_lock(&pool->lock);
+    memPoolRelease(pool);
+    pool->stats.allocs = 0;
+    pool->stats.frees = 0;
+    pool->stats.poolHits = 0;
+    pool->stats.largeAllocs = 0;
+    pool->stats.peakBytesInUse = pool->stats.bytesInUse;
+    pthread_mutex_unlock(&pool->lock);
+  }
+#endif
+}
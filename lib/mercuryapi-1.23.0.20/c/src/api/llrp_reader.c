@@ -215,6 +215,19 @@ TMR_LLRP_boot(TMR_Reader *reader)
   BITSET(lr->paramPresent, TMR_PARAM_ISO180006B_BLF);
   BITSET(lr->paramPresent, TMR_PARAM_REGION_SUPPORTEDREGIONS);
   BITSET(lr->paramPresent, TMR_PARAM_READ_ASYNCOFFTIME);
+  BITSET(lr->paramPresent, TMR_PARAM_LLRP_KEEPALIVE_PERIOD);
+  BITSET(lr->paramPresent, TMR_PARAM_LLRP_KEEPALIVE_MISSCOUNT);
+  BITSET(lr->paramPresent, TMR_PARAM_LLRP_AUTORECONNECT);
+  BITSET(lr->paramPresent, TMR_PARAM_LLRP_RECONNECT_TIMEOUT);
+  BITSET(lr->paramPresent, TMR_PARAM_LLRP_CONNECTION_STATS);
+  BITSET(lr->paramPresent, TMR_PARAM_LLRP_MEMPOOL_STATS);
+  BITSET(lr->paramPresent, TMR_PARAM_TAGREADDATA_DEDUPPOLICY);
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  BITSET(lr->paramPresent, TMR_PARAM_PIPELINE_STATS);
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  BITSET(lr->paramPresent, TMR_PARAM_PIPELINE_STATS_PERIOD);
+#endif
+#endif
  
   for (i = 0; i < TMR_PARAMWORDS; i++)
   {
@@ -250,6 +263,27 @@ TMR_LLRP_boot(TMR_Reader *reader)
      **/
   }
 
+  /**
+   * The reader merges duplicates within each report (ThingMagicDeDuplication);
+   * filtering repeats across reports is left to the API.
+   **/
+  reader->dedupPolicy.deviceFields = TMR_DEDUP_FIELD_UNIQUEBYANTENNA |
+                                     TMR_DEDUP_FIELD_UNIQUEBYDATA |
+                                     TMR_DEDUP_FIELD_HIGHESTRSSI;
+  {
+    TMR_LLRP_TMDeDuplication duplication;
+
+    if (TMR_SUCCESS == TMR_LLRP_cmdGetThingMagicDeDuplication(reader, &duplication))
+    {
+      reader->dedupPolicy.recordHighestRssi = (bool)duplication.highestRSSI;
+      reader->dedupPolicy.uniqueByAntenna = (bool)duplication.uniquebyAntenna;
+      reader->dedupPolicy.uniqueByData = (bool)duplication.uniquebyData;
+    }
+    /**
+     * Not Fatal, moving forward
+     **/
+  }
+
   if (TMR_LLRP_READER_DEFAULT_PORT == reader->u.llrpReader.portNum)
   {
     /**
@@ -297,6 +331,7 @@ TMR_LLRP_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
 
   ret = TMR_SUCCESS;
   lr = &reader->u.llrpReader;
+  TMR_LLRP_memPoolBind(reader);
 
   if (0 == BITGET(lr->paramConfirmed, key))
   {
@@ -331,6 +366,7 @@ TMR_LLRP_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
     case TMR_PARAM_CURRENTTIME:
     case TMR_PARAM_RADIO_TEMPERATURE:
     case TMR_PARAM_VERSION_SUPPORTEDPROTOCOLS:
+    case TMR_PARAM_LLRP_CONNECTION_STATS:
       {
         ret = TMR_ERROR_READONLY;
         break;
@@ -423,6 +459,68 @@ TMR_LLRP_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
         break;
       }
 
+    case TMR_PARAM_LLRP_KEEPALIVE_PERIOD:
+      {
+        uint32_t val = *(uint32_t *)value;
+        if ((0 == val) || ((1<<31) & val))
+        {
+          ret = TMR_ERROR_ILLEGAL_VALUE;
+          break;
+        }
+        lr->keepAlivePeriod = val;
+        if ((true == reader->connected) &&
+            (TMR_LLRP_READER_DEFAULT_PORT == lr->portNum))
+        {
+          /* Let the reader know about the new heart beat */
+          ret = TMR_LLRP_setKeepAlive(reader);
+        }
+        break;
+      }
+
+    case TMR_PARAM_LLRP_KEEPALIVE_MISSCOUNT:
+      {
+        uint32_t val = *(uint32_t *)value;
+        if (0 == val)
+        {
+          ret = TMR_ERROR_ILLEGAL_VALUE;
+        }
+        else
+        {
+          lr->keepAliveMissCount = val;
+        }
+        break;
+      }
+
+    case TMR_PARAM_LLRP_AUTORECONNECT:
+      {
+        lr->autoReconnect = *(bool *)value;
+        break;
+      }
+
+    case TMR_PARAM_LLRP_MEMPOOL_STATS:
+      {
+        /**
+         * Setting the stats, whatever the value, returns the
+         * cached blocks to the system and clears the counters.
+         **/
+        TMR_LLRP_memPoolReset(reader);
+        break;
+      }
+
+    case TMR_PARAM_LLRP_RECONNECT_TIMEOUT:
+      {
+        uint32_t val = *(uint32_t *)value;
+        if ((1<<31) & val)
+        {
+          ret = TMR_ERROR_ILLEGAL_VALUE;
+        }
+        else
+        {
+          lr->reconnectTimeout = val;
+        }
+        break;
+      }
+
     case TMR_PARAM_GEN2_ACCESSPASSWORD:
       {
         lr->gen2AccessPassword = *(TMR_GEN2_Password *)value;
@@ -474,9 +572,48 @@ TMR_LLRP_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
         }
         /* Set ThingMagic DeDuplication */
         ret = TMR_LLRP_cmdSetThingMagicDeDuplication(reader, &duplication);
+        if (TMR_SUCCESS == ret)
+        {
+          /* Keep the dedup policy in step with the reader */
+          reader->dedupPolicy.recordHighestRssi = (bool)duplication.highestRSSI;
+          reader->dedupPolicy.uniqueByAntenna = (bool)duplication.uniquebyAntenna;
+          reader->dedupPolicy.uniqueByData = (bool)duplication.uniquebyData;
+        }
 
         break;
       }
+
+    case TMR_PARAM_TAGREADDATA_DEDUPPOLICY:
+      {
+        const TMR_DedupPolicy *policy = value;
+        TMR_LLRP_TMDeDuplication duplication;
+
+        if (NULL == value)
+        {
+          return TMR_ERROR_ILLEGAL_VALUE;
+        }
+
+        /**
+         * The whole reader side of the policy fits in one
+         * SET_READER_CONFIG, no need to read it back first.
+         **/
+        duplication.highestRSSI = policy->recordHighestRssi;
+        duplication.uniquebyAntenna = policy->uniqueByAntenna;
+        duplication.uniquebyData = policy->uniqueByData;
+        ret = TMR_LLRP_cmdSetThingMagicDeDuplication(reader, &duplication);
+        if (TMR_SUCCESS != ret)
+        {
+          break;
+        }
+
+        reader->dedupPolicy.enable = policy->enable;
+        reader->dedupPolicy.uniqueByAntenna = policy->uniqueByAntenna;
+        reader->dedupPolicy.uniqueByData = policy->uniqueByData;
+        reader->dedupPolicy.uniqueByProtocol = policy->uniqueByProtocol;
+        reader->dedupPolicy.recordHighestRssi = policy->recordHighestRssi;
+        reader->dedupPolicy.windowMs = policy->windowMs;
+        break;
+      }
     case TMR_PARAM_READER_DESCRIPTION:
       {
         TMR_String *desc = (TMR_String *)value;
@@ -504,7 +641,7 @@ TMR_LLRP_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
         /* Set the description asked by user */
         LLRP_utf8v_clear(&config.description);
         config.description = LLRP_utf8v_construct(strlen(desc->value));
-        strcpy((char *)config.description.pValue, desc->value);
+        memcpy(config.description.pValue, desc->value, config.description.nValue);
         
         /* Set Reader Configuration */
         ret = TMR_LLRP_cmdSetThingmagicReaderConfiguration(reader, &config);
@@ -540,7 +677,7 @@ TMR_LLRP_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
         /* Set the host name asked by user */
         LLRP_utf8v_clear(&config.hostName);
         config.hostName = LLRP_utf8v_construct(strlen(hostname->value));
-        strcpy((char *)config.hostName.pValue, hostname->value);
+        memcpy(config.hostName.pValue, hostname->value, config.hostName.nValue);
 
         /* Set Reader Configuration */
         ret = TMR_LLRP_cmdSetThingmagicReaderConfiguration(reader, &config);
@@ -886,6 +1023,7 @@ TMR_LLRP_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
 
   ret = TMR_SUCCESS;
   lr = &reader->u.llrpReader;
+  TMR_LLRP_memPoolBind(reader);
 
   if (NULL == value)
   {
@@ -1165,6 +1303,42 @@ TMR_LLRP_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
         break;
       }
 
+    case TMR_PARAM_LLRP_KEEPALIVE_PERIOD:
+      {
+        *(uint32_t *)value = lr->keepAlivePeriod;
+        break;
+      }
+
+    case TMR_PARAM_LLRP_KEEPALIVE_MISSCOUNT:
+      {
+        *(uint32_t *)value = lr->keepAliveMissCount;
+        break;
+      }
+
+    case TMR_PARAM_LLRP_AUTORECONNECT:
+      {
+        *(bool *)value = lr->autoReconnect;
+        break;
+      }
+
+    case TMR_PARAM_LLRP_RECONNECT_TIMEOUT:
+      {
+        *(uint32_t *)value = lr->reconnectTimeout;
+        break;
+      }
+
+    case TMR_PARAM_LLRP_CONNECTION_STATS:
+      {
+        *(TMR_LLRP_ConnectionStats *)value = lr->connectionStats;
+        break;
+      }
+
+    case TMR_PARAM_LLRP_MEMPOOL_STATS:
+      {
+        TMR_LLRP_memPoolGetStats(reader, (TMR_LLRP_MemPoolStats *)value);
+        break;
+      }
+
     case TMR_PARAM_GEN2_ACCESSPASSWORD:
       {
         *(TMR_GEN2_Password *)value = lr->gen2AccessPassword;
@@ -1206,6 +1380,12 @@ TMR_LLRP_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
         break;
       }
 
+    case TMR_PARAM_TAGREADDATA_DEDUPPOLICY:
+      {
+        *(TMR_DedupPolicy *)value = reader->dedupPolicy;
+        break;
+      }
+
     case TMR_PARAM_READER_DESCRIPTION:
       {
         TMR_String *desc = (TMR_String *)value;
@@ -1469,6 +1649,8 @@ TMR_LLRP_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
 TMR_Status
 TMR_LLRP_LlrpReader_init(TMR_Reader *reader)
 {
+  TMR_Status ret;
+
   reader->readerType = TMR_READER_TYPE_LLRP;
   
   /*
@@ -1518,6 +1700,7 @@ TMR_LLRP_LlrpReader_init(TMR_Reader *reader)
   reader->u.llrpReader.msgId = 1;
   reader->u.llrpReader.roSpecId = 0;
   reader->u.llrpReader.opSpecId = 0;
+  reader->u.llrpReader.bulkOpSpecCount = 0;
   reader->u.llrpReader.accessSpecId = 0;
   reader->u.llrpReader.gen2AccessPassword = 0;
   memset(reader->u.llrpReader.paramConfirmed,0,
@@ -1550,10 +1733,22 @@ TMR_LLRP_LlrpReader_init(TMR_Reader *reader)
   /* Initialize keep alive params */
   reader->u.llrpReader.ka_start = 0;
   reader->u.llrpReader.ka_now   = 0;
+  reader->u.llrpReader.keepAlivePeriod = TMR_LLRP_KEEP_ALIVE_TIMEOUT;
+  reader->u.llrpReader.keepAliveMissCount = TMR_LLRP_KEEP_ALIVE_MISS_COUNT;
+  reader->u.llrpReader.autoReconnect = false;
+  reader->u.llrpReader.reconnectTimeout = TMR_LLRP_RECONNECT_TIMEOUT;
+  memset(&reader->u.llrpReader.connectionStats, 0,
+         sizeof(reader->u.llrpReader.connectionStats));
   reader->u.llrpReader.get_report = false;
   reader->u.llrpReader.reportReceived = false;
   reader->u.llrpReader.isResponsePending = false;
   reader->u.llrpReader.threadCancel = false;
+
+  ret = TMR_LLRP_memPoolCreate(reader);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
   return TMR_reader_init_internal(reader);
 }
 
@@ -1659,6 +1854,40 @@ TMR_LLRP_openConnectionToReader(TMR_Reader *reader, LLRP_tSConnection *pConn)
   flag = 1;
   setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (void*)&flag, sizeof flag);
 
+  /*
+   * Same for TCP keep alives. They catch a dead peer even when the
+   * LLRP keep alives are not available (non default port), and
+   * the user timeout fails a blocked send on a half open connection
+   * instead of letting it sit in the retransmit queue.
+   */
+  {
+    uint32_t lossMs;
+
+    lossMs = reader->u.llrpReader.keepAlivePeriod
+             * reader->u.llrpReader.keepAliveMissCount;
+
+    flag = 1;
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, (void*)&flag, sizeof flag);
+#ifdef TCP_KEEPIDLE
+    flag = (reader->u.llrpReader.keepAlivePeriod + 999) / 1000;
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, (void*)&flag, sizeof flag);
+#endif
+#ifdef TCP_KEEPINTVL
+    flag = (reader->u.llrpReader.keepAlivePeriod + 999) / 1000;
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, (void*)&flag, sizeof flag);
+#endif
+#ifdef TCP_KEEPCNT
+    flag = reader->u.llrpReader.keepAliveMissCount;
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, (void*)&flag, sizeof flag);
+#endif
+#ifdef TCP_USER_TIMEOUT
+    flag = lossMs;
+    setsockopt(sock, IPPROTO_TCP, TCP_USER_TIMEOUT, (void*)&flag, sizeof flag);
+#else
+    (void)lossMs;
+#endif
+  }
+
   /*
    * Record the socket in the connection instance
    */
@@ -1678,6 +1907,7 @@ TMR_LLRP_connect(TMR_Reader *reader)
   LLRP_tSConnection *pConn;
 
   ret = TMR_SUCCESS;
+  TMR_LLRP_memPoolBind(reader);
   /*
    * Construct a connection (LLRP_tSConnection).
    * Using a 32kb max frame size for send/recv.
@@ -1851,11 +2081,81 @@ TMR_LLRP_destroy(TMR_Reader *reader)
     LLRP_TypeRegistry_destruct(reader->u.llrpReader.pTypeRegistry);
     reader->u.llrpReader.pTypeRegistry=NULL;
   }
+  TMR_LLRP_memPoolDestroy(reader);
   reader->connected = false;
   
   return TMR_SUCCESS;
 }
 
+/**
+ * Re-establish a lost connection to the reader.
+ * Used by the background reader to resume continuous reading, the
+ * ROSpec and AccessSpecs are pushed down again by the next TMR_read().
+ * Keeps trying until reconnectTimeout expires or reading is stopped.
+ *
+ * @param reader The reader
+ */
+TMR_Status
+TMR_LLRP_reconnect(TMR_Reader *reader)
+{
+  TMR_Status ret;
+  TMR_LLRP_LlrpReader *lr;
+  uint64_t start;
+  uint32_t backoff;
+
+  lr = &reader->u.llrpReader;
+  ret = TMR_ERROR_LLRP_CONNECTIONFAILED;
+  start = tmr_gettime();
+  backoff = 250;
+  TMR_LLRP_memPoolBind(reader);
+
+  /**
+   * Nothing useful can be said to a dead peer,
+   * just drop the old connection.
+   **/
+  reader->connected = false;
+  if (NULL != lr->pConn)
+  {
+    LLRP_Conn_destruct(lr->pConn);
+    lr->pConn = NULL;
+  }
+
+  while (true == reader->searchStatus)
+  {
+    ret = TMR_LLRP_connect(reader);
+    if (TMR_SUCCESS == ret)
+    {
+      break;
+    }
+
+    /* Clean up the half open connection before trying again */
+    reader->connected = false;
+    if (NULL != lr->pConn)
+    {
+      LLRP_Conn_destruct(lr->pConn);
+      lr->pConn = NULL;
+    }
+
+    if ((tmr_gettime() - start) >= lr->reconnectTimeout)
+    {
+      break;
+    }
+    tmr_sleep(backoff);
+    if (2000 > backoff)
+    {
+      backoff *= 2;
+    }
+  }
+
+  if (TMR_SUCCESS == ret)
+  {
+    /* Restart keep alive monitoring on the new connection */
+    lr->ka_start = tmr_gettime();
+  }
+
+  return ret;
+}
+
 static TMR_Status
 TMR_LLRP_read_internal(TMR_Reader *reader,
                         uint32_t timeoutMs,
@@ -1921,6 +2221,14 @@ TMR_LLRP_read_internal(TMR_Reader *reader,
   }
 
   /* At this point we are guaranteed to have simple read plan */
+
+  /* Report trigger of the ROSpec about to be added */
+  lr->reportTrigger = rp->u.simple.reportTrigger;
+  if ((0 != lr->reportTrigger.periodMs) &&
+      ((0 == lr->reportPeriodMs) || (lr->reportTrigger.periodMs < lr->reportPeriodMs)))
+  {
+    lr->reportPeriodMs = lr->reportTrigger.periodMs;
+  }
   
   /**
    * Simple read plan with no embedded tag operations
@@ -2016,6 +2324,7 @@ TMR_LLRP_read(TMR_Reader *reader, uint32_t timeoutMs, int32_t *tagCount)
 
   rp = reader->readParams.readPlan;
   ret = TMR_SUCCESS;
+  TMR_LLRP_memPoolBind(reader);
 
   if (tagCount)
   {
@@ -2097,6 +2406,10 @@ TMR_LLRP_read(TMR_Reader *reader, uint32_t timeoutMs, int32_t *tagCount)
    **/
   reader->u.llrpReader.numOfROSpecEvents = 1;
 
+  /* Report period is collected from the read plan */
+  reader->u.llrpReader.reportPeriodMs = 0;
+  reader->u.llrpReader.lastReportTime = tmr_gettime();
+
   ret = TMR_LLRP_read_internal(reader, timeoutMs, rp);
   if (TMR_SUCCESS != ret)
   {
@@ -2141,6 +2454,7 @@ TMR_LLRP_hasMoreTags(TMR_Reader *reader)
 
   lr = &reader->u.llrpReader;
   ret = TMR_SUCCESS;
+  TMR_LLRP_memPoolBind(reader);
 
 #ifdef TMR_ENABLE_BACKGROUND_READS
   if (reader->continuousReading)
@@ -2150,6 +2464,27 @@ TMR_LLRP_hasMoreTags(TMR_Reader *reader)
 
     timeout = lr->searchTimeoutMs;
 
+    if (0 != lr->reportPeriodMs)
+    {
+      uint64_t now, due;
+
+      /**
+       * LLRP 1.0.1 has no time based report trigger. Ask for
+       * the report once the period passes without one, and
+       * do not wait for messages beyond the next deadline.
+       **/
+      now = tmr_gettime();
+      due = lr->lastReportTime + lr->reportPeriodMs;
+      if (now >= due)
+      {
+        reader->u.llrpReader.get_report = true;
+        lr->lastReportTime = now;
+        due = now + lr->reportPeriodMs;
+      }
+      /* receiveMessage adds the transport timeout on top */
+      timeout = (int)(due - now) - (int)lr->transportTimeout;
+    }
+
     if (true == reader->u.llrpReader.get_report)
     {
     /**
@@ -2177,16 +2512,23 @@ TMR_LLRP_hasMoreTags(TMR_Reader *reader)
 
         reader->u.llrpReader.ka_now = tmr_gettime();
         diffTime = reader->u.llrpReader.ka_now - reader->u.llrpReader.ka_start;
-        if ((TMR_LLRP_KEEP_ALIVE_TIMEOUT * 4) < diffTime)
+        if (((uint64_t)lr->keepAlivePeriod * lr->keepAliveMissCount) < diffTime)
         {
           /**
-           * We have waited for enough time (4 times keep alive duration), 
+           * We have waited for enough time (keepAliveMissCount times keep alive duration), 
            * and still there is no response from reader. 
            * Connection might be lost. Indicate an error so that the
            * continuous reading will be stopped.
            **/
           return TMR_ERROR_LLRP_READER_CONNECTION_LOST;
         }
+
+        if ((0 != lr->reportPeriodMs) && (NULL != lr->pConn) &&
+            (LLRP_RC_RecvTimeout == LLRP_Conn_getRecvError(lr->pConn)->eResultCode))
+        {
+          /* Woke up for the next report deadline, nothing wrong */
+          return TMR_ERROR_NO_TAGS;
+        }
       }
       return ret;
     }
@@ -2202,6 +2544,7 @@ TMR_LLRP_hasMoreTags(TMR_Reader *reader)
       {
         reader->isStatusResponse = false;
         reader->u.llrpReader.reportReceived = true;
+        lr->lastReportTime = tmr_gettime();
         return TMR_SUCCESS;
       }
       /**
@@ -2433,6 +2776,7 @@ TMR_LLRP_executeTagOp(TMR_Reader *reader, TMR_TagOp *tagop,
 
   lr = &reader->u.llrpReader;
   ret = TMR_SUCCESS;
+  TMR_LLRP_memPoolBind(reader);
  
   reader->u.llrpReader.bufPointer = 0;
   /**
@@ -2640,6 +2984,7 @@ TMR_LLRP_gpiGet(struct TMR_Reader *reader, uint8_t *count,
                          TMR_GpioPin state[])
 {
   TMR_Status ret;
+  TMR_LLRP_memPoolBind(reader);
   ret = TMR_LLRP_cmdGetGPIState(reader, count, state);
   return ret;
 }
@@ -2649,6 +2994,7 @@ TMR_LLRP_gpoSet(struct TMR_Reader *reader, uint8_t count,
                       const TMR_GpioPin state[])
 {
   TMR_Status ret;
+  TMR_LLRP_memPoolBind(reader);
   ret = TMR_LLRP_cmdSetGPOState(reader, count, state);
   return ret;
 }
@@ -2727,6 +3073,7 @@ TMR_LLRP_reboot(TMR_Reader *reader)
 {
   TMR_Status ret;
 
+  TMR_LLRP_memPoolBind(reader);
   ret = TMR_LLRP_cmdrebootReader(reader);
 
   return ret;
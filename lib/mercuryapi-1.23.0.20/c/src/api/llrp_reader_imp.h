@@ -265,6 +265,14 @@ TMR_Status TMR_LLRP_cmdSetEventNotificationSpec(TMR_Reader *reader, bool state);
 TMR_Status TMR_LLRP_handleReaderEvents(TMR_Reader *reader, LLRP_tSMessage *pMsg);
 TMR_Status TMR_LLRP_processReceivedMessage(TMR_Reader *reader, LLRP_tSMessage *pMsg);
 void TMR_LLRP_setBackgroundReceiverState(TMR_Reader *reader, bool state);
+TMR_Status TMR_LLRP_reconnect(TMR_Reader *reader);
+
+/* Message memory pool */
+TMR_Status TMR_LLRP_memPoolCreate(TMR_Reader *reader);
+void TMR_LLRP_memPoolDestroy(TMR_Reader *reader);
+void TMR_LLRP_memPoolBind(TMR_Reader *reader);
+void TMR_LLRP_memPoolGetStats(TMR_Reader *reader, TMR_LLRP_MemPoolStats *stats);
+void TMR_LLRP_memPoolReset(TMR_Reader *reader);
 
 /* Access Spec */
 TMR_Status TMR_LLRP_cmdEnableAccessSpec(TMR_Reader *reader, llrp_u32_t accessSpecId);
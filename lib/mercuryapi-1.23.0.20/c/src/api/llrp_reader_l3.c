@@ -46,6 +46,8 @@
 #include <time.h>
 #include "llrp_reader_imp.h"
 #include "tmr_utils.h"
+#include "tmr_trace.h"
+#include "tmr_transport_tap.h"
 
 #define BACKGROUND_RECEIVER_LOOP_PERIOD 100
 
@@ -121,6 +123,7 @@ TMR_LLRP_sendMessage(TMR_Reader *reader, LLRP_tSMessage *pMsg, int timeoutMs)
   {
     return TMR_ERROR_LLRP_SENDIO_ERROR;
   }
+  TMR_LLRP_memPoolBind(reader);
 
   pMsg->MessageID = reader->u.llrpReader.msgId ++;
 
@@ -139,8 +142,12 @@ TMR_LLRP_sendMessage(TMR_Reader *reader, LLRP_tSMessage *pMsg, int timeoutMs)
                 pMsg->elementHdr.pType->pName,
                 pError->pWhatStr ? pError->pWhatStr : "no reason given");
 
+    TMR__TAP_FRAME(reader, true, pConn->Send.nBuffer, pConn->Send.pBuffer,
+                   TMR_ERROR_LLRP_SENDIO_ERROR);
     return TMR_ERROR_LLRP_SENDIO_ERROR;
   }
+  /* The encoded frame is still in the send buffer */
+  TMR__TAP_FRAME(reader, true, pConn->Send.nBuffer, pConn->Send.pBuffer, TMR_SUCCESS);
 
   return TMR_SUCCESS;
 }
@@ -162,6 +169,7 @@ TMR_LLRP_receiveMessage(TMR_Reader *reader, LLRP_tSMessage **pMsg, int timeoutMs
   {
     return TMR_ERROR_LLRP_RECEIVEIO_ERROR;
   }
+  TMR_LLRP_memPoolBind(reader);
 
   /*
    * Receive the message subject to a time limit
@@ -179,10 +187,23 @@ TMR_LLRP_receiveMessage(TMR_Reader *reader, LLRP_tSMessage **pMsg, int timeoutMs
             "ERROR: recvMessage failed, %s",
             pError->pWhatStr ? pError->pWhatStr : "no reason given");
     
+    /* Whatever part of a frame had arrived */
+    TMR__TAP_FRAME(reader, false, pConn->Recv.nBuffer, pConn->Recv.pBuffer,
+                   TMR_ERROR_LLRP_RECEIVEIO_ERROR);
     return TMR_ERROR_LLRP_RECEIVEIO_ERROR;
   }
+  TMR__PIPELINE_ADD(reader, transportBytes, pConn->Recv.FrameExtract.MessageLength);
+  TMR__PIPELINE_ADD(reader, transportFrames, 1);
+  TMR_TRACE(LLRP_RECEIVE, reader, (*pMsg)->elementHdr.pType->TypeNum,
+            pConn->Recv.FrameExtract.MessageLength);
+  /* The decoded frame is still in the receive buffer */
+  TMR__TAP_FRAME(reader, false, pConn->Recv.FrameExtract.MessageLength,
+                 pConn->Recv.pBuffer, TMR_SUCCESS);
 
-  TMR_LLRP_notifyTransportListener(reader, *pMsg, false, timeoutMs);
+  if (NULL != reader->transportListeners)
+  {
+    TMR_LLRP_notifyTransportListener(reader, *pMsg, false, timeoutMs);
+  }
   return TMR_SUCCESS;
 }
 
@@ -2229,12 +2250,19 @@ TMR_LLRP_cmdAddROSpec(TMR_Reader *reader, uint16_t readDuration,
       if (reader->continuousReading)
       {
         /**
-         * In case of continuous Reading, report is
-         * requested for every 10 tags. (10 being the moderate value)
+         * In case of continuous Reading, report is requested
+         * for every tag unless the read plan asks for batches.
          * In case there is no report (when there are not enough tags),
          * we are supposed to GET_REPORT from reader.
          **/
-        LLRP_ROReportSpec_setN(pROReportSpec, 1);
+        if (0 != reader->u.llrpReader.reportTrigger.tagCount)
+        {
+          LLRP_ROReportSpec_setN(pROReportSpec, reader->u.llrpReader.reportTrigger.tagCount);
+        }
+        else
+        {
+          LLRP_ROReportSpec_setN(pROReportSpec, 1);
+        }
       }
       else
       {
@@ -2688,6 +2716,63 @@ TMR_LLRP_verifyReadOperation(TMR_Reader *reader, int32_t *tagCount)
   return TMR_SUCCESS;
 }
 
+/**
+ * Internal method to place the result of one OpSpec of a multi-OpSpec
+ * read into the TMR_TagReadData bank list (reservedMemData, epcMemData,
+ * tidMemData or userMemData) for the bank that OpSpec read.
+ * Several ranges of the same bank are appended in OpSpec order.
+ *
+ * @param reader Reader pointer
+ * @param data[out] Pointer to TMR_TagReadData
+ * @param pResult[in] The C1G2ReadOpSpecResult
+ */
+static void
+TMR_LLRP_parseBulkReadData(TMR_Reader *reader, TMR_TagReadData *data,
+                           LLRP_tSC1G2ReadOpSpecResult *pResult)
+{
+  TMR_LLRP_LlrpReader *lr;
+  TMR_uint8List *bankData;
+  TMR_uint8List tail;
+  uint16_t index;
+
+  lr = &reader->u.llrpReader;
+  index = (uint16_t)(pResult->OpSpecID - lr->bulkOpSpecId);
+  if (lr->bulkOpSpecCount <= index)
+  {
+    /* Not one of ours */
+    return;
+  }
+
+  switch (lr->bulkOpSpecBank[index])
+  {
+    case TMR_GEN2_BANK_RESERVED:
+      bankData = &data->reservedMemData;
+      break;
+    case TMR_GEN2_BANK_EPC:
+      bankData = &data->epcMemData;
+      break;
+    case TMR_GEN2_BANK_TID:
+      bankData = &data->tidMemData;
+      break;
+    default:
+      bankData = &data->userMemData;
+      break;
+  }
+
+  /* Whole words only */
+  tail.max = (bankData->max - bankData->len) & ~1;
+  if ((NULL == bankData->list) || (bankData->len > bankData->max) || (0 == tail.max))
+  {
+    return;
+  }
+
+  tail.list = bankData->list + bankData->len;
+  tail.len = 0;
+  TMR_LLRP_parseTagOpSpecData((LLRP_tSParameter *)pResult, &tail);
+  bankData->len += (tail.len < tail.max) ? tail.len : tail.max;
+  data->metadataFlags |= TMR_TRD_METADATA_FLAG_DATA;
+}
+
 /**
  * Internal method to parse metadata from LLRP Report response
  * This method constructs a TMR_TagReadData object by extracting the 
@@ -2892,7 +2977,13 @@ TMR_LLRP_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *data, LLR
          * TODO: For other tag operations which return tagop data,
          * where do we store that?
          **/
-        if (NULL != &data->data)
+        if ((0 != reader->u.llrpReader.bulkOpSpecCount) &&
+            (TMR_LLRP_C1G2READOPSPECRESULT == pParameter->elementHdr.pType->TypeNum))
+        {
+          TMR_LLRP_parseBulkReadData(reader, data,
+              (LLRP_tSC1G2ReadOpSpecResult *)pParameter);
+        }
+        else if (NULL != &data->data)
         {
           TMR_LLRP_parseTagOpSpecData(pParameter, &data->data);
           data->metadataFlags |= TMR_TRD_METADATA_FLAG_DATA;
@@ -3778,15 +3869,10 @@ TMR_LLRP_cmdSetThingMagicDeDuplication(TMR_Reader *reader, TMR_LLRP_TMDeDuplicat
 void 
 TMR_LLRP_freeTMReaderConfiguration(TMR_LLRP_TMReaderConfiguration *config)
 {
-  if (NULL != config->description.pValue)
-  {
-    free(config->description.pValue);
-  }
-
-  if (NULL != config->role.pValue)
-  {
-    free(config->role.pValue);
-  }
+  /* The strings come from LTKC, which may allocate them from a pool */
+  LLRP_utf8v_clear(&config->description);
+  LLRP_utf8v_clear(&config->role);
+  LLRP_utf8v_clear(&config->hostName);
 }
 
 
@@ -6176,7 +6262,7 @@ TMR_LLRP_setKeepAlive(TMR_Reader *reader)
   /* Initialize Keep Alive Spec  */
   pKeepAlive = LLRP_KeepaliveSpec_construct();
   LLRP_KeepaliveSpec_setKeepaliveTriggerType(pKeepAlive, LLRP_KeepaliveTriggerType_Periodic);
-  LLRP_KeepaliveSpec_setPeriodicTriggerValue(pKeepAlive, TMR_LLRP_KEEP_ALIVE_TIMEOUT);
+  LLRP_KeepaliveSpec_setPeriodicTriggerValue(pKeepAlive, reader->u.llrpReader.keepAlivePeriod);
 
 
   /* Add KeepaliveSpec to SET_READER_CONFIG*/
@@ -6213,9 +6299,16 @@ TMR_LLRP_setKeepAlive(TMR_Reader *reader)
   TMR_LLRP_freeMessage(pRspMsg);
 
   /**
-   * Start LLRP background receiver
+   * Start LLRP background receiver, unless it is already
+   * running from an earlier connection (e.g., after a reconnect
+   * or when the keep alive period is changed).
    **/
-  return TMR_LLRP_startBackgroundReceiver(reader);
+  if (false == reader->u.llrpReader.receiverSetup)
+  {
+    return TMR_LLRP_startBackgroundReceiver(reader);
+  }
+
+  return TMR_SUCCESS;
 }
 
 TMR_Status
@@ -6320,6 +6413,7 @@ llrp_receiver_thread(void *arg)
   ret = TMR_SUCCESS;
   reader = arg;
   lr = &reader->u.llrpReader;
+  TMR_LLRP_memPoolBind(reader);
 
   /**
    * You are going to kill me, if you set runInBackground to false.
@@ -6341,6 +6435,16 @@ llrp_receiver_thread(void *arg)
       lr->receiverRunning = true;
       pthread_mutex_unlock(&lr->receiverLock);
 
+      /**
+       * The connection might have been re-established
+       * while the receiver was disabled, pick up the current one.
+       **/
+      pConn = reader->u.llrpReader.pConn;
+      if (NULL == pConn)
+      {
+        continue;
+      }
+
       FD_ZERO(&set);
       FD_SET(pConn->fd, &set);
       tv.tv_sec = 0;
@@ -6394,10 +6498,10 @@ llrp_receiver_thread(void *arg)
       }
       reader->u.llrpReader.ka_now = tmr_gettime();
       diffTime = reader->u.llrpReader.ka_now - reader->u.llrpReader.ka_start;
-      if ((TMR_LLRP_KEEP_ALIVE_TIMEOUT * 4) < diffTime)
+      if (((uint64_t)lr->keepAlivePeriod * lr->keepAliveMissCount) < diffTime)
       {
         /**
-         * We have waited for enough time (4 times keep alive duration), 
+         * We have waited for enough time (keepAliveMissCount times keep alive duration), 
          * and still there is no response from reader. 
          * Connection might be lost. Indicate an error so that the
          * continuous reading will be stopped.
@@ -6699,6 +6803,40 @@ TMR_LLRP_cmdEnableAccessSpec(TMR_Reader *reader, llrp_u32_t accessSpecId)
   return ret;
 }
 
+/**
+ * Add a C1G2Read OpSpec, using the current OpSpecID, to an AccessCommand
+ *
+ * @param reader Reader pointer
+ * @param pAccessCommand Pointer to AccessCommand parameter
+ * @param args Pointer to the ReadData arguments
+ */
+static void
+TMR_LLRP_msgAddC1G2Read(TMR_Reader *reader,
+                        LLRP_tSAccessCommand *pAccessCommand,
+                        TMR_TagOp_GEN2_ReadData *args)
+{
+  LLRP_tSC1G2Read *pC1G2Read;
+
+  /* Construct and initialize C1G2Read */
+  pC1G2Read = LLRP_C1G2Read_construct();
+  /* Set OpSpec Id */
+  LLRP_C1G2Read_setOpSpecID(pC1G2Read, reader->u.llrpReader.opSpecId);
+  /* Set access password */
+  LLRP_C1G2Read_setAccessPassword(pC1G2Read, reader->u.llrpReader.gen2AccessPassword);
+  /* Set Memory Bank */
+  LLRP_C1G2Read_setMB(pC1G2Read, (llrp_u2_t)args->bank);
+  /* Set word pointer */
+  LLRP_C1G2Read_setWordPointer(pC1G2Read, args->wordAddress);
+  /* Set word length to read */
+  LLRP_C1G2Read_setWordCount(pC1G2Read, args->len);
+
+  /**
+   * Set C1G2Read as OpSpec to accessSpec
+   **/
+  LLRP_AccessCommand_addAccessCommandOpSpec(pAccessCommand, 
+                                  (LLRP_tSParameter *)pC1G2Read); 
+}
+
 /**
  * Prepare AccessCommand
  *
@@ -6716,6 +6854,7 @@ TMR_LLRP_msgPrepareAccessCommand(TMR_Reader *reader,
   TMR_Status ret;
 
   ret = TMR_SUCCESS;
+  reader->u.llrpReader.bulkOpSpecCount = 0;
 
   /**
    * 1. Prepare and Add TagSpec
@@ -6759,29 +6898,7 @@ TMR_LLRP_msgPrepareAccessCommand(TMR_Reader *reader,
     {
       case TMR_TAGOP_GEN2_READDATA:
         {
-          TMR_TagOp_GEN2_ReadData *args;
-          LLRP_tSC1G2Read         *pC1G2Read;
-
-          args = &tagop->u.gen2.u.readData;
-          
-          /* Construct and initialize C1G2Read */
-          pC1G2Read = LLRP_C1G2Read_construct();
-          /* Set OpSpec Id */
-          LLRP_C1G2Read_setOpSpecID(pC1G2Read, reader->u.llrpReader.opSpecId);
-          /* Set access password */
-          LLRP_C1G2Read_setAccessPassword(pC1G2Read, reader->u.llrpReader.gen2AccessPassword);
-          /* Set Memory Bank */
-          LLRP_C1G2Read_setMB(pC1G2Read, (llrp_u2_t)args->bank);
-          /* Set word pointer */
-          LLRP_C1G2Read_setWordPointer(pC1G2Read, args->wordAddress);
-          /* Set word length to read */
-          LLRP_C1G2Read_setWordCount(pC1G2Read, args->len);
-
-         /**
-          * Set C1G2Read as OpSpec to accessSpec
-          **/
-          LLRP_AccessCommand_addAccessCommandOpSpec(pAccessCommand, 
-                                          (LLRP_tSParameter *)pC1G2Read); 
+          TMR_LLRP_msgAddC1G2Read(reader, pAccessCommand, &tagop->u.gen2.u.readData);
           break;
         }
 
@@ -8927,11 +9044,44 @@ TMR_LLRP_msgPrepareAccessCommand(TMR_Reader *reader,
 #endif /* TMR_ENABLE_ISO180006B */
       case TMR_TAGOP_LIST:
         {
+          TMR_LLRP_LlrpReader *lr;
+          uint16_t i;
+
           /**
-           * We support only one OpSpec per AccessSpec.
-           * So return unsupported error.
+           * A list of Gen2 ReadData ops becomes one OpSpec per op in
+           * this AccessSpec, so the reader runs all of them on every
+           * tag it singulates and returns the results in the same
+           * TagReportData. Other tagops still need an AccessSpec each.
            **/
-          return TMR_ERROR_UNSUPPORTED;
+          lr = &reader->u.llrpReader;
+          if ((0 == tagop->u.list.len) ||
+              (TMR_MAX_TAGMEM_RANGES < tagop->u.list.len))
+          {
+            return TMR_ERROR_INVALID;
+          }
+          for (i = 0; i < tagop->u.list.len; i++)
+          {
+            if (TMR_TAGOP_GEN2_READDATA != tagop->u.list.list[i]->type)
+            {
+              return TMR_ERROR_UNSUPPORTED;
+            }
+          }
+
+          lr->bulkOpSpecId = lr->opSpecId;
+          for (i = 0; i < tagop->u.list.len; i++)
+          {
+            TMR_TagOp_GEN2_ReadData *args;
+
+            args = &tagop->u.list.list[i]->u.gen2.u.readData;
+            if (0 < i)
+            {
+              lr->opSpecId ++;
+            }
+            TMR_LLRP_msgAddC1G2Read(reader, pAccessCommand, args);
+            lr->bulkOpSpecBank[i] = (TMR_GEN2_Bank)(args->bank & 0x3);
+          }
+          lr->bulkOpSpecCount = (uint8_t)tagop->u.list.len;
+          break;
         }
 
       default:
@@ -10181,6 +10331,7 @@ TMR_LLRP_cmdDeleteAllAccessSpecs(TMR_Reader *reader)
 TMR_Status
 TMR_LLRP_cmdStopReading(struct TMR_Reader *reader)
 {
+  TMR_LLRP_memPoolBind(reader);
   if (TMR_READ_PLAN_TYPE_SIMPLE == reader->readParams.readPlan->type)
   {
     /* receiveResponse = false, as we do not need here */
@@ -139,6 +139,118 @@ TMR_SR_configPreamble(TMR_SR_SerialReader *sr)
   return ret;
 }
 
+/**
+ * Load reader->dedupPolicy from the module, so the API side of the
+ * dedup layer starts out agreeing with what the module does.  Settings
+ * the module cannot report are left at their defaults.
+ **/
+static void
+TMR_SR_initDedupPolicy(TMR_Reader *reader)
+{
+  TMR_SR_SerialReader *sr;
+  TMR_DedupPolicy *policy;
+  bool value;
+
+  sr = &reader->u.serialReader;
+  policy = &reader->dedupPolicy;
+
+  policy->deviceFields = TMR_DEDUP_FIELD_UNIQUEBYANTENNA | TMR_DEDUP_FIELD_UNIQUEBYDATA |
+                         TMR_DEDUP_FIELD_HIGHESTRSSI;
+  policy->enable = sr->enableReadFiltering;
+  policy->windowMs = (0 < sr->readFilterTimeout) ? (uint32_t)sr->readFilterTimeout : 0;
+
+  if (TMR_SUCCESS == TMR_SR_cmdGetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_ANTENNA, &value))
+  {
+    policy->uniqueByAntenna = value;
+  }
+  if (TMR_SUCCESS == TMR_SR_cmdGetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_DATA, &value))
+  {
+    policy->uniqueByData = value;
+  }
+  if (TMR_SUCCESS == TMR_SR_cmdGetReaderConfiguration(reader, TMR_SR_CONFIGURATION_RECORD_HIGHEST_RSSI, &value))
+  {
+    policy->recordHighestRssi = value;
+  }
+
+  if ((TMR_SR_MODEL_M6E == sr->versionInfo.hardware[0]) ||
+      (TMR_SR_MODEL_M6E_MICRO == sr->versionInfo.hardware[0]) ||
+      (TMR_SR_MODEL_M6E_PRC == sr->versionInfo.hardware[0]))
+  {
+    /* M6e family modules also filter repeats in the module */
+    policy->deviceFields |= TMR_DEDUP_FIELD_FILTER | TMR_DEDUP_FIELD_WINDOW |
+                            TMR_DEDUP_FIELD_UNIQUEBYPROTOCOL;
+    if (TMR_SUCCESS == TMR_SR_cmdGetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_PROTOCOL, &value))
+    {
+      policy->uniqueByProtocol = value;
+    }
+  }
+}
+
+/**
+ * Push a TMR_DedupPolicy down to the module.  M6e family modules take
+ * all of it.  Older modules have no read filter controls, so the
+ * filtering itself is left to TMR_readIntoArray() and the background
+ * read path.
+ **/
+static TMR_Status
+TMR_SR_setDedupPolicy(TMR_Reader *reader, const TMR_DedupPolicy *policy)
+{
+  TMR_Status ret;
+  TMR_SR_SerialReader *sr;
+
+  sr = &reader->u.serialReader;
+
+  ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_ANTENNA, &policy->uniqueByAntenna);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_DATA, &policy->uniqueByData);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_RECORD_HIGHEST_RSSI, &policy->recordHighestRssi);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
+  if ((TMR_SR_MODEL_M6E == sr->versionInfo.hardware[0]) ||
+      (TMR_SR_MODEL_M6E_MICRO == sr->versionInfo.hardware[0]) ||
+      (TMR_SR_MODEL_M6E_PRC == sr->versionInfo.hardware[0]))
+  {
+    int32_t timeout = (int32_t)policy->windowMs;
+
+    ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_PROTOCOL, &policy->uniqueByProtocol);
+    if (TMR_SUCCESS != ret)
+    {
+      return ret;
+    }
+    ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_READ_FILTER_TIMEOUT, &timeout);
+    if (TMR_SUCCESS != ret)
+    {
+      return ret;
+    }
+    sr->readFilterTimeout = timeout;
+    ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_ENABLE_READ_FILTER, &policy->enable);
+    if (TMR_SUCCESS != ret)
+    {
+      return ret;
+    }
+    sr->enableReadFiltering = policy->enable;
+  }
+
+  reader->dedupPolicy.enable = policy->enable;
+  reader->dedupPolicy.uniqueByAntenna = policy->uniqueByAntenna;
+  reader->dedupPolicy.uniqueByData = policy->uniqueByData;
+  reader->dedupPolicy.uniqueByProtocol = policy->uniqueByProtocol;
+  reader->dedupPolicy.recordHighestRssi = policy->recordHighestRssi;
+  reader->dedupPolicy.windowMs = policy->windowMs;
+
+  return TMR_SUCCESS;
+}
+
 static TMR_Status
 TMR_SR_boot(TMR_Reader *reader, uint32_t currentBaudRate)
 {
@@ -358,6 +470,16 @@ TMR_SR_boot(TMR_Reader *reader, uint32_t currentBaudRate)
   BITSET(sr->paramPresent, TMR_PARAM_TAGREADATA_TAGOPSUCCESSCOUNT);
   BITSET(sr->paramPresent, TMR_PARAM_TAGREADATA_TAGOPFAILURECOUNT);
   BITSET(sr->paramPresent, TMR_PARAM_TAGREADDATA_ENABLEREADFILTER);
+  BITSET(sr->paramPresent, TMR_PARAM_TAGREADDATA_DEDUPPOLICY);
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  BITSET(sr->paramPresent, TMR_PARAM_PIPELINE_STATS);
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  BITSET(sr->paramPresent, TMR_PARAM_PIPELINE_STATS_PERIOD);
+#endif
+#endif
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  BITSET(sr->paramPresent, TMR_PARAM_SERIAL_AUTORESUME);
+#endif
   BITSET(sr->paramPresent, TMR_PARAM_READER_WRITE_REPLY_TIMEOUT);
   BITSET(sr->paramPresent, TMR_PARAM_READER_WRITE_EARLY_EXIT);
   BITSET(sr->paramPresent, TMR_PARAM_ISO180006B_DELIMITER);
@@ -483,6 +605,8 @@ TMR_SR_boot(TMR_Reader *reader, uint32_t currentBaudRate)
 
   }
 
+  TMR_SR_initDedupPolicy(reader);
+
   
   return ret;
 }
@@ -2499,6 +2623,9 @@ TMR_SR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
       }
     }
 	break;
+  case TMR_PARAM_SERIAL_AUTORESUME:
+    sr->autoResume = *(bool *)value;
+    break;
   case TMR_PARAM_RADIO_ENABLEPOWERSAVE:
 	readerkey = TMR_SR_CONFIGURATION_TRANSMIT_POWER_SAVE;
 	break;
@@ -2515,6 +2642,10 @@ TMR_SR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
         (TMR_SR_MODEL_M6E_PRC == sr->versionInfo.hardware[0]))
     {
       ret = TMR_SR_cmdSetReaderConfiguration(reader, TMR_SR_CONFIGURATION_UNIQUE_BY_PROTOCOL, value);
+      if (TMR_SUCCESS == ret)
+      {
+        reader->dedupPolicy.uniqueByProtocol = *(bool *)value;
+      }
     }
     else
     {
@@ -2532,6 +2663,7 @@ TMR_SR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
       if (TMR_SUCCESS == ret)
       {
         reader->u.serialReader.readFilterTimeout = timeout;
+        reader->dedupPolicy.windowMs = (0 < timeout) ? (uint32_t)timeout : 0;
       }
     }
     else
@@ -2548,6 +2680,7 @@ TMR_SR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
       if (TMR_SUCCESS == ret)
       {
         reader->u.serialReader.enableReadFiltering = *(bool *)value;
+        reader->dedupPolicy.enable = *(bool *)value;
       }
     }
     else
@@ -2595,6 +2728,10 @@ TMR_SR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
     readerkey = TMR_SR_CONFIGURATION_UNIQUE_BY_DATA;
     break;
 
+  case TMR_PARAM_TAGREADDATA_DEDUPPOLICY:
+    ret = TMR_SR_setDedupPolicy(reader, value);
+    break;
+
   case TMR_PARAM_ANTENNA_PORTSWITCHGPOS:
   {
     uint8_t portmask;
@@ -3031,11 +3168,30 @@ TMR_SR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
   case TMR_PARAM_ANTENNA_CHECKPORT:
   case TMR_PARAM_RADIO_ENABLEPOWERSAVE:
   case TMR_PARAM_RADIO_ENABLESJC:
-  case TMR_PARAM_TAGREADDATA_RECORDHIGHESTRSSI:
   case TMR_PARAM_TAGREADDATA_REPORTRSSIINDBM:
+      ret = TMR_SR_cmdSetReaderConfiguration(reader, readerkey, value);
+    break;
+
+  case TMR_PARAM_TAGREADDATA_RECORDHIGHESTRSSI:
   case TMR_PARAM_TAGREADDATA_UNIQUEBYANTENNA:
   case TMR_PARAM_TAGREADDATA_UNIQUEBYDATA:
-      ret = TMR_SR_cmdSetReaderConfiguration(reader, readerkey, value);
+    ret = TMR_SR_cmdSetReaderConfiguration(reader, readerkey, value);
+    if (TMR_SUCCESS == ret)
+    {
+      /* Keep the dedup policy in step with the module */
+      if (TMR_PARAM_TAGREADDATA_RECORDHIGHESTRSSI == key)
+      {
+        reader->dedupPolicy.recordHighestRssi = *(bool *)value;
+      }
+      else if (TMR_PARAM_TAGREADDATA_UNIQUEBYANTENNA == key)
+      {
+        reader->dedupPolicy.uniqueByAntenna = *(bool *)value;
+      }
+      else
+      {
+        reader->dedupPolicy.uniqueByData = *(bool *)value;
+      }
+    }
     break;
 
   case TMR_PARAM_EXTENDEDEPC:
@@ -3216,6 +3372,10 @@ TMR_SR_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
     *(uint32_t *)value = sr->transportTimeout;
     break;
 
+  case TMR_PARAM_SERIAL_AUTORESUME:
+    *(bool *)value = sr->autoResume;
+    break;
+
   case TMR_PARAM_REGION_ID:
     {
       if ((TMR_REGION_NONE == sr->regionId) && (reader->connected))
@@ -3251,6 +3411,10 @@ TMR_SR_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
     *(bool *)value = sr->enableReadFiltering;
     break;
 
+  case TMR_PARAM_TAGREADDATA_DEDUPPOLICY:
+    *(TMR_DedupPolicy *)value = reader->dedupPolicy;
+    break;
+
   case TMR_PARAM_EXTENDEDEPC:
     readerkey = TMR_SR_CONFIGURATION_EXTENDED_EPC;
     break;
@@ -3951,6 +4115,10 @@ TMR_SR_SerialReader_init(TMR_Reader *reader)
   reader->u.serialReader.enableReadFiltering = true;
   reader->u.serialReader.readFilterTimeout = 0;
   reader->u.serialReader.usrTimeoutEnable = false;
+  reader->u.serialReader.autoResume = false;
+#ifdef TMR_ENABLE_PHASE_CAL
+  reader->u.serialReader.phaseCal = NULL;
+#endif
   reader->u.serialReader.crcEnabled = true;
   reader->u.serialReader.transportType = TMR_SR_MSG_SOURCE_UNKNOWN;
   reader->u.serialReader.gen2AllMemoryBankEnabled = false;
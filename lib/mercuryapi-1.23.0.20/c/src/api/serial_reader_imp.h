@@ -150,6 +150,7 @@ typedef enum TMR_SR_ProductGroupID
   TMR_SR_PRODUCT_INVALID = 0xFFFF,
 }TMR_SR_ProductGroupID;
 
+uint16_t TMR_SR_crc(uint8_t *u8Buf, uint8_t len);
 TMR_Status TMR_SR_sendTimeout(TMR_Reader *reader, uint8_t *data,
                               uint32_t timeoutMs);
 TMR_Status TMR_SR_send(TMR_Reader *reader, uint8_t *data);
@@ -35,6 +35,9 @@
 #include "tm_reader.h"
 #include "serial_reader_imp.h"
 #include "tmr_utils.h"
+#include "tmr_trace.h"
+#include "tmr_transport_tap.h"
+#include "tmr_phase_cal.h"
 
 #ifdef TMR_ENABLE_SERIAL_READER
 
@@ -57,8 +60,8 @@ static uint16_t crctable[] =
   0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
 };
 
-static uint16_t
-tm_crc(uint8_t *u8Buf, uint8_t len)
+uint16_t
+TMR_SR_crc(uint8_t *u8Buf, uint8_t len)
 {
   uint16_t crc;
   int i;
@@ -97,6 +100,7 @@ TMR_SR_sendBytes(TMR_Reader *reader, uint8_t len, uint8_t *data, uint32_t timeou
   }
 
   ret = transport->sendBytes(transport, len, data, timeoutMs);
+  TMR__TAP_FRAME(reader, true, len, data, ret);
   return ret;
 }
 
@@ -163,11 +167,12 @@ TMR_SR_sendMessage(TMR_Reader *reader, uint8_t *data, uint8_t *opcode, uint32_t
   *opcode = data[2];
  // if (reader->u.serialReader.crcEnabled)
   {
-  crc = tm_crc(&data[1], len + 2);
+  crc = TMR_SR_crc(&data[1], len + 2);
   data[len + 3] = crc >> 8;
   data[len + 4] = crc & 0xff;
   }
   
+  TMR_TRACE(SR_SEND, reader, *opcode, len + 5);
   ret = TMR_SR_sendBytes(reader, len+5, data, timeoutMs);
   return ret;
 }
@@ -218,12 +223,18 @@ retryHeader:
   if (TMR_SUCCESS != ret)
   {
     /* @todo Figure out how many bytes were actually obtained in a failed receive */
-    TMR__notifyTransportListeners(reader, false, inlen, data, timeoutMs);
+    if (NULL != reader->transportListeners)
+    {
+      TMR__notifyTransportListeners(reader, false, inlen, data, timeoutMs);
+    }
+    TMR__TAP_FRAME(reader, false, inlen + headerOffset, data, ret);
+    TMR_TRACE(SR_RECEIVE, reader, opcode, ret);
     return ret;
   }
 
   if (data[0] != (uint8_t)0xFF)
   {
+    TMR__PIPELINE_ADD(reader, resyncs, 1);
     for (i = 1; i < receiveBytesLen; i++) 
     {
       if (data[i] == 0xFF)
@@ -239,6 +250,8 @@ retryHeader:
       /* Retry to get SOH */
       goto retryHeader;
     }
+    TMR__TAP_FRAME(reader, false, receiveBytesLen, data, TMR_ERROR_TIMEOUT);
+    TMR_TRACE(SR_RECEIVE, reader, opcode, TMR_ERROR_TIMEOUT);
     return TMR_ERROR_TIMEOUT;
   }
 
@@ -261,6 +274,8 @@ retryHeader:
      * corrupted packet. Discard it and move on. Return back with TMR_ERROR_TOO_BIG
      * error.
      **/
+    TMR__TAP_FRAME(reader, false, receiveBytesLen, data, TMR_ERROR_TOO_BIG);
+    TMR_TRACE(SR_RECEIVE, reader, opcode, TMR_ERROR_TOO_BIG);
     return TMR_ERROR_TOO_BIG;
   }
   else
@@ -272,10 +287,13 @@ retryHeader:
   {
     TMR__notifyTransportListeners(reader, false, inlen + receiveBytesLen, data, timeoutMs);
   }
+  TMR__PIPELINE_ADD(reader, transportBytes, inlen + receiveBytesLen);
 
   if (TMR_SUCCESS != ret)
   {
     /* before we can actually process the message, we have to properly receive the message */
+    TMR__TAP_FRAME(reader, false, inlen + receiveBytesLen, data, ret);
+    TMR_TRACE(SR_RECEIVE, reader, opcode, ret);
     return ret;
   }
 
@@ -285,13 +303,18 @@ retryHeader:
    **/
   if (reader->u.serialReader.crcEnabled)
   {
-  crc = tm_crc(&data[1], len + 4);
+  crc = TMR_SR_crc(&data[1], len + 4);
   if ((data[len + 5] != (crc >> 8)) ||
       (data[len + 6] != (crc & 0xff)))
   {
+    TMR__PIPELINE_ADD(reader, crcErrors, 1);
+    TMR__TAP_FRAME(reader, false, inlen + receiveBytesLen, data, TMR_ERROR_CRC_ERROR);
+    TMR_TRACE(SR_RECEIVE, reader, data[2], TMR_ERROR_CRC_ERROR);
     return TMR_ERROR_CRC_ERROR;
   }
   }
+  TMR__PIPELINE_ADD(reader, transportFrames, 1);
+  TMR__TAP_FRAME(reader, false, inlen + receiveBytesLen, data, TMR_SUCCESS);
 
   if ((data[2] != opcode) && ((data[2] != 0x2F) || (!reader->continuousReading)))
   {
@@ -300,6 +323,7 @@ retryHeader:
      * a M6e, and thus that the device was rebooted somewhere between
      * the previous command and this one. Report this as a problem.
      */
+    TMR_TRACE(SR_RECEIVE, reader, data[2], TMR_ERROR_DEVICE_RESET);
     return TMR_ERROR_DEVICE_RESET;
  }
 
@@ -318,6 +342,7 @@ retryHeader:
 	  memcpy(reader->u.serialReader.errMsg + strlen(reader->u.serialReader.errMsg), assert + 4, len - 4);
   }
   }  
+  TMR_TRACE(SR_RECEIVE, reader, data[2], ret);
   return ret;
 }
 
@@ -1442,11 +1467,80 @@ TMR_Status TMR_SR_cmdGetTagsRemaining(TMR_Reader *reader, uint16_t *tagCount)
   return TMR_SUCCESS;
 }
 
+/**
+ * Bytes of the fixed size metadata fields selected by flags
+ **/
+static int
+metadataLength(uint16_t flags)
+{
+  int len;
+
+  len = 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_READCOUNT) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_RSSI) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_ANTENNAID) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_FREQUENCY) ? 3 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_TIMESTAMP) ? 4 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_PHASE) ? 2 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_PROTOCOL) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_DATA) ? 2 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS) ? 1 : 0;
+  return len;
+}
+
+/**
+ * Split the data of a gen2 read of all memory banks into the
+ * per-bank lists.  Each bank is a byte holding the bank number in
+ * bits 4-8, a length in words, and the words.
+ **/
+static void
+parseMemoryBanks(TMR_TagReadData *read, uint16_t dataLength)
+{
+  uint16_t readOffSet, bankLength, copyLength;
+  TMR_uint8List *bankData;
+
+  readOffSet = 0;
+  while (readOffSet + 2 <= dataLength)
+  {
+    switch ((read->data.list[readOffSet] >> 4) & 0x1F)
+    {
+      case TMR_GEN2_BANK_EPC:
+        bankData = &read->epcMemData;
+        break;
+      case TMR_GEN2_BANK_RESERVED:
+        bankData = &read->reservedMemData;
+        break;
+      case TMR_GEN2_BANK_TID:
+        bankData = &read->tidMemData;
+        break;
+      case TMR_GEN2_BANK_USER:
+        bankData = &read->userMemData;
+        break;
+      default:
+        /* Unknown bank, so where the next one starts is unknown too */
+        return;
+    }
+    bankLength = read->data.list[readOffSet + 1] * 2;
+    readOffSet += 2;
+    if (bankLength > dataLength - readOffSet)
+    {
+      bankLength = dataLength - readOffSet;
+    }
+    bankData->len = bankLength;
+    copyLength = (bankLength > bankData->max) ? bankData->max : bankLength;
+    if (NULL != bankData->list)
+    {
+      memcpy(bankData->list, read->data.list + readOffSet, copyLength);
+    }
+    readOffSet += bankLength;
+  }
+}
+
 void
 TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint16_t flags,
                                 uint8_t *i, uint8_t msg[])
 {
-  int msgEpcLen;
+  int msgEpcLen, end, crcLen;
 
   read->metadataFlags = flags;
   read->tag.protocol = TMR_TAG_PROTOCOL_NONE;
@@ -1472,7 +1566,28 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
     read->gpioCount = 4;
     break;
   }
-    
+
+  /**
+   * The record must end with the frame payload, at msg[1] + 5 before
+   * the frame CRC: lengths read from a corrupt or cut short record
+   * are clamped to it, so nothing past the frame is copied and the
+   * cursor doesn't wrap.  The cursor is 8 bits, so a frame filling the
+   * whole buffer (CRC off) gives up its last byte.
+   **/
+  end = msg[1] + 5;
+  if (TMR_SR_MAX_PACKET_SIZE - 1 < end)
+  {
+    end = TMR_SR_MAX_PACKET_SIZE - 1;
+  }
+  if (end < *i + metadataLength(flags) + 2)
+  {
+    /* Not even the metadata and EPC length fit */
+    read->data.len = 0;
+    read->tag.epcByteCount = 0;
+    read->tag.crc = 0;
+    *i = (uint8_t)((end < *i) ? *i : end);
+    return;
+  }
 
   /* Fill in tag data from response */
   if (flags & TMR_TRD_METADATA_FLAG_READCOUNT)
@@ -1506,109 +1621,40 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
   if (flags & TMR_TRD_METADATA_FLAG_DATA)
   {
     int msgDataLen, copyLen;
-    
+
     msgDataLen = tm_u8s_per_bits(GETU16(msg, *i));
+    /* Leave the GPIO byte and EPC length in the frame */
+    copyLen = end - *i - 2 - ((flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS) ? 1 : 0);
+    if (msgDataLen > copyLen)
+    {
+      msgDataLen = copyLen;
+    }
     read->data.len = msgDataLen;
     copyLen = msgDataLen;
     if (copyLen > read->data.max)
     {
       copyLen = read->data.max;
     }
-	if (NULL != read->data.list)
-	{
+    if (NULL != read->data.list)
+    {
       memcpy(read->data.list, &msg[*i], copyLen);
-	}
 
-  /**
-   * if the gen2AllMemoryBankEnabled is enbled,
-   * extract the values
-   **/
-  if (reader->u.serialReader.gen2AllMemoryBankEnabled)
-  {
-    uint16_t dataLength = read->data.len;
-    uint8_t readOffSet = 0;
-    uint8_t bank;
-    uint16_t epcDataLength;
-    while (dataLength != 0)
-    {
-      if (readOffSet == dataLength)
-        break;
-      bank = ((read->data.list[readOffSet] >> 4) & 0x1F);
-      epcDataLength = (read->data.list[readOffSet + 1] * 2);
-      switch (bank)
+      /**
+       * if the gen2AllMemoryBankEnabled is enbled,
+       * extract the values
+       **/
+      if (reader->u.serialReader.gen2AllMemoryBankEnabled)
       {
-        case TMR_GEN2_BANK_EPC:
-          {
-            read->epcMemData.len = epcDataLength;
-            if (epcDataLength > read->epcMemData.max)
-            {
-              epcDataLength = read->epcMemData.max;
-            }
-            if (NULL != read->epcMemData.list)
-            {
-              memcpy(read->epcMemData.list, (read->data.list + readOffSet + 2), epcDataLength);
-            }
-            readOffSet += (epcDataLength + 2);
-            break;
-
-          }
-        case TMR_GEN2_BANK_RESERVED:
-          {
-            read->reservedMemData.len = epcDataLength;
-            if (epcDataLength > read->epcMemData.max)
-            {
-              epcDataLength = read->reservedMemData.max;
-            }
-            if (NULL != read->reservedMemData.list)
-            {
-              memcpy(read->reservedMemData.list, (read->data.list + readOffSet + 2), epcDataLength);
-            }
-            readOffSet += (epcDataLength + 2);
-            break;
-
-          }
-        case TMR_GEN2_BANK_TID:
-          {
-            read->tidMemData.len = epcDataLength;
-            if (epcDataLength > read->tidMemData.max)
-            {
-              epcDataLength = read->tidMemData.max;
-            }
-            if (NULL != read->tidMemData.list)
-            {
-              memcpy(read->tidMemData.list, (read->data.list + readOffSet + 2), epcDataLength);
-            }
-            readOffSet += (epcDataLength + 2);
-            break;
-
-          }
-        case TMR_GEN2_BANK_USER:
-          {
-            read->userMemData.len = epcDataLength;
-            if (epcDataLength > read->userMemData.max)
-            {
-              epcDataLength = read->userMemData.max;
-            }
-            if (NULL != read->userMemData.list)
-            {
-              memcpy(read->userMemData.list, (read->data.list + readOffSet + 2), epcDataLength);
-            }
-            readOffSet += (epcDataLength + 2);
-            break;
-
-          }
-        default:
-          break;
+        parseMemoryBanks(read, (uint16_t)copyLen);
       }
     }
-  }
-  /**
-   * Now, we extracted all the values,
-   * Disable the gen2AllMemoryBankEnabled option.
-   **/
-  reader->u.serialReader.gen2AllMemoryBankEnabled = false;
+    /**
+     * Now, we extracted all the values,
+     * Disable the gen2AllMemoryBankEnabled option.
+     **/
+    reader->u.serialReader.gen2AllMemoryBankEnabled = false;
 
-	*i += msgDataLen;
+    *i += msgDataLen;
   }
   if (flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS)
   {
@@ -1627,7 +1673,7 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
     /* ATA protocol does not have TAG CRC */
     msgEpcLen -= 2; /* Remove 2 bytes CRC*/
   }
-  if (TMR_TAG_PROTOCOL_GEN2 == read->tag.protocol)
+  if ((TMR_TAG_PROTOCOL_GEN2 == read->tag.protocol) && (2 <= end - *i))
   {    
     read->tag.u.gen2.pc[0] = GETU8(msg, *i);
     read->tag.u.gen2.pc[1] = GETU8(msg, *i);
@@ -1637,7 +1683,7 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
     /* Add support for XPC bits
      * XPC_W1 is present, when the 6th most significant bit of PC word is set
      */
-    if ((read->tag.u.gen2.pc[0] & 0x02) == 0x02)
+    if (((read->tag.u.gen2.pc[0] & 0x02) == 0x02) && (2 <= end - *i))
     {
       /* When this bit is set, the XPC_W1 word will follow the PC word
        * Our TMR_Gen2_TagData::pc has enough space, so copying to the same.
@@ -1647,7 +1693,7 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
       msgEpcLen -= 2;                           /* EPC length will be length - 4(PC + XPC_W1)*/
       read->tag.u.gen2.pcByteCount += 2;        /* PC bytes are now 4*/
 
-      if ((read->tag.u.gen2.pc[2] & 0x80) == 0x80)
+      if (((read->tag.u.gen2.pc[2] & 0x80) == 0x80) && (2 <= end - *i))
       {
         /*
          * If the most siginificant bit of XPC_W1 is set, then there exists
@@ -1660,6 +1706,16 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
       }
     }    
   }
+  /* The EPC and the tag CRC after it end with the frame */
+  crcLen = (TMR_TAG_PROTOCOL_ATA != read->tag.protocol) ? 2 : 0;
+  if (msgEpcLen > end - *i - crcLen)
+  {
+    msgEpcLen = end - *i - crcLen;
+  }
+  if (msgEpcLen < 0)
+  {
+    msgEpcLen = 0;
+  }
   read->tag.epcByteCount = msgEpcLen;
   if (read->tag.epcByteCount > TMR_MAX_EPC_BYTE_COUNT)
   {
@@ -1668,7 +1724,7 @@ TMR_SR_parseMetadataFromMessage(TMR_Reader *reader, TMR_TagReadData *read, uint1
 
   memcpy(read->tag.epc, &msg[*i], read->tag.epcByteCount);
   *i += msgEpcLen;
-  read->tag.crc = GETU16(msg, *i);
+  read->tag.crc = (*i + 2 <= end) ? GETU16(msg, *i) : 0;
 
   if(reader->continuousReading)
   {
@@ -1829,6 +1885,14 @@ TMR_SR_postprocessReaderSpecificMetadata(TMR_TagReadData *read, TMR_SR_SerialRea
       }
     }
   }
+
+#ifdef TMR_ENABLE_PHASE_CAL
+  /* Now that the antenna is the logical one */
+  if (NULL != sr->phaseCal)
+  {
+    TMR_phaseCalApply(sr->phaseCal, read);
+  }
+#endif
 }
 
 #ifdef TMR_ENABLE_ISO180006B
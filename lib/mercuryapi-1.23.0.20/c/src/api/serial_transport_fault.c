@@ -0,0 +1,533 @@
+/**
+ *  @file serial_transport_fault.c
+ *  @brief Mercury API - Fault injection serial transport
+ *
+ * Wraps another serial transport (see tmr_fault.h).  When a fault is
+ * due the next receive draws its kind and positions from the seeded
+ * generator and applies it:
+ *
+ *   drop        1 to dropBytes bytes at a random place in the receive
+ *               are lost, and as many more are read in their place
+ *   corrupt     one bit of one received byte is flipped
+ *   stall       receives wait and time out until stallMs is over;
+ *               the wrapped transport keeps the bytes meanwhile
+ *   partial     a receive gets a random part of its bytes and times
+ *               out, the rest of them are lost
+ *   disconnect  for disconnectMs sends fail with EIO and receives time
+ *               out at once, as the native transport does when the
+ *               adapter goes away; afterwards the wrapped transport is
+ *               flushed, since nothing sent meanwhile was received
+ *
+ * When measuring, a fault is recovered from at the first tag read
+ * delivered after it is over, and the next fault is scheduled from
+ * then, so faults never overlap.  Otherwise it is scheduled from the
+ * end of the fault.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_FAULT
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "tm_reader.h"
+#include "tmr_fault.h"
+#include "osdep.h"
+
+static const char *faultKindNames[TMR_FAULT_KINDS] = {
+  "drop",
+  "corrupt",
+  "stall",
+  "partial",
+  "disconnect",
+};
+
+static uint64_t
+fault_nowUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* xorshift32, never zero */
+static uint32_t
+fault_random(TMR_FaultInjector *fi)
+{
+  uint32_t x = fi->rng;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  fi->rng = x;
+  return x;
+}
+
+static uint64_t
+fault_intervalUs(TMR_FaultInjector *fi)
+{
+  uint32_t ms;
+
+  ms = fi->config.intervalMs / 2 + fault_random(fi) % (fi->config.intervalMs + 1);
+  return (uint64_t)ms * 1000;
+}
+
+static TMR_FaultKind
+fault_pickKind(TMR_FaultInjector *fi)
+{
+  uint32_t kinds, n, k;
+
+  kinds = fi->config.kinds & TMR_FAULT_ALL;
+  for (n = 0, k = 0; k < TMR_FAULT_KINDS; k++)
+  {
+    n += (kinds >> k) & 1;
+  }
+  n = fault_random(fi) % n;
+  for (k = 0; k < TMR_FAULT_KINDS; k++)
+  {
+    if (kinds & TMR_FAULT_BIT(k))
+    {
+      if (0 == n)
+      {
+        break;
+      }
+      n--;
+    }
+  }
+  return (TMR_FaultKind)k;
+}
+
+/**
+ * Start the next fault if it is due.  Called with the lock held.
+ *
+ * @return The record of the fault, or NULL
+ **/
+static TMR_FaultRecord *
+fault_inject(TMR_FaultInjector *fi, uint64_t now)
+{
+  TMR_FaultRecord *r;
+
+  if ((0 == fi->nextFaultUs) || (now < fi->nextFaultUs)
+      || (fi->faults >= fi->config.maxFaults))
+  {
+    return NULL;
+  }
+
+  if ((now > fi->windowStartUs) && (0 < fi->windowReads))
+  {
+    fi->readRate = (double)fi->windowReads / (now - fi->windowStartUs);
+  }
+
+  r = &fi->records[fi->faults];
+  memset(r, 0, sizeof(*r));
+  r->kind = fault_pickKind(fi);
+  r->injectedUs = now;
+  r->clearedUs = now;
+  if (TMR_FAULT_STALL == r->kind)
+  {
+    fi->stalledUntilUs = r->clearedUs = now + (uint64_t)fi->config.stallMs * 1000;
+  }
+  else if (TMR_FAULT_DISCONNECT == r->kind)
+  {
+    fi->disconnectedUntilUs = r->clearedUs = now + (uint64_t)fi->config.disconnectMs * 1000;
+    fi->reconnectFlush = true;
+  }
+
+  if (NULL != fi->reader)
+  {
+    /* Scheduled again on recovery */
+    fi->pending = (int32_t)fi->faults;
+    fi->nextFaultUs = 0;
+  }
+  else
+  {
+    fi->nextFaultUs = r->clearedUs + fault_intervalUs(fi);
+  }
+  fi->faults++;
+
+  return r;
+}
+
+/**
+ * Whether the line is down.  Called with the lock held; flushes the
+ * wrapped transport once a disconnect is over.
+ **/
+static bool
+fault_disconnected(TMR_FaultInjector *fi, uint64_t now)
+{
+  if (now < fi->disconnectedUntilUs)
+  {
+    return true;
+  }
+  if (fi->reconnectFlush)
+  {
+    fi->reconnectFlush = false;
+    fi->inner.flush(&fi->inner);
+  }
+  return false;
+}
+
+static TMR_Status
+f_open(TMR_SR_SerialTransport *this)
+{
+  TMR_FaultInjector *fi;
+  TMR_Status ret;
+
+  fi = this->cookie;
+  ret = fi->inner.open(&fi->inner);
+  if (TMR_SUCCESS == ret)
+  {
+    pthread_mutex_lock(&fi->lock);
+    if ((NULL == fi->reader) || (0 > fi->pending))
+    {
+      fi->nextFaultUs = fault_nowUs() + (uint64_t)fi->config.startAfterMs * 1000;
+    }
+    pthread_mutex_unlock(&fi->lock);
+  }
+  return ret;
+}
+
+static TMR_Status
+f_sendBytes(TMR_SR_SerialTransport *this, uint32_t length,
+            uint8_t* message, const uint32_t timeoutMs)
+{
+  TMR_FaultInjector *fi;
+  bool down;
+
+  fi = this->cookie;
+  pthread_mutex_lock(&fi->lock);
+  down = fault_disconnected(fi, fault_nowUs());
+  pthread_mutex_unlock(&fi->lock);
+  if (down)
+  {
+    return TMR_ERROR_COMM_ERRNO(EIO);
+  }
+
+  return fi->inner.sendBytes(&fi->inner, length, message, timeoutMs);
+}
+
+static TMR_Status
+f_receiveBytes(TMR_SR_SerialTransport *this, uint32_t length,
+               uint32_t* messageLength, uint8_t* message, const uint32_t timeoutMs)
+{
+  TMR_FaultInjector *fi;
+  TMR_FaultRecord *r;
+  TMR_FaultKind kind;
+  TMR_Status ret;
+  uint64_t now, stalledUntil;
+  uint32_t timeout, r1, r2, n, at;
+
+  fi = this->cookie;
+  *messageLength = 0;
+  timeout = timeoutMs;
+
+  pthread_mutex_lock(&fi->lock);
+  now = fault_nowUs();
+  r = fault_inject(fi, now);
+  kind = TMR_FAULT_KINDS;
+  r1 = r2 = 0;
+  if (NULL != r)
+  {
+    kind = r->kind;
+    r1 = fault_random(fi);
+    r2 = fault_random(fi);
+  }
+  stalledUntil = fi->stalledUntilUs;
+  if (fault_disconnected(fi, now))
+  {
+    pthread_mutex_unlock(&fi->lock);
+    return TMR_ERROR_TIMEOUT;
+  }
+  pthread_mutex_unlock(&fi->lock);
+
+  if (now < stalledUntil)
+  {
+    uint64_t waitMs;
+
+    waitMs = (stalledUntil - now + 999) / 1000;
+    if (waitMs >= timeout)
+    {
+      tmr_sleep(timeout);
+      return TMR_ERROR_TIMEOUT;
+    }
+    tmr_sleep((uint32_t)waitMs);
+    timeout -= (uint32_t)waitMs;
+  }
+
+  ret = fi->inner.receiveBytes(&fi->inner, length, messageLength, message, timeout);
+  if (0 == *messageLength)
+  {
+    return ret;
+  }
+
+  switch (kind)
+  {
+    case TMR_FAULT_DROP:
+      n = 1 + r1 % fi->config.dropBytes;
+      at = r2 % *messageLength;
+      if (n > *messageLength - at)
+      {
+        n = *messageLength - at;
+      }
+      memmove(message + at, message + at + n, *messageLength - at - n);
+      *messageLength -= n;
+      if (TMR_SUCCESS == ret)
+      {
+        uint32_t more = 0;
+
+        ret = fi->inner.receiveBytes(&fi->inner, n, &more,
+                                     message + *messageLength, timeout);
+        *messageLength += more;
+      }
+      break;
+
+    case TMR_FAULT_CORRUPT:
+      message[r1 % *messageLength] ^= (uint8_t)(1 << (r2 % 8));
+      break;
+
+    case TMR_FAULT_PARTIAL:
+      *messageLength = (1 < *messageLength) ? 1 + r1 % (*messageLength - 1) : 0;
+      ret = TMR_ERROR_TIMEOUT;
+      break;
+
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static TMR_Status
+f_setBaudRate(TMR_SR_SerialTransport *this, uint32_t rate)
+{
+  TMR_FaultInjector *fi;
+
+  fi = this->cookie;
+  return fi->inner.setBaudRate(&fi->inner, rate);
+}
+
+static TMR_Status
+f_shutdown(TMR_SR_SerialTransport *this)
+{
+  TMR_FaultInjector *fi;
+
+  fi = this->cookie;
+  return fi->inner.shutdown(&fi->inner);
+}
+
+static TMR_Status
+f_flush(TMR_SR_SerialTransport *this)
+{
+  TMR_FaultInjector *fi;
+
+  fi = this->cookie;
+  return fi->inner.flush(&fi->inner);
+}
+
+static void
+fault_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_FaultInjector *fi = cookie;
+  TMR_FaultRecord *r;
+  uint64_t now;
+
+  now = fault_nowUs();
+  pthread_mutex_lock(&fi->lock);
+  fi->windowReads++;
+  if (0 <= fi->pending)
+  {
+    r = &fi->records[fi->pending];
+    if (now >= r->clearedUs)
+    {
+      r->recoveredUs = now;
+      r->readsLost = (uint32_t)(fi->readRate * (now - r->injectedUs) + 0.5);
+      fi->pending = -1;
+      fi->windowReads = 0;
+      fi->windowStartUs = now;
+      fi->nextFaultUs = now + fault_intervalUs(fi);
+    }
+  }
+  pthread_mutex_unlock(&fi->lock);
+}
+
+static void
+fault_exceptionListener(TMR_Reader *reader, TMR_Status error, void *cookie)
+{
+  TMR_FaultInjector *fi = cookie;
+
+  pthread_mutex_lock(&fi->lock);
+  if (0 <= fi->pending)
+  {
+    fi->records[fi->pending].exceptions++;
+    fi->records[fi->pending].lastException = error;
+  }
+  pthread_mutex_unlock(&fi->lock);
+}
+
+void
+TMR_faultInitConfig(TMR_FaultConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->seed = 1;
+  config->kinds = TMR_FAULT_ALL;
+  config->startAfterMs = 1000;
+  config->intervalMs = 2000;
+  config->stallMs = 1500;
+  config->disconnectMs = 1000;
+  config->dropBytes = 4;
+  config->maxFaults = TMR_FAULT_MAX_RECORDS;
+}
+
+TMR_Status
+TMR_SR_SerialTransportFaultInit(TMR_SR_SerialTransport *transport,
+                                TMR_FaultInjector *injector,
+                                const TMR_FaultConfig *config)
+{
+  if ((0 == (config->kinds & TMR_FAULT_ALL)) || (0 == config->dropBytes))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(injector, 0, sizeof(*injector));
+  injector->inner = *transport;
+  injector->config = *config;
+  if ((0 == injector->config.maxFaults)
+      || (TMR_FAULT_MAX_RECORDS < injector->config.maxFaults))
+  {
+    injector->config.maxFaults = TMR_FAULT_MAX_RECORDS;
+  }
+  injector->rng = (0 != config->seed) ? config->seed : 1;
+  injector->pending = -1;
+  injector->windowStartUs = fault_nowUs();
+  injector->nextFaultUs = injector->windowStartUs + (uint64_t)config->startAfterMs * 1000;
+  pthread_mutex_init(&injector->lock, NULL);
+
+  transport->cookie = injector;
+  transport->open = f_open;
+  transport->sendBytes = f_sendBytes;
+  transport->receiveBytes = f_receiveBytes;
+  transport->setBaudRate = f_setBaudRate;
+  transport->shutdown = f_shutdown;
+  transport->flush = f_flush;
+
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_startFaultInjection(TMR_Reader *reader, TMR_FaultInjector *injector,
+                        const TMR_FaultConfig *config)
+{
+  TMR_Status ret;
+
+  if (TMR_READER_TYPE_SERIAL != reader->readerType)
+  {
+    return TMR_ERROR_UNSUPPORTED;
+  }
+  if (f_open == reader->u.serialReader.transport.open)
+  {
+    /* Already injecting */
+    return TMR_ERROR_INVALID;
+  }
+
+  ret = TMR_SR_SerialTransportFaultInit(&reader->u.serialReader.transport, injector, config);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  injector->reader = reader;
+  injector->readListener.listener = fault_readListener;
+  injector->readListener.cookie = injector;
+  injector->exceptionListener.listener = fault_exceptionListener;
+  injector->exceptionListener.cookie = injector;
+  TMR_addReadListener(reader, &injector->readListener);
+  TMR_addReadExceptionListener(reader, &injector->exceptionListener);
+
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_stopFaultInjection(TMR_Reader *reader, TMR_FaultInjector *injector)
+{
+  if ((TMR_READER_TYPE_SERIAL != reader->readerType)
+      || (injector != reader->u.serialReader.transport.cookie))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  TMR_removeReadListener(reader, &injector->readListener);
+  TMR_removeReadExceptionListener(reader, &injector->exceptionListener);
+  reader->u.serialReader.transport = injector->inner;
+  injector->reader = NULL;
+  pthread_mutex_destroy(&injector->lock);
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_faultSummary(TMR_FaultInjector *injector, TMR_FaultKind kind,
+                 TMR_FaultSummary *summary)
+{
+  const TMR_FaultRecord *r;
+  uint64_t us;
+  uint32_t i;
+
+  memset(summary, 0, sizeof(*summary));
+  for (i = 0; i < injector->faults; i++)
+  {
+    r = &injector->records[i];
+    if (kind != r->kind)
+    {
+      continue;
+    }
+    summary->injected++;
+    if (0 == r->recoveredUs)
+    {
+      continue;
+    }
+    us = r->recoveredUs - r->clearedUs;
+    summary->recovered++;
+    summary->totalRecoveryUs += us;
+    if (us > summary->maxRecoveryUs)
+    {
+      summary->maxRecoveryUs = us;
+    }
+    summary->readsLost += r->readsLost;
+  }
+}
+
+const char *
+TMR_faultKindName(TMR_FaultKind kind)
+{
+  if ((unsigned)kind < TMR_FAULT_KINDS)
+  {
+    return faultKindNames[kind];
+  }
+  return "unknown";
+}
+
+#endif /* TMR_ENABLE_SERIAL_TRANSPORT_FAULT */
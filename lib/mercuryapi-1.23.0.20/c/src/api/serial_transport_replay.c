@@ -0,0 +1,400 @@
+/**
+ *  @file serial_transport_replay.c
+ *  @brief Mercury API - Capture replay serial transport
+ *
+ * A serial transport that plays back a capture written by
+ * TMR_startTransportCapture() (see tmr_capture.h), so a field session
+ * can be run again through the serial reader layer without the
+ * device.  Create the reader with
+ *
+ *   replay:///path/to/session.tmrcap?speed=10
+ *
+ * Options, all optional, separated by '&':
+ *   speed=N    playback speed multiplier, 0 for as fast as possible (default 1)
+ *
+ * Each send from the host is matched to the next captured send with
+ * the same bytes, looking a few sends ahead so commands the host
+ * issues on its own timers (statistics, stop) may move, or to the
+ * next captured send if none matches.  The captured receives that
+ * followed it are delivered at the captured offsets from it, divided
+ * by the speed.  Receives skipped over by a send were never read by
+ * the host and are dropped.  When the capture is exhausted, or waits
+ * for a send the host has not made yet, receives time out.
+ *
+ * At speed 0 the first reply to each command still takes its captured
+ * time, since the host times its own commands (a search returning
+ * early is reissued for the rest of the read), but everything after
+ * it, such as a continuous reading stream, is delivered immediately.
+ */
+
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tm_reader.h"
+#include "tmr_capture.h"
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_REPLAY
+
+/* How many captured sends to look past for one matching the host */
+#define REPLAY_MATCH_WINDOW 16
+
+typedef struct ReplayState
+{
+  TMR_SR_SerialPortNativeContext *context;
+
+  /* The mapped capture */
+  const uint8_t *map;
+  uint64_t mapLength;
+
+  /* Options from the URI */
+  uint32_t speed;
+
+  /* Offset of the next record not yet delivered or matched */
+  uint64_t next;
+  /* Bytes of the receive record at next already delivered */
+  uint32_t delivered;
+  /* Whether the last matched send has had a reply yet */
+  bool replied;
+
+  /* Capture and host time of the last matched send */
+  uint64_t baseCaptureUs;
+  uint64_t baseHostUs;
+
+  /* Sends and background receives come from different threads */
+  pthread_mutex_t lock;
+  /* Signalled on every send, which may make new receives due */
+  pthread_cond_t sent;
+} ReplayState;
+
+static uint64_t
+replay_nowUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/* Wait, with the lock held, until the given time or the next send */
+static void
+replay_waitUntil(ReplayState *s, uint64_t us)
+{
+  struct timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+  pthread_cond_timedwait(&s->sent, &s->lock, &ts);
+}
+
+static void
+replay_parseOptions(ReplayState *s, const char *device, char *path, size_t pathSize)
+{
+  const char *p;
+  size_t len;
+
+  s->speed = 1;
+
+  p = strchr(device, '?');
+  len = (NULL == p) ? strlen(device) : (size_t)(p - device);
+  len = (len < pathSize) ? len : pathSize - 1;
+  memcpy(path, device, len);
+  path[len] = '\0';
+
+  while (NULL != p)
+  {
+    const char *value;
+
+    p++;
+    value = strchr(p, '=');
+    if (NULL == value)
+    {
+      break;
+    }
+    if (0 == strncmp(p, "speed=", 6))
+    {
+      s->speed = (uint32_t)strtoul(value + 1, NULL, 10);
+    }
+    p = strchr(p, '&');
+  }
+}
+
+static TMR_Status
+r_open(TMR_SR_SerialTransport *this)
+{
+  TMR_SR_SerialPortNativeContext *c;
+  TMR_CaptureFileHeader header;
+  pthread_condattr_t attr;
+  ReplayState *s;
+  struct stat st;
+  char path[TMR_MAX_READER_NAME_LENGTH];
+  void *map;
+  int fd;
+
+  c = this->cookie;
+  s = calloc(1, sizeof(*s));
+  if (NULL == s)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  s->context = c;
+  replay_parseOptions(s, c->devicename, path, sizeof(path));
+
+  fd = open(path, O_RDONLY);
+  if (-1 == fd)
+  {
+    free(s);
+    return TMR_ERROR_COMM_ERRNO(errno);
+  }
+  if ((0 != fstat(fd, &st)) || (TMR_CAPTURE_HEADER_SIZE > st.st_size))
+  {
+    close(fd);
+    free(s);
+    return TMR_ERROR_INVALID;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == map)
+  {
+    free(s);
+    return TMR_ERROR_COMM_ERRNO(errno);
+  }
+  s->map = map;
+  s->mapLength = st.st_size;
+
+  if ((TMR_SUCCESS != TMR_captureParseHeader(s->map, TMR_CAPTURE_HEADER_SIZE, &header))
+      || (TMR_READER_TYPE_SERIAL != header.readerType))
+  {
+    munmap(map, st.st_size);
+    free(s);
+    return TMR_ERROR_INVALID;
+  }
+  s->next = header.headerSize;
+  s->baseCaptureUs = 0;
+  s->baseHostUs = replay_nowUs();
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&s->sent, &attr);
+  pthread_condattr_destroy(&attr);
+
+  this->cookie = s;
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+r_sendBytes(TMR_SR_SerialTransport *this, uint32_t length,
+            uint8_t* message, const uint32_t timeoutMs)
+{
+  ReplayState *s;
+  TMR_CaptureRecord record;
+  const uint8_t *data;
+  uint64_t offset, first, firstTimeUs;
+  uint32_t sends;
+
+  s = this->cookie;
+
+  pthread_mutex_lock(&s->lock);
+  first = 0;
+  firstTimeUs = 0;
+  sends = 0;
+  offset = s->next;
+  while ((sends < REPLAY_MATCH_WINDOW)
+         && (TMR_SUCCESS == TMR_captureNextRecord(s->map, s->mapLength, &offset, &record, &data)))
+  {
+    if (TMR_CAPTURE_TX != record.direction)
+    {
+      continue;
+    }
+    if ((record.length == length) && (0 == memcmp(data, message, length)))
+    {
+      first = offset;
+      firstTimeUs = record.timeUs;
+      break;
+    }
+    if (0 == first)
+    {
+      /* Fall back to the next send if nothing matches */
+      first = offset;
+      firstTimeUs = record.timeUs;
+    }
+    sends++;
+  }
+  if (0 != first)
+  {
+    s->next = first;
+    s->delivered = 0;
+    s->replied = false;
+    s->baseCaptureUs = firstTimeUs;
+    s->baseHostUs = replay_nowUs();
+  }
+  pthread_cond_broadcast(&s->sent);
+  pthread_mutex_unlock(&s->lock);
+
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+r_receiveBytes(TMR_SR_SerialTransport *this, uint32_t length,
+               uint32_t* messageLength, uint8_t* message, const uint32_t timeoutMs)
+{
+  ReplayState *s;
+  TMR_CaptureRecord record;
+  const uint8_t *data;
+  uint64_t offset, deadline, due, now;
+  uint32_t n;
+  TMR_Status ret;
+
+  s = this->cookie;
+  *messageLength = 0;
+  deadline = replay_nowUs() + (uint64_t)timeoutMs * 1000;
+  ret = TMR_SUCCESS;
+
+  pthread_mutex_lock(&s->lock);
+  while (*messageLength < length)
+  {
+    offset = s->next;
+    if ((TMR_SUCCESS != TMR_captureNextRecord(s->map, s->mapLength, &offset, &record, &data))
+        || (TMR_CAPTURE_TX == record.direction))
+    {
+      /* Nothing more until the host sends */
+      due = UINT64_MAX;
+    }
+    else if ((0 != s->speed) || (false == s->replied))
+    {
+      due = s->baseHostUs;
+      if (record.timeUs > s->baseCaptureUs)
+      {
+        due += (record.timeUs - s->baseCaptureUs) / ((0 != s->speed) ? s->speed : 1);
+      }
+    }
+    else
+    {
+      due = 0;
+    }
+
+    now = replay_nowUs();
+    if (due > now)
+    {
+      /* A quiet device takes the whole timeout to say so */
+      if (now >= deadline)
+      {
+        ret = TMR_ERROR_TIMEOUT;
+        break;
+      }
+      replay_waitUntil(s, (due < deadline) ? due : deadline);
+      continue;
+    }
+
+    n = record.length - s->delivered;
+    if (n > length - *messageLength)
+    {
+      n = length - *messageLength;
+    }
+    memcpy(message + *messageLength, data + s->delivered, n);
+    *messageLength += n;
+    s->delivered += n;
+    s->replied = true;
+    if (s->delivered == record.length)
+    {
+      s->next = offset;
+      s->delivered = 0;
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+
+  return ret;
+}
+
+
+static TMR_Status
+r_setBaudRate(TMR_SR_SerialTransport *this, uint32_t rate)
+{
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+r_shutdown(TMR_SR_SerialTransport *this)
+{
+  ReplayState *s;
+
+  s = this->cookie;
+  this->cookie = s->context;
+  pthread_cond_destroy(&s->sent);
+  pthread_mutex_destroy(&s->lock);
+  munmap((void *)s->map, s->mapLength);
+  free(s);
+
+  return TMR_SUCCESS;
+}
+
+static TMR_Status
+r_flush(TMR_SR_SerialTransport *this)
+{
+  /* Flushed bytes were never received, so they are not in the capture */
+  return TMR_SUCCESS;
+}
+
+/**
+ * Initialize a TMR_SR_SerialTransport structure with a capture
+ * replay.  The capture is opened at open time.
+ *
+ * @param transport The TMR_SR_SerialTransport structure to initialize.
+ * @param context A TMR_SR_SerialPortNativeContext structure for the callbacks to use.
+ * @param device The capture path and options, such as @c /tmp/dock.tmrcap?speed=0
+ */
+TMR_Status
+TMR_SR_SerialTransportReplayInit(TMR_SR_SerialTransport *transport,
+                                 TMR_SR_SerialPortNativeContext *context,
+                                 const char *device)
+{
+  if (strlen(device) + 1 > TMR_MAX_READER_NAME_LENGTH)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  strcpy(context->devicename, device);
+
+  transport->cookie = context;
+  transport->open = r_open;
+  transport->sendBytes = r_sendBytes;
+  transport->receiveBytes = r_receiveBytes;
+  transport->setBaudRate = r_setBaudRate;
+  transport->shutdown = r_shutdown;
+  transport->flush = r_flush;
+
+  return TMR_SUCCESS;
+}
+
+#endif /* TMR_ENABLE_SERIAL_TRANSPORT_REPLAY */
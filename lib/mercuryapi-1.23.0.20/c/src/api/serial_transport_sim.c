@@ -0,0 +1,1317 @@
+/**
+ *  @file serial_transport_sim.c
+ *  @brief Mercury API - Simulated M6e module serial transport
+ *
+ * A serial transport that answers the host side of the serial reader
+ * protocol itself instead of talking to a device, so the serial reader
+ * layer and the background read pipeline can be exercised and timed
+ * without hardware.  Register it with
+ *
+ *   TMR_setSerialTransport("sim", &TMR_SR_SerialTransportSimInit);
+ *
+ * (done by default when TMR_ENABLE_SERIAL_TRANSPORT_SIM is defined) and
+ * create the reader with a URI such as
+ *
+ *   sim:///m6e?tags=200&rate=5000&baud=921600&pace=1
+ *
+ * Options, all optional, separated by '&':
+ *   tags=N     tag population size (default 20)
+ *   epc=N      EPC length in bytes, even, 4 to 30 (default 12)
+ *   rate=N     tag reads per second, 0 for as fast as possible (default 1000)
+ *   ant=N      number of antenna ports (default 4)
+ *   baud=N     initial baud rate (default 115200)
+ *   pace=0|1   delay each byte by its time on the wire at the current baud rate
+ *   sync=0|1   hold sync search replies for the search timeout (default 1)
+ *   cycle=N    milliseconds between end of search cycle stream messages (default 50)
+ *   crcerr=N   corrupt the CRC of one in N tag read messages (default 0, off)
+ *   jitter=N   delay each message by up to N microseconds (default 0)
+ *   seed=N     random seed, also used in the EPCs (default 1)
+ *   range=N    tag n stands N + 25 * (n % 8) centimetres from the antennas
+ *              and its phase follows the carrier frequency, give or take
+ *              2 degrees (default 0, random phase)
+ *   cable=N    with range, port p has (p - 1) * N centimetres more cable than
+ *              port 1, which shifts its phase (default 0)
+ *
+ * The module side covers boot (version, current program, boot
+ * firmware), reader and protocol configuration get/set, sync
+ * searches through READ_TAG_ID_MULTIPLE and GET_TAG_ID_BUFFER, and
+ * continuous reading through MULTI_PROTOCOL_TAG_OP.  Embedded tag
+ * operations and other commands are answered with an error.
+ *
+ * Reads come from the antennas of the search list the host last set,
+ * in its order.  A sync search moves to the next antenna after each
+ * pass over the population; continuous reading dwells on each antenna
+ * for the search time over the length of the list, as the module
+ * does.
+ */
+
+
+/*
+ * Copyright (c) 2010 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "tm_reader.h"
+#include "serial_reader_imp.h"
+#include "tmr_utils.h"
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_SIM
+
+#define SIM_MAX_PAYLOAD    240
+#define SIM_IN_BUFFER_SIZE 512
+#define SIM_OUT_BUFFER_SIZE 4096
+#define SIM_MAX_SETTINGS   64
+#define SIM_MAX_SETTING_LENGTH 16
+
+/* Status codes of the serial protocol */
+#define SIM_STATUS_OK             0x0000
+#define SIM_STATUS_INVALID_OPCODE 0x0101
+#define SIM_STATUS_INVALID_VALUE  0x0105
+#define SIM_STATUS_NO_TAGS_FOUND  0x0400
+
+/* Stream message options */
+#define SIM_STREAM_OPTION         0x10
+#define SIM_STREAM_SEARCH_FLAGS   0x001B
+
+/**
+ * A reader or protocol configuration value last set by the host,
+ * returned as is by the matching get command.
+ **/
+typedef struct SimSetting
+{
+  uint16_t key;
+  uint8_t len;
+  uint8_t value[SIM_MAX_SETTING_LENGTH];
+} SimSetting;
+
+/** One entry of the module tag buffer */
+typedef struct SimBufferedTag
+{
+  uint32_t id;
+  uint8_t readCount;
+  int8_t rssi;
+  uint8_t antenna;
+  uint32_t offsetMs;
+} SimBufferedTag;
+
+typedef struct SimState
+{
+  TMR_SR_SerialPortNativeContext *context;
+
+  /* Options from the URI */
+  uint32_t tagCount;
+  uint8_t epcLen;
+  uint32_t readRate;
+  uint8_t antennaCount;
+  uint32_t baudRate;
+  bool pace;
+  bool syncTiming;
+  uint32_t cycleMs;
+  uint32_t crcErrorRate;
+  uint32_t jitterUs;
+  uint32_t seed;
+  uint32_t rangeCm;
+  uint32_t cableCm;
+
+  /* Module state */
+  uint16_t protocol;
+  uint8_t region;
+  bool sendCrc;
+  SimSetting settings[SIM_MAX_SETTINGS];
+  uint8_t settingCount;
+
+  /* Tag buffer, and where each tag of the population is in it */
+  SimBufferedTag *buffer;
+  int32_t *bufferIndex;
+  uint32_t bufferLen;
+  uint32_t bufferRead;
+  uint64_t searchStartUs;
+
+  /* Continuous reading */
+  bool streaming;
+  uint64_t streamStartUs;
+  uint64_t lastCycleUs;
+  uint64_t streamed;
+
+  uint32_t nextTag;
+  uint8_t nextAntenna;
+  /* Antenna search list, empty for every port, and the streaming dwell */
+  uint8_t searchList[16];
+  uint8_t searchLen;
+  uint32_t dwellUs;
+  uint32_t random;
+
+  /* Host to module bytes not yet processed */
+  uint8_t in[SIM_IN_BUFFER_SIZE];
+  uint32_t inLen;
+
+  /* Module to host bytes not yet received, and when they may be */
+  uint8_t out[SIM_OUT_BUFFER_SIZE];
+  uint32_t outStart;
+  uint32_t outEnd;
+  uint64_t holdUntilUs;
+
+  /* Sending (stop reading) and receiving run on different threads */
+  pthread_mutex_t lock;
+} SimState;
+
+/*
+ * ThingMagic-mutated CRC used for messages, as in serial_reader_l3.c
+ */
+static const uint16_t simCrcTable[] =
+{
+  0x0000, 0x1021, 0x2042, 0x3063,
+  0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b,
+  0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+static uint16_t
+sim_crc(const uint8_t *u8Buf, uint32_t len)
+{
+  uint16_t crc;
+  uint32_t i;
+
+  crc = 0xffff;
+
+  for (i = 0; i < len ; i++)
+  {
+    crc = ((crc << 4) | (u8Buf[i] >> 4))  ^ simCrcTable[crc >> 12];
+    crc = ((crc << 4) | (u8Buf[i] & 0xf)) ^ simCrcTable[crc >> 12];
+  }
+
+  return crc;
+}
+
+static uint64_t
+sim_nowUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static void
+sim_sleepUs(uint64_t us)
+{
+  struct timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (us % 1000000) * 1000;
+  nanosleep(&ts, NULL);
+}
+
+static uint32_t
+sim_random(SimState *s)
+{
+  /* xorshift32 */
+  s->random ^= s->random << 13;
+  s->random ^= s->random >> 17;
+  s->random ^= s->random << 5;
+  return s->random;
+}
+
+/**
+ * Time the given number of bytes spend on the wire, 10 bits per byte
+ **/
+static void
+sim_pace(SimState *s, uint32_t length)
+{
+  if (s->pace && (0 != s->baudRate))
+  {
+    sim_sleepUs(((uint64_t)length * 10 * 1000000) / s->baudRate);
+  }
+}
+
+static void
+sim_parseOptions(SimState *s, const char *device)
+{
+  const char *p;
+
+  s->tagCount = 20;
+  s->epcLen = 12;
+  s->readRate = 1000;
+  s->antennaCount = 4;
+  s->baudRate = 115200;
+  s->pace = false;
+  s->syncTiming = true;
+  s->cycleMs = 50;
+  s->crcErrorRate = 0;
+  s->jitterUs = 0;
+  s->seed = 1;
+  s->rangeCm = 0;
+  s->cableCm = 0;
+
+  p = strchr(device, '?');
+  while (NULL != p)
+  {
+    const char *value;
+    uint32_t n;
+
+    p++;
+    value = strchr(p, '=');
+    if (NULL == value)
+    {
+      break;
+    }
+    n = (uint32_t)strtoul(value + 1, NULL, 10);
+
+    if (0 == strncmp(p, "tags=", 5))
+    {
+      s->tagCount = n;
+    }
+    else if (0 == strncmp(p, "epc=", 4))
+    {
+      s->epcLen = (uint8_t)((n < 4) ? 4 : ((n > 30) ? 30 : (n & ~1)));
+    }
+    else if (0 == strncmp(p, "rate=", 5))
+    {
+      s->readRate = n;
+    }
+    else if (0 == strncmp(p, "ant=", 4))
+    {
+      s->antennaCount = (uint8_t)((0 == n) ? 1 : ((n > 16) ? 16 : n));
+    }
+    else if (0 == strncmp(p, "baud=", 5))
+    {
+      s->baudRate = n;
+    }
+    else if (0 == strncmp(p, "pace=", 5))
+    {
+      s->pace = (0 != n);
+    }
+    else if (0 == strncmp(p, "sync=", 5))
+    {
+      s->syncTiming = (0 != n);
+    }
+    else if (0 == strncmp(p, "cycle=", 6))
+    {
+      s->cycleMs = (0 == n) ? 1 : n;
+    }
+    else if (0 == strncmp(p, "crcerr=", 7))
+    {
+      s->crcErrorRate = n;
+    }
+    else if (0 == strncmp(p, "jitter=", 7))
+    {
+      s->jitterUs = n;
+    }
+    else if (0 == strncmp(p, "seed=", 5))
+    {
+      s->seed = n;
+    }
+    else if (0 == strncmp(p, "range=", 6))
+    {
+      s->rangeCm = n;
+    }
+    else if (0 == strncmp(p, "cable=", 6))
+    {
+      s->cableCm = n;
+    }
+    p = strchr(p, '&');
+  }
+}
+
+static SimSetting *
+sim_findSetting(SimState *s, uint16_t key)
+{
+  uint8_t i;
+
+  for (i = 0; i < s->settingCount; i++)
+  {
+    if (key == s->settings[i].key)
+    {
+      return &s->settings[i];
+    }
+  }
+  return NULL;
+}
+
+static void
+sim_storeSetting(SimState *s, uint16_t key, const uint8_t *value, uint8_t len)
+{
+  SimSetting *setting;
+
+  setting = sim_findSetting(s, key);
+  if (NULL == setting)
+  {
+    if (SIM_MAX_SETTINGS == s->settingCount)
+    {
+      return;
+    }
+    setting = &s->settings[s->settingCount++];
+    setting->key = key;
+  }
+  if (SIM_MAX_SETTING_LENGTH < len)
+  {
+    len = SIM_MAX_SETTING_LENGTH;
+  }
+  memcpy(setting->value, value, len);
+  setting->len = len;
+}
+
+/**
+ * Append a response message to the outgoing bytes.
+ *
+ * @param tagData Whether the message carries tag reads, the only
+ * messages eligible for CRC error injection, so that connecting and
+ * configuring stay reliable.
+ **/
+static void
+sim_queueMessage(SimState *s, uint8_t opcode, uint16_t status,
+                 const uint8_t *payload, uint8_t len, bool tagData)
+{
+  uint8_t *msg;
+  uint16_t crc;
+  uint32_t size;
+
+  size = len + (s->sendCrc ? 7 : 5);
+  if (SIM_OUT_BUFFER_SIZE - s->outEnd < size)
+  {
+    memmove(s->out, s->out + s->outStart, s->outEnd - s->outStart);
+    s->outEnd -= s->outStart;
+    s->outStart = 0;
+    if (SIM_OUT_BUFFER_SIZE - s->outEnd < size)
+    {
+      /* Host is not keeping up, drop the message like a UART overrun would */
+      return;
+    }
+  }
+
+  msg = s->out + s->outEnd;
+  msg[0] = 0xFF;
+  msg[1] = len;
+  msg[2] = opcode;
+  msg[3] = (uint8_t)(status >> 8);
+  msg[4] = (uint8_t)(status & 0xFF);
+  if (0 != len)
+  {
+    memcpy(msg + 5, payload, len);
+  }
+  if (s->sendCrc)
+  {
+    crc = sim_crc(msg + 1, len + 4);
+    msg[len + 5] = (uint8_t)(crc >> 8);
+    msg[len + 6] = (uint8_t)(crc & 0xFF);
+    if (tagData && (0 != s->crcErrorRate) &&
+        (0 == (sim_random(s) % s->crcErrorRate)))
+    {
+      msg[len + 6] ^= 0x5A;
+    }
+  }
+  s->outEnd += size;
+
+  if (0 != s->jitterUs)
+  {
+    uint64_t hold;
+
+    hold = sim_nowUs() + (sim_random(s) % s->jitterUs);
+    if (hold > s->holdUntilUs)
+    {
+      s->holdUntilUs = hold;
+    }
+  }
+}
+
+/**
+ * Encode one tag read in the layout of TMR_SR_parseMetadataFromMessage()
+ **/
+static uint8_t
+sim_encodeTag(SimState *s, uint8_t *msg, uint8_t i, uint16_t flags,
+              const SimBufferedTag *tag)
+{
+  uint8_t j;
+  uint8_t port;
+  uint32_t frequency;
+
+  port = (16 == tag->antenna) ? 0 : tag->antenna;
+  frequency = 902750 + (sim_random(s) % 50) * 500;
+
+  if (flags & TMR_TRD_METADATA_FLAG_READCOUNT)
+  {
+    SETU8(msg, i, tag->readCount);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_RSSI)
+  {
+    SETU8(msg, i, (uint8_t)tag->rssi);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_ANTENNAID)
+  {
+    SETU8(msg, i, (uint8_t)((port << 4) | port));
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_FREQUENCY)
+  {
+    SETU8(msg, i, (uint8_t)(frequency >> 16));
+    SETU16(msg, i, (uint16_t)frequency);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_TIMESTAMP)
+  {
+    SETU32(msg, i, tag->offsetMs);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_PHASE)
+  {
+    uint32_t phase;
+
+    phase = sim_random(s) % 180;
+    if (0 != s->rangeCm)
+    {
+      uint64_t distanceCm;
+
+      /* Round trip, 720 f d / c degrees, with f in kHz and d in cm */
+      distanceCm = s->rangeCm + 25 * (tag->id % 8)
+                   + (uint64_t)s->cableCm * (tag->antenna - 1);
+      phase = (uint32_t)((7200ULL * frequency * distanceCm / 299792458ULL
+                          + 180 - 2 + phase % 5) % 180);
+    }
+    SETU16(msg, i, (uint16_t)phase);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_PROTOCOL)
+  {
+    SETU8(msg, i, (uint8_t)s->protocol);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_DATA)
+  {
+    SETU16(msg, i, 0);
+  }
+  if (flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS)
+  {
+    SETU8(msg, i, 0);
+  }
+
+  /* EPC length in bits, covering PC, EPC and CRC */
+  SETU16(msg, i, (uint16_t)((2 + s->epcLen + 2) * 8));
+  SETU16(msg, i, (uint16_t)((s->epcLen / 2) << 11));
+  SETU8(msg, i, 0xE2);
+  SETU8(msg, i, 0x00);
+  SETU16(msg, i, (uint16_t)s->seed);
+  for (j = 4; j < s->epcLen - 4; j++)
+  {
+    SETU8(msg, i, 0);
+  }
+  SETU32(msg, i, tag->id);
+  SETU16(msg, i, sim_crc(msg + i - s->epcLen, s->epcLen));
+
+  return i;
+}
+
+static uint8_t
+sim_tagRecordLength(SimState *s, uint16_t flags)
+{
+  uint8_t len;
+
+  len = 2 + 2 + s->epcLen + 2;
+  len += (flags & TMR_TRD_METADATA_FLAG_READCOUNT) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_RSSI) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_ANTENNAID) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_FREQUENCY) ? 3 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_TIMESTAMP) ? 4 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_PHASE) ? 2 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_PROTOCOL) ? 1 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_DATA) ? 2 : 0;
+  len += (flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS) ? 1 : 0;
+  return len;
+}
+
+static void
+sim_nextRead(SimState *s, SimBufferedTag *tag)
+{
+  tag->id = s->nextTag;
+  tag->readCount = 1;
+  tag->rssi = (int8_t)(-40 - (int8_t)(sim_random(s) % 30));
+  tag->antenna = (0 != s->searchLen) ? s->searchList[s->nextAntenna - 1] : s->nextAntenna;
+  tag->offsetMs = 0;
+
+  s->nextTag = (s->nextTag + 1) % s->tagCount;
+  if (0 == s->nextTag)
+  {
+    s->nextAntenna = (s->nextAntenna % ((0 != s->searchLen) ? s->searchLen : s->antennaCount)) + 1;
+  }
+}
+
+/**
+ * Run a sync search: every tag in the population is seen, and the
+ * configured read rate over the search time is spread over them.
+ *
+ * @return Number of tags new to the tag buffer
+ **/
+static uint32_t
+sim_search(SimState *s, uint16_t timeoutMs)
+{
+  uint32_t reads, perTag, found, n;
+  SimBufferedTag read;
+
+  if (0 == s->tagCount)
+  {
+    return 0;
+  }
+  if (0 == s->bufferLen)
+  {
+    s->searchStartUs = sim_nowUs();
+  }
+
+  reads = (0 == s->readRate) ? s->tagCount :
+          (uint32_t)(((uint64_t)s->readRate * timeoutMs) / 1000);
+  perTag = reads / s->tagCount;
+  perTag = (0 == perTag) ? 1 : ((255 < perTag) ? 255 : perTag);
+
+  found = 0;
+  for (n = 0; n < s->tagCount; n++)
+  {
+    sim_nextRead(s, &read);
+    read.offsetMs = (uint32_t)((sim_nowUs() - s->searchStartUs) / 1000) +
+                    ((uint32_t)timeoutMs * n) / s->tagCount;
+    if (-1 == s->bufferIndex[read.id])
+    {
+      read.readCount = (uint8_t)perTag;
+      s->bufferIndex[read.id] = s->bufferLen;
+      s->buffer[s->bufferLen++] = read;
+      found++;
+    }
+    else
+    {
+      SimBufferedTag *old;
+
+      old = &s->buffer[s->bufferIndex[read.id]];
+      old->readCount = (uint8_t)(((uint32_t)(255 - old->readCount) < perTag) ? 255 : old->readCount + perTag);
+      if (read.rssi > old->rssi)
+      {
+        old->rssi = read.rssi;
+        old->antenna = read.antenna;
+      }
+    }
+  }
+  return found;
+}
+
+static void
+sim_clearBuffer(SimState *s)
+{
+  uint32_t n;
+
+  for (n = 0; n < s->bufferLen; n++)
+  {
+    s->bufferIndex[s->buffer[n].id] = -1;
+  }
+  s->bufferLen = 0;
+  s->bufferRead = 0;
+}
+
+static void
+sim_getTagBuffer(SimState *s, const uint8_t *args, uint8_t argLen)
+{
+  uint8_t payload[SIM_MAX_PAYLOAD];
+  uint8_t i, count, countPos, recordLen;
+  uint16_t flags;
+
+  i = 0;
+  if (0 == argLen)
+  {
+    /* Tags remaining form: read and write indexes */
+    SETU16(payload, i, (uint16_t)s->bufferRead);
+    SETU16(payload, i, (uint16_t)s->bufferLen);
+    sim_queueMessage(s, TMR_SR_OPCODE_GET_TAG_ID_BUFFER, SIM_STATUS_OK, payload, i, false);
+    return;
+  }
+
+  flags = (2 <= argLen) ? GETU16AT(args, 0) : 0;
+  if (s->bufferRead == s->bufferLen)
+  {
+    sim_queueMessage(s, TMR_SR_OPCODE_GET_TAG_ID_BUFFER, SIM_STATUS_NO_TAGS_FOUND, NULL, 0, false);
+    return;
+  }
+
+  SETU16(payload, i, flags);
+  SETU8(payload, i, (3 <= argLen) ? args[2] : 0);
+  countPos = i;
+  SETU8(payload, i, 0);
+
+  recordLen = sim_tagRecordLength(s, flags);
+  count = 0;
+  while ((s->bufferRead < s->bufferLen) && (i + recordLen <= SIM_MAX_PAYLOAD))
+  {
+    i = sim_encodeTag(s, payload, i, flags, &s->buffer[s->bufferRead++]);
+    count++;
+  }
+  payload[countPos] = count;
+  sim_queueMessage(s, TMR_SR_OPCODE_GET_TAG_ID_BUFFER, SIM_STATUS_OK, payload, i, true);
+}
+
+static void
+sim_readTagMultiple(SimState *s, const uint8_t *args, uint8_t argLen)
+{
+  uint8_t payload[8];
+  uint8_t i, j;
+  uint16_t searchFlags, timeout;
+  uint32_t found;
+
+  j = 0;
+  if ((0 < argLen) && (0x81 == args[0]))
+  {
+    j++; /* Gen2 BAP parameters follow */
+  }
+  if (argLen < j + 5)
+  {
+    sim_queueMessage(s, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, SIM_STATUS_INVALID_VALUE, NULL, 0, false);
+    return;
+  }
+  searchFlags = GETU16AT(args, j + 1);
+  timeout = GETU16AT(args, j + 3);
+
+  if (searchFlags & TMR_SR_SEARCH_FLAG_EMBEDDED_COMMAND)
+  {
+    /* Embedded tag operations are not simulated */
+    sim_queueMessage(s, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, SIM_STATUS_NO_TAGS_FOUND, NULL, 0, false);
+    return;
+  }
+
+  found = sim_search(s, timeout);
+
+  i = 0;
+  SETU8(payload, i, args[j]);
+  SETU16(payload, i, searchFlags);
+  SETU32(payload, i, found);
+  sim_queueMessage(s, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE,
+                   (0 == found) ? SIM_STATUS_NO_TAGS_FOUND : SIM_STATUS_OK,
+                   payload, (0 == found) ? 0 : i, false);
+  if (s->syncTiming)
+  {
+    s->holdUntilUs = sim_nowUs() + (uint64_t)timeout * 1000;
+  }
+}
+
+static void
+sim_multiProtocol(SimState *s, const uint8_t *args, uint8_t argLen)
+{
+  uint8_t payload[16];
+  uint8_t i;
+  uint8_t option;
+  uint16_t timeout;
+
+  if (argLen < 3)
+  {
+    sim_queueMessage(s, TMR_SR_OPCODE_MULTI_PROTOCOL_TAG_OP, SIM_STATUS_INVALID_VALUE, NULL, 0, false);
+    return;
+  }
+  timeout = GETU16AT(args, 0);
+  option = args[2];
+
+  i = 0;
+  switch (option)
+  {
+  case 0x01:
+    /* Start continuous reading */
+    s->dwellUs = 0;
+    if ((10 <= argLen) && (TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE == args[8]))
+    {
+      uint8_t j;
+
+      /* Search time of the embedded read, after its options and flags */
+      j = (0x81 == args[9]) ? 10 : 9;
+      if (argLen >= j + 5)
+      {
+        s->dwellUs = (uint32_t)GETU16AT(args, j + 3) * 1000
+                     / ((0 != s->searchLen) ? s->searchLen : s->antennaCount);
+      }
+    }
+    s->streaming = true;
+    s->streamStartUs = sim_nowUs();
+    s->lastCycleUs = s->streamStartUs;
+    s->streamed = 0;
+    SETU8(payload, i, option);
+    sim_queueMessage(s, TMR_SR_OPCODE_MULTI_PROTOCOL_TAG_OP, SIM_STATUS_OK, payload, i, false);
+    break;
+
+  case 0x02:
+    /* Stop continuous reading; all tag reads are already out */
+    s->streaming = false;
+    SETU8(payload, i, option);
+    sim_queueMessage(s, TMR_SR_OPCODE_MULTI_PROTOCOL_TAG_OP, SIM_STATUS_OK, payload, i, false);
+    break;
+
+  default:
+    {
+      /* Sync search over one or more protocols, with metadata */
+      uint32_t found;
+
+      found = sim_search(s, timeout);
+      SETU8(payload, i, option);
+      SETU16(payload, i, (3 <= argLen - 2) ? GETU16AT(args, 3) : 0);
+      SETU8(payload, i, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE);
+      SETU32(payload, i, found);
+      sim_queueMessage(s, TMR_SR_OPCODE_MULTI_PROTOCOL_TAG_OP,
+                       (0 == found) ? SIM_STATUS_NO_TAGS_FOUND : SIM_STATUS_OK,
+                       payload, (0 == found) ? 0 : i, false);
+      if (s->syncTiming)
+      {
+        s->holdUntilUs = sim_nowUs() + (uint64_t)timeout * 1000;
+      }
+    }
+    break;
+  }
+}
+
+/**
+ * Queue the stream messages that are due: tag reads at the configured
+ * rate, and an end of search cycle message every cycleMs so the host
+ * does not time out while the field is quiet.
+ **/
+static void
+sim_stream(SimState *s)
+{
+  uint8_t payload[SIM_MAX_PAYLOAD];
+  uint8_t i;
+  uint64_t now;
+  SimBufferedTag read;
+
+  now = sim_nowUs();
+  i = 0;
+  SETU8(payload, i, SIM_STREAM_OPTION);
+  SETU16(payload, i, SIM_STREAM_SEARCH_FLAGS);
+  SETU16(payload, i, TMR_TRD_METADATA_FLAG_ALL);
+
+  if (now - s->lastCycleUs >= (uint64_t)s->cycleMs * 1000)
+  {
+    SETU8(payload, i, 0x00);
+    /* Search flags, timeout, and tag op success and failure counts */
+    memset(payload + i, 0, 10);
+    i += 10;
+    s->lastCycleUs = now;
+    sim_queueMessage(s, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, SIM_STATUS_OK, payload, i, false);
+    return;
+  }
+
+  if ((0 == s->tagCount) ||
+      ((0 != s->readRate) &&
+       (s->streamed >= ((now - s->streamStartUs) * s->readRate) / 1000000)))
+  {
+    return;
+  }
+
+  SETU8(payload, i, 0x01);
+  sim_nextRead(s, &read);
+  if (0 != s->dwellUs)
+  {
+    uint32_t dwell;
+
+    dwell = (uint32_t)((now - s->streamStartUs) / s->dwellUs);
+    read.antenna = (0 != s->searchLen) ? s->searchList[dwell % s->searchLen]
+                                       : (uint8_t)(dwell % s->antennaCount + 1);
+  }
+  i = sim_encodeTag(s, payload, i, TMR_TRD_METADATA_FLAG_ALL, &read);
+  s->streamed++;
+  sim_queueMessage(s, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, SIM_STATUS_OK, payload, i, true);
+}
+
+static void
+sim_command(SimState *s, uint8_t opcode, const uint8_t *args, uint8_t argLen)
+{
+  uint8_t payload[SIM_MAX_PAYLOAD];
+  uint8_t i, j;
+  SimSetting *setting;
+
+  i = 0;
+  switch (opcode)
+  {
+  case TMR_SR_OPCODE_VERSION:
+    /* Bootloader, hardware, firmware date, firmware version, protocols */
+    SETU32(payload, i, 0x12120300);
+    SETU8(payload, i, TMR_SR_MODEL_M6E);
+    SETU8(payload, i, 0x00);
+    SETU16(payload, i, 0x0001);
+    SETU32(payload, i, 0x20140101);
+    SETU32(payload, i, 0x01210102);
+    SETU32(payload, i, 1 << (TMR_TAG_PROTOCOL_GEN2 - 1));
+    break;
+
+  case TMR_SR_OPCODE_GET_CURRENT_PROGRAM:
+    SETU8(payload, i, 0x02); /* Application */
+    break;
+
+  case TMR_SR_OPCODE_BOOT_FIRMWARE:
+    break;
+
+  case TMR_SR_OPCODE_SET_BAUD_RATE:
+    if (4 <= argLen)
+    {
+      s->baudRate = GETU32AT(args, 0);
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_POWER_MODE:
+  case TMR_SR_OPCODE_GET_USER_MODE:
+    SETU8(payload, i, 0x00);
+    break;
+
+  case TMR_SR_OPCODE_GET_TAG_PROTOCOL:
+    SETU16(payload, i, s->protocol);
+    break;
+
+  case TMR_SR_OPCODE_SET_TAG_PROTOCOL:
+    if (2 <= argLen)
+    {
+      s->protocol = GETU16AT(args, 0);
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_AVAILABLE_PROTOCOLS:
+    SETU16(payload, i, TMR_TAG_PROTOCOL_GEN2);
+    break;
+
+  case TMR_SR_OPCODE_GET_REGION:
+    SETU8(payload, i, s->region);
+    break;
+
+  case TMR_SR_OPCODE_SET_REGION:
+    if (1 <= argLen)
+    {
+      s->region = args[0];
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_AVAILABLE_REGIONS:
+    SETU8(payload, i, TMR_REGION_NA);
+    SETU8(payload, i, TMR_REGION_EU3);
+    SETU8(payload, i, TMR_REGION_PRC);
+    break;
+
+  case TMR_SR_OPCODE_GET_TEMPERATURE:
+    SETU8(payload, i, 32);
+    break;
+
+  case TMR_SR_OPCODE_GET_FREQ_HOP_TABLE:
+    for (j = 0; j < 50; j++)
+    {
+      SETU32(payload, i, 902750 + (uint32_t)j * 500);
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_USER_GPIO_INPUTS:
+    SETU8(payload, i, 0x00);
+    break;
+
+  case TMR_SR_OPCODE_GET_READ_TX_POWER:
+  case TMR_SR_OPCODE_GET_WRITE_TX_POWER:
+    /* Power, then limits for the option 1 form */
+    SETU8(payload, i, (1 <= argLen) ? args[0] : 0);
+    SETU16(payload, i, 3000);
+    SETU16(payload, i, 3150);
+    SETU16(payload, i, 500);
+    break;
+
+  case TMR_SR_OPCODE_GET_ANTENNA_PORT:
+    if ((1 <= argLen) && (5 == args[0]))
+    {
+      /* Antenna detect */
+      SETU8(payload, i, args[0]);
+      for (j = 1; j <= s->antennaCount; j++)
+      {
+        SETU8(payload, i, j);
+        SETU8(payload, i, 1);
+      }
+    }
+    else if ((1 <= argLen) && (4 == args[0]))
+    {
+      /* Port powers and settling times */
+      SETU8(payload, i, args[0]);
+      for (j = 1; j <= s->antennaCount; j++)
+      {
+        SETU8(payload, i, j);
+        SETU16(payload, i, 3000);
+        SETU16(payload, i, 3000);
+        SETU16(payload, i, 0);
+      }
+    }
+    else
+    {
+      sim_queueMessage(s, opcode, SIM_STATUS_INVALID_VALUE, NULL, 0, false);
+      return;
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_READER_OPTIONAL_PARAMS:
+    if (2 > argLen)
+    {
+      sim_queueMessage(s, opcode, SIM_STATUS_INVALID_VALUE, NULL, 0, false);
+      return;
+    }
+    SETU8(payload, i, args[0]);
+    SETU8(payload, i, args[1]);
+    setting = sim_findSetting(s, 0x100 | args[1]);
+    if (NULL != setting)
+    {
+      memcpy(payload + i, setting->value, setting->len);
+      i += setting->len;
+    }
+    else
+    {
+      /* The uniqueBy settings are inverted: 1 means off */
+      bool inverted = ((TMR_SR_CONFIGURATION_UNIQUE_BY_ANTENNA == args[1]) ||
+                       (TMR_SR_CONFIGURATION_UNIQUE_BY_DATA == args[1]) ||
+                       (TMR_SR_CONFIGURATION_UNIQUE_BY_PROTOCOL == args[1]));
+      SETU32(payload, i, inverted ? 0x01000000 : 0);
+    }
+    break;
+
+  case TMR_SR_OPCODE_SET_READER_OPTIONAL_PARAMS:
+    if (3 <= argLen)
+    {
+      sim_storeSetting(s, 0x100 | args[1], args + 2, argLen - 2);
+      if (TMR_SR_CONFIGURATION_SEND_CRC == args[1])
+      {
+        /* Takes effect from this response on */
+        s->sendCrc = (0 != args[2]);
+      }
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_PROTOCOL_PARAM:
+    if (2 > argLen)
+    {
+      sim_queueMessage(s, opcode, SIM_STATUS_INVALID_VALUE, NULL, 0, false);
+      return;
+    }
+    SETU8(payload, i, args[0]);
+    SETU8(payload, i, args[1]);
+    setting = sim_findSetting(s, (uint16_t)((args[0] << 8) | args[1]));
+    if (NULL != setting)
+    {
+      memcpy(payload + i, setting->value, setting->len);
+      i += setting->len;
+    }
+    else
+    {
+      SETU32(payload, i, 0);
+    }
+    break;
+
+  case TMR_SR_OPCODE_SET_PROTOCOL_PARAM:
+    if (3 <= argLen)
+    {
+      sim_storeSetting(s, (uint16_t)((args[0] << 8) | args[1]), args + 2, argLen - 2);
+    }
+    break;
+
+  case TMR_SR_OPCODE_GET_READER_STATS:
+    if ((1 <= argLen) && (TMR_SR_READER_STATS_OPTION_RESET == args[0]))
+    {
+      break;
+    }
+    sim_queueMessage(s, opcode, SIM_STATUS_INVALID_VALUE, NULL, 0, false);
+    return;
+
+  case TMR_SR_OPCODE_SET_ANTENNA_PORT:
+    if ((1 <= argLen) && (2 == args[0]))
+    {
+      /* Logical antenna list: transmit and receive port pairs */
+      s->searchLen = 0;
+      for (j = 1; (j + 1 < argLen) && (s->searchLen < sizeof(s->searchList)); j += 2)
+      {
+        s->searchList[s->searchLen++] = args[j];
+      }
+      s->nextAntenna = 1;
+    }
+    break;
+
+  case TMR_SR_OPCODE_SET_READ_TX_POWER:
+  case TMR_SR_OPCODE_SET_WRITE_TX_POWER:
+  case TMR_SR_OPCODE_SET_FREQ_HOP_TABLE:
+  case TMR_SR_OPCODE_SET_USER_GPIO_OUTPUTS:
+  case TMR_SR_OPCODE_SET_POWER_MODE:
+  case TMR_SR_OPCODE_SET_USER_MODE:
+    break;
+
+  case TMR_SR_OPCODE_CLEAR_TAG_ID_BUFFER:
+    sim_clearBuffer(s);
+    break;
+
+  case TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE:
+    sim_readTagMultiple(s, args, argLen);
+    return;
+
+  case TMR_SR_OPCODE_GET_TAG_ID_BUFFER:
+    sim_getTagBuffer(s, args, argLen);
+    return;
+
+  case TMR_SR_OPCODE_MULTI_PROTOCOL_TAG_OP:
+    sim_multiProtocol(s, args, argLen);
+    return;
+
+  default:
+    sim_queueMessage(s, opcode, SIM_STATUS_INVALID_OPCODE, NULL, 0, false);
+    return;
+  }
+
+  sim_queueMessage(s, opcode, SIM_STATUS_OK, payload, i, false);
+}
+
+/**
+ * Run every complete command in the host to module bytes.  Wakeup
+ * preambles (runs of 0xFF) and messages with a bad CRC are dropped.
+ **/
+static void
+sim_processInput(SimState *s)
+{
+  uint32_t start, len;
+
+  start = 0;
+  while (start < s->inLen)
+  {
+    if ((0xFF != s->in[start]) ||
+        ((start + 1 < s->inLen) && (0xFF == s->in[start + 1])))
+    {
+      start++;
+      continue;
+    }
+    if (start + 2 > s->inLen)
+    {
+      break;
+    }
+    len = s->in[start + 1];
+    if (start + len + 5 > s->inLen)
+    {
+      break;
+    }
+    if (sim_crc(s->in + start + 1, len + 2) ==
+        GETU16AT(s->in, start + len + 3))
+    {
+      sim_command(s, s->in[start + 2], s->in + start + 3, (uint8_t)len);
+    }
+    start += len + 5;
+  }
+  memmove(s->in, s->in + start, s->inLen - start);
+  s->inLen -= start;
+}
+
+/**
+ * Shutdown of a transport that is not open: nothing to free.
+ **/
+static TMR_Status
+s_shutdownClosed(TMR_SR_SerialTransport *this)
+{
+  return TMR_SUCCESS;
+}
+
+static TMR_Status
+s_shutdown(TMR_SR_SerialTransport *this)
+{
+  SimState *s;
+
+  s = this->cookie;
+  this->cookie = s->context;
+  this->shutdown = s_shutdownClosed;
+  pthread_mutex_destroy(&s->lock);
+  free(s->buffer);
+  free(s->bufferIndex);
+  free(s);
+
+  return TMR_SUCCESS;
+}
+
+static TMR_Status
+s_open(TMR_SR_SerialTransport *this)
+{
+  TMR_SR_SerialPortNativeContext *c;
+  SimState *s;
+  uint32_t n;
+
+  c = this->cookie;
+  s = calloc(1, sizeof(*s));
+  if (NULL == s)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  s->context = c;
+  sim_parseOptions(s, c->devicename);
+  s->protocol = TMR_TAG_PROTOCOL_GEN2;
+  s->region = TMR_REGION_NA;
+  s->sendCrc = true;
+  s->nextAntenna = 1;
+  s->random = (0 == s->seed) ? 1 : s->seed;
+
+  s->buffer = malloc(s->tagCount * sizeof(*s->buffer) + 1);
+  s->bufferIndex = malloc(s->tagCount * sizeof(*s->bufferIndex) + 1);
+  if ((NULL == s->buffer) || (NULL == s->bufferIndex))
+  {
+    free(s->buffer);
+    free(s->bufferIndex);
+    free(s);
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  for (n = 0; n < s->tagCount; n++)
+  {
+    s->bufferIndex[n] = -1;
+  }
+  pthread_mutex_init(&s->lock, NULL);
+
+  this->cookie = s;
+  this->shutdown = s_shutdown;
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+s_sendBytes(TMR_SR_SerialTransport *this, uint32_t length,
+                uint8_t* message, const uint32_t timeoutMs)
+{
+  SimState *s;
+  uint32_t n;
+
+  s = this->cookie;
+  sim_pace(s, length);
+
+  pthread_mutex_lock(&s->lock);
+  while (0 < length)
+  {
+    n = SIM_IN_BUFFER_SIZE - s->inLen;
+    if (n > length)
+    {
+      n = length;
+    }
+    memcpy(s->in + s->inLen, message, n);
+    s->inLen += n;
+    message += n;
+    length -= n;
+    sim_processInput(s);
+    if (SIM_IN_BUFFER_SIZE == s->inLen)
+    {
+      /* No message start in a full buffer, it is all noise */
+      s->inLen = 0;
+    }
+  }
+  pthread_mutex_unlock(&s->lock);
+
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+s_receiveBytes(TMR_SR_SerialTransport *this, uint32_t length,
+                   uint32_t* messageLength, uint8_t* message, const uint32_t timeoutMs)
+{
+  SimState *s;
+  uint64_t deadline, now;
+  bool ready;
+
+  s = this->cookie;
+  *messageLength = 0;
+  deadline = sim_nowUs() + (uint64_t)timeoutMs * 1000;
+
+  while (true)
+  {
+    pthread_mutex_lock(&s->lock);
+    now = sim_nowUs();
+    if (s->streaming && (s->outEnd - s->outStart < length))
+    {
+      sim_stream(s);
+    }
+    ready = ((s->outEnd - s->outStart >= length) && (now >= s->holdUntilUs));
+    if (ready)
+    {
+      memcpy(message, s->out + s->outStart, length);
+      s->outStart += length;
+      if (s->outStart == s->outEnd)
+      {
+        s->outStart = s->outEnd = 0;
+      }
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    if (ready)
+    {
+      break;
+    }
+    if (now >= deadline)
+    {
+      return TMR_ERROR_TIMEOUT;
+    }
+    sim_sleepUs(100);
+  }
+
+  sim_pace(s, length);
+  *messageLength = length;
+
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+s_setBaudRate(TMR_SR_SerialTransport *this, uint32_t rate)
+{
+  SimState *s;
+
+  s = this->cookie;
+  s->baudRate = rate;
+
+  return TMR_SUCCESS;
+}
+
+
+static TMR_Status
+s_flush(TMR_SR_SerialTransport *this)
+{
+  SimState *s;
+
+  s = this->cookie;
+  pthread_mutex_lock(&s->lock);
+  s->inLen = 0;
+  s->outStart = s->outEnd = 0;
+  pthread_mutex_unlock(&s->lock);
+
+  return TMR_SUCCESS;
+}
+
+/**
+ * Initialize a TMR_SR_SerialTransport structure with a simulated M6e
+ * module.  The options in the device string are read at open time.
+ *
+ * @param transport The TMR_SR_SerialTransport structure to initialize.
+ * @param context A TMR_SR_SerialPortNativeContext structure for the callbacks to use.
+ * @param device The simulation options, such as @c /m6e?tags=100&rate=5000
+ */
+TMR_Status
+TMR_SR_SerialTransportSimInit(TMR_SR_SerialTransport *transport,
+                              TMR_SR_SerialPortNativeContext *context,
+                              const char *device)
+{
+  if (strlen(device) + 1 > TMR_MAX_READER_NAME_LENGTH)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  strcpy(context->devicename, device);
+
+  transport->cookie = context;
+  transport->open = s_open;
+  transport->sendBytes = s_sendBytes;
+  transport->receiveBytes = s_receiveBytes;
+  transport->setBaudRate = s_setBaudRate;
+  /* s_open() installs s_shutdown() */
+  transport->shutdown = s_shutdownClosed;
+  transport->flush = s_flush;
+
+  return TMR_SUCCESS;
+}
+
+#endif /* TMR_ENABLE_SERIAL_TRANSPORT_SIM */
@@ -53,6 +53,25 @@ extern "C" {
  */
 #define TMR_ENABLE_SERIAL_TRANSPORT_NATIVE
 
+/**
+ * Define this to enable the simulated M6e module transport, registered
+ * under the "sim" URI scheme, for running the serial reader without
+ * hardware (see serial_transport_sim.c).
+ */
+#ifndef WIN32
+#define TMR_ENABLE_SERIAL_TRANSPORT_SIM
+#endif
+
+/**
+ * Define this to enable the capture replay transport, registered
+ * under the "replay" URI scheme, for running the serial reader against
+ * traffic recorded with TMR_startTransportCapture() (see
+ * serial_transport_replay.c).
+ */
+#ifndef WIN32
+#define TMR_ENABLE_SERIAL_TRANSPORT_REPLAY
+#endif
+
 /**
  * The longest possible name for a reader.
  */
@@ -75,6 +94,12 @@ extern "C" {
  */
 #define TMR_MAX_EMBEDDED_DATA_LENGTH 128 
 
+/**
+ * Maximum number of memory ranges TMR_readTagMemRanges() reads from
+ * each tag in one pass (one LLRP OpSpec per range).
+ */
+#define TMR_MAX_TAGMEM_RANGES 8
+
 /**
  * The maximum length of the probe baudrate list. This list specifies the  
  * baudrates which are used while connecting to the serial reader.
@@ -94,6 +119,25 @@ extern "C" {
  */
 #define TMR_LLRP_KEEP_ALIVE_TIMEOUT 5000
 
+/**
+ * Default number of consecutive keep alive periods without any traffic
+ * from the LLRP reader before the connection is declared lost.
+ */
+#define TMR_LLRP_KEEP_ALIVE_MISS_COUNT 4
+
+/**
+ * Maximum time in milli seconds spent re-establishing a lost LLRP
+ * connection during continuous reading, before giving up.
+ */
+#define TMR_LLRP_RECONNECT_TIMEOUT 60000
+
+/**
+ * Define this to recycle LTKC message memory through a per reader
+ * pool instead of the C library allocator. Needs the LTKC
+ * element allocator patch.
+ */
+#define TMR_ENABLE_LLRP_MEM_POOL
+
 /**
  * Define this to enable support for the ISO180006B protocol parameters
  * and access commands
@@ -150,12 +194,230 @@ extern "C" {
  */
 #define TMR_ENABLE_API_SIDE_DEDUPLICATION
 
+/**
+ * Number of slots the API-side continuous read filter starts with
+ * (a power of two, at least 8).  The filter is allocated only while
+ * the API filters, and doubles whenever three quarters of its slots
+ * are in use, so it tracks every tag of a search cycle or window.
+ */
+#define TMR_DEDUP_TABLE_SIZE 256
+
+/**
+ * Define this to keep host-side pipeline statistics: transport
+ * counters, background read queue depth, enqueue-to-dispatch latency
+ * and read listener callback times (see TMR_PipelineStats).  Costs a
+ * few relaxed atomic increments per message and two clock reads per
+ * listener call.
+ */
+#define TMR_ENABLE_PIPELINE_STATS
+
+/**
+ * Number of read listeners whose callback time the pipeline
+ * statistics track individually.
+ */
+#define TMR_PIPELINE_MAX_LISTENERS 4
+
+/**
+ * Define this to build the OpenMetrics exporter (see tmr_metrics.h),
+ * which serves read counts, RSSI distributions, module statistics and
+ * the pipeline statistics to Prometheus over a local HTTP socket.
+ */
+#if !defined(WIN32) && defined(TMR_ENABLE_BACKGROUND_READS)
+#define TMR_ENABLE_METRICS_EXPORTER
+#endif
+
+/**
+ * Number of antennas the OpenMetrics exporter counts reads for
+ * separately; reads on higher antenna numbers are counted together.
+ */
+#define TMR_METRICS_MAX_ANTENNAS 64
+
+/**
+ * Define this to record the tracepoints in tmr_trace.h (serial command
+ * send and receive, read queue, read listeners, LLRP receive, read
+ * exceptions) into per-thread rings that TMR_traceDump() writes out.
+ * When neither this nor TMR_ENABLE_TRACE_USDT is defined the
+ * tracepoints compile to nothing.
+ */
+#undef TMR_ENABLE_TRACE
+
+/**
+ * Define this to emit the tmr_trace.h tracepoints as USDT probes
+ * (provider "mercuryapi").  Needs <sys/sdt.h>.
+ */
+#undef TMR_ENABLE_TRACE_USDT
+
+/**
+ * Number of events each thread's trace ring keeps (must be a power
+ * of two).
+ */
+#define TMR_TRACE_RING_SIZE 4096
+
+/**
+ * Define this to build the sampling transport tap (see
+ * tmr_transport_tap.h).  Its ring needs GCC-style atomic builtins.
+ */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define TMR_ENABLE_TRANSPORT_TAP
+#endif
+
+/**
+ * Define this to build the fault injection serial transport (see
+ * tmr_fault.h), which wraps another serial transport to inject
+ * dropped bytes, corruption, stalls, cut short frames and disconnects
+ * and measures the reader's recovery from them.
+ */
+#if !defined(WIN32) && defined(TMR_ENABLE_BACKGROUND_READS)
+#define TMR_ENABLE_SERIAL_TRANSPORT_FAULT
+#endif
+
+/**
+ * Number of injected faults whose recovery the fault injection
+ * transport records individually.
+ */
+#define TMR_FAULT_MAX_RECORDS 256
+
+/**
+ * Define this to build the streaming phase difference engine (see
+ * tmr_pdoa.h), a read listener that pairs the phases of a tag read
+ * on two antennas at the same frequency as the reads arrive.
+ */
+#ifdef TMR_ENABLE_BACKGROUND_READS
+#define TMR_ENABLE_PDOA
+#endif
+
+/**
+ * Highest antenna number the phase difference engine pairs.
+ */
+#define TMR_PDOA_MAX_ANTENNAS 16
+
+/**
+ * Define this to build the multi-frequency ranging module (see
+ * tmr_range.h), a read listener that fits phase against carrier
+ * frequency per tag and antenna to estimate the tag's distance.
+ */
+#ifdef TMR_ENABLE_BACKGROUND_READS
+#define TMR_ENABLE_RANGING
+#endif
+
+/**
+ * Most carrier frequencies the ranging module keeps per tag and
+ * antenna.
+ */
+#define TMR_RANGE_MAX_CHANNELS 64
+
+/**
+ * Define this to build the batch phase statistics kernels (see
+ * tmr_phase.h): circular mean and variance, wrapped differences,
+ * RSSI weighting and outlier rejection over arrays of reads.
+ */
+#define TMR_ENABLE_PHASE_STATS
+
+/**
+ * Define this to let the phase statistics kernels use SSE2 and, where
+ * the CPU has it, AVX2, chosen at run time.  Only takes effect with a
+ * GNU-compatible compiler targeting x86; the plain C kernels give the
+ * same results elsewhere.
+ */
+#define TMR_ENABLE_PHASE_SIMD
+
+/**
+ * Largest phase turn, in degrees, the phase statistics kernels take.
+ */
+#define TMR_PHASE_MAX_TURN 360
+
+/**
+ * Define this to build the tag position estimator (see tmr_locate.h),
+ * a read listener that tracks each tag with a Kalman filter fed by
+ * RSSI, ranging and phase differences over a configured antenna
+ * geometry.
+ */
+#ifdef TMR_ENABLE_PDOA
+#define TMR_ENABLE_LOCATE
+#endif
+
+/**
+ * Define this to build per antenna and channel phase calibration (see
+ * tmr_phase_cal.h): offset tables learned from a reference tag and
+ * applied to the phase of each read as the serial reader parses it.
+ */
+#define TMR_ENABLE_PHASE_CAL
+
+/**
+ * Highest antenna port and most hop table channels a phase
+ * calibration table covers.
+ */
+#define TMR_PHASE_CAL_MAX_ANTENNAS 16
+#define TMR_PHASE_CAL_MAX_CHANNELS 64
+
+/**
+ * Define this to build synchronized multi-reader sessions (see
+ * tmr_multi.h): several readers started together, their clocks put
+ * on one time base and their reads merged into one stream.
+ */
+#if !defined(WIN32) && defined(TMR_ENABLE_BACKGROUND_READS)
+#define TMR_ENABLE_MULTI_READER
+#endif
+
+/**
+ * Most readers in a multi-reader session, and window minima each
+ * reader's clock is fitted through.
+ */
+#define TMR_MULTI_MAX_READERS 8
+#define TMR_MULTI_CLOCK_WINDOWS 16
+
+/**
+ * Define this to build antenna round-robin read scheduling (see
+ * tmr_schedule.h): serial reader settings for short dwells on each
+ * antenna, and the pairing latency they achieve.
+ */
+#define TMR_ENABLE_ANTENNA_SCHEDULE
+
+/**
+ * Most antennas a schedule goes round, and bins of its pairing
+ * latency histogram.
+ */
+#define TMR_SCHEDULE_MAX_ANTENNAS 16
+#define TMR_SCHEDULE_HISTOGRAM_BINS 256
+
+/**
+ * Define this to build tag presence and motion events (see
+ * tmr_events.h): entered, moving, stationary and departed per tag
+ * instead of every read.
+ */
+#if !defined(WIN32) && defined(TMR_ENABLE_BACKGROUND_READS)
+#define TMR_ENABLE_TAG_EVENTS
+#endif
+
+/**
+ * Define this to build direction of travel through portals (see
+ * tmr_portal.h), from the order, RSSI peaks and phase rates of each
+ * tag's reads on the antennas either side of a doorway.
+ */
+#if !defined(WIN32) && defined(TMR_ENABLE_BACKGROUND_READS)
+#define TMR_ENABLE_PORTAL
+#endif
+
+/**
+ * Most portals one engine tells apart.
+ */
+#define TMR_PORTAL_MAX_PORTALS 8
+
 /**
  * Enabling  this option will enable the support for the parameters defined 
  * in stdio.h header file like FILE *. This check is required as stdio.h doese not
  * exist in some of the embedded  architectures.
  */
 #define  TMR_ENABLE_STDIO
+
+/**
+ * Define this to build the columnar read log (see tmr_readlog.h): the
+ * read stream written to a compact binary file, and scanned back
+ * through a memory map.
+ */
+#if !defined(WIN32) && defined(TMR_ENABLE_BACKGROUND_READS)
+#define TMR_ENABLE_READ_LOG
+#endif
   
 /**
  * Enabling  this option will enable the support for the parameters defined 
@@ -99,6 +99,20 @@ static void TMR_initSerialTransportTable()
       TMR_stringCopy(&str, "tmr", (int)strlen("tmr"));
       tdTable.list[tdTable.len].transportInit = TMR_SR_SerialTransportNativeInit;
       tdTable.len++;
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_SIM
+      str.value = tdTable.list[tdTable.len].transportScheme;
+      TMR_stringCopy(&str, "sim", (int)strlen("sim"));
+      tdTable.list[tdTable.len].transportInit = TMR_SR_SerialTransportSimInit;
+      tdTable.len++;
+#endif
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_REPLAY
+      str.value = tdTable.list[tdTable.len].transportScheme;
+      TMR_stringCopy(&str, "replay", (int)strlen("replay"));
+      tdTable.list[tdTable.len].transportInit = TMR_SR_SerialTransportReplayInit;
+      tdTable.len++;
+#endif
     }
     transportTableInitialized = true;
   }
@@ -138,6 +152,10 @@ TMR_create(TMR_Reader *reader, const char* deviceUri)
   reader->readExceptionListeners = NULL;
   reader->statsListeners = NULL;
   reader->statusListeners = NULL;
+  reader->pipelineStatsListeners = NULL;
+  reader->connectionGapListeners = NULL;
+  reader->pipelineStatsPeriod = 1000;
+  reader->pipelineStatsNextUs = 0;
   reader->readState = TMR_READ_STATE_IDLE;
   reader->backgroundSetup = false;
   reader->parserSetup = false;
@@ -247,6 +265,8 @@ else
   char* scheme;
   bool scheme_exists = false;
 
+  TMR_initSerialTransportTable();
+
   scheme = strtok((char *)deviceUri, ":");
 
   for (i = 0; i < tdTable.len; i++)
@@ -292,6 +312,10 @@ TMR_reader_init_internal(struct TMR_Reader *reader)
   reader->connected = false;
   reader->pSupportsResetStats = NULL;
   reader->transportListeners = NULL;
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+  reader->transportTap = NULL;
+  reader->transportTapWriters = 0;
+#endif
 
 
   TMR_RP_init_simple(&reader->readParams.defaultReadPlan, 0, NULL, 
@@ -321,6 +345,7 @@ TMR_reader_init_internal(struct TMR_Reader *reader)
   reader->trueAsyncflag = false;
   reader->parserEnabled = false;
   reader->tagReadQueue = NULL;
+  memset(&reader->dedupTable, 0, sizeof(reader->dedupTable));
   reader->isStatusResponse = false;  
   reader->statsFlag = TMR_READER_STATS_FLAG_NONE;
   reader->streamStats = TMR_SR_STATUS_NONE;
@@ -331,6 +356,14 @@ TMR_reader_init_internal(struct TMR_Reader *reader)
   reader->backgroundThreadCancel = false;
   reader->isStopNTags = false;
   reader->numberOfTagsToRead = 0;
+  reader->dedupPolicy.enable = false;
+  reader->dedupPolicy.uniqueByAntenna = false;
+  reader->dedupPolicy.uniqueByData = false;
+  reader->dedupPolicy.uniqueByProtocol = false;
+  reader->dedupPolicy.recordHighestRssi = false;
+  reader->dedupPolicy.windowMs = 0;
+  reader->dedupPolicy.deviceFields = 0;
+  memset(&reader->pipelineStats, 0, sizeof(reader->pipelineStats));
 
   return TMR_SUCCESS;
 }
@@ -470,29 +503,14 @@ TMR_readIntoArray(struct TMR_Reader *reader, uint32_t timeoutMs,
 #endif /* TMR_ENABLE_API_SIDE_DEDUPLICATION */
 
 #ifdef TMR_ENABLE_API_SIDE_DEDUPLICATION
-  {
-    bool bval;
-
-    ret = TMR_paramGet(reader, TMR_PARAM_TAGREADDATA_UNIQUEBYANTENNA, &bval);
-    if (TMR_ERROR_NOT_FOUND == ret) { bval = false; }
-    else if (TMR_SUCCESS != ret) { return ret; }
-    uniqueByAntenna = bval;
-
-    ret = TMR_paramGet(reader, TMR_PARAM_TAGREADDATA_UNIQUEBYDATA, &bval);
-    if (TMR_ERROR_NOT_FOUND == ret) { bval = false; }
-    else if (TMR_SUCCESS != ret) { return ret; }
-    uniqueByData = bval;
-
-    ret = TMR_paramGet(reader, TMR_PARAM_TAGREADDATA_UNIQUEBYPROTOCOL, &bval);
-    if (TMR_ERROR_NOT_FOUND == ret) { bval = false; }
-    else if (TMR_SUCCESS != ret) { return ret; }
-    uniqueByProtocol = bval;
-
-    ret = TMR_paramGet(reader, TMR_PARAM_TAGREADDATA_RECORDHIGHESTRSSI, &bval);
-    if (TMR_ERROR_NOT_FOUND == ret) { bval = false; }
-    else if (TMR_SUCCESS != ret) { return ret; }
-    recordHighestRssi = bval;
-  }
+  /**
+   * The backends keep dedupPolicy in step with the device, so there
+   * is no need to ask the reader for each uniqueBy setting here.
+   **/
+  uniqueByAntenna = reader->dedupPolicy.uniqueByAntenna;
+  uniqueByData = reader->dedupPolicy.uniqueByData;
+  uniqueByProtocol = reader->dedupPolicy.uniqueByProtocol;
+  recordHighestRssi = reader->dedupPolicy.recordHighestRssi;
 #endif /* TMR_ENABLE_API_SIDE_DEDUPLICATION */
 
   tagsRead = 0;
@@ -559,7 +577,7 @@ TMR_readIntoArray(struct TMR_Reader *reader, uint32_t timeoutMs,
        * If no dup found, commit fetched tag by incrementing tag count.
        * If dup found, copy last record to found position, don't advance count.
        */
-      if (true == reader->u.serialReader.enableReadFiltering)
+      if (true == reader->dedupPolicy.enable)
       {
         TMR_TagReadData* last = &results[tagsRead];
         int dupIndex = TMR_findDupTag(reader, last, results, tagsRead,
@@ -592,6 +610,323 @@ out:
   return ret;
 }
 
+TMR_Status
+TMR_TagReadMap_init(TMR_TagReadMap *map)
+{
+  map->slots = NULL;
+  map->capacity = 0;
+  map->count = 0;
+  return TMR_SUCCESS;
+}
+
+void
+TMR_TagReadMap_free(TMR_TagReadMap *map)
+{
+  uint32_t i;
+
+  for (i = 0; i < map->capacity; i++)
+  {
+    free(map->slots[i]);
+  }
+  free(map->slots);
+  TMR_TagReadMap_init(map);
+}
+
+static uint32_t
+TMR_TagReadMap_hash(const TMR_TagData *tag)
+{
+  uint32_t hash;
+  uint8_t i;
+
+  /* FNV-1a over the EPC */
+  hash = 2166136261u;
+  for (i = 0; i < tag->epcByteCount; i++)
+  {
+    hash ^= tag->epc[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Find the slot holding a tag, or the empty slot it belongs in.
+ * The map must have at least one empty slot.
+ **/
+static uint32_t
+TMR_TagReadMap_slot(TMR_TagReadData **slots, uint32_t capacity,
+                    const TMR_TagData *tag)
+{
+  uint32_t i;
+  TMR_TagReadData *entry;
+
+  i = TMR_TagReadMap_hash(tag) & (capacity - 1);
+  while (NULL != (entry = slots[i]))
+  {
+    if ((entry->tag.epcByteCount == tag->epcByteCount) &&
+        (0 == memcmp(entry->tag.epc, tag->epc, tag->epcByteCount)))
+    {
+      break;
+    }
+    i = (i + 1) & (capacity - 1);
+  }
+  return i;
+}
+
+TMR_TagReadData *
+TMR_TagReadMap_find(const TMR_TagReadMap *map, const TMR_TagData *tag)
+{
+  if (0 == map->count)
+  {
+    return NULL;
+  }
+  return map->slots[TMR_TagReadMap_slot(map->slots, map->capacity, tag)];
+}
+
+/**
+ * Keep the map at most half full so probe sequences stay short.
+ **/
+static TMR_Status
+TMR_TagReadMap_grow(TMR_TagReadMap *map)
+{
+  TMR_TagReadData **slots;
+  uint32_t capacity, i;
+
+  if ((map->count + 1) * 2 <= map->capacity)
+  {
+    return TMR_SUCCESS;
+  }
+  capacity = (0 == map->capacity) ? 64 : map->capacity * 2;
+  slots = calloc(capacity, sizeof(*slots));
+  if (NULL == slots)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  for (i = 0; i < map->capacity; i++)
+  {
+    if (NULL != map->slots[i])
+    {
+      slots[TMR_TagReadMap_slot(slots, capacity, &map->slots[i]->tag)] =
+        map->slots[i];
+    }
+  }
+  free(map->slots);
+  map->slots = slots;
+  map->capacity = capacity;
+  return TMR_SUCCESS;
+}
+
+static void
+TMR_TagReadMap_copyList(TMR_uint8List *dest, const TMR_uint8List *src)
+{
+  uint16_t len;
+
+  len = (src->len < dest->max) ? src->len : dest->max;
+  if ((0 == dest->len) && (0 != len))
+  {
+    memcpy(dest->list, src->list, len);
+    dest->len = len;
+  }
+}
+
+/**
+ * Point a copied read's data lists at its own buffers, empty.
+ **/
+static void
+TMR_TagReadMap_ownLists(TMR_TagReadData *entry)
+{
+#if TMR_MAX_EMBEDDED_DATA_LENGTH
+  entry->data.list = entry->_dataList;
+  entry->epcMemData.list = entry->_epcMemDataList;
+  entry->tidMemData.list = entry->_tidMemDataList;
+  entry->userMemData.list = entry->_userMemDataList;
+  entry->reservedMemData.list = entry->_reservedMemDataList;
+
+  entry->data.max = TMR_MAX_EMBEDDED_DATA_LENGTH;
+  entry->epcMemData.max = TMR_MAX_EMBEDDED_DATA_LENGTH;
+  entry->tidMemData.max = TMR_MAX_EMBEDDED_DATA_LENGTH;
+  entry->userMemData.max = TMR_MAX_EMBEDDED_DATA_LENGTH;
+  entry->reservedMemData.max = TMR_MAX_EMBEDDED_DATA_LENGTH;
+#else
+  entry->data.list = NULL;
+  entry->epcMemData.list = NULL;
+  entry->tidMemData.list = NULL;
+  entry->userMemData.list = NULL;
+  entry->reservedMemData.list = NULL;
+
+  entry->data.max = 0;
+  entry->epcMemData.max = 0;
+  entry->tidMemData.max = 0;
+  entry->userMemData.max = 0;
+  entry->reservedMemData.max = 0;
+#endif
+  entry->data.len = 0;
+  entry->epcMemData.len = 0;
+  entry->tidMemData.len = 0;
+  entry->userMemData.len = 0;
+  entry->reservedMemData.len = 0;
+}
+
+/**
+ * Take the GPIO states of a later read of the tag, pin by pin.
+ **/
+static void
+TMR_TagReadMap_mergeGpio(TMR_TagReadData *entry, const TMR_TagReadData *read)
+{
+  uint8_t i, j;
+
+  for (i = 0; i < read->gpioCount; i++)
+  {
+    for (j = 0; j < entry->gpioCount; j++)
+    {
+      if (entry->gpio[j].id == read->gpio[i].id)
+      {
+        break;
+      }
+    }
+    if (j < entry->gpioCount)
+    {
+      entry->gpio[j] = read->gpio[i];
+    }
+    else if (entry->gpioCount < sizeof(entry->gpio) / sizeof(entry->gpio[0]))
+    {
+      entry->gpio[entry->gpioCount++] = read->gpio[i];
+    }
+  }
+}
+
+/**
+ * Add a read to the map, or merge it into the read of the same tag.
+ **/
+static TMR_Status
+TMR_TagReadMap_add(TMR_TagReadMap *map, const TMR_TagReadData *read)
+{
+  TMR_TagReadData *entry;
+  TMR_Status ret;
+  uint32_t i;
+
+  ret = TMR_TagReadMap_grow(map);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  i = TMR_TagReadMap_slot(map->slots, map->capacity, &read->tag);
+  entry = map->slots[i];
+  if (NULL == entry)
+  {
+    entry = malloc(sizeof(*entry));
+    if (NULL == entry)
+    {
+      return TMR_ERROR_OUT_OF_MEMORY;
+    }
+    /* Copy the read, then give the entry its own data buffers */
+    *entry = *read;
+    TMR_TagReadMap_ownLists(entry);
+    map->slots[i] = entry;
+    map->count++;
+  }
+  else
+  {
+    entry->readCount += read->readCount;
+    entry->metadataFlags |= read->metadataFlags;
+    if (read->rssi > entry->rssi)
+    {
+      entry->rssi = read->rssi;
+      entry->antenna = read->antenna;
+      entry->phase = read->phase;
+      entry->frequency = read->frequency;
+    }
+    TMR_TagReadMap_mergeGpio(entry, read);
+  }
+
+  TMR_TagReadMap_copyList(&entry->data, &read->data);
+  TMR_TagReadMap_copyList(&entry->epcMemData, &read->epcMemData);
+  TMR_TagReadMap_copyList(&entry->tidMemData, &read->tidMemData);
+  TMR_TagReadMap_copyList(&entry->userMemData, &read->userMemData);
+  TMR_TagReadMap_copyList(&entry->reservedMemData, &read->reservedMemData);
+
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_readTagMemRanges(struct TMR_Reader *reader, uint32_t timeoutMs,
+                     uint8_t count, const TMR_TagMemRange ranges[],
+                     TMR_TagReadMap *map)
+{
+  TMR_ReadPlan savedPlan, plan;
+  TMR_TagOp ops[TMR_MAX_TAGMEM_RANGES];
+  TMR_TagOp *opList[TMR_MAX_TAGMEM_RANGES];
+  TMR_TagOp listOp;
+  TMR_TagReadData read;
+  TMR_Status ret, ret1;
+  int32_t tagCount;
+  uint8_t i;
+
+  if ((0 == count) || (TMR_MAX_TAGMEM_RANGES < count))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  ret = TMR_paramGet(reader, TMR_PARAM_READ_PLAN, &savedPlan);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  if (TMR_READ_PLAN_TYPE_SIMPLE != savedPlan.type)
+  {
+    return TMR_ERROR_UNSUPPORTED;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    ret = TMR_TagOp_init_GEN2_ReadData(&ops[i], ranges[i].bank,
+                                       ranges[i].wordAddress, ranges[i].len);
+    if (TMR_SUCCESS != ret)
+    {
+      return ret;
+    }
+    opList[i] = &ops[i];
+  }
+  listOp.type = TMR_TAGOP_LIST;
+  listOp.u.list.list = opList;
+  listOp.u.list.len = count;
+
+  plan = savedPlan;
+  plan.u.simple.tagop = &listOp;
+  ret = TMR_paramSet(reader, TMR_PARAM_READ_PLAN, &plan);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
+  ret = TMR_read(reader, timeoutMs, &tagCount);
+  if ((TMR_SUCCESS == ret) || (TMR_ERROR_TAG_ID_BUFFER_FULL == ret))
+  {
+    ret = TMR_SUCCESS;
+    while (TMR_SUCCESS == TMR_hasMoreTags(reader))
+    {
+      TMR_TRD_init(&read);
+      ret = TMR_getNextTag(reader, &read);
+      if (TMR_SUCCESS != ret)
+      {
+        break;
+      }
+      ret = TMR_TagReadMap_add(map, &read);
+      if (TMR_SUCCESS != ret)
+      {
+        break;
+      }
+    }
+  }
+
+  /* The tagop list lives on this stack frame; always put the plan back */
+  ret1 = TMR_paramSet(reader, TMR_PARAM_READ_PLAN, &savedPlan);
+  if (TMR_SUCCESS == ret)
+  {
+    ret = ret1;
+  }
+  return ret;
+}
+
 TMR_Status
 validateReadPlan(TMR_Reader *reader, TMR_ReadPlan *plan,
                   TMR_AntennaMapList *txRxMap, uint32_t protocols)
@@ -634,7 +969,9 @@ validateReadPlan(TMR_Reader *reader, TMR_ReadPlan *plan,
     }
     if (NULL != plan->u.simple.tagop)
     {
-      if (TMR_TAGOP_LIST == plan->u.simple.tagop->type)
+      /* Only LLRP readers run a tagop list, as one multi-OpSpec AccessSpec */
+      if ((TMR_TAGOP_LIST == plan->u.simple.tagop->type) &&
+          (TMR_READER_TYPE_LLRP != reader->readerType))
         return TMR_ERROR_UNSUPPORTED; /* not yet supported */
     }
   }
@@ -651,6 +988,18 @@ TMR_paramSet(struct TMR_Reader *reader, TMR_Param key, const void *value)
 
   switch (key)
   {
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  case TMR_PARAM_PIPELINE_STATS:
+    /* Setting the stats, whatever the value, clears the counters */
+    TMR__pipelineResetStats(reader);
+    break;
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  case TMR_PARAM_PIPELINE_STATS_PERIOD:
+    reader->pipelineStatsPeriod = *(uint32_t *)value;
+    reader->pipelineStatsNextUs = 0;
+    break;
+#endif
+#endif
 #ifdef TMR_ENABLE_BACKGROUND_READS
   case TMR_PARAM_READ_ASYNCOFFTIME:
       {
@@ -691,6 +1040,16 @@ TMR_paramGet(struct TMR_Reader *reader, TMR_Param key, void *value)
     *plan = *reader->readParams.readPlan;
     break;
   }
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  case TMR_PARAM_PIPELINE_STATS:
+    TMR__pipelineGetStats(reader, value);
+    break;
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  case TMR_PARAM_PIPELINE_STATS_PERIOD:
+    *(uint32_t *)value = reader->pipelineStatsPeriod;
+    break;
+#endif
+#endif
 #ifdef TMR_ENABLE_BACKGROUND_READS
   case TMR_PARAM_READ_ASYNCOFFTIME:
   {
@@ -1218,6 +1577,8 @@ TMR_RP_init_simple(TMR_ReadPlan *plan, uint8_t antennaCount,
   plan->u.simple.useFastSearch = false;
   plan->u.simple.stopOnCount.stopNTriggerStatus = false;
   plan->u.simple.stopOnCount.noOfTags = 0;
+  plan->u.simple.reportTrigger.tagCount = 0;
+  plan->u.simple.reportTrigger.periodMs = 0;
   
   return TMR_SUCCESS;
 }
@@ -1241,6 +1602,28 @@ TMR_RP_set_stopTrigger(TMR_ReadPlan *plan, uint32_t nCount)
   return TMR_SUCCESS;
 }
 
+/**
+ * Set the report trigger of a simple read plan. Used during
+ * continuous reading to bound the latency between a tag being
+ * seen and its read being delivered.
+ *
+ * @param plan Pointer to the read plan
+ * @param tagCount Number of tags per report, 0 for the default
+ * @param periodMs Maximum milliseconds between reports, 0 for no limit
+ */
+TMR_Status
+TMR_RP_set_reportTrigger(TMR_ReadPlan *plan, uint16_t tagCount, uint32_t periodMs)
+{
+
+  if (TMR_READ_PLAN_TYPE_SIMPLE != plan->type)
+    return TMR_ERROR_INVALID;
+
+  plan->u.simple.reportTrigger.tagCount = tagCount;
+  plan->u.simple.reportTrigger.periodMs = periodMs;
+
+  return TMR_SUCCESS;
+}
+
 /**
  * Set the filter of a simple read plan.
  *
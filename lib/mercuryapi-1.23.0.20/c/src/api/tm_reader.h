@@ -184,6 +184,169 @@ typedef struct TMR_Reader_StatsValues
 	TMR_StatsPerAntennaValues _perAntStorage[TMR_SR_MAX_ANTENNA_PORTS];
 }TMR_Reader_StatsValues;
 
+/**
+ * Parts of a TMR_DedupPolicy that a reader or module can apply itself.
+ */
+typedef enum TMR_DedupField
+{
+  /** Repeated reads of a tag are dropped */
+  TMR_DEDUP_FIELD_FILTER          = 0x01,
+  /** Filter entries expire after TMR_DedupPolicy::windowMs */
+  TMR_DEDUP_FIELD_WINDOW          = 0x02,
+  /** Reads on different antennas are kept apart */
+  TMR_DEDUP_FIELD_UNIQUEBYANTENNA = 0x04,
+  /** Reads with different embedded data are kept apart */
+  TMR_DEDUP_FIELD_UNIQUEBYDATA    = 0x08,
+  /** Reads with different protocols are kept apart */
+  TMR_DEDUP_FIELD_UNIQUEBYPROTOCOL = 0x10,
+  /** The highest-RSSI read of a tag is the one kept */
+  TMR_DEDUP_FIELD_HIGHESTRSSI     = 0x20,
+} TMR_DedupField;
+
+/**
+ * Tag read deduplication policy, the "/reader/tagReadData/dedupPolicy"
+ * parameter.
+ *
+ * Setting the policy pushes every field the connected device supports
+ * down to it, so duplicate reads never cross the wire.  Whatever the
+ * device cannot do is done by the API before reads reach the
+ * listeners, with the same meaning on every reader type:
+ *
+ * - A read is a duplicate of an earlier one when the EPCs match and,
+ *   for each uniqueBy field that is set, that attribute matches too.
+ * - A duplicate is dropped if the earlier read was reported less than
+ *   windowMs ago.  A windowMs of 0 reports each tag once per read
+ *   (once per search cycle for background reads: each TMR_read() of
+ *   a pseudo-async read, or each asyncOnTime of a streaming one).
+ * - recordHighestRssi keeps the strongest read of a tag.  Only the
+ *   device and TMR_readIntoArray() can do this; a background read
+ *   already handed to a listener is not taken back.
+ *
+ * The individual "/reader/tagReadData/uniqueBy*", "recordHighestRssi",
+ * "enableReadFilter" and "readFilterTimeout" parameters remain, and
+ * setting them also updates this policy.
+ */
+typedef struct TMR_DedupPolicy
+{
+  /** Drop duplicate reads */
+  bool enable;
+  /** Treat reads on different antennas as different tags */
+  bool uniqueByAntenna;
+  /** Treat reads with different embedded data as different tags */
+  bool uniqueByData;
+  /** Treat reads with different protocols as different tags */
+  bool uniqueByProtocol;
+  /** Keep the highest-RSSI read of each tag */
+  bool recordHighestRssi;
+  /** Time (ms) before a tag already reported is reported again, 0 = once per search cycle */
+  uint32_t windowMs;
+  /**
+   * TMR_DedupField mask of the fields the device applies itself.
+   * Ignored by set; filled in by get.
+   */
+  uint32_t deviceFields;
+} TMR_DedupPolicy;
+
+/**
+ * @private
+ * API-side filter for reads the device did not deduplicate.
+ */
+typedef struct TMR_DedupTable
+{
+  /**
+   * Tags reported, with the time each was last reported as its lastUs
+   * since base (see tmr_tag_table.h); allocated only while the API
+   * filters
+   */
+  struct TMR_TagTable *tags;
+  /** tmr_gettime() when the table was reset */
+  uint64_t base;
+  /** Length of a streaming search cycle (ms), 0 when each TMR_read() is one */
+  uint32_t cycleMs;
+  /** Whether the API, rather than the device, filters this read */
+  bool active;
+} TMR_DedupTable;
+
+/** Number of buckets in a TMR_Histogram */
+#define TMR_HISTOGRAM_BUCKETS 240
+
+/**
+ * A log-linear (HDR style) histogram of non-negative values,
+ * typically microseconds.  Values 0-7 have a bucket each; above that
+ * each power of two is split into 8 buckets, so a recorded value is
+ * known to within 12.5% from 8 up to 2^32-1.
+ *
+ * Recording is a few relaxed atomic increments, with no lock.  A
+ * copy taken while another thread records may be off by the values
+ * in flight.
+ */
+typedef struct TMR_Histogram
+{
+  /** Number of values recorded in each bucket */
+  uint32_t counts[TMR_HISTOGRAM_BUCKETS];
+  /** Number of values recorded */
+  uint64_t count;
+  /** Sum of the values recorded */
+  uint64_t sum;
+  /** Largest value recorded */
+  uint32_t max;
+} TMR_Histogram;
+
+/**
+ * Callback time of one read listener, see TMR_PipelineStats.
+ */
+typedef struct TMR_ListenerStats
+{
+  /** The TMR_ReadListenerBlock timed, NULL for an unused slot */
+  const void *block;
+  /** Time spent in each call, in microseconds */
+  TMR_Histogram callbackUs;
+} TMR_ListenerStats;
+
+/**
+ * Host-side read pipeline statistics, the "/reader/pipeline/stats"
+ * parameter.  TMR_Reader_StatsValues reports what the module sees;
+ * these report what happens to reads after they leave it, so lost
+ * reads can be put down to the transport, the background read queue
+ * or slow listeners.
+ *
+ * Counters start at zero when the reader is created and only go up;
+ * setting the parameter, whatever the value, clears them.  LLRP
+ * readers count whole messages and their bytes, and have no CRC or
+ * resync events.
+ */
+typedef struct TMR_PipelineStats
+{
+  /** Bytes received from the device */
+  uint64_t transportBytes;
+  /** Messages received from the device intact */
+  uint64_t transportFrames;
+  /** Messages received with a bad CRC */
+  uint64_t crcErrors;
+  /** Times the receiver discarded bytes looking for a start of message */
+  uint64_t resyncs;
+  /** Messages waiting in the background read queue */
+  uint32_t queueDepth;
+  /** Most messages ever waiting in the background read queue */
+  uint32_t queueHighWater;
+  /** Messages put on the background read queue */
+  uint64_t enqueued;
+  /** Messages taken off the background read queue and parsed */
+  uint64_t dispatched;
+  /** Times the background reader paused because the queue was nearly full */
+  uint64_t queueStalls;
+  /** Times the queue filled up and background reading was stopped */
+  uint64_t overflows;
+  /** Messages the background reader received but dropped as corrupt */
+  uint64_t drops;
+  /** Tag reads dropped by the API-side dedup filter */
+  uint64_t duplicates;
+  /** Time from a message being queued to the parser taking it, in microseconds */
+  TMR_Histogram dispatchLatencyUs;
+  /** Callback time of the read listeners, one slot per listener */
+  TMR_ListenerStats listeners[TMR_PIPELINE_MAX_LISTENERS];
+} TMR_PipelineStats;
+
 /** Type of functions to be registered as read callbacks */
 typedef void (*TMR_ReadListener)(TMR_Reader *reader, const TMR_TagReadData *t,
                                  void *cookie);
@@ -290,6 +453,54 @@ typedef struct TMR_StatusListenerBlock
   struct TMR_StatusListenerBlock *next;
 } TMR_StatusListenerBlock;
 
+/** Type of functions to be registered as pipeline statistics callbacks */
+typedef void (*TMR_PipelineStatsListener)(TMR_Reader *reader,
+                                          const TMR_PipelineStats *stats,
+                                          void *cookie);
+/**
+ * User-allocated structure containing the callback pointer and the
+ * value to pass to that callback.
+ */
+typedef struct TMR_PipelineStatsListenerBlock
+{
+  /** Pointer to callback function */
+  TMR_PipelineStatsListener listener;
+  /** Value to pass to callback function */
+  void *cookie;
+  /** @private */
+  struct TMR_PipelineStatsListenerBlock *next;
+} TMR_PipelineStatsListenerBlock;
+
+/**
+ * A stretch of continuous reading in which no tag reads were delivered
+ * because the connection to the reader was lost.
+ */
+typedef struct TMR_ConnectionGap
+{
+  /** tmr_gettime() of the last read delivered before the loss */
+  uint64_t startMs;
+  /** Milliseconds from then until the connection was restored */
+  uint32_t lengthMs;
+} TMR_ConnectionGap;
+
+/** Type of functions to be registered as connection gap callbacks */
+typedef void (*TMR_ConnectionGapListener)(TMR_Reader *reader,
+                                          const TMR_ConnectionGap *gap,
+                                          void *cookie);
+/**
+ * User-allocated structure containing the callback pointer and the
+ * value to pass to that callback.
+ */
+typedef struct TMR_ConnectionGapListenerBlock
+{
+  /** Pointer to callback function */
+  TMR_ConnectionGapListener listener;
+  /** Value to pass to callback function */
+  void *cookie;
+  /** @private */
+  struct TMR_ConnectionGapListenerBlock *next;
+} TMR_ConnectionGapListenerBlock;
+
 /**
  * Private: should not be used by user level application.
  */
@@ -307,6 +518,8 @@ typedef struct TMR_Queue_tagReads
 
   uint8_t bufPointer;
   bool isStatusResponse;
+  /* Time the message was queued, for the pipeline statistics */
+  uint64_t enqueueUs;
   struct TMR_Queue_tagReads  *next;
 }TMR_Queue_tagReads;
 
@@ -348,6 +561,11 @@ struct TMR_Reader
   enum TMR_ReaderType readerType;
   bool connected;
   TMR_TransportListenerBlock *transportListeners;
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+  struct TMR_TransportTap *transportTap;
+  /* Threads writing a frame to the tap; it is freed only once there are none */
+  uint32_t transportTapWriters;
+#endif
 
   TMR_readParams readParams;
   TMR_tagOpParams tagOpParams;
@@ -373,6 +591,10 @@ struct TMR_Reader
   bool _storeSupportsResetStats;
   /* the option to request for background thread cancel */
   bool backgroundThreadCancel;
+  /* Deduplication policy, see TMR_DedupPolicy */
+  TMR_DedupPolicy dedupPolicy;
+  /* Host-side pipeline statistics */
+  TMR_PipelineStats pipelineStats;
 
   union
   {
@@ -407,6 +629,12 @@ struct TMR_Reader
   TMR_StatsListenerBlock *statsListeners;
   TMR_StatusListenerBlock *statusListeners;
   TMR_Queue_tagReads *tagReadQueue;
+  TMR_DedupTable dedupTable;
+  TMR_PipelineStatsListenerBlock *pipelineStatsListeners;
+  TMR_ConnectionGapListenerBlock *connectionGapListeners;
+  /* Pipeline statistics listener period (ms), 0 to disable */
+  uint32_t pipelineStatsPeriod;
+  uint64_t pipelineStatsNextUs;
 #endif
   TMR_Reader_StatsFlag statsFlag;
   TMR_SR_StatusType streamStats;
@@ -618,6 +846,89 @@ TMR_Status TMR_executeTagOp(struct TMR_Reader *reader, TMR_TagOp *tagop, TMR_Tag
 
 TMR_Status TMR_readIntoArray(struct TMR_Reader *reader, uint32_t timeoutMs, int32_t *tagCount, TMR_TagReadData *result[]);
 
+/**
+ * A range of tag memory for TMR_readTagMemRanges()
+ */
+typedef struct TMR_TagMemRange
+{
+  /** Memory bank to read */
+  TMR_GEN2_Bank bank;
+  /** Word address of the first word to read */
+  uint32_t wordAddress;
+  /** Number of words to read */
+  uint8_t len;
+} TMR_TagMemRange;
+
+/**
+ * Tag reads keyed by EPC.  Every TMR_TagReadData in the map is
+ * allocated by the API and released by TMR_TagReadMap_free().
+ * To visit every tag, walk slots[0 .. capacity - 1] and skip the
+ * NULL entries.
+ */
+typedef struct TMR_TagReadMap
+{
+  /** Hash slots, NULL when empty */
+  TMR_TagReadData **slots;
+  /** Number of slots, a power of two */
+  uint32_t capacity;
+  /** Number of tags in the map */
+  uint32_t count;
+} TMR_TagReadMap;
+
+/**
+ * @ingroup reader
+ * Initialize an empty TMR_TagReadMap.
+ *
+ * @param map The map to initialize
+ */
+TMR_Status TMR_TagReadMap_init(TMR_TagReadMap *map);
+
+/**
+ * @ingroup reader
+ * Look up the read of a tag by EPC.
+ *
+ * @param map The map to search
+ * @param tag The tag to look for, only the EPC is compared
+ * @return The read of that tag, or NULL if the tag is not in the map
+ */
+TMR_TagReadData *TMR_TagReadMap_find(const TMR_TagReadMap *map, const TMR_TagData *tag);
+
+/**
+ * @ingroup reader
+ * Release every read in a TMR_TagReadMap and the map's slots.
+ *
+ * @param map The map to free
+ */
+void TMR_TagReadMap_free(TMR_TagReadMap *map);
+
+/**
+ * @ingroup reader
+ * Read one or more memory ranges from every tag in the field in a
+ * single inventory, and merge the results into a map keyed by EPC.
+ *
+ * The current simple read plan (antennas, protocol, filter) is used
+ * with its tagop replaced by a list of Gen2 ReadData operations, one
+ * per range; the plan is restored afterwards.  LLRP readers run the
+ * whole list as one AccessSpec with an OpSpec per range, instead of
+ * one AccessSpec per operation per tag.  The data of each range ends
+ * up in the epcMemData, tidMemData, userMemData or reservedMemData
+ * list of the tag's read; ranges of the same bank are appended in
+ * order.  A tag read more than once keeps the first data read from
+ * each bank, and its readCount is the sum of all its reads.
+ *
+ * The map may already hold reads; call this repeatedly with the same
+ * map to pick up tags missed in an earlier pass.
+ *
+ * @param reader The reader being operated on
+ * @param timeoutMs The number of milliseconds to search for tags
+ * @param count Number of ranges, at most TMR_MAX_TAGMEM_RANGES
+ * @param ranges The memory ranges to read
+ * @param map The map to add the reads to, see TMR_TagReadMap_init()
+ */
+TMR_Status TMR_readTagMemRanges(struct TMR_Reader *reader, uint32_t timeoutMs,
+                                uint8_t count, const TMR_TagMemRange ranges[],
+                                TMR_TagReadMap *map);
+
 /**
  * @deprecated This method is deprecated 
  *
@@ -907,6 +1218,7 @@ TMR_Status TMR_reboot(struct TMR_Reader *reader);
  * @li /reader/status/antennaEnable
  * @li /reader/status/frequencyEnable
  * @li /reader/status/temperatureEnable
+ * @li /reader/tagReadData/dedupPolicy
  * @li /reader/tagReadData/enableReadFilter
  * @li /reader/tagReadData/readFilterTimeout
  * @li /reader/tagReadData/recordHighestRssi
@@ -1116,6 +1428,85 @@ TMR_Status TMR_addStatsListener(struct TMR_Reader *reader,
 TMR_Status TMR_removeStatsListener(struct TMR_Reader *reader,
                                   TMR_StatsListenerBlock *block);
 
+/**
+ * @ingroup reader
+ * Add a listener to the list of functions that will be called with a
+ * snapshot of the pipeline statistics every
+ * "/reader/pipeline/statsPeriod" milliseconds during background
+ * reads.  The listeners are called from the background read thread,
+ * so they should be quick.
+ *
+ * @param reader The reader to operate on.
+ * @param block A structure containing a pointer to the listener
+ * function and a user-supplied cookie value to pass to the function
+ * when called.
+ */
+TMR_Status TMR_addPipelineStatsListener(struct TMR_Reader *reader,
+                                        TMR_PipelineStatsListenerBlock *block);
+
+/**
+ * @ingroup reader
+ * Remove a listener from the list of functions that will be called
+ * with the pipeline statistics.
+ *
+ * @param reader The reader to operate on.
+ * @param block A structure containing a pointer to the listener
+ * function and a user-supplied cookie value to pass to the function
+ * when called.
+ */
+TMR_Status TMR_removePipelineStatsListener(struct TMR_Reader *reader,
+                                           TMR_PipelineStatsListenerBlock *block);
+
+/**
+ * @ingroup reader
+ * Add a listener to the list of functions that will be called when
+ * continuous reading resumes after the connection to the reader was
+ * lost (see "/reader/llrp/autoReconnect").  The listeners get when
+ * the last read before the loss was delivered and how long reading
+ * was interrupted, just before the exception listeners get
+ * TMR_ERROR_LLRP_READER_CONNECTION_RESTORED.
+ *
+ * @param reader The reader to operate on.
+ * @param block A structure containing a pointer to the listener
+ * function and a user-supplied cookie value to pass to the function
+ * when called.
+ */
+TMR_Status TMR_addConnectionGapListener(struct TMR_Reader *reader,
+                                        TMR_ConnectionGapListenerBlock *block);
+
+/**
+ * @ingroup reader
+ * Remove a listener from the list of functions that will be called
+ * when continuous reading resumes after a connection loss.
+ *
+ * @param reader The reader to operate on.
+ * @param block A structure containing a pointer to the listener
+ * function and a user-supplied cookie value to pass to the function
+ * when called.
+ */
+TMR_Status TMR_removeConnectionGapListener(struct TMR_Reader *reader,
+                                           TMR_ConnectionGapListenerBlock *block);
+
+/**
+ * @ingroup reader
+ * Get the value at a percentile of a histogram.
+ *
+ * @param histogram The histogram
+ * @param percentile The percentile, 0 to 100
+ * @return The upper bound of the bucket the percentile falls in (never
+ * above the largest value recorded), 0 if the histogram is empty
+ */
+uint32_t TMR_histogramPercentile(const TMR_Histogram *histogram, double percentile);
+
+/**
+ * @ingroup reader
+ * Get the largest value that falls in a histogram bucket, for
+ * exporting the buckets.
+ *
+ * @param index The bucket, 0 to TMR_HISTOGRAM_BUCKETS-1
+ */
+uint32_t TMR_histogramBucketLimit(int index);
+
 
 /**
  * @ingroup reader
@@ -1179,6 +1570,27 @@ void TMR__notifyTransportListeners(TMR_Reader *reader, bool tx,
 void notify_exception_listeners(TMR_Reader *reader, TMR_Status status);
 void cleanup_background_threads(TMR_Reader *reader);
 
+void TMR__histogramRecord(TMR_Histogram *histogram, uint32_t value);
+uint64_t TMR__pipelineNowUs(void);
+void TMR__pipelineGetStats(TMR_Reader *reader, TMR_PipelineStats *stats);
+void TMR__pipelineResetStats(TMR_Reader *reader);
+void TMR__pipelineListenerTime(TMR_Reader *reader, const void *block, uint64_t startUs);
+void TMR__pipelineListenerRemoved(TMR_Reader *reader, const void *block);
+TMR_Status TMR__dedupReset(TMR_Reader *reader, bool streaming);
+void TMR__dedupFree(TMR_Reader *reader);
+bool TMR__dedupIsDuplicate(TMR_Reader *reader, const TMR_TagReadData *trd);
+
+#ifdef TMR_ENABLE_PIPELINE_STATS
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#define TMR__PIPELINE_ADD(reader, field, n) \
+  ((void)__atomic_fetch_add(&(reader)->pipelineStats.field, (n), __ATOMIC_RELAXED))
+#else
+#define TMR__PIPELINE_ADD(reader, field, n) ((void)((reader)->pipelineStats.field += (n)))
+#endif
+#else
+#define TMR__PIPELINE_ADD(reader, field, n) ((void)0)
+#endif
+
 #ifdef TMR_ENABLE_SERIAL_READER_ONLY
 
 #define TMR_connect(reader) (TMR_SR_connect(reader))
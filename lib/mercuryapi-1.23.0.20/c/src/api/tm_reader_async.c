@@ -30,6 +30,7 @@
 #ifdef TMR_ENABLE_BACKGROUND_READS
 
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <time.h>
@@ -46,10 +47,14 @@
 #endif
 #include "osdep.h"
 #include "tmr_utils.h"
+#include "tmr_trace.h"
+#include "tmr_tag_table.h"
 
 static void *do_background_reads(void *arg);
 static void *parse_tag_reads(void *arg);
 static void process_async_response(TMR_Reader *reader);
+static void dedup_cycle(TMR_Reader *reader, uint64_t now);
+static void notify_pipeline_stats_listeners(TMR_Reader *reader);
 
 TMR_Status
 TMR_startReading(struct TMR_Reader *reader)
@@ -119,6 +124,17 @@ TMR_startReading(struct TMR_Reader *reader)
     return TMR_ERROR_UNSUPPORTED;
 #endif/* TMR_ENABLE_SERIAL_READER */    
   }
+
+  /**
+   * Each background read starts with an empty dedup filter.
+   * Streaming readers use the parser thread.
+   **/
+  ret = TMR__dedupReset(reader, createParser);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
 #ifdef TMR_ENABLE_LLRP_READER
   if (TMR_READER_TYPE_LLRP == reader->readerType)
   {
@@ -133,6 +149,7 @@ TMR_startReading(struct TMR_Reader *reader)
      * for async reads.
      **/
     reader->u.llrpReader.ka_start = tmr_gettime();
+    reader->u.llrpReader.lastReadTime = reader->u.llrpReader.ka_start;
   }
 #endif
 
@@ -347,25 +364,287 @@ TMR_stopReading(struct TMR_Reader *reader)
   return TMR_SUCCESS;
 }
 
+/**
+ * Prepare the API-side dedup filter for a background read.  The API
+ * filters only when the policy asks for it and the device is not
+ * already doing so: streaming M6e modules filter in the module, while
+ * pseudo-async reads restart the device filter on every TMR_read(),
+ * so repeats across those reads are dropped here.
+ *
+ * With no window, a tag is reported once per search cycle, as the
+ * device filter does: pseudo-async reads start a cycle with each
+ * TMR_read(), streaming reads every asyncOnTime.
+ **/
+TMR_Status
+TMR__dedupReset(TMR_Reader *reader, bool streaming)
+{
+  TMR_DedupTable *table = &reader->dedupTable;
+  TMR_Status ret;
+
+  table->active = reader->dedupPolicy.enable &&
+                  ((false == streaming) ||
+                   (0 == (reader->dedupPolicy.deviceFields & TMR_DEDUP_FIELD_FILTER)));
+  table->cycleMs = streaming ? reader->readParams.asyncOnTime : 0;
+  table->base = tmr_gettime();
+  if (false == table->active)
+  {
+    TMR__dedupFree(reader);
+    return TMR_SUCCESS;
+  }
+  if (NULL != table->tags)
+  {
+    TMR_tagTableClear(table->tags);
+    return TMR_SUCCESS;
+  }
+
+  table->tags = malloc(sizeof(*table->tags));
+  if (NULL == table->tags)
+  {
+    table->active = false;
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  ret = TMR_tagTableInit(table->tags, TMR_DEDUP_TABLE_SIZE, sizeof(TMR_TagTableEntry));
+  if (TMR_SUCCESS != ret)
+  {
+    free(table->tags);
+    table->tags = NULL;
+    table->active = false;
+  }
+  return ret;
+}
+
+/**
+ * Release the API-side dedup filter's table.
+ **/
+void
+TMR__dedupFree(TMR_Reader *reader)
+{
+  TMR_DedupTable *table = &reader->dedupTable;
+
+  if (NULL != table->tags)
+  {
+    TMR_tagTableDestroy(table->tags);
+    free(table->tags);
+    table->tags = NULL;
+  }
+}
+
+/**
+ * Start a new search cycle: forget the tags reported so far unless the
+ * policy has a window, which then decides alone when a tag is reported
+ * again.
+ **/
+static void
+dedup_cycle(TMR_Reader *reader, uint64_t now)
+{
+  TMR_DedupTable *table = &reader->dedupTable;
+
+  if ((0 == reader->dedupPolicy.windowMs) && (NULL != table->tags))
+  {
+    TMR_tagTableClear(table->tags);
+    table->base = now;
+  }
+}
+
+/**
+ * Drop the tags whose window has passed, to make room for new ones.
+ * They would be reported again anyway.
+ **/
+static void
+dedup_purge(TMR_TagTable *tags, uint64_t nowUs, uint64_t windowUs)
+{
+  TMR_TagTableEntry *entry;
+  uint32_t i;
+
+  i = 0;
+  while (i < tags->count)
+  {
+    entry = TMR_tagTableAt(tags, i);
+    if ((0 != entry->key) && (nowUs - entry->lastUs >= windowUs))
+    {
+      /* A later entry may have moved into the slot */
+      TMR_tagTableRemove(tags, entry);
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+static uint32_t
+dedup_hash(uint32_t hash, const uint8_t *data, uint32_t len)
+{
+  uint32_t i;
+
+  /* 32 bit FNV-1a */
+  for (i = 0; i < len; i++)
+  {
+    hash ^= data[i];
+    hash *= 0x01000193U;
+  }
+  return hash;
+}
+
+/**
+ * Check a read against the API-side dedup filter.  The table grows to
+ * hold every tag reported in the cycle or window.
+ *
+ * @return true if the read repeats one reported within the policy
+ * window and should not reach the listeners.
+ **/
+bool
+TMR__dedupIsDuplicate(TMR_Reader *reader, const TMR_TagReadData *trd)
+{
+  TMR_DedupTable *table = &reader->dedupTable;
+  const TMR_DedupPolicy *policy = &reader->dedupPolicy;
+  TMR_TagTable *tags = table->tags;
+  TMR_TagTableEntry *entry;
+  uint64_t time, nowUs, windowUs;
+  uint32_t extra;
+  bool found;
+
+  if ((false == table->active) || (NULL == tags))
+  {
+    return false;
+  }
+
+  /* The EPC is compared whole; the uniqueBy fields are hashed in */
+  extra = 0x811c9dc5U;
+  if (policy->uniqueByAntenna)
+  {
+    extra = dedup_hash(extra, &trd->antenna, sizeof(trd->antenna));
+  }
+  if (policy->uniqueByData)
+  {
+    extra = dedup_hash(extra, trd->data.list, trd->data.len);
+  }
+  if (policy->uniqueByProtocol)
+  {
+    extra = dedup_hash(extra, (const uint8_t *)&trd->tag.protocol, sizeof(trd->tag.protocol));
+  }
+
+  time = tmr_gettime();
+  if ((0 != table->cycleMs) && (time - table->base >= table->cycleMs))
+  {
+    dedup_cycle(reader, time);
+  }
+  nowUs = (time - table->base) * 1000;
+  windowUs = (uint64_t)policy->windowMs * 1000;
+
+  entry = TMR_tagTableFind(tags, &trd->tag, extra, true, &found);
+  if (found)
+  {
+    if ((0 == windowUs) || (nowUs - entry->lastUs < windowUs))
+    {
+      TMR__PIPELINE_ADD(reader, duplicates, 1);
+      return true;
+    }
+    entry->lastUs = nowUs;
+    return false;
+  }
+
+  /**
+   * A full probe run would mean evicting a tag still being filtered:
+   * drop the expired ones, then grow until there is room.
+   **/
+  if ((0 != entry->key) || (tags->used >= (tags->count / 4) * 3))
+  {
+    if (0 != windowUs)
+    {
+      dedup_purge(tags, nowUs, windowUs);
+    }
+    entry = TMR_tagTableFind(tags, &trd->tag, extra, true, &found);
+    while ((0 != entry->key) || (tags->used >= (tags->count / 4) * 3))
+    {
+      if (TMR_SUCCESS != TMR_tagTableGrow(tags))
+      {
+        /* Out of memory: report the tag rather than forget another */
+        return false;
+      }
+      entry = TMR_tagTableFind(tags, &trd->tag, extra, true, &found);
+    }
+  }
+  TMR_tagTableClaim(tags, entry, &trd->tag, extra);
+  entry->lastUs = nowUs;
+
+  return false;
+}
+
 void
 notify_read_listeners(TMR_Reader *reader, TMR_TagReadData *trd)
 {
   TMR_ReadListenerBlock *rlb;
+  uint32_t position;
 
   /* notify tag read to listener */
   if (NULL != reader)
   {
     pthread_mutex_lock(&reader->listenerLock);
     rlb = reader->readListeners;
+    position = 0;
     while (rlb)
     {
+      TMR_TRACE(LISTENER_ENTER, reader, position, trd->antenna);
+#ifdef TMR_ENABLE_PIPELINE_STATS
+      uint64_t start = TMR__pipelineNowUs();
+
       rlb->listener(reader, trd, rlb->cookie);
+      TMR__pipelineListenerTime(reader, rlb, start);
+#else
+      rlb->listener(reader, trd, rlb->cookie);
+#endif
+      TMR_TRACE(LISTENER_EXIT, reader, position, trd->antenna);
+      position++;
       rlb = rlb->next;
     }
+#ifdef TMR_ENABLE_LLRP_READER
+    if (TMR_READER_TYPE_LLRP == reader->readerType)
+    {
+      /* Where a connection gap starts, should one follow */
+      reader->u.llrpReader.lastReadTime = tmr_gettime();
+    }
+#endif
     pthread_mutex_unlock(&reader->listenerLock);
   }
 }
 
+/**
+ * Hand a snapshot of the pipeline statistics to the pipeline stats
+ * listeners, if the period has passed since the last one.  Only
+ * called from the background read thread.
+ **/
+static void
+notify_pipeline_stats_listeners(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  TMR_PipelineStatsListenerBlock *plb;
+  TMR_PipelineStats stats;
+  uint64_t now;
+
+  if ((NULL == reader->pipelineStatsListeners) || (0 == reader->pipelineStatsPeriod))
+  {
+    return;
+  }
+  now = TMR__pipelineNowUs();
+  if (now < reader->pipelineStatsNextUs)
+  {
+    return;
+  }
+  reader->pipelineStatsNextUs = now + ((uint64_t)reader->pipelineStatsPeriod * 1000);
+
+  TMR__pipelineGetStats(reader, &stats);
+  pthread_mutex_lock(&reader->listenerLock);
+  plb = reader->pipelineStatsListeners;
+  while (plb)
+  {
+    plb->listener(reader, &stats, plb->cookie);
+    plb = plb->next;
+  }
+  pthread_mutex_unlock(&reader->listenerLock);
+#endif
+}
+
 void
 notify_stats_listeners(TMR_Reader *reader, TMR_Reader_StatsValues *stats)
 {
@@ -449,11 +728,29 @@ TMR_removeReadExceptionListener(TMR_Reader *reader,
   return TMR_SUCCESS;
 }
 
+#ifdef TMR_ENABLE_LLRP_READER
+static void
+notify_connection_gap_listeners(TMR_Reader *reader, const TMR_ConnectionGap *gap)
+{
+  TMR_ConnectionGapListenerBlock *glb;
+
+  pthread_mutex_lock(&reader->listenerLock);
+  glb = reader->connectionGapListeners;
+  while (glb)
+  {
+    glb->listener(reader, gap, glb->cookie);
+    glb = glb->next;
+  }
+  pthread_mutex_unlock(&reader->listenerLock);
+}
+#endif
+
 void
 notify_exception_listeners(TMR_Reader *reader, TMR_Status status)
 {
   TMR_ReadExceptionListenerBlock *relb;
 
+  TMR_TRACE(EXCEPTION, reader, status, 0);
   if (NULL != reader)
   {
     pthread_mutex_lock(&reader->listenerLock);
@@ -475,6 +772,8 @@ dequeue(TMR_Reader *reader)
   tagRead = reader->tagReadQueue;
   reader->tagReadQueue = reader->tagReadQueue->next;
   reader->queue_depth --;
+  reader->pipelineStats.queueDepth = reader->queue_depth;
+  TMR_TRACE(QUEUE_DEQUEUE, reader, reader->queue_depth, 0);
   pthread_mutex_unlock(&reader->queue_lock);
   return(tagRead);
 }
@@ -486,6 +785,12 @@ void enqueue(TMR_Reader *reader, TMR_Queue_tagReads *tagRead)
   tagRead->next = reader->tagReadQueue;   /* Insert at head of list */
   reader->tagReadQueue = tagRead;
   reader->queue_depth ++;
+  reader->pipelineStats.queueDepth = reader->queue_depth;
+  if (reader->queue_depth > reader->pipelineStats.queueHighWater)
+  {
+    reader->pipelineStats.queueHighWater = reader->queue_depth;
+  }
+  TMR_TRACE(QUEUE_ENQUEUE, reader, reader->queue_depth, 0);
   pthread_mutex_unlock(&reader->queue_lock);
 }
 
@@ -526,6 +831,15 @@ parse_tag_reads(void *arg)
        * dequeue it and parse it.
        */          
       tagRead = dequeue(reader);
+#ifdef TMR_ENABLE_PIPELINE_STATS
+      {
+        uint64_t waited = TMR__pipelineNowUs() - tagRead->enqueueUs;
+
+        TMR__PIPELINE_ADD(reader, dispatched, 1);
+        TMR__histogramRecord(&reader->pipelineStats.dispatchLatencyUs,
+                             (waited > UINT32_MAX) ? UINT32_MAX : (uint32_t)waited);
+      }
+#endif
       if (false == tagRead->isStatusResponse)
       {
         /* Tag Buffer stream response */
@@ -543,7 +857,10 @@ parse_tag_reads(void *arg)
           TMR_SR_postprocessReaderSpecificMetadata(&trd, &reader->u.serialReader);
           
           trd.reader = reader;
-          notify_read_listeners(reader, &trd);
+          if (false == TMR__dedupIsDuplicate(reader, &trd))
+          {
+            notify_read_listeners(reader, &trd);
+          }
         }
 #endif/* TMR_ENABLE_SERIAL_READER */           
 #ifdef TMR_ENABLE_LLRP_READER
@@ -565,7 +882,10 @@ parse_tag_reads(void *arg)
             TMR_LLRP_parseMetadataFromMessage(reader, &trd, pTagReportData);
           
             trd.reader = reader;
-            notify_read_listeners(reader, &trd);
+            if (false == TMR__dedupIsDuplicate(reader, &trd))
+            {
+              notify_read_listeners(reader, &trd);
+            }
         }
         }
 #endif
@@ -766,8 +1086,12 @@ process_async_response(TMR_Reader *reader)
 #endif
 
   tagRead->isStatusResponse = reader->isStatusResponse;
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  tagRead->enqueueUs = TMR__pipelineNowUs();
+#endif
   /* Enqueue the tagRead into Queue */
   enqueue(reader, tagRead);
+  TMR__PIPELINE_ADD(reader, enqueued, 1);
   /* Increment queue_length */
   sem_post(&reader->queue_length);
 
@@ -777,6 +1101,118 @@ process_async_response(TMR_Reader *reader)
   }
 }
 
+/**
+ * Try to get a continuous read going again after the LLRP
+ * connection was lost. On success the outage, from the last read
+ * delivered until now, is accounted in the connection stats and
+ * handed to the connection gap listeners, the exception listeners
+ * get CONNECTION_RESTORED, and the caller is expected to resubmit
+ * the read plan.
+ *
+ * @return true if the connection was re-established and reading
+ * should go on
+ */
+static bool
+resume_after_connection_loss(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_LLRP_READER
+  if ((TMR_READER_TYPE_LLRP == reader->readerType) &&
+      (true == reader->u.llrpReader.autoReconnect) &&
+      (true == reader->searchStatus))
+  {
+    TMR_LLRP_ConnectionStats *stats;
+    TMR_ConnectionGap gap;
+    uint64_t length;
+
+    stats = &reader->u.llrpReader.connectionStats;
+
+    if (TMR_SUCCESS == TMR_LLRP_reconnect(reader))
+    {
+      /* No read has been delivered since the last one before the loss */
+      pthread_mutex_lock(&reader->listenerLock);
+      gap.startMs = reader->u.llrpReader.lastReadTime;
+      pthread_mutex_unlock(&reader->listenerLock);
+      length = tmr_gettime() - gap.startMs;
+      gap.lengthMs = (uint32_t)length;
+
+      stats->reconnects++;
+      stats->lastGapStartMs = gap.startMs;
+      stats->lastGapMs = gap.lengthMs;
+      stats->totalGapMs += length;
+      notify_connection_gap_listeners(reader, &gap);
+      notify_exception_listeners(reader, TMR_ERROR_LLRP_READER_CONNECTION_RESTORED);
+
+      /* stopReading() might have been called meanwhile */
+      return reader->searchStatus;
+    }
+  }
+#endif
+
+  return false;
+}
+
+/**
+ * A serial reader with /reader/serial/autoResume set starts continuous
+ * reading again after the transport times out, instead of giving up.
+ * Stop the stream the module may still be sending and wait for its
+ * end, posting the reads that come first; the read loop then starts a
+ * new one.  While the module can't be reached keep trying, backing
+ * off up to 200 ms, until it can or stopReading() is called.
+ *
+ * Called without backgroundLock held.
+ *
+ * @return true if continuous reading should be started again
+ **/
+static bool
+resume_after_timeout(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_SERIAL_READER
+  TMR_Status ret;
+  uint32_t retryMs;
+
+  if ((TMR_READER_TYPE_SERIAL != reader->readerType) ||
+      (false == reader->u.serialReader.autoResume))
+  {
+    return false;
+  }
+
+  retryMs = 10;
+  while (true == reader->searchStatus)
+  {
+    reader->u.serialReader.transport.flush(&reader->u.serialReader.transport);
+    ret = reader->cmdStopReading(reader);
+    if (TMR_SUCCESS == ret)
+    {
+      do
+      {
+        ret = TMR_hasMoreTags(reader);
+        if (TMR_SUCCESS == ret)
+        {
+          process_async_response(reader);
+        }
+      }
+      while ((TMR_ERROR_END_OF_READING != ret) &&
+             ((false == TMR_ERROR_IS_COMM(ret)) || (TMR_ERROR_CRC_ERROR == ret)));
+
+      /**
+       * A timeout here means the module wasn't streaming any more;
+       * if it is still out of reach, starting again fails and comes
+       * back here.
+       **/
+      if ((TMR_ERROR_END_OF_READING == ret) || (TMR_ERROR_TIMEOUT == ret))
+      {
+        reader->finishedReading = false;
+        return reader->searchStatus;
+      }
+    }
+    tmr_sleep(retryMs);
+    retryMs = (retryMs < 100) ? retryMs * 2 : 200;
+  }
+#endif
+
+  return false;
+}
+
 static void *
 do_background_reads(void *arg)
 {
@@ -849,6 +1285,19 @@ do_background_reads(void *arg)
         }
 
         notify_exception_listeners(reader, ret);
+        if ((true == reader->continuousReading) && TMR_ERROR_IS_COMM(ret))
+        {
+          /* Reading didn't start, try again once the module answers */
+          pthread_mutex_unlock(&reader->backgroundLock);
+          if (true == resume_after_timeout(reader))
+          {
+            pthread_mutex_lock(&reader->backgroundLock);
+            reader->backgroundEnabled = reader->searchStatus;
+            pthread_mutex_unlock(&reader->backgroundLock);
+            continue;
+          }
+          pthread_mutex_lock(&reader->backgroundLock);
+        }
         if(false == reader->searchStatus)
         {
           /**
@@ -892,6 +1341,7 @@ do_background_reads(void *arg)
       while (true)
       {
         ret = TMR_hasMoreTags(reader);
+        notify_pipeline_stats_listeners(reader);
         if (TMR_SUCCESS == ret)
         {
           /* Got a valid message, before posting it to queue
@@ -908,6 +1358,7 @@ do_background_reads(void *arg)
             {
               if (10 > slotsFree)
               {
+                TMR__PIPELINE_ADD(reader, queueStalls, 1);
                 tmr_sleep(20);
               }
               if (0 >= slotsFree)
@@ -920,6 +1371,7 @@ do_background_reads(void *arg)
                  */
                 if (true == reader->searchStatus)
                 {
+                  TMR__PIPELINE_ADD(reader, overflows, 1);
                   ret = TMR_ERROR_BUFFER_OVERFLOW;
                   notify_exception_listeners(reader, ret);
                   reader->cmdStopReading(reader);
@@ -944,6 +1396,7 @@ do_background_reads(void *arg)
            *
            * TODO: Fix the error by tracing the exact reason of failour
            */
+          TMR__PIPELINE_ADD(reader, drops, 1);
           notify_exception_listeners(reader, ret);
         }
         else if (TMR_ERROR_TAG_ID_BUFFER_FULL == ret)
@@ -973,6 +1426,23 @@ do_background_reads(void *arg)
             (TMR_ERROR_TM_ASSERT_FAILED == ret) || (TMR_ERROR_LLRP_READER_CONNECTION_LOST == ret))
           {
             notify_exception_listeners(reader, ret);
+
+            if ((TMR_ERROR_LLRP_READER_CONNECTION_LOST == ret) &&
+                (true == resume_after_connection_loss(reader)))
+            {
+              /**
+               * Connection is back. Resetting the trueAsyncflag makes
+               * the next pass send the ROSpec and AccessSpecs again.
+               **/
+              reader->trueAsyncflag = false;
+              break;
+            }
+            if ((TMR_ERROR_TIMEOUT == ret) && (true == resume_after_timeout(reader)))
+            {
+              /* The next pass starts reading again */
+              reader->trueAsyncflag = false;
+              break;
+            }
             /** 
              * In case of timeout error or CRC error, flush the transport buffer.
              * this avoids receiving of junk response.
@@ -1051,11 +1521,11 @@ do_background_reads(void *arg)
        */
 
       end = tmr_gettime();
+      dedup_cycle(reader, end);
 
       while (TMR_SUCCESS == TMR_hasMoreTags(reader))
       {
         TMR_TagReadData trd;
-        TMR_ReadListenerBlock *rlb;
 
         TMR_TRD_init(&trd);
 
@@ -1069,15 +1539,14 @@ do_background_reads(void *arg)
           break;
         }
 
-        pthread_mutex_lock(&reader->listenerLock);
-        rlb = reader->readListeners;
-        while (rlb)
-        { 
-          rlb->listener(reader, &trd, rlb->cookie);
-          rlb = rlb->next;
+        if (true == TMR__dedupIsDuplicate(reader, &trd))
+        {
+          continue;
         }
-        pthread_mutex_unlock(&reader->listenerLock);
+
+        notify_read_listeners(reader, &trd);
       }
+      notify_pipeline_stats_listeners(reader);
 
       /* Wait for the asyncOffTime duration to pass */
       now = tmr_gettime();
@@ -1133,6 +1602,9 @@ TMR_removeReadListener(TMR_Reader *reader, TMR_ReadListenerBlock *b)
     if (block == b)
     {
       *prev = block->next;
+#ifdef TMR_ENABLE_PIPELINE_STATS
+      TMR__pipelineListenerRemoved(reader, block);
+#endif
       break;
     }
     prev = &block->next;
@@ -1275,6 +1747,100 @@ TMR_removeStatsListener(TMR_Reader *reader, TMR_StatsListenerBlock *b)
   return TMR_SUCCESS;
 }
 
+TMR_Status
+TMR_addPipelineStatsListener(TMR_Reader *reader, TMR_PipelineStatsListenerBlock *b)
+{
+
+  if (0 != pthread_mutex_lock(&reader->listenerLock))
+    return TMR_ERROR_TRYAGAIN;
+
+  b->next = reader->pipelineStatsListeners;
+  reader->pipelineStatsListeners = b;
+
+  pthread_mutex_unlock(&reader->listenerLock);
+
+  return TMR_SUCCESS;
+}
+
+
+TMR_Status
+TMR_removePipelineStatsListener(TMR_Reader *reader, TMR_PipelineStatsListenerBlock *b)
+{
+  TMR_PipelineStatsListenerBlock *block, **prev;
+
+  if (0 != pthread_mutex_lock(&reader->listenerLock))
+    return TMR_ERROR_TRYAGAIN;
+
+  prev = &reader->pipelineStatsListeners;
+  block = reader->pipelineStatsListeners;
+  while (NULL != block)
+  {
+    if (block == b)
+    {
+      *prev = block->next;
+      break;
+    }
+    prev = &block->next;
+    block = block->next;
+  }
+
+  pthread_mutex_unlock(&reader->listenerLock);
+
+  if (block == NULL)
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_addConnectionGapListener(TMR_Reader *reader, TMR_ConnectionGapListenerBlock *b)
+{
+
+  if (0 != pthread_mutex_lock(&reader->listenerLock))
+    return TMR_ERROR_TRYAGAIN;
+
+  b->next = reader->connectionGapListeners;
+  reader->connectionGapListeners = b;
+
+  pthread_mutex_unlock(&reader->listenerLock);
+
+  return TMR_SUCCESS;
+}
+
+
+TMR_Status
+TMR_removeConnectionGapListener(TMR_Reader *reader, TMR_ConnectionGapListenerBlock *b)
+{
+  TMR_ConnectionGapListenerBlock *block, **prev;
+
+  if (0 != pthread_mutex_lock(&reader->listenerLock))
+    return TMR_ERROR_TRYAGAIN;
+
+  prev = &reader->connectionGapListeners;
+  block = reader->connectionGapListeners;
+  while (NULL != block)
+  {
+    if (block == b)
+    {
+      *prev = block->next;
+      break;
+    }
+    prev = &block->next;
+    block = block->next;
+  }
+
+  pthread_mutex_unlock(&reader->listenerLock);
+
+  if (block == NULL)
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  return TMR_SUCCESS;
+}
+
 TMR_Status
 TMR_removeStatusListener(TMR_Reader *reader, TMR_StatusListenerBlock *b)
 {
@@ -1326,6 +1892,8 @@ void cleanup_background_threads(TMR_Reader *reader)
     pthread_mutex_lock(&reader->listenerLock);
     reader->readExceptionListeners = NULL;
     reader->statsListeners = NULL;
+    reader->pipelineStatsListeners = NULL;
+    reader->connectionGapListeners = NULL;
     if (true == reader->backgroundSetup)
     {
       /**
@@ -1355,6 +1923,8 @@ void cleanup_background_threads(TMR_Reader *reader)
     }
     pthread_mutex_unlock(&reader->listenerLock);
     pthread_mutex_unlock(&reader->parserLock);
+
+    TMR__dedupFree(reader);
   }
 }
 #endif /* TMR_ENABLE_BACKGROUND_READS */
@@ -0,0 +1,51 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_ATOMIC_H
+#define _TMR_ATOMIC_H
+/**
+ *  @file tmr_atomic.h
+ *  @brief Mercury API - Loads and stores shared between threads
+ *  @private
+ *
+ * Acquire loads and release stores of a word one thread publishes to
+ * another: a ring position, a stop flag, a pointer swapped in.  With
+ * GCC-style atomic builtins they are those; elsewhere they fall back
+ * to a volatile access of the type given, which keeps the compiler
+ * from caching the word or splitting the access but orders nothing
+ * else, so code needing more than that checks __ATOMIC_RELEASE
+ * itself.  The type is the word's own, written so that "T volatile *"
+ * points to it, e.g. uint32_t or struct TMR_PhaseCal *.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#if defined(__GNUC__) && defined(__ATOMIC_RELEASE)
+#define TMR__LOAD_ACQUIRE(type, p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define TMR__LOAD_RELAXED(type, p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define TMR__STORE_RELEASE(type, p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define TMR__LOAD_ACQUIRE(type, p) (*(type volatile *)(p))
+#define TMR__LOAD_RELAXED(type, p) (*(type volatile *)(p))
+#define TMR__STORE_RELEASE(type, p, v) (*(type volatile *)(p) = (v))
+#endif
+
+#endif /* _TMR_ATOMIC_H */
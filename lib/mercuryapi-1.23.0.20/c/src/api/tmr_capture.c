@@ -0,0 +1,236 @@
+/**
+ *  @file tmr_capture.c
+ *  @brief Mercury API - Transport traffic capture
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include <errno.h>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#include "tm_reader.h"
+#include "tmr_capture.h"
+#include "osdep.h"
+
+static void
+putLE32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 0);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void
+putLE64(uint8_t *p, uint64_t v)
+{
+  putLE32(p, (uint32_t)v);
+  putLE32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t
+getLE32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 0) | ((uint32_t)p[1] << 8)
+    | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t
+getLE64(const uint8_t *p)
+{
+  return getLE32(p) | ((uint64_t)getLE32(p + 4) << 32);
+}
+
+TMR_Status
+TMR_captureParseHeader(const uint8_t *data, uint32_t length,
+                       TMR_CaptureFileHeader *header)
+{
+  if (TMR_CAPTURE_HEADER_SIZE > length)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  memcpy(header->magic, data, sizeof(header->magic));
+  header->version = getLE32(data + 8);
+  header->headerSize = getLE32(data + 12);
+  header->startTimeUs = getLE64(data + 16);
+  header->readerType = getLE32(data + 24);
+  header->reserved = getLE32(data + 28);
+
+  if ((0 != memcmp(header->magic, TMR_CAPTURE_MAGIC, sizeof(header->magic)))
+      || (TMR_CAPTURE_VERSION != header->version)
+      || (TMR_CAPTURE_HEADER_SIZE > header->headerSize)
+      || (0 != (header->headerSize % TMR_CAPTURE_ALIGN)))
+  {
+    return TMR_ERROR_INVALID;
+  }
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_captureNextRecord(const uint8_t *data, uint64_t length,
+                      uint64_t *offset, TMR_CaptureRecord *record,
+                      const uint8_t **recordData)
+{
+  const uint8_t *p;
+  uint64_t size;
+
+  if (*offset >= length)
+  {
+    return TMR_ERROR_NO_TAGS;
+  }
+  if (TMR_CAPTURE_RECORD_HEADER_SIZE > length - *offset)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  p = data + *offset;
+  record->timeUs = getLE64(p);
+  record->length = getLE32(p + 8);
+  record->direction = p[12];
+  memset(record->reserved, 0, sizeof(record->reserved));
+
+  size = TMR_CAPTURE_RECORD_HEADER_SIZE + (uint64_t)record->length;
+  if (size > length - *offset)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  *recordData = p + TMR_CAPTURE_RECORD_HEADER_SIZE;
+  size = (size + TMR_CAPTURE_ALIGN - 1) & ~(uint64_t)(TMR_CAPTURE_ALIGN - 1);
+  *offset += size;
+  return TMR_SUCCESS;
+}
+
+#ifdef TMR_ENABLE_STDIO
+
+static uint64_t
+capture_nowUs(void)
+{
+#ifndef WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#else
+  return tmr_gettime() * 1000;
+#endif
+}
+
+static void
+capture_write(TMR_TransportCapture *capture, const void *data, size_t length)
+{
+  if ((TMR_SUCCESS == capture->status)
+      && (length != fwrite(data, 1, length, capture->file)))
+  {
+    capture->status = TMR_ERROR_COMM_ERRNO(errno);
+  }
+}
+
+static void
+capture_listener(bool tx, uint32_t dataLen, const uint8_t data[],
+                 uint32_t timeout, void *cookie)
+{
+  static const uint8_t padding[TMR_CAPTURE_ALIGN];
+  TMR_TransportCapture *capture;
+  uint8_t header[TMR_CAPTURE_RECORD_HEADER_SIZE];
+  uint32_t pad;
+
+  capture = cookie;
+  memset(header, 0, sizeof(header));
+  putLE32(header + 8, dataLen);
+  header[12] = tx ? TMR_CAPTURE_TX : TMR_CAPTURE_RX;
+  pad = (TMR_CAPTURE_ALIGN - (dataLen % TMR_CAPTURE_ALIGN)) % TMR_CAPTURE_ALIGN;
+
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  /* Sends and background receives come from different threads */
+  pthread_mutex_lock(&capture->lock);
+#endif
+  putLE64(header, capture_nowUs() - capture->startUs);
+  capture_write(capture, header, sizeof(header));
+  capture_write(capture, data, dataLen);
+  capture_write(capture, padding, pad);
+  capture->records++;
+  capture->bytes += dataLen;
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  pthread_mutex_unlock(&capture->lock);
+#endif
+}
+
+TMR_Status
+TMR_startTransportCapture(TMR_Reader *reader, TMR_TransportCapture *capture,
+                          const char *path)
+{
+  uint8_t header[TMR_CAPTURE_HEADER_SIZE];
+
+  memset(capture, 0, sizeof(*capture));
+  capture->file = fopen(path, "wb");
+  if (NULL == capture->file)
+  {
+    return TMR_ERROR_COMM_ERRNO(errno);
+  }
+  capture->startUs = capture_nowUs();
+  capture->status = TMR_SUCCESS;
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, TMR_CAPTURE_MAGIC, 8);
+  putLE32(header + 8, TMR_CAPTURE_VERSION);
+  putLE32(header + 12, TMR_CAPTURE_HEADER_SIZE);
+  putLE64(header + 16, tmr_gettime() * 1000);
+  putLE32(header + 24, reader->readerType);
+  capture_write(capture, header, sizeof(header));
+  if (TMR_SUCCESS != capture->status)
+  {
+    fclose(capture->file);
+    capture->file = NULL;
+    return capture->status;
+  }
+
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  pthread_mutex_init(&capture->lock, NULL);
+#endif
+  capture->listener.listener = capture_listener;
+  capture->listener.cookie = capture;
+  return TMR_addTransportListener(reader, &capture->listener);
+}
+
+TMR_Status
+TMR_stopTransportCapture(TMR_Reader *reader, TMR_TransportCapture *capture)
+{
+  if (NULL == capture->file)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  TMR_removeTransportListener(reader, &capture->listener);
+  if ((0 != fclose(capture->file)) && (TMR_SUCCESS == capture->status))
+  {
+    capture->status = TMR_ERROR_COMM_ERRNO(errno);
+  }
+  capture->file = NULL;
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  pthread_mutex_destroy(&capture->lock);
+#endif
+  return capture->status;
+}
+
+#endif /* TMR_ENABLE_STDIO */
@@ -0,0 +1,190 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_CAPTURE_H
+#define _TMR_CAPTURE_H
+/**
+ *  @file tmr_capture.h
+ *  @brief Mercury API - Transport traffic capture
+ *
+ * Records the bytes a serial reader sends and receives to a compact
+ * binary file, for replaying later through the "replay" serial
+ * transport (see serial_transport_replay.c).
+ *
+ * File layout, all integers little-endian:
+ *
+ *   TMR_CaptureFileHeader   32 bytes
+ *   records                 each a TMR_CaptureRecord header followed by
+ *                           its data, padded with zeros to a multiple
+ *                           of TMR_CAPTURE_ALIGN bytes
+ *
+ * Every record starts 8-byte aligned, so a mapped capture can be
+ * walked in place without copying.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef TMR_ENABLE_STDIO
+#include <stdio.h>
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/** First bytes of every capture file */
+#define TMR_CAPTURE_MAGIC "TMRCAP\r\n"
+/** Capture format version written by this library */
+#define TMR_CAPTURE_VERSION 1
+/** Alignment of every record in the file */
+#define TMR_CAPTURE_ALIGN 8
+/** Size of the file header */
+#define TMR_CAPTURE_HEADER_SIZE 32
+/** Size of the header of each record */
+#define TMR_CAPTURE_RECORD_HEADER_SIZE 16
+
+/** Direction of a captured record */
+typedef enum TMR_CaptureDirection
+{
+  /** Bytes received from the device */
+  TMR_CAPTURE_RX = 0,
+  /** Bytes sent to the device */
+  TMR_CAPTURE_TX = 1,
+} TMR_CaptureDirection;
+
+/**
+ * The capture file header.
+ **/
+typedef struct TMR_CaptureFileHeader
+{
+  /** TMR_CAPTURE_MAGIC, not NUL terminated */
+  char magic[8];
+  /** TMR_CAPTURE_VERSION */
+  uint32_t version;
+  /** Size of this header in bytes, the offset of the first record */
+  uint32_t headerSize;
+  /** Wall clock time the capture started, in microseconds since the epoch */
+  uint64_t startTimeUs;
+  /** The TMR_ReaderType of the captured reader */
+  uint32_t readerType;
+  /** Zero */
+  uint32_t reserved;
+} TMR_CaptureFileHeader;
+
+/**
+ * The header of one captured record: the bytes of one
+ * TMR_TransportListener call.
+ **/
+typedef struct TMR_CaptureRecord
+{
+  /** Microseconds since the start of the capture */
+  uint64_t timeUs;
+  /** Number of data bytes following the header */
+  uint32_t length;
+  /** A TMR_CaptureDirection */
+  uint8_t direction;
+  /** Zero */
+  uint8_t reserved[3];
+} TMR_CaptureRecord;
+
+/**
+ * Decode a capture file header.
+ *
+ * @param data The first TMR_CAPTURE_HEADER_SIZE bytes of the file
+ * @param length Number of bytes available at data
+ * @param[out] header The decoded header
+ * @return TMR_ERROR_INVALID if this is not a capture this library can read
+ **/
+TMR_Status TMR_captureParseHeader(const uint8_t *data, uint32_t length,
+                                  TMR_CaptureFileHeader *header);
+
+/**
+ * Decode the record starting at offset in a capture.
+ *
+ * @param data The capture contents
+ * @param length Size of the capture
+ * @param offset Offset of the record, updated to the offset of the next one
+ * @param[out] record The decoded record header
+ * @param[out] recordData The record bytes, pointing into data
+ * @return TMR_ERROR_NO_TAGS at the end of the capture,
+ *         TMR_ERROR_INVALID if the record is truncated
+ **/
+TMR_Status TMR_captureNextRecord(const uint8_t *data, uint64_t length,
+                                 uint64_t *offset, TMR_CaptureRecord *record,
+                                 const uint8_t **recordData);
+
+#ifdef TMR_ENABLE_STDIO
+/**
+ * A capture in progress, see TMR_startTransportCapture()
+ **/
+typedef struct TMR_TransportCapture
+{
+  /** @private */
+  TMR_TransportListenerBlock listener;
+  /** @private */
+  FILE *file;
+  /** @private */
+  uint64_t startUs;
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  /** @private */
+  pthread_mutex_t lock;
+#endif
+  /** Number of records written */
+  uint32_t records;
+  /** Number of data bytes written */
+  uint64_t bytes;
+  /** First write error, reported by TMR_stopTransportCapture() */
+  TMR_Status status;
+} TMR_TransportCapture;
+
+/**
+ * Start writing every message sent to or received from a serial
+ * reader to a capture file.  Register the capture before
+ * TMR_connect() so the replay sees the whole boot sequence.
+ *
+ * @param reader The reader to capture
+ * @param capture Capture state, owned by the caller until the capture is stopped
+ * @param path The file to create
+ * @return TMR_ERROR_COMM_ERRNO status if the file can't be created
+ **/
+TMR_Status TMR_startTransportCapture(TMR_Reader *reader,
+                                     TMR_TransportCapture *capture,
+                                     const char *path);
+
+/**
+ * Stop a capture and close its file.  Stop any background reading
+ * first, the receive thread may still be writing records.
+ *
+ * @param reader The captured reader
+ * @param capture The capture
+ * @return The first error that occurred writing the file
+ **/
+TMR_Status TMR_stopTransportCapture(TMR_Reader *reader,
+                                    TMR_TransportCapture *capture);
+#endif /* TMR_ENABLE_STDIO */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_CAPTURE_H */
@@ -0,0 +1,467 @@
+/**
+ *  @file tmr_events.c
+ *  @brief Mercury API - Tag presence and motion events
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_TAG_EVENTS
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_events.h"
+#include "tmr_atomic.h"
+#include "tmr_phase.h"
+#include "tmr_tag_table.h"
+#include "osdep.h"
+
+/* Antennas a tag's last phase is kept for */
+#define EVENT_PHASE_ANTENNAS 4
+#define EVENT_PHASE_FLAGS (TMR_TRD_METADATA_FLAG_PHASE | TMR_TRD_METADATA_FLAG_FREQUENCY)
+
+/** Where a tag is in its life; an empty slot has key 0 */
+typedef enum EventState
+{
+  /** Read, but fewer than enterReads times */
+  EVENT_STATE_PENDING = 0,
+  /** Entered, neither moving nor stationary yet */
+  EVENT_STATE_PRESENT,
+  EVENT_STATE_MOVING,
+  EVENT_STATE_STATIONARY
+} EventState;
+
+/** The phase a rate is taken from, on one antenna and frequency */
+typedef struct EventPhase
+{
+  uint64_t timeUs;
+  uint32_t frequency;
+  uint16_t phase;
+  uint8_t antenna;
+} EventPhase;
+
+/** One tag */
+typedef struct EventSlot
+{
+  TMR_TagTableEntry entry;
+  uint64_t firstUs;
+  /** Since when both rates have been below their off thresholds, 0 if not */
+  uint64_t steadyUs;
+  double rssi;
+  double rssiSlow;
+  double phaseRate;
+  uint32_t reads;
+  uint8_t state;
+  uint8_t antenna;
+  uint8_t protocol;
+  EventPhase phase[EVENT_PHASE_ANTENNAS];
+} EventSlot;
+
+static double
+event_abs(double x)
+{
+  return (0 > x) ? -x : x;
+}
+
+static double
+event_rssiSlope(const TMR_TagEventEngine *engine, const EventSlot *slot)
+{
+  /* A ramp puts the two averages its slope times the difference of their lags apart */
+  return (slot->rssi - slot->rssiSlow) * 1e6 / (3.0 * engine->config.averageUs);
+}
+
+static void
+event_emit(TMR_TagEventEngine *engine, const EventSlot *slot, const TMR_TagData *tag,
+           TMR_TagEventType type, uint64_t timeUs)
+{
+  TMR_TagEvent event;
+
+  event.type = type;
+  event.tag = tag;
+  event.timeUs = timeUs;
+  event.firstUs = slot->firstUs;
+  event.lastUs = slot->entry.lastUs;
+  event.reads = slot->reads;
+  event.antenna = slot->antenna;
+  event.rssi = slot->rssi;
+  event.rssiSlope = event_rssiSlope(engine, slot);
+  event.phaseRate = slot->phaseRate;
+  engine->events[type]++;
+  engine->listener(engine->reader, &event, engine->cookie);
+}
+
+/** Report a tag departed, if it had entered */
+static void
+event_leave(TMR_TagEventEngine *engine, EventSlot *slot, uint64_t timeUs)
+{
+  TMR_TagData tag;
+
+  if (EVENT_STATE_PENDING != slot->state)
+  {
+    memset(&tag, 0, sizeof(tag));
+    tag.protocol = (TMR_TagProtocol)slot->protocol;
+    tag.epcByteCount = slot->entry.epcByteCount;
+    memcpy(tag.epc, slot->entry.epc, slot->entry.epcByteCount);
+    event_emit(engine, slot, &tag, TMR_TAG_EVENT_DEPARTED, timeUs);
+  }
+}
+
+/**
+ * Take a tag out of the table, reporting it departed if it had
+ * entered.  Another tag may move into the slot.
+ **/
+static void
+event_depart(TMR_TagEventEngine *engine, EventSlot *slot, uint64_t timeUs)
+{
+  event_leave(engine, slot, timeUs);
+  TMR_tagTableRemove(&engine->table, &slot->entry);
+  engine->tags = engine->table.used;
+}
+
+/**
+ * Find a tag's slot, taking an empty one, or the one read longest ago
+ * if it isn't there.
+ **/
+static EventSlot *
+event_find(TMR_TagEventEngine *engine, const TMR_TagData *tag, uint64_t now)
+{
+  EventSlot *slot;
+  bool found;
+
+  slot = (EventSlot *)TMR_tagTableFind(&engine->table, tag, 0, true, &found);
+  if (found)
+  {
+    return slot;
+  }
+  if (0 != slot->entry.key)
+  {
+    if (now - slot->entry.lastUs < engine->config.departUs)
+    {
+      engine->evictions++;
+    }
+    /* The new tag takes the slot, so nothing moves */
+    event_leave(engine, slot, now);
+  }
+  TMR_tagTableClaim(&engine->table, &slot->entry, tag, 0);
+  slot->firstUs = now;
+  slot->state = EVENT_STATE_PENDING;
+  slot->protocol = (uint8_t)tag->protocol;
+  engine->tags = engine->table.used;
+  return slot;
+}
+
+/** Fold a read's phase into the tag's phase rate */
+static void
+event_phase(TMR_TagEventEngine *engine, EventSlot *slot, const TMR_TagReadData *read,
+            uint64_t now)
+{
+  EventPhase *last;
+  uint64_t dt;
+  double rate, alpha;
+
+  last = &slot->phase[(read->antenna - 1) % EVENT_PHASE_ANTENNAS];
+  if ((last->antenna == read->antenna) && (last->frequency == read->frequency))
+  {
+    dt = now - last->timeUs;
+    if (dt < engine->config.phaseBaseUs)
+    {
+      /* Too close to the reference to say much; keep the reference */
+      return;
+    }
+    if (dt <= engine->config.phaseGapUs)
+    {
+      rate = TMR_phaseWrap((double)read->phase - last->phase, engine->config.phaseTurn)
+             * 1e6 / (double)dt;
+      alpha = (double)dt / (double)(engine->config.averageUs + dt);
+      slot->phaseRate += alpha * (rate - slot->phaseRate);
+    }
+  }
+  last->timeUs = now;
+  last->frequency = read->frequency;
+  last->phase = read->phase;
+  last->antenna = read->antenna;
+}
+
+/** Whether a slot's tag has departed */
+static bool
+event_gone(const TMR_TagEventEngine *engine, const EventSlot *slot, uint64_t now)
+{
+  return (0 != slot->entry.key) && (now > slot->entry.lastUs)
+         && (now - slot->entry.lastUs >= engine->config.departUs);
+}
+
+/** Check the next few slots for tags that have departed */
+static void
+event_sweepSome(TMR_TagEventEngine *engine, uint64_t now, uint32_t count)
+{
+  EventSlot *slot;
+  uint32_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    slot = (EventSlot *)TMR_tagTableAt(&engine->table, engine->cursor);
+    if (event_gone(engine, slot, now))
+    {
+      /* Look at the slot again, another tag may have moved into it */
+      event_depart(engine, slot, slot->entry.lastUs + engine->config.departUs);
+    }
+    else
+    {
+      engine->cursor = (engine->cursor + 1) & (engine->config.slots - 1);
+    }
+  }
+}
+
+void
+TMR_tagEventsAddRead(TMR_TagEventEngine *engine, const TMR_TagReadData *read)
+{
+  TMR_TagEventConfig *config;
+  EventSlot *slot;
+  uint64_t now, dt;
+  double alpha, slope;
+  bool moving, still;
+
+  config = &engine->config;
+  now = ((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) * 1000;
+
+  pthread_mutex_lock(&engine->lock);
+  engine->reads++;
+  engine->nowUs = (now > engine->nowUs) ? now : engine->nowUs;
+  event_sweepSome(engine, now, config->sweepPerRead);
+
+  slot = event_find(engine, &read->tag, now);
+  if (0 == slot->reads)
+  {
+    slot->rssi = read->rssi;
+    slot->rssiSlow = read->rssi;
+  }
+  else
+  {
+    dt = (now > slot->entry.lastUs) ? now - slot->entry.lastUs : 0;
+    alpha = (double)dt / (double)(config->averageUs + dt);
+    slot->rssi += alpha * (read->rssi - slot->rssi);
+    alpha = (double)dt / (double)(4 * (uint64_t)config->averageUs + dt);
+    slot->rssiSlow += alpha * (read->rssi - slot->rssiSlow);
+  }
+  if ((EVENT_PHASE_FLAGS == (read->metadataFlags & EVENT_PHASE_FLAGS)) && (0 != read->antenna))
+  {
+    event_phase(engine, slot, read, now);
+  }
+  slot->reads++;
+  slot->entry.lastUs = (now > slot->entry.lastUs) ? now : slot->entry.lastUs;
+  slot->antenna = read->antenna;
+
+  if (EVENT_STATE_PENDING == slot->state)
+  {
+    if (slot->reads < config->enterReads)
+    {
+      pthread_mutex_unlock(&engine->lock);
+      return;
+    }
+    slot->state = EVENT_STATE_PRESENT;
+    slot->steadyUs = 0;
+    event_emit(engine, slot, &read->tag, TMR_TAG_EVENT_ENTERED, now);
+  }
+
+  /* Between the on and off thresholds a tag stays as it was */
+  slope = event_abs(event_rssiSlope(engine, slot));
+  moving = (event_abs(slot->phaseRate) >= config->phaseRateOn) || (slope >= config->rssiSlopeOn);
+  still = (event_abs(slot->phaseRate) < config->phaseRateOff) && (slope < config->rssiSlopeOff);
+  if (moving)
+  {
+    slot->steadyUs = 0;
+    if (EVENT_STATE_MOVING != slot->state)
+    {
+      slot->state = EVENT_STATE_MOVING;
+      event_emit(engine, slot, &read->tag, TMR_TAG_EVENT_MOVING, now);
+    }
+  }
+  else if (still)
+  {
+    if (0 == slot->steadyUs)
+    {
+      slot->steadyUs = now;
+    }
+    if ((EVENT_STATE_STATIONARY != slot->state) && (now - slot->steadyUs >= config->stillUs))
+    {
+      slot->state = EVENT_STATE_STATIONARY;
+      event_emit(engine, slot, &read->tag, TMR_TAG_EVENT_STATIONARY, now);
+    }
+  }
+  else
+  {
+    slot->steadyUs = 0;
+  }
+  pthread_mutex_unlock(&engine->lock);
+}
+
+uint32_t
+TMR_tagEventsSweep(TMR_TagEventEngine *engine, uint64_t nowUs)
+{
+  EventSlot *slot;
+  uint64_t before, now;
+  uint32_t i;
+
+  pthread_mutex_lock(&engine->lock);
+  before = engine->events[TMR_TAG_EVENT_DEPARTED];
+  now = (0 == nowUs) ? engine->nowUs : nowUs;
+  for (i = 0; i < engine->config.slots; i++)
+  {
+    slot = (EventSlot *)TMR_tagTableAt(&engine->table, i);
+    while (event_gone(engine, slot, now))
+    {
+      event_depart(engine, slot, slot->entry.lastUs + engine->config.departUs);
+    }
+  }
+  pthread_mutex_unlock(&engine->lock);
+  return (uint32_t)(engine->events[TMR_TAG_EVENT_DEPARTED] - before);
+}
+
+static void
+event_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_tagEventsAddRead(cookie, t);
+}
+
+/** Sweeps on the clock the reader timestamps reads by */
+static void *
+event_sweepThread(void *arg)
+{
+  TMR_TagEventEngine *engine;
+
+  engine = arg;
+  while (TMR__LOAD_ACQUIRE(bool, &engine->sweeping))
+  {
+    tmr_sleep(engine->config.sweepMs);
+    TMR_tagEventsSweep(engine, tmr_gettime() * 1000);
+  }
+  return NULL;
+}
+
+void
+TMR_tagEventsInitConfig(TMR_TagEventConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->slots = 65536;
+  config->enterReads = 2;
+  config->departUs = 2000000;
+  config->stillUs = 1000000;
+  config->averageUs = 250000;
+  config->phaseRateOn = 450;
+  config->phaseRateOff = 120;
+  config->rssiSlopeOn = 8;
+  config->rssiSlopeOff = 2;
+  config->phaseTurn = 180;
+  config->phaseBaseUs = 20000;
+  config->phaseGapUs = 50000;
+  config->sweepPerRead = 4;
+  config->sweepMs = 100;
+}
+
+TMR_Status
+TMR_tagEventsStart(TMR_Reader *reader, TMR_TagEventEngine *engine,
+                   const TMR_TagEventConfig *config,
+                   TMR_TagEventListener listener, void *cookie)
+{
+  TMR_Status ret;
+
+  if ((NULL == listener) || (0 == config->enterReads)
+      || (0 == config->departUs) || (0 == config->averageUs) || (0 == config->phaseTurn)
+      || (config->phaseRateOff > config->phaseRateOn)
+      || (config->rssiSlopeOff > config->rssiSlopeOn)
+      || (config->phaseBaseUs > config->phaseGapUs))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->config = *config;
+  engine->listener = listener;
+  engine->cookie = cookie;
+  ret = TMR_tagTableInit(&engine->table, config->slots, sizeof(EventSlot));
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  pthread_mutex_init(&engine->lock, NULL);
+
+  if (NULL != reader)
+  {
+    engine->reader = reader;
+    engine->readListener.listener = event_readListener;
+    engine->readListener.cookie = engine;
+    ret = TMR_addReadListener(reader, &engine->readListener);
+    if ((TMR_SUCCESS == ret) && (0 != config->sweepMs))
+    {
+      TMR__STORE_RELEASE(bool, &engine->sweeping, true);
+      if (0 != pthread_create(&engine->sweepThread, NULL, event_sweepThread, engine))
+      {
+        engine->sweeping = false;
+        TMR_removeReadListener(reader, &engine->readListener);
+        ret = TMR_ERROR_NO_THREADS;
+      }
+    }
+    if (TMR_SUCCESS != ret)
+    {
+      pthread_mutex_destroy(&engine->lock);
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_tagEventsStop(TMR_TagEventEngine *engine)
+{
+  EventSlot *slot;
+  uint32_t i;
+
+  if (NULL != engine->reader)
+  {
+    TMR_removeReadListener(engine->reader, &engine->readListener);
+  }
+  if (TMR__LOAD_ACQUIRE(bool, &engine->sweeping))
+  {
+    TMR__STORE_RELEASE(bool, &engine->sweeping, false);
+    pthread_join(engine->sweepThread, NULL);
+  }
+
+  /* What is still here departs as of the last read */
+  for (i = 0; i < engine->config.slots; i++)
+  {
+    slot = (EventSlot *)TMR_tagTableAt(&engine->table, i);
+    while (0 != slot->entry.key)
+    {
+      event_depart(engine, slot, engine->nowUs);
+    }
+  }
+  engine->reader = NULL;
+  pthread_mutex_destroy(&engine->lock);
+  TMR_tagTableDestroy(&engine->table);
+}
+
+#endif /* TMR_ENABLE_TAG_EVENTS */
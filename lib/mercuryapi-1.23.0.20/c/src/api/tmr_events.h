@@ -0,0 +1,250 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_EVENTS_H
+#define _TMR_EVENTS_H
+/**
+ *  @file tmr_events.h
+ *  @brief Mercury API - Tag presence and motion events
+ *
+ * Turns the read stream into changes of state per tag, so what
+ * follows sees a handful of events instead of every read:
+ *
+ *  - TMR_TAG_EVENT_ENTERED once a tag has been read enterReads times;
+ *  - TMR_TAG_EVENT_MOVING when its phase or RSSI starts changing;
+ *  - TMR_TAG_EVENT_STATIONARY when they have stayed steady for
+ *    stillUs;
+ *  - TMR_TAG_EVENT_DEPARTED when it has not been read for departUs.
+ *
+ * For each tag the engine keeps the RSSI averaged over averageUs and
+ * over four times that, whose difference gives its slope, and the
+ * rate the phase turns at, from reads on the same antenna and carrier
+ * frequency (the phase of a tag standing still does not change; one
+ * moving a quarter wavelength turns it by half a turn).
+ * A tag counts as moving once either rate passes its on threshold and
+ * as still once both are below their off thresholds, which are lower,
+ * so a tag near a threshold doesn't flap between the two.
+ *
+ * Tags are kept in an open addressing table sized when the engine
+ * starts, looked up by a hash of the EPC.  Every read also checks a
+ * few slots for tags that have departed and frees them, and a tag that
+ * finds no free slot near its hash replaces the one read longest ago,
+ * so memory stays bounded however many tags pass by.  Reads and sweeps
+ * may come from different threads.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_tag_table.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_TAG_EVENTS
+
+/**
+ * Kinds of tag event.
+ **/
+typedef enum TMR_TagEventType
+{
+  /** The tag is in the field */
+  TMR_TAG_EVENT_ENTERED = 0,
+  /** It has started moving */
+  TMR_TAG_EVENT_MOVING = 1,
+  /** It has stopped */
+  TMR_TAG_EVENT_STATIONARY = 2,
+  /** It has left the field, or was dropped for a newer tag */
+  TMR_TAG_EVENT_DEPARTED = 3,
+  TMR_TAG_EVENT_TYPES = 4
+} TMR_TagEventType;
+
+/**
+ * Engine configuration, see TMR_tagEventsInitConfig().
+ **/
+typedef struct TMR_TagEventConfig
+{
+  /** Tags tracked at once, a power of two (default 65536) */
+  uint32_t slots;
+  /** Reads before a tag has entered (default 2) */
+  uint32_t enterReads;
+  /** Time unread after which a tag has departed (default 2 s) */
+  uint32_t departUs;
+  /** Time below both off thresholds before a tag is stationary (default 1 s) */
+  uint32_t stillUs;
+  /** Time constant of the RSSI and rate averages (default 250 ms) */
+  uint32_t averageUs;
+  /** Phase rate a tag is moving above, degrees per second (default 450) */
+  double phaseRateOn;
+  /** Phase rate it may be still below (default 120) */
+  double phaseRateOff;
+  /** RSSI slope a tag is moving above, dB per second (default 8) */
+  double rssiSlopeOn;
+  /** RSSI slope it may be still below (default 2) */
+  double rssiSlopeOff;
+  /** Degrees in a turn of phase as reported (default 180) */
+  uint16_t phaseTurn;
+  /**
+   * Shortest time between two reads a phase rate is taken over, so
+   * phase noise isn't blown up into a rate (default 20 ms)
+   */
+  uint32_t phaseBaseUs;
+  /**
+   * Longest, beyond which the phase may have gone round more than half
+   * a turn (default 50 ms)
+   */
+  uint32_t phaseGapUs;
+  /** Slots each read checks for departed tags (default 4) */
+  uint32_t sweepPerRead;
+  /** With a reader, how often the whole table is swept (default 100 ms, 0 for never) */
+  uint32_t sweepMs;
+} TMR_TagEventConfig;
+
+/**
+ * A change of state of a tag.
+ **/
+typedef struct TMR_TagEvent
+{
+  /** What happened */
+  TMR_TagEventType type;
+  /** The tag */
+  const TMR_TagData *tag;
+  /** When, microseconds on the read timestamp clock */
+  uint64_t timeUs;
+  /** First read of the tag */
+  uint64_t firstUs;
+  /** Last read of the tag */
+  uint64_t lastUs;
+  /** Reads of the tag */
+  uint32_t reads;
+  /** Antenna of the last read */
+  uint8_t antenna;
+  /** Average RSSI, dBm */
+  double rssi;
+  /** Its slope, dB per second */
+  double rssiSlope;
+  /** Average rate of phase, degrees per second */
+  double phaseRate;
+} TMR_TagEvent;
+
+/**
+ * Called with each event.
+ *
+ * @param reader The reader given to TMR_tagEventsStart(), or NULL
+ * @param event The event; the tag is only valid during the call
+ * @param cookie The cookie given to TMR_tagEventsStart()
+ **/
+typedef void (*TMR_TagEventListener)(TMR_Reader *reader, const TMR_TagEvent *event,
+                                     void *cookie);
+
+/**
+ * An event engine, see TMR_tagEventsStart().
+ **/
+typedef struct TMR_TagEventEngine
+{
+  /** @private */
+  TMR_TagEventConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_TagEventListener listener;
+  /** @private */
+  void *cookie;
+  /** @private Tag table */
+  TMR_TagTable table;
+  /** @private Next slot the per read sweep checks */
+  uint32_t cursor;
+  /** @private Latest read time seen */
+  uint64_t nowUs;
+  /** @private Serializes reads and sweeps */
+  pthread_mutex_t lock;
+  /** @private */
+  pthread_t sweepThread;
+  /** @private */
+  bool sweeping;
+  /** Reads taken in */
+  uint64_t reads;
+  /** Events, by type */
+  uint64_t events[TMR_TAG_EVENT_TYPES];
+  /** Tags dropped for newer ones before they departed */
+  uint64_t evictions;
+  /** Tags in the table */
+  uint32_t tags;
+} TMR_TagEventEngine;
+
+/**
+ * Fill in the default configuration.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_tagEventsInitConfig(TMR_TagEventConfig *config);
+
+/**
+ * Start an engine, as a read listener of reader with a thread that
+ * sweeps for departed tags every sweepMs, or to be fed with
+ * TMR_tagEventsAddRead() and swept with TMR_tagEventsSweep().
+ *
+ * @param reader Reader to listen to, or NULL
+ * @param engine Engine state, owned by the caller until it is stopped
+ * @param config The configuration
+ * @param listener Called with each event
+ * @param cookie Passed to listener
+ **/
+TMR_Status TMR_tagEventsStart(TMR_Reader *reader, TMR_TagEventEngine *engine,
+                              const TMR_TagEventConfig *config,
+                              TMR_TagEventListener listener, void *cookie);
+
+/**
+ * Take in a read.
+ *
+ * @param engine The engine
+ * @param read The read
+ **/
+void TMR_tagEventsAddRead(TMR_TagEventEngine *engine, const TMR_TagReadData *read);
+
+/**
+ * Report every tag unread for departUs by a time as departed.
+ *
+ * @param engine The engine
+ * @param nowUs The time, on the read timestamp clock; 0 for the
+ *              latest read seen
+ * @return Tags departed
+ **/
+uint32_t TMR_tagEventsSweep(TMR_TagEventEngine *engine, uint64_t nowUs);
+
+/**
+ * Stop the engine: remove the listener, stop the sweep thread, report
+ * every tag still in the table as departed and free the table.
+ *
+ * @param engine The engine
+ **/
+void TMR_tagEventsStop(TMR_TagEventEngine *engine);
+
+#endif /* TMR_ENABLE_TAG_EVENTS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_EVENTS_H */
@@ -0,0 +1,250 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_FAULT_H
+#define _TMR_FAULT_H
+/**
+ *  @file tmr_fault.h
+ *  @brief Mercury API - Fault injection serial transport
+ *
+ * A serial transport that wraps another one and injects the faults a
+ * glitching USB serial adapter produces: dropped bytes, a corrupted
+ * byte, a stall, a frame cut short and a disconnect.  The faults come
+ * from a seeded schedule, so the same seed gives the same kinds,
+ * intervals and byte positions on every run; each fault fires at the
+ * first receive after it is due.
+ *
+ * Started on a reader with TMR_startFaultInjection() it also measures,
+ * for each fault, how long the reader took to deliver a tag read
+ * again and how many reads were lost meanwhile, which makes the
+ * recovery paths of background reading measurable.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_FAULT
+#include <pthread.h>
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_FAULT
+
+/** Kinds of injected fault */
+typedef enum TMR_FaultKind
+{
+  /** Some bytes of a receive are lost on the line */
+  TMR_FAULT_DROP = 0,
+  /** One bit of a received byte is flipped */
+  TMR_FAULT_CORRUPT = 1,
+  /** Nothing is received for stallMs, then the held bytes arrive */
+  TMR_FAULT_STALL = 2,
+  /** A receive gets part of its bytes, then times out; the rest is lost */
+  TMR_FAULT_PARTIAL = 3,
+  /** Sends fail and receives time out for disconnectMs, and what was pending is lost */
+  TMR_FAULT_DISCONNECT = 4,
+  TMR_FAULT_KINDS = 5
+} TMR_FaultKind;
+
+/** Mask bit of a TMR_FaultKind, for TMR_FaultConfig.kinds */
+#define TMR_FAULT_BIT(kind) (1U << (kind))
+/** All kinds of fault */
+#define TMR_FAULT_ALL ((1U << TMR_FAULT_KINDS) - 1)
+
+/**
+ * Fault schedule, see TMR_faultInitConfig().
+ **/
+typedef struct TMR_FaultConfig
+{
+  /** Seed of the schedule */
+  uint32_t seed;
+  /** Kinds of fault to inject, TMR_FAULT_BIT()s (default TMR_FAULT_ALL) */
+  uint32_t kinds;
+  /** No faults for this long after the transport is opened (default 1000 ms) */
+  uint32_t startAfterMs;
+  /** Mean time between faults, each interval is drawn from half to one and a half of it (default 2000 ms) */
+  uint32_t intervalMs;
+  /** Length of a stall (default 1500 ms) */
+  uint32_t stallMs;
+  /** Length of a disconnect (default 1000 ms) */
+  uint32_t disconnectMs;
+  /** Most bytes a drop loses (default 4) */
+  uint32_t dropBytes;
+  /** Stop after this many faults, at most and by default TMR_FAULT_MAX_RECORDS */
+  uint32_t maxFaults;
+} TMR_FaultConfig;
+
+/**
+ * One injected fault.
+ **/
+typedef struct TMR_FaultRecord
+{
+  /** What was injected */
+  TMR_FaultKind kind;
+  /** Monotonic time it was injected, in microseconds */
+  uint64_t injectedUs;
+  /** When the fault was over: the end of a stall or disconnect, else injectedUs */
+  uint64_t clearedUs;
+  /** When the next tag read was delivered, 0 if none has been yet */
+  uint64_t recoveredUs;
+  /** Read exceptions reported between injection and recovery */
+  uint32_t exceptions;
+  /** The last of them */
+  TMR_Status lastException;
+  /**
+   * Tag reads lost: the read rate before the fault times the time from
+   * injection to recovery.  An estimate, the simulated and real
+   * readers don't read at a steady rate.
+   **/
+  uint32_t readsLost;
+} TMR_FaultRecord;
+
+/** Recovery figures of one kind of fault */
+typedef struct TMR_FaultSummary
+{
+  /** Faults injected */
+  uint32_t injected;
+  /** Faults the reader recovered from */
+  uint32_t recovered;
+  /** Sum, over recovered faults, of clearedUs to recoveredUs */
+  uint64_t totalRecoveryUs;
+  /** Longest clearedUs to recoveredUs */
+  uint64_t maxRecoveryUs;
+  /** Sum of readsLost */
+  uint64_t readsLost;
+} TMR_FaultSummary;
+
+/**
+ * A fault injecting transport, see TMR_SR_SerialTransportFaultInit()
+ * and TMR_startFaultInjection().
+ **/
+typedef struct TMR_FaultInjector
+{
+  /** @private The wrapped transport */
+  TMR_SR_SerialTransport inner;
+  /** @private */
+  TMR_FaultConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  pthread_mutex_t lock;
+  /** @private */
+  uint32_t rng;
+  /** @private */
+  uint64_t nextFaultUs;
+  /** @private */
+  uint64_t stalledUntilUs;
+  /** @private */
+  uint64_t disconnectedUntilUs;
+  /** @private Index of the record of the fault not yet recovered from, or -1 */
+  int32_t pending;
+  /** @private Tag reads since windowStartUs, for the read rate */
+  uint64_t windowReads;
+  /** @private */
+  uint64_t windowStartUs;
+  /** @private Reads per microsecond before the last fault */
+  double readRate;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_ReadExceptionListenerBlock exceptionListener;
+  /** @private Flush the wrapped transport at the end of a disconnect */
+  bool reconnectFlush;
+  /** Faults injected so far, each with its record */
+  uint32_t faults;
+  /** The injected faults */
+  TMR_FaultRecord records[TMR_FAULT_MAX_RECORDS];
+} TMR_FaultInjector;
+
+/**
+ * Fill in the default fault schedule: all kinds, one every 2 s on
+ * average from 1 s after open, seed 1.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_faultInitConfig(TMR_FaultConfig *config);
+
+/**
+ * Wrap a serial transport with fault injection.  The transport's
+ * callbacks move into the injector and are replaced by ones that
+ * call them and inject faults; the transport may already be open.
+ * No recovery is measured, see TMR_startFaultInjection().
+ *
+ * @param transport The transport to wrap
+ * @param injector Injector state, owned by the caller while the transport is in use
+ * @param config The fault schedule
+ **/
+TMR_Status TMR_SR_SerialTransportFaultInit(TMR_SR_SerialTransport *transport,
+                                           TMR_FaultInjector *injector,
+                                           const TMR_FaultConfig *config);
+
+/**
+ * Inject faults into a serial reader's transport and measure its
+ * recovery from them, through a read listener and a read exception
+ * listener.  Call it after TMR_create(), before or after TMR_connect(),
+ * and with background reading stopped.
+ *
+ * @param reader The reader
+ * @param injector Injector state, owned by the caller until injection is stopped
+ * @param config The fault schedule
+ * @return TMR_ERROR_UNSUPPORTED if the reader is not a serial reader
+ **/
+TMR_Status TMR_startFaultInjection(TMR_Reader *reader, TMR_FaultInjector *injector,
+                                   const TMR_FaultConfig *config);
+
+/**
+ * Put the reader's own transport back.  Stop background reading
+ * first.  The records stay in the injector.
+ *
+ * @param reader The reader
+ * @param injector The injector
+ * @return TMR_ERROR_INVALID if the injector is not the reader's
+ **/
+TMR_Status TMR_stopFaultInjection(TMR_Reader *reader, TMR_FaultInjector *injector);
+
+/**
+ * Sum up the recorded faults of one kind.
+ *
+ * @param injector The injector
+ * @param kind The kind of fault
+ * @param[out] summary The figures
+ **/
+void TMR_faultSummary(TMR_FaultInjector *injector, TMR_FaultKind kind,
+                      TMR_FaultSummary *summary);
+
+/**
+ * Name of a TMR_FaultKind, such as "stall".
+ *
+ * @param kind The kind of fault
+ **/
+const char *TMR_faultKindName(TMR_FaultKind kind);
+
+#endif /* TMR_ENABLE_SERIAL_TRANSPORT_FAULT */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_FAULT_H */
@@ -47,6 +47,59 @@ extern "C" {
 #define TMR_LLRP_MAX_RFMODE_ENTRIES 7
 #define TMR_LLRP_READER_DEFAULT_PORT 5084
 
+/**
+ * LLRP connection health, returned by /reader/llrp/connectionStats
+ **/
+typedef struct TMR_LLRP_ConnectionStats
+{
+  /* Number of times the connection was re-established during continuous reading */
+  uint32_t reconnects;
+
+  /**
+   * Duration of the most recent outage in milli seconds, from the last
+   * read delivered before it until reading resumed
+   */
+  uint32_t lastGapMs;
+
+  /* tmr_gettime() of the last read delivered before the most recent outage */
+  uint64_t lastGapStartMs;
+
+  /* Sum of all outages in milli seconds */
+  uint64_t totalGapMs;
+}TMR_LLRP_ConnectionStats;
+
+/**
+ * LLRP message memory pool statistics, returned by /reader/llrp/memPoolStats
+ **/
+typedef struct TMR_LLRP_MemPoolStats
+{
+  /* Allocations served, from the pool or the C library */
+  uint32_t allocs;
+
+  /* Blocks released */
+  uint32_t frees;
+
+  /* Allocations served from the pool free lists */
+  uint32_t poolHits;
+
+  /* Allocations too large to be pooled */
+  uint32_t largeAllocs;
+
+  /* Blocks currently held by messages */
+  uint32_t blocksInUse;
+
+  /* Bytes currently held by messages */
+  uint32_t bytesInUse;
+
+  /* High water mark of bytesInUse */
+  uint32_t peakBytesInUse;
+
+  /* Bytes kept in the free lists for reuse */
+  uint32_t bytesCached;
+}TMR_LLRP_MemPoolStats;
+
+struct TMR_LLRP_MemPool;
+
 /**
  * This structure is returned from cmdGetRFControl
  **/
@@ -219,7 +272,44 @@ typedef struct TMR_LLRP_LlrpReader
    * Used only in case of async reading
    **/
   uint64_t ka_start, ka_now;
+  /**
+   * tmr_gettime() of the last tag read handed to the read listeners
+   * during continuous reading, protected by listenerLock
+   **/
+  uint64_t lastReadTime;
   bool get_report, reportReceived;
+  /* Keep alive period in milli seconds, requested from the reader */
+  uint32_t keepAlivePeriod;
+  /* Missed keep alive periods before the connection is declared lost */
+  uint32_t keepAliveMissCount;
+
+  /**
+   * Reconnect and resume continuous reading when
+   * the connection is lost.
+   **/
+  bool autoReconnect;
+  uint32_t reconnectTimeout;
+  TMR_LLRP_ConnectionStats connectionStats;
+
+  /**
+   * Report trigger of the ROSpec being prepared, and the
+   * shortest report period over the whole read plan.
+   **/
+  TMR_ReportTrigger reportTrigger;
+  uint32_t reportPeriodMs;
+  uint64_t lastReportTime;
+
+  /**
+   * OpSpecs of an AccessSpec built from a TMR_TAGOP_LIST of
+   * ReadData ops: the first OpSpecID, the number of OpSpecs
+   * and the bank each one reads.
+   **/
+  llrp_u16_t bulkOpSpecId;
+  uint8_t bulkOpSpecCount;
+  TMR_GEN2_Bank bulkOpSpecBank[TMR_MAX_TAGMEM_RANGES];
+
+  /* Memory pool for LTKC messages */
+  struct TMR_LLRP_MemPool *memPool;
   /**
    * For monitoring protcol type
    * in case of multiprotocol read
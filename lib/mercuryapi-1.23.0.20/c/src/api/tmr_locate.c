@@ -0,0 +1,617 @@
+/**
+ *  @file tmr_locate.c
+ *  @brief Mercury API - Tag position estimator
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_LOCATE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_locate.h"
+#include "tmr_phase.h"
+#include "tmr_tag_table.h"
+
+#define LOCATE_PI     3.14159265358979323846
+#define LOCATE_LN10   2.30258509299404568402
+#define LOCATE_C      299792458.0
+
+/**
+ * One tag: its filter state, position then velocity, and their
+ * covariance, row by row.
+ **/
+typedef struct LocateSlot
+{
+  /** The tag; its lastUs is the time the state is for */
+  TMR_TagTableEntry entry;
+  /** Time of the last estimate */
+  uint64_t emitUs;
+  double x[6];
+  double P[36];
+  uint32_t updates;
+  bool live;
+  bool emitted;
+} LocateSlot;
+
+/**
+ * Square root by Newton's method from half the exponent, which keeps
+ * the library off libm
+ **/
+static double
+locate_sqrt(double x)
+{
+  uint64_t bits;
+  double r;
+  int i;
+
+  if (0 >= x)
+  {
+    return 0;
+  }
+  memcpy(&bits, &x, sizeof(bits));
+  bits = ((bits >> 1) + (0x3FFULL << 51)) & 0x7FF0000000000000ULL;
+  memcpy(&r, &bits, sizeof(r));
+  r = (0 == r) ? x : r;
+  for (i = 0; i < 6; i++)
+  {
+    r = (r + x / r) / 2;
+  }
+  return r;
+}
+
+/**
+ * Natural log: the exponent bits give the power of two, and the
+ * series of 2 atanh((m - 1) / (m + 1)) the rest
+ **/
+static double
+locate_log(double x)
+{
+  uint64_t bits;
+  double m, t, t2, r;
+  int exponent, k;
+
+  memcpy(&bits, &x, sizeof(bits));
+  exponent = (int)((bits >> 52) & 0x7FF) - 1023;
+  bits = (bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+  memcpy(&m, &bits, sizeof(m));
+  t = (m - 1) / (m + 1);
+  t2 = t * t;
+  r = 0;
+  for (k = 23; k >= 1; k -= 2)
+  {
+    r = r * t2 + 1.0 / k;
+  }
+  return exponent * 0.69314718055994530942 + 2 * t * r;
+}
+
+/** Distance from an antenna and the unit vector from it to the tag */
+static double
+locate_distance(const LocateSlot *slot, const TMR_LocateAntenna *antenna, double u[3])
+{
+  double d;
+  int i;
+
+  for (i = 0; i < 3; i++)
+  {
+    u[i] = slot->x[i] - antenna->position[i];
+  }
+  d = locate_sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+  for (i = 0; (i < 3) && (0 < d); i++)
+  {
+    u[i] /= d;
+  }
+  return d;
+}
+
+static LocateSlot *
+locate_find(TMR_LocateEngine *engine, const TMR_TagData *tag)
+{
+  LocateSlot *slot;
+  bool found;
+
+  slot = (LocateSlot *)TMR_tagTableFind(&engine->table, tag, 0, true, &found);
+  if (!found)
+  {
+    if (0 != slot->entry.key)
+    {
+      engine->evictions++;
+    }
+    TMR_tagTableClaim(&engine->table, &slot->entry, tag, 0);
+  }
+  return slot;
+}
+
+/** Start a tag seedDistance in front of the antenna that first read it */
+static void
+locate_seed(TMR_LocateEngine *engine, LocateSlot *slot,
+            const TMR_LocateAntenna *antenna, uint64_t now)
+{
+  const double *b;
+  double norm, seed;
+  int i;
+
+  b = antenna->boresight;
+  norm = locate_sqrt(b[0] * b[0] + b[1] * b[1] + b[2] * b[2]);
+  seed = engine->config.seedDistance;
+  memset(slot->x, 0, sizeof(slot->x));
+  memset(slot->P, 0, sizeof(slot->P));
+  for (i = 0; i < 3; i++)
+  {
+    slot->x[i] = antenna->position[i] + seed * b[i] / norm;
+    slot->P[i * 6 + i] = seed * seed;
+    slot->P[(i + 3) * 6 + i + 3] = 1;
+  }
+  slot->entry.lastUs = now;
+  slot->live = true;
+}
+
+/**
+ * Carry the state forward at constant velocity: x = F x and
+ * P = F P F' + Q, with F adding dt times velocity to position.
+ **/
+static void
+locate_predict(TMR_LocateEngine *engine, LocateSlot *slot, uint64_t now)
+{
+  double *P;
+  double dt, q;
+  int i, j;
+
+  if (now <= slot->entry.lastUs)
+  {
+    return;
+  }
+  dt = (now - slot->entry.lastUs) / 1e6;
+  slot->entry.lastUs = now;
+  P = slot->P;
+
+  for (i = 0; i < 3; i++)
+  {
+    slot->x[i] += dt * slot->x[i + 3];
+  }
+  /* Rows, then columns, of the position block take in the velocity */
+  for (i = 0; i < 3; i++)
+  {
+    for (j = 0; j < 6; j++)
+    {
+      P[i * 6 + j] += dt * P[(i + 3) * 6 + j];
+    }
+  }
+  for (i = 0; i < 6; i++)
+  {
+    for (j = 0; j < 3; j++)
+    {
+      P[i * 6 + j] += dt * P[i * 6 + j + 3];
+    }
+  }
+  q = engine->config.processNoise;
+  for (i = 0; i < 3; i++)
+  {
+    P[i * 6 + i] += q * dt * dt * dt / 3;
+    P[i * 6 + i + 3] += q * dt * dt / 2;
+    P[(i + 3) * 6 + i] += q * dt * dt / 2;
+    P[(i + 3) * 6 + i + 3] += q * dt;
+  }
+}
+
+/**
+ * Fuse one measurement whose gradient with respect to position is h
+ * and that is innovation away from what the state predicts.
+ **/
+static void
+locate_update(LocateSlot *slot, const double h[3], double innovation, double variance)
+{
+  double PH[6];
+  double S;
+  int i, j;
+
+  for (i = 0; i < 6; i++)
+  {
+    PH[i] = slot->P[i * 6 + 0] * h[0] + slot->P[i * 6 + 1] * h[1] + slot->P[i * 6 + 2] * h[2];
+  }
+  S = h[0] * PH[0] + h[1] * PH[1] + h[2] * PH[2] + variance;
+  if (0 >= S)
+  {
+    return;
+  }
+  for (i = 0; i < 6; i++)
+  {
+    slot->x[i] += PH[i] * innovation / S;
+    for (j = 0; j < 6; j++)
+    {
+      slot->P[i * 6 + j] -= PH[i] * PH[j] / S;
+    }
+  }
+  slot->updates++;
+}
+
+/**
+ * RSSI against the log-distance model, in dB, where its error is
+ * normal: rssiAt1m - 10 n log10(d).
+ **/
+static void
+locate_rssiUpdate(TMR_LocateEngine *engine, LocateSlot *slot,
+                  const TMR_LocateAntenna *antenna, int32_t rssi)
+{
+  TMR_LocateConfig *config;
+  double u[3];
+  double d, slope, predicted;
+  int i;
+
+  config = &engine->config;
+  d = locate_distance(slot, antenna, u);
+  if (1e-3 > d)
+  {
+    return;
+  }
+  slope = 10 * config->pathLossExponent / LOCATE_LN10;
+  predicted = config->rssiAt1m - slope * locate_log(d);
+  for (i = 0; i < 3; i++)
+  {
+    u[i] *= -slope / d;
+  }
+  locate_update(slot, u, rssi - predicted, config->rssiSigma * config->rssiSigma);
+  engine->rssiUpdates++;
+}
+
+#ifdef TMR_ENABLE_RANGING
+/**
+ * A distance from multi-frequency ranging.  Each estimate refits
+ * mostly the same channels as the last, so its variance is scaled
+ * up by their number rather than each being taken as new.
+ **/
+static void
+locate_rangeListener(TMR_Reader *reader, const TMR_RangeResult *result, void *cookie)
+{
+  TMR_LocateEngine *engine;
+  LocateSlot *slot;
+  const TMR_LocateAntenna *antenna;
+  double u[3];
+  double d, sigma;
+
+  engine = cookie;
+  slot = engine->current;
+  antenna = engine->port[result->antenna];
+  if ((NULL == slot) || (NULL == antenna)
+      || (result->confidence < engine->config.minRangeConfidence))
+  {
+    return;
+  }
+  d = locate_distance(slot, antenna, u);
+  if (1e-3 > d)
+  {
+    return;
+  }
+  sigma = (0.01 > result->sigma) ? 0.01 : result->sigma;
+  locate_update(slot, u, result->distance - d, sigma * sigma * result->channels);
+  engine->rangeUpdates++;
+}
+#endif
+
+/**
+ * A phase difference: k (dA - dB), k = 4 pi f / c, modulo a turn.
+ **/
+static void
+locate_pdoaListener(TMR_Reader *reader, const TMR_PdoaResult *result, void *cookie)
+{
+  TMR_LocateEngine *engine;
+  LocateSlot *slot;
+  const TMR_LocateAntenna *a, *b;
+  double uA[3], uB[3], h[3];
+  double k, turn, predicted, spread;
+  int i, j;
+
+  engine = cookie;
+  slot = engine->current;
+  a = engine->port[result->antennaA];
+  b = engine->port[result->antennaB];
+  if ((NULL == slot) || (NULL == a) || (NULL == b))
+  {
+    return;
+  }
+
+  k = 4 * LOCATE_PI * result->frequency * 1000.0 / LOCATE_C;
+  turn = engine->config.phaseTurn * LOCATE_PI / 180;
+  predicted = k * (locate_distance(slot, a, uA) - locate_distance(slot, b, uB));
+  for (i = 0; i < 3; i++)
+  {
+    h[i] = k * (uA[i] - uB[i]);
+  }
+
+  /* Only once the prediction is good to a quarter turn is the wrap resolved */
+  spread = 0;
+  for (i = 0; i < 3; i++)
+  {
+    for (j = 0; j < 3; j++)
+    {
+      spread += h[i] * slot->P[i * 6 + j] * h[j];
+    }
+  }
+  if (spread > turn * turn / 16)
+  {
+    engine->gated++;
+    return;
+  }
+
+  locate_update(slot, h, TMR_phaseWrap(result->phaseDiff - predicted, turn),
+                engine->config.phaseSigma * engine->config.phaseSigma);
+  engine->phaseUpdates++;
+}
+
+void
+TMR_locateAddRead(TMR_LocateEngine *engine, const TMR_TagReadData *read)
+{
+  TMR_LocateResult result;
+  const TMR_LocateAntenna *antenna;
+  LocateSlot *slot;
+  uint64_t now;
+  int i;
+
+  antenna = (TMR_PDOA_MAX_ANTENNAS >= read->antenna) ? engine->port[read->antenna] : NULL;
+  if (NULL == antenna)
+  {
+    engine->skipped++;
+    return;
+  }
+  engine->reads++;
+  now = ((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) * 1000;
+
+  slot = locate_find(engine, &read->tag);
+  if (false == slot->live)
+  {
+    locate_seed(engine, slot, antenna, now);
+  }
+  else
+  {
+    locate_predict(engine, slot, now);
+  }
+
+  if (engine->config.useRssi && (read->metadataFlags & TMR_TRD_METADATA_FLAG_RSSI))
+  {
+    locate_rssiUpdate(engine, slot, antenna, read->rssi);
+  }
+  engine->current = slot;
+#ifdef TMR_ENABLE_RANGING
+  if (NULL != engine->range.table.slots)
+  {
+    TMR_rangeAddRead(&engine->range, read);
+  }
+#endif
+  if (NULL != engine->pdoa.table.slots)
+  {
+    TMR_pdoaAddRead(&engine->pdoa, read);
+  }
+  engine->current = NULL;
+
+  if (slot->emitted && (now - slot->emitUs < engine->config.emitIntervalUs))
+  {
+    return;
+  }
+  result.tag = &read->tag;
+  for (i = 0; i < 3; i++)
+  {
+    result.position[i] = slot->x[i];
+    result.velocity[i] = slot->x[i + 3];
+  }
+  result.sigma = locate_sqrt(slot->P[0] + slot->P[7] + slot->P[14]);
+  result.updates = slot->updates;
+  result.timeUs = now;
+  slot->updates = 0;
+  slot->emitUs = now;
+  slot->emitted = true;
+  engine->estimates++;
+  engine->listener(engine->reader, &result, engine->cookie);
+}
+
+static void
+locate_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_locateAddRead(cookie, t);
+}
+
+void
+TMR_locateInitConfig(TMR_LocateConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->antennaCount = 0;
+  config->phaseTurn = 180;
+  config->maxSkewUs = 100000;
+  config->usePhase = true;
+  config->phaseSigma = 0.2;
+  config->useRssi = true;
+  config->rssiAt1m = -40;
+  config->pathLossExponent = 2;
+  config->rssiSigma = 4;
+  config->useRange = true;
+  config->minRangeConfidence = 0.5;
+  config->rangeOffsetM = 0;
+  config->processNoise = 0.5;
+  config->seedDistance = 1;
+  config->emitIntervalUs = 200000;
+  config->slots = 4096;
+  config->phaseSlots = 16384;
+}
+
+TMR_Status
+TMR_locateStart(TMR_Reader *reader, TMR_LocateEngine *engine,
+                const TMR_LocateConfig *config,
+                TMR_LocateListener listener, void *cookie)
+{
+  TMR_PdoaConfig pdoa;
+#ifdef TMR_ENABLE_RANGING
+  TMR_RangeConfig range;
+#endif
+  TMR_Status ret;
+  const TMR_LocateAntenna *antenna;
+  uint8_t i;
+
+  if ((NULL == listener) || (0 == config->antennaCount)
+      || (TMR_PDOA_MAX_ANTENNAS < config->antennaCount) || (0 == config->phaseTurn)
+      || (0 >= config->pathLossExponent) || (0 >= config->seedDistance))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->config = *config;
+  engine->reader = reader;
+  engine->listener = listener;
+  engine->cookie = cookie;
+  for (i = 0; i < config->antennaCount; i++)
+  {
+    antenna = &engine->config.antennas[i];
+    if ((0 == antenna->port) || (TMR_PDOA_MAX_ANTENNAS < antenna->port)
+        || (NULL != engine->port[antenna->port])
+        || ((0 == antenna->boresight[0]) && (0 == antenna->boresight[1])
+            && (0 == antenna->boresight[2])))
+    {
+      return TMR_ERROR_INVALID;
+    }
+    engine->port[antenna->port] = antenna;
+  }
+
+  ret = TMR_tagTableInit(&engine->table, config->slots, sizeof(LocateSlot));
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
+#ifdef TMR_ENABLE_RANGING
+  if (config->useRange)
+  {
+    TMR_rangeInitConfig(&range);
+    range.phaseTurn = config->phaseTurn;
+    range.offsetM = config->rangeOffsetM;
+    range.slots = config->phaseSlots / 16;
+    ret = TMR_rangeStart(NULL, &engine->range, &range, locate_rangeListener, engine);
+    if (TMR_SUCCESS != ret)
+    {
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+#endif
+
+  if (config->usePhase && (2 <= config->antennaCount))
+  {
+    TMR_pdoaInitConfig(&pdoa);
+    for (i = 0; i < config->antennaCount; i++)
+    {
+      pdoa.antennas[i] = config->antennas[i].port;
+    }
+    pdoa.antennaCount = config->antennaCount;
+    pdoa.phaseTurn = config->phaseTurn;
+    pdoa.maxSkewUs = config->maxSkewUs;
+    pdoa.slots = config->phaseSlots;
+    ret = TMR_pdoaStart(NULL, &engine->pdoa, &pdoa, locate_pdoaListener, engine);
+    if (TMR_SUCCESS != ret)
+    {
+#ifdef TMR_ENABLE_RANGING
+      TMR_rangeStop(&engine->range);
+#endif
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+
+  if (NULL != reader)
+  {
+    engine->readListener.listener = locate_readListener;
+    engine->readListener.cookie = engine;
+    ret = TMR_addReadListener(reader, &engine->readListener);
+    if (TMR_SUCCESS != ret)
+    {
+#ifdef TMR_ENABLE_RANGING
+      TMR_rangeStop(&engine->range);
+#endif
+      TMR_pdoaStop(&engine->pdoa);
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_locateStop(TMR_LocateEngine *engine)
+{
+  if (NULL != engine->reader)
+  {
+    TMR_removeReadListener(engine->reader, &engine->readListener);
+    engine->reader = NULL;
+  }
+#ifdef TMR_ENABLE_RANGING
+  TMR_rangeStop(&engine->range);
+#endif
+  TMR_pdoaStop(&engine->pdoa);
+  TMR_tagTableDestroy(&engine->table);
+}
+
+TMR_Status
+TMR_locateAngle(const TMR_LocateConfig *config, const TMR_PdoaResult *result,
+                double *cosine)
+{
+  const TMR_LocateAntenna *a, *b;
+  double baseline, k;
+  uint8_t i;
+
+  a = NULL;
+  b = NULL;
+  for (i = 0; i < config->antennaCount; i++)
+  {
+    if (result->antennaA == config->antennas[i].port)
+    {
+      a = &config->antennas[i];
+    }
+    if (result->antennaB == config->antennas[i].port)
+    {
+      b = &config->antennas[i];
+    }
+  }
+  if ((NULL == a) || (NULL == b))
+  {
+    return TMR_ERROR_INVALID;
+  }
+  baseline = 0;
+  for (i = 0; i < 3; i++)
+  {
+    baseline += (b->position[i] - a->position[i]) * (b->position[i] - a->position[i]);
+  }
+  baseline = locate_sqrt(baseline);
+  if (0 == baseline)
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  /* Far away, dA - dB is the baseline times the cosine */
+  k = 4 * LOCATE_PI * result->frequency * 1000.0 / LOCATE_C;
+  *cosine = result->phaseDiff / (k * baseline);
+  *cosine = (1 < *cosine) ? 1 : ((-1 > *cosine) ? -1 : *cosine);
+  return TMR_SUCCESS;
+}
+
+#endif /* TMR_ENABLE_LOCATE */
@@ -0,0 +1,268 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_LOCATE_H
+#define _TMR_LOCATE_H
+/**
+ *  @file tmr_locate.h
+ *  @brief Mercury API - Tag position estimator
+ *
+ * Live tag positions from the read stream.  Given where each antenna
+ * port is, the estimator tracks every tag with an extended Kalman
+ * filter over position and velocity, updated as each read arrives:
+ *
+ * - RSSI gives a distance from the antenna through a log-distance
+ *   path loss model; from several antennas this is trilateration.
+ * - With TMR_ENABLE_RANGING, the slope of phase against carrier
+ *   frequency (see tmr_range.h) gives the distance from each antenna
+ *   far more closely: the same trilateration, to centimetres.
+ * - The phase difference of the tag between two antennas at the same
+ *   frequency (see tmr_pdoa.h) gives the difference of its distances
+ *   from them, which is what angle of arrival measures.  It is only
+ *   known modulo a fraction of a wavelength, so it is used once the
+ *   filter knows the tag well enough to tell which fraction: until
+ *   then the phase updates are counted as gated and skipped.  RSSI
+ *   alone seldom gets there; ranging does.
+ *
+ * Each tag's estimate goes to the listener at most once per
+ * emitIntervalUs.  Filter state is a fixed table sized when the
+ * estimator starts and nothing is allocated per read.
+ *
+ * The phase model takes the antennas' cable and reader phase offsets
+ * as equal; where they aren't, the differences become position
+ * errors.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_pdoa.h"
+#include "tmr_range.h"
+#include "tmr_tag_table.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_LOCATE
+
+/**
+ * Where an antenna port is and which way it faces.
+ **/
+typedef struct TMR_LocateAntenna
+{
+  /** Antenna port, 1 to TMR_PDOA_MAX_ANTENNAS */
+  uint8_t port;
+  /** Position, metres */
+  double position[3];
+  /**
+   * Direction the antenna faces, any length.  A tag first read on
+   * this antenna starts seedDistance along it.
+   */
+  double boresight[3];
+} TMR_LocateAntenna;
+
+/**
+ * Estimator configuration, see TMR_locateInitConfig().
+ **/
+typedef struct TMR_LocateConfig
+{
+  /** The antennas; reads on other ports are skipped */
+  TMR_LocateAntenna antennas[TMR_PDOA_MAX_ANTENNAS];
+  /** Number of entries in antennas */
+  uint8_t antennaCount;
+  /** Phase values wrap at this many degrees (default 180) */
+  uint16_t phaseTurn;
+  /** Longest time between the two reads of a phase difference (default 100 ms) */
+  uint32_t maxSkewUs;
+  /** Use phase differences (default true) */
+  bool usePhase;
+  /** Standard deviation of a phase difference, radians (default 0.2) */
+  double phaseSigma;
+  /** Use RSSI distances (default true) */
+  bool useRssi;
+  /** RSSI of a tag 1 m in front of an antenna, dBm (default -40) */
+  double rssiAt1m;
+  /** Path loss exponent, 2 in free space (default 2) */
+  double pathLossExponent;
+  /** Standard deviation of RSSI about the model, dB (default 4) */
+  double rssiSigma;
+  /** Use multi-frequency ranging, where it is built (default true) */
+  bool useRange;
+  /** Lowest confidence of a ranging estimate to use (default 0.5) */
+  double minRangeConfidence;
+  /** Cable and reader offset of the ranging distances, metres (default 0) */
+  double rangeOffsetM;
+  /**
+   * Random acceleration of the tags, as the spectral density of the
+   * filter's process noise, m^2/s^3 (default 0.5)
+   */
+  double processNoise;
+  /** Distance in front of the first antenna a new tag starts, metres (default 1) */
+  double seedDistance;
+  /** Shortest time between estimates of a tag (default 200 ms) */
+  uint32_t emitIntervalUs;
+  /**
+   * Tags tracked, a power of two (default 4096).  When the table is
+   * full the tag read longest ago is forgotten.
+   */
+  uint32_t slots;
+  /**
+   * Tag, antenna and frequency combinations the phase difference
+   * engine tracks, a power of two (default 16384); ranging tracks a
+   * sixteenth as many tags and antennas
+   */
+  uint32_t phaseSlots;
+} TMR_LocateConfig;
+
+/**
+ * A tag's position.  Passed to the listener, valid during the call.
+ **/
+typedef struct TMR_LocateResult
+{
+  /** The tag */
+  const TMR_TagData *tag;
+  /** Position, metres, in the frame of the antenna positions */
+  double position[3];
+  /** Velocity, metres per second */
+  double velocity[3];
+  /** Root of the summed variances of the position, metres */
+  double sigma;
+  /** Measurements taken in since the tag's last estimate */
+  uint32_t updates;
+  /** Time of the read that gave the estimate, microseconds */
+  uint64_t timeUs;
+} TMR_LocateResult;
+
+/**
+ * Called with each estimate, from the thread that delivers the reads.
+ **/
+typedef void (*TMR_LocateListener)(TMR_Reader *reader, const TMR_LocateResult *result,
+                                   void *cookie);
+
+/**
+ * A position estimator, see TMR_locateStart().
+ **/
+typedef struct TMR_LocateEngine
+{
+  /** @private */
+  TMR_LocateConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_LocateListener listener;
+  /** @private */
+  void *cookie;
+  /** @private Phase differences */
+  TMR_PdoaEngine pdoa;
+#ifdef TMR_ENABLE_RANGING
+  /** @private Distances */
+  TMR_RangeEngine range;
+#endif
+  /** @private Antenna of each port, or NULL */
+  const TMR_LocateAntenna *port[TMR_PDOA_MAX_ANTENNAS + 1];
+  /** @private */
+  TMR_TagTable table;
+  /** @private Slot of the read being taken in */
+  void *current;
+  /** Reads taken in */
+  uint64_t reads;
+  /** Reads on antennas not in the geometry */
+  uint64_t skipped;
+  /** RSSI readings fused */
+  uint64_t rssiUpdates;
+  /** Ranging distances fused */
+  uint64_t rangeUpdates;
+  /** Phase differences fused */
+  uint64_t phaseUpdates;
+  /** Phase differences skipped while the position was too uncertain */
+  uint64_t gated;
+  /** Estimates reported */
+  uint64_t estimates;
+  /** Tracked tags forgotten to make room */
+  uint64_t evictions;
+} TMR_LocateEngine;
+
+/**
+ * Fill in the default configuration, with no antennas.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_locateInitConfig(TMR_LocateConfig *config);
+
+/**
+ * Start an estimator and, given a reader, add it as a read listener.
+ *
+ * @param reader The reader, or NULL to feed the estimator with
+ *               TMR_locateAddRead() only
+ * @param engine Estimator state, owned by the caller until it is stopped
+ * @param config The configuration
+ * @param listener Called with each estimate
+ * @param cookie Passed to listener
+ * @return TMR_ERROR_INVALID for a bad configuration
+ **/
+TMR_Status TMR_locateStart(TMR_Reader *reader, TMR_LocateEngine *engine,
+                           const TMR_LocateConfig *config,
+                           TMR_LocateListener listener, void *cookie);
+
+/**
+ * Take in one read, as the read listener does.  For reads from a
+ * sync read or a file; don't call it for an estimator added to a
+ * reader that is reading in the background.
+ *
+ * @param engine The estimator
+ * @param read The read
+ **/
+void TMR_locateAddRead(TMR_LocateEngine *engine, const TMR_TagReadData *read);
+
+/**
+ * Remove the read listener and free the tables.
+ *
+ * @param engine The estimator
+ **/
+void TMR_locateStop(TMR_LocateEngine *engine);
+
+/**
+ * Angle of arrival of a tag far from a pair of antennas, from their
+ * phase difference alone: the cosine of the angle between the line
+ * from antennaA to antennaB and the direction of the tag.  Phase
+ * repeats every phaseTurn, so with antennas further apart than
+ * phaseTurn / 720 wavelengths (a quarter wavelength for the M6e)
+ * this is one of several angles.
+ *
+ * @param config The configuration with the antennas
+ * @param result A phase difference
+ * @param[out] cosine The cosine, -1 to 1
+ * @return TMR_ERROR_INVALID if either antenna isn't in the
+ *         configuration or they are in the same place
+ **/
+TMR_Status TMR_locateAngle(const TMR_LocateConfig *config, const TMR_PdoaResult *result,
+                           double *cosine);
+
+#endif /* TMR_ENABLE_LOCATE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_LOCATE_H */
@@ -0,0 +1,903 @@
+/**
+ *  @file tmr_metrics.c
+ *  @brief Mercury API - OpenMetrics exporter
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_METRICS_EXPORTER
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "tm_reader.h"
+#include "tmr_metrics.h"
+
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#define METRICS_ADD(p, n) ((void)__atomic_fetch_add((p), (n), __ATOMIC_RELAXED))
+#define METRICS_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#else
+#define METRICS_ADD(p, n) ((void)(*(p) += (n)))
+#define METRICS_LOAD(p) (*(p))
+#endif
+
+/* Upper bounds of the RSSI buckets in dBm, the last bucket is +Inf */
+#define RSSI_BUCKETS 12
+static const int rssiLimits[RSSI_BUCKETS - 1] = {
+  -90, -80, -75, -70, -65, -60, -55, -50, -45, -40, -30
+};
+
+/* Longest reader label, before escaping */
+#define METRICS_NAME_LENGTH 64
+/* Largest HTTP request read */
+#define METRICS_REQUEST_LENGTH 2048
+/* How long a client gets to send its request */
+#define METRICS_REQUEST_TIMEOUT_MS 2000
+/* How long a client gets to take the response, so a stalled one can't hold up the next */
+#define METRICS_RESPONSE_TIMEOUT_MS 2000
+
+typedef struct MetricsAntenna
+{
+  uint64_t reads;
+  /* Not cumulative, summed up when formatted */
+  uint64_t rssi[RSSI_BUCKETS];
+} MetricsAntenna;
+
+/* The module statistics kept, TMR_Reader_StatsValues points into itself */
+typedef struct MetricsModuleStats
+{
+  TMR_Reader_StatsFlag valid;
+  int8_t temperature;
+  uint32_t frequency;
+  uint16_t antennaCount;
+  TMR_StatsPerAntennaValues perAntenna[TMR_SR_MAX_ANTENNA_PORTS];
+} MetricsModuleStats;
+
+typedef struct MetricsReader
+{
+  struct MetricsReader *next;
+  TMR_Reader *reader;
+  /* Escaped for a label value */
+  char name[(2 * METRICS_NAME_LENGTH) + 1];
+  uint32_t flags;
+
+  TMR_ReadListenerBlock readListener;
+  TMR_StatsListenerBlock statsListener;
+
+  /* Written by the read listener only; antenna numbers past the last go in the last */
+  MetricsAntenna antennas[TMR_METRICS_MAX_ANTENNAS + 1];
+
+  /* Guards stats; the stats listener skips a report rather than wait */
+  pthread_mutex_t statsLock;
+  MetricsModuleStats stats;
+
+  /* Snapshots taken at the start of a scrape, under the exporter lock */
+  MetricsModuleStats scrapeStats;
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  TMR_PipelineStats scrapePipeline;
+#endif
+} MetricsReader;
+
+struct TMR_MetricsExporter
+{
+  /* Guards readers and the scrape state */
+  pthread_mutex_t lock;
+  MetricsReader *readers;
+
+  int listenFd;
+  volatile bool stopping;
+  bool serving;
+  pthread_t thread;
+
+  /* Response body, kept between scrapes; only the server thread uses it */
+  char *body;
+  size_t bodySize;
+};
+
+typedef struct MetricsOut
+{
+  char *buffer;
+  size_t size;
+  size_t length;
+} MetricsOut;
+
+static void
+out_printf(MetricsOut *out, const char *format, ...)
+{
+  va_list ap;
+  int n;
+
+  va_start(ap, format);
+  n = vsnprintf((out->length < out->size) ? out->buffer + out->length : NULL,
+                (out->length < out->size) ? out->size - out->length : 0,
+                format, ap);
+  va_end(ap);
+  if (0 < n)
+  {
+    out->length += n;
+  }
+}
+
+static void
+out_family(MetricsOut *out, const char *name, const char *type,
+           const char *unit, const char *help)
+{
+  out_printf(out, "# TYPE %s %s\n", name, type);
+  if (NULL != unit)
+  {
+    out_printf(out, "# UNIT %s %s\n", name, unit);
+  }
+  out_printf(out, "# HELP %s %s\n", name, help);
+}
+
+static void
+out_antenna(MetricsOut *out, int antenna)
+{
+  if (TMR_METRICS_MAX_ANTENNAS == antenna)
+  {
+    out_printf(out, "antenna=\"other\"");
+  }
+  else
+  {
+    out_printf(out, "antenna=\"%d\"", antenna);
+  }
+}
+
+static void
+metrics_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  MetricsReader *m = cookie;
+  MetricsAntenna *a;
+  int i;
+
+  a = &m->antennas[(t->antenna < TMR_METRICS_MAX_ANTENNAS) ? t->antenna : TMR_METRICS_MAX_ANTENNAS];
+  for (i = 0; (i < RSSI_BUCKETS - 1) && (t->rssi > rssiLimits[i]); i++)
+    ;
+  METRICS_ADD(&a->reads, 1);
+  METRICS_ADD(&a->rssi[i], 1);
+}
+
+static void
+metrics_statsListener(TMR_Reader *reader, const TMR_Reader_StatsValues *stats, void *cookie)
+{
+  MetricsReader *m = cookie;
+  uint16_t i;
+
+  if (0 != pthread_mutex_trylock(&m->statsLock))
+  {
+    /* A scrape is copying; the next report will do */
+    return;
+  }
+  m->stats.valid = stats->valid;
+  m->stats.temperature = stats->temperature;
+  m->stats.frequency = stats->frequency;
+  m->stats.antennaCount = 0;
+  for (i = 0; (i < stats->perAntenna.len) && (i < TMR_SR_MAX_ANTENNA_PORTS); i++)
+  {
+    m->stats.perAntenna[i] = stats->perAntenna.list[i];
+    m->stats.antennaCount++;
+  }
+  pthread_mutex_unlock(&m->statsLock);
+}
+
+static void
+metrics_escapeLabel(char *dst, const char *src)
+{
+  size_t i;
+
+  for (i = 0; ('\0' != src[i]) && (i < METRICS_NAME_LENGTH); i++)
+  {
+    if (('\\' == src[i]) || ('"' == src[i]))
+    {
+      *dst++ = '\\';
+      *dst++ = src[i];
+    }
+    else if ('\n' == src[i])
+    {
+      *dst++ = '\\';
+      *dst++ = 'n';
+    }
+    else
+    {
+      *dst++ = src[i];
+    }
+  }
+  *dst = '\0';
+}
+
+static void
+format_reads(MetricsOut *out, MetricsReader *readers)
+{
+  MetricsReader *m;
+  int a;
+
+  out_family(out, "tmr_tag_reads", "counter", NULL, "Tag reads reported to the host.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (0 == (m->flags & TMR_METRICS_READS))
+    {
+      continue;
+    }
+    for (a = 0; a <= TMR_METRICS_MAX_ANTENNAS; a++)
+    {
+      uint64_t reads = METRICS_LOAD(&m->antennas[a].reads);
+
+      if (0 == reads)
+      {
+        continue;
+      }
+      out_printf(out, "tmr_tag_reads_total{reader=\"%s\",", m->name);
+      out_antenna(out, a);
+      out_printf(out, "} %llu\n", (unsigned long long)reads);
+    }
+  }
+
+  /* Negative bucket bounds, so no _sum (OpenMetrics requires it be a counter) */
+  out_family(out, "tmr_tag_rssi_dbm", "histogram", "dbm", "RSSI of tag reads.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (0 == (m->flags & TMR_METRICS_READS))
+    {
+      continue;
+    }
+    for (a = 0; a <= TMR_METRICS_MAX_ANTENNAS; a++)
+    {
+      uint64_t cumulative;
+      int i;
+
+      if (0 == METRICS_LOAD(&m->antennas[a].reads))
+      {
+        continue;
+      }
+      cumulative = 0;
+      for (i = 0; i < RSSI_BUCKETS; i++)
+      {
+        cumulative += METRICS_LOAD(&m->antennas[a].rssi[i]);
+        out_printf(out, "tmr_tag_rssi_dbm_bucket{reader=\"%s\",", m->name);
+        out_antenna(out, a);
+        if (i < RSSI_BUCKETS - 1)
+        {
+          out_printf(out, ",le=\"%d.0\"} %llu\n", rssiLimits[i], (unsigned long long)cumulative);
+        }
+        else
+        {
+          out_printf(out, ",le=\"+Inf\"} %llu\n", (unsigned long long)cumulative);
+        }
+      }
+      out_printf(out, "tmr_tag_rssi_dbm_count{reader=\"%s\",", m->name);
+      out_antenna(out, a);
+      out_printf(out, "} %llu\n", (unsigned long long)cumulative);
+    }
+  }
+}
+
+static void
+format_moduleStats(MetricsOut *out, MetricsReader *readers)
+{
+  MetricsReader *m;
+  uint16_t i;
+
+  out_family(out, "tmr_reader_temperature_celsius", "gauge", "celsius",
+             "Module temperature.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (m->scrapeStats.valid & TMR_READER_STATS_FLAG_TEMPERATURE)
+    {
+      out_printf(out, "tmr_reader_temperature_celsius{reader=\"%s\"} %d\n",
+                 m->name, m->scrapeStats.temperature);
+    }
+  }
+
+  out_family(out, "tmr_reader_frequency_hertz", "gauge", "hertz",
+             "Current RF carrier frequency.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (m->scrapeStats.valid & TMR_READER_STATS_FLAG_FREQUENCY)
+    {
+      out_printf(out, "tmr_reader_frequency_hertz{reader=\"%s\"} %llu\n",
+                 m->name, (unsigned long long)m->scrapeStats.frequency * 1000);
+    }
+  }
+
+  out_family(out, "tmr_antenna_rf_on_seconds", "gauge", "seconds",
+             "RF on time since the start of the search.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (0 == (m->scrapeStats.valid & TMR_READER_STATS_FLAG_RF_ON_TIME))
+    {
+      continue;
+    }
+    for (i = 0; i < m->scrapeStats.antennaCount; i++)
+    {
+      out_printf(out, "tmr_antenna_rf_on_seconds{reader=\"%s\",antenna=\"%u\"} %u.%03u\n",
+                 m->name, m->scrapeStats.perAntenna[i].antenna,
+                 m->scrapeStats.perAntenna[i].rfOnTime / 1000,
+                 m->scrapeStats.perAntenna[i].rfOnTime % 1000);
+    }
+  }
+
+  out_family(out, "tmr_antenna_noise_floor_dbm", "gauge", "dbm",
+             "Noise floor with the transmitter on.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (0 == (m->scrapeStats.valid & TMR_READER_STATS_FLAG_NOISE_FLOOR_SEARCH_RX_TX_WITH_TX_ON))
+    {
+      continue;
+    }
+    for (i = 0; i < m->scrapeStats.antennaCount; i++)
+    {
+      out_printf(out, "tmr_antenna_noise_floor_dbm{reader=\"%s\",antenna=\"%u\"} %d\n",
+                 m->name, m->scrapeStats.perAntenna[i].antenna,
+                 m->scrapeStats.perAntenna[i].noiseFloor);
+    }
+  }
+}
+
+#ifdef TMR_ENABLE_PIPELINE_STATS
+
+typedef struct PipelineMetric
+{
+  const char *name;
+  const char *help;
+  size_t offset;
+} PipelineMetric;
+
+static const PipelineMetric pipelineCounters[] = {
+  {"tmr_pipeline_transport_bytes", "Bytes received from the device.",
+   offsetof(TMR_PipelineStats, transportBytes)},
+  {"tmr_pipeline_transport_frames", "Messages received from the device intact.",
+   offsetof(TMR_PipelineStats, transportFrames)},
+  {"tmr_pipeline_crc_errors", "Messages received with a bad CRC.",
+   offsetof(TMR_PipelineStats, crcErrors)},
+  {"tmr_pipeline_resyncs", "Times the receiver discarded bytes looking for a start of message.",
+   offsetof(TMR_PipelineStats, resyncs)},
+  {"tmr_pipeline_enqueued", "Messages put on the background read queue.",
+   offsetof(TMR_PipelineStats, enqueued)},
+  {"tmr_pipeline_dispatched", "Messages taken off the background read queue and parsed.",
+   offsetof(TMR_PipelineStats, dispatched)},
+  {"tmr_pipeline_queue_stalls", "Times the background reader paused for a nearly full queue.",
+   offsetof(TMR_PipelineStats, queueStalls)},
+  {"tmr_pipeline_overflows", "Times the queue filled up and background reading was stopped.",
+   offsetof(TMR_PipelineStats, overflows)},
+  {"tmr_pipeline_drops", "Messages dropped as corrupt by the background reader.",
+   offsetof(TMR_PipelineStats, drops)},
+  {"tmr_pipeline_duplicates", "Tag reads dropped by the API-side dedup filter.",
+   offsetof(TMR_PipelineStats, duplicates)},
+};
+
+static const PipelineMetric pipelineGauges[] = {
+  {"tmr_pipeline_queue_depth", "Messages waiting in the background read queue.",
+   offsetof(TMR_PipelineStats, queueDepth)},
+  {"tmr_pipeline_queue_high_water", "Most messages ever waiting in the background read queue.",
+   offsetof(TMR_PipelineStats, queueHighWater)},
+};
+
+/**
+ * Export a microsecond histogram in seconds.  Bounds are every other
+ * power of two from 16us to 16s, each the limit of a bucket of the
+ * histogram, so the cumulative counts are exact.
+ **/
+static void
+format_latency(MetricsOut *out, const char *name, const char *labels,
+               const TMR_Histogram *histogram)
+{
+  uint64_t cumulative;
+  int i, next, power;
+
+  cumulative = 0;
+  i = 0;
+  for (power = 4; power <= 24; power += 2)
+  {
+    uint32_t limit;
+
+    /* The bucket ending at 2^power - 1 */
+    next = ((power - 3) * 8) + 7;
+    for (; i <= next; i++)
+    {
+      cumulative += histogram->counts[i];
+    }
+    limit = TMR_histogramBucketLimit(next);
+    out_printf(out, "%s_bucket{%s,le=\"%u.%06u\"} %llu\n", name, labels,
+               limit / 1000000, limit % 1000000, (unsigned long long)cumulative);
+  }
+  for (; i < TMR_HISTOGRAM_BUCKETS; i++)
+  {
+    cumulative += histogram->counts[i];
+  }
+  out_printf(out, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels, (unsigned long long)cumulative);
+  out_printf(out, "%s_count{%s} %llu\n", name, labels, (unsigned long long)cumulative);
+  out_printf(out, "%s_sum{%s} %llu.%06u\n", name, labels,
+             (unsigned long long)(histogram->sum / 1000000),
+             (unsigned)(histogram->sum % 1000000));
+}
+
+static void
+format_pipeline(MetricsOut *out, MetricsReader *readers)
+{
+  MetricsReader *m;
+  char labels[sizeof(m->name) + 32];
+  size_t i;
+  int l;
+
+  for (i = 0; i < sizeof(pipelineCounters) / sizeof(pipelineCounters[0]); i++)
+  {
+    out_family(out, pipelineCounters[i].name, "counter", NULL, pipelineCounters[i].help);
+    for (m = readers; NULL != m; m = m->next)
+    {
+      if (m->flags & TMR_METRICS_PIPELINE)
+      {
+        out_printf(out, "%s_total{reader=\"%s\"} %llu\n", pipelineCounters[i].name, m->name,
+                   (unsigned long long)*(const uint64_t *)
+                   ((const char *)&m->scrapePipeline + pipelineCounters[i].offset));
+      }
+    }
+  }
+  for (i = 0; i < sizeof(pipelineGauges) / sizeof(pipelineGauges[0]); i++)
+  {
+    out_family(out, pipelineGauges[i].name, "gauge", NULL, pipelineGauges[i].help);
+    for (m = readers; NULL != m; m = m->next)
+    {
+      if (m->flags & TMR_METRICS_PIPELINE)
+      {
+        out_printf(out, "%s{reader=\"%s\"} %u\n", pipelineGauges[i].name, m->name,
+                   *(const uint32_t *)((const char *)&m->scrapePipeline + pipelineGauges[i].offset));
+      }
+    }
+  }
+
+  out_family(out, "tmr_pipeline_dispatch_latency_seconds", "histogram", "seconds",
+             "Time from receiving a message to dispatching it.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (m->flags & TMR_METRICS_PIPELINE)
+    {
+      snprintf(labels, sizeof(labels), "reader=\"%s\"", m->name);
+      format_latency(out, "tmr_pipeline_dispatch_latency_seconds", labels,
+                     &m->scrapePipeline.dispatchLatencyUs);
+    }
+  }
+
+  out_family(out, "tmr_pipeline_listener_callback_seconds", "histogram", "seconds",
+             "Time spent in each read listener call, by listener slot.");
+  for (m = readers; NULL != m; m = m->next)
+  {
+    if (0 == (m->flags & TMR_METRICS_PIPELINE))
+    {
+      continue;
+    }
+    for (l = 0; l < TMR_PIPELINE_MAX_LISTENERS; l++)
+    {
+      if (NULL == m->scrapePipeline.listeners[l].block)
+      {
+        continue;
+      }
+      snprintf(labels, sizeof(labels), "reader=\"%s\",listener=\"%d\"", m->name, l);
+      format_latency(out, "tmr_pipeline_listener_callback_seconds", labels,
+                     &m->scrapePipeline.listeners[l].callbackUs);
+    }
+  }
+}
+
+#endif /* TMR_ENABLE_PIPELINE_STATS */
+
+/* Called with the exporter lock held */
+static size_t
+metrics_format(TMR_MetricsExporter *exporter, char *buffer, size_t size)
+{
+  MetricsOut out;
+  MetricsReader *m;
+
+  for (m = exporter->readers; NULL != m; m = m->next)
+  {
+    pthread_mutex_lock(&m->statsLock);
+    m->scrapeStats = m->stats;
+    pthread_mutex_unlock(&m->statsLock);
+#ifdef TMR_ENABLE_PIPELINE_STATS
+    if (m->flags & TMR_METRICS_PIPELINE)
+    {
+      TMR_paramGet(m->reader, TMR_PARAM_PIPELINE_STATS, &m->scrapePipeline);
+    }
+#endif
+  }
+
+  out.buffer = buffer;
+  out.size = size;
+  out.length = 0;
+  if (0 < size)
+  {
+    buffer[0] = '\0';
+  }
+
+  format_reads(&out, exporter->readers);
+  format_moduleStats(&out, exporter->readers);
+#ifdef TMR_ENABLE_PIPELINE_STATS
+  format_pipeline(&out, exporter->readers);
+#endif
+  out_printf(&out, "# EOF\n");
+
+  return out.length;
+}
+
+size_t
+TMR_metricsFormat(TMR_MetricsExporter *exporter, char *buffer, size_t size)
+{
+  size_t length;
+
+  pthread_mutex_lock(&exporter->lock);
+  length = metrics_format(exporter, buffer, size);
+  pthread_mutex_unlock(&exporter->lock);
+
+  return length;
+}
+
+static bool
+metrics_sendAll(int fd, const char *data, size_t length)
+{
+  ssize_t n;
+
+  while (0 < length)
+  {
+    n = send(fd, data, length, MSG_NOSIGNAL);
+    if (0 > n)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    length -= n;
+  }
+  return true;
+}
+
+static void
+metrics_respond(int fd, const char *status, const char *type, const char *body, size_t length)
+{
+  char header[256];
+  int n;
+
+  n = snprintf(header, sizeof(header),
+               "HTTP/1.1 %s\r\n"
+               "Content-Type: %s\r\n"
+               "Content-Length: %lu\r\n"
+               "Connection: close\r\n"
+               "\r\n", status, type, (unsigned long)length);
+  if (metrics_sendAll(fd, header, n))
+  {
+    metrics_sendAll(fd, body, length);
+  }
+}
+
+static void
+metrics_serve(TMR_MetricsExporter *exporter, int fd)
+{
+  char request[METRICS_REQUEST_LENGTH + 1];
+  size_t length, needed;
+  struct timeval tv;
+  char *path, *end;
+  ssize_t n;
+
+  tv.tv_sec = METRICS_REQUEST_TIMEOUT_MS / 1000;
+  tv.tv_usec = (METRICS_REQUEST_TIMEOUT_MS % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (void *)&tv, sizeof tv);
+  tv.tv_sec = METRICS_RESPONSE_TIMEOUT_MS / 1000;
+  tv.tv_usec = (METRICS_RESPONSE_TIMEOUT_MS % 1000) * 1000;
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (void *)&tv, sizeof tv);
+
+  /* Only the request line matters, but read the headers so closing doesn't reset */
+  length = 0;
+  while (length < METRICS_REQUEST_LENGTH)
+  {
+    n = recv(fd, request + length, METRICS_REQUEST_LENGTH - length, 0);
+    if (0 >= n)
+    {
+      break;
+    }
+    length += n;
+    request[length] = '\0';
+    if (NULL != strstr(request, "\r\n\r\n"))
+    {
+      break;
+    }
+  }
+  request[length] = '\0';
+
+  path = strchr(request, ' ');
+  end = (NULL == path) ? NULL : strchr(path + 1, ' ');
+  if ((NULL == end) || (0 != strncmp(request, "GET ", 4)))
+  {
+    static const char msg[] = "Only GET is supported\n";
+    metrics_respond(fd, "405 Method Not Allowed", "text/plain", msg, sizeof(msg) - 1);
+    return;
+  }
+  *end = '\0';
+  path++;
+  if ((0 != strcmp(path, "/metrics")) && (0 != strncmp(path, "/metrics?", 9)))
+  {
+    static const char msg[] = "Metrics are at /metrics\n";
+    metrics_respond(fd, "404 Not Found", "text/plain", msg, sizeof(msg) - 1);
+    return;
+  }
+
+  /* Format under the lock, send unlocked: a stalled client can't hold up the callers */
+  pthread_mutex_lock(&exporter->lock);
+  needed = metrics_format(exporter, exporter->body, exporter->bodySize);
+  if (needed >= exporter->bodySize)
+  {
+    char *body = realloc(exporter->body, needed + 1);
+
+    if (NULL != body)
+    {
+      exporter->body = body;
+      exporter->bodySize = needed + 1;
+      needed = metrics_format(exporter, exporter->body, exporter->bodySize);
+    }
+  }
+  pthread_mutex_unlock(&exporter->lock);
+
+  if (needed < exporter->bodySize)
+  {
+    metrics_respond(fd, "200 OK",
+                    "application/openmetrics-text; version=1.0.0; charset=utf-8",
+                    exporter->body, needed);
+  }
+  else
+  {
+    static const char msg[] = "Out of memory\n";
+    metrics_respond(fd, "500 Internal Server Error", "text/plain", msg, sizeof(msg) - 1);
+  }
+}
+
+static void *
+metrics_thread(void *arg)
+{
+  TMR_MetricsExporter *exporter = arg;
+  struct pollfd pfd;
+  int fd;
+
+  pfd.fd = exporter->listenFd;
+  pfd.events = POLLIN;
+  while (false == exporter->stopping)
+  {
+    if (0 >= poll(&pfd, 1, 100))
+    {
+      continue;
+    }
+    fd = accept(exporter->listenFd, NULL, NULL);
+    if (0 > fd)
+    {
+      continue;
+    }
+    /* Scrapes are rare and quick, serve them one at a time */
+    metrics_serve(exporter, fd);
+    close(fd);
+  }
+  return NULL;
+}
+
+void
+TMR_metricsInitConfig(TMR_MetricsConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  strcpy(config->address, "127.0.0.1");
+  config->port = TMR_METRICS_DEFAULT_PORT;
+}
+
+TMR_Status
+TMR_metricsStart(TMR_MetricsExporter **exporter, const TMR_MetricsConfig *config)
+{
+  TMR_MetricsExporter *e;
+  struct sockaddr_in sin;
+  int flag;
+
+  e = calloc(1, sizeof(*e));
+  if (NULL == e)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  pthread_mutex_init(&e->lock, NULL);
+  e->listenFd = -1;
+
+  if (0 != config->port)
+  {
+    memset(&sin, 0, sizeof sin);
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(config->port);
+    if (1 != inet_pton(AF_INET, config->address, &sin.sin_addr))
+    {
+      pthread_mutex_destroy(&e->lock);
+      free(e);
+      return TMR_ERROR_INVALID;
+    }
+
+    e->listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (0 > e->listenFd)
+    {
+      pthread_mutex_destroy(&e->lock);
+      free(e);
+      return TMR_ERROR_COMM_ERRNO(errno);
+    }
+    flag = 1;
+    setsockopt(e->listenFd, SOL_SOCKET, SO_REUSEADDR, (void *)&flag, sizeof flag);
+    if ((0 != bind(e->listenFd, (struct sockaddr *)&sin, sizeof sin))
+        || (0 != listen(e->listenFd, 8)))
+    {
+      TMR_Status ret = TMR_ERROR_COMM_ERRNO(errno);
+
+      close(e->listenFd);
+      pthread_mutex_destroy(&e->lock);
+      free(e);
+      return ret;
+    }
+
+    if (0 != pthread_create(&e->thread, NULL, metrics_thread, e))
+    {
+      close(e->listenFd);
+      pthread_mutex_destroy(&e->lock);
+      free(e);
+      return TMR_ERROR_NO_THREADS;
+    }
+    e->serving = true;
+  }
+
+  *exporter = e;
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_metricsAddReader(TMR_MetricsExporter *exporter, TMR_Reader *reader,
+                     const char *name, uint32_t flags)
+{
+  MetricsReader *m;
+  TMR_Status ret;
+
+  pthread_mutex_lock(&exporter->lock);
+  for (m = exporter->readers; NULL != m; m = m->next)
+  {
+    if (reader == m->reader)
+    {
+      pthread_mutex_unlock(&exporter->lock);
+      return TMR_ERROR_INVALID;
+    }
+  }
+  pthread_mutex_unlock(&exporter->lock);
+
+  m = calloc(1, sizeof(*m));
+  if (NULL == m)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  m->reader = reader;
+  m->flags = flags;
+  metrics_escapeLabel(m->name, name);
+  pthread_mutex_init(&m->statsLock, NULL);
+
+  if (flags & TMR_METRICS_READS)
+  {
+    m->readListener.listener = metrics_readListener;
+    m->readListener.cookie = m;
+    ret = TMR_addReadListener(reader, &m->readListener);
+    if (TMR_SUCCESS != ret)
+    {
+      pthread_mutex_destroy(&m->statsLock);
+      free(m);
+      return ret;
+    }
+  }
+  if (flags & TMR_METRICS_MODULE_STATS)
+  {
+    m->statsListener.listener = metrics_statsListener;
+    m->statsListener.cookie = m;
+    ret = TMR_addStatsListener(reader, &m->statsListener);
+    if (TMR_SUCCESS != ret)
+    {
+      if (flags & TMR_METRICS_READS)
+      {
+        TMR_removeReadListener(reader, &m->readListener);
+      }
+      pthread_mutex_destroy(&m->statsLock);
+      free(m);
+      return ret;
+    }
+  }
+
+  pthread_mutex_lock(&exporter->lock);
+  m->next = exporter->readers;
+  exporter->readers = m;
+  pthread_mutex_unlock(&exporter->lock);
+
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_metricsRemoveReader(TMR_MetricsExporter *exporter, TMR_Reader *reader)
+{
+  MetricsReader *m, **prev;
+
+  pthread_mutex_lock(&exporter->lock);
+  for (prev = &exporter->readers; NULL != *prev; prev = &(*prev)->next)
+  {
+    if (reader == (*prev)->reader)
+    {
+      break;
+    }
+  }
+  m = *prev;
+  if (NULL != m)
+  {
+    *prev = m->next;
+  }
+  pthread_mutex_unlock(&exporter->lock);
+
+  if (NULL == m)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  /* Once removed, neither listener is running or will run again */
+  if (m->flags & TMR_METRICS_READS)
+  {
+    TMR_removeReadListener(reader, &m->readListener);
+  }
+  if (m->flags & TMR_METRICS_MODULE_STATS)
+  {
+    TMR_removeStatsListener(reader, &m->statsListener);
+  }
+  pthread_mutex_destroy(&m->statsLock);
+  free(m);
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_metricsStop(TMR_MetricsExporter *exporter)
+{
+  if (exporter->serving)
+  {
+    exporter->stopping = true;
+    pthread_join(exporter->thread, NULL);
+    close(exporter->listenFd);
+  }
+  while (NULL != exporter->readers)
+  {
+    TMR_metricsRemoveReader(exporter, exporter->readers->reader);
+  }
+  pthread_mutex_destroy(&exporter->lock);
+  free(exporter->body);
+  free(exporter);
+}
+
+#endif /* TMR_ENABLE_METRICS_EXPORTER */
@@ -0,0 +1,164 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_METRICS_H
+#define _TMR_METRICS_H
+/**
+ *  @file tmr_metrics.h
+ *  @brief Mercury API - OpenMetrics exporter
+ *
+ * Serves statistics for one or more readers in the OpenMetrics text
+ * format (what Prometheus scrapes) over a local HTTP socket:
+ *
+ *   tmr_tag_reads_total                 reads by reader and antenna
+ *   tmr_tag_rssi_dbm                    RSSI histogram by reader and antenna
+ *   tmr_reader_temperature_celsius      module statistics, when enabled
+ *   tmr_reader_frequency_hertz
+ *   tmr_antenna_rf_on_seconds
+ *   tmr_antenna_noise_floor_dbm
+ *   tmr_pipeline_*                      host pipeline statistics (see
+ *                                       TMR_PipelineStats)
+ *
+ * Reads are counted by a read listener with a few relaxed atomic
+ * increments, and module statistics are copied by a stats listener
+ * that skips a report rather than wait for a scrape in progress, so
+ * a scrape only ever formats snapshots and never holds up the read
+ * path.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_METRICS_EXPORTER
+
+/** Default port, the one registered for OpenTelemetry Prometheus exporters */
+#define TMR_METRICS_DEFAULT_PORT 9464
+
+/** Flags for TMR_metricsAddReader() */
+typedef enum TMR_MetricsReaderFlag
+{
+  /** Count reads and their RSSI */
+  TMR_METRICS_READS        = 0x01,
+  /**
+   * Export module statistics.  Registers a stats listener; the
+   * caller still chooses what the module reports with
+   * TMR_PARAM_READER_STATS_ENABLE.
+   */
+  TMR_METRICS_MODULE_STATS = 0x02,
+  /** Export the host pipeline statistics (TMR_PARAM_PIPELINE_STATS) */
+  TMR_METRICS_PIPELINE     = 0x04,
+  /** Everything */
+  TMR_METRICS_ALL          = 0x07,
+} TMR_MetricsReaderFlag;
+
+/**
+ * Exporter configuration, see TMR_metricsInitConfig().
+ **/
+typedef struct TMR_MetricsConfig
+{
+  /** IPv4 address to listen on (default 127.0.0.1) */
+  char address[32];
+  /**
+   * Port to listen on (default TMR_METRICS_DEFAULT_PORT).  0 starts
+   * no server, for embedding in an existing one with
+   * TMR_metricsFormat().
+   */
+  uint16_t port;
+} TMR_MetricsConfig;
+
+/** An exporter, see TMR_metricsStart() */
+typedef struct TMR_MetricsExporter TMR_MetricsExporter;
+
+/**
+ * Fill in the default exporter configuration.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_metricsInitConfig(TMR_MetricsConfig *config);
+
+/**
+ * Start an exporter and, unless the port is 0, its HTTP server
+ * thread, which answers GET /metrics.
+ *
+ * @param[out] exporter The new exporter
+ * @param config The configuration
+ * @return TMR_ERROR_COMM_ERRNO status if the socket can't be opened
+ **/
+TMR_Status TMR_metricsStart(TMR_MetricsExporter **exporter,
+                            const TMR_MetricsConfig *config);
+
+/**
+ * Export the statistics of a reader.  Add it after TMR_create(),
+ * before starting a read.
+ *
+ * @param exporter The exporter
+ * @param reader The reader
+ * @param name Value of the reader label, unique within the exporter
+ * @param flags TMR_MetricsReaderFlag values, ORed
+ * @return TMR_ERROR_INVALID if the reader is already exported
+ **/
+TMR_Status TMR_metricsAddReader(TMR_MetricsExporter *exporter,
+                                TMR_Reader *reader, const char *name,
+                                uint32_t flags);
+
+/**
+ * Stop exporting the statistics of a reader, and remove the
+ * listeners added for it.  Call it before TMR_destroy().
+ *
+ * @param exporter The exporter
+ * @param reader The reader
+ * @return TMR_ERROR_INVALID if the reader is not exported
+ **/
+TMR_Status TMR_metricsRemoveReader(TMR_MetricsExporter *exporter,
+                                   TMR_Reader *reader);
+
+/**
+ * Format the current statistics as an OpenMetrics text exposition,
+ * ending with "# EOF".
+ *
+ * @param exporter The exporter
+ * @param buffer Where to write, NUL terminated
+ * @param size Size of buffer
+ * @return The length of the whole exposition, which did not fit if
+ *         it is size or more (as with snprintf)
+ **/
+size_t TMR_metricsFormat(TMR_MetricsExporter *exporter, char *buffer, size_t size);
+
+/**
+ * Stop the HTTP server and free the exporter.  Readers still
+ * exported are removed first.
+ *
+ * @param exporter The exporter
+ **/
+void TMR_metricsStop(TMR_MetricsExporter *exporter);
+
+#endif /* TMR_ENABLE_METRICS_EXPORTER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_METRICS_H */
@@ -0,0 +1,423 @@
+/**
+ *  @file tmr_multi.c
+ *  @brief Mercury API - Synchronized multi-reader sessions
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_MULTI_READER
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "tm_reader.h"
+#include "tmr_multi.h"
+#include "tmr_atomic.h"
+#include "osdep.h"
+
+/**
+ * A waiting read: what of it is passed on, and its time on the
+ * shared base.  Each member's queue is a ring of these with one
+ * producer, the reader's listener, and one consumer, the merge.
+ **/
+typedef struct MultiRecord
+{
+  uint64_t timeUs;
+  TMR_TagData tag;
+  uint16_t metadataFlags;
+  uint16_t phase;
+  uint8_t antenna;
+  uint32_t readCount;
+  int32_t rssi;
+  uint32_t frequency;
+} MultiRecord;
+
+uint64_t
+TMR_multiNowUs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+/**
+ * Fit a line through the window minima: offset about their mean
+ * reader time, and slope as drift.
+ **/
+static void
+multi_fitClock(TMR_MultiMember *member)
+{
+  uint32_t n, i;
+  double meanTime, meanDelta, sxx, sxy, dt;
+
+  n = (TMR_MULTI_CLOCK_WINDOWS < member->windows) ? TMR_MULTI_CLOCK_WINDOWS : member->windows;
+  meanTime = 0;
+  meanDelta = 0;
+  for (i = 0; i < n; i++)
+  {
+    meanTime += (double)(member->windowTime[i] - member->windowTime[0]);
+    meanDelta += (double)member->windowDelta[i];
+  }
+  meanTime /= n;
+  meanDelta /= n;
+  sxx = 0;
+  sxy = 0;
+  for (i = 0; i < n; i++)
+  {
+    dt = (double)(member->windowTime[i] - member->windowTime[0]) - meanTime;
+    sxx += dt * dt;
+    sxy += dt * ((double)member->windowDelta[i] - meanDelta);
+  }
+  member->clockOrigin = member->windowTime[0] + (int64_t)meanTime;
+  member->offsetUs = meanDelta;
+  member->driftPpm = (0 < sxx) ? sxy / sxx * 1e6 : 0;
+}
+
+/**
+ * Take one pairing of reader and host time into the clock model.
+ **/
+static void
+multi_clock(TMR_MultiSession *session, TMR_MultiMember *member, int64_t readerUs,
+            uint64_t hostUs)
+{
+  int64_t delta;
+
+  delta = (int64_t)hostUs - readerUs;
+  if (0 == member->reads)
+  {
+    member->windowStart = readerUs;
+    member->minDelta = delta;
+    member->minTime = readerUs;
+    member->clockOrigin = readerUs;
+    member->offsetUs = (double)delta;
+    return;
+  }
+
+  if (readerUs - member->windowStart >= (int64_t)session->config.clockWindowUs)
+  {
+    member->windowTime[member->windows % TMR_MULTI_CLOCK_WINDOWS] = member->minTime;
+    member->windowDelta[member->windows % TMR_MULTI_CLOCK_WINDOWS] = member->minDelta;
+    member->windows++;
+    multi_fitClock(member);
+    member->windowStart = readerUs;
+    member->minDelta = delta;
+    member->minTime = readerUs;
+  }
+  else if (delta < member->minDelta)
+  {
+    member->minDelta = delta;
+    member->minTime = readerUs;
+    if (0 == member->windows)
+    {
+      /* Until a window closes the smallest difference so far is the offset */
+      member->clockOrigin = readerUs;
+      member->offsetUs = (double)delta;
+    }
+  }
+}
+
+void
+TMR_multiAddRead(TMR_MultiSession *session, uint8_t index, const TMR_TagReadData *read,
+                 uint64_t hostUs)
+{
+  TMR_MultiMember *member;
+  MultiRecord *record;
+  int64_t readerUs;
+  double timeUs;
+  uint32_t tail;
+
+  member = &session->members[index];
+  readerUs = (int64_t)((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) * 1000;
+  multi_clock(session, member, readerUs, hostUs);
+  member->reads++;
+  member->lastReadUs = hostUs;
+
+  tail = member->tail;
+  if (tail - TMR__LOAD_ACQUIRE(uint32_t, &member->head) >= session->config.queueSize)
+  {
+    member->dropped++;
+    return;
+  }
+  record = (MultiRecord *)member->queue + (tail & (session->config.queueSize - 1));
+  timeUs = (double)readerUs + member->offsetUs
+           + member->driftPpm * 1e-6 * (double)(readerUs - member->clockOrigin);
+  record->timeUs = (0 < timeUs) ? (uint64_t)timeUs : 0;
+  record->tag = read->tag;
+  record->metadataFlags = read->metadataFlags;
+  record->phase = read->phase;
+  record->antenna = read->antenna;
+  record->readCount = read->readCount;
+  record->rssi = read->rssi;
+  record->frequency = read->frequency;
+  TMR__STORE_RELEASE(uint32_t, &member->tail, tail + 1);
+}
+
+uint32_t
+TMR_multiFlush(TMR_MultiSession *session, uint64_t nowUs)
+{
+  TMR_TagReadData trd;
+  TMR_MultiMember *member;
+  const MultiRecord *record, *best;
+  uint32_t delivered, head;
+  uint8_t i, bestIndex;
+  bool everyReader;
+
+  delivered = 0;
+  pthread_mutex_lock(&session->mergeLock);
+  for (;;)
+  {
+    /* Few readers, so the earliest head is found by looking at each */
+    best = NULL;
+    bestIndex = 0;
+    everyReader = true;
+    for (i = 0; i < session->count; i++)
+    {
+      member = &session->members[i];
+      head = member->head;
+      if (head == TMR__LOAD_ACQUIRE(uint32_t, &member->tail))
+      {
+        everyReader = false;
+        continue;
+      }
+      record = (const MultiRecord *)member->queue + (head & (session->config.queueSize - 1));
+      if ((NULL == best) || (record->timeUs < best->timeUs))
+      {
+        best = record;
+        bestIndex = i;
+      }
+    }
+    if ((NULL == best)
+        || ((false == everyReader) && (UINT64_MAX != nowUs)
+            && (best->timeUs + session->config.reorderDelayUs > nowUs)))
+    {
+      break;
+    }
+
+    member = &session->members[bestIndex];
+    TMR_TRD_init(&trd);
+    trd.tag = best->tag;
+    trd.metadataFlags = best->metadataFlags;
+    trd.phase = best->phase;
+    trd.antenna = (uint8_t)(bestIndex * session->config.antennaStride + best->antenna);
+    trd.readCount = best->readCount;
+    trd.rssi = best->rssi;
+    trd.frequency = best->frequency;
+    trd.timestampHigh = (uint32_t)((best->timeUs / 1000) >> 32);
+    trd.timestampLow = (uint32_t)(best->timeUs / 1000);
+    trd.reader = member->reader;
+    if (best->timeUs < session->lastUs)
+    {
+      session->late++;
+    }
+    else
+    {
+      session->lastUs = best->timeUs;
+    }
+    session->merged++;
+    delivered++;
+    session->listener(session, bestIndex, &trd, best->timeUs, session->cookie);
+    TMR__STORE_RELEASE(uint32_t, &member->head, member->head + 1);
+  }
+  pthread_mutex_unlock(&session->mergeLock);
+  return delivered;
+}
+
+static void
+multi_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_MultiMember *member;
+
+  member = cookie;
+  TMR_multiAddRead(member->session, (uint8_t)(member - member->session->members), t,
+                   TMR_multiNowUs());
+}
+
+static void
+multi_exceptionListener(TMR_Reader *reader, TMR_Status error, void *cookie)
+{
+  TMR_MultiMember *member;
+
+  member = cookie;
+  member->exceptions++;
+  member->lastError = error;
+}
+
+static void *
+multi_mergeThread(void *arg)
+{
+  TMR_MultiSession *session;
+
+  session = arg;
+  while (TMR__LOAD_ACQUIRE(bool, &session->merging))
+  {
+    TMR_multiFlush(session, TMR_multiNowUs());
+    tmr_sleep(1);
+  }
+  return NULL;
+}
+
+void
+TMR_multiInitConfig(TMR_MultiConfig *config)
+{
+  config->reorderDelayUs = 50000;
+  config->queueSize = 1024;
+  config->antennaStride = 4;
+  config->clockWindowUs = 1000000;
+}
+
+/** Undo TMR_multiStart() for the first count readers */
+static void
+multi_release(TMR_MultiSession *session, uint8_t started)
+{
+  TMR_MultiMember *member;
+  uint8_t i;
+
+  for (i = 0; i < session->count; i++)
+  {
+    member = &session->members[i];
+    if (i < started)
+    {
+      TMR_stopReading(member->reader);
+    }
+  }
+  if (TMR__LOAD_ACQUIRE(bool, &session->merging))
+  {
+    TMR__STORE_RELEASE(bool, &session->merging, false);
+    pthread_join(session->mergeThread, NULL);
+  }
+  TMR_multiFlush(session, UINT64_MAX);
+  for (i = 0; i < session->count; i++)
+  {
+    member = &session->members[i];
+    if (NULL != member->reader)
+    {
+      TMR_removeReadListener(member->reader, &member->readListener);
+      TMR_removeReadExceptionListener(member->reader, &member->exceptionListener);
+    }
+    free(member->queue);
+    member->queue = NULL;
+  }
+  pthread_mutex_destroy(&session->mergeLock);
+}
+
+TMR_Status
+TMR_multiStart(TMR_MultiSession *session, TMR_Reader **readers, uint8_t count,
+               const TMR_MultiConfig *config, TMR_MultiListener listener, void *cookie)
+{
+  TMR_MultiMember *member;
+  TMR_Status ret;
+  uint8_t i;
+
+  if ((NULL == listener) || (0 == count) || (TMR_MULTI_MAX_READERS < count)
+      || (2 > config->queueSize) || (0 != (config->queueSize & (config->queueSize - 1)))
+      || (0 == config->clockWindowUs) || (255 < (uint32_t)count * config->antennaStride))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(session, 0, sizeof(*session));
+  session->config = *config;
+  session->listener = listener;
+  session->cookie = cookie;
+  session->count = count;
+  pthread_mutex_init(&session->mergeLock, NULL);
+  for (i = 0; i < count; i++)
+  {
+    member = &session->members[i];
+    member->session = session;
+    member->reader = (NULL != readers) ? readers[i] : NULL;
+    member->queue = calloc(config->queueSize, sizeof(MultiRecord));
+    if (NULL == member->queue)
+    {
+      multi_release(session, 0);
+      return TMR_ERROR_OUT_OF_MEMORY;
+    }
+  }
+  if (NULL == readers)
+  {
+    return TMR_SUCCESS;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    member = &session->members[i];
+    member->readListener.listener = multi_readListener;
+    member->readListener.cookie = member;
+    member->exceptionListener.listener = multi_exceptionListener;
+    member->exceptionListener.cookie = member;
+    ret = TMR_addReadListener(member->reader, &member->readListener);
+    if (TMR_SUCCESS == ret)
+    {
+      ret = TMR_addReadExceptionListener(member->reader, &member->exceptionListener);
+    }
+    if (TMR_SUCCESS != ret)
+    {
+      multi_release(session, 0);
+      return ret;
+    }
+  }
+
+  TMR__STORE_RELEASE(bool, &session->merging, true);
+  if (0 != pthread_create(&session->mergeThread, NULL, multi_mergeThread, session))
+  {
+    session->merging = false;
+    multi_release(session, 0);
+    return TMR_ERROR_NO_THREADS;
+  }
+
+  /* Back to back, so the readers start as close together as the host allows */
+  for (i = 0; i < count; i++)
+  {
+    ret = TMR_startReading(session->members[i].reader);
+    if (TMR_SUCCESS != ret)
+    {
+      multi_release(session, i);
+      return ret;
+    }
+  }
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_multiStop(TMR_MultiSession *session)
+{
+  TMR_Status ret, first;
+  uint8_t i;
+
+  first = TMR_SUCCESS;
+  for (i = 0; i < session->count; i++)
+  {
+    if (NULL != session->members[i].reader)
+    {
+      ret = TMR_stopReading(session->members[i].reader);
+      first = (TMR_SUCCESS == first) ? ret : first;
+    }
+  }
+  multi_release(session, 0);
+  return first;
+}
+
+#endif /* TMR_ENABLE_MULTI_READER */
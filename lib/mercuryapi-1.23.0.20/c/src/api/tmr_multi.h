@@ -0,0 +1,248 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_MULTI_H
+#define _TMR_MULTI_H
+/**
+ *  @file tmr_multi.h
+ *  @brief Mercury API - Synchronized multi-reader sessions
+ *
+ * A session reads with several readers at once and hands their reads
+ * to one listener as a single stream, in order of time on a shared
+ * time base, so reads of a tag from more antennas than one module
+ * has ports can be fused.
+ *
+ * Each reader stamps its reads with its own clock.  The session pairs
+ * every read's timestamp with the host's monotonic clock when the read
+ * arrives; the smallest difference seen in each window of
+ * clockWindowUs is the one least delayed on the way, and a line
+ * through the last TMR_MULTI_CLOCK_WINDOWS of those minima gives the
+ * reader's clock offset and drift.  Reads are put on the host clock
+ * with them as they arrive.
+ *
+ * The readers' streams are merged k ways: the earliest read waiting
+ * from any reader goes next once every reader has a read waiting,
+ * since none can then be earlier, or once it has waited
+ * reorderDelayUs, so an idle reader holds the stream up by no more
+ * than that.  A read that arrives later still, behind one already
+ * passed on, is passed on anyway and counted as late.
+ *
+ * Reads are carried as their tag and metadata; embedded tag operation
+ * data and GPIO state are not.  Each read's timestamp is replaced
+ * with its time on the shared base, in milliseconds, and its antenna
+ * with index * antennaStride + antenna, so the merged stream can go
+ * straight to TMR_pdoaAddRead() or TMR_locateAddRead().
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_MULTI_READER
+
+struct TMR_MultiSession;
+
+/**
+ * Session configuration, see TMR_multiInitConfig().
+ **/
+typedef struct TMR_MultiConfig
+{
+  /** Longest a read waits for earlier reads from other readers (default 50 ms) */
+  uint32_t reorderDelayUs;
+  /**
+   * Reads each reader can have waiting, a power of two (default
+   * 1024); when its queue is full a reader's newest read is dropped
+   */
+  uint32_t queueSize;
+  /** Antenna numbers of reader index i start at i * antennaStride (default 4) */
+  uint8_t antennaStride;
+  /** Window each clock minimum is taken over (default 1 s) */
+  uint32_t clockWindowUs;
+} TMR_MultiConfig;
+
+/**
+ * One reader of a session and what is known of it.  The counters and
+ * the clock are written by the thread that delivers the reader's
+ * reads; read them as a snapshot.
+ **/
+typedef struct TMR_MultiMember
+{
+  /** @private */
+  struct TMR_MultiSession *session;
+  /** The reader, or NULL in a session fed by TMR_multiAddRead() */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_ReadExceptionListenerBlock exceptionListener;
+  /** @private Waiting reads */
+  uint8_t *queue;
+  /** @private */
+  uint32_t head;
+  /** @private */
+  uint32_t tail;
+  /** @private Window minima of host minus reader time: reader time, difference */
+  int64_t windowTime[TMR_MULTI_CLOCK_WINDOWS];
+  /** @private */
+  int64_t windowDelta[TMR_MULTI_CLOCK_WINDOWS];
+  /** @private Windows filled, then the next to replace */
+  uint32_t windows;
+  /** @private Reader time the current window started */
+  int64_t windowStart;
+  /** @private Smallest difference in the current window, and its reader time */
+  int64_t minDelta;
+  /** @private */
+  int64_t minTime;
+  /** @private Reader time the clock is fitted about */
+  int64_t clockOrigin;
+  /** Reads taken in */
+  uint64_t reads;
+  /** Reads dropped because the queue was full */
+  uint64_t dropped;
+  /** Read exceptions the reader reported */
+  uint64_t exceptions;
+  /** The last of them */
+  TMR_Status lastError;
+  /** Host time of the last read, microseconds, 0 before the first */
+  uint64_t lastReadUs;
+  /** Host clock minus reader clock at clockOrigin, microseconds */
+  double offsetUs;
+  /** How much faster the host clock runs than the reader's, parts per million */
+  double driftPpm;
+} TMR_MultiMember;
+
+/**
+ * Called with each read of the merged stream, from the session's
+ * merge thread or from TMR_multiFlush().
+ *
+ * @param session The session
+ * @param index Index of the reader that read it
+ * @param read The read, with the shared timestamp and antenna numbering
+ * @param timeUs Its time on the shared base, host monotonic microseconds
+ * @param cookie The cookie given to TMR_multiStart()
+ **/
+typedef void (*TMR_MultiListener)(struct TMR_MultiSession *session, uint8_t index,
+                                  const TMR_TagReadData *read, uint64_t timeUs,
+                                  void *cookie);
+
+/**
+ * A multi-reader session, see TMR_multiStart().
+ **/
+typedef struct TMR_MultiSession
+{
+  /** @private */
+  TMR_MultiConfig config;
+  /** @private */
+  TMR_MultiListener listener;
+  /** @private */
+  void *cookie;
+  /** Readers in the session */
+  uint8_t count;
+  /** The readers, by index */
+  TMR_MultiMember members[TMR_MULTI_MAX_READERS];
+  /** @private */
+  pthread_t mergeThread;
+  /** @private */
+  bool merging;
+  /** @private Serializes merging between the thread and TMR_multiFlush() */
+  pthread_mutex_t mergeLock;
+  /** @private Time of the last read passed on */
+  uint64_t lastUs;
+  /** Reads passed on */
+  uint64_t merged;
+  /** Reads passed on behind a later one */
+  uint64_t late;
+} TMR_MultiSession;
+
+/**
+ * Fill in the default configuration.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_multiInitConfig(TMR_MultiConfig *config);
+
+/**
+ * Start a session: add a listener to each reader, start a thread to
+ * merge their reads and start them all reading.  The readers must be
+ * connected, with their read plans set.  With readers NULL nothing is
+ * started: feed the session with TMR_multiAddRead() and merge with
+ * TMR_multiFlush().
+ *
+ * @param session Session state, owned by the caller until it is stopped
+ * @param readers The readers, or NULL
+ * @param count Number of readers, at most TMR_MULTI_MAX_READERS
+ * @param config The configuration
+ * @param listener Called with each read of the merged stream
+ * @param cookie Passed to listener
+ * @return TMR_ERROR_INVALID for a bad configuration, or the error of
+ *         the reader that failed to start, with none left reading
+ **/
+TMR_Status TMR_multiStart(TMR_MultiSession *session, TMR_Reader **readers, uint8_t count,
+                          const TMR_MultiConfig *config, TMR_MultiListener listener,
+                          void *cookie);
+
+/**
+ * Take in a read of one of the session's readers, as its read
+ * listener does.  Call it from one thread per reader.
+ *
+ * @param session The session
+ * @param index Index of the reader
+ * @param read The read, timestamped by the reader
+ * @param hostUs Host monotonic time the read arrived, microseconds
+ **/
+void TMR_multiAddRead(TMR_MultiSession *session, uint8_t index, const TMR_TagReadData *read,
+                      uint64_t hostUs);
+
+/**
+ * Pass on the reads that are due by a time: those every reader has
+ * caught up with and those older than the reorder delay.
+ *
+ * @param session The session
+ * @param nowUs Host monotonic time, microseconds; UINT64_MAX for all
+ * @return Reads passed on
+ **/
+uint32_t TMR_multiFlush(TMR_MultiSession *session, uint64_t nowUs);
+
+/**
+ * Stop the readers, pass on every read still waiting and remove the
+ * listeners.
+ *
+ * @param session The session
+ * @return The first error stopping a reader
+ **/
+TMR_Status TMR_multiStop(TMR_MultiSession *session);
+
+/**
+ * Host monotonic time, microseconds: the shared time base.
+ **/
+uint64_t TMR_multiNowUs(void);
+
+#endif /* TMR_ENABLE_MULTI_READER */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_MULTI_H */
@@ -114,6 +114,16 @@ static const char *paramNames[1 + TMR_PARAM_MAX] = {
 	"/reader/gen2/writeReplyTimeout", /* TMR_PARAM_READER_WRITE_REPLY_TIMEOUT */
 	"/reader/gen2/writeEarlyExit", /* /reader/gen2/writeEarlyExit */
   "reader/stats/enable", /* /reader/stats/enable */
+  "/reader/llrp/keepAlivePeriod", /* TMR_PARAM_LLRP_KEEPALIVE_PERIOD */
+  "/reader/llrp/keepAliveMissCount", /* TMR_PARAM_LLRP_KEEPALIVE_MISSCOUNT */
+  "/reader/llrp/autoReconnect", /* TMR_PARAM_LLRP_AUTORECONNECT */
+  "/reader/llrp/reconnectTimeout", /* TMR_PARAM_LLRP_RECONNECT_TIMEOUT */
+  "/reader/llrp/connectionStats", /* TMR_PARAM_LLRP_CONNECTION_STATS */
+  "/reader/llrp/memPoolStats", /* TMR_PARAM_LLRP_MEMPOOL_STATS */
+  "/reader/tagReadData/dedupPolicy", /* TMR_PARAM_TAGREADDATA_DEDUPPOLICY */
+  "/reader/pipeline/stats", /* TMR_PARAM_PIPELINE_STATS */
+  "/reader/pipeline/statsPeriod", /* TMR_PARAM_PIPELINE_STATS_PERIOD */
+  "/reader/serial/autoResume", /* TMR_PARAM_SERIAL_AUTORESUME */
 };
 
 
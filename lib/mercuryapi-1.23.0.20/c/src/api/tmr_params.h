@@ -201,6 +201,26 @@ typedef enum TMR_Param
 	TMR_PARAM_READER_WRITE_EARLY_EXIT,
   /** "reader/stats/enable", TMR_StatsEnable */
   TMR_PARAM_READER_STATS_ENABLE,
+  /** "/reader/llrp/keepAlivePeriod", uint32_t */
+  TMR_PARAM_LLRP_KEEPALIVE_PERIOD,
+  /** "/reader/llrp/keepAliveMissCount", uint32_t */
+  TMR_PARAM_LLRP_KEEPALIVE_MISSCOUNT,
+  /** "/reader/llrp/autoReconnect", bool */
+  TMR_PARAM_LLRP_AUTORECONNECT,
+  /** "/reader/llrp/reconnectTimeout", uint32_t */
+  TMR_PARAM_LLRP_RECONNECT_TIMEOUT,
+  /** "/reader/llrp/connectionStats", TMR_LLRP_ConnectionStats */
+  TMR_PARAM_LLRP_CONNECTION_STATS,
+  /** "/reader/llrp/memPoolStats", TMR_LLRP_MemPoolStats */
+  TMR_PARAM_LLRP_MEMPOOL_STATS,
+  /** "/reader/tagReadData/dedupPolicy", TMR_DedupPolicy */
+  TMR_PARAM_TAGREADDATA_DEDUPPOLICY,
+  /** "/reader/pipeline/stats", TMR_PipelineStats */
+  TMR_PARAM_PIPELINE_STATS,
+  /** "/reader/pipeline/statsPeriod", uint32_t */
+  TMR_PARAM_PIPELINE_STATS_PERIOD,
+  /** "/reader/serial/autoResume", bool */
+  TMR_PARAM_SERIAL_AUTORESUME,
   TMR_PARAM_END,
   TMR_PARAM_MAX = TMR_PARAM_END-1,
 
@@ -0,0 +1,286 @@
+/**
+ *  @file tmr_pdoa.c
+ *  @brief Mercury API - Streaming phase difference engine
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_PDOA
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_pdoa.h"
+#include "tmr_phase.h"
+#include "tmr_tag_table.h"
+
+#define PDOA_PI     3.14159265358979323846
+/* A combination is told apart in the tag table by antenna and frequency */
+#define PDOA_EXTRA(antenna, frequency) (((uint32_t)(antenna) << 24) | ((frequency) & 0xffffff))
+
+/** A read kept in a ring */
+typedef struct PdoaSample
+{
+  uint64_t timeUs;
+  uint16_t phase;
+  int16_t rssi;
+} PdoaSample;
+
+/**
+ * One tag, antenna and frequency.  Each slot of the table is this
+ * header followed by history samples, the newest at head - 1.
+ **/
+typedef struct PdoaSlot
+{
+  TMR_TagTableEntry entry;
+  uint8_t count;
+  uint8_t head;
+} PdoaSlot;
+
+static PdoaSample *
+pdoa_sample(PdoaSlot *slot, uint32_t history, uint32_t age)
+{
+  return (PdoaSample *)(slot + 1) + ((slot->head + history - 1 - age) % history);
+}
+
+/**
+ * Find the slot of a tag on an antenna and frequency.  With insert,
+ * take an empty slot or the one read longest ago if it isn't there.
+ **/
+static PdoaSlot *
+pdoa_find(TMR_PdoaEngine *engine, const TMR_TagData *tag, uint8_t antenna,
+          uint32_t frequency, bool insert)
+{
+  PdoaSlot *slot;
+  bool found;
+
+  slot = (PdoaSlot *)TMR_tagTableFind(&engine->table, tag, PDOA_EXTRA(antenna, frequency),
+                                      insert, &found);
+  if (found || (NULL == slot))
+  {
+    return slot;
+  }
+  if (0 != slot->entry.key)
+  {
+    engine->evictions++;
+  }
+  TMR_tagTableClaim(&engine->table, &slot->entry, tag, PDOA_EXTRA(antenna, frequency));
+  return slot;
+}
+
+void
+TMR_pdoaAddRead(TMR_PdoaEngine *engine, const TMR_TagReadData *read)
+{
+  TMR_PdoaConfig *config;
+  TMR_PdoaResult result;
+  PdoaSlot *self, *other;
+  PdoaSample *sample, *s0, *s1;
+  uint64_t now;
+  uint32_t pairs, skew, dt;
+  uint8_t b;
+  double phaseB, diff;
+
+  config = &engine->config;
+  if ((0 == (read->metadataFlags & TMR_TRD_METADATA_FLAG_PHASE))
+      || (0 == read->antenna) || (TMR_PDOA_MAX_ANTENNAS < read->antenna)
+      || (0 == engine->pairs[read->antenna]))
+  {
+    engine->skipped++;
+    return;
+  }
+  engine->reads++;
+  now = TMR_readClockTime(&engine->clock, engine->config.moduleTime, read);
+
+  self = pdoa_find(engine, &read->tag, read->antenna, read->frequency, true);
+  sample = (PdoaSample *)(self + 1) + self->head;
+  sample->timeUs = now;
+  sample->phase = read->phase;
+  sample->rssi = (int16_t)read->rssi;
+  self->head = (uint8_t)((self->head + 1) % config->history);
+  self->count = (self->count < config->history) ? self->count + 1 : self->count;
+  self->entry.lastUs = now;
+
+  pairs = engine->pairs[read->antenna];
+  for (b = 1; 0 != pairs; b++, pairs >>= 1)
+  {
+    if (0 == (pairs & 1))
+    {
+      continue;
+    }
+    other = pdoa_find(engine, &read->tag, b, read->frequency, false);
+    if ((NULL == other) || (0 == other->count))
+    {
+      continue;
+    }
+    s1 = pdoa_sample(other, config->history, 0);
+    skew = (uint32_t)((now > s1->timeUs) ? now - s1->timeUs : s1->timeUs - now);
+    if (skew > config->maxSkewUs)
+    {
+      continue;
+    }
+
+    /**
+     * Carry the other antenna's phase forward to this read at the
+     * rate its last two reads show, if they are no closer together
+     * than the gap to this read: a shorter baseline would mostly
+     * scale up phase noise.
+     **/
+    phaseB = s1->phase;
+    result.aligned = false;
+    if ((2 <= other->count) && (0 < skew) && (now > s1->timeUs))
+    {
+      s0 = pdoa_sample(other, config->history, 1);
+      dt = (uint32_t)(s1->timeUs - s0->timeUs);
+      if ((s1->timeUs > s0->timeUs) && (dt >= skew) && (dt <= config->maxSkewUs))
+      {
+        phaseB += TMR_phaseWrap((double)s1->phase - s0->phase, config->phaseTurn) * skew / dt;
+        result.aligned = true;
+      }
+    }
+
+    diff = TMR_phaseWrap((double)read->phase - phaseB, config->phaseTurn);
+    result.tag = &read->tag;
+    result.frequency = read->frequency;
+    result.skewUs = skew;
+    result.timeUs = now;
+    if (read->antenna < b)
+    {
+      result.antennaA = read->antenna;
+      result.antennaB = b;
+      result.rssiA = read->rssi;
+      result.rssiB = s1->rssi;
+    }
+    else
+    {
+      diff = -diff;
+      result.antennaA = b;
+      result.antennaB = read->antenna;
+      result.rssiA = s1->rssi;
+      result.rssiB = read->rssi;
+    }
+    result.phaseDiff = diff * PDOA_PI / 180.0;
+    engine->results++;
+    engine->listener(engine->reader, &result, engine->cookie);
+  }
+}
+
+static void
+pdoa_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_pdoaAddRead(cookie, t);
+}
+
+void
+TMR_pdoaInitConfig(TMR_PdoaConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->antennaCount = 0;
+  config->phaseTurn = 180;
+  config->maxSkewUs = 100000;
+  config->history = 4;
+  config->slots = 4096;
+  config->moduleTime = false;
+}
+
+TMR_Status
+TMR_pdoaStart(TMR_Reader *reader, TMR_PdoaEngine *engine,
+              const TMR_PdoaConfig *config,
+              TMR_PdoaListener listener, void *cookie)
+{
+  TMR_Status ret;
+  uint8_t i, j, a, b;
+
+  if ((NULL == listener) || (0 == config->phaseTurn)
+      || (2 > config->history) || (255 < config->history)
+      || (TMR_PDOA_MAX_ANTENNAS < config->antennaCount))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->config = *config;
+  engine->reader = reader;
+  engine->listener = listener;
+  engine->cookie = cookie;
+
+  for (a = 1; a <= TMR_PDOA_MAX_ANTENNAS; a++)
+  {
+    if (0 == config->antennaCount)
+    {
+      engine->pairs[a] = ((1U << TMR_PDOA_MAX_ANTENNAS) - 1) & ~(1U << (a - 1));
+    }
+  }
+  for (i = 0; i < config->antennaCount; i++)
+  {
+    a = config->antennas[i];
+    if ((0 == a) || (TMR_PDOA_MAX_ANTENNAS < a))
+    {
+      return TMR_ERROR_INVALID;
+    }
+    for (j = 0; j < config->antennaCount; j++)
+    {
+      b = config->antennas[j];
+      if ((0 != b) && (TMR_PDOA_MAX_ANTENNAS >= b) && (a != b))
+      {
+        engine->pairs[a] |= 1U << (b - 1);
+      }
+    }
+  }
+
+  ret = TMR_tagTableInit(&engine->table, config->slots,
+                         (uint32_t)((sizeof(PdoaSlot) + config->history * sizeof(PdoaSample) + 7)
+                                    & ~(size_t)7));
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
+  if (NULL != reader)
+  {
+    engine->readListener.listener = pdoa_readListener;
+    engine->readListener.cookie = engine;
+    ret = TMR_addReadListener(reader, &engine->readListener);
+    if (TMR_SUCCESS != ret)
+    {
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_pdoaStop(TMR_PdoaEngine *engine)
+{
+  if (NULL != engine->reader)
+  {
+    TMR_removeReadListener(engine->reader, &engine->readListener);
+    engine->reader = NULL;
+  }
+  TMR_tagTableDestroy(&engine->table);
+}
+
+#endif /* TMR_ENABLE_PDOA */
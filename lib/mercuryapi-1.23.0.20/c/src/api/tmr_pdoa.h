@@ -0,0 +1,205 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_PDOA_H
+#define _TMR_PDOA_H
+/**
+ *  @file tmr_pdoa.h
+ *  @brief Mercury API - Streaming phase difference engine
+ *
+ * Phase difference of arrival (PDoA) as the reads come in.  The
+ * engine is a read listener: for each tag, antenna and carrier
+ * frequency it keeps the last few reads (phase, RSSI, time) in a
+ * ring, and for every read with phase it looks up the same tag on
+ * the other antennas at the same frequency.  When one was read
+ * recently enough it reports the difference of the two phases,
+ * wrapped, with the other antenna's phase carried forward to the time
+ * of this read when its ring shows how the phase is moving.
+ *
+ * Phases on different carriers can't be compared, which is why
+ * everything is kept per frequency.  The tables are sized when the
+ * engine starts and nothing is allocated per read.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_tag_table.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_PDOA
+
+/**
+ * Engine configuration, see TMR_pdoaInitConfig().
+ **/
+typedef struct TMR_PdoaConfig
+{
+  /**
+   * Antennas to pair, each with each other; none (antennaCount 0,
+   * the default) pairs every antenna up to TMR_PDOA_MAX_ANTENNAS.
+   */
+  uint8_t antennas[TMR_PDOA_MAX_ANTENNAS];
+  /** Number of entries in antennas */
+  uint8_t antennaCount;
+  /**
+   * Phase values wrap at this many degrees (default 180, the range
+   * of the M6e phase metadata)
+   */
+  uint16_t phaseTurn;
+  /** Longest time between the reads of a pair (default 100 ms) */
+  uint32_t maxSkewUs;
+  /** Reads kept per tag, antenna and frequency, 2 to 255 (default 4) */
+  uint32_t history;
+  /**
+   * Tag, antenna and frequency combinations tracked, a power of two
+   * (default 4096).  When the table is full the combination read
+   * longest ago is forgotten.
+   */
+  uint32_t slots;
+  /**
+   * Time the reads with the module's dspMicros rather than the host
+   * read time, which has millisecond resolution.  Needs the
+   * timestamp metadata.
+   */
+  bool moduleTime;
+} TMR_PdoaConfig;
+
+/**
+ * One phase difference.  Passed to the listener, valid during the
+ * call.
+ **/
+typedef struct TMR_PdoaResult
+{
+  /** The tag */
+  const TMR_TagData *tag;
+  /** The lower numbered antenna of the pair */
+  uint8_t antennaA;
+  /** The higher numbered antenna */
+  uint8_t antennaB;
+  /** Carrier frequency of both reads, kHz */
+  uint32_t frequency;
+  /**
+   * Phase on antennaA less phase on antennaB, in radians, wrapped to
+   * half a phase turn either way
+   */
+  double phaseDiff;
+  /** Time between the two reads */
+  uint32_t skewUs;
+  /** True if the earlier read's phase was carried forward to the later one's time */
+  bool aligned;
+  /** RSSI of the read on antennaA, dBm */
+  int32_t rssiA;
+  /** RSSI of the read on antennaB, dBm */
+  int32_t rssiB;
+  /** Time of the later read, microseconds, host or module clock */
+  uint64_t timeUs;
+} TMR_PdoaResult;
+
+/**
+ * Called with each phase difference, from the thread that delivers
+ * the reads.
+ **/
+typedef void (*TMR_PdoaListener)(TMR_Reader *reader, const TMR_PdoaResult *result,
+                                 void *cookie);
+
+/**
+ * A phase difference engine, see TMR_pdoaStart().
+ **/
+typedef struct TMR_PdoaEngine
+{
+  /** @private */
+  TMR_PdoaConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_PdoaListener listener;
+  /** @private */
+  void *cookie;
+  /** @private Pairs of each antenna, bit n - 1 for antenna n */
+  uint32_t pairs[TMR_PDOA_MAX_ANTENNAS + 1];
+  /** @private */
+  TMR_TagTable table;
+  /** @private */
+  TMR_ReadClock clock;
+  /** Reads with phase taken in */
+  uint64_t reads;
+  /** Reads without phase metadata, or on an antenna that isn't paired */
+  uint64_t skipped;
+  /** Phase differences reported */
+  uint64_t results;
+  /** Tracked combinations forgotten to make room */
+  uint64_t evictions;
+} TMR_PdoaEngine;
+
+/**
+ * Fill in the default configuration: all antennas, 180 degree phase,
+ * 100 ms skew, 4 reads of history, 4096 slots, host time.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_pdoaInitConfig(TMR_PdoaConfig *config);
+
+/**
+ * Start an engine and, given a reader, add it as a read listener.
+ * Reads without phase metadata or an antenna number are skipped;
+ * continuous reads from an M6e carry both, and the frequency.
+ *
+ * @param reader The reader, or NULL to feed the engine with
+ *               TMR_pdoaAddRead() only
+ * @param engine Engine state, owned by the caller until it is stopped
+ * @param config The configuration
+ * @param listener Called with each phase difference
+ * @param cookie Passed to listener
+ * @return TMR_ERROR_INVALID for a bad configuration
+ **/
+TMR_Status TMR_pdoaStart(TMR_Reader *reader, TMR_PdoaEngine *engine,
+                         const TMR_PdoaConfig *config,
+                         TMR_PdoaListener listener, void *cookie);
+
+/**
+ * Take in one read, as the read listener does.  For reads from a
+ * sync read or a file; don't call it for an engine added to a reader
+ * that is reading in the background.
+ *
+ * @param engine The engine
+ * @param read The read
+ **/
+void TMR_pdoaAddRead(TMR_PdoaEngine *engine, const TMR_TagReadData *read);
+
+/**
+ * Remove the engine's read listener and free its tables.
+ *
+ * @param engine The engine
+ **/
+void TMR_pdoaStop(TMR_PdoaEngine *engine);
+
+#endif /* TMR_ENABLE_PDOA */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_PDOA_H */
@@ -0,0 +1,896 @@
+/**
+ *  @file tmr_phase.c
+ *  @brief Mercury API - Batch phase statistics
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_phase.h"
+
+double
+TMR_phaseWrap(double diff, double turn)
+{
+  diff -= turn * (double)(int64_t)(diff / turn);
+  if (diff > turn / 2)
+  {
+    diff -= turn;
+  }
+  else if (diff <= -turn / 2)
+  {
+    diff += turn;
+  }
+  return diff;
+}
+
+#ifdef TMR_ENABLE_PHASE_STATS
+
+#if defined(TMR_ENABLE_PHASE_SIMD) && defined(__GNUC__) \
+  && (defined(__x86_64__) || defined(__i386__))
+#define PHASE_X86
+#include <immintrin.h>
+#endif
+
+#define PHASE_PI    3.14159265358979323846
+/* 10^0.1, the power ratio of one dB */
+#define PHASE_DB    1.2589254117941673
+/* Phases masked at a time by TMR_phaseRejectOutliers() without a keep array */
+#define PHASE_CHUNK 512
+
+/** Weighted sums of the unit vectors of some phases */
+typedef struct PhaseSums
+{
+  double c;
+  double s;
+  double w;
+  uint32_t count;
+} PhaseSums;
+
+/**
+ * Sine and cosine of -pi to pi by their series, to build the tables
+ * without libm
+ **/
+static void
+phase_sincos(double x, double *s, double *c)
+{
+  double term;
+  int n;
+
+  *s = 0;
+  *c = 0;
+  term = 1;
+  for (n = 0; n < 40; n++)
+  {
+    /* x^n / n!, added with the signs + + - - in turn */
+    if (0 == (n & 1))
+    {
+      *c += (0 == (n & 2)) ? term : -term;
+    }
+    else
+    {
+      *s += (0 == (n & 2)) ? term : -term;
+    }
+    term = term * x / (n + 1);
+  }
+}
+
+#ifdef PHASE_X86
+__attribute__((target("sse2")))
+static double
+phase_sqrt(double x)
+{
+  return (0 >= x) ? 0 : _mm_cvtsd_f64(_mm_sqrt_sd(_mm_setzero_pd(), _mm_set_sd(x)));
+}
+#else
+/**
+ * Square root by Newton's method from half the exponent, which is
+ * within a factor of two, so six steps reach full precision
+ **/
+static double
+phase_sqrt(double x)
+{
+  uint64_t bits;
+  double r;
+  int i;
+
+  if (0 >= x)
+  {
+    return 0;
+  }
+  memcpy(&bits, &x, sizeof(bits));
+  bits = ((bits >> 1) + (0x3FFULL << 51)) & 0x7FF0000000000000ULL;
+  memcpy(&r, &bits, sizeof(r));
+  r = (0 == r) ? x : r;
+  for (i = 0; i < 6; i++)
+  {
+    r = (r + x / r) / 2;
+  }
+  return r;
+}
+#endif
+
+/**
+ * Arc tangent: fold x to 0 to tan(pi / 16) with the tangent addition
+ * formula, where ten terms of the series are good to 1e-15
+ **/
+static double
+phase_atan(double x)
+{
+  double base, x2;
+  bool negative, invert;
+
+  negative = (0 > x);
+  x = negative ? -x : x;
+  invert = (1 < x);
+  x = invert ? 1 / x : x;
+  base = 0;
+  if (0.41421356237309503 < x)
+  {
+    base = PHASE_PI / 4;
+    x = (x - 1) / (x + 1);
+  }
+  if (0.19891236737965800 < x)
+  {
+    base += PHASE_PI / 8;
+    x = (x - 0.41421356237309503) / (1 + x * 0.41421356237309503);
+  }
+  else if (-0.19891236737965800 > x)
+  {
+    base -= PHASE_PI / 8;
+    x = (x + 0.41421356237309503) / (1 - x * 0.41421356237309503);
+  }
+  x2 = x * x;
+  x = base + x * (1 - x2 * (1.0 / 3 - x2 * (1.0 / 5 - x2 * (1.0 / 7 - x2 * (1.0 / 9
+        - x2 * (1.0 / 11 - x2 * (1.0 / 13 - x2 * (1.0 / 15 - x2 * (1.0 / 17
+        - x2 / 19)))))))));
+  x = invert ? PHASE_PI / 2 - x : x;
+  return negative ? -x : x;
+}
+
+static double
+phase_atan2(double y, double x)
+{
+  if (0 < x)
+  {
+    return phase_atan(y / x);
+  }
+  if (0 > x)
+  {
+    return phase_atan(y / x) + ((0 > y) ? -PHASE_PI : PHASE_PI);
+  }
+  if (0 == y)
+  {
+    return 0;
+  }
+  return (0 > y) ? -PHASE_PI / 2 : PHASE_PI / 2;
+}
+
+/** Wrap an integer phase difference the way TMR_phaseWrap() does */
+static int16_t
+phase_wrapInt(int32_t d, int32_t turn)
+{
+  int round;
+
+  for (round = 0; round < 2; round++)
+  {
+    if (d > turn / 2)
+    {
+      d -= turn;
+    }
+    if (d <= -((turn + 1) / 2))
+    {
+      d += turn;
+    }
+  }
+  return (int16_t)d;
+}
+
+static uint32_t
+phase_index(const TMR_PhaseKernel *kernel, uint16_t phase)
+{
+  return (phase < 2 * kernel->turn) ? phase : 2 * kernel->turn - 1;
+}
+
+static void
+phase_sumsScalar(const TMR_PhaseKernel *kernel, const uint16_t *phase,
+                 const int8_t *rssi, const uint8_t *keep, uint32_t count,
+                 PhaseSums *sums)
+{
+  uint32_t i, idx;
+  float w;
+
+  for (i = 0; i < count; i++)
+  {
+    if ((NULL != keep) && (0 == keep[i]))
+    {
+      continue;
+    }
+    idx = phase_index(kernel, phase[i]);
+    w = (NULL == rssi) ? 1.0f : kernel->rssiWeight[(uint8_t)(rssi[i] + 128)];
+    sums->c += kernel->cosTable[idx] * w;
+    sums->s += kernel->sinTable[idx] * w;
+    sums->w += w;
+    sums->count++;
+  }
+}
+
+/**
+ * Mark the phases within limit of mean, both in degrees, as the
+ * vector versions do, in single precision.
+ **/
+static uint32_t
+phase_maskScalar(const TMR_PhaseKernel *kernel, const uint16_t *phase, uint32_t count,
+                 float mean, float limit, uint8_t *keep)
+{
+  uint32_t i, kept;
+  float turn, half, d;
+  int round;
+
+  turn = kernel->turn;
+  half = turn / 2;
+  kept = 0;
+  for (i = 0; i < count; i++)
+  {
+    d = (float)phase_index(kernel, phase[i]) - mean;
+    for (round = 0; round < 2; round++)
+    {
+      d = (d > half) ? d - turn : d;
+      d = (d <= -half) ? d + turn : d;
+    }
+    keep[i] = (((0 > d) ? -d : d) <= limit) ? 1 : 0;
+    kept += keep[i];
+  }
+  return kept;
+}
+
+static void
+phase_wrapDiffScalar(const TMR_PhaseKernel *kernel, const uint16_t *a,
+                     const uint16_t *b, uint32_t count, int16_t *out)
+{
+  uint32_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    out[i] = phase_wrapInt((int32_t)a[i] - b[i], kernel->turn);
+  }
+}
+
+#ifdef PHASE_X86
+
+/**
+ * The table lookups gather eight at a time; SSE2 has no gather, so
+ * below AVX2 the sums are the plain C ones.
+ **/
+__attribute__((target("avx2")))
+static void
+phase_sumsAvx2(const TMR_PhaseKernel *kernel, const uint16_t *phase,
+               const int8_t *rssi, const uint8_t *keep, uint32_t count,
+               PhaseSums *sums)
+{
+  __m256d c0, c1, s0, s1, w0, w1;
+  __m256i top, bias, zero;
+  __m256 ones;
+  double lanes[4];
+  uint32_t i, n;
+  int j;
+
+  c0 = c1 = s0 = s1 = w0 = w1 = _mm256_setzero_pd();
+  top = _mm256_set1_epi32(2 * kernel->turn - 1);
+  bias = _mm256_set1_epi32(128);
+  zero = _mm256_setzero_si256();
+  ones = _mm256_set1_ps(1.0f);
+  n = 0;
+  for (i = 0; i + 8 <= count; i += 8)
+  {
+    __m256i idx;
+    __m256 c, s, w;
+
+    idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(phase + i)));
+    idx = _mm256_min_epu32(idx, top);
+    c = _mm256_i32gather_ps(kernel->cosTable, idx, 4);
+    s = _mm256_i32gather_ps(kernel->sinTable, idx, 4);
+    w = ones;
+    if (NULL != rssi)
+    {
+      __m256i r;
+
+      r = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i *)(rssi + i)));
+      w = _mm256_i32gather_ps(kernel->rssiWeight, _mm256_add_epi32(r, bias), 4);
+    }
+    if (NULL != keep)
+    {
+      __m256i m;
+
+      m = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(keep + i)));
+      m = _mm256_cmpgt_epi32(m, zero);
+      w = _mm256_and_ps(w, _mm256_castsi256_ps(m));
+      n += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+    }
+    else
+    {
+      n += 8;
+    }
+    c = _mm256_mul_ps(c, w);
+    s = _mm256_mul_ps(s, w);
+    c0 = _mm256_add_pd(c0, _mm256_cvtps_pd(_mm256_castps256_ps128(c)));
+    c1 = _mm256_add_pd(c1, _mm256_cvtps_pd(_mm256_extractf128_ps(c, 1)));
+    s0 = _mm256_add_pd(s0, _mm256_cvtps_pd(_mm256_castps256_ps128(s)));
+    s1 = _mm256_add_pd(s1, _mm256_cvtps_pd(_mm256_extractf128_ps(s, 1)));
+    w0 = _mm256_add_pd(w0, _mm256_cvtps_pd(_mm256_castps256_ps128(w)));
+    w1 = _mm256_add_pd(w1, _mm256_cvtps_pd(_mm256_extractf128_ps(w, 1)));
+  }
+
+  _mm256_storeu_pd(lanes, _mm256_add_pd(c0, c1));
+  for (j = 0; j < 4; j++)
+  {
+    sums->c += lanes[j];
+  }
+  _mm256_storeu_pd(lanes, _mm256_add_pd(s0, s1));
+  for (j = 0; j < 4; j++)
+  {
+    sums->s += lanes[j];
+  }
+  _mm256_storeu_pd(lanes, _mm256_add_pd(w0, w1));
+  for (j = 0; j < 4; j++)
+  {
+    sums->w += lanes[j];
+  }
+  sums->count += n;
+
+  phase_sumsScalar(kernel, phase + i, (NULL == rssi) ? NULL : rssi + i,
+                   (NULL == keep) ? NULL : keep + i, count - i, sums);
+}
+
+__attribute__((target("sse2")))
+static void
+phase_wrapDiffSse2(const TMR_PhaseKernel *kernel, const uint16_t *a,
+                   const uint16_t *b, uint32_t count, int16_t *out)
+{
+  __m128i turn, up, low;
+  uint32_t i;
+
+  turn = _mm_set1_epi16((int16_t)kernel->turn);
+  up = _mm_set1_epi16((int16_t)(kernel->turn / 2));
+  low = _mm_set1_epi16((int16_t)(1 - (kernel->turn + 1) / 2));
+  for (i = 0; i + 8 <= count; i += 8)
+  {
+    __m128i d;
+
+    d = _mm_sub_epi16(_mm_loadu_si128((const __m128i *)(a + i)),
+                      _mm_loadu_si128((const __m128i *)(b + i)));
+    d = _mm_sub_epi16(d, _mm_and_si128(_mm_cmpgt_epi16(d, up), turn));
+    d = _mm_add_epi16(d, _mm_and_si128(_mm_cmplt_epi16(d, low), turn));
+    d = _mm_sub_epi16(d, _mm_and_si128(_mm_cmpgt_epi16(d, up), turn));
+    d = _mm_add_epi16(d, _mm_and_si128(_mm_cmplt_epi16(d, low), turn));
+    _mm_storeu_si128((__m128i *)(out + i), d);
+  }
+  phase_wrapDiffScalar(kernel, a + i, b + i, count - i, out + i);
+}
+
+__attribute__((target("avx2")))
+static void
+phase_wrapDiffAvx2(const TMR_PhaseKernel *kernel, const uint16_t *a,
+                   const uint16_t *b, uint32_t count, int16_t *out)
+{
+  __m256i turn, up, low;
+  uint32_t i;
+
+  turn = _mm256_set1_epi16((int16_t)kernel->turn);
+  up = _mm256_set1_epi16((int16_t)(kernel->turn / 2));
+  low = _mm256_set1_epi16((int16_t)(1 - (kernel->turn + 1) / 2));
+  for (i = 0; i + 16 <= count; i += 16)
+  {
+    __m256i d;
+
+    d = _mm256_sub_epi16(_mm256_loadu_si256((const __m256i *)(a + i)),
+                         _mm256_loadu_si256((const __m256i *)(b + i)));
+    d = _mm256_sub_epi16(d, _mm256_and_si256(_mm256_cmpgt_epi16(d, up), turn));
+    d = _mm256_add_epi16(d, _mm256_and_si256(_mm256_cmpgt_epi16(low, d), turn));
+    d = _mm256_sub_epi16(d, _mm256_and_si256(_mm256_cmpgt_epi16(d, up), turn));
+    d = _mm256_add_epi16(d, _mm256_and_si256(_mm256_cmpgt_epi16(low, d), turn));
+    _mm256_storeu_si256((__m256i *)(out + i), d);
+  }
+  phase_wrapDiffScalar(kernel, a + i, b + i, count - i, out + i);
+}
+
+__attribute__((target("sse2")))
+static uint32_t
+phase_maskSse2(const TMR_PhaseKernel *kernel, const uint16_t *phase, uint32_t count,
+               float mean, float limit, uint8_t *keep)
+{
+  __m128 top, m, turn, half, nhalf, lim, sign;
+  __m128i zero;
+  uint32_t i, kept;
+  int j, bits, round;
+
+  top = _mm_set1_ps((float)(2 * kernel->turn - 1));
+  m = _mm_set1_ps(mean);
+  turn = _mm_set1_ps((float)kernel->turn);
+  half = _mm_set1_ps((float)kernel->turn / 2);
+  nhalf = _mm_set1_ps(-(float)kernel->turn / 2);
+  lim = _mm_set1_ps(limit);
+  sign = _mm_set1_ps(-0.0f);
+  zero = _mm_setzero_si128();
+  kept = 0;
+  for (i = 0; i + 4 <= count; i += 4)
+  {
+    __m128i p;
+    __m128 d;
+
+    p = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(phase + i)), zero);
+    d = _mm_sub_ps(_mm_min_ps(_mm_cvtepi32_ps(p), top), m);
+    for (round = 0; round < 2; round++)
+    {
+      d = _mm_sub_ps(d, _mm_and_ps(_mm_cmpgt_ps(d, half), turn));
+      d = _mm_add_ps(d, _mm_and_ps(_mm_cmple_ps(d, nhalf), turn));
+    }
+    bits = _mm_movemask_ps(_mm_cmple_ps(_mm_andnot_ps(sign, d), lim));
+    for (j = 0; j < 4; j++)
+    {
+      keep[i + j] = (uint8_t)((bits >> j) & 1);
+    }
+    kept += __builtin_popcount(bits);
+  }
+  return kept + phase_maskScalar(kernel, phase + i, count - i, mean, limit, keep + i);
+}
+
+__attribute__((target("avx2")))
+static uint32_t
+phase_maskAvx2(const TMR_PhaseKernel *kernel, const uint16_t *phase, uint32_t count,
+               float mean, float limit, uint8_t *keep)
+{
+  __m256 top, m, turn, half, nhalf, lim, sign;
+  uint32_t i, kept;
+  int j, bits, round;
+
+  top = _mm256_set1_ps((float)(2 * kernel->turn - 1));
+  m = _mm256_set1_ps(mean);
+  turn = _mm256_set1_ps((float)kernel->turn);
+  half = _mm256_set1_ps((float)kernel->turn / 2);
+  nhalf = _mm256_set1_ps(-(float)kernel->turn / 2);
+  lim = _mm256_set1_ps(limit);
+  sign = _mm256_set1_ps(-0.0f);
+  kept = 0;
+  for (i = 0; i + 8 <= count; i += 8)
+  {
+    __m256i p;
+    __m256 d;
+
+    p = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(phase + i)));
+    d = _mm256_sub_ps(_mm256_min_ps(_mm256_cvtepi32_ps(p), top), m);
+    for (round = 0; round < 2; round++)
+    {
+      d = _mm256_sub_ps(d, _mm256_and_ps(_mm256_cmp_ps(d, half, _CMP_GT_OQ), turn));
+      d = _mm256_add_ps(d, _mm256_and_ps(_mm256_cmp_ps(d, nhalf, _CMP_LE_OQ), turn));
+    }
+    bits = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, d), lim, _CMP_LE_OQ));
+    for (j = 0; j < 8; j++)
+    {
+      keep[i + j] = (uint8_t)((bits >> j) & 1);
+    }
+    kept += __builtin_popcount(bits);
+  }
+  return kept + phase_maskScalar(kernel, phase + i, count - i, mean, limit, keep + i);
+}
+
+#endif /* PHASE_X86 */
+
+static void
+phase_sums(const TMR_PhaseKernel *kernel, const uint16_t *phase, const int8_t *rssi,
+           const uint8_t *keep, uint32_t count, PhaseSums *sums)
+{
+#ifdef PHASE_X86
+  if (TMR_PHASE_KERNEL_AVX2 == kernel->type)
+  {
+    phase_sumsAvx2(kernel, phase, rssi, keep, count, sums);
+    return;
+  }
+#endif
+  phase_sumsScalar(kernel, phase, rssi, keep, count, sums);
+}
+
+static uint32_t
+phase_mask(const TMR_PhaseKernel *kernel, const uint16_t *phase, uint32_t count,
+           float mean, float limit, uint8_t *keep)
+{
+#ifdef PHASE_X86
+  if (TMR_PHASE_KERNEL_AVX2 == kernel->type)
+  {
+    return phase_maskAvx2(kernel, phase, count, mean, limit, keep);
+  }
+  if (TMR_PHASE_KERNEL_SSE2 == kernel->type)
+  {
+    return phase_maskSse2(kernel, phase, count, mean, limit, keep);
+  }
+#endif
+  return phase_maskScalar(kernel, phase, count, mean, limit, keep);
+}
+
+/** Turn sums on the circle of a turn into the statistics of the phases */
+static void
+phase_finish(const TMR_PhaseKernel *kernel, const PhaseSums *sums, TMR_PhaseStats *stats)
+{
+  double theta;
+
+  memset(stats, 0, sizeof(*stats));
+  stats->count = sums->count;
+  stats->weight = sums->w;
+  if (0 >= sums->w)
+  {
+    stats->variance = 1;
+    stats->deviation = phase_sqrt(2) * kernel->turn / 360;
+    return;
+  }
+  theta = phase_atan2(sums->s, sums->c);
+  theta = (0 > theta) ? theta + 2 * PHASE_PI : theta;
+  theta = (2 * PHASE_PI <= theta) ? theta - 2 * PHASE_PI : theta;
+  stats->mean = theta * kernel->turn / 360;
+  stats->resultant = phase_sqrt(sums->c * sums->c + sums->s * sums->s) / sums->w;
+  stats->resultant = (1 < stats->resultant) ? 1 : stats->resultant;
+  stats->variance = 1 - stats->resultant;
+  stats->deviation = phase_sqrt(2 * stats->variance) * kernel->turn / 360;
+}
+
+TMR_Status
+TMR_phaseKernelInit(TMR_PhaseKernel *kernel, uint16_t turn)
+{
+  double theta, s, c, w;
+  uint32_t i;
+
+  if ((0 == turn) || (TMR_PHASE_MAX_TURN < turn))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(kernel, 0, sizeof(*kernel));
+  kernel->turn = turn;
+  for (i = 0; i < 2 * (uint32_t)turn; i++)
+  {
+    theta = 2 * PHASE_PI * (i % turn) / turn;
+    theta = (PHASE_PI < theta) ? theta - 2 * PHASE_PI : theta;
+    phase_sincos(theta, &s, &c);
+    kernel->cosTable[i] = (float)c;
+    kernel->sinTable[i] = (float)s;
+  }
+  w = 1;
+  for (i = 128; i < 256; i++, w *= PHASE_DB)
+  {
+    kernel->rssiWeight[i] = (float)w;
+  }
+  w = 1;
+  for (i = 128; i-- > 0; )
+  {
+    w /= PHASE_DB;
+    kernel->rssiWeight[i] = (float)w;
+  }
+
+  kernel->type = TMR_PHASE_KERNEL_SCALAR;
+#ifdef PHASE_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    kernel->type = TMR_PHASE_KERNEL_AVX2;
+  }
+  else if (__builtin_cpu_supports("sse2"))
+  {
+    kernel->type = TMR_PHASE_KERNEL_SSE2;
+  }
+#endif
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_phaseStats(const TMR_PhaseKernel *kernel, const uint16_t *phase,
+               const int8_t *rssi, uint32_t count, TMR_PhaseStats *stats)
+{
+  PhaseSums sums;
+
+  memset(&sums, 0, sizeof(sums));
+  phase_sums(kernel, phase, rssi, NULL, count, &sums);
+  phase_finish(kernel, &sums, stats);
+}
+
+void
+TMR_phaseWrapDiff(const TMR_PhaseKernel *kernel, const uint16_t *a,
+                  const uint16_t *b, uint32_t count, int16_t *out)
+{
+#ifdef PHASE_X86
+  if (TMR_PHASE_KERNEL_AVX2 == kernel->type)
+  {
+    phase_wrapDiffAvx2(kernel, a, b, count, out);
+    return;
+  }
+  if (TMR_PHASE_KERNEL_SSE2 == kernel->type)
+  {
+    phase_wrapDiffSse2(kernel, a, b, count, out);
+    return;
+  }
+#endif
+  phase_wrapDiffScalar(kernel, a, b, count, out);
+}
+
+uint32_t
+TMR_phaseRejectOutliers(const TMR_PhaseKernel *kernel, const uint16_t *phase,
+                        const int8_t *rssi, uint32_t count, double limit,
+                        uint8_t *keep, TMR_PhaseStats *stats)
+{
+  PhaseSums sums;
+  uint8_t chunk[PHASE_CHUNK];
+  uint8_t *mask;
+  uint32_t done, n;
+  float mean, bound;
+
+  TMR_phaseStats(kernel, phase, rssi, count, stats);
+  if (0 == stats->count)
+  {
+    return 0;
+  }
+
+  /* The kernels compare in degrees */
+  mean = (float)(stats->mean * 180 / PHASE_PI);
+  bound = (float)(limit * stats->deviation * 180 / PHASE_PI);
+  memset(&sums, 0, sizeof(sums));
+  for (done = 0; done < count; done += n)
+  {
+    if (NULL != keep)
+    {
+      n = count - done;
+      mask = keep + done;
+    }
+    else
+    {
+      n = (PHASE_CHUNK < count - done) ? PHASE_CHUNK : count - done;
+      mask = chunk;
+    }
+    phase_mask(kernel, phase + done, n, mean, bound, mask);
+    phase_sums(kernel, phase + done, (NULL == rssi) ? NULL : rssi + done, mask, n, &sums);
+  }
+  phase_finish(kernel, &sums, stats);
+  return stats->count;
+}
+
+/**
+ * The scatter into groups doesn't vectorize; with the tables it is a
+ * few nanoseconds a read all the same.
+ **/
+void
+TMR_phaseGroupStats(const TMR_PhaseKernel *kernel, const TMR_PhaseBatch *batch,
+                    bool weighted, double limit, TMR_PhaseStats *stats)
+{
+  PhaseSums sums;
+  double *g;
+  uint32_t i, idx;
+  float w, d, turn, half;
+  int round;
+
+  /* Per group: c, s, w, count, then the mean and bound in degrees */
+  memset(batch->scratch, 0, batch->groupCount * 6 * sizeof(double));
+  turn = kernel->turn;
+  half = turn / 2;
+  for (i = 0; i < batch->count; i++)
+  {
+    g = batch->scratch + 6 * batch->group[i];
+    idx = phase_index(kernel, batch->phase[i]);
+    w = weighted ? kernel->rssiWeight[(uint8_t)(batch->rssi[i] + 128)] : 1.0f;
+    g[0] += kernel->cosTable[idx] * w;
+    g[1] += kernel->sinTable[idx] * w;
+    g[2] += w;
+    g[3] += 1;
+  }
+  for (i = 0; i < batch->groupCount; i++)
+  {
+    g = batch->scratch + 6 * i;
+    sums.c = g[0];
+    sums.s = g[1];
+    sums.w = g[2];
+    sums.count = (uint32_t)g[3];
+    phase_finish(kernel, &sums, &stats[i]);
+  }
+  if (0 >= limit)
+  {
+    return;
+  }
+
+  for (i = 0; i < batch->groupCount; i++)
+  {
+    g = batch->scratch + 6 * i;
+    memset(g, 0, 4 * sizeof(double));
+    g[4] = (float)(stats[i].mean * 180 / PHASE_PI);
+    g[5] = (float)(limit * stats[i].deviation * 180 / PHASE_PI);
+  }
+  for (i = 0; i < batch->count; i++)
+  {
+    g = batch->scratch + 6 * batch->group[i];
+    idx = phase_index(kernel, batch->phase[i]);
+    d = (float)idx - (float)g[4];
+    for (round = 0; round < 2; round++)
+    {
+      d = (d > half) ? d - turn : d;
+      d = (d <= -half) ? d + turn : d;
+    }
+    if (((0 > d) ? -d : d) > (float)g[5])
+    {
+      continue;
+    }
+    w = weighted ? kernel->rssiWeight[(uint8_t)(batch->rssi[i] + 128)] : 1.0f;
+    g[0] += kernel->cosTable[idx] * w;
+    g[1] += kernel->sinTable[idx] * w;
+    g[2] += w;
+    g[3] += 1;
+  }
+  for (i = 0; i < batch->groupCount; i++)
+  {
+    g = batch->scratch + 6 * i;
+    sums.c = g[0];
+    sums.s = g[1];
+    sums.w = g[2];
+    sums.count = (uint32_t)g[3];
+    phase_finish(kernel, &sums, &stats[i]);
+  }
+}
+
+TMR_Status
+TMR_phaseBatchInit(TMR_PhaseBatch *batch, uint32_t max, uint16_t turn, bool byAntenna)
+{
+  uint32_t size;
+
+  memset(batch, 0, sizeof(*batch));
+  if ((0 == max) || (0x40000000 < max) || (0 == turn) || (TMR_PHASE_MAX_TURN < turn))
+  {
+    return TMR_ERROR_INVALID;
+  }
+  for (size = 2; size < 2 * max; size <<= 1)
+  {
+  }
+
+  batch->max = max;
+  batch->turn = turn;
+  batch->byAntenna = byAntenna;
+  batch->indexMask = size - 1;
+  batch->phase = malloc(max * sizeof(*batch->phase));
+  batch->rssi = malloc(max * sizeof(*batch->rssi));
+  batch->antenna = malloc(max * sizeof(*batch->antenna));
+  batch->frequency = malloc(max * sizeof(*batch->frequency));
+  batch->group = malloc(max * sizeof(*batch->group));
+  batch->groupTag = malloc(max * sizeof(*batch->groupTag));
+  batch->groupAntenna = malloc(max * sizeof(*batch->groupAntenna));
+  batch->scratch = malloc(max * 6 * sizeof(*batch->scratch));
+  batch->index = calloc(size, sizeof(*batch->index));
+  if ((NULL == batch->phase) || (NULL == batch->rssi) || (NULL == batch->antenna)
+      || (NULL == batch->frequency) || (NULL == batch->group) || (NULL == batch->groupTag)
+      || (NULL == batch->groupAntenna) || (NULL == batch->scratch) || (NULL == batch->index))
+  {
+    TMR_phaseBatchFree(batch);
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  return TMR_SUCCESS;
+}
+
+void
+TMR_phaseBatchClear(TMR_PhaseBatch *batch)
+{
+  batch->count = 0;
+  batch->groupCount = 0;
+  memset(batch->index, 0, (batch->indexMask + 1) * sizeof(*batch->index));
+}
+
+/** Number the tag and antenna of a read, adding a group if it is new */
+static uint32_t
+phase_group(TMR_PhaseBatch *batch, const TMR_TagReadData *read)
+{
+  const TMR_TagData *tag;
+  uint32_t hash, slot, g;
+  uint8_t antenna, i;
+
+  tag = &read->tag;
+  antenna = batch->byAntenna ? read->antenna : 0;
+
+  /* FNV-1a */
+  hash = 0x811c9dc5U;
+  for (i = 0; i < tag->epcByteCount; i++)
+  {
+    hash = (hash ^ tag->epc[i]) * 0x01000193U;
+  }
+  hash = (hash ^ antenna) * 0x01000193U;
+
+  for (slot = hash & batch->indexMask; 0 != batch->index[slot];
+       slot = (slot + 1) & batch->indexMask)
+  {
+    g = batch->index[slot] - 1;
+    if ((antenna == batch->groupAntenna[g])
+        && (tag->epcByteCount == batch->groupTag[g].epcByteCount)
+        && (0 == memcmp(tag->epc, batch->groupTag[g].epc, tag->epcByteCount)))
+    {
+      return g;
+    }
+  }
+
+  g = batch->groupCount++;
+  batch->index[slot] = g + 1;
+  batch->groupTag[g] = *tag;
+  batch->groupAntenna[g] = antenna;
+  return g;
+}
+
+TMR_Status
+TMR_phaseBatchAdd(TMR_PhaseBatch *batch, const TMR_TagReadData *read)
+{
+  uint32_t i;
+
+  if (0 == (read->metadataFlags & TMR_TRD_METADATA_FLAG_PHASE))
+  {
+    return TMR_SUCCESS;
+  }
+  if (batch->count == batch->max)
+  {
+    return TMR_ERROR_TOO_BIG;
+  }
+
+  i = batch->count++;
+  batch->phase[i] = read->phase % batch->turn;
+  batch->rssi[i] = (int8_t)((-128 > read->rssi) ? -128 : ((127 < read->rssi) ? 127 : read->rssi));
+  batch->antenna[i] = read->antenna;
+  batch->frequency[i] = read->frequency;
+  batch->group[i] = phase_group(batch, read);
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_phaseBatchLoad(TMR_PhaseBatch *batch, const TMR_TagReadData *reads, int32_t count)
+{
+  TMR_Status ret;
+  int32_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    ret = TMR_phaseBatchAdd(batch, &reads[i]);
+    if (TMR_SUCCESS != ret)
+    {
+      return ret;
+    }
+  }
+  return TMR_SUCCESS;
+}
+
+void
+TMR_phaseBatchFree(TMR_PhaseBatch *batch)
+{
+  free(batch->phase);
+  free(batch->rssi);
+  free(batch->antenna);
+  free(batch->frequency);
+  free(batch->group);
+  free(batch->groupTag);
+  free(batch->groupAntenna);
+  free(batch->scratch);
+  free(batch->index);
+  memset(batch, 0, sizeof(*batch));
+}
+
+#endif /* TMR_ENABLE_PHASE_STATS */
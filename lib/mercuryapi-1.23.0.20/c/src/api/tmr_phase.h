@@ -0,0 +1,283 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_PHASE_H
+#define _TMR_PHASE_H
+/**
+ *  @file tmr_phase.h
+ *  @brief Mercury API - Batch phase statistics
+ *
+ * Statistics of the phase metadata over many reads at once.  Phase
+ * is an angle, so it is averaged on the circle: each read is a unit
+ * vector, optionally weighted by its received power, and the mean
+ * is the direction of their sum and the spread its shortfall from
+ * the total weight.  A phase that wraps at 180 degrees, as the M6e's
+ * does, is doubled onto the full circle first, so 0 and 179 count
+ * as neighbours.
+ *
+ * The kernels work on plain arrays of phase (and RSSI), so a
+ * TMR_PhaseBatch, which lays reads out that way and numbers the tags
+ * in them, is the usual way in: load it from TMR_readIntoArray()
+ * output or append to it from a read listener.  Sines, cosines and
+ * power weights come from tables built by TMR_phaseKernelInit(); with
+ * TMR_ENABLE_PHASE_SIMD the kernels use AVX2 or SSE2 where the CPU
+ * has them, and give the same results as the plain C ones to within
+ * rounding.
+ *
+ * TMR_phaseWrap(), the one wrap of a phase difference the read stream
+ * engines all use, is built whether or not the kernels are.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Wrap a phase difference to half a turn either way, into
+ * (-turn / 2, turn / 2]: a difference of exactly half a turn comes
+ * out positive.  Differences any number of turns out are brought in.
+ *
+ * @param diff The difference
+ * @param turn Phase values wrap at this, in the same units; 180
+ *             degrees for the M6e
+ **/
+double TMR_phaseWrap(double diff, double turn);
+
+#ifdef TMR_ENABLE_PHASE_STATS
+
+/**
+ * Which kernels TMR_phaseKernelInit() picked.
+ **/
+typedef enum TMR_PhaseKernelType
+{
+  TMR_PHASE_KERNEL_SCALAR = 0,
+  TMR_PHASE_KERNEL_SSE2 = 1,
+  TMR_PHASE_KERNEL_AVX2 = 2
+} TMR_PhaseKernelType;
+
+/**
+ * Tables and the kernel choice for one phase turn.  Read-only once
+ * initialized, so threads can share one.
+ **/
+typedef struct TMR_PhaseKernel
+{
+  /** Phase values wrap at this many degrees */
+  uint16_t turn;
+  /** The kernels in use; set it lower to force simpler ones */
+  TMR_PhaseKernelType type;
+  /** @private Cosine and sine of each phase value, up to two turns */
+  float cosTable[2 * TMR_PHASE_MAX_TURN];
+  /** @private */
+  float sinTable[2 * TMR_PHASE_MAX_TURN];
+  /** @private Received power of each RSSI, from -128 dBm, in mW */
+  float rssiWeight[256];
+} TMR_PhaseKernel;
+
+/**
+ * Circular statistics of a set of phases.
+ **/
+typedef struct TMR_PhaseStats
+{
+  /** Reads counted */
+  uint32_t count;
+  /** Sum of their weights: count unweighted, mW weighted */
+  double weight;
+  /** Mean phase, radians, 0 to a turn */
+  double mean;
+  /**
+   * Length of the mean vector, 0 to 1: 1 when every phase is the
+   * same, near 0 when they are spread round the circle
+   */
+  double resultant;
+  /** Circular variance, 1 - resultant */
+  double variance;
+  /**
+   * Angular deviation, sqrt(2 * variance), in radians of phase: the
+   * circular counterpart of the standard deviation
+   */
+  double deviation;
+} TMR_PhaseStats;
+
+/**
+ * Reads laid out as arrays, one entry per read, with the tags in
+ * them numbered as groups.
+ **/
+typedef struct TMR_PhaseBatch
+{
+  /** Reads in the batch */
+  uint32_t count;
+  /** Room for this many reads */
+  uint32_t max;
+  /** Phase of each read, degrees, below a turn */
+  uint16_t *phase;
+  /** RSSI of each read, dBm */
+  int8_t *rssi;
+  /** Antenna of each read */
+  uint8_t *antenna;
+  /** Carrier frequency of each read, kHz */
+  uint32_t *frequency;
+  /** Group of each read, below groupCount */
+  uint32_t *group;
+  /** Groups in the batch */
+  uint32_t groupCount;
+  /** Tag of each group */
+  TMR_TagData *groupTag;
+  /** Antenna of each group, 0 unless grouped by antenna */
+  uint8_t *groupAntenna;
+  /** True if a tag on another antenna is another group */
+  bool byAntenna;
+  /** @private Phase turn the batch reduces phases to */
+  uint16_t turn;
+  /** @private Group + 1 by hash of tag and antenna, 0 if empty */
+  uint32_t *index;
+  /** @private */
+  uint32_t indexMask;
+  /** @private Per group sums for TMR_phaseGroupStats() */
+  double *scratch;
+} TMR_PhaseBatch;
+
+/**
+ * Build the tables for a phase turn and pick the kernels.
+ *
+ * @param kernel The kernel to initialize
+ * @param turn Phase values wrap at this many degrees, 180 for the M6e
+ * @return TMR_ERROR_INVALID if turn is 0 or above TMR_PHASE_MAX_TURN
+ **/
+TMR_Status TMR_phaseKernelInit(TMR_PhaseKernel *kernel, uint16_t turn);
+
+/**
+ * Circular mean and spread of a set of phases.  Phases of two turns
+ * or more count as the last value of the second turn.
+ *
+ * @param kernel The kernel
+ * @param phase Phases, degrees
+ * @param rssi RSSI of each phase, dBm, to weight each by its received
+ *             power, or NULL to weight them equally
+ * @param count Number of phases
+ * @param[out] stats The statistics
+ **/
+void TMR_phaseStats(const TMR_PhaseKernel *kernel, const uint16_t *phase,
+                    const int8_t *rssi, uint32_t count, TMR_PhaseStats *stats);
+
+/**
+ * Differences of pairs of phases, each wrapped to half a turn either
+ * way: out[i] = a[i] - b[i].  Phases must be below two turns.  Pass a
+ * + 1 and a for the changes between consecutive reads.
+ *
+ * @param kernel The kernel
+ * @param a First phase of each pair, degrees
+ * @param b Second phase of each pair, degrees
+ * @param count Number of pairs
+ * @param[out] out The differences, degrees; may not overlap a or b
+ **/
+void TMR_phaseWrapDiff(const TMR_PhaseKernel *kernel, const uint16_t *a,
+                       const uint16_t *b, uint32_t count, int16_t *out);
+
+/**
+ * Circular mean and spread of a set of phases leaving out those
+ * further from the mean of them all than limit angular deviations.
+ *
+ * @param kernel The kernel
+ * @param phase Phases, degrees
+ * @param rssi RSSI of each phase to weight by, or NULL
+ * @param count Number of phases
+ * @param limit Furthest a phase may be from the mean, in deviations
+ * @param[out] keep Set to 1 for each phase kept and 0 for each left
+ *                  out, or NULL
+ * @param[out] stats The statistics of the phases kept
+ * @return Number of phases kept
+ **/
+uint32_t TMR_phaseRejectOutliers(const TMR_PhaseKernel *kernel, const uint16_t *phase,
+                                 const int8_t *rssi, uint32_t count, double limit,
+                                 uint8_t *keep, TMR_PhaseStats *stats);
+
+/**
+ * Statistics of each group of a batch in one pass over it, and with
+ * a limit, a second pass leaving out each group's outliers.
+ *
+ * @param kernel The kernel, for the batch's turn
+ * @param batch The batch
+ * @param weighted Weight phases by received power
+ * @param limit Furthest a phase may be from its group's mean, in
+ *              deviations, or 0 to keep all
+ * @param[out] stats batch->groupCount statistics, by group
+ **/
+void TMR_phaseGroupStats(const TMR_PhaseKernel *kernel, const TMR_PhaseBatch *batch,
+                         bool weighted, double limit, TMR_PhaseStats *stats);
+
+/**
+ * Allocate a batch.
+ *
+ * @param batch The batch to initialize
+ * @param max Room for this many reads
+ * @param turn Phase values wrap at this many degrees
+ * @param byAntenna Make a tag on each antenna a group of its own
+ * @return TMR_ERROR_OUT_OF_MEMORY or TMR_ERROR_INVALID
+ **/
+TMR_Status TMR_phaseBatchInit(TMR_PhaseBatch *batch, uint32_t max, uint16_t turn,
+                              bool byAntenna);
+
+/**
+ * Empty a batch, forgetting its groups.
+ *
+ * @param batch The batch
+ **/
+void TMR_phaseBatchClear(TMR_PhaseBatch *batch);
+
+/**
+ * Append a read to a batch.  Reads without phase metadata are left
+ * out.
+ *
+ * @param batch The batch
+ * @param read The read
+ * @return TMR_ERROR_TOO_BIG if the batch is full
+ **/
+TMR_Status TMR_phaseBatchAdd(TMR_PhaseBatch *batch, const TMR_TagReadData *read);
+
+/**
+ * Append reads to a batch, such as those from TMR_readIntoArray().
+ *
+ * @param batch The batch
+ * @param reads The reads
+ * @param count Number of reads
+ * @return TMR_ERROR_TOO_BIG if the batch filled up
+ **/
+TMR_Status TMR_phaseBatchLoad(TMR_PhaseBatch *batch, const TMR_TagReadData *reads,
+                              int32_t count);
+
+/**
+ * Free a batch's arrays.
+ *
+ * @param batch The batch
+ **/
+void TMR_phaseBatchFree(TMR_PhaseBatch *batch);
+
+#endif /* TMR_ENABLE_PHASE_STATS */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_PHASE_H */
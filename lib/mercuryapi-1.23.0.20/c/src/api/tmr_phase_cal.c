@@ -0,0 +1,341 @@
+/**
+ *  @file tmr_phase_cal.c
+ *  @brief Mercury API - Per antenna and channel phase calibration
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_PHASE_CAL
+
+#include <string.h>
+#ifdef TMR_ENABLE_STDIO
+#include <stdio.h>
+#endif
+
+#include "tm_reader.h"
+#include "tmr_phase_cal.h"
+#include "tmr_atomic.h"
+#include "tmr_phase.h"
+
+#define CAL_C 299792458.0
+#define CAL_FLAGS (TMR_TRD_METADATA_FLAG_PHASE | TMR_TRD_METADATA_FLAG_FREQUENCY)
+
+/**
+ * Table index of a read, or -1 for a read the table doesn't cover
+ **/
+static int32_t
+cal_index(const TMR_PhaseCal *cal, const TMR_TagReadData *read)
+{
+  uint32_t channel;
+
+  if ((CAL_FLAGS != (read->metadataFlags & CAL_FLAGS))
+      || (TMR_PHASE_CAL_MAX_ANTENNAS < read->antenna)
+      || (read->frequency < cal->baseKhz) || (read->phase >= cal->turn))
+  {
+    return -1;
+  }
+  channel = (read->frequency - cal->baseKhz) / cal->stepKhz;
+  if ((channel >= cal->channels)
+      || (read->frequency != cal->baseKhz + channel * cal->stepKhz))
+  {
+    return -1;
+  }
+  return (int32_t)(read->antenna * cal->channels + channel);
+}
+
+static uint32_t
+cal_gcd(uint32_t a, uint32_t b)
+{
+  uint32_t t;
+
+  while (0 != b)
+  {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+TMR_Status
+TMR_phaseCalInit(TMR_PhaseCal *cal, uint16_t turn, const uint32_t *frequencies,
+                 uint32_t count)
+{
+  uint32_t lowest, highest, step, i;
+
+  if ((0 == turn) || (0 == count))
+  {
+    return TMR_ERROR_INVALID;
+  }
+  lowest = frequencies[0];
+  highest = frequencies[0];
+  for (i = 1; i < count; i++)
+  {
+    lowest = (frequencies[i] < lowest) ? frequencies[i] : lowest;
+    highest = (frequencies[i] > highest) ? frequencies[i] : highest;
+  }
+  step = 0;
+  for (i = 0; i < count; i++)
+  {
+    step = cal_gcd(step, frequencies[i] - lowest);
+  }
+  step = (0 == step) ? 1 : step;
+  if ((highest - lowest) / step >= TMR_PHASE_CAL_MAX_CHANNELS)
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(cal, 0, sizeof(*cal));
+  cal->turn = turn;
+  cal->baseKhz = lowest;
+  cal->stepKhz = step;
+  cal->channels = (uint16_t)((highest - lowest) / step + 1);
+  return TMR_SUCCESS;
+}
+
+void
+TMR_phaseCalClear(TMR_PhaseCal *cal)
+{
+  memset(cal->offset, 0, sizeof(cal->offset));
+}
+
+TMR_Status
+TMR_phaseCalAttach(TMR_Reader *reader, TMR_PhaseCal *cal)
+{
+#ifdef TMR_ENABLE_SERIAL_READER
+  if (TMR_READER_TYPE_SERIAL == reader->readerType)
+  {
+    TMR__STORE_RELEASE(struct TMR_PhaseCal *, &reader->u.serialReader.phaseCal, cal);
+    return TMR_SUCCESS;
+  }
+#endif
+  return TMR_ERROR_UNSUPPORTED;
+}
+
+void
+TMR_phaseCalApply(TMR_PhaseCal *cal, TMR_TagReadData *read)
+{
+  int32_t index;
+  uint16_t offset;
+
+  index = cal_index(cal, read);
+  if (0 > index)
+  {
+    cal->skipped++;
+    return;
+  }
+  offset = cal->offset[index];
+  read->phase = (read->phase >= offset) ? read->phase - offset
+                                        : read->phase + cal->turn - offset;
+  cal->corrected++;
+}
+
+void
+TMR_phaseCalLearnInit(TMR_PhaseCalLearner *learner, const TMR_PhaseCal *cal,
+                      const TMR_TagData *reference)
+{
+  memset(learner, 0, sizeof(*learner));
+  learner->cal = cal;
+  learner->reference = *reference;
+  learner->minReads = 4;
+}
+
+void
+TMR_phaseCalLearnAdd(TMR_PhaseCalLearner *learner, const TMR_TagReadData *read)
+{
+  const TMR_PhaseCal *cal;
+  int32_t index;
+  double expected, error;
+
+  cal = learner->cal;
+  if ((read->tag.epcByteCount != learner->reference.epcByteCount)
+      || (0 != memcmp(read->tag.epc, learner->reference.epc, read->tag.epcByteCount)))
+  {
+    return;
+  }
+  index = cal_index(cal, read);
+  if ((0 > index) || (0 >= learner->distance[read->antenna]))
+  {
+    return;
+  }
+  learner->reads++;
+
+  /* Round trip, 720 f d / c degrees */
+  expected = 720.0 * read->frequency * 1000.0 * learner->distance[read->antenna] / CAL_C;
+  error = TMR_phaseWrap(read->phase - expected, cal->turn);
+
+  /* Running mean, each error taken on the side of the turn nearest the mean */
+  if (0 == learner->count[index])
+  {
+    learner->mean[index] = error;
+  }
+  else
+  {
+    learner->mean[index] += TMR_phaseWrap(error - learner->mean[index], cal->turn)
+                            / (learner->count[index] + 1);
+  }
+  learner->count[index]++;
+}
+
+TMR_Status
+TMR_phaseCalLearnFinish(const TMR_PhaseCalLearner *learner, TMR_PhaseCal *cal,
+                        uint32_t *cells)
+{
+  uint32_t i, updated;
+  double offset;
+
+  if (cal != learner->cal)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  updated = 0;
+  for (i = 0; i < (uint32_t)(TMR_PHASE_CAL_MAX_ANTENNAS + 1) * cal->channels; i++)
+  {
+    if ((0 == learner->count[i]) || (learner->count[i] < learner->minReads))
+    {
+      continue;
+    }
+    offset = TMR_phaseWrap(cal->offset[i] + learner->mean[i], cal->turn);
+    offset = (0 > offset) ? offset + cal->turn : offset;
+    cal->offset[i] = (uint16_t)((uint32_t)(offset + 0.5) % cal->turn);
+    updated++;
+  }
+  if (NULL != cells)
+  {
+    *cells = updated;
+  }
+  return TMR_SUCCESS;
+}
+
+#ifdef TMR_ENABLE_STDIO
+TMR_Status
+TMR_phaseCalSave(const TMR_PhaseCal *cal, const char *path)
+{
+  FILE *f;
+  uint32_t antenna, channel;
+  uint16_t offset;
+  int ok;
+
+  f = fopen(path, "w");
+  if (NULL == f)
+  {
+    return TMR_ERROR_TRYAGAIN;
+  }
+  ok = fprintf(f, "# Mercury API phase calibration: antenna, frequency kHz, offset degrees\n"
+               "turn %u\ngrid %lu %lu %u\n", cal->turn, (unsigned long)cal->baseKhz,
+               (unsigned long)cal->stepKhz, cal->channels);
+  for (antenna = 0; (0 < ok) && (antenna <= TMR_PHASE_CAL_MAX_ANTENNAS); antenna++)
+  {
+    for (channel = 0; (0 < ok) && (channel < cal->channels); channel++)
+    {
+      offset = cal->offset[antenna * cal->channels + channel];
+      if (0 != offset)
+      {
+        ok = fprintf(f, "%lu %lu %u\n", (unsigned long)antenna,
+                     (unsigned long)(cal->baseKhz + channel * cal->stepKhz), offset);
+      }
+    }
+  }
+  if ((0 != fclose(f)) || (0 > ok))
+  {
+    return TMR_ERROR_TRYAGAIN;
+  }
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_phaseCalLoad(TMR_PhaseCal *cal, const char *path)
+{
+  FILE *f;
+  TMR_TagReadData read;
+  char line[128];
+  unsigned int turn, channels, offset;
+  unsigned long base, step, antenna, frequency;
+  bool haveTurn, haveGrid;
+  int32_t index;
+  TMR_Status ret;
+
+  f = fopen(path, "r");
+  if (NULL == f)
+  {
+    return TMR_ERROR_NOT_FOUND;
+  }
+  memset(cal, 0, sizeof(*cal));
+  haveTurn = false;
+  haveGrid = false;
+  ret = TMR_SUCCESS;
+  turn = 0;
+  while ((TMR_SUCCESS == ret) && (NULL != fgets(line, sizeof(line), f)))
+  {
+    if (('#' == line[0]) || ('\n' == line[0]))
+    {
+      continue;
+    }
+    if (1 == sscanf(line, "turn %u", &turn))
+    {
+      haveTurn = (0 < turn) && (0xFFFF >= turn);
+      cal->turn = (uint16_t)turn;
+      ret = haveTurn ? TMR_SUCCESS : TMR_ERROR_INVALID;
+    }
+    else if (3 == sscanf(line, "grid %lu %lu %u", &base, &step, &channels))
+    {
+      haveGrid = (0 < step) && (0 < channels) && (TMR_PHASE_CAL_MAX_CHANNELS >= channels);
+      cal->baseKhz = (uint32_t)base;
+      cal->stepKhz = (uint32_t)step;
+      cal->channels = (uint16_t)channels;
+      ret = haveGrid ? TMR_SUCCESS : TMR_ERROR_INVALID;
+    }
+    else if (haveTurn && haveGrid
+             && (3 == sscanf(line, "%lu %lu %u", &antenna, &frequency, &offset))
+             && (TMR_PHASE_CAL_MAX_ANTENNAS >= antenna) && (offset < turn))
+    {
+      read.metadataFlags = CAL_FLAGS;
+      read.antenna = (uint8_t)antenna;
+      read.frequency = (uint32_t)frequency;
+      read.phase = 0;
+      index = cal_index(cal, &read);
+      if (0 > index)
+      {
+        ret = TMR_ERROR_INVALID;
+      }
+      else
+      {
+        cal->offset[index] = (uint16_t)offset;
+      }
+    }
+    else
+    {
+      ret = TMR_ERROR_INVALID;
+    }
+  }
+  fclose(f);
+  if ((TMR_SUCCESS == ret) && !(haveTurn && haveGrid))
+  {
+    ret = TMR_ERROR_INVALID;
+  }
+  return ret;
+}
+#endif /* TMR_ENABLE_STDIO */
+
+#endif /* TMR_ENABLE_PHASE_CAL */
@@ -0,0 +1,210 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_PHASE_CAL_H
+#define _TMR_PHASE_CAL_H
+/**
+ *  @file tmr_phase_cal.h
+ *  @brief Mercury API - Per antenna and channel phase calibration
+ *
+ * Cables and port electronics add a phase offset to every read that
+ * depends on the antenna and the carrier frequency.  A TMR_PhaseCal
+ * is a table of those offsets, one per antenna and channel of the hop
+ * table.  Attached to a serial reader with TMR_phaseCalAttach(), it
+ * is subtracted from the phase of each read as the read is parsed,
+ * with one table lookup, so read listeners, TMR_getNextTag() and the
+ * localization engines all see corrected phase.
+ *
+ * The offsets are learned from a reference tag standing at a known
+ * distance from each antenna: a TMR_PhaseCalLearner averages, per
+ * antenna and channel, how far the tag's phase is from the phase that
+ * distance gives, and TMR_phaseCalLearnFinish() adds the averages to
+ * the table.  Reads parsed with a table attached are already corrected
+ * by it, so learning again with the table attached refines it; clear
+ * it first, or learn with it detached, to start over.  Tables persist
+ * as text with TMR_phaseCalSave() and TMR_phaseCalLoad().
+ *
+ * Offsets are whole degrees, the resolution of the phase metadata.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_PHASE_CAL
+
+/**
+ * Phase offsets by antenna and channel.  Channels are a grid of
+ * stepKhz from baseKhz; a read off the grid, on an antenna above
+ * TMR_PHASE_CAL_MAX_ANTENNAS or without phase and frequency metadata
+ * is left as it is.
+ **/
+typedef struct TMR_PhaseCal
+{
+  /** Phase values wrap at this many degrees */
+  uint16_t turn;
+  /** Frequency of channel 0, kHz */
+  uint32_t baseKhz;
+  /** Spacing of the channels, kHz */
+  uint32_t stepKhz;
+  /** Number of channels */
+  uint16_t channels;
+  /**
+   * Offset of each antenna and channel, degrees below a turn, at
+   * [antenna * channels + channel]; 0 where nothing was learned
+   */
+  uint16_t offset[(TMR_PHASE_CAL_MAX_ANTENNAS + 1) * TMR_PHASE_CAL_MAX_CHANNELS];
+  /** Reads corrected */
+  uint64_t corrected;
+  /** Reads left as they were */
+  uint64_t skipped;
+} TMR_PhaseCal;
+
+/**
+ * Offsets being learned from a reference tag, see
+ * TMR_phaseCalLearnInit().
+ **/
+typedef struct TMR_PhaseCalLearner
+{
+  /** @private The table whose grid the learner follows */
+  const TMR_PhaseCal *cal;
+  /** The reference tag */
+  TMR_TagData reference;
+  /**
+   * Distance of the reference tag from each antenna, metres, by
+   * port; 0 for an antenna not to calibrate
+   */
+  double distance[TMR_PHASE_CAL_MAX_ANTENNAS + 1];
+  /** Fewest reads of a channel for its offset to be used (default 4) */
+  uint32_t minReads;
+  /** @private Reads of each antenna and channel */
+  uint32_t count[(TMR_PHASE_CAL_MAX_ANTENNAS + 1) * TMR_PHASE_CAL_MAX_CHANNELS];
+  /** @private Circular mean of the phase errors, degrees */
+  double mean[(TMR_PHASE_CAL_MAX_ANTENNAS + 1) * TMR_PHASE_CAL_MAX_CHANNELS];
+  /** Reads of the reference tag taken in */
+  uint64_t reads;
+} TMR_PhaseCalLearner;
+
+/**
+ * Start an empty table for a hop table.  The channels are the
+ * narrowest grid that holds every frequency in it.
+ *
+ * @param cal The table to initialize
+ * @param turn Phase values wrap at this many degrees, 180 for the M6e
+ * @param frequencies The hop table, kHz, in any order
+ * @param count Number of frequencies
+ * @return TMR_ERROR_INVALID if the grid would need more than
+ *         TMR_PHASE_CAL_MAX_CHANNELS channels or turn is 0
+ **/
+TMR_Status TMR_phaseCalInit(TMR_PhaseCal *cal, uint16_t turn, const uint32_t *frequencies,
+                            uint32_t count);
+
+/**
+ * Set every offset back to 0.
+ *
+ * @param cal The table
+ **/
+void TMR_phaseCalClear(TMR_PhaseCal *cal);
+
+/**
+ * Correct the phase of each read a serial reader parses from now on.
+ * The table is read, not copied: keep it until it is detached and
+ * don't change it while reads are being parsed.
+ *
+ * @param reader The reader
+ * @param cal The table, or NULL to detach the one attached
+ * @return TMR_ERROR_UNSUPPORTED for a reader other than a serial reader
+ **/
+TMR_Status TMR_phaseCalAttach(TMR_Reader *reader, TMR_PhaseCal *cal);
+
+/**
+ * Correct one read, as the parse path does.
+ *
+ * @param cal The table
+ * @param read The read
+ **/
+void TMR_phaseCalApply(TMR_PhaseCal *cal, TMR_TagReadData *read);
+
+/**
+ * Start learning a table's offsets from a reference tag.  Set the
+ * distances from the antennas before adding reads.
+ *
+ * @param learner The learner to initialize
+ * @param cal The table, for its grid
+ * @param reference The reference tag
+ **/
+void TMR_phaseCalLearnInit(TMR_PhaseCalLearner *learner, const TMR_PhaseCal *cal,
+                           const TMR_TagData *reference);
+
+/**
+ * Take in a read.  Reads of other tags, on antennas without a
+ * distance or off the grid are left out.
+ *
+ * @param learner The learner
+ * @param read The read
+ **/
+void TMR_phaseCalLearnAdd(TMR_PhaseCalLearner *learner, const TMR_TagReadData *read);
+
+/**
+ * Add what has been learned to a table: each antenna and channel with
+ * at least minReads reads has its mean error added to its offset.
+ *
+ * @param learner The learner
+ * @param cal The table the learner was started for
+ * @param[out] cells Antennas and channels updated, or NULL
+ * @return TMR_ERROR_INVALID if cal isn't the learner's table
+ **/
+TMR_Status TMR_phaseCalLearnFinish(const TMR_PhaseCalLearner *learner, TMR_PhaseCal *cal,
+                                   uint32_t *cells);
+
+#ifdef TMR_ENABLE_STDIO
+/**
+ * Write a table to a file, as text: the grid, then a line of
+ * antenna, frequency and offset for each offset that isn't 0.
+ *
+ * @param cal The table
+ * @param path The file
+ * @return TMR_ERROR_TRYAGAIN if the file couldn't be written
+ **/
+TMR_Status TMR_phaseCalSave(const TMR_PhaseCal *cal, const char *path);
+
+/**
+ * Read a table written by TMR_phaseCalSave(), grid and all.
+ *
+ * @param cal The table to initialize
+ * @param path The file
+ * @return TMR_ERROR_NOT_FOUND if the file couldn't be opened,
+ *         TMR_ERROR_INVALID if it isn't a table
+ **/
+TMR_Status TMR_phaseCalLoad(TMR_PhaseCal *cal, const char *path);
+#endif
+
+#endif /* TMR_ENABLE_PHASE_CAL */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_PHASE_CAL_H */
@@ -0,0 +1,256 @@
+/**
+ *  @file tmr_pipeline_stats.c
+ *  @brief Mercury API - Host-side read pipeline statistics
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_PIPELINE_STATS
+
+#include <string.h>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "tm_reader.h"
+
+/* Values below 2^SUB_BITS get a bucket each, larger ones 2^SUB_BITS per power of two */
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+#define STATS_ADD(p, n) ((void)__atomic_fetch_add((p), (n), __ATOMIC_RELAXED))
+#define STATS_LOAD(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define STATS_RAISE(p, v) do { \
+  uint32_t old_ = __atomic_load_n((p), __ATOMIC_RELAXED); \
+  while (((v) > old_) && \
+         !__atomic_compare_exchange_n((p), &old_, (v), true, \
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) \
+    ; \
+} while (0)
+#else
+#define STATS_ADD(p, n) ((void)(*(p) += (n)))
+#define STATS_LOAD(p) (*(p))
+#define STATS_RAISE(p, v) do { if ((v) > *(p)) *(p) = (v); } while (0)
+#endif
+
+uint64_t
+TMR__pipelineNowUs(void)
+{
+#ifdef WIN32
+  LARGE_INTEGER count, frequency;
+
+  QueryPerformanceCounter(&count);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)((count.QuadPart / frequency.QuadPart) * 1000000
+                    + ((count.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#endif
+}
+
+static int
+histogram_bucket(uint32_t value)
+{
+  int exponent;
+
+  if (value < HISTOGRAM_SUB_BUCKETS)
+  {
+    return (int)value;
+  }
+#if defined(__GNUC__)
+  exponent = 31 - __builtin_clz(value);
+#else
+  for (exponent = 31; 0 == (value >> exponent); exponent--)
+    ;
+#endif
+  return ((exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+    + (int)((value >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+}
+
+uint32_t
+TMR_histogramBucketLimit(int index)
+{
+  int shift;
+  uint64_t low;
+
+  if (index < HISTOGRAM_SUB_BUCKETS)
+  {
+    return (uint32_t)index;
+  }
+  shift = (index / HISTOGRAM_SUB_BUCKETS) - 1;
+  low = (uint64_t)(HISTOGRAM_SUB_BUCKETS + (index % HISTOGRAM_SUB_BUCKETS)) << shift;
+  return (uint32_t)(low + ((uint64_t)1 << shift) - 1);
+}
+
+void
+TMR__histogramRecord(TMR_Histogram *histogram, uint32_t value)
+{
+  STATS_ADD(&histogram->counts[histogram_bucket(value)], 1);
+  STATS_ADD(&histogram->count, 1);
+  STATS_ADD(&histogram->sum, value);
+  STATS_RAISE(&histogram->max, value);
+}
+
+uint32_t
+TMR_histogramPercentile(const TMR_Histogram *histogram, double percentile)
+{
+  uint64_t total, target, seen;
+  uint32_t limit, max;
+  int i;
+
+  total = 0;
+  for (i = 0; i < TMR_HISTOGRAM_BUCKETS; i++)
+  {
+    total += STATS_LOAD(&histogram->counts[i]);
+  }
+  if (0 == total)
+  {
+    return 0;
+  }
+
+  target = (uint64_t)((percentile / 100.0) * (double)total + 0.5);
+  if (target < 1)
+  {
+    target = 1;
+  }
+  else if (target > total)
+  {
+    target = total;
+  }
+
+  max = STATS_LOAD(&histogram->max);
+  seen = 0;
+  for (i = 0; i < TMR_HISTOGRAM_BUCKETS; i++)
+  {
+    seen += STATS_LOAD(&histogram->counts[i]);
+    if (seen >= target)
+    {
+      break;
+    }
+  }
+  limit = TMR_histogramBucketLimit(i < TMR_HISTOGRAM_BUCKETS ? i : TMR_HISTOGRAM_BUCKETS - 1);
+  return (limit < max) ? limit : max;
+}
+
+void
+TMR__pipelineGetStats(TMR_Reader *reader, TMR_PipelineStats *stats)
+{
+  /**
+   * No lock: the counters are updated with relaxed atomics by the
+   * receive and parser threads, and a snapshot a few increments
+   * behind is good enough.
+   **/
+  memcpy(stats, &reader->pipelineStats, sizeof(*stats));
+}
+
+void
+TMR__pipelineResetStats(TMR_Reader *reader)
+{
+  TMR_PipelineStats *stats = &reader->pipelineStats;
+  int i;
+
+  stats->transportBytes = 0;
+  stats->transportFrames = 0;
+  stats->crcErrors = 0;
+  stats->resyncs = 0;
+  /* queueDepth is a gauge, not a counter */
+  stats->queueHighWater = stats->queueDepth;
+  stats->enqueued = 0;
+  stats->dispatched = 0;
+  stats->queueStalls = 0;
+  stats->overflows = 0;
+  stats->drops = 0;
+  stats->duplicates = 0;
+  memset(&stats->dispatchLatencyUs, 0, sizeof(stats->dispatchLatencyUs));
+  for (i = 0; i < TMR_PIPELINE_MAX_LISTENERS; i++)
+  {
+    /* Keep the slots of listeners still registered */
+    memset(&stats->listeners[i].callbackUs, 0, sizeof(stats->listeners[i].callbackUs));
+  }
+}
+
+/**
+ * Account the time since startUs to a read listener.  Called with
+ * the listener lock held, which also guards the slot assignment.
+ **/
+void
+TMR__pipelineListenerTime(TMR_Reader *reader, const void *block, uint64_t startUs)
+{
+  TMR_ListenerStats *slot, *freeSlot;
+  uint64_t elapsed;
+  int i;
+
+  elapsed = TMR__pipelineNowUs() - startUs;
+  freeSlot = NULL;
+  for (i = 0; i < TMR_PIPELINE_MAX_LISTENERS; i++)
+  {
+    slot = &reader->pipelineStats.listeners[i];
+    if (block == slot->block)
+    {
+      break;
+    }
+    if ((NULL == slot->block) && (NULL == freeSlot))
+    {
+      freeSlot = slot;
+    }
+  }
+  if (TMR_PIPELINE_MAX_LISTENERS == i)
+  {
+    if (NULL == freeSlot)
+    {
+      /* More listeners than slots, this one isn't tracked */
+      return;
+    }
+    slot = freeSlot;
+    slot->block = block;
+  }
+  TMR__histogramRecord(&slot->callbackUs, (elapsed > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed);
+}
+
+/**
+ * Free the slot of a read listener that has been removed.  Called
+ * with the listener lock held.
+ **/
+void
+TMR__pipelineListenerRemoved(TMR_Reader *reader, const void *block)
+{
+  int i;
+
+  for (i = 0; i < TMR_PIPELINE_MAX_LISTENERS; i++)
+  {
+    if (block == reader->pipelineStats.listeners[i].block)
+    {
+      memset(&reader->pipelineStats.listeners[i], 0, sizeof(reader->pipelineStats.listeners[i]));
+      break;
+    }
+  }
+}
+
+#endif /* TMR_ENABLE_PIPELINE_STATS */
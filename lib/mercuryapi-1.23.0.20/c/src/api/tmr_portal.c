@@ -0,0 +1,519 @@
+/**
+ *  @file tmr_portal.c
+ *  @brief Mercury API - Direction of travel through portals
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_PORTAL
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_portal.h"
+#include "tmr_atomic.h"
+#include "tmr_phase.h"
+#include "tmr_tag_table.h"
+#include "osdep.h"
+
+#define PORTAL_PHASE_FLAGS (TMR_TRD_METADATA_FLAG_PHASE | TMR_TRD_METADATA_FLAG_FREQUENCY)
+
+/** What one side of a portal has seen of a tag */
+typedef struct PortalSide
+{
+  uint64_t firstUs;
+  uint64_t lastUs;
+  /** When the averaged RSSI peaked */
+  uint64_t peakUs;
+  /** When the tag started moving away, if it has */
+  uint64_t recedeUs;
+  double rssi;
+  double peakRssi;
+  double rate;
+  uint32_t reads;
+  bool receded;
+  /** The read the next phase rate is taken from */
+  uint8_t phaseAntenna;
+  uint16_t phase;
+  uint32_t phaseFrequency;
+  uint64_t phaseUs;
+} PortalSide;
+
+/** One passage of a tag through a portal, keyed by EPC and portal */
+typedef struct PortalSlot
+{
+  TMR_TagTableEntry entry;
+  uint64_t firstUs;
+  uint8_t protocol;
+  /** Outside, inside */
+  PortalSide side[2];
+} PortalSlot;
+
+/**
+ * Vote between the times the two sides saw something: in if the
+ * outside's came first by more than orderUs, out if the inside's did.
+ * A side that didn't see it at all comes last, as long as it read the
+ * tag, since then the tag reached it without the thing happening yet.
+ **/
+static int8_t
+portal_vote(const TMR_PortalEngine *engine, const PortalSlot *slot,
+            uint64_t outsideUs, bool outsideSaw, uint64_t insideUs, bool insideSaw)
+{
+  uint32_t orderUs;
+
+  orderUs = engine->config.orderUs;
+  if ((0 == slot->side[0].reads) || (0 == slot->side[1].reads))
+  {
+    return 0;
+  }
+  if (outsideSaw && insideSaw)
+  {
+    if (insideUs > outsideUs + orderUs)
+    {
+      return 1;
+    }
+    if (outsideUs > insideUs + orderUs)
+    {
+      return -1;
+    }
+    return 0;
+  }
+  if (outsideSaw)
+  {
+    return 1;
+  }
+  if (insideSaw)
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Decide a passage and report it; the slot is left to the caller.
+ **/
+static void
+portal_decide(TMR_PortalEngine *engine, PortalSlot *slot, uint64_t timeUs)
+{
+  TMR_PortalConfig *config;
+  TMR_PortalDecision decision;
+  TMR_TagData tag;
+  const PortalSide *out, *in;
+  double weights;
+
+  config = &engine->config;
+  out = &slot->side[0];
+  in = &slot->side[1];
+
+  memset(&tag, 0, sizeof(tag));
+  tag.protocol = (TMR_TagProtocol)slot->protocol;
+  tag.epcByteCount = slot->entry.epcByteCount;
+  memcpy(tag.epc, slot->entry.epc, slot->entry.epcByteCount);
+
+  decision.portal = (uint8_t)slot->entry.extra;
+  decision.tag = &tag;
+  decision.orderVote = portal_vote(engine, slot, out->firstUs, true, in->firstUs, true);
+  decision.peakVote = portal_vote(engine, slot, out->peakUs, true, in->peakUs, true);
+  decision.dopplerVote = portal_vote(engine, slot, out->recedeUs, out->receded,
+                                     in->recedeUs, in->receded);
+  weights = config->orderWeight + config->peakWeight + config->dopplerWeight;
+  decision.score = (config->orderWeight * decision.orderVote
+                    + config->peakWeight * decision.peakVote
+                    + config->dopplerWeight * decision.dopplerVote) / weights;
+  if (decision.score >= config->minScore)
+  {
+    decision.direction = TMR_PORTAL_IN;
+  }
+  else if (decision.score <= -config->minScore)
+  {
+    decision.direction = TMR_PORTAL_OUT;
+  }
+  else
+  {
+    decision.direction = TMR_PORTAL_UNKNOWN;
+  }
+  decision.firstUs = slot->firstUs;
+  decision.lastUs = slot->entry.lastUs;
+  decision.timeUs = timeUs;
+  decision.outsideReads = out->reads;
+  decision.insideReads = in->reads;
+
+  engine->decisions[decision.direction]++;
+  engine->listener(engine->reader, &decision, engine->cookie);
+}
+
+/** Start a passage in a slot */
+static void
+portal_begin(TMR_PortalEngine *engine, PortalSlot *slot, const TMR_TagData *tag,
+             uint8_t portal, uint64_t now)
+{
+  TMR_tagTableClaim(&engine->table, &slot->entry, tag, portal);
+  slot->entry.lastUs = now;
+  slot->firstUs = now;
+  slot->protocol = (uint8_t)tag->protocol;
+}
+
+/**
+ * Find a tag's passage through a portal, starting one in an empty
+ * slot, or in the one read longest ago if it isn't there.
+ **/
+static PortalSlot *
+portal_find(TMR_PortalEngine *engine, const TMR_TagData *tag, uint8_t portal, uint64_t now)
+{
+  PortalSlot *slot;
+  bool found;
+
+  slot = (PortalSlot *)TMR_tagTableFind(&engine->table, tag, portal, true, &found);
+  if (found)
+  {
+    return slot;
+  }
+  if (0 != slot->entry.key)
+  {
+    if (now - slot->entry.lastUs < engine->config.leaveUs)
+    {
+      engine->evictions++;
+    }
+    portal_decide(engine, slot, now);
+  }
+  portal_begin(engine, slot, tag, portal, now);
+  engine->passages = engine->table.used;
+  return slot;
+}
+
+/** Fold a read's phase into a side's phase rate */
+static void
+portal_phase(TMR_PortalEngine *engine, PortalSide *side, const TMR_TagReadData *read,
+             uint64_t now)
+{
+  uint64_t dt;
+  double rate, alpha;
+
+  if ((side->phaseAntenna == read->antenna) && (side->phaseFrequency == read->frequency))
+  {
+    dt = now - side->phaseUs;
+    if (dt < engine->config.phaseBaseUs)
+    {
+      return;
+    }
+    if (dt <= engine->config.phaseGapUs)
+    {
+      rate = TMR_phaseWrap((double)read->phase - side->phase, engine->config.phaseTurn)
+             * 1e6 / (double)dt;
+      alpha = (double)dt / (double)(engine->config.averageUs + dt);
+      side->rate += alpha * (rate - side->rate);
+      if (!side->receded && (side->rate >= engine->config.recedeRate))
+      {
+        side->receded = true;
+        side->recedeUs = now;
+      }
+    }
+  }
+  side->phaseAntenna = read->antenna;
+  side->phaseFrequency = read->frequency;
+  side->phase = read->phase;
+  side->phaseUs = now;
+}
+
+/** Whether a passage's tag has left the portal */
+static bool
+portal_gone(const TMR_PortalEngine *engine, const PortalSlot *slot, uint64_t now)
+{
+  return (0 != slot->entry.key) && (now > slot->entry.lastUs)
+         && (now - slot->entry.lastUs >= engine->config.leaveUs);
+}
+
+/** Check the next few slots for tags that have left */
+static void
+portal_sweepSome(TMR_PortalEngine *engine, uint64_t now, uint32_t count)
+{
+  PortalSlot *slot;
+  uint32_t i;
+
+  for (i = 0; i < count; i++)
+  {
+    slot = (PortalSlot *)TMR_tagTableAt(&engine->table, engine->cursor);
+    if (portal_gone(engine, slot, now))
+    {
+      /* Look at the slot again, another passage may have moved into it */
+      portal_decide(engine, slot, now);
+      TMR_tagTableRemove(&engine->table, &slot->entry);
+      engine->passages = engine->table.used;
+    }
+    else
+    {
+      engine->cursor = (engine->cursor + 1) & (engine->config.slots - 1);
+    }
+  }
+}
+
+void
+TMR_portalAddRead(TMR_PortalEngine *engine, const TMR_TagReadData *read)
+{
+  TMR_PortalConfig *config;
+  PortalSlot *slot;
+  PortalSide *side;
+  uint64_t now, dt;
+  uint8_t role;
+  double alpha;
+
+  config = &engine->config;
+  role = config->role[read->antenna];
+  if (TMR_PORTAL_ROLE_NONE == role)
+  {
+    engine->skipped++;
+    return;
+  }
+  now = ((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) * 1000;
+
+  pthread_mutex_lock(&engine->lock);
+  engine->reads++;
+  engine->nowUs = (now > engine->nowUs) ? now : engine->nowUs;
+  portal_sweepSome(engine, now, config->sweepPerRead);
+
+  slot = portal_find(engine, &read->tag, config->portal[read->antenna], now);
+  if ((now > slot->firstUs) && (now - slot->firstUs >= config->windowUs))
+  {
+    portal_decide(engine, slot, now);
+    portal_begin(engine, slot, &read->tag, (uint8_t)slot->entry.extra, now);
+  }
+
+  side = &slot->side[role - 1];
+  if (0 == side->reads)
+  {
+    side->firstUs = now;
+    side->rssi = read->rssi;
+    side->peakRssi = read->rssi;
+    side->peakUs = now;
+  }
+  else
+  {
+    dt = (now > side->lastUs) ? now - side->lastUs : 0;
+    alpha = (double)dt / (double)(config->averageUs + dt);
+    side->rssi += alpha * (read->rssi - side->rssi);
+    if (side->rssi > side->peakRssi)
+    {
+      side->peakRssi = side->rssi;
+      side->peakUs = now;
+    }
+  }
+  if (PORTAL_PHASE_FLAGS == (read->metadataFlags & PORTAL_PHASE_FLAGS))
+  {
+    portal_phase(engine, side, read, now);
+  }
+  side->reads++;
+  side->lastUs = (now > side->lastUs) ? now : side->lastUs;
+  slot->entry.lastUs = (now > slot->entry.lastUs) ? now : slot->entry.lastUs;
+  pthread_mutex_unlock(&engine->lock);
+}
+
+uint32_t
+TMR_portalSweep(TMR_PortalEngine *engine, uint64_t nowUs)
+{
+  PortalSlot *slot;
+  uint64_t before, after, now;
+  uint32_t i;
+
+  pthread_mutex_lock(&engine->lock);
+  before = 0;
+  for (i = 0; i < TMR_PORTAL_DIRECTIONS; i++)
+  {
+    before += engine->decisions[i];
+  }
+  now = (0 == nowUs) ? engine->nowUs : nowUs;
+  for (i = 0; i < engine->config.slots; i++)
+  {
+    slot = (PortalSlot *)TMR_tagTableAt(&engine->table, i);
+    while (portal_gone(engine, slot, now))
+    {
+      portal_decide(engine, slot, now);
+      TMR_tagTableRemove(&engine->table, &slot->entry);
+    }
+  }
+  engine->passages = engine->table.used;
+  after = 0;
+  for (i = 0; i < TMR_PORTAL_DIRECTIONS; i++)
+  {
+    after += engine->decisions[i];
+  }
+  pthread_mutex_unlock(&engine->lock);
+  return (uint32_t)(after - before);
+}
+
+static void
+portal_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_portalAddRead(cookie, t);
+}
+
+/** Sweeps on the clock the reader timestamps reads by */
+static void *
+portal_sweepThread(void *arg)
+{
+  TMR_PortalEngine *engine;
+
+  engine = arg;
+  while (TMR__LOAD_ACQUIRE(bool, &engine->sweeping))
+  {
+    tmr_sleep(engine->config.sweepMs);
+    TMR_portalSweep(engine, tmr_gettime() * 1000);
+  }
+  return NULL;
+}
+
+void
+TMR_portalInitConfig(TMR_PortalConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->slots = 4096;
+  config->windowUs = 10000000;
+  config->leaveUs = 100000;
+  config->averageUs = 50000;
+  config->orderUs = 20000;
+  config->phaseTurn = 180;
+  config->phaseBaseUs = 5000;
+  config->phaseGapUs = 30000;
+  config->recedeRate = 300;
+  config->orderWeight = 1;
+  config->peakWeight = 1;
+  config->dopplerWeight = 1;
+  config->minScore = 0.5;
+  config->sweepPerRead = 4;
+  config->sweepMs = 50;
+}
+
+TMR_Status
+TMR_portalSetAntenna(TMR_PortalConfig *config, uint8_t antenna, uint8_t portal,
+                     TMR_PortalRole role)
+{
+  if ((TMR_PORTAL_MAX_PORTALS <= portal) || (TMR_PORTAL_ROLE_INSIDE < role))
+  {
+    return TMR_ERROR_INVALID;
+  }
+  config->portal[antenna] = portal;
+  config->role[antenna] = (uint8_t)role;
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_portalStart(TMR_Reader *reader, TMR_PortalEngine *engine,
+                const TMR_PortalConfig *config,
+                TMR_PortalListener listener, void *cookie)
+{
+  TMR_Status ret;
+  uint8_t sides[TMR_PORTAL_MAX_PORTALS];
+  bool complete;
+  int i;
+
+  /* At least one portal has to have antennas on both sides */
+  memset(sides, 0, sizeof(sides));
+  complete = false;
+  for (i = 0; i < 256; i++)
+  {
+    if (TMR_PORTAL_ROLE_NONE != config->role[i])
+    {
+      sides[config->portal[i]] |= config->role[i];
+      complete = complete || (3 == sides[config->portal[i]]);
+    }
+  }
+  if ((NULL == listener) || !complete || (0 == config->windowUs)
+      || (0 == config->leaveUs) || (0 == config->averageUs) || (0 == config->phaseTurn)
+      || (config->phaseBaseUs > config->phaseGapUs)
+      || (0 >= config->orderWeight + config->peakWeight + config->dopplerWeight))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->config = *config;
+  engine->listener = listener;
+  engine->cookie = cookie;
+  ret = TMR_tagTableInit(&engine->table, config->slots, sizeof(PortalSlot));
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  pthread_mutex_init(&engine->lock, NULL);
+
+  if (NULL != reader)
+  {
+    engine->reader = reader;
+    engine->readListener.listener = portal_readListener;
+    engine->readListener.cookie = engine;
+    ret = TMR_addReadListener(reader, &engine->readListener);
+    if ((TMR_SUCCESS == ret) && (0 != config->sweepMs))
+    {
+      TMR__STORE_RELEASE(bool, &engine->sweeping, true);
+      if (0 != pthread_create(&engine->sweepThread, NULL, portal_sweepThread, engine))
+      {
+        engine->sweeping = false;
+        TMR_removeReadListener(reader, &engine->readListener);
+        ret = TMR_ERROR_NO_THREADS;
+      }
+    }
+    if (TMR_SUCCESS != ret)
+    {
+      pthread_mutex_destroy(&engine->lock);
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_portalStop(TMR_PortalEngine *engine)
+{
+  PortalSlot *slot;
+  uint32_t i;
+
+  if (NULL != engine->reader)
+  {
+    TMR_removeReadListener(engine->reader, &engine->readListener);
+  }
+  if (TMR__LOAD_ACQUIRE(bool, &engine->sweeping))
+  {
+    TMR__STORE_RELEASE(bool, &engine->sweeping, false);
+    pthread_join(engine->sweepThread, NULL);
+  }
+
+  /* What is still here is decided as of the last read */
+  for (i = 0; i < engine->config.slots; i++)
+  {
+    slot = (PortalSlot *)TMR_tagTableAt(&engine->table, i);
+    while (0 != slot->entry.key)
+    {
+      portal_decide(engine, slot, engine->nowUs);
+      TMR_tagTableRemove(&engine->table, &slot->entry);
+    }
+  }
+  engine->passages = 0;
+  engine->reader = NULL;
+  pthread_mutex_destroy(&engine->lock);
+  TMR_tagTableDestroy(&engine->table);
+}
+
+#endif /* TMR_ENABLE_PORTAL */
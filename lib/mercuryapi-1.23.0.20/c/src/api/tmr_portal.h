@@ -0,0 +1,280 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_PORTAL_H
+#define _TMR_PORTAL_H
+/**
+ *  @file tmr_portal.h
+ *  @brief Mercury API - Direction of travel through portals
+ *
+ * A portal is a doorway with antennas on its outside and its inside.
+ * A tag carried through it is read by both sides, and which side had
+ * it first tells which way it went.  The engine follows each tag's
+ * passage through each portal on the read stream and, once the tag has
+ * been unread for leaveUs, decides its direction from three votes
+ * between the sides:
+ *
+ *  - order: the side that read the tag first, by more than orderUs;
+ *  - peak: the side whose RSSI, averaged over averageUs, peaked first,
+ *    by more than orderUs, as the tag passes closest to each side's
+ *    antennas in turn;
+ *  - Doppler: the side the tag started moving away from first, by more
+ *    than orderUs.  The phase of a tag grows with its distance, so it
+ *    falls as the tag comes closer to an antenna and rises once it has
+ *    passed; the rate is taken from reads on the same antenna and
+ *    frequency, as in tmr_events.h.
+ *
+ * Each vote is for in (outside first), out or neither, and the
+ * weighted sum of the votes is the decision's score.  A passage longer
+ * than windowUs is decided when the window ends and the tag starts a
+ * new one.
+ *
+ * Passages are kept in an open addressing table sized when the engine
+ * starts, looked up by a hash of the EPC and portal, and swept for
+ * tags that have left on every read and, with a reader, by a thread
+ * every sweepMs, so decisions come out within leaveUs plus sweepMs of
+ * the tag's last read.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_tag_table.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_PORTAL
+
+/**
+ * Which side of its portal an antenna covers.
+ **/
+typedef enum TMR_PortalRole
+{
+  /** Not part of a portal; its reads are ignored */
+  TMR_PORTAL_ROLE_NONE = 0,
+  TMR_PORTAL_ROLE_OUTSIDE = 1,
+  TMR_PORTAL_ROLE_INSIDE = 2
+} TMR_PortalRole;
+
+/**
+ * Direction of travel.
+ **/
+typedef enum TMR_PortalDirection
+{
+  /** The votes didn't decide */
+  TMR_PORTAL_UNKNOWN = 0,
+  /** From the outside to the inside */
+  TMR_PORTAL_IN = 1,
+  /** From the inside to the outside */
+  TMR_PORTAL_OUT = 2,
+  TMR_PORTAL_DIRECTIONS = 3
+} TMR_PortalDirection;
+
+/**
+ * Engine configuration, see TMR_portalInitConfig() and
+ * TMR_portalSetAntenna().
+ **/
+typedef struct TMR_PortalConfig
+{
+  /** @private Portal of each antenna */
+  uint8_t portal[256];
+  /** @private Role of each antenna, a TMR_PortalRole */
+  uint8_t role[256];
+  /** Passages tracked at once, a power of two (default 4096) */
+  uint32_t slots;
+  /** Longest passage; a longer one is decided and starts over (default 10 s) */
+  uint32_t windowUs;
+  /** Time unread after which a tag has left the portal (default 100 ms) */
+  uint32_t leaveUs;
+  /** Time constant of the RSSI and phase rate averages (default 50 ms) */
+  uint32_t averageUs;
+  /** Times of the two sides closer than this don't vote (default 20 ms) */
+  uint32_t orderUs;
+  /** Degrees in a turn of phase as reported (default 180) */
+  uint16_t phaseTurn;
+  /** Shortest time a phase rate is taken over (default 5 ms) */
+  uint32_t phaseBaseUs;
+  /**
+   * Longest, beyond which a tag walking past may have turned the phase
+   * by half a turn (default 30 ms)
+   */
+  uint32_t phaseGapUs;
+  /** Phase rate a tag is moving away above, degrees per second (default 300) */
+  double recedeRate;
+  /** Weights of the order, peak and Doppler votes (default 1 each) */
+  double orderWeight;
+  double peakWeight;
+  double dopplerWeight;
+  /** Score a direction needs, of the sum of the weights (default 0.5) */
+  double minScore;
+  /** Slots each read checks for tags that have left (default 4) */
+  uint32_t sweepPerRead;
+  /** With a reader, how often the whole table is swept (default 50 ms, 0 for never) */
+  uint32_t sweepMs;
+} TMR_PortalConfig;
+
+/**
+ * The direction of one passage.
+ **/
+typedef struct TMR_PortalDecision
+{
+  /** The portal */
+  uint8_t portal;
+  /** The tag */
+  const TMR_TagData *tag;
+  /** Which way it went */
+  TMR_PortalDirection direction;
+  /** Weighted votes over the sum of the weights, -1 (out) to 1 (in) */
+  double score;
+  /** The order, peak and Doppler votes: 1 for in, -1 for out, 0 for neither */
+  int8_t orderVote;
+  int8_t peakVote;
+  int8_t dopplerVote;
+  /** First and last read of the passage, microseconds on the read timestamp clock */
+  uint64_t firstUs;
+  uint64_t lastUs;
+  /** When it was decided, on the same clock */
+  uint64_t timeUs;
+  /** Reads on the outside and inside antennas */
+  uint32_t outsideReads;
+  uint32_t insideReads;
+} TMR_PortalDecision;
+
+/**
+ * Called with each decision.
+ *
+ * @param reader The reader given to TMR_portalStart(), or NULL
+ * @param decision The decision; the tag is only valid during the call
+ * @param cookie The cookie given to TMR_portalStart()
+ **/
+typedef void (*TMR_PortalListener)(TMR_Reader *reader, const TMR_PortalDecision *decision,
+                                   void *cookie);
+
+/**
+ * A portal engine, see TMR_portalStart().
+ **/
+typedef struct TMR_PortalEngine
+{
+  /** @private */
+  TMR_PortalConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_PortalListener listener;
+  /** @private */
+  void *cookie;
+  /** @private Passage table */
+  TMR_TagTable table;
+  /** @private Next slot the per read sweep checks */
+  uint32_t cursor;
+  /** @private Latest read time seen */
+  uint64_t nowUs;
+  /** @private Serializes reads and sweeps */
+  pthread_mutex_t lock;
+  /** @private */
+  pthread_t sweepThread;
+  /** @private */
+  bool sweeping;
+  /** Reads taken in */
+  uint64_t reads;
+  /** Reads of antennas not in a portal */
+  uint64_t skipped;
+  /** Decisions, by direction */
+  uint64_t decisions[TMR_PORTAL_DIRECTIONS];
+  /** Passages decided early to make room for newer ones */
+  uint64_t evictions;
+  /** Passages in the table */
+  uint32_t passages;
+} TMR_PortalEngine;
+
+/**
+ * Fill in the default configuration, with no antennas in a portal.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_portalInitConfig(TMR_PortalConfig *config);
+
+/**
+ * Put an antenna on one side of a portal.
+ *
+ * @param config The configuration
+ * @param antenna The antenna
+ * @param portal The portal, below TMR_PORTAL_MAX_PORTALS
+ * @param role The side it covers, or TMR_PORTAL_ROLE_NONE to take it out
+ * @return TMR_ERROR_INVALID for a portal or role out of range
+ **/
+TMR_Status TMR_portalSetAntenna(TMR_PortalConfig *config, uint8_t antenna, uint8_t portal,
+                                TMR_PortalRole role);
+
+/**
+ * Start an engine, as a read listener of reader with a thread that
+ * sweeps for tags that have left every sweepMs, or to be fed with
+ * TMR_portalAddRead() and swept with TMR_portalSweep().
+ *
+ * @param reader Reader to listen to, or NULL
+ * @param engine Engine state, owned by the caller until it is stopped
+ * @param config The configuration
+ * @param listener Called with each decision
+ * @param cookie Passed to listener
+ * @return TMR_ERROR_INVALID for a bad configuration or one without a
+ *         portal with both sides
+ **/
+TMR_Status TMR_portalStart(TMR_Reader *reader, TMR_PortalEngine *engine,
+                           const TMR_PortalConfig *config,
+                           TMR_PortalListener listener, void *cookie);
+
+/**
+ * Take in a read.
+ *
+ * @param engine The engine
+ * @param read The read
+ **/
+void TMR_portalAddRead(TMR_PortalEngine *engine, const TMR_TagReadData *read);
+
+/**
+ * Decide every passage unread for leaveUs by a time.
+ *
+ * @param engine The engine
+ * @param nowUs The time, on the read timestamp clock; 0 for the
+ *              latest read seen
+ * @return Passages decided
+ **/
+uint32_t TMR_portalSweep(TMR_PortalEngine *engine, uint64_t nowUs);
+
+/**
+ * Stop the engine: remove the listener, stop the sweep thread, decide
+ * every passage still in the table and free the table.
+ *
+ * @param engine The engine
+ **/
+void TMR_portalStop(TMR_PortalEngine *engine);
+
+#endif /* TMR_ENABLE_PORTAL */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_PORTAL_H */
@@ -0,0 +1,391 @@
+/**
+ *  @file tmr_range.c
+ *  @brief Mercury API - Multi-frequency phase ranging
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_RANGING
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_range.h"
+#include "tmr_phase.h"
+#include "tmr_tag_table.h"
+
+#define RANGE_C      299792458.0
+/* Reads averaged into a channel's phase before older ones fade out */
+#define RANGE_AVERAGE 8
+
+/** The phase of a tag on one channel */
+typedef struct RangeChannel
+{
+  uint64_t lastUs;
+  /** Mean phase, degrees, 0 to phaseTurn */
+  double phase;
+  uint32_t frequency;
+  uint16_t count;
+} RangeChannel;
+
+/**
+ * One tag and antenna.  Each slot of the table is this header
+ * followed by config.channels channels, the first count of them in
+ * use and in order of frequency.
+ **/
+typedef struct RangeSlot
+{
+  /** The tag, told apart by antenna */
+  TMR_TagTableEntry entry;
+  uint8_t count;
+} RangeSlot;
+
+/**
+ * Find the slot of a tag on an antenna, taking an empty slot or the
+ * one read longest ago if it isn't there.
+ **/
+static RangeSlot *
+range_find(TMR_RangeEngine *engine, const TMR_TagData *tag, uint8_t antenna)
+{
+  RangeSlot *slot;
+  bool found;
+
+  slot = (RangeSlot *)TMR_tagTableFind(&engine->table, tag, antenna, true, &found);
+  if (!found)
+  {
+    if (0 != slot->entry.key)
+    {
+      engine->evictions++;
+    }
+    TMR_tagTableClaim(&engine->table, &slot->entry, tag, antenna);
+  }
+  return slot;
+}
+
+/** Square root by Newton's method, which keeps the library off libm */
+static double
+range_sqrt(double x)
+{
+  double r;
+  int i;
+
+  if (0 >= x)
+  {
+    return 0;
+  }
+  r = (1 < x) ? x : 1;
+  for (i = 0; i < 64; i++)
+  {
+    double next;
+
+    next = (r + x / r) / 2;
+    if (next >= r)
+    {
+      break;
+    }
+    r = next;
+  }
+  return r;
+}
+
+/**
+ * Find the channel of a frequency, making room for it in order of
+ * frequency if it isn't there.
+ **/
+static RangeChannel *
+range_channel(TMR_RangeEngine *engine, RangeSlot *slot, uint32_t frequency)
+{
+  RangeChannel *channels;
+  uint8_t i, at;
+
+  channels = (RangeChannel *)(slot + 1);
+  for (at = 0; at < slot->count; at++)
+  {
+    if (frequency == channels[at].frequency)
+    {
+      return &channels[at];
+    }
+    if (frequency < channels[at].frequency)
+    {
+      break;
+    }
+  }
+
+  /* TMR_rangeStart() makes channels at least 3, so a full slot isn't empty */
+  if ((0 < slot->count) && (slot->count == engine->config.channels))
+  {
+    uint8_t oldest;
+
+    oldest = 0;
+    for (i = 1; i < slot->count; i++)
+    {
+      if (channels[i].lastUs < channels[oldest].lastUs)
+      {
+        oldest = i;
+      }
+    }
+    memmove(&channels[oldest], &channels[oldest + 1],
+            (size_t)(slot->count - oldest - 1) * sizeof(*channels));
+    slot->count--;
+    if (oldest < at)
+    {
+      at--;
+    }
+  }
+
+  memmove(&channels[at + 1], &channels[at], (size_t)(slot->count - at) * sizeof(*channels));
+  slot->count++;
+  channels[at].frequency = frequency;
+  channels[at].count = 0;
+  channels[at].lastUs = 0;
+  channels[at].phase = 0;
+  return &channels[at];
+}
+
+/**
+ * Unwrap the recent channels of a slot across frequency and fit a
+ * line through them.
+ *
+ * @return false if there aren't minChannels of them
+ **/
+static bool
+range_fit(TMR_RangeEngine *engine, RangeSlot *slot, uint64_t now,
+          TMR_RangeResult *result)
+{
+  TMR_RangeConfig *config;
+  RangeChannel *channels;
+  double x[TMR_RANGE_MAX_CHANNELS], y[TMR_RANGE_MAX_CHANNELS];
+  double turn, meanX, meanY, sxx, sxy, ssr, slope, rms, raw;
+  uint32_t first, previous, maxGap;
+  uint8_t i, n;
+
+  config = &engine->config;
+  channels = (RangeChannel *)(slot + 1);
+  turn = config->phaseTurn;
+
+  n = 0;
+  first = 0;
+  previous = 0;
+  maxGap = 0;
+  meanX = 0;
+  meanY = 0;
+  for (i = 0; i < slot->count; i++)
+  {
+    if (channels[i].lastUs + config->maxAgeUs < now)
+    {
+      continue;
+    }
+    if (0 == n)
+    {
+      first = channels[i].frequency;
+      y[0] = channels[i].phase;
+    }
+    else
+    {
+      y[n] = y[n - 1] + TMR_phaseWrap(channels[i].phase - channels[previous].phase, turn);
+      if (channels[i].frequency - channels[previous].frequency > maxGap)
+      {
+        maxGap = channels[i].frequency - channels[previous].frequency;
+      }
+    }
+    x[n] = (double)(channels[i].frequency - first);
+    meanX += x[n];
+    meanY += y[n];
+    previous = i;
+    n++;
+  }
+  if (n < config->minChannels)
+  {
+    return false;
+  }
+
+  meanX /= n;
+  meanY /= n;
+  sxx = 0;
+  sxy = 0;
+  for (i = 0; i < n; i++)
+  {
+    sxx += (x[i] - meanX) * (x[i] - meanX);
+    sxy += (x[i] - meanX) * (y[i] - meanY);
+  }
+  slope = sxy / sxx;
+  ssr = 0;
+  for (i = 0; i < n; i++)
+  {
+    double r;
+
+    r = y[i] - meanY - slope * (x[i] - meanX);
+    ssr += r * r;
+  }
+
+  /* 720 d / c degrees per Hz, and slope is in degrees per kHz */
+  raw = RANGE_C * slope / 720000.0;
+  result->distance = raw - config->offsetM;
+  result->sigma = RANGE_C * range_sqrt(ssr / (n - 2) / sxx) / 720000.0;
+  result->maxDistance = RANGE_C * turn / (1440000.0 * maxGap);
+  /* Random phase leaves residuals of turn / sqrt(12) */
+  rms = range_sqrt(ssr / n);
+  result->confidence = 1 - rms * 3.4641016151377544 / turn;
+  if ((0 > result->confidence) || (0 > raw) || (raw > result->maxDistance))
+  {
+    result->confidence = 0;
+  }
+  result->channels = n;
+  result->spanKhz = channels[previous].frequency - first;
+  return true;
+}
+
+void
+TMR_rangeAddRead(TMR_RangeEngine *engine, const TMR_TagReadData *read)
+{
+  TMR_RangeConfig *config;
+  TMR_RangeResult result;
+  RangeSlot *slot;
+  RangeChannel *channel;
+  uint64_t now;
+  double phase;
+
+  config = &engine->config;
+  if ((0 == (read->metadataFlags & TMR_TRD_METADATA_FLAG_PHASE))
+      || (0 == (read->metadataFlags & TMR_TRD_METADATA_FLAG_FREQUENCY))
+      || (0 == read->antenna) || (0 == read->frequency))
+  {
+    engine->skipped++;
+    return;
+  }
+  engine->reads++;
+  now = ((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) * 1000;
+
+  slot = range_find(engine, &read->tag, read->antenna);
+  slot->entry.lastUs = now;
+  channel = range_channel(engine, slot, read->frequency);
+  phase = read->phase % config->phaseTurn;
+  if ((0 == channel->count) || (channel->lastUs + config->maxAgeUs < now))
+  {
+    /* New, or read too long ago to still be where the tag is */
+    channel->phase = phase;
+    channel->count = 1;
+  }
+  else
+  {
+    if (RANGE_AVERAGE > channel->count)
+    {
+      channel->count++;
+    }
+    channel->phase += TMR_phaseWrap(phase - channel->phase, config->phaseTurn) / channel->count;
+    if (0 > channel->phase)
+    {
+      channel->phase += config->phaseTurn;
+    }
+    else if (config->phaseTurn <= channel->phase)
+    {
+      channel->phase -= config->phaseTurn;
+    }
+  }
+  channel->lastUs = now;
+
+  if (range_fit(engine, slot, now, &result))
+  {
+    result.tag = &read->tag;
+    result.antenna = read->antenna;
+    result.timeUs = now;
+    engine->estimates++;
+    engine->listener(engine->reader, &result, engine->cookie);
+  }
+}
+
+static void
+range_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_rangeAddRead(cookie, t);
+}
+
+void
+TMR_rangeInitConfig(TMR_RangeConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->phaseTurn = 180;
+  config->minChannels = 4;
+  config->channels = 50;
+  config->maxAgeUs = 2000000;
+  config->slots = 1024;
+  config->offsetM = 0;
+}
+
+TMR_Status
+TMR_rangeStart(TMR_Reader *reader, TMR_RangeEngine *engine,
+               const TMR_RangeConfig *config,
+               TMR_RangeListener listener, void *cookie)
+{
+  TMR_Status ret;
+
+  if ((NULL == listener) || (0 == config->phaseTurn)
+      || (3 > config->minChannels) || (config->minChannels > config->channels)
+      || (TMR_RANGE_MAX_CHANNELS < config->channels))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(engine, 0, sizeof(*engine));
+  engine->config = *config;
+  engine->reader = reader;
+  engine->listener = listener;
+  engine->cookie = cookie;
+
+  ret = TMR_tagTableInit(&engine->table, config->slots,
+                         (uint32_t)((sizeof(RangeSlot) + config->channels * sizeof(RangeChannel) + 7)
+                                    & ~(size_t)7));
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
+  if (NULL != reader)
+  {
+    engine->readListener.listener = range_readListener;
+    engine->readListener.cookie = engine;
+    ret = TMR_addReadListener(reader, &engine->readListener);
+    if (TMR_SUCCESS != ret)
+    {
+      TMR_tagTableDestroy(&engine->table);
+      return ret;
+    }
+  }
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_rangeStop(TMR_RangeEngine *engine)
+{
+  if (NULL != engine->reader)
+  {
+    TMR_removeReadListener(engine->reader, &engine->readListener);
+    engine->reader = NULL;
+  }
+  TMR_tagTableDestroy(&engine->table);
+}
+
+#endif /* TMR_ENABLE_RANGING */
@@ -0,0 +1,206 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_RANGE_H
+#define _TMR_RANGE_H
+/**
+ *  @file tmr_range.h
+ *  @brief Mercury API - Multi-frequency phase ranging
+ *
+ * The phase of a tag's backscatter grows with the carrier frequency
+ * at a rate set by the round trip to the tag, 720 * d / c degrees per
+ * hertz.  One phase is only known modulo a turn, but the reader hops
+ * over many channels, and each read carries its frequency: keeping
+ * the phase of each tag and antenna per channel, unwrapping it across
+ * neighbouring channels and fitting a line through phase against
+ * frequency gives the distance without the ambiguity, and without
+ * pinning the hop table to one channel.
+ *
+ * The module is a read listener.  Each read with phase updates its
+ * channel and, once enough channels have been read recently, refits
+ * the line and reports a distance with its standard error and a
+ * confidence.  Tables are sized when ranging starts and nothing is
+ * allocated per read.
+ *
+ * Unwrapping assumes the phase moves less than half a turn between
+ * neighbouring channels in the fit, which holds out to maxDistance of
+ * the result: about 75 m with 500 kHz channels and the M6e's 180
+ * degree phase.  The distance includes the cables and the reader's
+ * own delay; measure it with a tag at a known distance and set
+ * offsetM.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_tag_table.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_RANGING
+
+/**
+ * Ranging configuration, see TMR_rangeInitConfig().
+ **/
+typedef struct TMR_RangeConfig
+{
+  /**
+   * Phase values wrap at this many degrees (default 180, the range
+   * of the M6e phase metadata)
+   */
+  uint16_t phaseTurn;
+  /** Fewest recently read channels to fit a distance to (3 or more, default 4) */
+  uint8_t minChannels;
+  /**
+   * Channels kept per tag and antenna, up to TMR_RANGE_MAX_CHANNELS
+   * (default 50).  When they are all in use the one read longest
+   * ago makes way.
+   */
+  uint8_t channels;
+  /**
+   * Channels not read within this long of the newest read are left
+   * out of the fit, so a moving tag is ranged from where it is now
+   * (default 2 s)
+   */
+  uint32_t maxAgeUs;
+  /**
+   * Tags and antennas tracked, a power of two (default 1024).  When
+   * the table is full the one read longest ago is forgotten.
+   */
+  uint32_t slots;
+  /** Subtracted from each distance, metres (default 0) */
+  double offsetM;
+} TMR_RangeConfig;
+
+/**
+ * One distance estimate.  Passed to the listener, valid during the
+ * call.
+ **/
+typedef struct TMR_RangeResult
+{
+  /** The tag */
+  const TMR_TagData *tag;
+  /** The antenna */
+  uint8_t antenna;
+  /** Distance from the antenna, metres, less offsetM */
+  double distance;
+  /** Standard error of distance from the fit, metres */
+  double sigma;
+  /**
+   * 0 to 1: 1 when the channels lie on the line, falling to 0 as the
+   * residuals approach those of random phase; 0 when distance is
+   * beyond maxDistance
+   */
+  double confidence;
+  /** Furthest distance the channels in the fit can unwrap, metres */
+  double maxDistance;
+  /** Channels in the fit */
+  uint8_t channels;
+  /** Lowest to highest frequency in the fit, kHz */
+  uint32_t spanKhz;
+  /** Time of the read, microseconds */
+  uint64_t timeUs;
+} TMR_RangeResult;
+
+/**
+ * Called with each estimate, from the thread that delivers the reads.
+ **/
+typedef void (*TMR_RangeListener)(TMR_Reader *reader, const TMR_RangeResult *result,
+                                  void *cookie);
+
+/**
+ * Ranging state, see TMR_rangeStart().
+ **/
+typedef struct TMR_RangeEngine
+{
+  /** @private */
+  TMR_RangeConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private */
+  TMR_RangeListener listener;
+  /** @private */
+  void *cookie;
+  /** @private */
+  TMR_TagTable table;
+  /** Reads with phase and frequency taken in */
+  uint64_t reads;
+  /** Reads without phase, frequency or antenna metadata */
+  uint64_t skipped;
+  /** Estimates reported */
+  uint64_t estimates;
+  /** Tracked tags and antennas forgotten to make room */
+  uint64_t evictions;
+} TMR_RangeEngine;
+
+/**
+ * Fill in the default configuration: 180 degree phase, 4 to 50
+ * channels, 2 s age, 1024 slots, no offset.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_rangeInitConfig(TMR_RangeConfig *config);
+
+/**
+ * Start ranging and, given a reader, add it as a read listener.
+ * Reads without phase, frequency or antenna metadata are skipped;
+ * continuous reads from an M6e carry all three.
+ *
+ * @param reader The reader, or NULL to feed it with TMR_rangeAddRead()
+ *               only
+ * @param engine Ranging state, owned by the caller until it is stopped
+ * @param config The configuration
+ * @param listener Called with each estimate
+ * @param cookie Passed to listener
+ * @return TMR_ERROR_INVALID for a bad configuration
+ **/
+TMR_Status TMR_rangeStart(TMR_Reader *reader, TMR_RangeEngine *engine,
+                          const TMR_RangeConfig *config,
+                          TMR_RangeListener listener, void *cookie);
+
+/**
+ * Take in one read, as the read listener does.  For reads from a
+ * sync read or a file; don't call it for ranging added to a reader
+ * that is reading in the background.
+ *
+ * @param engine The ranging state
+ * @param read The read
+ **/
+void TMR_rangeAddRead(TMR_RangeEngine *engine, const TMR_TagReadData *read);
+
+/**
+ * Remove the read listener and free the tables.
+ *
+ * @param engine The ranging state
+ **/
+void TMR_rangeStop(TMR_RangeEngine *engine);
+
+#endif /* TMR_ENABLE_RANGING */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_RANGE_H */
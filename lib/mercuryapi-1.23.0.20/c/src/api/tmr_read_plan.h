@@ -55,6 +55,7 @@ typedef struct TMR_ReadPlan TMR_ReadPlan;
 typedef struct TMR_SimpleReadPlan TMR_SimpleReadPlan;
 typedef struct TMR_MultiReadPlan TMR_MultiReadPlan;
 typedef struct TMR_StopOnTagCount TMR_StopOnTagCount;
+typedef struct TMR_ReportTrigger TMR_ReportTrigger;
 typedef struct TMR_TagObservationTrigger TMR_TagObservationTrigger;
 typedef struct TMR_StopTrigger TMR_StopTrigger;
 
@@ -85,6 +86,22 @@ struct TMR_StopOnTagCount
   uint32_t noOfTags;
 };
 
+/**
+ * A ReportTrigger controls how tag reads are streamed back during
+ * continuous reading on LLRP readers. The reader pushes a report
+ * every tagCount tags, and a report is requested whenever periodMs
+ * milliseconds pass without one. A zero value leaves the default
+ * behavior for that knob.
+ **/
+struct TMR_ReportTrigger
+{
+  /* Number of tags per report */
+  uint16_t tagCount;
+
+  /* Maximum milliseconds between reports */
+  uint32_t periodMs;
+};
+
 /**
  * A SimpleReadPlan contains a protocol, a list of antennas, and an
  * optional filter. The list of antennas may be an empty list, in
@@ -111,6 +128,8 @@ struct TMR_SimpleReadPlan
   bool useFastSearch;
   /** The stop N trigger */
   TMR_StopOnTagCount stopOnCount;
+  /** The report trigger used during continuous reading */
+  TMR_ReportTrigger reportTrigger;
 };
 
 /**
@@ -177,6 +196,7 @@ TMR_Status TMR_RP_set_tagop(TMR_ReadPlan *plan, TMR_TagOp *tagop);
 
 TMR_Status TMR_RP_set_useFastSearch(TMR_ReadPlan *plan, bool useFastSearch);
 TMR_Status TMR_RP_set_stopTrigger(TMR_ReadPlan *plan, uint32_t count);
+TMR_Status TMR_RP_set_reportTrigger(TMR_ReadPlan *plan, uint16_t tagCount, uint32_t periodMs);
 /**
  * @}
  */
@@ -0,0 +1,917 @@
+/**
+ *  @file tmr_readlog.c
+ *  @brief Mercury API - Columnar read log
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_READ_LOG
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tm_reader.h"
+#include "tmr_readlog.h"
+#include "osdep.h"
+
+#define READLOG_DEFAULT_CHUNK_READS 4096
+/* Times are kept below 2^54 ms, so zigzag deltas of them fit 55 bits */
+#define READLOG_TIME_MASK ((1ULL << 54) - 1)
+/* Widest column the unpacker takes */
+#define READLOG_MAX_WIDTH 56
+/* RSSI is stored biased to unsigned */
+#define READLOG_RSSI_BIAS 32768
+#define READLOG_WIDTHS_SIZE 8
+
+static void
+putLE16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 0);
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void
+putLE32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 0);
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void
+putLE64(uint8_t *p, uint64_t v)
+{
+  putLE32(p, (uint32_t)v);
+  putLE32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t
+getLE16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t
+getLE32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 0) | ((uint32_t)p[1] << 8)
+    | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t
+getLE64(const uint8_t *p)
+{
+  return getLE32(p) | ((uint64_t)getLE32(p + 4) << 32);
+}
+
+/** Bits a value takes */
+static uint8_t
+log_width(uint64_t v)
+{
+  uint8_t w;
+
+  for (w = 0; 0 != v; w++)
+  {
+    v >>= 1;
+  }
+  return w;
+}
+
+/** Bytes a column of count values of width bits takes */
+static uint64_t
+log_columnSize(uint32_t count, uint8_t width)
+{
+  return ((uint64_t)count * width + 7) / 8;
+}
+
+static uint8_t *
+log_pack(uint8_t *p, const uint64_t *values, uint32_t count, uint64_t base, uint8_t width)
+{
+  uint64_t acc;
+  uint32_t bits, i;
+
+  if (0 == width)
+  {
+    return p;
+  }
+  acc = 0;
+  bits = 0;
+  for (i = 0; i < count; i++)
+  {
+    acc |= (values[i] - base) << bits;
+    bits += width;
+    while (8 <= bits)
+    {
+      *p++ = (uint8_t)acc;
+      acc >>= 8;
+      bits -= 8;
+    }
+  }
+  if (0 != bits)
+  {
+    *p++ = (uint8_t)acc;
+  }
+  return p;
+}
+
+static const uint8_t *
+log_unpack(const uint8_t *p, uint64_t *values, uint32_t count, uint64_t base, uint8_t width)
+{
+  uint64_t acc, mask;
+  uint32_t bits, i;
+
+  if (0 == width)
+  {
+    for (i = 0; i < count; i++)
+    {
+      values[i] = base;
+    }
+    return p;
+  }
+  mask = (1ULL << width) - 1;
+  acc = 0;
+  bits = 0;
+  for (i = 0; i < count; i++)
+  {
+    while (bits < width)
+    {
+      acc |= (uint64_t)*p++ << bits;
+      bits += 8;
+    }
+    values[i] = base + (acc & mask);
+    acc >>= width;
+    bits -= width;
+  }
+  return p;
+}
+
+/** Grow an array to hold at least need elements */
+static bool
+log_grow(void **array, uint64_t *max, uint64_t need, size_t size)
+{
+  uint64_t n;
+  void *grown;
+
+  if (need <= *max)
+  {
+    return true;
+  }
+  for (n = (0 == *max) ? 64 : *max; n < need; n *= 2)
+  {
+  }
+  grown = realloc(*array, n * size);
+  if (NULL == grown)
+  {
+    return false;
+  }
+  *array = grown;
+  *max = n;
+  return true;
+}
+
+static void
+log_write(TMR_ReadLogWriter *writer, const void *data, size_t length)
+{
+  if ((TMR_SUCCESS == writer->status) && (0 != length)
+      && (length != fwrite(data, 1, length, writer->file)))
+  {
+    writer->status = TMR_ERROR_COMM_ERRNO(errno);
+  }
+  writer->bytes += length;
+}
+
+static uint32_t
+log_hash(const uint8_t *entry)
+{
+  uint32_t hash;
+  uint8_t i;
+
+  /* FNV-1a over protocol, length and EPC */
+  hash = 2166136261U;
+  for (i = 0; i < 2 + entry[1]; i++)
+  {
+    hash = (hash ^ entry[i]) * 16777619U;
+  }
+  return hash;
+}
+
+/** Rehash the dictionary into twice the slots */
+static bool
+log_rehash(TMR_ReadLogWriter *writer)
+{
+  uint32_t *hash, slots, slot, id;
+
+  slots = 2 * writer->hashSlots;
+  hash = calloc(slots, sizeof(*hash));
+  if (NULL == hash)
+  {
+    return false;
+  }
+  for (id = 0; id < writer->epcs; id++)
+  {
+    slot = log_hash(writer->dict + writer->dictOffsets[id]) & (slots - 1);
+    while (0 != hash[slot])
+    {
+      slot = (slot + 1) & (slots - 1);
+    }
+    hash[slot] = id + 1;
+  }
+  free(writer->hash);
+  writer->hash = hash;
+  writer->hashSlots = slots;
+  return true;
+}
+
+/**
+ * Number of an EPC in the dictionary, adding it if it is new.
+ *
+ * @return false if out of memory
+ **/
+static bool
+log_epcId(TMR_ReadLogWriter *writer, const TMR_TagData *tag, uint32_t *id)
+{
+  uint8_t entry[2 + TMR_MAX_EPC_BYTE_COUNT];
+  const uint8_t *known;
+  uint64_t max;
+  uint32_t slot;
+
+  entry[0] = (uint8_t)tag->protocol;
+  entry[1] = (TMR_MAX_EPC_BYTE_COUNT < tag->epcByteCount) ? TMR_MAX_EPC_BYTE_COUNT : tag->epcByteCount;
+  memcpy(entry + 2, tag->epc, entry[1]);
+
+  slot = log_hash(entry) & (writer->hashSlots - 1);
+  while (0 != writer->hash[slot])
+  {
+    *id = writer->hash[slot] - 1;
+    known = writer->dict + writer->dictOffsets[*id];
+    if (0 == memcmp(known, entry, 2 + entry[1]))
+    {
+      return true;
+    }
+    slot = (slot + 1) & (writer->hashSlots - 1);
+  }
+
+  /* New: keep the table at most half full */
+  if (2 * (uint64_t)(writer->epcs + 1) > writer->hashSlots)
+  {
+    if (!log_rehash(writer))
+    {
+      return false;
+    }
+    slot = log_hash(entry) & (writer->hashSlots - 1);
+    while (0 != writer->hash[slot])
+    {
+      slot = (slot + 1) & (writer->hashSlots - 1);
+    }
+  }
+  max = writer->dictOffsetsMax;
+  if (!log_grow((void **)&writer->dictOffsets, &max, writer->epcs + 1, sizeof(uint64_t))
+      || !log_grow((void **)&writer->dict, &writer->dictMax,
+                   writer->dictLength + 2 + entry[1], 1))
+  {
+    return false;
+  }
+  writer->dictOffsetsMax = (uint32_t)max;
+  *id = writer->epcs++;
+  writer->dictOffsets[*id] = writer->dictLength;
+  memcpy(writer->dict + writer->dictLength, entry, 2 + entry[1]);
+  writer->dictLength += 2 + entry[1];
+  writer->hash[slot] = *id + 1;
+  return true;
+}
+
+/** Write the reads taken in as a chunk */
+static void
+log_writeChunk(TMR_ReadLogWriter *writer)
+{
+  static const uint8_t padding[TMR_READLOG_ALIGN];
+  uint8_t header[TMR_READLOG_CHUNK_HEADER_SIZE];
+  uint8_t widths[READLOG_WIDTHS_SIZE];
+  uint64_t min[TMR_READLOG_COLUMNS], max[TMR_READLOG_COLUMNS];
+  uint64_t *time, prev, zigzag, maxZigzag, size;
+  int64_t delta;
+  uint32_t c, i, count;
+  uint8_t *p;
+
+  count = writer->count;
+  if (0 == count)
+  {
+    return;
+  }
+  for (c = 0; c < TMR_READLOG_COLUMNS; c++)
+  {
+    min[c] = max[c] = writer->columns[c][0];
+    for (i = 1; i < count; i++)
+    {
+      min[c] = (writer->columns[c][i] < min[c]) ? writer->columns[c][i] : min[c];
+      max[c] = (writer->columns[c][i] > max[c]) ? writer->columns[c][i] : max[c];
+    }
+  }
+
+  /* Time goes in as zigzag deltas */
+  time = writer->columns[TMR_READLOG_TIME];
+  prev = min[TMR_READLOG_TIME];
+  maxZigzag = 0;
+  for (i = 0; i < count; i++)
+  {
+    delta = (int64_t)(time[i] - prev);
+    prev = time[i];
+    zigzag = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    time[i] = zigzag;
+    maxZigzag = (zigzag > maxZigzag) ? zigzag : maxZigzag;
+  }
+
+  memset(widths, 0, sizeof(widths));
+  widths[TMR_READLOG_TIME] = log_width(maxZigzag);
+  p = log_pack(writer->packed, time, count, 0, widths[TMR_READLOG_TIME]);
+  for (c = TMR_READLOG_EPC; c < TMR_READLOG_COLUMNS; c++)
+  {
+    widths[c] = log_width(max[c] - min[c]);
+    p = log_pack(p, writer->columns[c], count, min[c], widths[c]);
+  }
+
+  size = TMR_READLOG_CHUNK_HEADER_SIZE + READLOG_WIDTHS_SIZE
+         + (writer->dictLength - writer->dictWrittenLength) + (uint64_t)(p - writer->packed);
+  size = (size + TMR_READLOG_ALIGN - 1) & ~(uint64_t)(TMR_READLOG_ALIGN - 1);
+
+  memset(header, 0, sizeof(header));
+  putLE32(header + 0, TMR_READLOG_CHUNK_MAGIC);
+  putLE32(header + 4, (uint32_t)size);
+  putLE32(header + 8, count);
+  putLE32(header + 12, writer->epcs - writer->dictWritten);
+  putLE32(header + 16, writer->dictWritten);
+  putLE32(header + 20, (uint32_t)min[TMR_READLOG_EPC]);
+  putLE32(header + 24, (uint32_t)max[TMR_READLOG_EPC]);
+  putLE32(header + 28, (uint32_t)min[TMR_READLOG_FREQUENCY]);
+  putLE32(header + 32, (uint32_t)max[TMR_READLOG_FREQUENCY]);
+  putLE16(header + 36, (uint16_t)(int16_t)((int32_t)min[TMR_READLOG_RSSI] - READLOG_RSSI_BIAS));
+  putLE16(header + 38, (uint16_t)(int16_t)((int32_t)max[TMR_READLOG_RSSI] - READLOG_RSSI_BIAS));
+  putLE64(header + 40, min[TMR_READLOG_TIME]);
+  putLE64(header + 48, max[TMR_READLOG_TIME]);
+  putLE16(header + 56, (uint16_t)min[TMR_READLOG_PHASE]);
+  putLE16(header + 58, (uint16_t)max[TMR_READLOG_PHASE]);
+  header[60] = (uint8_t)min[TMR_READLOG_ANTENNA];
+  header[61] = (uint8_t)max[TMR_READLOG_ANTENNA];
+
+  log_write(writer, header, sizeof(header));
+  log_write(writer, widths, sizeof(widths));
+  log_write(writer, writer->dict + writer->dictWrittenLength,
+            (size_t)(writer->dictLength - writer->dictWrittenLength));
+  log_write(writer, writer->packed, (size_t)(p - writer->packed));
+  log_write(writer, padding, (size_t)(size - TMR_READLOG_CHUNK_HEADER_SIZE - READLOG_WIDTHS_SIZE
+                                      - (writer->dictLength - writer->dictWrittenLength)
+                                      - (uint64_t)(p - writer->packed)));
+
+  writer->dictWritten = writer->epcs;
+  writer->dictWrittenLength = writer->dictLength;
+  writer->count = 0;
+  writer->chunks++;
+}
+
+void
+TMR_readLogAddRead(TMR_ReadLogWriter *writer, const TMR_TagReadData *read)
+{
+  uint32_t id, i;
+  int32_t rssi;
+
+  pthread_mutex_lock(&writer->lock);
+  if (NULL == writer->file)
+  {
+    pthread_mutex_unlock(&writer->lock);
+    return;
+  }
+  if (!log_epcId(writer, &read->tag, &id))
+  {
+    if (TMR_SUCCESS == writer->status)
+    {
+      writer->status = TMR_ERROR_OUT_OF_MEMORY;
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return;
+  }
+  rssi = (read->rssi < -READLOG_RSSI_BIAS) ? -READLOG_RSSI_BIAS
+         : ((read->rssi >= READLOG_RSSI_BIAS) ? READLOG_RSSI_BIAS - 1 : read->rssi);
+
+  i = writer->count++;
+  writer->columns[TMR_READLOG_TIME][i] =
+    ((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) & READLOG_TIME_MASK;
+  writer->columns[TMR_READLOG_EPC][i] = id;
+  writer->columns[TMR_READLOG_ANTENNA][i] = read->antenna;
+  writer->columns[TMR_READLOG_FREQUENCY][i] = read->frequency;
+  writer->columns[TMR_READLOG_PHASE][i] = read->phase;
+  writer->columns[TMR_READLOG_RSSI][i] = (uint64_t)(rssi + READLOG_RSSI_BIAS);
+  writer->reads++;
+  if (writer->chunkReads == writer->count)
+  {
+    log_writeChunk(writer);
+  }
+  pthread_mutex_unlock(&writer->lock);
+}
+
+static void
+log_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_readLogAddRead(cookie, t);
+}
+
+static void
+log_freeWriter(TMR_ReadLogWriter *writer)
+{
+  uint32_t c;
+
+  for (c = 0; c < TMR_READLOG_COLUMNS; c++)
+  {
+    free(writer->columns[c]);
+    writer->columns[c] = NULL;
+  }
+  free(writer->packed);
+  free(writer->hash);
+  free(writer->dict);
+  free(writer->dictOffsets);
+  writer->packed = NULL;
+  writer->hash = NULL;
+  writer->dict = NULL;
+  writer->dictOffsets = NULL;
+}
+
+TMR_Status
+TMR_readLogStart(TMR_Reader *reader, TMR_ReadLogWriter *writer,
+                 const char *path, uint32_t chunkReads)
+{
+  uint8_t header[TMR_READLOG_HEADER_SIZE];
+  TMR_Status ret;
+  bool allocated;
+  uint32_t c;
+
+  chunkReads = (0 == chunkReads) ? READLOG_DEFAULT_CHUNK_READS : chunkReads;
+  if (TMR_READLOG_MAX_CHUNK_READS < chunkReads)
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(writer, 0, sizeof(*writer));
+  writer->chunkReads = chunkReads;
+  allocated = true;
+  for (c = 0; c < TMR_READLOG_COLUMNS; c++)
+  {
+    writer->columns[c] = malloc(chunkReads * sizeof(uint64_t));
+    allocated = allocated && (NULL != writer->columns[c]);
+  }
+  /* Widest case of every column, 55 bits of time and 32 of the others but RSSI */
+  writer->packed = malloc(log_columnSize(chunkReads, 55 + 32 + 8 + 32 + 16 + 16) + 8);
+  writer->hashSlots = 1024;
+  writer->hash = calloc(writer->hashSlots, sizeof(uint32_t));
+  if (!allocated || (NULL == writer->packed) || (NULL == writer->hash))
+  {
+    log_freeWriter(writer);
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+
+  writer->file = fopen(path, "wb");
+  if (NULL == writer->file)
+  {
+    ret = TMR_ERROR_COMM_ERRNO(errno);
+    log_freeWriter(writer);
+    return ret;
+  }
+  writer->status = TMR_SUCCESS;
+
+  memset(header, 0, sizeof(header));
+  memcpy(header, TMR_READLOG_MAGIC, 8);
+  putLE32(header + 8, TMR_READLOG_VERSION);
+  putLE32(header + 12, TMR_READLOG_HEADER_SIZE);
+  putLE64(header + 16, tmr_gettime() * 1000);
+  putLE32(header + 24, chunkReads);
+  log_write(writer, header, sizeof(header));
+  if (TMR_SUCCESS != writer->status)
+  {
+    fclose(writer->file);
+    writer->file = NULL;
+    log_freeWriter(writer);
+    return writer->status;
+  }
+  pthread_mutex_init(&writer->lock, NULL);
+
+  if (NULL != reader)
+  {
+    writer->reader = reader;
+    writer->readListener.listener = log_readListener;
+    writer->readListener.cookie = writer;
+    ret = TMR_addReadListener(reader, &writer->readListener);
+    if (TMR_SUCCESS != ret)
+    {
+      pthread_mutex_destroy(&writer->lock);
+      fclose(writer->file);
+      writer->file = NULL;
+      log_freeWriter(writer);
+      return ret;
+    }
+  }
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_readLogFlush(TMR_ReadLogWriter *writer)
+{
+  TMR_Status ret;
+
+  pthread_mutex_lock(&writer->lock);
+  if (NULL != writer->file)
+  {
+    log_writeChunk(writer);
+    if ((0 != fflush(writer->file)) && (TMR_SUCCESS == writer->status))
+    {
+      writer->status = TMR_ERROR_COMM_ERRNO(errno);
+    }
+  }
+  ret = writer->status;
+  pthread_mutex_unlock(&writer->lock);
+  return ret;
+}
+
+TMR_Status
+TMR_readLogStop(TMR_ReadLogWriter *writer)
+{
+  if (NULL == writer->file)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  if (NULL != writer->reader)
+  {
+    TMR_removeReadListener(writer->reader, &writer->readListener);
+    writer->reader = NULL;
+  }
+  pthread_mutex_lock(&writer->lock);
+  log_writeChunk(writer);
+  if ((0 != fclose(writer->file)) && (TMR_SUCCESS == writer->status))
+  {
+    writer->status = TMR_ERROR_COMM_ERRNO(errno);
+  }
+  writer->file = NULL;
+  pthread_mutex_unlock(&writer->lock);
+  pthread_mutex_destroy(&writer->lock);
+  log_freeWriter(writer);
+  return writer->status;
+}
+
+static void
+log_parseChunk(const uint8_t *p, uint64_t offset, TMR_ReadLogChunk *chunk)
+{
+  chunk->offset = offset;
+  chunk->size = getLE32(p + 4);
+  chunk->count = getLE32(p + 8);
+  chunk->dictCount = getLE32(p + 12);
+  chunk->dictFirst = getLE32(p + 16);
+  chunk->minEpc = getLE32(p + 20);
+  chunk->maxEpc = getLE32(p + 24);
+  chunk->minFrequency = getLE32(p + 28);
+  chunk->maxFrequency = getLE32(p + 32);
+  chunk->minRssi = (int16_t)getLE16(p + 36);
+  chunk->maxRssi = (int16_t)getLE16(p + 38);
+  chunk->minTimeMs = getLE64(p + 40);
+  chunk->maxTimeMs = getLE64(p + 48);
+  chunk->minPhase = getLE16(p + 56);
+  chunk->maxPhase = getLE16(p + 58);
+  chunk->minAntenna = p[60];
+  chunk->maxAntenna = p[61];
+}
+
+/**
+ * Check the chunk at offset and add its EPCs to the index.
+ *
+ * @return false if it isn't a whole, valid chunk
+ **/
+static bool
+log_indexChunk(TMR_ReadLog *log, uint64_t offset, uint64_t *epcMax, TMR_ReadLogChunk *chunk)
+{
+  const uint8_t *p, *end;
+  uint64_t columns;
+  uint32_t i, c;
+
+  if (TMR_READLOG_CHUNK_HEADER_SIZE + READLOG_WIDTHS_SIZE > log->length - offset)
+  {
+    return false;
+  }
+  p = log->map + offset;
+  log_parseChunk(p, offset, chunk);
+  if ((TMR_READLOG_CHUNK_MAGIC != getLE32(p)) || (0 == chunk->count)
+      || (log->chunkReads < chunk->count)
+      || (TMR_READLOG_CHUNK_HEADER_SIZE + READLOG_WIDTHS_SIZE > chunk->size)
+      || (chunk->size > log->length - offset)
+      || (0 != (chunk->size % TMR_READLOG_ALIGN)) || (log->epcs != chunk->dictFirst)
+      || (chunk->minTimeMs > chunk->maxTimeMs))
+  {
+    return false;
+  }
+  end = p + chunk->size;
+  p += TMR_READLOG_CHUNK_HEADER_SIZE;
+  columns = 0;
+  for (c = 0; c < TMR_READLOG_COLUMNS; c++)
+  {
+    if (READLOG_MAX_WIDTH < p[c])
+    {
+      return false;
+    }
+    columns += log_columnSize(chunk->count, p[c]);
+  }
+  p += READLOG_WIDTHS_SIZE;
+
+  for (i = 0; i < chunk->dictCount; i++)
+  {
+    if ((2 > end - p) || (TMR_MAX_EPC_BYTE_COUNT < p[1]) || (2 + p[1] > end - p))
+    {
+      return false;
+    }
+    if (!log_grow((void **)&log->epcOffsets, epcMax, log->epcs + 1, sizeof(uint64_t)))
+    {
+      return false;
+    }
+    log->epcOffsets[log->epcs++] = (uint64_t)(p - log->map);
+    p += 2 + p[1];
+  }
+  if ((columns > (uint64_t)(end - p)) || (chunk->maxEpc >= log->epcs)
+      || (chunk->minEpc > chunk->maxEpc))
+  {
+    return false;
+  }
+  return true;
+}
+
+TMR_Status
+TMR_readLogOpen(TMR_ReadLog *log, const char *path)
+{
+  TMR_ReadLogChunk chunk;
+  struct stat st;
+  uint64_t offset, chunkMax, epcMax;
+  uint32_t headerSize;
+  void *map;
+  int fd;
+
+  memset(log, 0, sizeof(*log));
+  fd = open(path, O_RDONLY);
+  if (-1 == fd)
+  {
+    return TMR_ERROR_COMM_ERRNO(errno);
+  }
+  if ((0 != fstat(fd, &st)) || (TMR_READLOG_HEADER_SIZE > st.st_size))
+  {
+    close(fd);
+    return TMR_ERROR_INVALID;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == map)
+  {
+    return TMR_ERROR_COMM_ERRNO(errno);
+  }
+  log->map = map;
+  log->length = st.st_size;
+
+  headerSize = getLE32(log->map + 12);
+  log->startTimeUs = getLE64(log->map + 16);
+  log->chunkReads = getLE32(log->map + 24);
+  if ((0 != memcmp(log->map, TMR_READLOG_MAGIC, 8))
+      || (TMR_READLOG_VERSION != getLE32(log->map + 8))
+      || (TMR_READLOG_HEADER_SIZE > headerSize) || (0 != (headerSize % TMR_READLOG_ALIGN))
+      || (0 == log->chunkReads) || (TMR_READLOG_MAX_CHUNK_READS < log->chunkReads))
+  {
+    TMR_readLogClose(log);
+    return TMR_ERROR_INVALID;
+  }
+
+  chunkMax = epcMax = 0;
+  for (offset = headerSize; offset < log->length; offset += chunk.size)
+  {
+    if (!log_indexChunk(log, offset, &epcMax, &chunk)
+        || !log_grow((void **)&log->chunkOffsets, &chunkMax, log->chunks + 1, sizeof(uint64_t)))
+    {
+      log->truncated = true;
+      break;
+    }
+    log->chunkOffsets[log->chunks++] = offset;
+    log->reads += chunk.count;
+    log->minTimeMs = ((1 == log->chunks) || (chunk.minTimeMs < log->minTimeMs))
+                     ? chunk.minTimeMs : log->minTimeMs;
+    log->maxTimeMs = (chunk.maxTimeMs > log->maxTimeMs) ? chunk.maxTimeMs : log->maxTimeMs;
+  }
+
+  log->columns = malloc((size_t)log->chunkReads * TMR_READLOG_COLUMNS * sizeof(uint64_t));
+  if (NULL == log->columns)
+  {
+    TMR_readLogClose(log);
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_readLogChunk(const TMR_ReadLog *log, uint32_t index, TMR_ReadLogChunk *chunk)
+{
+  if (index >= log->chunks)
+  {
+    return TMR_ERROR_NO_TAGS;
+  }
+  log_parseChunk(log->map + log->chunkOffsets[index], log->chunkOffsets[index], chunk);
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_readLogEpc(const TMR_ReadLog *log, uint32_t index, TMR_TagData *tag)
+{
+  const uint8_t *p;
+
+  if (index >= log->epcs)
+  {
+    return TMR_ERROR_NO_TAGS;
+  }
+  p = log->map + log->epcOffsets[index];
+  tag->protocol = (TMR_TagProtocol)p[0];
+  tag->epcByteCount = p[1];
+  memcpy(tag->epc, p + 2, p[1]);
+  return TMR_SUCCESS;
+}
+
+void
+TMR_readLogInitQuery(TMR_ReadLogQuery *query)
+{
+  memset(query, 0, sizeof(*query));
+  query->tag = NULL;
+  query->minTimeMs = 0;
+  query->maxTimeMs = UINT64_MAX;
+  query->minAntenna = 0;
+  query->maxAntenna = 255;
+  query->minFrequency = 0;
+  query->maxFrequency = UINT32_MAX;
+  query->minRssi = INT16_MIN;
+  query->maxRssi = INT16_MAX;
+}
+
+uint64_t
+TMR_readLogScan(TMR_ReadLog *log, const TMR_ReadLogQuery *query,
+                TMR_ReadLogListener listener, void *cookie)
+{
+  TMR_TagReadData trd;
+  TMR_ReadLogChunk chunk;
+  const uint8_t *p, *widths;
+  uint64_t *column[TMR_READLOG_COLUMNS];
+  uint64_t matched, time, zigzag, base;
+  uint32_t index, epc, lastEpc, i, c;
+  int32_t rssi;
+
+  log->chunksScanned = 0;
+  log->chunksSkipped = 0;
+  for (c = 0; c < TMR_READLOG_COLUMNS; c++)
+  {
+    column[c] = log->columns + (size_t)c * log->chunkReads;
+  }
+
+  /* A tag is looked for by its number in the dictionary */
+  epc = 0;
+  if (NULL != query->tag)
+  {
+    for (epc = 0; epc < log->epcs; epc++)
+    {
+      p = log->map + log->epcOffsets[epc];
+      if ((query->tag->epcByteCount == p[1])
+          && (0 == memcmp(query->tag->epc, p + 2, p[1])))
+      {
+        break;
+      }
+    }
+    if (epc == log->epcs)
+    {
+      log->chunksSkipped = log->chunks;
+      return 0;
+    }
+  }
+
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ANTENNAID | TMR_TRD_METADATA_FLAG_FREQUENCY
+                      | TMR_TRD_METADATA_FLAG_TIMESTAMP | TMR_TRD_METADATA_FLAG_PHASE
+                      | TMR_TRD_METADATA_FLAG_RSSI | TMR_TRD_METADATA_FLAG_PROTOCOL;
+  lastEpc = UINT32_MAX;
+  matched = 0;
+  for (index = 0; index < log->chunks; index++)
+  {
+    TMR_readLogChunk(log, index, &chunk);
+    if ((chunk.maxTimeMs < query->minTimeMs) || (chunk.minTimeMs > query->maxTimeMs)
+        || (chunk.maxAntenna < query->minAntenna) || (chunk.minAntenna > query->maxAntenna)
+        || (chunk.maxFrequency < query->minFrequency)
+        || (chunk.minFrequency > query->maxFrequency)
+        || (chunk.maxRssi < query->minRssi) || (chunk.minRssi > query->maxRssi)
+        || ((NULL != query->tag) && ((epc < chunk.minEpc) || (epc > chunk.maxEpc))))
+    {
+      log->chunksSkipped++;
+      continue;
+    }
+    log->chunksScanned++;
+
+    p = log->map + chunk.offset + TMR_READLOG_CHUNK_HEADER_SIZE;
+    widths = p;
+    p += READLOG_WIDTHS_SIZE;
+    for (i = 0; i < chunk.dictCount; i++)
+    {
+      p += 2 + p[1];
+    }
+    for (c = 0; c < TMR_READLOG_COLUMNS; c++)
+    {
+      switch (c)
+      {
+        case TMR_READLOG_TIME:
+          base = 0;
+          break;
+        case TMR_READLOG_EPC:
+          base = chunk.minEpc;
+          break;
+        case TMR_READLOG_ANTENNA:
+          base = chunk.minAntenna;
+          break;
+        case TMR_READLOG_FREQUENCY:
+          base = chunk.minFrequency;
+          break;
+        case TMR_READLOG_PHASE:
+          base = chunk.minPhase;
+          break;
+        default:
+          base = (uint64_t)(chunk.minRssi + READLOG_RSSI_BIAS);
+          break;
+      }
+      p = log_unpack(p, column[c], chunk.count, base, widths[c]);
+    }
+
+    time = chunk.minTimeMs;
+    for (i = 0; i < chunk.count; i++)
+    {
+      zigzag = column[TMR_READLOG_TIME][i];
+      time += (uint64_t)((int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1));
+      rssi = (int32_t)column[TMR_READLOG_RSSI][i] - READLOG_RSSI_BIAS;
+      if (((NULL != query->tag) && (epc != column[TMR_READLOG_EPC][i]))
+          || (time < query->minTimeMs) || (time > query->maxTimeMs)
+          || (column[TMR_READLOG_ANTENNA][i] < query->minAntenna)
+          || (column[TMR_READLOG_ANTENNA][i] > query->maxAntenna)
+          || (column[TMR_READLOG_FREQUENCY][i] < query->minFrequency)
+          || (column[TMR_READLOG_FREQUENCY][i] > query->maxFrequency)
+          || (rssi < query->minRssi) || (rssi > query->maxRssi)
+          || (column[TMR_READLOG_EPC][i] >= log->epcs))
+      {
+        continue;
+      }
+      if (lastEpc != column[TMR_READLOG_EPC][i])
+      {
+        lastEpc = (uint32_t)column[TMR_READLOG_EPC][i];
+        TMR_readLogEpc(log, lastEpc, &trd.tag);
+      }
+      trd.timestampHigh = (uint32_t)(time >> 32);
+      trd.timestampLow = (uint32_t)time;
+      trd.antenna = (uint8_t)column[TMR_READLOG_ANTENNA][i];
+      trd.frequency = (uint32_t)column[TMR_READLOG_FREQUENCY][i];
+      trd.phase = (uint16_t)column[TMR_READLOG_PHASE][i];
+      trd.rssi = rssi;
+      matched++;
+      listener(&trd, cookie);
+    }
+  }
+  return matched;
+}
+
+void
+TMR_readLogClose(TMR_ReadLog *log)
+{
+  if (NULL != log->map)
+  {
+    munmap((void *)log->map, log->length);
+  }
+  free(log->chunkOffsets);
+  free(log->epcOffsets);
+  free(log->columns);
+  memset(log, 0, sizeof(*log));
+}
+
+#endif /* TMR_ENABLE_READ_LOG */
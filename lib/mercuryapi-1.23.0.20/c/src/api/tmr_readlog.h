@@ -0,0 +1,341 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_READLOG_H
+#define _TMR_READLOG_H
+/**
+ *  @file tmr_readlog.h
+ *  @brief Mercury API - Columnar read log
+ *
+ * Writes the read stream to a compact binary file, and scans it back
+ * in place through a memory map.  Each read keeps its time (to the
+ * millisecond), EPC and protocol, antenna, carrier frequency, phase
+ * and RSSI, in about 4 to 6 bytes where a line of text takes 50.
+ *
+ * File layout, all integers little-endian:
+ *
+ *   file header      TMR_READLOG_HEADER_SIZE bytes: TMR_READLOG_MAGIC,
+ *                    version, header size, wall clock start time in
+ *                    microseconds since the epoch, most reads a chunk
+ *                    holds
+ *   chunks           each TMR_READLOG_ALIGN aligned:
+ *     header         TMR_READLOG_CHUNK_HEADER_SIZE bytes, see
+ *                    TMR_ReadLogChunk, with the minimum and maximum of
+ *                    every column over the chunk
+ *     widths         one byte per column, the bits each value takes,
+ *                    padded to 8 bytes
+ *     dictionary     the EPCs first read in this chunk, each a protocol
+ *                    byte, a length byte and the EPC; EPCs are numbered
+ *                    from 0 in the order they appear in the file
+ *     columns        time, EPC number, antenna, frequency, phase and
+ *                    RSSI, each count values of its width packed least
+ *                    significant bit first, to a whole byte
+ *
+ * The time column holds the difference of each read's time from the
+ * one before (from the chunk's minimum for the first), zigzag encoded
+ * so reads out of order still pack; the others hold each value less
+ * the chunk's minimum.  A scan uses the minima and maxima to skip the
+ * chunks a query can't match without unpacking them.
+ *
+ * A file cut short, by a crash while writing, reads up to its last
+ * whole chunk.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef TMR_ENABLE_READ_LOG
+#include <stdio.h>
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_READ_LOG
+
+/** First bytes of every read log */
+#define TMR_READLOG_MAGIC "TMRLOG\r\n"
+/** Read log format version written by this library */
+#define TMR_READLOG_VERSION 1
+/** Alignment of every chunk in the file */
+#define TMR_READLOG_ALIGN 8
+/** Size of the file header */
+#define TMR_READLOG_HEADER_SIZE 32
+/** Size of the header of each chunk */
+#define TMR_READLOG_CHUNK_HEADER_SIZE 64
+/** First bytes of every chunk, "CHNK" */
+#define TMR_READLOG_CHUNK_MAGIC 0x4b4e4843
+/** Most reads a chunk may hold */
+#define TMR_READLOG_MAX_CHUNK_READS 1048576
+
+/** The columns of a chunk, in file order */
+typedef enum TMR_ReadLogColumn
+{
+  TMR_READLOG_TIME = 0,
+  TMR_READLOG_EPC = 1,
+  TMR_READLOG_ANTENNA = 2,
+  TMR_READLOG_FREQUENCY = 3,
+  TMR_READLOG_PHASE = 4,
+  TMR_READLOG_RSSI = 5,
+  TMR_READLOG_COLUMNS = 6
+} TMR_ReadLogColumn;
+
+/**
+ * A chunk header: where it is, what it holds and its index.
+ **/
+typedef struct TMR_ReadLogChunk
+{
+  /** Offset of the chunk in the file */
+  uint64_t offset;
+  /** Size of the chunk in bytes, padding included */
+  uint32_t size;
+  /** Reads in the chunk */
+  uint32_t count;
+  /** EPCs first read in the chunk, and the number of the first of them */
+  uint32_t dictCount;
+  uint32_t dictFirst;
+  /** Range of each column over the chunk */
+  uint32_t minEpc, maxEpc;
+  uint32_t minFrequency, maxFrequency;
+  int16_t minRssi, maxRssi;
+  uint64_t minTimeMs, maxTimeMs;
+  uint16_t minPhase, maxPhase;
+  uint8_t minAntenna, maxAntenna;
+} TMR_ReadLogChunk;
+
+/**
+ * A read log being written, see TMR_readLogStart().
+ **/
+typedef struct TMR_ReadLogWriter
+{
+  /** @private */
+  FILE *file;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private Serializes reads, flushes and stopping */
+  pthread_mutex_t lock;
+  /** @private */
+  uint32_t chunkReads;
+  /** @private Reads in the chunk being built */
+  uint32_t count;
+  /** @private Its columns, values as they go in the file before packing */
+  uint64_t *columns[TMR_READLOG_COLUMNS];
+  /** @private Packed columns of the chunk being written */
+  uint8_t *packed;
+  /** @private EPC numbers by hash of the EPC, plus one; 0 for empty */
+  uint32_t *hash;
+  /** @private */
+  uint32_t hashSlots;
+  /** @private Dictionary entries as they go in the file */
+  uint8_t *dict;
+  /** @private */
+  uint64_t dictLength;
+  /** @private */
+  uint64_t dictMax;
+  /** @private Offset of each EPC's entry in dict */
+  uint64_t *dictOffsets;
+  /** @private */
+  uint32_t dictOffsetsMax;
+  /** @private First EPC not yet written, and where its entry starts */
+  uint32_t dictWritten;
+  /** @private */
+  uint64_t dictWrittenLength;
+  /** Reads taken in */
+  uint64_t reads;
+  /** Chunks written */
+  uint32_t chunks;
+  /** Distinct EPCs */
+  uint32_t epcs;
+  /** Bytes written */
+  uint64_t bytes;
+  /** First error writing the file, reported by TMR_readLogStop() */
+  TMR_Status status;
+} TMR_ReadLogWriter;
+
+/**
+ * Start a read log, as a read listener of reader, or to be fed with
+ * TMR_readLogAddRead().
+ *
+ * @param reader Reader to log the reads of, or NULL
+ * @param writer Writer state, owned by the caller until it is stopped
+ * @param path The file to create
+ * @param chunkReads Most reads in a chunk, 0 for 4096
+ * @return TMR_ERROR_COMM_ERRNO status if the file can't be created
+ **/
+TMR_Status TMR_readLogStart(TMR_Reader *reader, TMR_ReadLogWriter *writer,
+                            const char *path, uint32_t chunkReads);
+
+/**
+ * Take in a read.  Its timestamp is kept to the millisecond, below
+ * 2^54 ms, and its RSSI within 16 bits.
+ *
+ * @param writer The writer
+ * @param read The read
+ **/
+void TMR_readLogAddRead(TMR_ReadLogWriter *writer, const TMR_TagReadData *read);
+
+/**
+ * Write the reads taken in so far as a chunk, so they are in the file
+ * if the process dies.
+ *
+ * @param writer The writer
+ * @return The first error writing the file
+ **/
+TMR_Status TMR_readLogFlush(TMR_ReadLogWriter *writer);
+
+/**
+ * Stop logging: remove the listener, write the last chunk and close
+ * the file.
+ *
+ * @param writer The writer
+ * @return The first error writing the file
+ **/
+TMR_Status TMR_readLogStop(TMR_ReadLogWriter *writer);
+
+/**
+ * What a scan matches; every read within all the ranges given.
+ * See TMR_readLogInitQuery().
+ **/
+typedef struct TMR_ReadLogQuery
+{
+  /** The tag, or NULL (default) for every tag */
+  const TMR_TagData *tag;
+  /** Times, milliseconds (default all) */
+  uint64_t minTimeMs, maxTimeMs;
+  /** Antennas (default all) */
+  uint8_t minAntenna, maxAntenna;
+  /** Frequencies, kHz (default all) */
+  uint32_t minFrequency, maxFrequency;
+  /** RSSI, dBm (default all) */
+  int16_t minRssi, maxRssi;
+} TMR_ReadLogQuery;
+
+/**
+ * Called with each read a scan matches, in file order.
+ *
+ * @param read The read, with its tag, time, antenna, frequency, phase
+ *             and RSSI; only valid during the call
+ * @param cookie The cookie given to TMR_readLogScan()
+ **/
+typedef void (*TMR_ReadLogListener)(const TMR_TagReadData *read, void *cookie);
+
+/**
+ * A read log opened for scanning, see TMR_readLogOpen().
+ **/
+typedef struct TMR_ReadLog
+{
+  /** @private */
+  const uint8_t *map;
+  /** @private */
+  uint64_t length;
+  /** @private Offset of each chunk */
+  uint64_t *chunkOffsets;
+  /** @private Offset of each EPC's dictionary entry */
+  uint64_t *epcOffsets;
+  /** @private Unpacked columns of one chunk */
+  uint64_t *columns;
+  /** Wall clock time the log started, microseconds since the epoch */
+  uint64_t startTimeUs;
+  /** Most reads a chunk holds */
+  uint32_t chunkReads;
+  /** Whole chunks in the file */
+  uint32_t chunks;
+  /** Reads in them */
+  uint64_t reads;
+  /** Distinct EPCs */
+  uint32_t epcs;
+  /** Range of times over the file, milliseconds */
+  uint64_t minTimeMs, maxTimeMs;
+  /** True if the file ends in part of a chunk */
+  bool truncated;
+  /** Chunks the last scan unpacked, and skipped by their index */
+  uint32_t chunksScanned;
+  uint32_t chunksSkipped;
+} TMR_ReadLog;
+
+/**
+ * Map a read log and index its chunks and EPCs.
+ *
+ * @param log Log state, owned by the caller until it is closed
+ * @param path The file
+ * @return TMR_ERROR_COMM_ERRNO status if it can't be opened,
+ *         TMR_ERROR_INVALID if it is not a read log this library can
+ *         read
+ **/
+TMR_Status TMR_readLogOpen(TMR_ReadLog *log, const char *path);
+
+/**
+ * Get a chunk's header.
+ *
+ * @param log The log
+ * @param index The chunk, from 0
+ * @param[out] chunk Its header
+ * @return TMR_ERROR_NO_TAGS past the last chunk
+ **/
+TMR_Status TMR_readLogChunk(const TMR_ReadLog *log, uint32_t index, TMR_ReadLogChunk *chunk);
+
+/**
+ * Get an EPC from the log's dictionary.
+ *
+ * @param log The log
+ * @param index The EPC's number, from 0
+ * @param[out] tag The EPC and protocol
+ * @return TMR_ERROR_NO_TAGS past the last EPC
+ **/
+TMR_Status TMR_readLogEpc(const TMR_ReadLog *log, uint32_t index, TMR_TagData *tag);
+
+/**
+ * Fill in a query that matches every read.
+ *
+ * @param query The query to initialize
+ **/
+void TMR_readLogInitQuery(TMR_ReadLogQuery *query);
+
+/**
+ * Pass every read a query matches to a listener.
+ *
+ * @param log The log
+ * @param query The query
+ * @param listener Called with each read
+ * @param cookie Passed to listener
+ * @return Reads matched
+ **/
+uint64_t TMR_readLogScan(TMR_ReadLog *log, const TMR_ReadLogQuery *query,
+                         TMR_ReadLogListener listener, void *cookie);
+
+/**
+ * Unmap a read log and free its index.
+ *
+ * @param log The log
+ **/
+void TMR_readLogClose(TMR_ReadLog *log);
+
+#endif /* TMR_ENABLE_READ_LOG */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_READLOG_H */
@@ -0,0 +1,366 @@
+/**
+ *  @file tmr_schedule.c
+ *  @brief Mercury API - Antenna round-robin read scheduling
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_ANTENNA_SCHEDULE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_schedule.h"
+#include "tmr_tag_table.h"
+#ifdef TMR_ENABLE_SERIAL_READER
+#include "serial_reader_imp.h"
+#endif
+
+/** One tag and when it was last read on each antenna of the schedule */
+typedef struct ScheduleSlot
+{
+  TMR_TagTableEntry entry;
+  uint64_t seenUs[TMR_SCHEDULE_MAX_ANTENNAS];
+} ScheduleSlot;
+
+/**
+ * Find a tag's slot, taking an empty one or the one read longest ago
+ * if it isn't there.
+ **/
+static ScheduleSlot *
+schedule_find(TMR_Schedule *schedule, const TMR_TagData *tag)
+{
+  ScheduleSlot *slot;
+  bool found;
+
+  slot = (ScheduleSlot *)TMR_tagTableFind(&schedule->table, tag, 0, true, &found);
+  if (!found)
+  {
+    if (0 != slot->entry.key)
+    {
+      schedule->evictions++;
+    }
+    TMR_tagTableClaim(&schedule->table, &slot->entry, tag, 0);
+  }
+  return slot;
+}
+
+void
+TMR_scheduleAddRead(TMR_Schedule *schedule, const TMR_TagReadData *read)
+{
+  ScheduleSlot *slot;
+  uint64_t now, other;
+  uint32_t gap, bin;
+  uint8_t self, i;
+
+  self = schedule->position[read->antenna];
+  now = TMR_readClockTime(&schedule->clock, schedule->config.moduleTime, read);
+  if ((0 == self) || (0 == now))
+  {
+    schedule->skipped++;
+    return;
+  }
+  self--;
+  schedule->reads++;
+
+  slot = schedule_find(schedule, &read->tag);
+  other = 0;
+  for (i = 0; i < schedule->config.antennaCount; i++)
+  {
+    if ((i != self) && (slot->seenUs[i] > other))
+    {
+      other = slot->seenUs[i];
+    }
+  }
+  slot->seenUs[self] = now;
+  slot->entry.lastUs = now;
+
+  if ((0 == other) || (now < other) || (now - other > schedule->config.maxGapUs))
+  {
+    schedule->unpaired++;
+    return;
+  }
+  gap = (uint32_t)(now - other);
+  bin = gap / schedule->config.binUs;
+  bin = (TMR_SCHEDULE_HISTOGRAM_BINS <= bin) ? TMR_SCHEDULE_HISTOGRAM_BINS - 1 : bin;
+  schedule->histogram[bin]++;
+  schedule->pairs++;
+  schedule->totalUs += gap;
+  schedule->maxUs = (gap > schedule->maxUs) ? gap : schedule->maxUs;
+}
+
+uint32_t
+TMR_scheduleLatencyUs(const TMR_Schedule *schedule, double percent)
+{
+  uint64_t target, count;
+  uint32_t bin;
+
+  if (0 == schedule->pairs)
+  {
+    return 0;
+  }
+  percent = (0 > percent) ? 0 : ((100 < percent) ? 100 : percent);
+  target = (uint64_t)(schedule->pairs * percent / 100 + 0.5);
+  target = (0 == target) ? 1 : target;
+  count = 0;
+  for (bin = 0; bin < TMR_SCHEDULE_HISTOGRAM_BINS - 1; bin++)
+  {
+    count += schedule->histogram[bin];
+    if (count >= target)
+    {
+      return bin * schedule->config.binUs;
+    }
+  }
+  return schedule->maxUs;
+}
+
+void
+TMR_scheduleReset(TMR_Schedule *schedule)
+{
+  schedule->reads = 0;
+  schedule->skipped = 0;
+  schedule->pairs = 0;
+  schedule->unpaired = 0;
+  schedule->evictions = 0;
+  schedule->totalUs = 0;
+  schedule->maxUs = 0;
+  memset(schedule->histogram, 0, sizeof(schedule->histogram));
+  TMR_tagTableClear(&schedule->table);
+}
+
+static void
+schedule_readListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_scheduleAddRead(cookie, t);
+}
+
+void
+TMR_scheduleInitConfig(TMR_ScheduleConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->tagCount = 4;
+  config->filter = NULL;
+  config->q = -1;
+  config->session = TMR_GEN2_SESSION_S0;
+  config->target = TMR_GEN2_TARGET_AB;
+  config->settlingUs = 0;
+  config->dwellMs = 0;
+  config->rounds = 2;
+  config->slotUs = 500;
+  config->maxGapUs = 1000000;
+  config->binUs = 1000;
+  config->slots = 1024;
+  config->moduleTime = false;
+}
+
+#ifdef TMR_ENABLE_SERIAL_READER
+/**
+ * Set the settling time of the ports behind the schedule's antennas,
+ * keeping their powers and the other ports as they are.
+ **/
+static TMR_Status
+schedule_setSettling(TMR_Reader *reader, const TMR_ScheduleConfig *config)
+{
+  TMR_SR_PortPowerAndSettlingTime ports[TMR_SR_MAX_ANTENNA_PORTS];
+  TMR_AntennaMapList *map;
+  TMR_Status ret;
+  uint8_t count, i, j, k;
+
+  count = TMR_SR_MAX_ANTENNA_PORTS;
+  ret = TMR_SR_cmdGetAntennaPortPowersAndSettlingTime(reader, &count, ports);
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+  map = reader->u.serialReader.txRxMap;
+  for (i = 0; i < config->antennaCount; i++)
+  {
+    for (j = 0; (j < map->len) && (config->antennas[i] != map->list[j].antenna); j++)
+      ;
+    if (j == map->len)
+    {
+      return TMR_ERROR_NO_ANTENNA;
+    }
+    for (k = 0; (k < count) && (map->list[j].txPort != ports[k].port); k++)
+      ;
+    if (k == count)
+    {
+      if (TMR_SR_MAX_ANTENNA_PORTS == count)
+      {
+        return TMR_ERROR_TOO_BIG;
+      }
+      ports[k].port = map->list[j].txPort;
+      ports[k].readPower = 0;
+      ports[k].writePower = 0;
+      count++;
+    }
+    ports[k].settlingTime = config->settlingUs;
+  }
+  return TMR_SR_cmdSetAntennaPortPowersAndSettlingTime(reader, count, ports);
+}
+
+/**
+ * Gen2 session, target and Q, settling times, the read plan and the
+ * background read on and off times, in that order.
+ **/
+static TMR_Status
+schedule_apply(TMR_Reader *reader, TMR_Schedule *schedule)
+{
+  TMR_ScheduleConfig *config;
+  TMR_GEN2_Q q;
+  TMR_Status ret;
+  uint32_t offTime;
+
+  config = &schedule->config;
+  ret = TMR_paramSet(reader, TMR_PARAM_GEN2_SESSION, &config->session);
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_paramSet(reader, TMR_PARAM_GEN2_TARGET, &config->target);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    q.type = TMR_SR_GEN2_Q_STATIC;
+    q.u.staticQ.initialQ = schedule->q;
+    ret = TMR_paramSet(reader, TMR_PARAM_GEN2_Q, &q);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    ret = schedule_setSettling(reader, config);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    memcpy(schedule->planAntennas, config->antennas, config->antennaCount);
+    ret = TMR_RP_init_simple(&schedule->plan, config->antennaCount, schedule->planAntennas,
+                             TMR_TAG_PROTOCOL_GEN2, 1000);
+  }
+  if ((TMR_SUCCESS == ret) && (NULL != config->filter))
+  {
+    ret = TMR_RP_set_filter(&schedule->plan, config->filter);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_paramSet(reader, TMR_PARAM_READ_PLAN, &schedule->plan);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_paramSet(reader, TMR_PARAM_READ_ASYNCONTIME, &schedule->onTimeMs);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    offTime = 0;
+    ret = TMR_paramSet(reader, TMR_PARAM_READ_ASYNCOFFTIME, &offTime);
+  }
+  return ret;
+}
+#endif /* TMR_ENABLE_SERIAL_READER */
+
+TMR_Status
+TMR_scheduleStart(TMR_Reader *reader, TMR_Schedule *schedule,
+                  const TMR_ScheduleConfig *config)
+{
+  TMR_Status ret;
+  uint32_t dwellUs;
+  uint8_t i, q;
+
+  if ((2 > config->antennaCount) || (TMR_SCHEDULE_MAX_ANTENNAS < config->antennaCount)
+      || (15 < config->q) || (0 == config->binUs)
+      || ((0 == config->dwellMs) && ((0 == config->rounds) || (0 == config->slotUs))))
+  {
+    return TMR_ERROR_INVALID;
+  }
+#ifdef TMR_ENABLE_SERIAL_READER
+  if ((NULL != reader) && (TMR_READER_TYPE_SERIAL != reader->readerType))
+#else
+  if (NULL != reader)
+#endif
+  {
+    return TMR_ERROR_UNSUPPORTED;
+  }
+
+  memset(schedule, 0, sizeof(*schedule));
+  schedule->config = *config;
+  for (i = 0; i < config->antennaCount; i++)
+  {
+    if ((0 == config->antennas[i]) || (0 != schedule->position[config->antennas[i]]))
+    {
+      return TMR_ERROR_INVALID;
+    }
+    schedule->position[config->antennas[i]] = (uint8_t)(i + 1);
+  }
+
+  /* About one slot per tag makes the rounds shortest for the reads they give */
+  for (q = 0; (q < 15) && ((1U << q) < config->tagCount); q++)
+    ;
+  schedule->q = (0 <= config->q) ? (uint8_t)config->q : q;
+  schedule->dwellMs = config->dwellMs;
+  if (0 == schedule->dwellMs)
+  {
+    dwellUs = config->rounds * (1U << schedule->q) * config->slotUs + config->settlingUs;
+    schedule->dwellMs = (dwellUs + 999) / 1000;
+  }
+  schedule->onTimeMs = schedule->dwellMs * config->antennaCount;
+
+  ret = TMR_tagTableInit(&schedule->table, config->slots, sizeof(ScheduleSlot));
+  if (TMR_SUCCESS != ret)
+  {
+    return ret;
+  }
+
+  if (NULL != reader)
+  {
+#ifdef TMR_ENABLE_SERIAL_READER
+    ret = schedule_apply(reader, schedule);
+#else
+    ret = TMR_ERROR_UNSUPPORTED;
+#endif
+    if (TMR_SUCCESS == ret)
+    {
+      schedule->readListener.listener = schedule_readListener;
+      schedule->readListener.cookie = schedule;
+      ret = TMR_addReadListener(reader, &schedule->readListener);
+    }
+    if (TMR_SUCCESS != ret)
+    {
+      TMR_tagTableDestroy(&schedule->table);
+      return ret;
+    }
+    schedule->reader = reader;
+  }
+
+  return TMR_SUCCESS;
+}
+
+void
+TMR_scheduleStop(TMR_Schedule *schedule)
+{
+  if (NULL != schedule->reader)
+  {
+    TMR_removeReadListener(schedule->reader, &schedule->readListener);
+    schedule->reader = NULL;
+  }
+  TMR_tagTableDestroy(&schedule->table);
+}
+
+#endif /* TMR_ENABLE_ANTENNA_SCHEDULE */
@@ -0,0 +1,214 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_SCHEDULE_H
+#define _TMR_SCHEDULE_H
+/**
+ *  @file tmr_schedule.h
+ *  @brief Mercury API - Antenna round-robin read scheduling
+ *
+ * Phase differences need reads of one tag on two antennas close
+ * together in time, but a module searching a list of antennas dwells
+ * on each for its share of the search time: with the default 250 ms
+ * on time and three antennas, a tag's reads on them are tens of
+ * milliseconds apart and it has moved in between.
+ *
+ * A schedule sets a serial reader up to go round its antennas quickly
+ * for a small set of target tags:
+ *
+ *  - Gen2 session S0 with target AB and a static Q sized to the target
+ *    tag count, so the tags answer in every short inventory round;
+ *  - the antennas' settling time, on the ports the schedule uses;
+ *  - a read plan over the antennas, in order, optionally filtered to
+ *    the target tags;
+ *  - a search time just long enough for each antenna to run a few
+ *    rounds, as the background read on time (off time 0), so the
+ *    module dwells on each antenna for about dwellMs.
+ *
+ * It then measures the pairing latency it achieves: for every read of
+ * a tag on one of the antennas, the time since the tag was last read
+ * on another of them, which is the skew a phase difference from that
+ * read would have.  The latencies go in a histogram, see
+ * TMR_scheduleLatencyUs().
+ *
+ * The reader settings are left as the schedule set them when it
+ * stops.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_tag_table.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_ANTENNA_SCHEDULE
+
+/**
+ * Schedule configuration, see TMR_scheduleInitConfig().
+ **/
+typedef struct TMR_ScheduleConfig
+{
+  /** Antennas to go round, in order */
+  uint8_t antennas[TMR_SCHEDULE_MAX_ANTENNAS];
+  /** Number of antennas, at least 2 */
+  uint8_t antennaCount;
+  /** Number of target tags, which sizes Q (default 4) */
+  uint16_t tagCount;
+  /** Filter to read the target tags only, or NULL (default) */
+  TMR_TagFilter *filter;
+  /** Static Q, or -1 (default) for the smallest with 2^Q >= tagCount */
+  int8_t q;
+  /** Gen2 session (default S0) */
+  TMR_GEN2_Session session;
+  /** Gen2 target (default AB) */
+  TMR_GEN2_Target target;
+  /** Settling time after switching to each antenna, microseconds (default 0) */
+  uint16_t settlingUs;
+  /**
+   * Dwell per antenna, milliseconds, or 0 (default) for rounds
+   * inventory rounds of 2^Q slots of slotUs, plus the settling time
+   */
+  uint32_t dwellMs;
+  /** Inventory rounds per dwell when dwellMs is 0 (default 2) */
+  uint8_t rounds;
+  /** Length of one slot of a round, microseconds (default 500) */
+  uint32_t slotUs;
+  /** Latencies longer than this are not pairs (default 1 s) */
+  uint32_t maxGapUs;
+  /** Width of a latency histogram bin, microseconds (default 1000) */
+  uint32_t binUs;
+  /** Tags tracked, a power of two (default 1024) */
+  uint32_t slots;
+  /** Time reads by the module's dspMicros instead of their timestamp */
+  bool moduleTime;
+} TMR_ScheduleConfig;
+
+/**
+ * A schedule, see TMR_scheduleStart().  The counters are written by
+ * the thread that delivers reads; read them as a snapshot.
+ **/
+typedef struct TMR_Schedule
+{
+  /** @private */
+  TMR_ScheduleConfig config;
+  /** @private */
+  TMR_Reader *reader;
+  /** @private */
+  TMR_ReadListenerBlock readListener;
+  /** @private The read plan, and the antenna list it points to */
+  TMR_ReadPlan plan;
+  /** @private */
+  uint8_t planAntennas[TMR_SCHEDULE_MAX_ANTENNAS];
+  /** @private Position of each antenna in the schedule, plus one; 0 if not in it */
+  uint8_t position[256];
+  /** @private Tag table */
+  TMR_TagTable table;
+  /** @private */
+  TMR_ReadClock clock;
+  /** Static Q set */
+  uint8_t q;
+  /** Dwell per antenna, milliseconds */
+  uint32_t dwellMs;
+  /** Search time of one pass over the antennas, milliseconds; use as the TMR_read() timeout */
+  uint32_t onTimeMs;
+  /** Reads of the scheduled antennas taken in */
+  uint64_t reads;
+  /** Reads of other antennas, or without a time */
+  uint64_t skipped;
+  /** Reads with a read of the tag on another antenna within maxGapUs */
+  uint64_t pairs;
+  /** Reads without */
+  uint64_t unpaired;
+  /** Tags dropped from the table for newer ones */
+  uint64_t evictions;
+  /** Sum of the pairing latencies, microseconds */
+  uint64_t totalUs;
+  /** Longest pairing latency, microseconds */
+  uint32_t maxUs;
+  /** Pairing latencies by binUs; the last bin takes everything longer */
+  uint32_t histogram[TMR_SCHEDULE_HISTOGRAM_BINS];
+} TMR_Schedule;
+
+/**
+ * Fill in the default configuration.  The antennas must still be set.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_scheduleInitConfig(TMR_ScheduleConfig *config);
+
+/**
+ * Set a reader up to read by a schedule and start measuring its
+ * pairing latency.  Read with TMR_startReading(), or TMR_read() with
+ * onTimeMs, afterwards.  With reader NULL nothing is set up: feed the
+ * schedule with TMR_scheduleAddRead() to measure reads from
+ * elsewhere.
+ *
+ * @param reader A connected serial reader, or NULL
+ * @param schedule Schedule state, owned by the caller until it is stopped
+ * @param config The configuration
+ * @return TMR_ERROR_INVALID for a bad configuration,
+ *         TMR_ERROR_UNSUPPORTED for a reader that isn't serial, or the
+ *         error of the setting that failed
+ **/
+TMR_Status TMR_scheduleStart(TMR_Reader *reader, TMR_Schedule *schedule,
+                             const TMR_ScheduleConfig *config);
+
+/**
+ * Take in a read, as the schedule's read listener does.
+ *
+ * @param schedule The schedule
+ * @param read The read
+ **/
+void TMR_scheduleAddRead(TMR_Schedule *schedule, const TMR_TagReadData *read);
+
+/**
+ * Pairing latency a share of the pairs are within.
+ *
+ * @param schedule The schedule
+ * @param percent Share of the pairs, 0 to 100
+ * @return The latency, to binUs, microseconds; 0 before any pair
+ **/
+uint32_t TMR_scheduleLatencyUs(const TMR_Schedule *schedule, double percent);
+
+/**
+ * Clear the latency counters and forget the tags seen.
+ *
+ * @param schedule The schedule
+ **/
+void TMR_scheduleReset(TMR_Schedule *schedule);
+
+/**
+ * Stop measuring: remove the read listener and free the tag table.
+ *
+ * @param schedule The schedule
+ **/
+void TMR_scheduleStop(TMR_Schedule *schedule);
+
+#endif /* TMR_ENABLE_ANTENNA_SCHEDULE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_SCHEDULE_H */
@@ -331,6 +331,12 @@ typedef struct TM_SR_SerialReader
   int32_t readFilterTimeout;
   /* Option to use the user specified transportTimeout */
   bool usrTimeoutEnable;
+  /* Restart continuous reading after the transport times out */
+  bool autoResume;
+#ifdef TMR_ENABLE_PHASE_CAL
+  /* Phase calibration applied to each read parsed, or NULL */
+  struct TMR_PhaseCal *phaseCal;
+#endif
   /* Enable CRC calculation */
   bool crcEnabled;
   /* TransportType */
@@ -200,6 +200,34 @@ TMR_Status TMR_SR_SerialTransportTcpNativeInit(TMR_SR_SerialTransport *transport
                                             const char *device);
 #endif /* TMR_ENABLE_SERIAL_TRANSPORT_NATIVE */
 
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_SIM
+/**
+ * Initialize a TMR_SR_SerialTransport structure with a simulated M6e
+ * module, for exercising the serial reader without hardware.
+ *
+ * @param transport The TMR_SR_SerialTransport structure to initialize.
+ * @param context A TMR_SR_SerialPortNativeContext structure for the callbacks to use.
+ * @param device The simulation options (@c /m6e?tags=100&rate=5000), see serial_transport_sim.c
+ */
+TMR_Status TMR_SR_SerialTransportSimInit(TMR_SR_SerialTransport *transport,
+                                         TMR_SR_SerialPortNativeContext *context,
+                                         const char *device);
+#endif /* TMR_ENABLE_SERIAL_TRANSPORT_SIM */
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_REPLAY
+/**
+ * Initialize a TMR_SR_SerialTransport structure with a replay of a
+ * transport capture, see tmr_capture.h.
+ *
+ * @param transport The TMR_SR_SerialTransport structure to initialize.
+ * @param context A TMR_SR_SerialPortNativeContext structure for the callbacks to use.
+ * @param device The capture path and options (@c /tmp/dock.tmrcap?speed=10), see serial_transport_replay.c
+ */
+TMR_Status TMR_SR_SerialTransportReplayInit(TMR_SR_SerialTransport *transport,
+                                            TMR_SR_SerialPortNativeContext *context,
+                                            const char *device);
+#endif /* TMR_ENABLE_SERIAL_TRANSPORT_REPLAY */
+
 #ifdef TMR_ENABLE_SERIAL_TRANSPORT_LLRP
 /**
  * Initialize a TMR_SR_SerialTransport structure with a LLRP+EAPI
@@ -213,6 +213,7 @@ typedef uint32_t TMR_Status;
 #define TMR_ERROR_LLRP_UNDEFINED_VALUE        TMR_ERROR_LLRP_SPECIFIC(9)
 #define TMR_ERROR_LLRP_READER_ERROR           TMR_ERROR_LLRP_SPECIFIC(10)
 #define TMR_ERROR_LLRP_READER_CONNECTION_LOST TMR_ERROR_LLRP_SPECIFIC(11)
+#define TMR_ERROR_LLRP_READER_CONNECTION_RESTORED TMR_ERROR_LLRP_SPECIFIC(12)
 
 #ifdef TMR_ENABLE_ERROR_STRINGS
 const char *TMR_strerror(TMR_Status status);
@@ -71,6 +71,8 @@ TMR_strerr(TMR_Reader *reader, TMR_Status status)
         return "LLRP reader unknown error";
       case TMR_ERROR_LLRP_READER_CONNECTION_LOST:
         return "LLRP reader connection lost";
+      case TMR_ERROR_LLRP_READER_CONNECTION_RESTORED:
+        return "LLRP reader connection restored, tag reads may be missing for the outage";
       case TMR_ERROR_LLRP_GETTYPEREGISTRY:
         return "LLRP Reader GetTypeRegistry Failed";
       case TMR_ERROR_LLRP_CONNECTIONFAILED:
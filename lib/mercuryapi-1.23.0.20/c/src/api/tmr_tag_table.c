@@ -0,0 +1,246 @@
+/**
+ *  @file tmr_tag_table.c
+ *  @brief Mercury API - Per tag state table
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tm_reader.h"
+#include "tmr_tag_table.h"
+
+static uint64_t
+tagtable_key(const TMR_TagData *tag, uint8_t epcLen, uint32_t extra)
+{
+  uint64_t hash;
+  uint8_t i;
+
+  /* FNV-1a over the EPC, then the extra word */
+  hash = 0xcbf29ce484222325ULL;
+  for (i = 0; i < epcLen; i++)
+  {
+    hash = (hash ^ tag->epc[i]) * 0x100000001b3ULL;
+  }
+  for (i = 0; i < 4; i++)
+  {
+    hash = (hash ^ ((extra >> (8 * i)) & 0xff)) * 0x100000001b3ULL;
+  }
+  return (0 == hash) ? 1 : hash;
+}
+
+TMR_Status
+TMR_tagTableInit(TMR_TagTable *table, uint32_t count, uint32_t slotSize)
+{
+  memset(table, 0, sizeof(*table));
+  if ((TMR_TAG_TABLE_PROBES > count) || (0 != (count & (count - 1)))
+      || (sizeof(TMR_TagTableEntry) > slotSize))
+  {
+    return TMR_ERROR_INVALID;
+  }
+  table->slots = calloc(count, slotSize);
+  if (NULL == table->slots)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  table->slotSize = slotSize;
+  table->count = count;
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_tagTableGrow(TMR_TagTable *table)
+{
+  TMR_TagTable grown;
+  TMR_TagTableEntry *entry, *slot;
+  TMR_Status ret;
+  uint32_t count, i, p;
+
+  count = table->count;
+  do
+  {
+    if (0x80000000U <= count)
+    {
+      return TMR_ERROR_TOO_BIG;
+    }
+    count *= 2;
+    ret = TMR_tagTableInit(&grown, count, table->slotSize);
+    if (TMR_SUCCESS != ret)
+    {
+      return ret;
+    }
+    for (i = 0; i < table->count; i++)
+    {
+      entry = TMR_tagTableAt(table, i);
+      if (0 == entry->key)
+      {
+        continue;
+      }
+      for (p = 0; p < TMR_TAG_TABLE_PROBES; p++)
+      {
+        slot = TMR_tagTableAt(&grown, (uint32_t)entry->key + p);
+        if (0 == slot->key)
+        {
+          break;
+        }
+      }
+      if (TMR_TAG_TABLE_PROBES == p)
+      {
+        /* A run still too long: try twice the size again */
+        TMR_tagTableDestroy(&grown);
+        break;
+      }
+      memcpy(slot, entry, table->slotSize);
+      grown.used++;
+    }
+  }
+  while (NULL == grown.slots);
+
+  free(table->slots);
+  *table = grown;
+  return TMR_SUCCESS;
+}
+
+void
+TMR_tagTableDestroy(TMR_TagTable *table)
+{
+  free(table->slots);
+  memset(table, 0, sizeof(*table));
+}
+
+void
+TMR_tagTableClear(TMR_TagTable *table)
+{
+  if (NULL != table->slots)
+  {
+    memset(table->slots, 0, (size_t)table->count * table->slotSize);
+  }
+  table->used = 0;
+}
+
+TMR_TagTableEntry *
+TMR_tagTableAt(const TMR_TagTable *table, uint32_t index)
+{
+  return (TMR_TagTableEntry *)(table->slots
+                               + (size_t)(index & (table->count - 1)) * table->slotSize);
+}
+
+TMR_TagTableEntry *
+TMR_tagTableFind(TMR_TagTable *table, const TMR_TagData *tag, uint32_t extra, bool insert,
+                 bool *found)
+{
+  TMR_TagTableEntry *entry, *oldest;
+  uint64_t key;
+  uint32_t p;
+  uint8_t epcLen;
+
+  *found = false;
+  epcLen = (TMR_MAX_EPC_BYTE_COUNT < tag->epcByteCount) ? TMR_MAX_EPC_BYTE_COUNT : tag->epcByteCount;
+  key = tagtable_key(tag, epcLen, extra);
+  oldest = NULL;
+  for (p = 0; p < TMR_TAG_TABLE_PROBES; p++)
+  {
+    entry = TMR_tagTableAt(table, (uint32_t)key + p);
+    if (0 == entry->key)
+    {
+      /* Removal keeps runs unbroken, so the tag isn't further along */
+      return insert ? entry : NULL;
+    }
+    if ((key == entry->key) && (extra == entry->extra) && (epcLen == entry->epcByteCount)
+        && (0 == memcmp(tag->epc, entry->epc, epcLen)))
+    {
+      *found = true;
+      return entry;
+    }
+    if ((NULL == oldest) || (entry->lastUs < oldest->lastUs))
+    {
+      oldest = entry;
+    }
+  }
+  return insert ? oldest : NULL;
+}
+
+void
+TMR_tagTableClaim(TMR_TagTable *table, TMR_TagTableEntry *entry, const TMR_TagData *tag,
+                  uint32_t extra)
+{
+  uint8_t epcLen;
+
+  if (0 == entry->key)
+  {
+    table->used++;
+  }
+  epcLen = (TMR_MAX_EPC_BYTE_COUNT < tag->epcByteCount) ? TMR_MAX_EPC_BYTE_COUNT : tag->epcByteCount;
+  memset(entry, 0, table->slotSize);
+  entry->key = tagtable_key(tag, epcLen, extra);
+  entry->extra = extra;
+  entry->epcByteCount = epcLen;
+  memcpy(entry->epc, tag->epc, epcLen);
+}
+
+void
+TMR_tagTableRemove(TMR_TagTable *table, TMR_TagTableEntry *entry)
+{
+  TMR_TagTableEntry *next;
+  uint32_t mask, hole, i;
+
+  /*
+   * Move later entries of the probe run back into the hole, so a
+   * lookup never stops at an empty slot short of its entry.  Entries
+   * sit at most TMR_TAG_TABLE_PROBES - 1 slots past home, so nothing
+   * further than that can belong before the hole.
+   */
+  mask = table->count - 1;
+  hole = (uint32_t)(((uint8_t *)entry - table->slots) / table->slotSize);
+  for (i = (hole + 1) & mask; ((i - hole) & mask) < TMR_TAG_TABLE_PROBES; i = (i + 1) & mask)
+  {
+    next = TMR_tagTableAt(table, i);
+    if (0 == next->key)
+    {
+      break;
+    }
+    if (((i - (uint32_t)next->key) & mask) >= ((i - hole) & mask))
+    {
+      memcpy(TMR_tagTableAt(table, hole), next, table->slotSize);
+      hole = i;
+    }
+  }
+  TMR_tagTableAt(table, hole)->key = 0;
+  table->used--;
+}
+
+uint64_t
+TMR_readClockTime(TMR_ReadClock *clock, bool moduleTime, const TMR_TagReadData *read)
+{
+  if (moduleTime)
+  {
+    if ((read->dspMicros < clock->lastDsp) && (0x80000000U < clock->lastDsp - read->dspMicros))
+    {
+      clock->dspHigh += 0x100000000ULL;
+    }
+    clock->lastDsp = read->dspMicros;
+    return clock->dspHigh + read->dspMicros;
+  }
+  return ((((uint64_t)read->timestampHigh) << 32) | read->timestampLow) * 1000;
+}
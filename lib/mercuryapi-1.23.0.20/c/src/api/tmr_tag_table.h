@@ -0,0 +1,194 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_TAG_TABLE_H
+#define _TMR_TAG_TABLE_H
+/**
+ *  @file tmr_tag_table.h
+ *  @brief Mercury API - Per tag state table
+ *
+ * The table the read stream engines, and the API-side dedup filter,
+ * keep their per tag state in.  Each slot starts with a
+ * TMR_TagTableEntry, the tag's EPC and an extra word that tells apart
+ * entries of the same tag (an antenna, a frequency, a portal),
+ * followed by the engine's own state.  Entries are found by linear probing from a FNV-1a hash of
+ * the two, at most TMR_TAG_TABLE_PROBES slots; a tag that finds none
+ * of them free takes the one read longest ago, so memory stays
+ * bounded however many tags pass by.  An owner that must not lose
+ * entries grows the table with TMR_tagTableGrow() instead.  Removing
+ * an entry moves the ones after it in the probe run back, so none is
+ * left past an empty slot.
+ *
+ * The table does no locking; the engine that owns it does.
+ *
+ * TMR_readClockTime() is the read time the engines that can go by the
+ * module's clock share.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/** Slots looked at for a tag before the one read longest ago is taken */
+#define TMR_TAG_TABLE_PROBES 8
+
+/**
+ * @private
+ * The start of every slot of a tag table.
+ **/
+typedef struct TMR_TagTableEntry
+{
+  /** Hash of the EPC and extra, 0 for an empty slot */
+  uint64_t key;
+  /** Time of the entry's last read; the oldest is taken when the table is full */
+  uint64_t lastUs;
+  /** Tells apart entries of the same EPC */
+  uint32_t extra;
+  uint8_t epcByteCount;
+  uint8_t epc[TMR_MAX_EPC_BYTE_COUNT];
+} TMR_TagTableEntry;
+
+/**
+ * @private
+ * A tag table, see TMR_tagTableInit().
+ **/
+typedef struct TMR_TagTable
+{
+  /** Slots, each slotSize bytes */
+  uint8_t *slots;
+  uint32_t slotSize;
+  /** Number of slots, a power of two */
+  uint32_t count;
+  /** Slots in use */
+  uint32_t used;
+} TMR_TagTable;
+
+/**
+ * Allocate a table of empty slots.
+ *
+ * @param table The table
+ * @param count Number of slots, a power of two of at least TMR_TAG_TABLE_PROBES
+ * @param slotSize Size of each slot, at least sizeof(TMR_TagTableEntry)
+ * @return TMR_ERROR_INVALID for a bad count or size, TMR_ERROR_OUT_OF_MEMORY
+ **/
+TMR_Status TMR_tagTableInit(TMR_TagTable *table, uint32_t count, uint32_t slotSize);
+
+/**
+ * Double a table's slots, moving every entry over, until each one is
+ * within TMR_TAG_TABLE_PROBES slots of its hash again.  Entries move,
+ * so pointers to them are stale afterwards.
+ *
+ * @param table The table
+ * @return TMR_ERROR_OUT_OF_MEMORY, leaving the table as it was, or
+ *         TMR_ERROR_TOO_BIG past 2^31 slots
+ **/
+TMR_Status TMR_tagTableGrow(TMR_TagTable *table);
+
+/**
+ * Free a table's slots.
+ *
+ * @param table The table
+ **/
+void TMR_tagTableDestroy(TMR_TagTable *table);
+
+/**
+ * Empty every slot.
+ *
+ * @param table The table
+ **/
+void TMR_tagTableClear(TMR_TagTable *table);
+
+/**
+ * Get a slot by index, taken modulo the number of slots.
+ *
+ * @param table The table
+ * @param index The slot
+ **/
+TMR_TagTableEntry *TMR_tagTableAt(const TMR_TagTable *table, uint32_t index);
+
+/**
+ * Look a tag up.
+ *
+ * @param table The table
+ * @param tag The tag
+ * @param extra What tells its entries apart
+ * @param insert Whether to give the slot to put it in if it isn't there
+ * @param[out] found Whether the entry returned is the tag's
+ * @return The tag's entry; else with insert the slot to claim with
+ *         TMR_tagTableClaim(), empty or the one read longest ago, which
+ *         the caller is done with first; else NULL
+ **/
+TMR_TagTableEntry *TMR_tagTableFind(TMR_TagTable *table, const TMR_TagData *tag,
+                                    uint32_t extra, bool insert, bool *found);
+
+/**
+ * Put a tag in a slot TMR_tagTableFind() gave, clearing the slot.
+ *
+ * @param table The table
+ * @param entry The slot
+ * @param tag The tag
+ * @param extra What tells its entries apart
+ **/
+void TMR_tagTableClaim(TMR_TagTable *table, TMR_TagTableEntry *entry, const TMR_TagData *tag,
+                       uint32_t extra);
+
+/**
+ * Remove an entry.  An entry from further along may move into its
+ * slot, so a caller walking the table looks at the slot again.
+ *
+ * @param table The table
+ * @param entry The entry
+ **/
+void TMR_tagTableRemove(TMR_TagTable *table, TMR_TagTableEntry *entry);
+
+/**
+ * @private
+ * The module's dspMicros carried past its 32-bit wrap, see
+ * TMR_readClockTime().  Zeroed, it is at the start.
+ **/
+typedef struct TMR_ReadClock
+{
+  /** Last dspMicros seen */
+  uint32_t lastDsp;
+  /** Microseconds of the wraps so far */
+  uint64_t dspHigh;
+} TMR_ReadClock;
+
+/**
+ * Time of a read, microseconds: with moduleTime the module's
+ * dspMicros, unwrapped on the clock, which the reads must reach in
+ * the order the module made them; else the read's host timestamp.
+ *
+ * @param clock The clock
+ * @param moduleTime Whether to go by the module's clock
+ * @param read The read
+ **/
+uint64_t TMR_readClockTime(TMR_ReadClock *clock, bool moduleTime, const TMR_TagReadData *read);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_TAG_TABLE_H */
@@ -0,0 +1,316 @@
+/**
+ *  @file tmr_trace.c
+ *  @brief Mercury API - Tracepoints
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_TRACE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#include "tm_reader.h"
+#include "tmr_trace.h"
+#include "tmr_atomic.h"
+#include "osdep.h"
+
+#if (TMR_TRACE_RING_SIZE & (TMR_TRACE_RING_SIZE - 1)) != 0
+#error TMR_TRACE_RING_SIZE must be a power of two
+#endif
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL __thread
+#endif
+
+/**
+ * One thread's events.  Only the owning thread writes a ring; readers
+ * copy it and then drop whatever the writer may have overwritten
+ * meanwhile.  Rings of threads that exit are kept, for their events,
+ * and handed to the next new thread.
+ **/
+typedef struct TraceRing
+{
+  struct TraceRing *next;
+  uint32_t thread;
+  bool inUse;
+  /* Number of records ever written; the next goes at head % size */
+  uint32_t head;
+  TMR_TraceRecord records[TMR_TRACE_RING_SIZE];
+} TraceRing;
+
+static pthread_once_t traceOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t traceLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t traceKey;
+static TraceRing *traceRings;
+static uint32_t traceThreads;
+static TRACE_THREAD_LOCAL TraceRing *threadRing;
+#ifdef TMR_ENABLE_STDIO
+static FILE *exceptionDump;
+#endif
+
+static const char *traceEventNames[] = {
+  "NONE",
+  "SR_SEND",
+  "SR_RECEIVE",
+  "QUEUE_ENQUEUE",
+  "QUEUE_DEQUEUE",
+  "LISTENER_ENTER",
+  "LISTENER_EXIT",
+  "LLRP_RECEIVE",
+  "EXCEPTION",
+};
+
+static uint64_t
+trace_nowUs(void)
+{
+#ifndef WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#else
+  return tmr_gettime() * 1000;
+#endif
+}
+
+static void
+trace_threadExit(void *arg)
+{
+  TraceRing *ring = arg;
+
+  pthread_mutex_lock(&traceLock);
+  ring->inUse = false;
+  pthread_mutex_unlock(&traceLock);
+}
+
+static void
+trace_init(void)
+{
+  pthread_key_create(&traceKey, trace_threadExit);
+}
+
+static TraceRing *
+trace_threadRing(void)
+{
+  TraceRing *ring;
+
+  pthread_once(&traceOnce, trace_init);
+  pthread_mutex_lock(&traceLock);
+  for (ring = traceRings; NULL != ring; ring = ring->next)
+  {
+    if (false == ring->inUse)
+    {
+      break;
+    }
+  }
+  if (NULL == ring)
+  {
+    ring = calloc(1, sizeof(*ring));
+    if (NULL == ring)
+    {
+      pthread_mutex_unlock(&traceLock);
+      return NULL;
+    }
+    ring->next = traceRings;
+    traceRings = ring;
+  }
+  ring->inUse = true;
+  ring->thread = traceThreads++;
+  pthread_mutex_unlock(&traceLock);
+
+  pthread_setspecific(traceKey, ring);
+  return ring;
+}
+
+void
+TMR__traceRecord(TMR_TraceEvent event, const void *reader, uint32_t a, uint32_t b)
+{
+  TraceRing *ring;
+  TMR_TraceRecord *r;
+  uint32_t head;
+
+  ring = threadRing;
+  if (NULL == ring)
+  {
+    ring = threadRing = trace_threadRing();
+    if (NULL == ring)
+    {
+      return;
+    }
+  }
+
+  head = ring->head;
+  r = &ring->records[head & (TMR_TRACE_RING_SIZE - 1)];
+  r->timeUs = trace_nowUs();
+  r->reader = reader;
+  r->thread = ring->thread;
+  r->event = (uint16_t)event;
+  r->reserved = 0;
+  r->a = a;
+  r->b = b;
+  TMR__STORE_RELEASE(uint32_t, &ring->head, head + 1);
+
+#ifdef TMR_ENABLE_STDIO
+  if ((TMR_TRACE_EXCEPTION == event) && (NULL != exceptionDump))
+  {
+    TMR_traceDump(exceptionDump);
+  }
+#endif
+}
+
+static int
+trace_compare(const void *a, const void *b)
+{
+  const TMR_TraceRecord *ra = a, *rb = b;
+
+  if (ra->timeUs != rb->timeUs)
+  {
+    return (ra->timeUs < rb->timeUs) ? -1 : 1;
+  }
+  return (ra->thread < rb->thread) ? -1 : (ra->thread > rb->thread);
+}
+
+/** Number of rings; called with traceLock held */
+static uint32_t
+trace_ringCount(void)
+{
+  TraceRing *ring;
+  uint32_t rings;
+
+  rings = 0;
+  for (ring = traceRings; NULL != ring; ring = ring->next)
+  {
+    rings++;
+  }
+  return rings;
+}
+
+uint32_t
+TMR_traceSnapshot(TMR_TraceRecord *records, uint32_t max)
+{
+  TMR_TraceRecord *all;
+  TraceRing *ring;
+  uint32_t rings, count, start, head, first, i;
+
+  pthread_mutex_lock(&traceLock);
+  rings = trace_ringCount();
+  all = malloc((size_t)rings * TMR_TRACE_RING_SIZE * sizeof(*all));
+  if (NULL == all)
+  {
+    pthread_mutex_unlock(&traceLock);
+    return 0;
+  }
+
+  count = 0;
+  for (ring = traceRings; NULL != ring; ring = ring->next)
+  {
+    head = TMR__LOAD_ACQUIRE(uint32_t, &ring->head);
+    first = (head > TMR_TRACE_RING_SIZE) ? head - TMR_TRACE_RING_SIZE : 0;
+    start = count;
+    for (i = first; i != head; i++)
+    {
+      all[count++] = ring->records[i & (TMR_TRACE_RING_SIZE - 1)];
+    }
+    /* Drop records the thread overwrote while they were copied */
+    head = TMR__LOAD_ACQUIRE(uint32_t, &ring->head);
+    if (head - first > TMR_TRACE_RING_SIZE)
+    {
+      uint32_t lost = head - first - TMR_TRACE_RING_SIZE;
+
+      if (lost > count - start)
+      {
+        lost = count - start;
+      }
+      memmove(&all[start], &all[start + lost], (count - start - lost) * sizeof(*all));
+      count -= lost;
+    }
+  }
+  pthread_mutex_unlock(&traceLock);
+
+  qsort(all, count, sizeof(*all), trace_compare);
+  start = (count > max) ? count - max : 0;
+  memcpy(records, &all[start], (count - start) * sizeof(*all));
+  free(all);
+
+  return count - start;
+}
+
+const char *
+TMR_traceEventName(uint16_t event)
+{
+  if (event < sizeof(traceEventNames) / sizeof(traceEventNames[0]))
+  {
+    return traceEventNames[event];
+  }
+  return "UNKNOWN";
+}
+
+#ifdef TMR_ENABLE_STDIO
+
+void
+TMR_traceDump(FILE *out)
+{
+  TMR_TraceRecord *records;
+  uint32_t max, count, i;
+
+  /* Thread numbers keep growing as threads come and go, the rings don't */
+  pthread_mutex_lock(&traceLock);
+  max = trace_ringCount() * TMR_TRACE_RING_SIZE;
+  pthread_mutex_unlock(&traceLock);
+
+  records = malloc((size_t)max * sizeof(*records));
+  if (NULL == records)
+  {
+    return;
+  }
+  count = TMR_traceSnapshot(records, max);
+  fprintf(out, "# %u trace records\n", count);
+  for (i = 0; i < count; i++)
+  {
+    fprintf(out, "%llu.%06u t%u %p %s %u %u\n",
+            (unsigned long long)(records[i].timeUs / 1000000),
+            (unsigned)(records[i].timeUs % 1000000),
+            records[i].thread, records[i].reader,
+            TMR_traceEventName(records[i].event), records[i].a, records[i].b);
+  }
+  fflush(out);
+  free(records);
+}
+
+void
+TMR_traceSetExceptionDump(FILE *out)
+{
+  exceptionDump = out;
+}
+
+#endif /* TMR_ENABLE_STDIO */
+
+#endif /* TMR_ENABLE_TRACE */
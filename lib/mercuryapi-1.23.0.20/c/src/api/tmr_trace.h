@@ -0,0 +1,171 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_TRACE_H
+#define _TMR_TRACE_H
+/**
+ *  @file tmr_trace.h
+ *  @brief Mercury API - Tracepoints
+ *
+ * Tracepoints at serial command send and receive, background read
+ * queue enqueue and dequeue, read listener entry and exit, LLRP
+ * message receive and read exceptions.  Unless TMR_ENABLE_TRACE or
+ * TMR_ENABLE_TRACE_USDT is defined in tm_config.h they compile to
+ * nothing, arguments included.
+ *
+ * With TMR_ENABLE_TRACE each thread records into its own ring of the
+ * last TMR_TRACE_RING_SIZE events, with no locks and no formatting:
+ * a clock read and a 32-byte store.  The rings of all threads are
+ * merged by TMR_traceSnapshot() or TMR_traceDump(), and can be dumped
+ * automatically on every read exception.
+ *
+ * With TMR_ENABLE_TRACE_USDT each tracepoint is also a USDT probe in
+ * the "mercuryapi" provider, named after the event (SR_SEND, ...),
+ * with the reader and the two event arguments, for bpftrace or
+ * SystemTap.  Needs <sys/sdt.h>.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+
+#ifdef TMR_ENABLE_STDIO
+#include <stdio.h>
+#endif
+#ifdef TMR_ENABLE_TRACE_USDT
+#include <sys/sdt.h>
+#endif
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+/** Traced events, and what their two arguments are */
+typedef enum TMR_TraceEvent
+{
+  /** Serial command sent: opcode, message length */
+  TMR_TRACE_SR_SEND = 1,
+  /** Serial response received: opcode, TMR_Status */
+  TMR_TRACE_SR_RECEIVE = 2,
+  /** Message put on the background read queue: queue depth after, 0 */
+  TMR_TRACE_QUEUE_ENQUEUE = 3,
+  /** Message taken off the background read queue: queue depth after, 0 */
+  TMR_TRACE_QUEUE_DEQUEUE = 4,
+  /** Read listener called: position in the listener list, antenna */
+  TMR_TRACE_LISTENER_ENTER = 5,
+  /** Read listener returned: position in the listener list, antenna */
+  TMR_TRACE_LISTENER_EXIT = 6,
+  /** LLRP message received: message type, message length */
+  TMR_TRACE_LLRP_RECEIVE = 7,
+  /** Read exception reported: TMR_Status, 0 */
+  TMR_TRACE_EXCEPTION = 8,
+} TMR_TraceEvent;
+
+#ifdef TMR_ENABLE_TRACE_USDT
+#define TMR__TRACE_USDT(event, reader, a, b) \
+  DTRACE_PROBE3(mercuryapi, event, (reader), (a), (b))
+#else
+#define TMR__TRACE_USDT(event, reader, a, b) ((void)0)
+#endif
+
+#ifdef TMR_ENABLE_TRACE
+#define TMR__TRACE_RING(event, reader, a, b) \
+  TMR__traceRecord(TMR_TRACE_##event, (reader), (uint32_t)(a), (uint32_t)(b))
+#else
+#define TMR__TRACE_RING(event, reader, a, b) ((void)0)
+#endif
+
+/**
+ * Record a tracepoint.  event is a TMR_TraceEvent without the
+ * TMR_TRACE_ prefix.
+ **/
+#define TMR_TRACE(event, reader, a, b) do { \
+  TMR__TRACE_USDT(event, reader, a, b); \
+  TMR__TRACE_RING(event, reader, a, b); \
+} while (0)
+
+#ifdef TMR_ENABLE_TRACE
+
+/**
+ * One recorded event.
+ **/
+typedef struct TMR_TraceRecord
+{
+  /** Monotonic time, in microseconds */
+  uint64_t timeUs;
+  /** The reader, or NULL */
+  const void *reader;
+  /** Number of the recording thread, in the order threads first traced */
+  uint32_t thread;
+  /** A TMR_TraceEvent */
+  uint16_t event;
+  /** Zero */
+  uint16_t reserved;
+  /** First event argument */
+  uint32_t a;
+  /** Second event argument */
+  uint32_t b;
+} TMR_TraceRecord;
+
+/**
+ * Copy the most recent events of all threads, oldest first.
+ *
+ * @param[out] records Where to copy them
+ * @param max Number of records there is room for
+ * @return Number of records copied
+ **/
+uint32_t TMR_traceSnapshot(TMR_TraceRecord *records, uint32_t max);
+
+/**
+ * Name of a TMR_TraceEvent, such as "SR_SEND".
+ *
+ * @param event The event
+ **/
+const char *TMR_traceEventName(uint16_t event);
+
+#ifdef TMR_ENABLE_STDIO
+/**
+ * Write the most recent events of all threads as text, one per line,
+ * oldest first.
+ *
+ * @param out Where to write
+ **/
+void TMR_traceDump(FILE *out);
+
+/**
+ * Dump the trace to a file whenever a read exception is reported,
+ * before the exception listeners are called.
+ *
+ * @param out Where to write, NULL to stop
+ **/
+void TMR_traceSetExceptionDump(FILE *out);
+#endif
+
+/** @private */
+void TMR__traceRecord(TMR_TraceEvent event, const void *reader, uint32_t a, uint32_t b);
+
+#endif /* TMR_ENABLE_TRACE */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_TRACE_H */
@@ -0,0 +1,252 @@
+/**
+ *  @file tmr_transport_tap.c
+ *  @brief Mercury API - Sampling transport tap
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_config.h"
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#include "tm_reader.h"
+#include "tmr_transport_tap.h"
+#include "osdep.h"
+
+#define TAP_ADD(p, n) __atomic_fetch_add((p), (n), __ATOMIC_RELAXED)
+#define TAP_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define TAP_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * Each slot of the ring is this header followed by snapLength bytes.
+ * The ring is a bounded multi-producer queue: sends and receives may
+ * come from different threads.  A slot's sequence is its position
+ * when free for writing, position + 1 once written, and position +
+ * slots once read.
+ **/
+typedef struct TapSlot
+{
+  uint32_t sequence;
+  uint32_t reserved;
+  TMR_TransportTapRecord record;
+} TapSlot;
+
+static uint64_t
+tap_nowUs(void)
+{
+#ifndef WIN32
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#else
+  return tmr_gettime() * 1000;
+#endif
+}
+
+static TapSlot *
+tap_slot(TMR_TransportTap *tap, uint32_t pos)
+{
+  return (TapSlot *)(tap->ring + ((size_t)(pos & (tap->config.slots - 1)) * tap->slotSize));
+}
+
+static void
+tap_frame(TMR_TransportTap *tap, bool tx, uint32_t length, const uint8_t *data,
+          TMR_Status status)
+{
+  TapSlot *slot;
+  uint64_t frame;
+  uint32_t pos, sequence, captured;
+
+  frame = TAP_ADD(&tap->frames, 1);
+  if (TMR_SUCCESS == status)
+  {
+    if (tap->config.errorsOnly
+        || ((1 < tap->config.sampleEvery) && (0 != (frame % tap->config.sampleEvery))))
+    {
+      return;
+    }
+  }
+
+  /* Claim a slot */
+  pos = __atomic_load_n(&tap->writePos, __ATOMIC_RELAXED);
+  for (;;)
+  {
+    int32_t diff;
+
+    slot = tap_slot(tap, pos);
+    sequence = TAP_LOAD(&slot->sequence);
+    diff = (int32_t)(sequence - pos);
+    if (0 == diff)
+    {
+      if (__atomic_compare_exchange_n(&tap->writePos, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+        break;
+      }
+    }
+    else if (0 > diff)
+    {
+      /* Full: the reader hasn't taken the frame a lap ago */
+      TAP_ADD(&tap->dropped, 1);
+      return;
+    }
+    else
+    {
+      pos = __atomic_load_n(&tap->writePos, __ATOMIC_RELAXED);
+    }
+  }
+
+  captured = (length < tap->config.snapLength) ? length : tap->config.snapLength;
+  slot->record.timeUs = tap_nowUs();
+  slot->record.frame = frame;
+  slot->record.length = length;
+  slot->record.captured = captured;
+  slot->record.tx = tx;
+  slot->record.status = status;
+  if ((0 < captured) && (NULL != data))
+  {
+    memcpy(slot + 1, data, captured);
+  }
+  else
+  {
+    slot->record.captured = 0;
+  }
+  TAP_ADD(&tap->kept, 1);
+  TAP_STORE(&slot->sequence, pos + 1);
+}
+
+void
+TMR__transportTapFrame(TMR_Reader *reader, bool tx, uint32_t length,
+                       const uint8_t *data, TMR_Status status)
+{
+  TMR_TransportTap *tap;
+
+  if ((TMR_SUCCESS != status) && (0 == length))
+  {
+    /* Nothing arrived, which isn't a frame */
+    return;
+  }
+
+  /*
+   * Count this thread in, then load the tap.  TMR_stopTransportTap()
+   * clears the tap, then waits for the count to drop to 0, so either
+   * this sees no tap or the ring outlives the frame.
+   */
+  __atomic_fetch_add(&reader->transportTapWriters, 1, __ATOMIC_SEQ_CST);
+  tap = __atomic_load_n(&reader->transportTap, __ATOMIC_SEQ_CST);
+  if (NULL != tap)
+  {
+    tap_frame(tap, tx, length, data, status);
+  }
+  __atomic_fetch_sub(&reader->transportTapWriters, 1, __ATOMIC_RELEASE);
+}
+
+bool
+TMR_transportTapRead(TMR_TransportTap *tap, TMR_TransportTapRecord *record,
+                     uint8_t *data, uint32_t size)
+{
+  TapSlot *slot;
+  uint32_t pos;
+
+  pos = tap->readPos;
+  slot = tap_slot(tap, pos);
+  if (TAP_LOAD(&slot->sequence) != pos + 1)
+  {
+    return false;
+  }
+  *record = slot->record;
+  if (record->captured > size)
+  {
+    record->captured = size;
+  }
+  memcpy(data, slot + 1, record->captured);
+  tap->readPos = pos + 1;
+  TAP_STORE(&slot->sequence, pos + tap->config.slots);
+
+  return true;
+}
+
+void
+TMR_transportTapInitConfig(TMR_TransportTapConfig *config)
+{
+  memset(config, 0, sizeof(*config));
+  config->sampleEvery = 1;
+  config->errorsOnly = false;
+  config->slots = 1024;
+  config->snapLength = 256;
+}
+
+TMR_Status
+TMR_startTransportTap(TMR_Reader *reader, TMR_TransportTap *tap,
+                      const TMR_TransportTapConfig *config)
+{
+  uint32_t i;
+
+  if ((NULL != reader->transportTap) || (0 == config->slots)
+      || (0 != (config->slots & (config->slots - 1))))
+  {
+    return TMR_ERROR_INVALID;
+  }
+
+  memset(tap, 0, sizeof(*tap));
+  tap->config = *config;
+  tap->slotSize = (uint32_t)((sizeof(TapSlot) + config->snapLength + 7) & ~(size_t)7);
+  tap->ring = malloc((size_t)tap->slotSize * config->slots);
+  if (NULL == tap->ring)
+  {
+    return TMR_ERROR_OUT_OF_MEMORY;
+  }
+  for (i = 0; i < config->slots; i++)
+  {
+    tap_slot(tap, i)->sequence = i;
+  }
+
+  TAP_STORE(&reader->transportTap, tap);
+  return TMR_SUCCESS;
+}
+
+TMR_Status
+TMR_stopTransportTap(TMR_Reader *reader, TMR_TransportTap *tap)
+{
+  if (tap != reader->transportTap)
+  {
+    return TMR_ERROR_INVALID;
+  }
+  __atomic_store_n(&reader->transportTap, NULL, __ATOMIC_SEQ_CST);
+  while (0 != __atomic_load_n(&reader->transportTapWriters, __ATOMIC_SEQ_CST))
+  {
+    tmr_sleep(1);
+  }
+  free(tap->ring);
+  tap->ring = NULL;
+
+  return TMR_SUCCESS;
+}
+
+#endif /* TMR_ENABLE_TRANSPORT_TAP */
@@ -0,0 +1,179 @@
+/* ex: set tabstop=2 shiftwidth=2 expandtab cindent: */
+#ifndef _TMR_TRANSPORT_TAP_H
+#define _TMR_TRANSPORT_TAP_H
+/**
+ *  @file tmr_transport_tap.h
+ *  @brief Mercury API - Sampling transport tap
+ *
+ * A cheaper way than a transport listener to watch the traffic of a
+ * busy reader.  The tap copies the raw bytes of sampled frames into a
+ * lock-free ring, with no formatting (LLRP frames are not turned into
+ * XML), and another thread takes them out with
+ * TMR_transportTapRead().  It can keep one frame in N, or only frames
+ * whose transfer failed.  When the ring is full frames are dropped
+ * and counted rather than holding up the reader.
+ *
+ * With no tap started the cost is one pointer test per frame.
+ */
+
+/*
+ * Copyright (c) 2014 ThingMagic, Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "tm_reader.h"
+#include "tmr_atomic.h"
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+
+/**
+ * Tap configuration, see TMR_transportTapInitConfig().
+ **/
+typedef struct TMR_TransportTapConfig
+{
+  /** Keep one frame in this many; 0 or 1 keeps all.  Failed transfers are always kept. */
+  uint32_t sampleEvery;
+  /** Keep only frames whose transfer failed (timeout, bad CRC, corrupt or oversized frame) */
+  bool errorsOnly;
+  /** Number of frames the ring holds, a power of two (default 1024) */
+  uint32_t slots;
+  /** Most bytes kept of each frame, the rest is cut off (default 256) */
+  uint32_t snapLength;
+} TMR_TransportTapConfig;
+
+/**
+ * A frame taken from the tap.
+ **/
+typedef struct TMR_TransportTapRecord
+{
+  /** Monotonic time the frame was tapped, in microseconds */
+  uint64_t timeUs;
+  /** Number of the frame among all frames the tap has seen, from 0 */
+  uint64_t frame;
+  /** Length of the frame */
+  uint32_t length;
+  /** Bytes of it kept, at most the snap length */
+  uint32_t captured;
+  /** True for a frame sent to the device */
+  bool tx;
+  /** TMR_SUCCESS, or the error the transfer failed with */
+  TMR_Status status;
+} TMR_TransportTapRecord;
+
+/**
+ * A tap on a reader's transport, see TMR_startTransportTap().
+ **/
+typedef struct TMR_TransportTap
+{
+  /** @private */
+  TMR_TransportTapConfig config;
+  /** @private */
+  uint8_t *ring;
+  /** @private */
+  uint32_t slotSize;
+  /** @private */
+  uint32_t writePos;
+  /** @private */
+  uint32_t readPos;
+  /** Frames seen */
+  uint64_t frames;
+  /** Frames put on the ring */
+  uint64_t kept;
+  /** Frames to be kept that were dropped because the ring was full */
+  uint64_t dropped;
+} TMR_TransportTap;
+
+/**
+ * Fill in the default tap configuration: every frame, 1024 slots of
+ * 256 bytes.
+ *
+ * @param config The configuration to initialize
+ **/
+void TMR_transportTapInitConfig(TMR_TransportTapConfig *config);
+
+/**
+ * Start tapping a reader's transport.  A reader has at most one tap.
+ *
+ * @param reader The reader
+ * @param tap Tap state, owned by the caller until the tap is stopped
+ * @param config The configuration
+ * @return TMR_ERROR_INVALID if the reader already has a tap or slots
+ *         is not a power of two
+ **/
+TMR_Status TMR_startTransportTap(TMR_Reader *reader, TMR_TransportTap *tap,
+                                 const TMR_TransportTapConfig *config);
+
+/**
+ * Take the oldest frame off the tap.  Only one thread may read a tap.
+ *
+ * @param tap The tap
+ * @param[out] record The frame
+ * @param[out] data Where to copy its bytes, at most size of them
+ * @param size Size of data
+ * @return false if there is no frame waiting
+ **/
+bool TMR_transportTapRead(TMR_TransportTap *tap, TMR_TransportTapRecord *record,
+                          uint8_t *data, uint32_t size);
+
+/**
+ * Stop tapping and free the ring, once the frames being written to it
+ * are done.  Reading may go on meanwhile.
+ *
+ * @param reader The reader
+ * @param tap The tap
+ * @return TMR_ERROR_INVALID if the tap is not the reader's
+ **/
+TMR_Status TMR_stopTransportTap(TMR_Reader *reader, TMR_TransportTap *tap);
+
+/** @private */
+void TMR__transportTapFrame(TMR_Reader *reader, bool tx, uint32_t length,
+                            const uint8_t *data, TMR_Status status);
+
+#define TMR__TAP_STARTED(reader) \
+  (NULL != TMR__LOAD_RELAXED(struct TMR_TransportTap *, &(reader)->transportTap))
+
+/**
+ * Offer a frame to the reader's tap, if it has one.  The test here
+ * only skips the call with no tap started; TMR__transportTapFrame()
+ * loads the tap once more where TMR_stopTransportTap() waits for it.
+ * @private
+ **/
+#define TMR__TAP_FRAME(reader, tx, length, data, status) do { \
+  if (TMR__TAP_STARTED(reader)) \
+  { \
+    TMR__transportTapFrame((reader), (tx), (length), (data), (status)); \
+  } \
+} while (0)
+
+#else
+
+#define TMR__TAP_FRAME(reader, tx, length, data, status) ((void)0)
+
+#endif /* TMR_ENABLE_TRANSPORT_TAP */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TMR_TRANSPORT_TAP_H */
@@ -0,0 +1,2018 @@
+/**
+ * Read pipeline benchmark.
+ *
+ * Drives the serial reader layer against the simulated M6e transport
+ * (sim:// URIs) and the LLRP report decoder against synthetic
+ * RO_ACCESS_REPORTs, so every run sees the same traffic, and prints
+ * the results as one JSON document.  Measured:
+ *
+ *   crc_mb_per_sec              TMR_SR_crc() over full size frames
+ *   receive_frames_per_sec      TMR_SR_receiveMessage() over recorded tag frames
+ *   receive_tap_frames_per_sec  the same with a transport tap keeping every frame
+ *   parse_metadata_ns           TMR_SR_parseMetadataFromMessage() per tag read
+ *   parse_metadata_cal_ns       the same with a phase calibration table attached
+ *   async_latency_p50_us/p99_us frame received to read listener called
+ *   async_reads_per_sec         reads delivered to the read listener
+ *   readintoarray_<N>_us        TMR_readIntoArray() of N tags (1 ms search), dedup on
+ *   readintoarray_dedup_<N>_us  the API dedup filter over one search cycle of
+ *                               N tags read 4 times each
+ *   llrp_decode_tags_per_sec    RO_ACCESS_REPORT frame decode and metadata parse
+ *   fault_recovery_mean_ms/max_ms
+ *                               end of an injected transport fault to the next
+ *                               tag read, continuous reading with auto resume
+ *   pdoa_reads_per_sec          reads through the phase difference engine,
+ *                               4 antennas, 50 channels, tags from -t
+ *   range_reads_per_sec         reads through ranging, 50 channels, tags
+ *                               from -t, each refitting the tag's line
+ *   range_error_cm              worst error of the last estimates of those
+ *                               tags, 1 to 8.75 m away, phase +/- 2 degrees
+ *   phase_stats_reads_per_sec   weighted circular mean and spread of 64k
+ *                               phases, with the best kernels the CPU has
+ *   phase_outlier_reads_per_sec the same with outliers left out
+ *   phase_group_us              statistics of each of 4096 tags from 16
+ *                               reads each, leaving out outliers
+ *   locate_reads_per_sec        reads through the position estimator, 4
+ *                               ceiling antennas, 50 channels, tags from -t
+ *   locate_error_cm             mean error of the last positions of those
+ *                               tags, RSSI +/- 3 dB and phase +/- 2 degrees
+ *   multi_merge_reads_per_sec   reads through a session of 4 readers fed
+ *                               directly, merged in time order
+ *   multi_clock_error_us        worst error of those readers' fitted clocks,
+ *                               offsets up to 5 s and drifts up to 100 ppm,
+ *                               0.2 to 2.2 ms delay on the way
+ *   schedule_pair_p90_us        90th percentile time between reads of a tag
+ *                               on different antennas, simulated module
+ *                               reading 4 tags on 3 antennas by a schedule
+ *   events_reads_per_sec        reads through the tag event engine, 64 tags
+ *                               standing still and a stream passing by
+ *   portal_reads_per_sec        reads through the portal engine, a tag
+ *                               walking through a doorway every 500 ms
+ *   portal_accuracy_pct         share of those passages given the direction
+ *                               they went, RSSI +/- 2 dB, phase +/- 2 degrees
+ *   portal_decision_lag_ms      longest time from a tag's last read to its
+ *                               decision, sweeping every 50 ms
+ *   readlog_write_reads_per_sec reads into a read log, 4 antennas, 50
+ *                               channels, tags from -t
+ *   readlog_bytes_per_read      size of that log over its reads
+ *   readlog_scan_reads_per_sec  reads of the whole log through a scan
+ *   readlog_query_us            scan for one tag's reads in one second of
+ *                               the log
+ *
+ * Thresholds are read from a file of "name value" lines (-f) or given
+ * as -T name=value.  A metric passes when it is at least its
+ * threshold (rates) or at most its threshold (costs and latencies);
+ * the program exits with 1 if any metric fails.
+ *
+ * Usage: tmrbench [-d ms] [-t tags] [-r rate] [-f thresholds]
+ *                 [-T name=value] [-o output]
+ * @file tmrbench.c
+ */
+
+#include <tm_reader.h>
+#include <serial_reader_imp.h>
+#include <tmr_utils.h>
+#include <tmr_transport_tap.h>
+#include <tmr_fault.h>
+#include <tmr_pdoa.h>
+#include <tmr_range.h>
+#include <tmr_phase.h>
+#include <tmr_locate.h>
+#include <tmr_phase_cal.h>
+#include <tmr_multi.h>
+#include <tmr_schedule.h>
+#include <tmr_events.h>
+#include <tmr_portal.h>
+#include <tmr_readlog.h>
+#ifdef TMR_ENABLE_LLRP_READER
+#include <llrp_reader_imp.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <math.h>
+
+#define BENCH_MAX_RESULTS    48
+#define BENCH_MAX_THRESHOLDS 48
+#define BENCH_MAX_FRAMES     1024
+#define BENCH_MAX_SAMPLES    (1 << 20)
+#define BENCH_RING_SIZE      (1 << 16)
+#define BENCH_LLRP_TAGS      100
+
+typedef struct BenchResult
+{
+  char name[48];
+  double value;
+  const char *unit;
+  bool higherIsBetter;
+} BenchResult;
+
+typedef struct BenchThreshold
+{
+  char name[48];
+  double value;
+} BenchThreshold;
+
+/* Benchmark options */
+static uint32_t durationMs = 1000;
+static uint32_t tagCount = 128;
+static uint32_t readRate = 5000;
+
+static BenchResult results[BENCH_MAX_RESULTS];
+static int resultCount;
+static BenchThreshold thresholds[BENCH_MAX_THRESHOLDS];
+static int thresholdCount;
+
+/* Tag frames recorded from the simulated module */
+static uint8_t frames[BENCH_MAX_FRAMES][TMR_SR_MAX_PACKET_SIZE];
+static uint32_t frameLengths[BENCH_MAX_FRAMES];
+static uint32_t frameCount;
+
+/* Frame arrival times waiting for their read listener call */
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t ring[BENCH_RING_SIZE];
+static uint32_t ringHead, ringTail;
+static uint32_t *samples;
+static uint32_t sampleCount;
+static uint32_t readsSeen;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+static uint64_t
+nowNs(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void
+addResult(const char *name, double value, const char *unit, bool higherIsBetter)
+{
+  BenchResult *r;
+
+  if (BENCH_MAX_RESULTS == resultCount)
+  {
+    return;
+  }
+  r = &results[resultCount++];
+  snprintf(r->name, sizeof(r->name), "%s", name);
+  r->value = value;
+  r->unit = unit;
+  r->higherIsBetter = higherIsBetter;
+}
+
+static void
+addThreshold(const char *name, double value)
+{
+  int i;
+
+  for (i = 0; i < thresholdCount; i++)
+  {
+    if (0 == strcmp(thresholds[i].name, name))
+    {
+      thresholds[i].value = value;
+      return;
+    }
+  }
+  if (BENCH_MAX_THRESHOLDS == thresholdCount)
+  {
+    errx(2, "Too many thresholds\n");
+  }
+  snprintf(thresholds[thresholdCount].name, sizeof(thresholds[0].name), "%s", name);
+  thresholds[thresholdCount].value = value;
+  thresholdCount++;
+}
+
+static void
+readThresholds(const char *path)
+{
+  FILE *f;
+  char line[128], name[48];
+  double value;
+
+  f = fopen(path, "r");
+  if (NULL == f)
+  {
+    errx(2, "Can't open %s\n", path);
+  }
+  while (NULL != fgets(line, sizeof(line), f))
+  {
+    if (('#' == line[0]) || ('\n' == line[0]))
+    {
+      continue;
+    }
+    if (2 != sscanf(line, "%47s %lf", name, &value))
+    {
+      errx(2, "Bad threshold line in %s: %s", path, line);
+    }
+    addThreshold(name, value);
+  }
+  fclose(f);
+}
+
+static void
+connectSim(TMR_Reader *reader, uint32_t tags, uint32_t rate, bool sync)
+{
+  char uri[128];
+  TMR_Region region;
+  TMR_Status ret;
+
+  snprintf(uri, sizeof(uri), "sim:///m6e?tags=%u&rate=%u&sync=%d", tags, rate, sync ? 1 : 0);
+  ret = TMR_create(reader, uri);
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_connect(reader);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    region = TMR_REGION_NA;
+    ret = TMR_paramSet(reader, TMR_PARAM_REGION_ID, &region);
+  }
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error connecting to %s: %s\n", uri, TMR_strerr(reader, ret));
+  }
+}
+
+/**
+ * True for a continuous reading frame that carries one tag read
+ * (the layout TMR_SR_hasMoreTags() accepts as stream continues).
+ **/
+static bool
+isTagFrame(const uint8_t *data, uint32_t len)
+{
+  uint8_t typePos;
+
+  if ((len < 12) || (0xFF != data[0]) || (TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE != data[2])
+      || (0 != GETU16AT(data, 3)) || (data[1] < 6))
+  {
+    return false;
+  }
+  typePos = (0x10 == (data[5] & 0x10)) ? 10 : 8;
+  return (0x01 == data[typePos]);
+}
+
+static void
+recordListener(bool tx, uint32_t dataLen, const uint8_t data[],
+               uint32_t timeout, void *cookie)
+{
+  if ((false == tx) && (frameCount < BENCH_MAX_FRAMES) && isTagFrame(data, dataLen)
+      && (dataLen <= TMR_SR_MAX_PACKET_SIZE))
+  {
+    memcpy(frames[frameCount], data, dataLen);
+    frameLengths[frameCount] = dataLen;
+    frameCount++;
+  }
+}
+
+static void
+recordFrames(TMR_Reader *reader)
+{
+  TMR_TransportListenerBlock tb;
+  TMR_Status ret;
+  uint32_t waitedMs;
+
+  tb.listener = recordListener;
+  tb.cookie = NULL;
+  TMR_addTransportListener(reader, &tb);
+  ret = TMR_startReading(reader);
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error starting reading: %s\n", TMR_strerr(reader, ret));
+  }
+  for (waitedMs = 0; (frameCount < BENCH_MAX_FRAMES) && (waitedMs < 5000); waitedMs += 10)
+  {
+    tmr_sleep(10);
+  }
+  TMR_stopReading(reader);
+  TMR_removeTransportListener(reader, &tb);
+  if (0 == frameCount)
+  {
+    errx(2, "No tag frames recorded\n");
+  }
+}
+
+static void
+benchCrc(void)
+{
+  uint8_t buf[255];
+  volatile uint16_t sink;
+  uint64_t start, elapsed, bytes;
+  uint32_t i;
+
+  for (i = 0; i < sizeof(buf); i++)
+  {
+    buf[i] = (uint8_t)(i * 7 + 1);
+  }
+  bytes = 0;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++)
+    {
+      sink = TMR_SR_crc(buf, sizeof(buf));
+      buf[0] = (uint8_t)sink;
+    }
+    bytes += 1024 * sizeof(buf);
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+
+  addResult("crc_mb_per_sec", (bytes / 1e6) / (elapsed / 1e9), "MB/s", true);
+}
+
+/**
+ * A transport that serves the recorded frames over and over, so
+ * TMR_SR_receiveMessage() is timed without a device or simulator
+ * behind it.
+ **/
+typedef struct ReplayContext
+{
+  uint8_t *stream;
+  uint32_t length;
+  uint32_t pos;
+} ReplayContext;
+
+static TMR_Status
+replayReceiveBytes(TMR_SR_SerialTransport *this, uint32_t length,
+                   uint32_t *messageLength, uint8_t *message, const uint32_t timeoutMs)
+{
+  ReplayContext *c;
+  uint32_t n;
+
+  c = this->cookie;
+  *messageLength = length;
+  while (0 < length)
+  {
+    n = c->length - c->pos;
+    n = (n < length) ? n : length;
+    memcpy(message, c->stream + c->pos, n);
+    message += n;
+    length -= n;
+    c->pos = (c->pos + n) % c->length;
+  }
+  return TMR_SUCCESS;
+}
+
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+static volatile bool tapDraining;
+
+/* The off-thread consumer a diagnostics tool would run */
+static void *
+drainTap(void *arg)
+{
+  TMR_TransportTap *tap = arg;
+  TMR_TransportTapRecord record;
+  uint8_t data[TMR_SR_MAX_PACKET_SIZE];
+
+  while (tapDraining)
+  {
+    while (TMR_transportTapRead(tap, &record, data, sizeof(data)))
+      ;
+    tmr_sleep(1);
+  }
+  return NULL;
+}
+#endif
+
+static void
+benchReceive(TMR_Reader *reader, bool tapped)
+{
+  TMR_SR_SerialTransport saved;
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+  TMR_TransportTapConfig tapConfig;
+  TMR_TransportTap tap;
+  pthread_t drainer;
+#endif
+  ReplayContext ctx;
+  uint8_t msg[TMR_SR_MAX_PACKET_SIZE];
+  uint64_t start, elapsed, count;
+  uint32_t i;
+  TMR_Status ret;
+
+  ctx.length = 0;
+  for (i = 0; i < frameCount; i++)
+  {
+    ctx.length += frameLengths[i];
+  }
+  ctx.stream = malloc(ctx.length);
+  if (NULL == ctx.stream)
+  {
+    errx(2, "Out of memory\n");
+  }
+  ctx.length = 0;
+  for (i = 0; i < frameCount; i++)
+  {
+    memcpy(ctx.stream + ctx.length, frames[i], frameLengths[i]);
+    ctx.length += frameLengths[i];
+  }
+  ctx.pos = 0;
+
+  saved = reader->u.serialReader.transport;
+  reader->u.serialReader.transport.cookie = &ctx;
+  reader->u.serialReader.transport.receiveBytes = replayReceiveBytes;
+
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+  if (tapped)
+  {
+    TMR_transportTapInitConfig(&tapConfig);
+    tapConfig.snapLength = TMR_SR_MAX_PACKET_SIZE;
+    ret = TMR_startTransportTap(reader, &tap, &tapConfig);
+    if (TMR_SUCCESS != ret)
+    {
+      errx(2, "Error starting transport tap: %s\n", TMR_strerr(reader, ret));
+    }
+    tapDraining = true;
+    pthread_create(&drainer, NULL, drainTap, &tap);
+  }
+#endif
+
+  count = 0;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++)
+    {
+      ret = TMR_SR_receiveMessage(reader, msg, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, 0);
+      if (TMR_SUCCESS != ret)
+      {
+        errx(2, "Error receiving recorded frame: %s\n", TMR_strerr(reader, ret));
+      }
+    }
+    count += 1024;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+
+  reader->u.serialReader.transport = saved;
+  free(ctx.stream);
+
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+  if (tapped)
+  {
+    tapDraining = false;
+    pthread_join(drainer, NULL);
+    TMR_stopTransportTap(reader, &tap);
+    addResult("receive_tap_frames_per_sec", count / (elapsed / 1e9), "frames/s", true);
+    return;
+  }
+#endif
+  addResult("receive_frames_per_sec", count / (elapsed / 1e9), "frames/s", true);
+}
+
+/** Time the parse of the recorded tag frames, ns per read */
+static double
+parseFrames(TMR_Reader *reader)
+{
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count;
+  uint16_t flags;
+  uint8_t i;
+  uint32_t f;
+
+  count = 0;
+  start = nowNs();
+  do
+  {
+    for (f = 0; f < frameCount; f++)
+    {
+      /* Same offsets as the background parser uses for stream frames */
+      TMR_TRD_init(&trd);
+      flags = GETU16AT(frames[f], 8);
+      i = 11;
+      TMR_SR_parseMetadataFromMessage(reader, &trd, flags, &i, frames[f]);
+      TMR_SR_postprocessReaderSpecificMetadata(&trd, &reader->u.serialReader);
+    }
+    count += frameCount;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+
+  return (double)elapsed / count;
+}
+
+static void
+benchParse(TMR_Reader *reader)
+{
+#ifdef TMR_ENABLE_PHASE_CAL
+  static TMR_PhaseCal cal;
+  uint32_t hopTable[50];
+  uint32_t i;
+#endif
+
+  addResult("parse_metadata_ns", parseFrames(reader), "ns", false);
+
+#ifdef TMR_ENABLE_PHASE_CAL
+  for (i = 0; i < 50; i++)
+  {
+    hopTable[i] = 902750 + i * 500;
+  }
+  if ((TMR_SUCCESS != TMR_phaseCalInit(&cal, 180, hopTable, 50))
+      || (TMR_SUCCESS != TMR_phaseCalAttach(reader, &cal)))
+  {
+    errx(2, "Error attaching phase calibration\n");
+  }
+  for (i = 0; i < sizeof(cal.offset) / sizeof(cal.offset[0]); i++)
+  {
+    cal.offset[i] = (uint16_t)(i * 37 % 180);
+  }
+  addResult("parse_metadata_cal_ns", parseFrames(reader), "ns", false);
+  TMR_phaseCalAttach(reader, NULL);
+  if (0 == cal.corrected)
+  {
+    errx(2, "Phase calibration corrected no reads\n");
+  }
+#endif
+}
+
+static void
+latencyFrameListener(bool tx, uint32_t dataLen, const uint8_t data[],
+                     uint32_t timeout, void *cookie)
+{
+  if ((false == tx) && isTagFrame(data, dataLen))
+  {
+    pthread_mutex_lock(&ringLock);
+    ring[ringHead % BENCH_RING_SIZE] = nowNs();
+    ringHead++;
+    pthread_mutex_unlock(&ringLock);
+  }
+}
+
+static void
+latencyReadListener(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  uint64_t now;
+
+  now = nowNs();
+  pthread_mutex_lock(&ringLock);
+  /* One tag read per frame, reported in the order received */
+  if (ringTail != ringHead)
+  {
+    if (sampleCount < BENCH_MAX_SAMPLES)
+    {
+      samples[sampleCount++] = (uint32_t)((now - ring[ringTail % BENCH_RING_SIZE]) / 1000);
+    }
+    ringTail++;
+  }
+  readsSeen++;
+  pthread_mutex_unlock(&ringLock);
+}
+
+static int
+compareU32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+static void
+benchAsyncLatency(TMR_Reader *reader)
+{
+  TMR_TransportListenerBlock tb;
+  TMR_ReadListenerBlock rb;
+  TMR_Status ret;
+  uint64_t start, elapsed;
+
+  samples = malloc(BENCH_MAX_SAMPLES * sizeof(*samples));
+  if (NULL == samples)
+  {
+    errx(2, "Out of memory\n");
+  }
+  sampleCount = 0;
+  readsSeen = 0;
+  ringHead = ringTail = 0;
+
+  tb.listener = latencyFrameListener;
+  tb.cookie = NULL;
+  rb.listener = latencyReadListener;
+  rb.cookie = NULL;
+  TMR_addTransportListener(reader, &tb);
+  TMR_addReadListener(reader, &rb);
+
+  start = nowNs();
+  ret = TMR_startReading(reader);
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error starting reading: %s\n", TMR_strerr(reader, ret));
+  }
+  tmr_sleep(durationMs);
+  TMR_stopReading(reader);
+  elapsed = nowNs() - start;
+
+  TMR_removeReadListener(reader, &rb);
+  TMR_removeTransportListener(reader, &tb);
+
+  if (0 == sampleCount)
+  {
+    errx(2, "No tag reads during continuous reading\n");
+  }
+  qsort(samples, sampleCount, sizeof(*samples), compareU32);
+  addResult("async_latency_p50_us", samples[sampleCount / 2], "us", false);
+  addResult("async_latency_p99_us", samples[(sampleCount * 99ULL) / 100], "us", false);
+  addResult("async_reads_per_sec", readsSeen / (elapsed / 1e9), "reads/s", true);
+  free(samples);
+}
+
+/**
+ * Time TMR_readIntoArray() calls of one 1 ms search each.  The
+ * simulated module buffers each tag once per search, so every call
+ * returns the whole population whether or not dedup is on.
+ *
+ * @return Microseconds per call
+ **/
+static double
+timeReadIntoArray(TMR_Reader *reader, uint32_t tags, bool dedup)
+{
+  TMR_DedupPolicy policy;
+  TMR_TagReadData *reads;
+  TMR_Status ret;
+  uint64_t start, elapsed, calls;
+  int32_t count;
+
+  ret = TMR_paramGet(reader, TMR_PARAM_TAGREADDATA_DEDUPPOLICY, &policy);
+  if (TMR_SUCCESS == ret)
+  {
+    policy.enable = dedup;
+    ret = TMR_paramSet(reader, TMR_PARAM_TAGREADDATA_DEDUPPOLICY, &policy);
+  }
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error setting dedup policy: %s\n", TMR_strerr(reader, ret));
+  }
+
+  calls = 0;
+  start = nowNs();
+  do
+  {
+    ret = TMR_readIntoArray(reader, 1, &count, &reads);
+    free(reads);
+    if (TMR_SUCCESS != ret)
+    {
+      errx(2, "Error reading into array: %s\n", TMR_strerr(reader, ret));
+    }
+    if ((uint32_t)count != tags)
+    {
+      errx(2, "Read %d tags into array, expected %u\n", count, tags);
+    }
+    calls++;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < (durationMs / 2) * 1000000ULL);
+
+  return (elapsed / 1e3) / calls;
+}
+
+#ifdef TMR_ENABLE_BACKGROUND_READS
+#define BENCH_DEDUP_READS 4
+
+/**
+ * Time the API dedup filter directly: a search cycle of a buffered
+ * population, each tag read BENCH_DEDUP_READS times.  Timing it through
+ * TMR_readIntoArray() would leave it lost in the noise of the search.
+ *
+ * @return Microseconds per cycle
+ **/
+static double
+timeDedup(TMR_Reader *reader, uint32_t tags)
+{
+  TMR_DedupPolicy policy;
+  TMR_TagReadData *reads;
+  TMR_Status ret;
+  uint64_t start, elapsed, cycles;
+  uint32_t i, pass, duplicates;
+
+  ret = TMR_paramGet(reader, TMR_PARAM_TAGREADDATA_DEDUPPOLICY, &policy);
+  if (TMR_SUCCESS == ret)
+  {
+    policy.enable = true;
+    policy.windowMs = 0;
+    ret = TMR_paramSet(reader, TMR_PARAM_TAGREADDATA_DEDUPPOLICY, &policy);
+  }
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error setting dedup policy: %s\n", TMR_strerr(reader, ret));
+  }
+
+  reads = calloc(tags, sizeof(*reads));
+  if (NULL == reads)
+  {
+    errx(2, "Out of memory\n");
+  }
+  for (i = 0; i < tags; i++)
+  {
+    TMR_TRD_init(&reads[i]);
+    reads[i].tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+    reads[i].tag.epcByteCount = 12;
+    reads[i].tag.epc[8] = (uint8_t)(i >> 24);
+    reads[i].tag.epc[9] = (uint8_t)(i >> 16);
+    reads[i].tag.epc[10] = (uint8_t)(i >> 8);
+    reads[i].tag.epc[11] = (uint8_t)i;
+    reads[i].antenna = 1;
+    reads[i].reader = reader;
+  }
+
+  cycles = 0;
+  start = nowNs();
+  do
+  {
+    ret = TMR__dedupReset(reader, false);
+    if (TMR_SUCCESS != ret)
+    {
+      errx(2, "Error resetting dedup filter: %s\n", TMR_strerr(reader, ret));
+    }
+    duplicates = 0;
+    for (pass = 0; pass < BENCH_DEDUP_READS; pass++)
+    {
+      for (i = 0; i < tags; i++)
+      {
+        duplicates += TMR__dedupIsDuplicate(reader, &reads[i]) ? 1 : 0;
+      }
+    }
+    cycles++;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < (durationMs / 2) * 1000000ULL);
+
+  if (duplicates != (BENCH_DEDUP_READS - 1) * tags)
+  {
+    errx(2, "Dedup dropped %u of %u reads, expected %u\n", duplicates,
+         BENCH_DEDUP_READS * tags, (BENCH_DEDUP_READS - 1) * tags);
+  }
+  free(reads);
+  return (elapsed / 1e3) / cycles;
+}
+#endif /* TMR_ENABLE_BACKGROUND_READS */
+
+static void
+benchReadIntoArray(uint32_t tags)
+{
+  TMR_Reader r;
+  char name[48];
+
+  connectSim(&r, tags, 0, false);
+  snprintf(name, sizeof(name), "readintoarray_%u_us", tags);
+  addResult(name, timeReadIntoArray(&r, tags, true), "us", false);
+#ifdef TMR_ENABLE_BACKGROUND_READS
+  snprintf(name, sizeof(name), "readintoarray_dedup_%u_us", tags);
+  addResult(name, timeDedup(&r, tags), "us", false);
+#endif
+  TMR_destroy(&r);
+}
+
+#ifdef TMR_ENABLE_LLRP_READER
+/**
+ * Encode an RO_ACCESS_REPORT with the metadata the ThingMagic readers
+ * send for each tag.
+ *
+ * @return Frame length
+ **/
+static uint32_t
+encodeReport(uint8_t *buf, uint32_t size)
+{
+  LLRP_tSRO_ACCESS_REPORT *pReport;
+  LLRP_tSFrameEncoder *pEncoder;
+  uint32_t i, len;
+
+  pReport = LLRP_RO_ACCESS_REPORT_construct();
+  for (i = 0; i < BENCH_LLRP_TAGS; i++)
+  {
+    LLRP_tSTagReportData *pTag;
+    LLRP_tSEPC_96 *pEpc;
+    LLRP_tSROSpecID *pROSpecID;
+    LLRP_tSAntennaID *pAntenna;
+    LLRP_tSPeakRSSI *pRssi;
+    LLRP_tSChannelIndex *pChannel;
+    LLRP_tSLastSeenTimestampUTC *pLastSeen;
+    LLRP_tSTagSeenCount *pSeen;
+    LLRP_tSC1G2_PC *pPc;
+    LLRP_tSC1G2_CRC *pCrc;
+    LLRP_tSThingMagicRFPhase *pPhase;
+
+    pTag = LLRP_TagReportData_construct();
+    pEpc = LLRP_EPC_96_construct();
+    memset(pEpc->EPC.aValue, 0, 12);
+    pEpc->EPC.aValue[0] = 0xE2;
+    pEpc->EPC.aValue[10] = (uint8_t)(i >> 8);
+    pEpc->EPC.aValue[11] = (uint8_t)i;
+    LLRP_TagReportData_setEPCParameter(pTag, &pEpc->hdr);
+    pROSpecID = LLRP_ROSpecID_construct();
+    LLRP_ROSpecID_setROSpecID(pROSpecID, 1);
+    LLRP_TagReportData_setROSpecID(pTag, pROSpecID);
+    pAntenna = LLRP_AntennaID_construct();
+    LLRP_AntennaID_setAntennaID(pAntenna, (llrp_u16_t)(1 + i % 4));
+    LLRP_TagReportData_setAntennaID(pTag, pAntenna);
+    pRssi = LLRP_PeakRSSI_construct();
+    LLRP_PeakRSSI_setPeakRSSI(pRssi, (llrp_s8_t)(-40 - (int)(i % 30)));
+    LLRP_TagReportData_setPeakRSSI(pTag, pRssi);
+    pChannel = LLRP_ChannelIndex_construct();
+    LLRP_ChannelIndex_setChannelIndex(pChannel, (llrp_u16_t)(1 + i % 50));
+    LLRP_TagReportData_setChannelIndex(pTag, pChannel);
+    pLastSeen = LLRP_LastSeenTimestampUTC_construct();
+    LLRP_LastSeenTimestampUTC_setMicroseconds(pLastSeen, 1400000000000000ULL + i * 500);
+    LLRP_TagReportData_setLastSeenTimestampUTC(pTag, pLastSeen);
+    pSeen = LLRP_TagSeenCount_construct();
+    LLRP_TagSeenCount_setTagCount(pSeen, 1);
+    LLRP_TagReportData_setTagSeenCount(pTag, pSeen);
+    pPc = LLRP_C1G2_PC_construct();
+    LLRP_C1G2_PC_setPC_Bits(pPc, 0x3000);
+    LLRP_TagReportData_addAirProtocolTagData(pTag, &pPc->hdr);
+    pCrc = LLRP_C1G2_CRC_construct();
+    LLRP_C1G2_CRC_setCRC(pCrc, (llrp_u16_t)(0x1234 + i));
+    LLRP_TagReportData_addAirProtocolTagData(pTag, &pCrc->hdr);
+    pPhase = LLRP_ThingMagicRFPhase_construct();
+    LLRP_ThingMagicRFPhase_setPhase(pPhase, (llrp_u16_t)(i * 3 % 360));
+    LLRP_TagReportData_addCustom(pTag, &pPhase->hdr);
+    LLRP_RO_ACCESS_REPORT_addTagReportData(pReport, pTag);
+  }
+
+  pEncoder = LLRP_FrameEncoder_construct(buf, size);
+  LLRP_Encoder_encodeElement(&pEncoder->encoderHdr, &pReport->hdr.elementHdr);
+  len = (LLRP_RC_OK == pEncoder->encoderHdr.ErrorDetails.eResultCode) ? pEncoder->iNext : 0;
+  LLRP_Encoder_destruct(&pEncoder->encoderHdr);
+  LLRP_Element_destruct(&pReport->hdr.elementHdr);
+  return len;
+}
+
+static void
+benchLlrpDecode(void)
+{
+  static uint8_t buf[64 * 1024];
+  TMR_Reader *reader;
+  LLRP_tSTypeRegistry *pTypeRegistry;
+  LLRP_tSFrameDecoder *pDecoder;
+  LLRP_tSMessage *pMsg;
+  LLRP_tSTagReportData *pTag;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count;
+  uint32_t len;
+
+  pTypeRegistry = LLRP_getTheTypeRegistry();
+  if (NULL == pTypeRegistry)
+  {
+    errx(2, "Out of memory\n");
+  }
+  LLRP_enrollTmTypesIntoRegistry(pTypeRegistry);
+  len = encodeReport(buf, sizeof(buf));
+  if (0 == len)
+  {
+    errx(2, "Error encoding LLRP report\n");
+  }
+
+  /* Just the reader state the metadata parse looks at */
+  reader = calloc(1, sizeof(*reader));
+  if (NULL == reader)
+  {
+    errx(2, "Out of memory\n");
+  }
+  reader->readerType = TMR_READER_TYPE_LLRP;
+  strcpy(reader->u.llrpReader.capabilities.softwareVersion, "5.3.2.97");
+  reader->u.llrpReader.readPlanProtocol[1].rospecID = 1;
+  reader->u.llrpReader.readPlanProtocol[1].rospecProtocol = TMR_TAG_PROTOCOL_GEN2;
+
+  count = 0;
+  start = nowNs();
+  do
+  {
+    pDecoder = LLRP_FrameDecoder_construct(pTypeRegistry, buf, len);
+    pMsg = LLRP_Decoder_decodeMessage(&pDecoder->decoderHdr);
+    LLRP_Decoder_destruct(&pDecoder->decoderHdr);
+    if (NULL == pMsg)
+    {
+      errx(2, "Error decoding LLRP report\n");
+    }
+    for (pTag = ((LLRP_tSRO_ACCESS_REPORT *)pMsg)->listTagReportData;
+         NULL != pTag;
+         pTag = (LLRP_tSTagReportData *)pTag->hdr.pNextSubParameter)
+    {
+      TMR_TRD_init(&trd);
+      TMR_LLRP_parseMetadataFromMessage(reader, &trd, pTag);
+      count++;
+    }
+    LLRP_Element_destruct(&pMsg->elementHdr);
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+
+  free(reader);
+  LLRP_TypeRegistry_destruct(pTypeRegistry);
+
+  addResult("llrp_decode_tags_per_sec", count / (elapsed / 1e9), "tags/s", true);
+}
+#endif /* TMR_ENABLE_LLRP_READER */
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_FAULT
+/**
+ * Inject short stalls, cut short frames and disconnects into
+ * continuous reading and time the recovery from each.
+ **/
+static void
+benchFaultRecovery(void)
+{
+  TMR_Reader reader;
+  TMR_FaultInjector injector;
+  TMR_FaultConfig config;
+  TMR_FaultSummary summary;
+  TMR_Status ret;
+  uint64_t totalUs, maxUs;
+  uint32_t recovered, waitedMs, i;
+  bool resume;
+
+  TMR_faultInitConfig(&config);
+  config.kinds = TMR_FAULT_BIT(TMR_FAULT_STALL) | TMR_FAULT_BIT(TMR_FAULT_PARTIAL)
+                 | TMR_FAULT_BIT(TMR_FAULT_DISCONNECT);
+  config.startAfterMs = 200;
+  config.intervalMs = 200;
+  config.stallMs = 300;
+  config.disconnectMs = 300;
+  config.maxFaults = 8;
+
+  connectSim(&reader, tagCount, readRate, true);
+  ret = TMR_startFaultInjection(&reader, &injector, &config);
+  if (TMR_SUCCESS == ret)
+  {
+    resume = true;
+    ret = TMR_paramSet(&reader, TMR_PARAM_SERIAL_AUTORESUME, &resume);
+  }
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_startReading(&reader);
+  }
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error starting fault injection: %s\n", TMR_strerr(&reader, ret));
+  }
+  for (waitedMs = 0; waitedMs < 20000; waitedMs += 10)
+  {
+    recovered = 0;
+    for (i = 0; i < injector.faults; i++)
+    {
+      recovered += (0 != injector.records[i].recoveredUs) ? 1 : 0;
+    }
+    if ((config.maxFaults == injector.faults) && (recovered == injector.faults))
+    {
+      break;
+    }
+    tmr_sleep(10);
+  }
+  TMR_stopReading(&reader);
+  TMR_stopFaultInjection(&reader, &injector);
+  TMR_destroy(&reader);
+
+  totalUs = maxUs = 0;
+  recovered = 0;
+  for (i = 0; i < TMR_FAULT_KINDS; i++)
+  {
+    TMR_faultSummary(&injector, (TMR_FaultKind)i, &summary);
+    recovered += summary.recovered;
+    totalUs += summary.totalRecoveryUs;
+    maxUs = (summary.maxRecoveryUs > maxUs) ? summary.maxRecoveryUs : maxUs;
+  }
+  if (recovered < injector.faults)
+  {
+    /* A fault never recovered from fails the threshold */
+    maxUs = 20000000;
+  }
+  addResult("fault_recovery_mean_ms", (0 != recovered) ? totalUs / 1000.0 / recovered : 0,
+            "ms", false);
+  addResult("fault_recovery_max_ms", maxUs / 1000.0, "ms", false);
+}
+#endif
+
+#ifdef TMR_ENABLE_PDOA
+static void
+pdoaCountListener(TMR_Reader *reader, const TMR_PdoaResult *result, void *cookie)
+{
+  (*(uint64_t *)cookie)++;
+}
+
+/**
+ * Feed the phase difference engine reads hopping over 50 channels on
+ * 4 antennas, a millisecond apart, as fast as it takes them.
+ **/
+static void
+benchPdoa(void)
+{
+  TMR_PdoaConfig config;
+  TMR_PdoaEngine engine;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count, pairs, ms;
+  uint32_t id, i;
+
+  TMR_pdoaInitConfig(&config);
+  pairs = 0;
+  if (TMR_SUCCESS != TMR_pdoaStart(NULL, &engine, &config, pdoaCountListener, &pairs))
+  {
+    errx(2, "Error starting the phase difference engine\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0xE2, trd.tag.epcByteCount);
+
+  count = 0;
+  ms = 0;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++, ms++)
+    {
+      id = (uint32_t)(ms % tagCount);
+      memcpy(trd.tag.epc + 8, &id, sizeof(id));
+      trd.antenna = (uint8_t)(1 + (ms / tagCount) % 4);
+      trd.frequency = 902750 + (uint32_t)((ms / (4 * tagCount)) % 50) * 500;
+      trd.phase = (uint16_t)((ms * 7) % 180);
+      trd.rssi = -50;
+      trd.timestampHigh = 0;
+      trd.timestampLow = (uint32_t)ms;
+      TMR_pdoaAddRead(&engine, &trd);
+    }
+    count += 1024;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  TMR_pdoaStop(&engine);
+
+  addResult("pdoa_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+}
+#endif
+
+#ifdef TMR_ENABLE_RANGING
+static void
+rangeLastListener(TMR_Reader *reader, const TMR_RangeResult *result, void *cookie)
+{
+  uint32_t id;
+
+  memcpy(&id, result->tag->epc + 8, sizeof(id));
+  ((double *)cookie)[id] = result->distance;
+}
+
+/**
+ * Feed ranging reads hopping over 50 channels, tag n standing
+ * 1 + n % 32 / 4 metres away, and check where it puts them.
+ **/
+static void
+benchRange(void)
+{
+  TMR_RangeConfig config;
+  TMR_RangeEngine engine;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count, ms;
+  uint32_t id, i, frequency, distanceCm;
+  double *last, error, worst;
+
+  last = calloc(tagCount, sizeof(*last));
+  TMR_rangeInitConfig(&config);
+  if ((NULL == last)
+      || (TMR_SUCCESS != TMR_rangeStart(NULL, &engine, &config, rangeLastListener, last)))
+  {
+    errx(2, "Error starting ranging\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0xE2, trd.tag.epcByteCount);
+  trd.antenna = 1;
+
+  count = 0;
+  ms = 0;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++, ms++)
+    {
+      id = (uint32_t)(ms % tagCount);
+      memcpy(trd.tag.epc + 8, &id, sizeof(id));
+      frequency = 902750 + (uint32_t)((ms / tagCount * 7) % 50) * 500;
+      distanceCm = 100 + 25 * (id % 32);
+      trd.frequency = frequency;
+      trd.phase = (uint16_t)((7200ULL * frequency * distanceCm / 299792458ULL
+                              + 180 - 2 + ms % 5) % 180);
+      trd.timestampHigh = 0;
+      trd.timestampLow = (uint32_t)ms;
+      TMR_rangeAddRead(&engine, &trd);
+    }
+    count += 1024;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  TMR_rangeStop(&engine);
+
+  worst = 0;
+  for (id = 0; id < tagCount; id++)
+  {
+    error = last[id] * 100 - (100 + 25 * (id % 32));
+    error = (0 > error) ? -error : error;
+    worst = (error > worst) ? error : worst;
+  }
+  free(last);
+
+  addResult("range_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+  addResult("range_error_cm", worst, "cm", false);
+}
+#endif
+
+#ifdef TMR_ENABLE_PHASE_STATS
+/**
+ * Time the phase statistics kernels on a batch of 4096 tags read 16
+ * times each, one read in 16 an outlier.
+ **/
+static void
+benchPhase(void)
+{
+  TMR_PhaseKernel kernel;
+  TMR_PhaseBatch batch;
+  TMR_PhaseStats stats, *groupStats;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count;
+  uint32_t i, id, random;
+
+  if ((TMR_SUCCESS != TMR_phaseKernelInit(&kernel, 180))
+      || (TMR_SUCCESS != TMR_phaseBatchInit(&batch, 65536, 180, false)))
+  {
+    errx(2, "Error initializing the phase kernels\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0xE2, trd.tag.epcByteCount);
+  random = 1;
+  for (i = 0; i < batch.max; i++)
+  {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    id = i % 4096;
+    memcpy(trd.tag.epc + 8, &id, sizeof(id));
+    trd.phase = (uint16_t)((0 == (random & 15)) ? random % 180 : (id + random % 9) % 180);
+    trd.rssi = -40 - (int32_t)(random % 30);
+    TMR_phaseBatchAdd(&batch, &trd);
+  }
+  groupStats = calloc(batch.groupCount, sizeof(*groupStats));
+  if (NULL == groupStats)
+  {
+    errx(2, "Out of memory\n");
+  }
+
+  count = 0;
+  start = nowNs();
+  do
+  {
+    TMR_phaseStats(&kernel, batch.phase, batch.rssi, batch.count, &stats);
+    count += batch.count;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  addResult("phase_stats_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+
+  count = 0;
+  start = nowNs();
+  do
+  {
+    TMR_phaseRejectOutliers(&kernel, batch.phase, batch.rssi, batch.count, 2, NULL, &stats);
+    count += batch.count;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  addResult("phase_outlier_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+
+  count = 0;
+  start = nowNs();
+  do
+  {
+    TMR_phaseGroupStats(&kernel, &batch, true, 2, groupStats);
+    count++;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  addResult("phase_group_us", elapsed / 1e3 / count, "us", false);
+
+  free(groupStats);
+  TMR_phaseBatchFree(&batch);
+}
+#endif
+
+#ifdef TMR_ENABLE_LOCATE
+static void
+locateLastListener(TMR_Reader *reader, const TMR_LocateResult *result, void *cookie)
+{
+  uint32_t id;
+
+  memcpy(&id, result->tag->epc + 8, sizeof(id));
+  memcpy((double *)cookie + 3 * id, result->position, 3 * sizeof(double));
+}
+
+/**
+ * Feed the position estimator 4000 reads a second from four antennas
+ * 2.5 m up at the corners of a 4 m square, hopping over 50 channels,
+ * with the tags standing on a grid on the floor, and check where it
+ * puts them.
+ **/
+static void
+benchLocate(void)
+{
+  static const double corners[4][3] = {{0, 0, 2.5}, {4, 0, 2.5}, {0, 4, 2.5}, {4, 4, 2.5}};
+  TMR_LocateConfig config;
+  TMR_LocateEngine engine;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count, ms;
+  uint32_t id, i, a, frequency, random;
+  double *truth, *last, *distance, *rssi, error, dx, dy, dz;
+
+  TMR_locateInitConfig(&config);
+  for (a = 0; a < 4; a++)
+  {
+    config.antennas[a].port = (uint8_t)(a + 1);
+    memcpy(config.antennas[a].position, corners[a], sizeof(corners[a]));
+    config.antennas[a].boresight[2] = -1;
+  }
+  config.antennaCount = 4;
+  config.seedDistance = 2.5;
+  config.processNoise = 0.0001;
+
+  truth = calloc(3 * tagCount, sizeof(*truth));
+  last = calloc(3 * tagCount, sizeof(*last));
+  distance = calloc(4 * tagCount, sizeof(*distance));
+  rssi = calloc(4 * tagCount, sizeof(*rssi));
+  if ((NULL == truth) || (NULL == last) || (NULL == distance) || (NULL == rssi)
+      || (TMR_SUCCESS != TMR_locateStart(NULL, &engine, &config, locateLastListener, last)))
+  {
+    errx(2, "Error starting the position estimator\n");
+  }
+  for (id = 0; id < tagCount; id++)
+  {
+    truth[3 * id] = 0.2 + 0.4 * (id % 10);
+    truth[3 * id + 1] = 0.2 + 0.4 * (id / 10 % 10);
+    for (a = 0; a < 4; a++)
+    {
+      dx = truth[3 * id] - corners[a][0];
+      dy = truth[3 * id + 1] - corners[a][1];
+      dz = truth[3 * id + 2] - corners[a][2];
+      distance[4 * id + a] = sqrt(dx * dx + dy * dy + dz * dz);
+      rssi[4 * id + a] = config.rssiAt1m - 20 * log10(distance[4 * id + a]);
+    }
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0xE2, trd.tag.epcByteCount);
+
+  count = 0;
+  ms = 0;
+  random = 1;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++, ms++)
+    {
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      id = (uint32_t)(ms % tagCount);
+      a = (uint32_t)((ms / tagCount) % 4);
+      frequency = 902750 + (uint32_t)((ms / (4 * tagCount) * 7) % 50) * 500;
+      memcpy(trd.tag.epc + 8, &id, sizeof(id));
+      trd.antenna = (uint8_t)(a + 1);
+      trd.frequency = frequency;
+      trd.rssi = (int32_t)rssi[4 * id + a] - 3 + (int32_t)(random % 7);
+      trd.phase = (uint16_t)(((uint32_t)(720.0 * frequency * 1000 * distance[4 * id + a]
+                                         / 299792458.0)
+                              + 180 - 2 + (random >> 8) % 5) % 180);
+      trd.timestampHigh = (uint32_t)((ms / 4) >> 32);
+      trd.timestampLow = (uint32_t)(ms / 4);
+      TMR_locateAddRead(&engine, &trd);
+    }
+    count += 1024;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  TMR_locateStop(&engine);
+
+  error = 0;
+  for (id = 0; id < tagCount; id++)
+  {
+    dx = last[3 * id] - truth[3 * id];
+    dy = last[3 * id + 1] - truth[3 * id + 1];
+    dz = last[3 * id + 2] - truth[3 * id + 2];
+    error += sqrt(dx * dx + dy * dy + dz * dz) * 100 / tagCount;
+  }
+  free(truth);
+  free(last);
+  free(distance);
+  free(rssi);
+
+  addResult("locate_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+  addResult("locate_error_cm", error, "cm", false);
+}
+#endif
+
+#ifdef TMR_ENABLE_MULTI_READER
+static void
+multiCountListener(TMR_MultiSession *session, uint8_t index, const TMR_TagReadData *read,
+                   uint64_t timeUs, void *cookie)
+{
+  (*(uint64_t *)cookie)++;
+}
+
+/**
+ * Feed a session four readers' reads, 4000 a second between them,
+ * each reader's clock set off from the host's and running at its own
+ * rate, and check the clocks it fits against the true ones.
+ **/
+static void
+benchMulti(void)
+{
+  static const double offsetUs[4] = {0, 1234567, -5000000, 250000};
+  static const double drift[4] = {0, 50e-6, -30e-6, 100e-6};
+  TMR_MultiConfig config;
+  TMR_MultiSession session;
+  TMR_MultiMember *member;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count, delivered, hostUs, readerMs;
+  uint32_t i, r, random;
+  double readerUs, error, worst;
+
+  TMR_multiInitConfig(&config);
+  delivered = 0;
+  if (TMR_SUCCESS != TMR_multiStart(&session, NULL, 4, &config, multiCountListener, &delivered))
+  {
+    errx(2, "Error starting the multi-reader session\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0xE2, trd.tag.epcByteCount);
+  trd.antenna = 1;
+
+  /* Host time starts well clear of 0 so no reader clock goes negative */
+  hostUs = 10000000000ULL;
+  count = 0;
+  random = 1;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++)
+    {
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      r = i % 4;
+      /* Irregular, as reads come, so the millisecond timestamps fall all over */
+      hostUs += 150 + (random >> 16) % 200;
+      readerMs = (uint64_t)(((double)hostUs - offsetUs[r]) * (1 - drift[r]) / 1000);
+      trd.timestampHigh = (uint32_t)(readerMs >> 32);
+      trd.timestampLow = (uint32_t)readerMs;
+      trd.phase = (uint16_t)(random % 180);
+      TMR_multiAddRead(&session, (uint8_t)r, &trd, hostUs + 200 + random % 2000);
+    }
+    TMR_multiFlush(&session, hostUs);
+    count += 1024;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+
+  /* Where each fitted clock puts the host's last microsecond */
+  worst = 0;
+  for (r = 0; r < 4; r++)
+  {
+    member = &session.members[r];
+    readerUs = ((double)hostUs - offsetUs[r]) * (1 - drift[r]);
+    error = readerUs + member->offsetUs
+            + member->driftPpm * 1e-6 * (readerUs - (double)member->clockOrigin)
+            - (double)hostUs;
+    error = (0 > error) ? -error : error;
+    worst = (error > worst) ? error : worst;
+  }
+  TMR_multiStop(&session);
+  if (delivered != count)
+  {
+    errx(2, "Error merging: %llu of %llu reads passed on\n", (unsigned long long)delivered,
+         (unsigned long long)count);
+  }
+
+  addResult("multi_merge_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+  addResult("multi_clock_error_us", worst, "us", false);
+}
+#endif
+
+#ifdef TMR_ENABLE_ANTENNA_SCHEDULE
+/**
+ * Read 4 tags from the simulated module on antennas 1, 3 and 4 by a
+ * schedule, and see how far apart their reads on different antennas
+ * are.
+ **/
+static void
+benchSchedule(void)
+{
+  TMR_Reader r;
+  TMR_ScheduleConfig config;
+  TMR_Schedule schedule;
+  TMR_Status ret;
+
+  connectSim(&r, 4, 1000, true);
+  TMR_scheduleInitConfig(&config);
+  config.antennas[0] = 1;
+  config.antennas[1] = 3;
+  config.antennas[2] = 4;
+  config.antennaCount = 3;
+  config.tagCount = 4;
+  ret = TMR_scheduleStart(&r, &schedule, &config);
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_startReading(&r);
+  }
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error reading by a schedule: %s\n", TMR_strerr(&r, ret));
+  }
+  tmr_sleep(durationMs);
+  TMR_stopReading(&r);
+  TMR_scheduleStop(&schedule);
+  TMR_destroy(&r);
+
+  addResult("schedule_pair_p90_us", (0 != schedule.pairs) ? TMR_scheduleLatencyUs(&schedule, 90)
+                                                         : 1e9, "us", false);
+}
+#endif
+
+#ifdef TMR_ENABLE_TAG_EVENTS
+static void
+eventsCountListener(TMR_Reader *reader, const TMR_TagEvent *event, void *cookie)
+{
+  uint64_t (*counts)[TMR_TAG_EVENT_TYPES];
+
+  /* Standing tags' EPCs start 0x30, passing ones' 0xE2 */
+  counts = cookie;
+  counts[(0x30 == event->tag->epc[0]) ? 0 : 1][event->type]++;
+}
+
+/**
+ * Feed the event engine 10000 reads a second: half of 64 tags standing
+ * still, half of a stream of tags passing by at 0.7 m/s, each read for
+ * about 200 ms, and check the standing ones come out stationary and
+ * the passing ones moving.
+ **/
+static void
+benchEvents(void)
+{
+  TMR_TagEventConfig config;
+  TMR_TagEventEngine engine;
+  TMR_TagReadData trd;
+  uint64_t counts[2][TMR_TAG_EVENT_TYPES];
+  uint64_t start, elapsed, n, s, timeUs, timeMs;
+  uint32_t i, id, random;
+  double frac;
+
+  TMR_tagEventsInitConfig(&config);
+  config.slots = 4096;
+  memset(counts, 0, sizeof(counts));
+  if (TMR_SUCCESS != TMR_tagEventsStart(NULL, &engine, &config, eventsCountListener, counts))
+  {
+    errx(2, "Error starting the tag event engine\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0, trd.tag.epcByteCount);
+  trd.antenna = 1;
+
+  n = 0;
+  random = 1;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++, n++)
+    {
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      timeUs = n * 100;
+      if (n & 1)
+      {
+        id = (random >> 8) % 64;
+        trd.tag.epc[0] = 0x30;
+        trd.rssi = -55 + (int32_t)(random % 3) - 1;
+        trd.frequency = 902750 + 500 * (id % 50);
+        trd.phase = (uint16_t)((id * 37 + 178 + random % 5) % 180);
+      }
+      else
+      {
+        /* A window of 32 tags that moves on one tag every 32 stream reads */
+        s = n >> 1;
+        id = (uint32_t)(s / 32) + (random >> 8) % 32;
+        frac = (double)(s + 31 * 32 - 32 * (uint64_t)id) / (32 * 32);
+        trd.tag.epc[0] = 0xE2;
+        trd.rssi = (int32_t)(-70 + 30 * (1 - ((frac > 0.5) ? 2 * frac - 1 : 1 - 2 * frac)));
+        trd.frequency = 902750 + 500 * (id % 50);
+        trd.phase = (uint16_t)((id * 37 + 1500 * timeUs / 1000000 + random % 5) % 180);
+      }
+      trd.tag.epc[8] = (uint8_t)(id >> 24);
+      trd.tag.epc[9] = (uint8_t)(id >> 16);
+      trd.tag.epc[10] = (uint8_t)(id >> 8);
+      trd.tag.epc[11] = (uint8_t)id;
+      timeMs = timeUs / 1000;
+      trd.timestampHigh = (uint32_t)(timeMs >> 32);
+      trd.timestampLow = (uint32_t)timeMs;
+      TMR_tagEventsAddRead(&engine, &trd);
+    }
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  TMR_tagEventsStop(&engine);
+
+  if ((64 != counts[0][TMR_TAG_EVENT_STATIONARY]) || (0 != counts[0][TMR_TAG_EVENT_MOVING])
+      || (0 != counts[1][TMR_TAG_EVENT_STATIONARY])
+      || (counts[1][TMR_TAG_EVENT_MOVING] < counts[1][TMR_TAG_EVENT_ENTERED] * 9 / 10)
+      || (counts[1][TMR_TAG_EVENT_DEPARTED] != counts[1][TMR_TAG_EVENT_ENTERED]))
+  {
+    errx(2, "Error in tag events: standing %llu stationary, %llu moving; passing %llu entered, "
+         "%llu moving, %llu stationary, %llu departed\n",
+         (unsigned long long)counts[0][TMR_TAG_EVENT_STATIONARY],
+         (unsigned long long)counts[0][TMR_TAG_EVENT_MOVING],
+         (unsigned long long)counts[1][TMR_TAG_EVENT_ENTERED],
+         (unsigned long long)counts[1][TMR_TAG_EVENT_MOVING],
+         (unsigned long long)counts[1][TMR_TAG_EVENT_STATIONARY],
+         (unsigned long long)counts[1][TMR_TAG_EVENT_DEPARTED]);
+  }
+
+  addResult("events_reads_per_sec", n * 1e9 / elapsed, "reads/s", true);
+}
+#endif
+
+#ifdef TMR_ENABLE_PORTAL
+/** Passages of benchPortal(): one starts every 500 ms, walking 7 m at 1 m/s */
+#define BENCH_PASSAGE_US 500000
+#define BENCH_PASSAGE_SPAN 14
+static bool portalStopping;
+static uint64_t portalDecided, portalCorrect;
+static double portalLagMs;
+
+/** Which way passage n goes: true for in */
+static bool
+portalGoesIn(uint32_t n)
+{
+  return 0 != ((n * 2654435761U) & 0x80000000U);
+}
+
+static void
+portalListener(TMR_Reader *reader, const TMR_PortalDecision *decision, void *cookie)
+{
+  uint32_t n;
+  double lagMs;
+
+  if (portalStopping)
+  {
+    return;
+  }
+  n = ((uint32_t)decision->tag->epc[8] << 24) | ((uint32_t)decision->tag->epc[9] << 16)
+      | ((uint32_t)decision->tag->epc[10] << 8) | decision->tag->epc[11];
+  portalDecided++;
+  if (decision->direction == (portalGoesIn(n) ? TMR_PORTAL_IN : TMR_PORTAL_OUT))
+  {
+    portalCorrect++;
+  }
+  lagMs = (decision->timeUs - decision->lastUs) / 1000.0;
+  portalLagMs = (lagMs > portalLagMs) ? lagMs : portalLagMs;
+}
+
+/**
+ * Walk tags through a doorway 2 m wide, with antenna 1 on the outside
+ * and antenna 2 on the inside, 1 m either side of it.  The reader
+ * switches antennas every 10 ms and hops channels every 200 ms, and
+ * reads a tag up to 2.5 m from an antenna.
+ **/
+static void
+benchPortal(void)
+{
+  TMR_PortalConfig config;
+  TMR_PortalEngine engine;
+  TMR_TagReadData trd;
+  uint64_t start, elapsed, count, timeUs, lastSweepUs, timeMs, walkUs;
+  uint32_t i, n, random;
+  int32_t now;
+  double x, xa, d, frequency, phase;
+
+  TMR_portalInitConfig(&config);
+  TMR_portalSetAntenna(&config, 1, 0, TMR_PORTAL_ROLE_OUTSIDE);
+  TMR_portalSetAntenna(&config, 2, 0, TMR_PORTAL_ROLE_INSIDE);
+  portalStopping = false;
+  portalDecided = portalCorrect = 0;
+  portalLagMs = 0;
+  if (TMR_SUCCESS != TMR_portalStart(NULL, &engine, &config, portalListener, NULL))
+  {
+    errx(2, "Error starting the portal engine\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0, trd.tag.epcByteCount);
+  trd.tag.epc[0] = 0xE2;
+
+  /* Passage n starts at n * BENCH_PASSAGE_US, after a second of nothing */
+  timeUs = 1000000;
+  lastSweepUs = timeUs;
+  count = 0;
+  random = 1;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++)
+    {
+      timeUs += 200;
+      if (timeUs - lastSweepUs >= 50000)
+      {
+        TMR_portalSweep(&engine, timeUs);
+        lastSweepUs = timeUs;
+      }
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      now = (int32_t)((timeUs - 1000000) / BENCH_PASSAGE_US);
+      if (now < (int32_t)((random >> 8) % BENCH_PASSAGE_SPAN))
+      {
+        continue;
+      }
+      n = (uint32_t)(now - (int32_t)((random >> 8) % BENCH_PASSAGE_SPAN));
+      walkUs = timeUs - 1000000 - (uint64_t)n * BENCH_PASSAGE_US;
+      x = portalGoesIn(n) ? -3.5 + walkUs / 1e6 : 3.5 - walkUs / 1e6;
+      trd.antenna = (uint8_t)(1 + (timeUs / 10000) % 2);
+      xa = (1 == trd.antenna) ? -1 : 1;
+      d = sqrt((x - xa) * (x - xa) + 1);
+      if (2.5 < d)
+      {
+        continue;
+      }
+      frequency = 902750 + 500 * (((timeUs / 200000) * 2654435761U >> 16) % 50);
+      phase = fmod(720 * frequency * 1000 * d / 299792458.0 + 178 + random % 5, 180);
+      trd.frequency = (uint32_t)frequency;
+      trd.phase = (uint16_t)phase;
+      trd.rssi = (int32_t)(-35 - 20 * log10(d)) + (int32_t)((random >> 4) % 5) - 2;
+      trd.tag.epc[8] = (uint8_t)(n >> 24);
+      trd.tag.epc[9] = (uint8_t)(n >> 16);
+      trd.tag.epc[10] = (uint8_t)(n >> 8);
+      trd.tag.epc[11] = (uint8_t)n;
+      timeMs = timeUs / 1000;
+      trd.timestampHigh = (uint32_t)(timeMs >> 32);
+      trd.timestampLow = (uint32_t)timeMs;
+      TMR_portalAddRead(&engine, &trd);
+      count++;
+    }
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL);
+  portalStopping = true;
+  TMR_portalStop(&engine);
+
+  addResult("portal_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+  addResult("portal_accuracy_pct", (0 == portalDecided) ? 0 : 100.0 * portalCorrect / portalDecided,
+            "%", true);
+  addResult("portal_decision_lag_ms", portalLagMs, "ms", false);
+}
+#endif
+
+#ifdef TMR_ENABLE_READ_LOG
+/** Most reads benchReadLog() writes, to bound the file */
+#define BENCH_READLOG_MAX_READS (1 << 22)
+
+/** Reads a scan matched, and the sum of their fields */
+typedef struct BenchLogSum
+{
+  uint64_t reads;
+  uint64_t sum;
+} BenchLogSum;
+
+static uint64_t
+logReadSum(const TMR_TagReadData *read)
+{
+  return read->tag.epc[11] + read->antenna + read->frequency + read->phase
+         + (uint16_t)read->rssi + read->timestampLow;
+}
+
+static void
+logSumListener(const TMR_TagReadData *read, void *cookie)
+{
+  BenchLogSum *sum;
+
+  sum = cookie;
+  sum->reads++;
+  sum->sum += logReadSum(read);
+}
+
+/**
+ * Log 10000 reads a second of tags from -t, the reader switching
+ * antennas every 10 ms and hopping channels every 200 ms, then scan it
+ * all, and one tag over one second, and check the scans give back
+ * what was written.
+ **/
+static void
+benchReadLog(void)
+{
+  TMR_ReadLogWriter writer;
+  TMR_ReadLog log;
+  TMR_ReadLogQuery query;
+  TMR_TagReadData trd;
+  TMR_TagData tag;
+  BenchLogSum all, one, scanned;
+  char path[] = "/tmp/tmrbenchXXXXXX";
+  uint64_t start, elapsed, count, timeUs, timeMs, queries;
+  uint32_t i, id, random;
+  int fd;
+
+  fd = mkstemp(path);
+  if (-1 == fd)
+  {
+    errx(2, "Can't create a temporary file\n");
+  }
+  close(fd);
+  if (TMR_SUCCESS != TMR_readLogStart(NULL, &writer, path, 0))
+  {
+    errx(2, "Error starting the read log\n");
+  }
+  TMR_TRD_init(&trd);
+  trd.metadataFlags = TMR_TRD_METADATA_FLAG_ALL;
+  trd.tag.protocol = TMR_TAG_PROTOCOL_GEN2;
+  trd.tag.epcByteCount = 12;
+  memset(trd.tag.epc, 0, trd.tag.epcByteCount);
+  trd.tag.epc[0] = 0xE2;
+
+  /* The query is for tag 7 in the second second */
+  memset(&all, 0, sizeof(all));
+  memset(&one, 0, sizeof(one));
+  count = 0;
+  random = 1;
+  start = nowNs();
+  do
+  {
+    for (i = 0; i < 1024; i++, count++)
+    {
+      random ^= random << 13;
+      random ^= random >> 17;
+      random ^= random << 5;
+      timeUs = count * 100;
+      id = (random >> 8) % tagCount;
+      trd.antenna = (uint8_t)(1 + (timeUs / 10000) % 4);
+      trd.frequency = 902750 + 500 * (uint32_t)(((timeUs / 200000) * 2654435761U >> 16) % 50);
+      trd.phase = (uint16_t)((id * 37 + trd.frequency / 100 + random % 5) % 180);
+      trd.rssi = -40 - (int32_t)((id + (random >> 4) % 5) % 30);
+      trd.tag.epc[8] = (uint8_t)(id >> 24);
+      trd.tag.epc[9] = (uint8_t)(id >> 16);
+      trd.tag.epc[10] = (uint8_t)(id >> 8);
+      trd.tag.epc[11] = (uint8_t)id;
+      timeMs = timeUs / 1000;
+      trd.timestampHigh = (uint32_t)(timeMs >> 32);
+      trd.timestampLow = (uint32_t)timeMs;
+      TMR_readLogAddRead(&writer, &trd);
+      all.reads++;
+      all.sum += logReadSum(&trd);
+      if ((7 == id) && (1000 <= timeMs) && (timeMs < 2000))
+      {
+        one.reads++;
+        one.sum += logReadSum(&trd);
+      }
+    }
+    elapsed = nowNs() - start;
+  }
+  while ((elapsed < durationMs * 1000000ULL) && (count < BENCH_READLOG_MAX_READS));
+  if (TMR_SUCCESS != TMR_readLogStop(&writer))
+  {
+    errx(2, "Error writing the read log\n");
+  }
+  elapsed = nowNs() - start;
+  addResult("readlog_write_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+  addResult("readlog_bytes_per_read", (double)writer.bytes / count, "bytes", false);
+
+  if (TMR_SUCCESS != TMR_readLogOpen(&log, path))
+  {
+    errx(2, "Error opening the read log\n");
+  }
+  TMR_readLogInitQuery(&query);
+  memset(&scanned, 0, sizeof(scanned));
+  start = nowNs();
+  TMR_readLogScan(&log, &query, logSumListener, &scanned);
+  elapsed = nowNs() - start;
+  if ((scanned.reads != all.reads) || (scanned.sum != all.sum))
+  {
+    errx(2, "Error in the read log: %llu reads scanned of %llu\n",
+         (unsigned long long)scanned.reads, (unsigned long long)all.reads);
+  }
+  addResult("readlog_scan_reads_per_sec", count * 1e9 / elapsed, "reads/s", true);
+
+  memcpy(tag.epc, trd.tag.epc, trd.tag.epcByteCount);
+  tag.epcByteCount = trd.tag.epcByteCount;
+  tag.epc[8] = tag.epc[9] = tag.epc[10] = 0;
+  tag.epc[11] = 7;
+  query.tag = &tag;
+  query.minTimeMs = 1000;
+  query.maxTimeMs = 1999;
+  queries = 0;
+  start = nowNs();
+  do
+  {
+    memset(&scanned, 0, sizeof(scanned));
+    TMR_readLogScan(&log, &query, logSumListener, &scanned);
+    if ((scanned.reads != one.reads) || (scanned.sum != one.sum))
+    {
+      errx(2, "Error in the read log query: %llu reads of %llu\n",
+           (unsigned long long)scanned.reads, (unsigned long long)one.reads);
+    }
+    queries++;
+    elapsed = nowNs() - start;
+  }
+  while (elapsed < durationMs * 1000000ULL / 4);
+  addResult("readlog_query_us", elapsed / 1e3 / queries, "us", false);
+
+  TMR_readLogClose(&log);
+  unlink(path);
+}
+#endif
+
+/**
+ * Print the results and check them against the thresholds.
+ *
+ * @return true if no metric failed its threshold
+ **/
+static bool
+report(FILE *out)
+{
+  const BenchThreshold *t;
+  bool allPass, pass;
+  int i, j;
+
+  allPass = true;
+  fprintf(out, "{\n  \"durationMs\": %u,\n  \"tags\": %u,\n  \"rate\": %u,\n  \"results\": [\n",
+          durationMs, tagCount, readRate);
+  for (i = 0; i < resultCount; i++)
+  {
+    const BenchResult *r = &results[i];
+
+    t = NULL;
+    for (j = 0; j < thresholdCount; j++)
+    {
+      if (0 == strcmp(thresholds[j].name, r->name))
+      {
+        t = &thresholds[j];
+      }
+    }
+    fprintf(out, "    {\"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\", \"better\": \"%s\", ",
+            r->name, r->value, r->unit, r->higherIsBetter ? "higher" : "lower");
+    if (NULL == t)
+    {
+      fprintf(out, "\"threshold\": null, \"pass\": null}");
+    }
+    else
+    {
+      pass = r->higherIsBetter ? (r->value >= t->value) : (r->value <= t->value);
+      allPass = allPass && pass;
+      fprintf(out, "\"threshold\": %.3f, \"pass\": %s}", t->value, pass ? "true" : "false");
+    }
+    fprintf(out, "%s\n", (i + 1 < resultCount) ? "," : "");
+  }
+  fprintf(out, "  ],\n  \"pass\": %s\n}\n", allPass ? "true" : "false");
+  return allPass;
+}
+
+static void
+usage(void)
+{
+  errx(2, "Usage: tmrbench [-d ms] [-t tags] [-r rate] [-f thresholds]\n"
+          "                [-T name=value] [-o output]\n");
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r;
+  FILE *out;
+  char *eq;
+  bool pass;
+  int opt;
+
+  out = stdout;
+  while (-1 != (opt = getopt(argc, argv, "d:t:r:f:T:o:")))
+  {
+    switch (opt)
+    {
+      case 'd':
+        durationMs = atoi(optarg);
+        break;
+      case 't':
+        tagCount = atoi(optarg);
+        break;
+      case 'r':
+        readRate = atoi(optarg);
+        break;
+      case 'f':
+        readThresholds(optarg);
+        break;
+      case 'T':
+        eq = strchr(optarg, '=');
+        if (NULL == eq)
+        {
+          usage();
+        }
+        *eq = '\0';
+        addThreshold(optarg, atof(eq + 1));
+        break;
+      case 'o':
+        out = fopen(optarg, "w");
+        if (NULL == out)
+        {
+          errx(2, "Can't open %s\n", optarg);
+        }
+        break;
+      default:
+        usage();
+    }
+  }
+  if ((0 == durationMs) || (0 == tagCount))
+  {
+    usage();
+  }
+
+  benchCrc();
+
+  connectSim(&r, tagCount, readRate, true);
+  recordFrames(&r);
+  benchReceive(&r, false);
+#ifdef TMR_ENABLE_TRANSPORT_TAP
+  benchReceive(&r, true);
+#endif
+  benchParse(&r);
+  benchAsyncLatency(&r);
+  TMR_destroy(&r);
+
+  benchReadIntoArray(16);
+  benchReadIntoArray(128);
+  benchReadIntoArray(1024);
+
+#ifdef TMR_ENABLE_LLRP_READER
+  benchLlrpDecode();
+#endif
+
+#ifdef TMR_ENABLE_SERIAL_TRANSPORT_FAULT
+  benchFaultRecovery();
+#endif
+
+#ifdef TMR_ENABLE_PDOA
+  benchPdoa();
+#endif
+
+#ifdef TMR_ENABLE_RANGING
+  benchRange();
+#endif
+
+#ifdef TMR_ENABLE_PHASE_STATS
+  benchPhase();
+#endif
+
+#ifdef TMR_ENABLE_LOCATE
+  benchLocate();
+#endif
+
+#ifdef TMR_ENABLE_MULTI_READER
+  benchMulti();
+#endif
+
+#ifdef TMR_ENABLE_ANTENNA_SCHEDULE
+  benchSchedule();
+#endif
+
+#ifdef TMR_ENABLE_TAG_EVENTS
+  benchEvents();
+#endif
+
+#ifdef TMR_ENABLE_PORTAL
+  benchPortal();
+#endif
+
+#ifdef TMR_ENABLE_READ_LOG
+  benchReadLog();
+#endif
+
+  pass = report(out);
+  if (stdout != out)
+  {
+    fclose(out);
+  }
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,1035 @@
+/**
+ * Fuzzing and property test harness for the serial frame parser.
+ *
+ * Feeds a byte stream through a memory transport into
+ * TMR_SR_receiveMessage(), TMR_SR_hasMoreTags(), TMR_SR_getNextTag()
+ * and TMR_SR_parseMetadataFromMessage(), as if a module had sent it,
+ * and aborts when a property fails:
+ *
+ *   - a frame TMR_SR_receiveMessage() accepts starts with SOH, fits
+ *     the buffer and, with CRC on, has a good CRC
+ *   - parsing a tag record leaves the cursor inside the frame
+ *   - parsing a tag record gives the same read whatever follows the
+ *     frame in the buffer (each stream record is parsed twice, from
+ *     a heap copy of exactly TMR_SR_MAX_PACKET_SIZE bytes with the
+ *     tail filled with 0x00 and then 0xFF)
+ *   - a well-formed record generated here parses back to what was
+ *     encoded (property runs only)
+ *
+ * Out of bounds accesses are left to the sanitizers: build the
+ * library and harness with -fsanitize=address,undefined.
+ *
+ * The first byte of an input selects what is fuzzed, the rest is the
+ * stream from the module:
+ *
+ *   bits 0-1  0 or 3: continuous reading, TMR_SR_hasMoreTags() and the
+ *             background parser; 1: sync reading, TMR_SR_getNextTag()
+ *             over GET_TAG_ID_BUFFER responses; 2: TMR_SR_receiveMessage()
+ *   bit 2     CRC off
+ *   bit 3     gen2 read of all memory banks
+ *   bit 4     M5e rather than M6e
+ *   bits 5-6  read data buffers: 0 embedded, 1 none, 2 five bytes,
+ *             3 255 bytes of data and three per memory bank
+ *
+ * With -DTMR_FUZZ_LIBFUZZER only LLVMFuzzerTestOneInput() is built,
+ * for libFuzzer.  Otherwise there is a main() that runs each file
+ * named (or stdin for -), as AFL expects, or runs property tests:
+ *
+ * Usage: fuzzserial [-s seed] [-n runs] [-g dir] [file ...]
+ *
+ *   -n  generate and check this many inputs (default 0, or 10000
+ *       when no files are named)
+ *   -s  seed of the generator (default 1)
+ *   -g  also write the inputs to dir, as a seed corpus
+ * @file fuzzserial.c
+ */
+
+#include <tm_reader.h>
+#include <serial_reader_imp.h>
+#include <tmr_utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FUZZ_MAX_MESSAGES 64
+#define FUZZ_MAX_INPUT    4096
+#define FUZZ_BANK_MAX     3
+
+#define FUZZ_MODE(m)           ((m) & 0x03)
+#define FUZZ_MODE_STREAM       0
+#define FUZZ_MODE_SYNC         1
+#define FUZZ_MODE_RECEIVE      2
+#define FUZZ_CRC_OFF           0x04
+#define FUZZ_ALL_BANKS         0x08
+#define FUZZ_M5E               0x10
+#define FUZZ_BUFFERS(m)        (((m) >> 5) & 0x03)
+
+/** Bytes the module sends, served by the memory transport */
+typedef struct FuzzStream
+{
+  const uint8_t *data;
+  uint32_t length;
+  uint32_t pos;
+} FuzzStream;
+
+/** A tag read and the buffers it copies into */
+typedef struct FuzzRead
+{
+  TMR_TagReadData trd;
+  uint8_t data[255];
+  uint8_t banks[4][FUZZ_BANK_MAX];
+} FuzzRead;
+
+/** What the generator encoded in a tag record */
+typedef struct FuzzTruth
+{
+  uint16_t flags;
+  uint8_t readCount;
+  int8_t rssi;
+  uint8_t antenna;
+  uint32_t frequency;
+  uint32_t dspMicros;
+  uint16_t phase;
+  uint8_t protocol;
+  uint8_t gpio;
+  uint8_t dataLen;
+  uint8_t data[64];
+  uint8_t pcLen;
+  uint8_t pc[6];
+  uint8_t epcLen;
+  uint8_t epc[TMR_MAX_EPC_BYTE_COUNT];
+  uint16_t crc;
+} FuzzTruth;
+
+static TMR_Reader reader;
+static TMR_SR_SerialTransport simTransport;
+static bool readerReady;
+static uint8_t fuzzMode;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+static void
+fuzzFail(const char *what, const uint8_t *frame)
+{
+  int j, len;
+
+  fprintf(stderr, "Property failed: %s\n", what);
+  if (NULL != frame)
+  {
+    len = frame[1] + 7;
+    len = (TMR_SR_MAX_PACKET_SIZE < len) ? TMR_SR_MAX_PACKET_SIZE : len;
+    fprintf(stderr, "Frame:");
+    for (j = 0; j < len; j++)
+    {
+      fprintf(stderr, " %02X", frame[j]);
+    }
+    fprintf(stderr, "\n");
+  }
+  abort();
+}
+
+static TMR_Status
+memReceiveBytes(TMR_SR_SerialTransport *this, uint32_t length,
+                uint32_t *messageLength, uint8_t *message, const uint32_t timeoutMs)
+{
+  FuzzStream *s;
+  uint32_t n;
+
+  s = this->cookie;
+  n = s->length - s->pos;
+  n = (n < length) ? n : length;
+  memcpy(message, s->data + s->pos, n);
+  s->pos += n;
+  *messageLength = n;
+
+  return (n == length) ? TMR_SUCCESS : TMR_ERROR_TIMEOUT;
+}
+
+static TMR_Status
+memSendBytes(TMR_SR_SerialTransport *this, uint32_t length,
+             uint8_t* message, const uint32_t timeoutMs)
+{
+  return TMR_SUCCESS;
+}
+
+static TMR_Status
+memFlush(TMR_SR_SerialTransport *this)
+{
+  return TMR_SUCCESS;
+}
+
+/**
+ * Connect to the simulated module once, for a reader in the state a
+ * real connect leaves it in, then take its transport over.
+ **/
+static void
+fuzzInit(void)
+{
+  char uri[] = "sim:///m6e";
+  TMR_Status ret;
+
+  if (readerReady)
+  {
+    return;
+  }
+  ret = TMR_create(&reader, uri);
+  if (TMR_SUCCESS == ret)
+  {
+    ret = TMR_connect(&reader);
+  }
+  if (TMR_SUCCESS != ret)
+  {
+    errx(2, "Error connecting to %s: %s\n", uri, TMR_strerr(&reader, ret));
+  }
+  simTransport = reader.u.serialReader.transport;
+  reader.u.serialReader.transport.receiveBytes = memReceiveBytes;
+  reader.u.serialReader.transport.sendBytes = memSendBytes;
+  reader.u.serialReader.transport.flush = memFlush;
+  reader.u.serialReader.transportTimeout = 0;
+  reader.u.serialReader.searchTimeoutMs = 0;
+  readerReady = true;
+}
+
+static void
+initRead(FuzzRead *r)
+{
+  TMR_uint8List *banks[4];
+  int b;
+
+  memset(r, 0, sizeof(*r));
+  TMR_TRD_init(&r->trd);
+  banks[0] = &r->trd.epcMemData;
+  banks[1] = &r->trd.tidMemData;
+  banks[2] = &r->trd.userMemData;
+  banks[3] = &r->trd.reservedMemData;
+  switch (FUZZ_BUFFERS(fuzzMode))
+  {
+    case 1:
+      r->trd.data.list = NULL;
+      r->trd.data.max = 0;
+      for (b = 0; b < 4; b++)
+      {
+        banks[b]->list = NULL;
+        banks[b]->max = 0;
+      }
+      break;
+    case 2:
+    case 3:
+      TMR_TRD_init_data(&r->trd, (2 == FUZZ_BUFFERS(fuzzMode)) ? 5 : 255, r->data);
+      for (b = 0; b < 4; b++)
+      {
+        banks[b]->list = r->banks[b];
+        banks[b]->max = (2 == FUZZ_BUFFERS(fuzzMode)) ? 0 : FUZZ_BANK_MAX;
+        banks[b]->len = 0;
+      }
+      break;
+    default:
+      break;
+  }
+  r->trd.data.len = 0;
+  for (b = 0; b < 4; b++)
+  {
+    banks[b]->len = 0;
+  }
+}
+
+static bool
+sameList(const TMR_uint8List *a, const TMR_uint8List *b)
+{
+  uint16_t n;
+
+  if ((a->len != b->len) || (a->max != b->max))
+  {
+    return false;
+  }
+  n = (a->len < a->max) ? a->len : a->max;
+  return (0 == n) || (NULL == a->list) || (0 == memcmp(a->list, b->list, n));
+}
+
+static bool
+sameRead(const TMR_TagReadData *a, const TMR_TagReadData *b)
+{
+  int j;
+
+  if ((a->readCount != b->readCount) || (a->rssi != b->rssi)
+      || (a->antenna != b->antenna) || (a->frequency != b->frequency)
+      || (a->dspMicros != b->dspMicros) || (a->phase != b->phase)
+      || (a->tag.protocol != b->tag.protocol) || (a->gpioCount != b->gpioCount)
+      || (a->tag.epcByteCount != b->tag.epcByteCount) || (a->tag.crc != b->tag.crc)
+      || (0 != memcmp(a->tag.epc, b->tag.epc, a->tag.epcByteCount)))
+  {
+    return false;
+  }
+  for (j = 0; j < a->gpioCount; j++)
+  {
+    if (a->gpio[j].high != b->gpio[j].high)
+    {
+      return false;
+    }
+  }
+  if ((TMR_TAG_PROTOCOL_GEN2 == a->tag.protocol)
+      && ((a->tag.u.gen2.pcByteCount != b->tag.u.gen2.pcByteCount)
+          || (0 != memcmp(a->tag.u.gen2.pc, b->tag.u.gen2.pc, a->tag.u.gen2.pcByteCount))))
+  {
+    return false;
+  }
+  return sameList(&a->data, &b->data) && sameList(&a->epcMemData, &b->epcMemData)
+    && sameList(&a->tidMemData, &b->tidMemData) && sameList(&a->userMemData, &b->userMemData)
+    && sameList(&a->reservedMemData, &b->reservedMemData);
+}
+
+/** End of the payload of a received frame, where records must stop */
+static int
+payloadEnd(const uint8_t *msg)
+{
+  int end;
+
+  end = msg[1] + 5;
+  return (TMR_SR_MAX_PACKET_SIZE - 1 < end) ? TMR_SR_MAX_PACKET_SIZE - 1 : end;
+}
+
+/**
+ * Parse the record at start of a stream frame, as the background
+ * parser does, from a copy whose bytes past the frame are fill.
+ **/
+static uint8_t
+parseCopy(const uint8_t *msg, uint8_t start, uint8_t fill, FuzzRead *r)
+{
+  uint8_t *copy;
+  int frameLen;
+  uint8_t i;
+
+  frameLen = msg[1] + ((fuzzMode & FUZZ_CRC_OFF) ? 5 : 7);
+  copy = malloc(TMR_SR_MAX_PACKET_SIZE);
+  if (NULL == copy)
+  {
+    errx(2, "Out of memory\n");
+  }
+  memcpy(copy, msg, frameLen);
+  memset(copy + frameLen, fill, TMR_SR_MAX_PACKET_SIZE - frameLen);
+
+  initRead(r);
+  reader.u.serialReader.gen2AllMemoryBankEnabled = (0 != (fuzzMode & FUZZ_ALL_BANKS));
+  i = start;
+  TMR_SR_parseMetadataFromMessage(&reader, &r->trd, GETU16AT(copy, 8), &i, copy);
+  free(copy);
+
+  return i;
+}
+
+static void
+checkRecord(const uint8_t *msg, uint8_t start)
+{
+  static FuzzRead a, b;
+  uint8_t endA, endB;
+
+  endA = parseCopy(msg, start, 0x00, &a);
+  endB = parseCopy(msg, start, 0xFF, &b);
+  if ((endA < start) || (endA > payloadEnd(msg)))
+  {
+    fuzzFail("record cursor left the frame", msg);
+  }
+  if ((endA != endB) || (false == sameRead(&a.trd, &b.trd)))
+  {
+    fuzzFail("record parse depends on bytes past the frame", msg);
+  }
+  if (a.trd.tag.epcByteCount > TMR_MAX_EPC_BYTE_COUNT)
+  {
+    fuzzFail("EPC longer than the tag data holds", msg);
+  }
+}
+
+static void
+checkFrame(TMR_Status ret, const uint8_t *msg)
+{
+  uint16_t crc;
+
+  /* Only a whole, checked frame gets past the transport errors */
+  if ((TMR_SUCCESS != ret) && (false == TMR_ERROR_IS_CODE(ret)))
+  {
+    return;
+  }
+  if (0xFF != msg[0])
+  {
+    fuzzFail("frame accepted without SOH", msg);
+  }
+  if (msg[1] > TMR_SR_MAX_PACKET_SIZE - ((fuzzMode & FUZZ_CRC_OFF) ? 5 : 7))
+  {
+    fuzzFail("frame accepted longer than the buffer", msg);
+  }
+  if (0 == (fuzzMode & FUZZ_CRC_OFF))
+  {
+    crc = TMR_SR_crc((uint8_t *)&msg[1], msg[1] + 4);
+    if (crc != GETU16AT(msg, msg[1] + 5))
+    {
+      fuzzFail("frame accepted with a bad CRC", msg);
+    }
+  }
+}
+
+static void
+fuzzStream(FuzzStream *s)
+{
+  TMR_SR_SerialReader *sr;
+  TMR_Status ret;
+  int n;
+
+  sr = &reader.u.serialReader;
+  reader.continuousReading = true;
+  for (n = 0; (n < FUZZ_MAX_MESSAGES) && (s->pos < s->length); n++)
+  {
+    sr->tagsRemainingInBuffer = 0;
+    sr->oldQ.type = TMR_SR_GEN2_Q_INVALID;
+    reader.isStatusResponse = false;
+    ret = TMR_SR_hasMoreTags(&reader);
+    if ((TMR_SUCCESS == ret) && (false == reader.isStatusResponse))
+    {
+      checkFrame(ret, sr->bufResponse);
+      checkRecord(sr->bufResponse, sr->bufPointer);
+    }
+  }
+  sr->tagsRemainingInBuffer = 0;
+  reader.finishedReading = false;
+}
+
+static void
+fuzzSync(FuzzStream *s)
+{
+  static FuzzRead r;
+  TMR_SR_SerialReader *sr;
+  TMR_Status ret;
+  int n, start, end;
+
+  sr = &reader.u.serialReader;
+  reader.continuousReading = false;
+  sr->opCode = TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE;
+  sr->tagsRemaining = FUZZ_MAX_MESSAGES;
+  sr->tagsRemainingInBuffer = 0;
+  for (n = 0; n < FUZZ_MAX_MESSAGES; n++)
+  {
+    initRead(&r);
+    sr->gen2AllMemoryBankEnabled = (0 != (fuzzMode & FUZZ_ALL_BANKS));
+    /* Records follow the count at 8 of a new buffer */
+    start = (0 == sr->tagsRemainingInBuffer) ? 9 : sr->bufPointer;
+    ret = TMR_SR_getNextTag(&reader, &r.trd);
+    if (TMR_SUCCESS != ret)
+    {
+      break;
+    }
+    checkFrame(ret, sr->bufResponse);
+    /* A frame too short to hold any record leaves the cursor where it was */
+    end = payloadEnd(sr->bufResponse);
+    if (sr->bufPointer > ((start < end) ? end : start))
+    {
+      fuzzFail("record cursor left the frame", sr->bufResponse);
+    }
+  }
+  sr->tagsRemaining = 0;
+  sr->tagsRemainingInBuffer = 0;
+}
+
+static void
+fuzzReceive(FuzzStream *s)
+{
+  uint8_t msg[TMR_SR_MAX_PACKET_SIZE];
+  TMR_Status ret;
+  int n;
+
+  reader.continuousReading = true;
+  for (n = 0; (n < FUZZ_MAX_MESSAGES) && (s->pos < s->length); n++)
+  {
+    ret = TMR_SR_receiveMessage(&reader, msg, TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, 0);
+    checkFrame(ret, msg);
+  }
+}
+
+static void
+fuzzOne(const uint8_t *data, size_t size)
+{
+  FuzzStream s;
+
+  if (0 == size)
+  {
+    return;
+  }
+  fuzzInit();
+  fuzzMode = data[0];
+  s.data = data + 1;
+  s.length = (uint32_t)((size - 1 < FUZZ_MAX_INPUT) ? size - 1 : FUZZ_MAX_INPUT);
+  s.pos = 0;
+  reader.u.serialReader.transport.cookie = &s;
+  reader.u.serialReader.crcEnabled = (0 == (fuzzMode & FUZZ_CRC_OFF));
+  reader.u.serialReader.versionInfo.hardware[0] =
+    (fuzzMode & FUZZ_M5E) ? TMR_SR_MODEL_M5E : TMR_SR_MODEL_M6E;
+
+  switch (FUZZ_MODE(fuzzMode))
+  {
+    case FUZZ_MODE_SYNC:
+      fuzzSync(&s);
+      break;
+    case FUZZ_MODE_RECEIVE:
+      fuzzReceive(&s);
+      break;
+    default:
+      fuzzStream(&s);
+      break;
+  }
+  reader.u.serialReader.crcEnabled = true;
+  reader.u.serialReader.gen2AllMemoryBankEnabled = false;
+}
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  fuzzOne(data, size);
+  return 0;
+}
+
+#ifndef TMR_FUZZ_LIBFUZZER
+
+static uint32_t rng = 1;
+
+static uint32_t
+fuzzRandom(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static uint32_t
+fuzzBelow(uint32_t n)
+{
+  return (0 == n) ? 0 : fuzzRandom() % n;
+}
+
+/**
+ * Generate a well-formed tag record, and what it holds.  Memory bank
+ * data (allBanks) is a run of banks, each its number, its length in
+ * words and the words.
+ **/
+static void
+genTruth(FuzzTruth *t, bool allBanks)
+{
+  static const uint8_t protocols[] = {
+    TMR_TAG_PROTOCOL_GEN2, TMR_TAG_PROTOCOL_GEN2, TMR_TAG_PROTOCOL_GEN2,
+    TMR_TAG_PROTOCOL_ISO180006B, TMR_TAG_PROTOCOL_ATA,
+  };
+  static const uint8_t banks[] = {
+    TMR_GEN2_BANK_RESERVED, TMR_GEN2_BANK_EPC, TMR_GEN2_BANK_TID, TMR_GEN2_BANK_USER,
+  };
+  uint8_t j, words;
+
+  memset(t, 0, sizeof(*t));
+  t->flags = (uint16_t)(fuzzRandom() & TMR_TRD_METADATA_FLAG_ALL) | TMR_TRD_METADATA_FLAG_PROTOCOL;
+  t->readCount = (uint8_t)fuzzRandom();
+  t->rssi = (int8_t)fuzzRandom();
+  t->antenna = (uint8_t)fuzzRandom();
+  t->frequency = fuzzRandom() & 0xFFFFFF;
+  t->dspMicros = fuzzRandom();
+  t->phase = (uint16_t)fuzzRandom();
+  t->protocol = protocols[fuzzBelow(sizeof(protocols))];
+  t->gpio = (uint8_t)fuzzRandom();
+  if (t->flags & TMR_TRD_METADATA_FLAG_DATA)
+  {
+    if (allBanks)
+    {
+      while (t->dataLen + 2 + 8 <= sizeof(t->data) && fuzzBelow(4))
+      {
+        words = (uint8_t)fuzzBelow(5);
+        t->data[t->dataLen++] = (uint8_t)(banks[fuzzBelow(4)] << 4);
+        t->data[t->dataLen++] = words;
+        for (j = 0; j < 2 * words; j++)
+        {
+          t->data[t->dataLen++] = (uint8_t)fuzzRandom();
+        }
+      }
+    }
+    else
+    {
+      t->dataLen = (uint8_t)fuzzBelow(sizeof(t->data) + 1);
+      for (j = 0; j < t->dataLen; j++)
+      {
+        t->data[j] = (uint8_t)fuzzRandom();
+      }
+    }
+  }
+  if (TMR_TAG_PROTOCOL_GEN2 == t->protocol)
+  {
+    t->pc[0] = (uint8_t)fuzzRandom();
+    t->pc[1] = (uint8_t)fuzzRandom();
+    t->pc[2] = (uint8_t)fuzzRandom();
+    t->pcLen = (t->pc[0] & 0x02) ? ((t->pc[2] & 0x80) ? 6 : 4) : 2;
+    for (j = 3; j < t->pcLen; j++)
+    {
+      t->pc[j] = (uint8_t)fuzzRandom();
+    }
+  }
+  t->epcLen = (uint8_t)(2 * fuzzBelow(TMR_MAX_EPC_BYTE_COUNT / 2 - 8));
+  for (j = 0; j < t->epcLen; j++)
+  {
+    t->epc[j] = (uint8_t)fuzzRandom();
+  }
+  t->crc = (uint16_t)fuzzRandom();
+}
+
+static uint8_t
+encodeRecord(const FuzzTruth *t, uint8_t *p, uint8_t i)
+{
+  uint16_t bytes;
+
+  if (t->flags & TMR_TRD_METADATA_FLAG_READCOUNT)
+  {
+    SETU8(p, i, t->readCount);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_RSSI)
+  {
+    SETU8(p, i, (uint8_t)t->rssi);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_ANTENNAID)
+  {
+    SETU8(p, i, t->antenna);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_FREQUENCY)
+  {
+    SETU8(p, i, (uint8_t)(t->frequency >> 16));
+    SETU16(p, i, (uint16_t)t->frequency);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_TIMESTAMP)
+  {
+    SETU32(p, i, t->dspMicros);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_PHASE)
+  {
+    SETU16(p, i, t->phase);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_PROTOCOL)
+  {
+    SETU8(p, i, t->protocol);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_DATA)
+  {
+    SETU16(p, i, (uint16_t)(t->dataLen * 8));
+    memcpy(p + i, t->data, t->dataLen);
+    i += t->dataLen;
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS)
+  {
+    SETU8(p, i, t->gpio);
+  }
+  /* EPC length in bits covers the PC words and, but for ATA, the CRC */
+  bytes = t->pcLen + t->epcLen + ((TMR_TAG_PROTOCOL_ATA != t->protocol) ? 2 : 0);
+  SETU16(p, i, (uint16_t)(bytes * 8));
+  memcpy(p + i, t->pc, t->pcLen);
+  i += t->pcLen;
+  memcpy(p + i, t->epc, t->epcLen);
+  i += t->epcLen;
+  SETU16(p, i, t->crc);
+
+  return i;
+}
+
+/** Check a read parsed from a well-formed record against what it encoded */
+static void
+checkTruth(const FuzzTruth *t, const TMR_TagReadData *trd, const uint8_t *msg)
+{
+  const TMR_uint8List *bank;
+  uint16_t off, len, n, last[4];
+  int j;
+
+  if (((t->flags & TMR_TRD_METADATA_FLAG_READCOUNT) && (trd->readCount != t->readCount))
+      || ((t->flags & TMR_TRD_METADATA_FLAG_RSSI) && (trd->rssi != t->rssi))
+      || ((t->flags & TMR_TRD_METADATA_FLAG_ANTENNAID) && (trd->antenna != t->antenna))
+      || ((t->flags & TMR_TRD_METADATA_FLAG_FREQUENCY) && (trd->frequency != t->frequency))
+      || ((t->flags & TMR_TRD_METADATA_FLAG_TIMESTAMP) && (trd->dspMicros != t->dspMicros))
+      || ((t->flags & TMR_TRD_METADATA_FLAG_PHASE) && (trd->phase != t->phase))
+      || (trd->tag.protocol != t->protocol))
+  {
+    fuzzFail("metadata doesn't round trip", msg);
+  }
+  if (t->flags & TMR_TRD_METADATA_FLAG_GPIO_STATUS)
+  {
+    for (j = 0; j < trd->gpioCount; j++)
+    {
+      if (trd->gpio[j].high != (0 != ((t->gpio >> j) & 1)))
+      {
+        fuzzFail("GPIO doesn't round trip", msg);
+      }
+    }
+  }
+  if ((trd->tag.epcByteCount != t->epcLen) || (trd->tag.crc != t->crc)
+      || (0 != memcmp(trd->tag.epc, t->epc, t->epcLen)))
+  {
+    fuzzFail("EPC doesn't round trip", msg);
+  }
+  if ((t->pcLen != 0)
+      && ((trd->tag.u.gen2.pcByteCount != t->pcLen)
+          || (0 != memcmp(trd->tag.u.gen2.pc, t->pc, t->pcLen))))
+  {
+    fuzzFail("PC doesn't round trip", msg);
+  }
+  if (0 == (t->flags & TMR_TRD_METADATA_FLAG_DATA))
+  {
+    return;
+  }
+  n = (t->dataLen < trd->data.max) ? t->dataLen : trd->data.max;
+  if ((trd->data.len != t->dataLen)
+      || ((NULL != trd->data.list) && (0 != memcmp(trd->data.list, t->data, n))))
+  {
+    fuzzFail("data doesn't round trip", msg);
+  }
+  if ((0 == (fuzzMode & FUZZ_ALL_BANKS)) || (NULL == trd->data.list))
+  {
+    return;
+  }
+  /**
+   * Banks in the data that was copied, the last one cut short as it
+   * was; a bank seen twice ends up with the second
+   **/
+  memset(last, 0xFF, sizeof(last));
+  for (off = 0; off + 2 <= n; off += 2 + len)
+  {
+    len = t->data[off + 1] * 2;
+    len = (off + 2 + len > n) ? n - off - 2 : len;
+    last[(t->data[off] >> 4) & 0x03] = off;
+  }
+  for (j = 0; j < 4; j++)
+  {
+    static const int numbers[] = {
+      TMR_GEN2_BANK_RESERVED, TMR_GEN2_BANK_EPC, TMR_GEN2_BANK_TID, TMR_GEN2_BANK_USER,
+    };
+
+    switch (numbers[j])
+    {
+      case TMR_GEN2_BANK_EPC:
+        bank = &trd->epcMemData;
+        break;
+      case TMR_GEN2_BANK_TID:
+        bank = &trd->tidMemData;
+        break;
+      case TMR_GEN2_BANK_USER:
+        bank = &trd->userMemData;
+        break;
+      default:
+        bank = &trd->reservedMemData;
+        break;
+    }
+    off = last[numbers[j]];
+    if (0xFFFF == off)
+    {
+      if (0 != bank->len)
+      {
+        fuzzFail("memory bank parsed that wasn't sent", msg);
+      }
+      continue;
+    }
+    len = t->data[off + 1] * 2;
+    len = (off + 2 + len > n) ? n - off - 2 : len;
+    if ((bank->len != len)
+        || ((NULL != bank->list)
+            && (0 != memcmp(bank->list, t->data + off + 2, (len < bank->max) ? len : bank->max))))
+    {
+      fuzzFail("memory bank doesn't round trip", msg);
+    }
+  }
+}
+
+/** Frame a payload, as the module does */
+static uint32_t
+putFrame(uint8_t *out, uint8_t opcode, uint16_t status,
+         const uint8_t *payload, uint8_t len)
+{
+  uint32_t i;
+  uint16_t crc;
+
+  i = 0;
+  SETU8(out, i, 0xFF);
+  SETU8(out, i, len);
+  SETU8(out, i, opcode);
+  SETU16(out, i, status);
+  memcpy(out + i, payload, len);
+  i += len;
+  if (0 == (fuzzMode & FUZZ_CRC_OFF))
+  {
+    crc = TMR_SR_crc(out + 1, len + 4);
+    SETU16(out, i, crc);
+  }
+  return i;
+}
+
+/**
+ * Damage a payload the way a bad line or firmware might, keeping it
+ * a frame so the CRC doesn't hide it from the parser
+ **/
+static uint8_t
+mutatePayload(uint8_t *p, uint8_t len)
+{
+  uint8_t pos;
+
+  if (0 == len)
+  {
+    return len;
+  }
+  pos = (uint8_t)fuzzBelow(len);
+  switch (fuzzBelow(5))
+  {
+    case 0:
+      p[pos] ^= (uint8_t)(1 << fuzzBelow(8));
+      break;
+    case 1:
+      p[pos] = (uint8_t)fuzzRandom();
+      break;
+    case 2:
+      /* Cut short */
+      len = pos;
+      break;
+    case 3:
+      /* A length or flags field made large */
+      p[pos] = 0xFF;
+      if (pos + 1 < len)
+      {
+        p[pos + 1] = 0xFF;
+      }
+      break;
+    default:
+      memset(p + pos, 0, len - pos);
+      break;
+  }
+  return len;
+}
+
+/**
+ * Generate an input: the mode byte, then frames of the kind the mode
+ * fuzzes.  Well-formed records are parsed back and checked as they
+ * are made; with mutate, some frames are then damaged.
+ *
+ * @return Length of the input
+ **/
+static uint32_t
+genInput(uint8_t *out, bool mutate)
+{
+  static FuzzRead r;
+  uint8_t payload[TMR_SR_MAX_PACKET_SIZE];
+  uint8_t msg[TMR_SR_MAX_PACKET_SIZE];
+  FuzzTruth truth[8];
+  uint32_t len, frameLen;
+  uint8_t i, countPos, start, end, count, pi;
+  int frames, f, t;
+
+  fuzzMode = (uint8_t)fuzzRandom();
+  out[0] = fuzzMode;
+  len = 1;
+  frames = 1 + fuzzBelow(6);
+  for (f = 0; f < frames; f++)
+  {
+    i = 0;
+    count = 0;
+    start = 0;
+    if (FUZZ_MODE_SYNC == FUZZ_MODE(fuzzMode))
+    {
+      /* GET_TAG_ID_BUFFER: flags, read options, count, records */
+      genTruth(&truth[0], false);
+      SETU16(payload, i, truth[0].flags);
+      SETU8(payload, i, 0);
+      countPos = i;
+      SETU8(payload, i, 0);
+      for (t = 0; t < 8; t++)
+      {
+        FuzzTruth next;
+
+        genTruth(&next, 0 != (fuzzMode & FUZZ_ALL_BANKS));
+        next.flags = truth[0].flags;
+        if (TMR_SR_MAX_PACKET_SIZE - 7 - i < 16 + 2 + next.dataLen + 2 + 6 + next.epcLen + 2)
+        {
+          break;
+        }
+        truth[t] = next;
+        i = encodeRecord(&truth[t], payload, i);
+        count++;
+      }
+      payload[countPos] = count;
+      start = 9;
+    }
+    else
+    {
+      /* Stream: option, search flags, metadata flags, response type */
+      genTruth(&truth[0], 0 != (fuzzMode & FUZZ_ALL_BANKS));
+      SETU8(payload, i, 0x10);
+      SETU16(payload, i, 0x001B);
+      SETU16(payload, i, truth[0].flags);
+      switch (fuzzBelow(8))
+      {
+        case 0:
+          /* End of a search cycle */
+          SETU8(payload, i, 0x00);
+          memset(payload + i, 0, 10);
+          i += 10;
+          break;
+        case 1:
+          /* Status report */
+          SETU8(payload, i, 0x02);
+          for (t = fuzzBelow(12); 0 < t; t--)
+          {
+            SETU8(payload, i, (uint8_t)fuzzRandom());
+          }
+          break;
+        default:
+          SETU8(payload, i, 0x01);
+          i = encodeRecord(&truth[0], payload, i);
+          count = 1;
+          start = 11;
+          break;
+      }
+    }
+
+    /* The frame as received, for the round trip */
+    frameLen = putFrame(msg, (FUZZ_MODE_SYNC == FUZZ_MODE(fuzzMode))
+                        ? TMR_SR_OPCODE_GET_TAG_ID_BUFFER
+                        : TMR_SR_OPCODE_READ_TAG_ID_MULTIPLE, 0, payload, i);
+    pi = start;
+    for (t = 0; t < count; t++)
+    {
+      initRead(&r);
+      reader.u.serialReader.gen2AllMemoryBankEnabled = (0 != (fuzzMode & FUZZ_ALL_BANKS));
+      reader.u.serialReader.versionInfo.hardware[0] =
+        (fuzzMode & FUZZ_M5E) ? TMR_SR_MODEL_M5E : TMR_SR_MODEL_M6E;
+      end = pi;
+      TMR_SR_parseMetadataFromMessage(&reader, &r.trd,
+                                      (FUZZ_MODE_SYNC == FUZZ_MODE(fuzzMode))
+                                      ? GETU16AT(msg, 5) : GETU16AT(msg, 8), &end, msg);
+      checkTruth(&truth[t], &r.trd, msg);
+      pi = end;
+    }
+    reader.u.serialReader.gen2AllMemoryBankEnabled = false;
+
+    if (mutate && fuzzBelow(2))
+    {
+      i = mutatePayload(payload, i);
+      frameLen = putFrame(msg, msg[2], 0, payload, i);
+    }
+    if (len + frameLen > FUZZ_MAX_INPUT)
+    {
+      break;
+    }
+    memcpy(out + len, msg, frameLen);
+    len += frameLen;
+  }
+  if (mutate && (0 == fuzzBelow(8)) && (1 < len))
+  {
+    /* A bit lost on the line */
+    out[1 + fuzzBelow(len - 1)] ^= (uint8_t)(1 << fuzzBelow(8));
+  }
+  return len;
+}
+
+static void
+writeInput(const char *dir, uint32_t n, const uint8_t *data, uint32_t len)
+{
+  char path[1024];
+  FILE *f;
+
+  snprintf(path, sizeof(path), "%s/gen-%06u", dir, n);
+  f = fopen(path, "wb");
+  if (NULL == f)
+  {
+    errx(2, "Can't write %s\n", path);
+  }
+  fwrite(data, 1, len, f);
+  fclose(f);
+}
+
+static void
+runFile(const char *path)
+{
+  static uint8_t data[FUZZ_MAX_INPUT + 1];
+  FILE *f;
+  size_t len;
+
+  f = (0 == strcmp(path, "-")) ? stdin : fopen(path, "rb");
+  if (NULL == f)
+  {
+    errx(2, "Can't open %s\n", path);
+  }
+  len = fread(data, 1, sizeof(data), f);
+  if (stdin != f)
+  {
+    fclose(f);
+  }
+  fuzzOne(data, len);
+}
+
+static void
+usage(void)
+{
+  errx(1, "Usage: fuzzserial [-s seed] [-n runs] [-g dir] [file ...]\n");
+}
+
+int main(int argc, char *argv[])
+{
+  static uint8_t input[FUZZ_MAX_INPUT];
+  const char *corpus;
+  uint32_t runs, n, len;
+  int opt;
+
+  runs = 0;
+  corpus = NULL;
+  while (-1 != (opt = getopt(argc, argv, "s:n:g:")))
+  {
+    switch (opt)
+    {
+      case 's':
+        rng = (uint32_t)strtoul(optarg, NULL, 0);
+        rng = (0 == rng) ? 1 : rng;
+        break;
+      case 'n':
+        runs = (uint32_t)atoi(optarg);
+        break;
+      case 'g':
+        corpus = optarg;
+        break;
+      default:
+        usage();
+    }
+  }
+  if ((optind == argc) && (0 == runs))
+  {
+    runs = 10000;
+  }
+
+  fuzzInit();
+  for (; optind < argc; optind++)
+  {
+    runFile(argv[optind]);
+  }
+  for (n = 0; n < runs; n++)
+  {
+    /* Each well-formed stream, then a damaged one */
+    len = genInput(input, 0 != (n & 1));
+    if (NULL != corpus)
+    {
+      writeInput(corpus, n, input, len);
+    }
+    fuzzOne(input, len);
+  }
+  if (0 < runs)
+  {
+    printf("%u inputs, all properties held\n", runs);
+  }
+
+  reader.u.serialReader.transport = simTransport;
+  TMR_destroy(&reader);
+  return 0;
+}
+
+#endif /* TMR_FUZZ_LIBFUZZER */
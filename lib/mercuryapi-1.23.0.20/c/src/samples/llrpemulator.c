@@ -0,0 +1,137 @@
+/**
+ * Sample programme that emulates one or more LLRP readers on local
+ * sockets, for running the LLRP samples and load tests without
+ * fixed readers.  Counters are printed every interval.
+ *
+ * Usage: llrpemulator [-a address] [-p port] [-n readers] [-P]
+ *                     [-t tags] [-e epcbytes] [-A antennas] [-r rate]
+ *                     [-s seed] [-d seconds] [-i seconds]
+ *
+ * Connect to reader N with tmr://<address + N> (or tmr://address:<port + N>
+ * with -P).
+ * @file llrpemulator.c
+ */
+
+#include <tm_reader.h>
+#include <llrp_emulator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+static volatile sig_atomic_t stop = 0;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+static void onSignal(int sig)
+{
+  stop = 1;
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: llrpemulator [-a address] [-p port] [-n readers] [-P]\n"
+          "                    [-t tags] [-e epcbytes] [-A antennas] [-r rate]\n"
+          "                    [-s seed] [-d seconds] [-i seconds]\n");
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_LLRP_EmulatorConfig config;
+  TMR_LLRP_Emulator *emulator;
+  TMR_LLRP_EmulatorStats stats, last;
+  TMR_Status ret;
+  unsigned long duration, interval, elapsed;
+  int opt;
+
+  TMR_LLRP_emulatorInitConfig(&config);
+  duration = 0;
+  interval = 1;
+
+  while (-1 != (opt = getopt(argc, argv, "a:p:n:Pt:e:A:r:s:d:i:")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        strncpy(config.address, optarg, sizeof(config.address) - 1);
+        break;
+      case 'p':
+        config.port = (uint16_t)atoi(optarg);
+        break;
+      case 'n':
+        config.readerCount = atoi(optarg);
+        break;
+      case 'P':
+        config.portPerReader = true;
+        break;
+      case 't':
+        config.tagCount = atoi(optarg);
+        break;
+      case 'e':
+        config.epcLength = (uint8_t)atoi(optarg);
+        break;
+      case 'A':
+        config.antennaCount = (uint8_t)atoi(optarg);
+        break;
+      case 'r':
+        config.readRate = atoi(optarg);
+        break;
+      case 's':
+        config.seed = atoi(optarg);
+        break;
+      case 'd':
+        duration = atoi(optarg);
+        break;
+      case 'i':
+        interval = atoi(optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (0 == interval)
+  {
+    interval = 1;
+  }
+
+  ret = TMR_LLRP_emulatorStart(&emulator, &config);
+  if (TMR_SUCCESS != ret)
+  {
+    errx(1, "Error starting emulator: %s\n", TMR_strerr(NULL, ret));
+  }
+  printf("Emulating %u reader(s) from %s:%u\n", config.readerCount,
+         config.address, config.port);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+
+  memset(&last, 0, sizeof(last));
+  for (elapsed = 0; (0 == stop) && ((0 == duration) || (elapsed < duration)); )
+  {
+    sleep(interval);
+    elapsed += interval;
+    TMR_LLRP_emulatorGetStats(emulator, &stats);
+    printf("sessions %u/%u  msgs in %llu out %llu  reports %llu  tags/s %llu  reads/s %llu\n",
+           stats.activeSessions, stats.connections,
+           (unsigned long long)stats.messagesReceived,
+           (unsigned long long)stats.messagesSent,
+           (unsigned long long)stats.reports,
+           (unsigned long long)(stats.tagReports - last.tagReports) / interval,
+           (unsigned long long)(stats.tagReads - last.tagReads) / interval);
+    fflush(stdout);
+    last = stats;
+  }
+
+  TMR_LLRP_emulatorStop(emulator);
+  return 0;
+}
@@ -0,0 +1,259 @@
+/**
+ * Sample programme that learns a phase calibration table from a
+ * reference tag and saves it, or loads one and reads with it applied
+ * (see tmr_phase_cal.h).
+ *
+ * Usage: phasecal -l epc -g antenna [-g antenna ...] [-d duration] [-w file] uri
+ *        phasecal -c file [-a antennas] [-d duration] [-q] uri
+ *
+ *   -l  learn from the tag with this EPC, in hex
+ *   -g  an antenna and the reference tag's distance from it: port:cm
+ *   -w  file to save the learned table to (default phasecal.txt)
+ *   -c  read with the table in this file applied
+ *   -a  comma separated antennas to read on (default those given to -g, or 1)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -q  print the counts only
+ *
+ * For example, against the simulated module with 30 cm more cable on
+ * each port than the one before, and the first tag 1.5 m from them:
+ *   phasecal -l E20000010000000000000000 -g 1:150 -g 2:150 -g 3:150 \
+ *            'sim:///m6e?tags=8&ant=3&rate=2000&range=150&cable=30'
+ *   phasecal -c phasecal.txt -a 1,2,3 'sim:///m6e?tags=8&ant=3&rate=2000&range=150&cable=30'
+ * @file phasecal.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_phase_cal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool quiet;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: phasecal -l epc -g antenna [-g antenna ...] [-d duration] [-w file] uri\n"
+          "       phasecal -c file [-a antennas] [-d duration] [-q] uri\n");
+}
+
+static void learnCallback(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_phaseCalLearnAdd(cookie, t);
+}
+
+static void printCallback(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  char epc[128];
+
+  if (false == quiet)
+  {
+    TMR_bytesToHex(t->tag.epc, t->tag.epcByteCount, epc);
+    printf("%s ant %u %6u kHz phase %3u\n", epc, t->antenna, t->frequency, t->phase);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_ReadListenerBlock rlb;
+  TMR_PhaseCal cal;
+  TMR_PhaseCalLearner learner;
+  TMR_TagData reference;
+  TMR_Status ret;
+  TMR_Region region;
+  TMR_uint32List hopTable;
+  uint32_t hopTableData[64];
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  const char *learnEpc, *loadPath, *savePath;
+  char *name;
+  double distance[TMR_PHASE_CAL_MAX_ANTENNAS + 1];
+  uint8_t antennas[TMR_PHASE_CAL_MAX_ANTENNAS];
+  uint8_t antennaCount;
+  uint32_t durationMs, cells;
+  int opt, port, cm, i;
+
+  rp = &r;
+  learnEpc = NULL;
+  loadPath = NULL;
+  savePath = "phasecal.txt";
+  memset(distance, 0, sizeof(distance));
+  antennaCount = 0;
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "l:g:w:c:a:d:q")))
+  {
+    switch (opt)
+    {
+      case 'l':
+        learnEpc = optarg;
+        break;
+      case 'g':
+        if ((2 != sscanf(optarg, "%d:%d", &port, &cm)) || (1 > port)
+            || (TMR_PHASE_CAL_MAX_ANTENNAS < port) || (0 >= cm)
+            || (sizeof(antennas) == antennaCount))
+        {
+          usage();
+        }
+        distance[port] = cm / 100.0;
+        antennas[antennaCount++] = (uint8_t)port;
+        break;
+      case 'w':
+        savePath = optarg;
+        break;
+      case 'c':
+        loadPath = optarg;
+        break;
+      case 'a':
+        antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (sizeof(antennas) == antennaCount)
+          {
+            usage();
+          }
+          antennas[antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if ((optind + 1 != argc) || ((NULL == learnEpc) == (NULL == loadPath)))
+  {
+    usage();
+  }
+  if (0 == antennaCount)
+  {
+    if (NULL != learnEpc)
+    {
+      usage();
+    }
+    antennas[antennaCount++] = 1;
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  if (NULL != learnEpc)
+  {
+    /* The table covers the channels the reader hops over */
+    hopTable.list = hopTableData;
+    hopTable.max = sizeof(hopTableData) / sizeof(hopTableData[0]);
+    hopTable.len = 0;
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_HOPTABLE, &hopTable);
+    checkerr(rp, ret, 1, "getting the hop table");
+    ret = TMR_phaseCalInit(&cal, 180, hopTable.list, hopTable.len);
+    checkerr(rp, ret, 1, "setting up the table");
+
+    reference.epcByteCount = sizeof(reference.epc);
+    ret = TMR_hexToBytes(learnEpc, reference.epc, strlen(learnEpc) / 2, NULL);
+    checkerr(rp, ret, 1, "parsing the EPC");
+    reference.epcByteCount = (uint8_t)(strlen(learnEpc) / 2);
+    TMR_phaseCalLearnInit(&learner, &cal, &reference);
+    memcpy(learner.distance, distance, sizeof(distance));
+
+    rlb.listener = learnCallback;
+    rlb.cookie = &learner;
+  }
+  else
+  {
+    ret = TMR_phaseCalLoad(&cal, loadPath);
+    checkerr(rp, ret, 1, "loading the table");
+    ret = TMR_phaseCalAttach(rp, &cal);
+    checkerr(rp, ret, 1, "attaching the table");
+
+    rlb.listener = printCallback;
+    rlb.cookie = NULL;
+  }
+  ret = TMR_addReadListener(rp, &rlb);
+  checkerr(rp, ret, 1, "adding read listener");
+
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+
+  if (NULL != learnEpc)
+  {
+    ret = TMR_phaseCalLearnFinish(&learner, &cal, &cells);
+    checkerr(rp, ret, 1, "finishing the table");
+    ret = TMR_phaseCalSave(&cal, savePath);
+    checkerr(rp, ret, 1, "saving the table");
+    printf("%llu reads of the reference tag, %lu antennas and channels learned, saved to %s\n",
+           (unsigned long long)learner.reads, (unsigned long)cells, savePath);
+    for (i = 0; i < antennaCount; i++)
+    {
+      printf("ant %u: %3u degrees at %lu kHz\n", antennas[i],
+             cal.offset[antennas[i] * cal.channels], (unsigned long)cal.baseKhz);
+    }
+  }
+  else
+  {
+    TMR_phaseCalAttach(rp, NULL);
+    printf("%llu reads corrected, %llu left as they were\n",
+           (unsigned long long)cal.corrected, (unsigned long long)cal.skipped);
+  }
+
+  TMR_destroy(rp);
+  return 0;
+}
@@ -0,0 +1,177 @@
+/**
+ * Sample programme that reads continuously from one or more readers
+ * and serves their statistics to Prometheus in the OpenMetrics text
+ * format, until interrupted.
+ *
+ * Usage: readermetrics [-a address] [-p port] [-s] uri [uri...]
+ *
+ * Scrape http://<address>:<port>/metrics.  -s also exports module
+ * statistics (temperature, frequency, RF on time, noise floor).
+ * @file readermetrics.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_metrics.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#define MAX_READERS 8
+
+static volatile sig_atomic_t stop = 0;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void onSignal(int sig)
+{
+  stop = 1;
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readermetrics [-a address] [-p port] [-s] uri [uri...]\n");
+}
+
+static void exceptionCallback(TMR_Reader *reader, TMR_Status error, void *cookie)
+{
+  fprintf(stderr, "Error reading from %s: %s\n", (char *)cookie, TMR_strerr(reader, error));
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader readers[MAX_READERS];
+  TMR_ReadExceptionListenerBlock exceptionListeners[MAX_READERS];
+  char uris[MAX_READERS][TMR_MAX_READER_NAME_LENGTH];
+  TMR_MetricsConfig config;
+  TMR_MetricsExporter *exporter;
+  TMR_Status ret;
+  uint32_t flags;
+  int opt, count, i;
+
+  TMR_metricsInitConfig(&config);
+  flags = TMR_METRICS_READS | TMR_METRICS_PIPELINE;
+
+  while (-1 != (opt = getopt(argc, argv, "a:p:s")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        strncpy(config.address, optarg, sizeof(config.address) - 1);
+        break;
+      case 'p':
+        config.port = (uint16_t)atoi(optarg);
+        break;
+      case 's':
+        flags |= TMR_METRICS_MODULE_STATS;
+        break;
+      default:
+        usage();
+    }
+  }
+  count = argc - optind;
+  if ((count < 1) || (count > MAX_READERS))
+  {
+    usage();
+  }
+
+  ret = TMR_metricsStart(&exporter, &config);
+  if (TMR_SUCCESS != ret)
+  {
+    errx(1, "Error starting exporter: %s\n", TMR_strerr(NULL, ret));
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    TMR_Reader *rp = &readers[i];
+    TMR_Region region;
+
+    /* TMR_create() tokenizes the URI in place */
+    strncpy(uris[i], argv[optind + i], sizeof(uris[i]) - 1);
+    uris[i][sizeof(uris[i]) - 1] = '\0';
+    ret = TMR_create(rp, uris[i]);
+    checkerr(rp, ret, 1, "creating reader");
+    strncpy(uris[i], argv[optind + i], sizeof(uris[i]) - 1);
+
+    ret = TMR_metricsAddReader(exporter, rp, uris[i], flags);
+    checkerr(rp, ret, 1, "exporting reader");
+
+    ret = TMR_connect(rp);
+    checkerr(rp, ret, 1, "connecting reader");
+
+    region = TMR_REGION_NONE;
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "getting region");
+    if (TMR_REGION_NONE == region)
+    {
+      TMR_RegionList regions;
+      TMR_Region _regionStore[32];
+      regions.list = _regionStore;
+      regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+      regions.len = 0;
+
+      ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+      checkerr(rp, ret, 1, "getting supported regions");
+      if (regions.len < 1)
+      {
+        checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+      }
+      region = regions.list[0];
+      ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+      checkerr(rp, ret, 1, "setting region");
+    }
+
+    if (flags & TMR_METRICS_MODULE_STATS)
+    {
+      TMR_Reader_StatsFlag setFlag = TMR_READER_STATS_FLAG_ALL;
+
+      ret = TMR_paramSet(rp, TMR_PARAM_READER_STATS_ENABLE, &setFlag);
+      checkerr(rp, ret, 1, "enabling reader stats");
+    }
+
+    exceptionListeners[i].listener = exceptionCallback;
+    exceptionListeners[i].cookie = uris[i];
+    TMR_addReadExceptionListener(rp, &exceptionListeners[i]);
+
+    ret = TMR_startReading(rp);
+    checkerr(rp, ret, 1, "starting reading");
+  }
+
+  printf("Serving metrics for %d reader(s) at http://%s:%u/metrics\n",
+         count, config.address, config.port);
+  fflush(stdout);
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  while (0 == stop)
+  {
+    sleep(1);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    TMR_stopReading(&readers[i]);
+    TMR_metricsRemoveReader(exporter, &readers[i]);
+    TMR_destroy(&readers[i]);
+  }
+  TMR_metricsStop(exporter);
+  return 0;
+}
@@ -0,0 +1,190 @@
+/**
+ * Sample programme that reads in the background and prints tag
+ * events (see tmr_events.h) instead of reads: when each tag enters
+ * the field, starts moving, stops and departs.
+ *
+ * Usage: readevents [-a antennas] [-d duration] [-n reads] [-g depart]
+ *                   [-s still] [-q] uri
+ *
+ *   -a  comma separated antennas to read on (default 1)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -n  reads before a tag has entered (default 2)
+ *   -g  milliseconds unread before a tag has departed (default 2000)
+ *   -s  milliseconds steady before a tag is stationary (default 1000)
+ *   -q  print the counts only
+ *
+ * Tags still in the field when reading stops are reported departed.
+ * For example, against the simulated module, whose tags stand still:
+ *   readevents 'sim:///m6e?tags=4&rate=500&range=100'
+ * @file readevents.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_events.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool quiet;
+static uint64_t startUs;
+
+static const char *eventNames[TMR_TAG_EVENT_TYPES] = {
+  "entered", "moving", "stationary", "departed"
+};
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readevents [-a antennas] [-d duration] [-n reads] [-g depart]\n"
+          "                  [-s still] [-q] uri\n");
+}
+
+static void eventCallback(TMR_Reader *reader, const TMR_TagEvent *event, void *cookie)
+{
+  char epcStr[2 * TMR_MAX_EPC_BYTE_COUNT + 1];
+
+  if (quiet)
+  {
+    return;
+  }
+  TMR_bytesToHex(event->tag->epc, event->tag->epcByteCount, epcStr);
+  printf("%8.3f %-10s %s ant %u reads %lu rssi %.1f dBm slope %+.1f dB/s phase %+.0f deg/s\n",
+         (event->timeUs - startUs) / 1e6, eventNames[event->type], epcStr, event->antenna,
+         (unsigned long)event->reads, event->rssi, event->rssiSlope, event->phaseRate);
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_TagEventConfig config;
+  TMR_TagEventEngine engine;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  uint8_t antennas[16];
+  uint8_t antennaCount;
+  uint32_t durationMs;
+  char *name;
+  int opt;
+
+  rp = &r;
+  TMR_tagEventsInitConfig(&config);
+  antennas[0] = 1;
+  antennaCount = 1;
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "a:d:n:g:s:q")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (sizeof(antennas) == antennaCount)
+          {
+            usage();
+          }
+          antennas[antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'n':
+        config.enterReads = (uint32_t)atoi(optarg);
+        break;
+      case 'g':
+        config.departUs = (uint32_t)atoi(optarg) * 1000;
+        break;
+      case 's':
+        config.stillUs = (uint32_t)atoi(optarg) * 1000;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 1 != argc || 0 == antennaCount)
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  ret = TMR_tagEventsStart(rp, &engine, &config, eventCallback, NULL);
+  checkerr(rp, ret, 1, "starting the event engine");
+  startUs = tmr_gettime() * 1000;
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  TMR_tagEventsStop(&engine);
+
+  printf("%llu reads: %llu entered, %llu moving, %llu stationary, %llu departed, "
+         "%llu evicted\n", (unsigned long long)engine.reads,
+         (unsigned long long)engine.events[TMR_TAG_EVENT_ENTERED],
+         (unsigned long long)engine.events[TMR_TAG_EVENT_MOVING],
+         (unsigned long long)engine.events[TMR_TAG_EVENT_STATIONARY],
+         (unsigned long long)engine.events[TMR_TAG_EVENT_DEPARTED],
+         (unsigned long long)engine.evictions);
+
+  TMR_destroy(rp);
+  return 0;
+}
@@ -0,0 +1,234 @@
+/**
+ * Sample programme that reads continuously from a serial reader while
+ * injecting transport faults (see tmr_fault.h), and reports how long
+ * the reader took to deliver reads again after each one and how many
+ * reads were lost.
+ *
+ * Usage: readfaults [-s seed] [-k kinds] [-i interval] [-n faults]
+ *                   [-d duration] [-r] uri
+ *
+ *   -k  comma separated kinds: drop,corrupt,stall,partial,disconnect
+ *       (default all)
+ *   -i  mean milliseconds between faults (default 2000)
+ *   -n  stop after this many faults (default 10)
+ *   -d  read for at most this many milliseconds (default 60000)
+ *   -r  set /reader/serial/autoResume, so reading restarts after a
+ *       timeout instead of stopping
+ *
+ * For example, against the simulated module:
+ *   readfaults -r -k stall,disconnect 'sim:///m6e?tags=50&rate=2000'
+ * @file readfaults.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_fault.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readfaults [-s seed] [-k kinds] [-i interval] [-n faults]\n"
+          "                  [-d duration] [-r] uri\n");
+}
+
+static uint32_t parseKinds(char *list)
+{
+  uint32_t kinds;
+  char *name;
+  int k;
+
+  kinds = 0;
+  for (name = strtok(list, ","); NULL != name; name = strtok(NULL, ","))
+  {
+    for (k = 0; k < TMR_FAULT_KINDS; k++)
+    {
+      if (0 == strcmp(name, TMR_faultKindName((TMR_FaultKind)k)))
+      {
+        kinds |= TMR_FAULT_BIT(k);
+        break;
+      }
+    }
+    if (TMR_FAULT_KINDS == k)
+    {
+      usage();
+    }
+  }
+  return kinds;
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_FaultInjector injector;
+  TMR_FaultConfig config;
+  TMR_FaultSummary summary;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  uint32_t durationMs, waitedMs, recovered, i;
+  bool resume;
+  int opt, k;
+
+  rp = &r;
+  TMR_faultInitConfig(&config);
+  config.maxFaults = 10;
+  durationMs = 60000;
+  resume = false;
+
+  while (-1 != (opt = getopt(argc, argv, "s:k:i:n:d:r")))
+  {
+    switch (opt)
+    {
+      case 's':
+        config.seed = (uint32_t)strtoul(optarg, NULL, 0);
+        break;
+      case 'k':
+        config.kinds = parseKinds(optarg);
+        break;
+      case 'i':
+        config.intervalMs = (uint32_t)atoi(optarg);
+        break;
+      case 'n':
+        config.maxFaults = (uint32_t)atoi(optarg);
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'r':
+        resume = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 1 != argc)
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_startFaultInjection(rp, &injector, &config);
+  checkerr(rp, ret, 1, "starting fault injection");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_paramSet(rp, TMR_PARAM_SERIAL_AUTORESUME, &resume);
+  checkerr(rp, ret, 1, "setting auto resume");
+
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+
+  /* Until every fault has been recovered from, or time runs out */
+  for (waitedMs = 0; waitedMs < durationMs; waitedMs += 100)
+  {
+    recovered = 0;
+    for (i = 0; i < injector.faults; i++)
+    {
+      recovered += (0 != injector.records[i].recoveredUs) ? 1 : 0;
+    }
+    if ((config.maxFaults == injector.faults) && (recovered == injector.faults))
+    {
+      break;
+    }
+    tmr_sleep(100);
+  }
+
+  TMR_stopReading(rp);
+  TMR_stopFaultInjection(rp, &injector);
+
+  printf("%-4s %-10s %10s %10s %10s %6s %s\n",
+         "#", "kind", "outage_ms", "recover_ms", "lost_reads", "errors", "last_error");
+  for (i = 0; i < injector.faults; i++)
+  {
+    const TMR_FaultRecord *f = &injector.records[i];
+
+    printf("%-4u %-10s %10.1f ", i, TMR_faultKindName(f->kind),
+           (f->clearedUs - f->injectedUs) / 1000.0);
+    if (0 != f->recoveredUs)
+    {
+      printf("%10.1f %10u ", (f->recoveredUs - f->clearedUs) / 1000.0, f->readsLost);
+    }
+    else
+    {
+      printf("%10s %10s ", "never", "-");
+    }
+    printf("%6u %s\n", f->exceptions,
+           (0 != f->exceptions) ? TMR_strerr(rp, f->lastException) : "");
+  }
+
+  printf("\n%-10s %8s %9s %14s %14s %14s\n",
+         "kind", "injected", "recovered", "mean_recov_ms", "max_recov_ms", "lost_per_fault");
+  for (k = 0; k < TMR_FAULT_KINDS; k++)
+  {
+    TMR_faultSummary(&injector, (TMR_FaultKind)k, &summary);
+    if (0 == summary.injected)
+    {
+      continue;
+    }
+    printf("%-10s %8u %9u ", TMR_faultKindName((TMR_FaultKind)k),
+           summary.injected, summary.recovered);
+    if (0 != summary.recovered)
+    {
+      printf("%14.1f %14.1f %14.1f\n",
+             summary.totalRecoveryUs / 1000.0 / summary.recovered,
+             summary.maxRecoveryUs / 1000.0,
+             (double)summary.readsLost / summary.recovered);
+    }
+    else
+    {
+      printf("%14s %14s %14s\n", "-", "-", "-");
+    }
+  }
+
+  TMR_destroy(rp);
+  return 0;
+}
@@ -0,0 +1,219 @@
+/**
+ * Sample programme that reads continuously on several antennas and
+ * prints where each tag is as the estimates come in (see
+ * tmr_locate.h), then the last estimate of each tag.
+ *
+ * Usage: readlocate -g antenna [-g antenna ...] [-d duration] [-e interval] [-q] uri
+ *
+ *   -g  an antenna and where it is: port:x,y,z or port:x,y,z:bx,by,bz,
+ *       in metres, with the direction it faces last (default 0,0,1)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -e  fewest milliseconds between estimates of a tag (default 200)
+ *   -q  print the last estimates only
+ *
+ * For example, four antennas in the ceiling of a 4 m square room:
+ *   readlocate -g 1:0,0,2.5:0,0,-1 -g 2:4,0,2.5:0,0,-1 \
+ *              -g 3:0,4,2.5:0,0,-1 -g 4:4,4,2.5:0,0,-1 tmr:///dev/ttyUSB0
+ * @file readlocate.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_locate.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_TAGS 64
+
+typedef struct LastEstimate
+{
+  char epc[128];
+  TMR_LocateResult result;
+} LastEstimate;
+
+static LastEstimate last[MAX_TAGS];
+static int lastCount;
+static bool quiet;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readlocate -g antenna [-g antenna ...] [-d duration] [-e interval] [-q] uri\n");
+}
+
+/* port:x,y,z[:bx,by,bz] */
+static void parseAntenna(char *arg, TMR_LocateAntenna *antenna)
+{
+  int port;
+
+  memset(antenna, 0, sizeof(*antenna));
+  antenna->boresight[2] = 1;
+  if (4 > sscanf(arg, "%d:%lf,%lf,%lf:%lf,%lf,%lf", &port,
+                 &antenna->position[0], &antenna->position[1], &antenna->position[2],
+                 &antenna->boresight[0], &antenna->boresight[1], &antenna->boresight[2]))
+  {
+    usage();
+  }
+  antenna->port = (uint8_t)port;
+}
+
+static void locateCallback(TMR_Reader *reader, const TMR_LocateResult *r, void *cookie)
+{
+  char epc[128];
+  int i;
+
+  TMR_bytesToHex(r->tag->epc, r->tag->epcByteCount, epc);
+  for (i = 0; i < lastCount; i++)
+  {
+    if (0 == strcmp(epc, last[i].epc))
+    {
+      break;
+    }
+  }
+  if ((i == lastCount) && (MAX_TAGS > lastCount))
+  {
+    strcpy(last[i].epc, epc);
+    lastCount++;
+  }
+  if (i < lastCount)
+  {
+    last[i].result = *r;
+    last[i].result.tag = NULL;
+  }
+
+  if (false == quiet)
+  {
+    printf("%s %7.3f %7.3f %7.3f m +/- %.3f moving %6.3f %6.3f %6.3f m/s, %u updates\n",
+           epc, r->position[0], r->position[1], r->position[2], r->sigma,
+           r->velocity[0], r->velocity[1], r->velocity[2], r->updates);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_LocateConfig config;
+  TMR_LocateEngine engine;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  uint8_t antennas[TMR_PDOA_MAX_ANTENNAS];
+  uint32_t durationMs;
+  int opt, i;
+
+  rp = &r;
+  TMR_locateInitConfig(&config);
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "g:d:e:q")))
+  {
+    switch (opt)
+    {
+      case 'g':
+        if (TMR_PDOA_MAX_ANTENNAS == config.antennaCount)
+        {
+          usage();
+        }
+        parseAntenna(optarg, &config.antennas[config.antennaCount]);
+        antennas[config.antennaCount] = config.antennas[config.antennaCount].port;
+        config.antennaCount++;
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'e':
+        config.emitIntervalUs = (uint32_t)atoi(optarg) * 1000;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if ((optind + 1 != argc) || (0 == config.antennaCount))
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, config.antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  ret = TMR_locateStart(rp, &engine, &config, locateCallback, NULL);
+  checkerr(rp, ret, 1, "starting the estimator");
+
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  TMR_locateStop(&engine);
+
+  printf("\n%llu reads, %llu skipped; %llu RSSI, %llu range and %llu phase updates, "
+         "%llu phase gated; %llu estimates\n",
+         (unsigned long long)engine.reads, (unsigned long long)engine.skipped,
+         (unsigned long long)engine.rssiUpdates, (unsigned long long)engine.rangeUpdates,
+         (unsigned long long)engine.phaseUpdates, (unsigned long long)engine.gated,
+         (unsigned long long)engine.estimates);
+  for (i = 0; i < lastCount; i++)
+  {
+    printf("%s %7.3f %7.3f %7.3f m +/- %.3f\n", last[i].epc,
+           last[i].result.position[0], last[i].result.position[1],
+           last[i].result.position[2], last[i].result.sigma);
+  }
+
+  TMR_destroy(rp);
+  return 0;
+}
@@ -0,0 +1,425 @@
+/**
+ * Sample programme that records reads to a columnar read log (see
+ * tmr_readlog.h) and converts between read logs and text.
+ *
+ * Usage: readlog record [-a antennas] [-d duration] [-c chunk] uri file
+ *        readlog import [-c chunk] text file
+ *        readlog export [-e epc] [-a antenna] [-t from,to] file
+ *        readlog info file
+ *
+ *   record  read in the background and log every read
+ *   import  log the reads of a text file
+ *   export  print the reads of a log, or those of one tag, antenna or
+ *           span of milliseconds, as text
+ *   info    print the log's chunks and their indexes
+ *
+ *   -a  comma separated antennas to read on (default 1); for export,
+ *       the antenna
+ *   -d  read for this many milliseconds (default 5000)
+ *   -c  most reads in a chunk (default 4096)
+ *   -e  EPC, in hex
+ *   -t  first and last millisecond
+ *
+ * Text has a read a line, in the columns the phase experiments write:
+ *
+ *   GEN2:300833B2DDD9014000000000    1     1.5184364492350666     87.0
+ *
+ * protocol and EPC, antenna, phase in radians and in degrees, followed
+ * by time in milliseconds, frequency in kHz and RSSI in dBm, which
+ * export writes and import takes if they are there.  Without a time,
+ * import gives each group of lines between blank lines the next
+ * millisecond.  Other lines are skipped.
+ * @file readlog.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_readlog.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PI 3.14159265358979323846
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readlog record [-a antennas] [-d duration] [-c chunk] uri file\n"
+          "       readlog import [-c chunk] text file\n"
+          "       readlog export [-e epc] [-a antenna] [-t from,to] file\n"
+          "       readlog info file\n");
+}
+
+static const char *protocolName(TMR_TagProtocol protocol)
+{
+  switch (protocol)
+  {
+    case TMR_TAG_PROTOCOL_ISO180006B:
+      return "ISO180006B";
+    case TMR_TAG_PROTOCOL_GEN2:
+      return "GEN2";
+    case TMR_TAG_PROTOCOL_ISO180006B_UCODE:
+      return "ISO180006B_UCODE";
+    case TMR_TAG_PROTOCOL_IPX64:
+      return "IPX64";
+    case TMR_TAG_PROTOCOL_IPX256:
+      return "IPX256";
+    default:
+      return "NONE";
+  }
+}
+
+static TMR_TagProtocol protocolByName(const char *name, size_t length)
+{
+  static const TMR_TagProtocol protocols[] = {
+    TMR_TAG_PROTOCOL_ISO180006B, TMR_TAG_PROTOCOL_GEN2, TMR_TAG_PROTOCOL_ISO180006B_UCODE,
+    TMR_TAG_PROTOCOL_IPX64, TMR_TAG_PROTOCOL_IPX256
+  };
+  const char *known;
+  size_t i;
+
+  for (i = 0; i < sizeof(protocols) / sizeof(protocols[0]); i++)
+  {
+    known = protocolName(protocols[i]);
+    if ((strlen(known) == length) && (0 == strncmp(known, name, length)))
+    {
+      return protocols[i];
+    }
+  }
+  return TMR_TAG_PROTOCOL_NONE;
+}
+
+static void record(uint32_t chunkReads, int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_ReadLogWriter writer;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  uint8_t antennas[16];
+  uint8_t antennaCount;
+  uint32_t durationMs;
+  char *name;
+  int opt;
+
+  rp = &r;
+  antennas[0] = 1;
+  antennaCount = 1;
+  durationMs = 5000;
+  while (-1 != (opt = getopt(argc, argv, "a:d:c:")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (sizeof(antennas) == antennaCount)
+          {
+            usage();
+          }
+          antennas[antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'c':
+        chunkReads = (uint32_t)atoi(optarg);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 2 != argc || 0 == antennaCount)
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  ret = TMR_readLogStart(rp, &writer, argv[optind + 1], chunkReads);
+  checkerr(rp, ret, 1, "creating the log");
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  ret = TMR_readLogStop(&writer);
+  checkerr(rp, ret, 1, "writing the log");
+
+  printf("%llu reads of %lu tags in %lu chunks, %llu bytes, %.2f bytes a read\n",
+         (unsigned long long)writer.reads, (unsigned long)writer.epcs,
+         (unsigned long)writer.chunks, (unsigned long long)writer.bytes,
+         (0 == writer.reads) ? 0.0 : (double)writer.bytes / writer.reads);
+  TMR_destroy(rp);
+}
+
+static void import(uint32_t chunkReads, const char *textPath, const char *path)
+{
+  TMR_ReadLogWriter writer;
+  TMR_TagReadData trd;
+  TMR_Status ret;
+  FILE *text;
+  char line[512], epc[2 * TMR_MAX_EPC_BYTE_COUNT + 1];
+  const char *colon;
+  unsigned long long timeMs;
+  unsigned int antenna, frequency;
+  double radians, degrees;
+  int rssi, fields;
+  uint64_t groupMs, skipped;
+  bool inGroup;
+
+  text = fopen(textPath, "r");
+  if (NULL == text)
+  {
+    errx(1, "Error opening %s\n", textPath);
+  }
+  ret = TMR_readLogStart(NULL, &writer, path, chunkReads);
+  checkerr(NULL, ret, 1, "creating the log");
+
+  TMR_TRD_init(&trd);
+  groupMs = 0;
+  inGroup = false;
+  skipped = 0;
+  while (NULL != fgets(line, sizeof(line), text))
+  {
+    if (strspn(line, " \t\r\n") == strlen(line))
+    {
+      /* The next group of reads is a millisecond on */
+      if (inGroup)
+      {
+        groupMs++;
+      }
+      inGroup = false;
+      continue;
+    }
+    colon = strchr(line, ':');
+    fields = (NULL == colon) ? 0
+             : sscanf(colon + 1, "%124s %u %lf %lf %llu %u %d", epc, &antenna, &radians,
+                      &degrees, &timeMs, &frequency, &rssi);
+    if ((3 > fields) || (0 != (strlen(epc) % 2))
+        || (TMR_SUCCESS != TMR_hexToBytes(epc, trd.tag.epc, strlen(epc) / 2, NULL)))
+    {
+      skipped++;
+      continue;
+    }
+    trd.tag.protocol = protocolByName(line, colon - line);
+    trd.tag.epcByteCount = (uint8_t)(strlen(epc) / 2);
+    trd.antenna = (uint8_t)antenna;
+    /* Radians as written are whole degrees */
+    trd.phase = (uint16_t)((radians * 180 / PI) + 0.5);
+    if (5 > fields)
+    {
+      timeMs = groupMs;
+    }
+    trd.frequency = (6 > fields) ? 0 : frequency;
+    trd.rssi = (7 > fields) ? 0 : rssi;
+    trd.timestampHigh = (uint32_t)(timeMs >> 32);
+    trd.timestampLow = (uint32_t)timeMs;
+    TMR_readLogAddRead(&writer, &trd);
+    inGroup = true;
+  }
+  fclose(text);
+  ret = TMR_readLogStop(&writer);
+  checkerr(NULL, ret, 1, "writing the log");
+
+  printf("%llu reads of %lu tags in %lu chunks, %llu bytes, %llu lines skipped\n",
+         (unsigned long long)writer.reads, (unsigned long)writer.epcs,
+         (unsigned long)writer.chunks, (unsigned long long)writer.bytes,
+         (unsigned long long)skipped);
+}
+
+static void exportRead(const TMR_TagReadData *read, void *cookie)
+{
+  char epcStr[2 * TMR_MAX_EPC_BYTE_COUNT + 1];
+
+  TMR_bytesToHex(read->tag.epc, read->tag.epcByteCount, epcStr);
+  printf("%s:%s    %u     %.16g     %u     %llu     %lu     %d\n",
+         protocolName(read->tag.protocol), epcStr, read->antenna, read->phase * PI / 180,
+         read->phase, ((unsigned long long)read->timestampHigh << 32) | read->timestampLow,
+         (unsigned long)read->frequency, (int)read->rssi);
+}
+
+static void export(int argc, char *argv[])
+{
+  TMR_ReadLog log;
+  TMR_ReadLogQuery query;
+  TMR_TagData tag;
+  TMR_Status ret;
+  const char *epc;
+  char *comma;
+  uint64_t reads;
+  int opt;
+
+  TMR_readLogInitQuery(&query);
+  epc = NULL;
+  while (-1 != (opt = getopt(argc, argv, "e:a:t:")))
+  {
+    switch (opt)
+    {
+      case 'e':
+        epc = optarg;
+        break;
+      case 'a':
+        query.minAntenna = query.maxAntenna = (uint8_t)atoi(optarg);
+        break;
+      case 't':
+        comma = strchr(optarg, ',');
+        if (NULL == comma)
+        {
+          usage();
+        }
+        query.minTimeMs = strtoull(optarg, NULL, 10);
+        query.maxTimeMs = strtoull(comma + 1, NULL, 10);
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 1 != argc)
+  {
+    usage();
+  }
+  if (NULL != epc)
+  {
+    ret = TMR_hexToBytes(epc, tag.epc, strlen(epc) / 2, NULL);
+    checkerr(NULL, ret, 1, "parsing the EPC");
+    tag.epcByteCount = (uint8_t)(strlen(epc) / 2);
+    query.tag = &tag;
+  }
+
+  ret = TMR_readLogOpen(&log, argv[optind]);
+  checkerr(NULL, ret, 1, "opening the log");
+  reads = TMR_readLogScan(&log, &query, exportRead, NULL);
+  fprintf(stderr, "%llu reads, %lu chunks scanned, %lu skipped by their index\n",
+          (unsigned long long)reads, (unsigned long)log.chunksScanned,
+          (unsigned long)log.chunksSkipped);
+  TMR_readLogClose(&log);
+}
+
+static void info(const char *path)
+{
+  TMR_ReadLog log;
+  TMR_ReadLogChunk chunk;
+  TMR_Status ret;
+  uint32_t i;
+
+  ret = TMR_readLogOpen(&log, path);
+  checkerr(NULL, ret, 1, "opening the log");
+  printf("%llu reads of %lu tags in %lu chunks of up to %lu reads%s\n",
+         (unsigned long long)log.reads, (unsigned long)log.epcs, (unsigned long)log.chunks,
+         (unsigned long)log.chunkReads, log.truncated ? ", then part of a chunk" : "");
+  for (i = 0; TMR_SUCCESS == TMR_readLogChunk(&log, i, &chunk); i++)
+  {
+    printf("chunk %lu at %llu: %lu reads in %lu bytes, %lu new tags, ms %llu-%llu, tags %lu-%lu, "
+           "ant %u-%u, kHz %lu-%lu, phase %u-%u, dBm %d-%d\n",
+           (unsigned long)i, (unsigned long long)chunk.offset, (unsigned long)chunk.count,
+           (unsigned long)chunk.size, (unsigned long)chunk.dictCount,
+           (unsigned long long)chunk.minTimeMs, (unsigned long long)chunk.maxTimeMs,
+           (unsigned long)chunk.minEpc, (unsigned long)chunk.maxEpc, chunk.minAntenna,
+           chunk.maxAntenna, (unsigned long)chunk.minFrequency,
+           (unsigned long)chunk.maxFrequency, chunk.minPhase, chunk.maxPhase, chunk.minRssi,
+           chunk.maxRssi);
+  }
+  TMR_readLogClose(&log);
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t chunkReads;
+  int opt;
+
+  if (2 > argc)
+  {
+    usage();
+  }
+  chunkReads = 0;
+  /* Options follow the command */
+  optind = 2;
+  if (0 == strcmp(argv[1], "record"))
+  {
+    record(chunkReads, argc, argv);
+  }
+  else if (0 == strcmp(argv[1], "import"))
+  {
+    while (-1 != (opt = getopt(argc, argv, "c:")))
+    {
+      if ('c' != opt)
+      {
+        usage();
+      }
+      chunkReads = (uint32_t)atoi(optarg);
+    }
+    if (optind + 2 != argc)
+    {
+      usage();
+    }
+    import(chunkReads, argv[optind], argv[optind + 1]);
+  }
+  else if (0 == strcmp(argv[1], "export"))
+  {
+    export(argc, argv);
+  }
+  else if ((0 == strcmp(argv[1], "info")) && (3 == argc))
+  {
+    info(argv[2]);
+  }
+  else
+  {
+    usage();
+  }
+  return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * Sample programme that reads with several readers at once and
+ * prints their reads as one stream on a shared time base (see
+ * tmr_multi.h), then each reader's clock offset and drift.
+ *
+ * Usage: readmulti [-a antennas] [-d duration] [-r delay] [-p] [-q] uri [uri ...]
+ *
+ *   -a  comma separated antennas each reader reads on (default 1)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -r  longest a read waits for earlier reads of other readers, ms
+ *       (default 50)
+ *   -p  feed the merged stream to the phase difference engine and
+ *       count the differences between antennas of different readers
+ *   -q  print the counts only
+ *
+ * Antenna a of the reader given n-th (from 0) is numbered 4n + a in
+ * the merged stream.  For example, two simulated modules:
+ *   readmulti -p -a 1,2 'sim:///m6e?tags=4&ant=2&rate=500' \
+ *                       'sim:///m6e?tags=4&ant=2&rate=500'
+ * @file readmulti.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_multi.h>
+#include <tmr_pdoa.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool quiet;
+static bool pairing;
+static TMR_PdoaEngine pdoa;
+static uint64_t crossPairs;
+static uint8_t stride;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readmulti [-a antennas] [-d duration] [-r delay] [-p] [-q] uri [uri ...]\n");
+}
+
+static void pdoaCallback(TMR_Reader *reader, const TMR_PdoaResult *r, void *cookie)
+{
+  if ((r->antennaA - 1) / stride != (r->antennaB - 1) / stride)
+  {
+    crossPairs++;
+  }
+}
+
+static void multiCallback(TMR_MultiSession *session, uint8_t index,
+                          const TMR_TagReadData *t, uint64_t timeUs, void *cookie)
+{
+  char epc[128];
+
+  if (false == quiet)
+  {
+    TMR_bytesToHex(t->tag.epc, t->tag.epcByteCount, epc);
+    printf("%12llu us reader %u ant %2u %s\n", (unsigned long long)timeUs, index,
+           t->antenna, epc);
+  }
+  if (pairing)
+  {
+    TMR_pdoaAddRead(&pdoa, t);
+  }
+}
+
+static void connectReader(TMR_Reader *rp, const char *arg, uint8_t *antennas,
+                          uint8_t antennaCount)
+{
+  TMR_ReadPlan plan;
+  TMR_Region region;
+  TMR_Status ret;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, arg, sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+}
+
+int main(int argc, char *argv[])
+{
+  static TMR_Reader r[TMR_MULTI_MAX_READERS];
+  static TMR_MultiSession session;
+  TMR_Reader *readers[TMR_MULTI_MAX_READERS];
+  TMR_MultiConfig config;
+  TMR_PdoaConfig pdoaConfig;
+  TMR_MultiMember *member;
+  TMR_Status ret;
+  char *name;
+  uint8_t antennas[16];
+  uint8_t antennaCount, count;
+  uint32_t durationMs;
+  int opt, i;
+
+  TMR_multiInitConfig(&config);
+  stride = config.antennaStride;
+  antennas[0] = 1;
+  antennaCount = 1;
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "a:d:r:pq")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (sizeof(antennas) == antennaCount)
+          {
+            usage();
+          }
+          antennas[antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'r':
+        config.reorderDelayUs = (uint32_t)atoi(optarg) * 1000;
+        break;
+      case 'p':
+        pairing = true;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  count = (uint8_t)(argc - optind);
+  if ((0 == count) || (TMR_MULTI_MAX_READERS < count) || (0 == antennaCount))
+  {
+    usage();
+  }
+  for (i = 0; i < count; i++)
+  {
+    connectReader(&r[i], argv[optind + i], antennas, antennaCount);
+    readers[i] = &r[i];
+  }
+
+  if (pairing)
+  {
+    TMR_pdoaInitConfig(&pdoaConfig);
+    ret = TMR_pdoaStart(NULL, &pdoa, &pdoaConfig, pdoaCallback, NULL);
+    checkerr(NULL, ret, 1, "starting the phase difference engine");
+  }
+
+  ret = TMR_multiStart(&session, readers, count, &config, multiCallback, NULL);
+  checkerr(readers[0], ret, 1, "starting the session");
+  tmr_sleep(durationMs);
+  ret = TMR_multiStop(&session);
+  checkerr(readers[0], ret, 1, "stopping the session");
+
+  printf("\n%llu reads merged, %llu late\n", (unsigned long long)session.merged,
+         (unsigned long long)session.late);
+  for (i = 0; i < count; i++)
+  {
+    member = &session.members[i];
+    printf("reader %d: %llu reads, %llu dropped, %llu exceptions, "
+           "clock offset %.0f us, drift %.1f ppm\n", i,
+           (unsigned long long)member->reads, (unsigned long long)member->dropped,
+           (unsigned long long)member->exceptions, member->offsetUs, member->driftPpm);
+  }
+  if (pairing)
+  {
+    printf("%llu phase differences, %llu between readers\n",
+           (unsigned long long)pdoa.results, (unsigned long long)crossPairs);
+    TMR_pdoaStop(&pdoa);
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    TMR_destroy(&r[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * Sample programme that reads continuously and prints the phase
+ * difference of each tag between pairs of antennas as the reads
+ * arrive (see tmr_pdoa.h), then how many differences each pair gave.
+ *
+ * Usage: readpdoa [-a antennas] [-d duration] [-s skew] [-q] uri
+ *
+ *   -a  comma separated antennas to read on and pair (default 1,2)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -s  longest time between the reads of a pair, ms (default 100)
+ *   -q  print the counts only
+ *
+ * For example, against the simulated module:
+ *   readpdoa -a 1,2,3 'sim:///m6e?tags=4&ant=3&rate=2000'
+ * @file readpdoa.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_pdoa.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint32_t pairCounts[TMR_PDOA_MAX_ANTENNAS + 1][TMR_PDOA_MAX_ANTENNAS + 1];
+static bool quiet;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readpdoa [-a antennas] [-d duration] [-s skew] [-q] uri\n");
+}
+
+static void pdoaCallback(TMR_Reader *reader, const TMR_PdoaResult *r, void *cookie)
+{
+  char epc[128];
+
+  pairCounts[r->antennaA][r->antennaB]++;
+  if (quiet)
+  {
+    return;
+  }
+  TMR_bytesToHex(r->tag->epc, r->tag->epcByteCount, epc);
+  printf("%s %u-%u %6u kHz %+8.4f rad skew %5.1f ms%s rssi %d/%d\n",
+         epc, r->antennaA, r->antennaB, r->frequency, r->phaseDiff,
+         r->skewUs / 1000.0, r->aligned ? " aligned" : "",
+         r->rssiA, r->rssiB);
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_PdoaConfig config;
+  TMR_PdoaEngine engine;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  char *name;
+  uint32_t durationMs;
+  int opt, a, b;
+
+  rp = &r;
+  TMR_pdoaInitConfig(&config);
+  config.antennas[0] = 1;
+  config.antennas[1] = 2;
+  config.antennaCount = 2;
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "a:d:s:q")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        config.antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (TMR_PDOA_MAX_ANTENNAS == config.antennaCount)
+          {
+            usage();
+          }
+          config.antennas[config.antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 's':
+        config.maxSkewUs = (uint32_t)atoi(optarg) * 1000;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if ((optind + 1 != argc) || (2 > config.antennaCount))
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, config.antennaCount, config.antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  ret = TMR_pdoaStart(rp, &engine, &config, pdoaCallback, NULL);
+  checkerr(rp, ret, 1, "starting the phase difference engine");
+
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  TMR_pdoaStop(&engine);
+
+  printf("\n%llu reads with phase, %llu skipped, %llu differences\n",
+         (unsigned long long)engine.reads, (unsigned long long)engine.skipped,
+         (unsigned long long)engine.results);
+  for (a = 1; a <= TMR_PDOA_MAX_ANTENNAS; a++)
+  {
+    for (b = a + 1; b <= TMR_PDOA_MAX_ANTENNAS; b++)
+    {
+      if (0 != pairCounts[a][b])
+      {
+        printf("antennas %d-%d: %u\n", a, b, pairCounts[a][b]);
+      }
+    }
+  }
+
+  TMR_destroy(rp);
+  return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ * Sample programme that reads tags a number of times with
+ * TMR_readIntoArray(), lays the reads out in a phase batch and prints
+ * the circular phase statistics of each tag (see tmr_phase.h).
+ *
+ * Usage: readphase [-n rounds] [-t timeout] [-l limit] [-a] [-w] uri
+ *
+ *   -n  read this many times (default 20)
+ *   -t  milliseconds each read lasts (default 250)
+ *   -l  leave out phases further than this many deviations from
+ *       their tag's mean (default 0, keep all)
+ *   -a  take each tag on each antenna separately
+ *   -w  weight phases by received power
+ *
+ * For example, against the simulated module:
+ *   readphase -l 2 -a 'sim:///m6e?tags=8&ant=2&range=150'
+ * @file readphase.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_phase.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_READS 65536
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readphase [-n rounds] [-t timeout] [-l limit] [-a] [-w] uri\n");
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_PhaseKernel kernel;
+  TMR_PhaseBatch batch;
+  TMR_PhaseStats *stats;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  char epc[128];
+  uint32_t rounds, timeoutMs, g;
+  double limit;
+  bool byAntenna, weighted;
+  int opt;
+  static const char *kernelNames[] = {"scalar", "SSE2", "AVX2"};
+
+  rp = &r;
+  rounds = 20;
+  timeoutMs = 250;
+  limit = 0;
+  byAntenna = false;
+  weighted = false;
+
+  while (-1 != (opt = getopt(argc, argv, "n:t:l:aw")))
+  {
+    switch (opt)
+    {
+      case 'n':
+        rounds = (uint32_t)atoi(optarg);
+        break;
+      case 't':
+        timeoutMs = (uint32_t)atoi(optarg);
+        break;
+      case 'l':
+        limit = atof(optarg);
+        break;
+      case 'a':
+        byAntenna = true;
+        break;
+      case 'w':
+        weighted = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 1 != argc)
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  /* The M6e's phase wraps at 180 degrees */
+  ret = TMR_phaseKernelInit(&kernel, 180);
+  checkerr(rp, ret, 1, "initializing the phase kernel");
+  ret = TMR_phaseBatchInit(&batch, MAX_READS, 180, byAntenna);
+  checkerr(rp, ret, 1, "allocating the phase batch");
+
+  for (; rounds > 0; rounds--)
+  {
+    TMR_TagReadData *reads;
+    int32_t count;
+
+    ret = TMR_readIntoArray(rp, timeoutMs, &count, &reads);
+    checkerr(rp, ret, 1, "reading tags");
+    ret = TMR_phaseBatchLoad(&batch, reads, count);
+    free(reads);
+    if (TMR_ERROR_TOO_BIG == ret)
+    {
+      break;
+    }
+  }
+
+  stats = calloc(batch.groupCount + 1, sizeof(*stats));
+  if (NULL == stats)
+  {
+    errx(1, "Out of memory\n");
+  }
+  TMR_phaseGroupStats(&kernel, &batch, weighted, limit, stats);
+
+  printf("%u reads of %u tags, %s kernels\n", batch.count, batch.groupCount,
+         kernelNames[kernel.type]);
+  for (g = 0; g < batch.groupCount; g++)
+  {
+    TMR_bytesToHex(batch.groupTag[g].epc, batch.groupTag[g].epcByteCount, epc);
+    printf("%s", epc);
+    if (byAntenna)
+    {
+      printf(" ant %u", batch.groupAntenna[g]);
+    }
+    printf(" %4u reads, mean %6.2f deg, deviation %5.2f deg, resultant %.3f\n",
+           stats[g].count, stats[g].mean * 180 / 3.14159265358979,
+           stats[g].deviation * 180 / 3.14159265358979, stats[g].resultant);
+  }
+
+  free(stats);
+  TMR_phaseBatchFree(&batch);
+  TMR_destroy(rp);
+  return 0;
+}
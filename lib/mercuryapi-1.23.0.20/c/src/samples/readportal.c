@@ -0,0 +1,202 @@
+/**
+ * Sample programme that reads in the background and prints which way
+ * each tag went through a portal (see tmr_portal.h).
+ *
+ * Usage: readportal [-P portal] -o antennas -i antennas [...] [-d duration]
+ *                   [-g leave] [-q] uri
+ *
+ *   -P  portal the -o and -i after it are for (default 0)
+ *   -o  comma separated antennas on the outside of the portal
+ *   -i  comma separated antennas on the inside
+ *   -d  read for this many milliseconds (default 5000)
+ *   -g  milliseconds unread before a tag has left the portal (default 100)
+ *   -q  print the counts only
+ *
+ * The reader reads on every antenna given.  For example, dock doors 0
+ * and 1 with two antennas each:
+ *   readportal -o 1 -i 2 -P 1 -o 3 -i 4 tmr:///dev/ttyUSB0
+ * @file readportal.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_portal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool quiet;
+
+static const char *directionNames[TMR_PORTAL_DIRECTIONS] = {
+  "unknown", "in", "out"
+};
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readportal [-P portal] -o antennas -i antennas [...] [-d duration]\n"
+          "                  [-g leave] [-q] uri\n");
+}
+
+static void decisionCallback(TMR_Reader *reader, const TMR_PortalDecision *decision,
+                             void *cookie)
+{
+  char epcStr[2 * TMR_MAX_EPC_BYTE_COUNT + 1];
+
+  if (quiet)
+  {
+    return;
+  }
+  TMR_bytesToHex(decision->tag->epc, decision->tag->epcByteCount, epcStr);
+  printf("portal %u %s %-7s score %+.2f (order %+d peak %+d doppler %+d) reads %lu/%lu "
+         "%.0f ms after its last read\n", decision->portal, epcStr,
+         directionNames[decision->direction], decision->score, decision->orderVote,
+         decision->peakVote, decision->dopplerVote, (unsigned long)decision->outsideReads,
+         (unsigned long)decision->insideReads,
+         (decision->timeUs - decision->lastUs) / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_PortalConfig config;
+  TMR_PortalEngine engine;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  uint8_t antennas[16];
+  uint8_t antennaCount;
+  uint8_t portal, antenna;
+  uint32_t durationMs;
+  char *name;
+  int opt, i;
+
+  rp = &r;
+  TMR_portalInitConfig(&config);
+  antennaCount = 0;
+  portal = 0;
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "P:o:i:d:g:q")))
+  {
+    switch (opt)
+    {
+      case 'P':
+        portal = (uint8_t)atoi(optarg);
+        break;
+      case 'o':
+      case 'i':
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          antenna = (uint8_t)atoi(name);
+          ret = TMR_portalSetAntenna(&config, antenna, portal,
+                                     ('o' == opt) ? TMR_PORTAL_ROLE_OUTSIDE
+                                                  : TMR_PORTAL_ROLE_INSIDE);
+          if (TMR_SUCCESS != ret)
+          {
+            usage();
+          }
+          for (i = 0; i < antennaCount && antennas[i] != antenna; i++)
+          {
+          }
+          if (i == antennaCount)
+          {
+            if (sizeof(antennas) == antennaCount)
+            {
+              usage();
+            }
+            antennas[antennaCount++] = antenna;
+          }
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'g':
+        config.leaveUs = (uint32_t)atoi(optarg) * 1000;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 1 != argc || 0 == antennaCount)
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  ret = TMR_RP_init_simple(&plan, antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  ret = TMR_portalStart(rp, &engine, &config, decisionCallback, NULL);
+  checkerr(rp, ret, 1, "starting the portal engine (each portal needs -o and -i)");
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  TMR_portalStop(&engine);
+
+  printf("%llu reads: %llu in, %llu out, %llu unknown, %llu decided early\n",
+         (unsigned long long)engine.reads,
+         (unsigned long long)engine.decisions[TMR_PORTAL_IN],
+         (unsigned long long)engine.decisions[TMR_PORTAL_OUT],
+         (unsigned long long)engine.decisions[TMR_PORTAL_UNKNOWN],
+         (unsigned long long)engine.evictions);
+
+  TMR_destroy(rp);
+  return 0;
+}
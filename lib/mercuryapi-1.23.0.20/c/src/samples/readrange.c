@@ -0,0 +1,212 @@
+/**
+ * Sample programme that reads continuously with frequency hopping
+ * on and prints each tag's distance from the antenna as the hops
+ * come in (see tmr_range.h), then the last estimate of each tag.
+ *
+ * Usage: readrange [-a antennas] [-d duration] [-m channels] [-o offset] [-q] uri
+ *
+ *   -a  comma separated antennas to read on (default 1)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -m  fewest channels to estimate from (default 4)
+ *   -o  cable and reader offset to subtract, cm (default 0)
+ *   -q  print the last estimates only
+ *
+ * For example, against the simulated module with tags 1.5 m and more
+ * away:
+ *   readrange 'sim:///m6e?tags=4&ant=1&rate=2000&range=150'
+ * @file readrange.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_range.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_TAGS 64
+
+typedef struct LastEstimate
+{
+  char epc[128];
+  uint8_t antenna;
+  TMR_RangeResult result;
+} LastEstimate;
+
+static LastEstimate last[MAX_TAGS];
+static int lastCount;
+static bool quiet;
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readrange [-a antennas] [-d duration] [-m channels] [-o offset] [-q] uri\n");
+}
+
+static void rangeCallback(TMR_Reader *reader, const TMR_RangeResult *r, void *cookie)
+{
+  char epc[128];
+  int i;
+
+  TMR_bytesToHex(r->tag->epc, r->tag->epcByteCount, epc);
+  for (i = 0; i < lastCount; i++)
+  {
+    if ((r->antenna == last[i].antenna) && (0 == strcmp(epc, last[i].epc)))
+    {
+      break;
+    }
+  }
+  if ((i == lastCount) && (MAX_TAGS > lastCount))
+  {
+    strcpy(last[i].epc, epc);
+    last[i].antenna = r->antenna;
+    lastCount++;
+  }
+  if (i < lastCount)
+  {
+    last[i].result = *r;
+    last[i].result.tag = NULL;
+  }
+
+  if (false == quiet)
+  {
+    printf("%s ant %u %7.3f m +/- %.3f confidence %.2f, %2u channels over %5u kHz\n",
+           epc, r->antenna, r->distance, r->sigma, r->confidence,
+           r->channels, r->spanKhz);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_RangeConfig config;
+  TMR_RangeEngine engine;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  char *name;
+  uint8_t antennas[16];
+  uint8_t antennaCount;
+  uint32_t durationMs;
+  int opt, i;
+
+  rp = &r;
+  TMR_rangeInitConfig(&config);
+  antennas[0] = 1;
+  antennaCount = 1;
+  durationMs = 5000;
+
+  while (-1 != (opt = getopt(argc, argv, "a:d:m:o:q")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (sizeof(antennas) == antennaCount)
+          {
+            usage();
+          }
+          antennas[antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'm':
+        config.minChannels = (uint8_t)atoi(optarg);
+        break;
+      case 'o':
+        config.offsetM = atoi(optarg) / 100.0;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if ((optind + 1 != argc) || (0 == antennaCount))
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  /* Leave the region's hop table as it is: ranging needs the hops */
+  ret = TMR_RP_init_simple(&plan, antennaCount, antennas, TMR_TAG_PROTOCOL_GEN2, 1000);
+  checkerr(rp, ret, 1, "initializing the read plan");
+  ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+  checkerr(rp, ret, 1, "setting read plan");
+
+  ret = TMR_rangeStart(rp, &engine, &config, rangeCallback, NULL);
+  checkerr(rp, ret, 1, "starting ranging");
+
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  TMR_rangeStop(&engine);
+
+  printf("\n%llu reads with phase, %llu skipped, %llu estimates\n",
+         (unsigned long long)engine.reads, (unsigned long long)engine.skipped,
+         (unsigned long long)engine.estimates);
+  for (i = 0; i < lastCount; i++)
+  {
+    printf("%s ant %u %7.3f m +/- %.3f confidence %.2f\n",
+           last[i].epc, last[i].antenna, last[i].result.distance,
+           last[i].result.sigma, last[i].result.confidence);
+  }
+
+  TMR_destroy(rp);
+  return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * Sample programme that reads with an antenna round-robin schedule
+ * (see tmr_schedule.h) and reports how close together in time each
+ * tag's reads on the different antennas came.
+ *
+ * Usage: readschedule [-a antennas] [-n tags] [-e epc] [-Q q] [-w dwell]
+ *                     [-t settling] [-d duration] [-b] uri
+ *
+ *   -a  comma separated antennas to go round (default 1,2)
+ *   -n  number of target tags (default 4)
+ *   -e  read only the tag with this EPC, in hex
+ *   -Q  static Q (default sized to the number of tags)
+ *   -w  dwell per antenna, milliseconds (default from Q)
+ *   -t  antenna settling time, microseconds (default 0)
+ *   -d  read for this many milliseconds (default 5000)
+ *   -b  read first with a plain read plan over the same antennas and
+ *       the reader's own search time, for comparison
+ *
+ * For example, against the simulated module:
+ *   readschedule -b -a 1,3,4 'sim:///m6e?tags=4&ant=4&rate=1000'
+ * @file readschedule.c
+ */
+
+#include <tm_reader.h>
+#include <tmr_schedule.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+void errx(int exitval, const char *fmt, ...)
+{
+  va_list ap;
+
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+
+  exit(exitval);
+}
+
+void checkerr(TMR_Reader* rp, TMR_Status ret, int exitval, const char *msg)
+{
+  if (TMR_SUCCESS != ret)
+  {
+    errx(exitval, "Error %s: %s\n", msg, TMR_strerr(rp, ret));
+  }
+}
+
+static void usage(void)
+{
+  errx(1, "Usage: readschedule [-a antennas] [-n tags] [-e epc] [-Q q] [-w dwell]\n"
+          "                    [-t settling] [-d duration] [-b] uri\n");
+}
+
+static void baselineCallback(TMR_Reader *reader, const TMR_TagReadData *t, void *cookie)
+{
+  TMR_scheduleAddRead(cookie, t);
+}
+
+static void report(const char *name, const TMR_Schedule *schedule)
+{
+  printf("%s: %llu reads, %llu paired, latency mean %.1f ms, p50 %.0f ms, p90 %.0f ms, "
+         "p99 %.0f ms, max %.1f ms\n", name,
+         (unsigned long long)schedule->reads, (unsigned long long)schedule->pairs,
+         (0 == schedule->pairs) ? 0.0 : schedule->totalUs / 1000.0 / schedule->pairs,
+         TMR_scheduleLatencyUs(schedule, 50) / 1000.0,
+         TMR_scheduleLatencyUs(schedule, 90) / 1000.0,
+         TMR_scheduleLatencyUs(schedule, 99) / 1000.0, schedule->maxUs / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+  TMR_Reader r, *rp;
+  TMR_ReadPlan plan;
+  TMR_ReadListenerBlock rlb;
+  TMR_ScheduleConfig config;
+  TMR_Schedule schedule, baseline;
+  TMR_TagFilter filter;
+  TMR_Status ret;
+  TMR_Region region;
+  char uri[TMR_MAX_READER_NAME_LENGTH];
+  const char *epc;
+  char *name;
+  uint32_t durationMs;
+  bool compare;
+  int opt;
+
+  rp = &r;
+  TMR_scheduleInitConfig(&config);
+  config.antennas[0] = 1;
+  config.antennas[1] = 2;
+  config.antennaCount = 2;
+  epc = NULL;
+  durationMs = 5000;
+  compare = false;
+
+  while (-1 != (opt = getopt(argc, argv, "a:n:e:Q:w:t:d:b")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        config.antennaCount = 0;
+        for (name = strtok(optarg, ","); NULL != name; name = strtok(NULL, ","))
+        {
+          if (TMR_SCHEDULE_MAX_ANTENNAS == config.antennaCount)
+          {
+            usage();
+          }
+          config.antennas[config.antennaCount++] = (uint8_t)atoi(name);
+        }
+        break;
+      case 'n':
+        config.tagCount = (uint16_t)atoi(optarg);
+        break;
+      case 'e':
+        epc = optarg;
+        break;
+      case 'Q':
+        config.q = (int8_t)atoi(optarg);
+        break;
+      case 'w':
+        config.dwellMs = (uint32_t)atoi(optarg);
+        break;
+      case 't':
+        config.settlingUs = (uint16_t)atoi(optarg);
+        break;
+      case 'd':
+        durationMs = (uint32_t)atoi(optarg);
+        break;
+      case 'b':
+        compare = true;
+        break;
+      default:
+        usage();
+    }
+  }
+  if (optind + 1 != argc)
+  {
+    usage();
+  }
+
+  /* TMR_create() tokenizes the URI in place */
+  strncpy(uri, argv[optind], sizeof(uri) - 1);
+  uri[sizeof(uri) - 1] = '\0';
+  ret = TMR_create(rp, uri);
+  checkerr(rp, ret, 1, "creating reader");
+
+  ret = TMR_connect(rp);
+  checkerr(rp, ret, 1, "connecting reader");
+
+  region = TMR_REGION_NONE;
+  ret = TMR_paramGet(rp, TMR_PARAM_REGION_ID, &region);
+  checkerr(rp, ret, 1, "getting region");
+  if (TMR_REGION_NONE == region)
+  {
+    TMR_RegionList regions;
+    TMR_Region _regionStore[32];
+    regions.list = _regionStore;
+    regions.max = sizeof(_regionStore)/sizeof(_regionStore[0]);
+    regions.len = 0;
+
+    ret = TMR_paramGet(rp, TMR_PARAM_REGION_SUPPORTEDREGIONS, &regions);
+    checkerr(rp, ret, 1, "getting supported regions");
+    if (regions.len < 1)
+    {
+      checkerr(rp, TMR_ERROR_INVALID_REGION, 1, "Reader doesn't support any regions");
+    }
+    region = regions.list[0];
+    ret = TMR_paramSet(rp, TMR_PARAM_REGION_ID, &region);
+    checkerr(rp, ret, 1, "setting region");
+  }
+
+  if (NULL != epc)
+  {
+    filter.type = TMR_FILTER_TYPE_TAG_DATA;
+    ret = TMR_hexToBytes(epc, filter.u.tagData.epc, strlen(epc) / 2, NULL);
+    checkerr(rp, ret, 1, "parsing the EPC");
+    filter.u.tagData.epcByteCount = (uint8_t)(strlen(epc) / 2);
+    config.filter = &filter;
+  }
+
+  if (compare)
+  {
+    /* The same antennas as one plain plan, timed by the reader's search time */
+    ret = TMR_scheduleStart(NULL, &baseline, &config);
+    checkerr(rp, ret, 1, "starting the baseline");
+    ret = TMR_RP_init_simple(&plan, config.antennaCount, config.antennas,
+                             TMR_TAG_PROTOCOL_GEN2, 1000);
+    checkerr(rp, ret, 1, "initializing the read plan");
+    if (NULL != config.filter)
+    {
+      TMR_RP_set_filter(&plan, config.filter);
+    }
+    ret = TMR_paramSet(rp, TMR_PARAM_READ_PLAN, &plan);
+    checkerr(rp, ret, 1, "setting read plan");
+    rlb.listener = baselineCallback;
+    rlb.cookie = &baseline;
+    ret = TMR_addReadListener(rp, &rlb);
+    checkerr(rp, ret, 1, "adding read listener");
+    ret = TMR_startReading(rp);
+    checkerr(rp, ret, 1, "starting reading");
+    tmr_sleep(durationMs);
+    TMR_stopReading(rp);
+    TMR_removeReadListener(rp, &rlb);
+    report("plain plan", &baseline);
+    TMR_scheduleStop(&baseline);
+  }
+
+  ret = TMR_scheduleStart(rp, &schedule, &config);
+  checkerr(rp, ret, 1, "starting the schedule");
+  printf("schedule: Q %u, dwell %lu ms per antenna, search time %lu ms\n", schedule.q,
+         (unsigned long)schedule.dwellMs, (unsigned long)schedule.onTimeMs);
+  ret = TMR_startReading(rp);
+  checkerr(rp, ret, 1, "starting reading");
+  tmr_sleep(durationMs);
+  TMR_stopReading(rp);
+  report("schedule", &schedule);
+  TMR_scheduleStop(&schedule);
+
+  TMR_destroy(rp);
+  return 0;
+}